@@ -0,0 +1,272 @@
+#include "adjacency.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+int SideIndex(TileSide s) { return static_cast<int>(s); }
+
+TileSide Opposite(TileSide s) {
+    switch (s) {
+        case TileSide::Left: return TileSide::Right;
+        case TileSide::Right: return TileSide::Left;
+        case TileSide::Top: return TileSide::Bottom;
+        case TileSide::Bottom: return TileSide::Top;
+    }
+    return TileSide::Left;
+}
+
+bool IsVertical(TileSide s) { return s == TileSide::Left || s == TileSide::Right; }
+
+// coordinata della linea su cui sta il lato
+int Coord(const CellRect& r, TileSide s) {
+    switch (s) {
+        case TileSide::Left: return r.x;
+        case TileSide::Right: return r.x + r.w;
+        case TileSide::Top: return r.y;
+        case TileSide::Bottom: return r.y + r.h;
+    }
+    return 0;
+}
+
+// estensione del lato lungo la sua linea: [SpanLo, SpanHi)
+int SpanLo(const CellRect& r, TileSide s) { return IsVertical(s) ? r.y : r.x; }
+int SpanHi(const CellRect& r, TileSide s) { return IsVertical(s) ? r.y + r.h : r.x + r.w; }
+
+constexpr TileSide kSides[] = {TileSide::Left, TileSide::Right, TileSide::Top, TileSide::Bottom};
+
+void EraseValue(std::vector<uint64_t>& v, uint64_t id) {
+    auto it = std::find(v.begin(), v.end(), id);
+    if (it == v.end()) return;
+    *it = v.back();
+    v.pop_back();
+}
+
+} // namespace
+
+void AdjacencyIndex::Clear() {
+    nodes_.clear();
+    for (auto& l : lines_) l.clear();
+    order_.clear();
+}
+
+const CellRect* AdjacencyIndex::Rect(uint64_t id) const {
+    auto it = nodes_.find(id);
+    return it == nodes_.end() ? nullptr : &it->second.rect;
+}
+
+const std::vector<uint64_t>& AdjacencyIndex::Neighbors(uint64_t id, TileSide side) const {
+    static const std::vector<uint64_t> kNone;
+    auto it = nodes_.find(id);
+    return it == nodes_.end() ? kNone : it->second.nbr[SideIndex(side)];
+}
+
+void AdjacencyIndex::Overlapping(TileSide side, int coord, int lo, int hi, std::vector<uint64_t>& out) const {
+    out.clear();
+    auto lit = lines_[SideIndex(side)].find(coord);
+    if (lit != lines_[SideIndex(side)].end()) OverlappingLine(lit->second, lo, hi, out);
+}
+
+void AdjacencyIndex::OverlappingLine(const Line& line, int lo, int hi, std::vector<uint64_t>& out) const {
+    out.clear();
+    // sulla stessa linea i tratti sono disgiunti: solo il precedente puo' iniziare prima di lo
+    auto it = line.lower_bound({lo, 0});
+    if (it != line.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second > lo) out.push_back(prev->first.second);
+    }
+    for (; it != line.end() && it->first.first < hi; ++it) out.push_back(it->first.second);
+}
+
+void AdjacencyIndex::Add(uint64_t id, const CellRect& r) {
+    if (nodes_.count(id)) Remove(id);
+    Node& node = nodes_[id];
+    node.rect = r;
+
+    std::vector<uint64_t> hits;
+    for (TileSide s : kSides) {
+        const TileSide opp = Opposite(s);
+        Overlapping(opp, Coord(r, s), SpanLo(r, s), SpanHi(r, s), hits);
+        for (uint64_t n : hits) {
+            if (n == id) continue;
+            node.nbr[SideIndex(s)].push_back(n);
+            nodes_[n].nbr[SideIndex(opp)].push_back(id);
+        }
+    }
+    for (TileSide s : kSides) lines_[SideIndex(s)][Coord(r, s)][{SpanLo(r, s), id}] = SpanHi(r, s);
+    order_.insert({r.y, r.x, id});
+}
+
+void AdjacencyIndex::Remove(uint64_t id) {
+    auto it = nodes_.find(id);
+    if (it == nodes_.end()) return;
+    const Node& node = it->second;
+
+    for (TileSide s : kSides) {
+        for (uint64_t n : node.nbr[SideIndex(s)]) {
+            auto nit = nodes_.find(n);
+            if (nit != nodes_.end()) EraseValue(nit->second.nbr[SideIndex(Opposite(s))], id);
+        }
+        auto& byCoord = lines_[SideIndex(s)];
+        auto lit = byCoord.find(Coord(node.rect, s));
+        if (lit == byCoord.end()) continue;
+        lit->second.erase({SpanLo(node.rect, s), id});
+        if (lit->second.empty()) byCoord.erase(lit);
+    }
+    order_.erase({node.rect.y, node.rect.x, id});
+    nodes_.erase(it);
+}
+
+void AdjacencyIndex::Move(uint64_t id, const CellRect& r) {
+    auto it = nodes_.find(id);
+    if (it != nodes_.end()) {
+        const CellRect& cur = it->second.rect;
+        if (cur.x == r.x && cur.y == r.y && cur.w == r.w && cur.h == r.h) return;
+    }
+    Remove(id);
+    Add(id, r);
+}
+
+bool AdjacencyIndex::SharedEdge(uint64_t id, TileSide side, int boardLimit, EdgeGroup& out) const {
+    auto it = nodes_.find(id);
+    if (it == nodes_.end()) return false;
+    const CellRect& r = it->second.rect;
+
+    out = EdgeGroup{};
+    out.vertical = IsVertical(side);
+    out.line = Coord(r, side);
+    out.lo = SpanLo(r, side);
+    out.hi = SpanHi(r, side);
+
+    // lati che finiscono / iniziano sulla linea
+    const TileSide endSide = out.vertical ? TileSide::Right : TileSide::Bottom;
+    const TileSide startSide = out.vertical ? TileSide::Left : TileSide::Top;
+
+    // chiusura: si allarga il tratto finche' qualche tile sulla linea lo sborda
+    for (;;) {
+        Overlapping(endSide, out.line, out.lo, out.hi, out.before);
+        Overlapping(startSide, out.line, out.lo, out.hi, out.after);
+        int lo = out.lo;
+        int hi = out.hi;
+        for (uint64_t n : out.before) {
+            const CellRect& o = nodes_.at(n).rect;
+            lo = std::min(lo, SpanLo(o, endSide));
+            hi = std::max(hi, SpanHi(o, endSide));
+        }
+        for (uint64_t n : out.after) {
+            const CellRect& o = nodes_.at(n).rect;
+            lo = std::min(lo, SpanLo(o, startSide));
+            hi = std::max(hi, SpanHi(o, startSide));
+        }
+        if (lo == out.lo && hi == out.hi) break;
+        out.lo = lo;
+        out.hi = hi;
+    }
+
+    auto along = [&](const CellRect& o) { return out.vertical ? o.w : o.h; };
+    out.minDelta = -out.line;
+    out.maxDelta = boardLimit > 0 ? boardLimit - out.line : INT_MAX;
+    for (uint64_t n : out.before) out.minDelta = std::max(out.minDelta, 1 - along(nodes_.at(n).rect));
+    for (uint64_t n : out.after) out.maxDelta = std::min(out.maxDelta, along(nodes_.at(n).rect) - 1);
+
+    // Dove c'e' solo il lato "before" la linea avanza nel vuoto (e viceversa):
+    // la prima tile estranea su quelle righe/colonne fa da ostacolo.
+    const int span = out.hi - out.lo;
+    std::vector<int> beforeOnly(span + 1, 0);
+    std::vector<int> afterOnly(span + 1, 0);
+    {
+        std::vector<int8_t> cover(span, 0); // bit 1: before, bit 2: after
+        for (uint64_t n : out.before) {
+            const CellRect& o = nodes_.at(n).rect;
+            for (int p = SpanLo(o, endSide); p < SpanHi(o, endSide); ++p) cover[p - out.lo] |= 1;
+        }
+        for (uint64_t n : out.after) {
+            const CellRect& o = nodes_.at(n).rect;
+            for (int p = SpanLo(o, startSide); p < SpanHi(o, startSide); ++p) cover[p - out.lo] |= 2;
+        }
+        for (int p = 0; p < span; ++p) {
+            beforeOnly[p + 1] = beforeOnly[p] + (cover[p] == 1);
+            afterOnly[p + 1] = afterOnly[p] + (cover[p] == 2);
+        }
+    }
+    auto count = [&](const std::vector<int>& prefix, int lo, int hi) {
+        lo = std::clamp(lo, out.lo, out.hi) - out.lo;
+        hi = std::clamp(hi, out.lo, out.hi) - out.lo;
+        return lo < hi ? prefix[hi] - prefix[lo] : 0;
+    };
+
+    for (const auto& [n, node] : nodes_) {
+        const CellRect& o = node.rect;
+        const int lo = SpanLo(o, endSide);
+        const int hi = SpanHi(o, endSide);
+        if (hi <= out.lo || lo >= out.hi) continue;
+        const int near = Coord(o, startSide);
+        const int far = Coord(o, endSide);
+        if (near > out.line && count(beforeOnly, lo, hi) > 0) out.maxDelta = std::min(out.maxDelta, near - out.line);
+        if (far < out.line && count(afterOnly, lo, hi) > 0) out.minDelta = std::max(out.minDelta, far - out.line);
+    }
+
+    out.minDelta = std::min(out.minDelta, 0);
+    out.maxDelta = std::max(out.maxDelta, 0);
+    return true;
+}
+
+uint64_t AdjacencyIndex::Closest(const std::vector<uint64_t>& ids, TileSide side, int ref) const {
+    // distanza di ref dal tratto del candidato lungo il lato; a parita' vince chi inizia prima
+    uint64_t best = 0;
+    int bestDist = INT_MAX;
+    int bestLo = INT_MAX;
+    for (uint64_t n : ids) {
+        const CellRect& o = nodes_.at(n).rect;
+        const int lo = SpanLo(o, side);
+        const int hi = SpanHi(o, side);
+        const int dist = ref < lo ? lo - ref : ref >= hi ? ref - hi + 1 : 0;
+        if (dist < bestDist || (dist == bestDist && lo < bestLo)) {
+            best = n;
+            bestDist = dist;
+            bestLo = lo;
+        }
+    }
+    return best;
+}
+
+uint64_t AdjacencyIndex::Nearest(uint64_t id, TileSide side, int ref) const {
+    auto it = nodes_.find(id);
+    if (it == nodes_.end()) return 0;
+    const Node& node = it->second;
+    if (!node.nbr[SideIndex(side)].empty()) return Closest(node.nbr[SideIndex(side)], side, ref);
+
+    // buco tra le tile: le linee dei lati opposti oltre il bordo, dalla piu' vicina
+    const CellRect& r = node.rect;
+    const int edge = Coord(r, side);
+    const int lo = SpanLo(r, side);
+    const int hi = SpanHi(r, side);
+    const auto& lines = lines_[SideIndex(Opposite(side))];
+    std::vector<uint64_t> hits;
+    if (side == TileSide::Right || side == TileSide::Bottom) {
+        for (auto lit = lines.upper_bound(edge); lit != lines.end(); ++lit) {
+            OverlappingLine(lit->second, lo, hi, hits);
+            if (!hits.empty()) return Closest(hits, side, ref);
+        }
+    } else {
+        for (auto lit = std::make_reverse_iterator(lines.lower_bound(edge)); lit != lines.rend(); ++lit) {
+            OverlappingLine(lit->second, lo, hi, hits);
+            if (!hits.empty()) return Closest(hits, side, ref);
+        }
+    }
+    return 0;
+}
+
+uint64_t AdjacencyIndex::NextInReadingOrder(uint64_t id, bool backwards) const {
+    auto it = nodes_.find(id);
+    if (it == nodes_.end() || order_.empty()) return 0;
+    auto pos = order_.find({it->second.rect.y, it->second.rect.x, id});
+    if (backwards) {
+        if (pos == order_.begin()) pos = order_.end();
+        return std::get<2>(*std::prev(pos));
+    }
+    ++pos;
+    if (pos == order_.end()) pos = order_.begin();
+    return std::get<2>(*pos);
+}
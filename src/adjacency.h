@@ -0,0 +1,78 @@
+#pragma once
+
+// Grafo delle adiacenze tra tile: due tile sono vicine se condividono un tratto
+// di bordo (non solo un angolo). Le tile sono indicizzate anche per "linea":
+// per ogni coordinata x (y) le tile che hanno li' il lato sinistro/destro
+// (alto/basso), ordinate lungo la linea. Aggiunta/rimozione costano
+// O(log n + vicini), senza confronti con tutte le altre tile.
+// Lo stesso indice risponde alla navigazione da tastiera (vicino in una
+// direzione, ordine di lettura).
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "layoutcheck.h" // CellRect
+
+enum class TileSide { Left, Right, Top, Bottom };
+
+// Tutte le tile che toccano una linea di bordo, collegate da tratti sovrapposti:
+// spostando la linea si muovono insieme (semantica dei tiling window manager).
+struct EdgeGroup {
+    bool vertical{true};          // linea verticale (lati Left/Right) o orizzontale (Top/Bottom)
+    int line{0};                  // coordinata della linea, in celle
+    int lo{0};                    // tratto coperto lungo la linea: [lo, hi)
+    int hi{0};
+    std::vector<uint64_t> before; // tile che finiscono sulla linea (a sinistra / sopra)
+    std::vector<uint64_t> after;  // tile che iniziano sulla linea (a destra / sotto)
+    int minDelta{0};              // spostamento ammesso della linea, in celle
+    int maxDelta{0};
+};
+
+class AdjacencyIndex {
+public:
+    void Clear();
+    void Add(uint64_t id, const CellRect& r);
+    void Remove(uint64_t id);
+    void Move(uint64_t id, const CellRect& r);
+
+    size_t Size() const { return nodes_.size(); }
+    const CellRect* Rect(uint64_t id) const;
+    // vicini che condividono un tratto del lato indicato (vuoto se id non esiste)
+    const std::vector<uint64_t>& Neighbors(uint64_t id, TileSide side) const;
+
+    // Gruppo del bordo `side` di id. boardLimit: estensione della board sull'asse
+    // perpendicolare alla linea (<= 0: senza limite). Ogni tile resta larga/alta
+    // almeno una cella e la linea non entra nelle tile fuori dal gruppo.
+    // Il calcolo dei limiti guarda tutte le tile: va fatto una volta a inizio drag.
+    bool SharedEdge(uint64_t id, TileSide side, int boardLimit, EdgeGroup& out) const;
+
+    // Tile piu' vicina oltre il lato `side`: prima i vicini diretti, se c'e' un buco
+    // la prima linea oltre il lato con una tile che si sovrappone al lato.
+    // ref: posizione lungo il lato (es. il centro) per scegliere tra piu' candidati.
+    // 0 se in quella direzione non c'e' nulla.
+    uint64_t Nearest(uint64_t id, TileSide side, int ref) const;
+    // Ordine di lettura (righe dall'alto, poi da sinistra), circolare. 0 se id non esiste.
+    uint64_t NextInReadingOrder(uint64_t id, bool backwards) const;
+
+private:
+    using Line = std::map<std::pair<int, uint64_t>, int>; // (inizio tratto, id) -> fine tratto
+
+    struct Node {
+        CellRect rect;
+        std::vector<uint64_t> nbr[4]; // per TileSide
+    };
+
+    void Overlapping(TileSide side, int coord, int lo, int hi, std::vector<uint64_t>& out) const;
+    void OverlappingLine(const Line& line, int lo, int hi, std::vector<uint64_t>& out) const;
+    uint64_t Closest(const std::vector<uint64_t>& ids, TileSide side, int ref) const;
+
+    using OrderKey = std::tuple<int, int, uint64_t>; // (y, x, id)
+
+    std::unordered_map<uint64_t, Node> nodes_;
+    std::map<int, Line> lines_[4]; // per TileSide: linea del lato di ciascuna tile
+    std::set<OrderKey> order_;
+};
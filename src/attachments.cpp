@@ -0,0 +1,353 @@
+#include "attachments.h"
+
+#include "imagecodec.h"
+#include "mappedfile.h"
+#include "sha256.h"
+#include "statefile.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+namespace {
+
+// richieste di miniature oltre queste: le piu' vecchie (tile uscite di vista) si lasciano perdere
+constexpr size_t kMaxWanted = 64;
+constexpr size_t kCopyChunk = size_t{1} << 20;
+
+std::string Hex(const std::array<uint8_t, 32>& digest) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string out(64, '0');
+    for (size_t i = 0; i < 32; ++i) {
+        out[i * 2] = kDigits[digest[i] >> 4];
+        out[i * 2 + 1] = kDigits[digest[i] & 15];
+    }
+    return out;
+}
+
+void Touch(const std::filesystem::path& path) {
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+}
+
+size_t ThumbBytes(const Thumb& t) { return sizeof(Thumb) + t.pixels.size() * sizeof(uint32_t); }
+
+ThumbPtr ToThumb(const Image& img) {
+    auto t = std::make_shared<Thumb>();
+    t->width = img.width;
+    t->height = img.height;
+    t->pixels.resize(static_cast<size_t>(img.width) * img.height);
+    const uint8_t* p = img.rgba.data();
+    for (uint32_t& px : t->pixels) {
+        px = (uint32_t{p[0]} << 16) | (uint32_t{p[1]} << 8) | p[2];
+        p += 4;
+    }
+    return t;
+}
+
+} // namespace
+
+bool IsBlobHash(std::string_view hash) {
+    return hash.size() == 64 && hash.find_first_not_of("0123456789abcdef") == std::string_view::npos;
+}
+
+bool BlobStore::Open(const std::filesystem::path& dir) {
+    dir_ = dir;
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    return std::filesystem::is_directory(dir_, ec);
+}
+
+std::filesystem::path BlobStore::PathOf(const std::string& hash) const {
+    // come i chunk della cronologia: 256 sottocartelle
+    return dir_ / hash.substr(0, 2) / hash.substr(2);
+}
+
+bool BlobStore::Has(const std::string& hash) const {
+    std::error_code ec;
+    return IsBlobHash(hash) && std::filesystem::is_regular_file(PathOf(hash), ec);
+}
+
+std::string BlobStore::Put(std::string_view bytes) {
+    std::string hash = Sha256Hex(bytes);
+    const std::filesystem::path path = PathOf(hash);
+    std::error_code ec;
+    if (std::filesystem::exists(path, ec)) {
+        Touch(path);
+        return hash;
+    }
+    std::filesystem::create_directories(path.parent_path(), ec);
+    return WriteFileAtomic(path, std::string(bytes)) ? hash : std::string();
+}
+
+std::string BlobStore::PutFile(const std::filesystem::path& file, uint64_t* size) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) return {};
+    // prima in un file temporaneo: il nome vero si sa solo alla fine
+    std::filesystem::path tmp = dir_ / ("incoming-" + std::to_string(nextTmp_++) + ".tmp");
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return {};
+
+    Sha256 sha;
+    std::vector<char> buf(kCopyChunk);
+    uint64_t total = 0;
+    while (in) {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        const std::streamsize n = in.gcount();
+        if (n <= 0) break;
+        sha.Update(buf.data(), static_cast<size_t>(n));
+        out.write(buf.data(), n);
+        total += static_cast<uint64_t>(n);
+    }
+    const bool ok = !in.bad() && static_cast<bool>(out.flush());
+    out.close();
+    std::error_code ec;
+    if (!ok) {
+        std::filesystem::remove(tmp, ec);
+        return {};
+    }
+
+    std::string hash = Hex(sha.Finish());
+    const std::filesystem::path path = PathOf(hash);
+    if (std::filesystem::exists(path, ec)) {
+        std::filesystem::remove(tmp, ec);
+        Touch(path);
+    } else {
+        std::filesystem::create_directories(path.parent_path(), ec);
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) {
+            std::filesystem::remove(tmp, ec);
+            return {};
+        }
+    }
+    if (size) *size = total;
+    return hash;
+}
+
+size_t BlobStore::Sweep(const std::unordered_set<std::string>& live, std::chrono::seconds minAge) {
+    const auto cutoff = std::filesystem::file_time_type::clock::now() - minAge;
+    size_t removed = 0;
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        const std::string hash = it->path().parent_path().filename().string() + it->path().filename().string();
+        if (IsBlobHash(hash) && live.count(hash)) continue;
+        std::error_code timeEc;
+        const auto written = it->last_write_time(timeEc);
+        if (timeEc || written > cutoff) continue; // anche i .tmp: magari una copia in corso
+        std::error_code rmEc;
+        if (std::filesystem::remove(it->path(), rmEc)) ++removed;
+    }
+    return removed;
+}
+
+int ThumbCache::ThumbSide(int px) {
+    static constexpr int kSides[] = {48, 64, 96, 128, 192, 256, 384, 512, 768, 1024};
+    for (int side : kSides) {
+        if (px <= side) return side;
+    }
+    return kSides[std::size(kSides) - 1]; // oltre si allarga quella: una tile enorme non tiene una bitmap enorme
+}
+
+bool ThumbCache::Open(const BlobStore* blobs, const std::filesystem::path& dir, size_t maxBytes, uint32_t background) {
+    blobs_ = blobs;
+    dir_ = dir;
+    background_ = background;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxBytes_ = maxBytes;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    return std::filesystem::is_directory(dir_, ec);
+}
+
+ThumbPtr ThumbCache::Get(const std::string& hash, int side, bool* failed) {
+    if (failed) *failed = false;
+    const std::string key = Key(hash, side);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        order_.splice(order_.begin(), order_, it->second.order);
+        ++stats_.hits;
+        return it->second.thumb;
+    }
+    if (failed_.count(hash)) {
+        if (failed) *failed = true;
+        return nullptr;
+    }
+    ++stats_.misses;
+    if (wantedSet_.insert(key).second) {
+        wanted_.emplace_back(hash, side);
+        if (wanted_.size() > kMaxWanted) {
+            wantedSet_.erase(Key(wanted_.front().first, wanted_.front().second));
+            wanted_.pop_front();
+        }
+    } else {
+        // gia' in coda: torna in fondo, e' ancora in vista
+        for (auto w = wanted_.begin(); w != wanted_.end(); ++w) {
+            if (w->first == hash && w->second == side) {
+                std::rotate(w, w + 1, wanted_.end());
+                break;
+            }
+        }
+    }
+    wake_.notify_one();
+    return nullptr;
+}
+
+ThumbPtr ThumbCache::Load(const std::string& hash, int side) {
+    if (!IsBlobHash(hash) || !blobs_) return nullptr;
+    const std::filesystem::path reduced = dir_ / (Key(hash, side) + ".png");
+    std::string bytes;
+    Image img;
+    if (ReadWholeFile(reduced, bytes) && DecodeImage(bytes, img)) {
+        Touch(reduced); // TrimDisk toglie prima quelle non usate da piu' tempo
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.diskHits;
+        return ToThumb(img);
+    }
+
+    // l'originale si legge mappato: niente copia, e le righe non servono tutte insieme
+    MappedFile blob;
+    const bool ok = blob.Open(blobs_->PathOf(hash)) &&
+                    MakeThumbnail(std::string_view(reinterpret_cast<const char*>(blob.Data()), blob.Size()), side, background_, img);
+    blob.Close();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++(ok ? stats_.decodes : stats_.failures);
+    }
+    if (!ok) return nullptr;
+    WriteFileAtomic(reduced, EncodePng(img)); // se non si scrive si rifara' la prossima volta
+    return ToThumb(img);
+}
+
+void ThumbCache::Insert(const std::string& key, ThumbPtr thumb) {
+    // col lock preso
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        bytes_ -= ThumbBytes(*it->second.thumb);
+        order_.erase(it->second.order);
+        entries_.erase(it);
+    }
+    bytes_ += ThumbBytes(*thumb);
+    order_.push_front(key);
+    entries_[key] = Entry{std::move(thumb), order_.begin()};
+    // la piu' recente resta anche se da sola supera il tetto: e' quella che si sta guardando
+    while (bytes_ > maxBytes_ && order_.size() > 1) {
+        auto victim = entries_.find(order_.back());
+        bytes_ -= ThumbBytes(*victim->second.thumb);
+        entries_.erase(victim);
+        order_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+size_t ThumbCache::TrimDisk(const std::unordered_set<std::string>& live, uint64_t maxBytes) {
+    struct File {
+        std::filesystem::file_time_type used;
+        uint64_t size;
+        std::filesystem::path path;
+    };
+    std::vector<File> files;
+    uint64_t total = 0;
+    size_t removed = 0;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        const std::string name = it->path().filename().string();
+        std::error_code rmEc;
+        if (it->path().extension() != ".png" || name.size() < 64 || !live.count(name.substr(0, 64))) {
+            if (std::filesystem::remove(it->path(), rmEc)) ++removed;
+            continue;
+        }
+        std::error_code infoEc;
+        File f{it->last_write_time(infoEc), it->file_size(infoEc), it->path()};
+        if (infoEc) continue;
+        total += f.size;
+        files.push_back(std::move(f));
+    }
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.used < b.used; });
+    for (const File& f : files) {
+        if (total <= maxBytes) break;
+        std::error_code rmEc;
+        if (!std::filesystem::remove(f.path, rmEc)) continue;
+        total -= f.size;
+        ++removed;
+    }
+    return removed;
+}
+
+void ThumbCache::Forget(const std::string& hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_.erase(hash);
+}
+
+ThumbStats ThumbCache::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ThumbStats s = stats_;
+    s.items = entries_.size();
+    s.bytes = bytes_;
+    s.maxBytes = maxBytes_;
+    return s;
+}
+
+void ThumbCache::Start(std::function<void()> onReady) {
+    if (thread_.joinable()) return;
+    onReady_ = std::move(onReady);
+    stopping_ = false;
+    thread_ = std::thread([this] { Loop(); });
+}
+
+void ThumbCache::Post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void ThumbCache::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        wanted_.clear();
+        wantedSet_.clear();
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) thread_.join();
+}
+
+void ThumbCache::Loop() {
+    for (;;) {
+        std::function<void()> job;
+        std::pair<std::string, int> want;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !jobs_.empty() || !wanted_.empty(); });
+            if (!jobs_.empty()) {
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            } else if (stopping_) {
+                return;
+            } else {
+                want = std::move(wanted_.back());
+                wanted_.pop_back();
+            }
+        }
+        if (job) {
+            job();
+            continue;
+        }
+
+        ThumbPtr thumb = Load(want.first, want.second);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const std::string key = Key(want.first, want.second);
+            wantedSet_.erase(key);
+            if (thumb) Insert(key, std::move(thumb));
+            else failed_.insert(want.first);
+        }
+        if (onReady_) onReady_();
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+// Allegati delle tile: immagini incollate o trascinate e file qualunque.
+//
+// I byte stanno in uno store indirizzato per contenuto (SHA-256, come i chunk della
+// cronologia) sotto <stato>/blobs: lo stesso file allegato piu' volte, anche in tile
+// diverse, c'e' una volta sola. state.json tiene solo hash, nome, dimensione e misure
+// dell'immagine: avvio e salvataggio non aprono mai un allegato, qualunque sia il volume.
+//
+// Miniature: per ogni immagine e lato (a scalini, vedi ThumbSide) un PNG gia' ridotto
+// sotto <stato>/thumbs, fatto la prima volta che serve e poi solo riletto. In memoria le
+// miniature decodificate stanno in una LRU con un tetto in byte. Chi disegna chiede solo
+// quelle delle tile in vista e non aspetta mai: quelle che mancano si preparano su un
+// thread a parte (prima le ultime chieste: sono quelle ancora in vista) e poi onReady.
+//
+// Gli allegati restano su questo dispositivo: la sincronizzazione e la cartella Markdown
+// portano solo le note, e una tile arrivata da fuori mostra l'allegato come mancante.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+struct Attachment {
+    std::string hash; // SHA-256 esadecimale dei byte
+    std::string name; // nome del file originale (UTF-8), per mostrarlo e per riaprirlo
+    uint64_t size{0};
+    int width{0}; // immagini (PNG, BMP): pixel; 0 = file qualunque
+    int height{0};
+};
+
+bool IsBlobHash(std::string_view hash);
+
+class BlobStore {
+public:
+    bool Open(const std::filesystem::path& dir);
+
+    // Put e PutFile: hash del contenuto, vuoto se la scrittura fallisce. Un blob che c'e'
+    // gia' non si riscrive (ma conta come appena usato: vedi Sweep).
+    std::string Put(std::string_view bytes);
+    // copiato a pezzi, con l'hash calcolato mentre si copia: file grandi senza tenerli in memoria
+    std::string PutFile(const std::filesystem::path& file, uint64_t* size = nullptr);
+
+    // da qualunque thread
+    bool Has(const std::string& hash) const;
+    std::filesystem::path PathOf(const std::string& hash) const;
+
+    // via i blob fuori da live e non usati da almeno minAge: un allegato appena tolto puo'
+    // tornare (un file di stato unito da fuori, una tile ripristinata a mano). Ritorna quanti.
+    size_t Sweep(const std::unordered_set<std::string>& live, std::chrono::seconds minAge);
+
+private:
+    std::filesystem::path dir_;
+    uint64_t nextTmp_{0};
+};
+
+// 0x00RRGGBB, righe dall'alto: un DIB a 32 bit cosi' com'e'
+struct Thumb {
+    int width{0};
+    int height{0};
+    std::vector<uint32_t> pixels;
+};
+using ThumbPtr = std::shared_ptr<const Thumb>;
+
+struct ThumbStats {
+    size_t items{0}; // in memoria
+    size_t bytes{0};
+    size_t maxBytes{0};
+    uint64_t hits{0};     // Get trovate in memoria
+    uint64_t misses{0};   // Get messe in coda
+    uint64_t diskHits{0}; // Load dal PNG gia' ridotto
+    uint64_t decodes{0};  // Load dall'immagine originale
+    uint64_t failures{0}; // blob mancanti o immagini che non si leggono
+    uint64_t evictions{0};
+};
+
+class ThumbCache {
+public:
+    ThumbCache() = default;
+    ~ThumbCache() { Stop(); }
+    ThumbCache(const ThumbCache&) = delete;
+    ThumbCache& operator=(const ThumbCache&) = delete;
+
+    // lato da preparare per una casella di px (il lato lungo): scalini, cosi' uno zoom
+    // o una tile ridimensionata non rifanno le miniature a ogni pixel
+    static int ThumbSide(int px);
+
+    // prima di Start; background 0xRRGGBB: le immagini trasparenti si compongono su questo
+    bool Open(const BlobStore* blobs, const std::filesystem::path& dir, size_t maxBytes, uint32_t background);
+
+    // Dalla memoria, segnata come appena usata. Se manca: nullptr e la richiesta va in coda,
+    // oppure failed = true se si e' gia' visto che non si puo' fare.
+    ThumbPtr Get(const std::string& hash, int side, bool* failed = nullptr);
+    // sincrona, sul thread che chiama: il PNG ridotto, o l'originale ridotto e poi salvato.
+    // nullptr se il blob manca o l'immagine non si legge.
+    ThumbPtr Load(const std::string& hash, int side);
+
+    // il blob e' appena arrivato (di nuovo): se prima mancava, si riprova
+    void Forget(const std::string& hash);
+
+    // PNG ridotti di blob fuori da live, poi i meno usati finche' il totale sta in maxBytes
+    size_t TrimDisk(const std::unordered_set<std::string>& live, uint64_t maxBytes);
+
+    ThumbStats Stats() const;
+
+    // onReady(): una miniatura chiesta e' pronta (dal thread delle miniature)
+    void Start(std::function<void()> onReady);
+    // lavoro qualunque sullo stesso thread, prima delle miniature (allegare un file, pulizie)
+    void Post(std::function<void()> job);
+    void Stop(); // finisce i lavori, lascia perdere le miniature in coda
+
+private:
+    struct Entry {
+        ThumbPtr thumb;
+        std::list<std::string>::iterator order;
+    };
+
+    static std::string Key(const std::string& hash, int side) { return hash + "-" + std::to_string(side); }
+    void Insert(const std::string& key, ThumbPtr thumb);
+    void Loop();
+
+    const BlobStore* blobs_{nullptr};
+    std::filesystem::path dir_;
+    uint32_t background_{0};
+
+    mutable std::mutex mutex_; // tutto quello che segue
+    size_t maxBytes_{0};
+    size_t bytes_{0};
+    std::list<std::string> order_; // chiavi, dalla piu' recente
+    std::unordered_map<std::string, Entry> entries_;
+    std::unordered_set<std::string> failed_;
+    std::deque<std::pair<std::string, int>> wanted_; // chieste e non ancora pronte, l'ultima in fondo
+    std::unordered_set<std::string> wantedSet_;      // le loro chiavi
+    std::deque<std::function<void()>> jobs_;
+    ThumbStats stats_;
+
+    std::function<void()> onReady_;
+    std::thread thread_;
+    std::condition_variable wake_;
+    bool stopping_{false};
+};
@@ -0,0 +1,180 @@
+#include "autofit.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "textutil.h" // ContentHash64
+
+namespace {
+
+struct Span {
+    size_t begin;
+    size_t length;
+    uint64_t hash;
+};
+
+// paragrafi di text[begin, end) separati da '\n' (end e' la fine o un '\n'); il '\r' prima dell'a capo non ne fa parte
+void SplitParagraphs(std::wstring_view text, size_t begin, size_t end, std::vector<Span>& out) {
+    for (;;) {
+        const size_t nl = text.find(L'\n', begin);
+        const bool last = nl == std::wstring_view::npos || nl >= end;
+        const size_t stop = last ? end : nl;
+        size_t length = stop - begin;
+        if (stop < text.size() && length > 0 && text[begin + length - 1] == L'\r') --length; // stop e' sempre un '\n' o la fine
+        out.push_back(Span{begin, length, ContentHash64(text.data() + begin, length * sizeof(wchar_t))});
+        if (last) break;
+        begin = nl + 1;
+    }
+}
+
+} // namespace
+
+size_t ParagraphHeightCache::KeyHash::operator()(const Key& k) const {
+    uint64_t h = k.hash ^ (static_cast<uint64_t>(k.length) << 32);
+    h ^= (static_cast<uint64_t>(static_cast<uint32_t>(k.fontPx)) << 16) ^ static_cast<uint32_t>(k.width);
+    h *= 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+ParagraphHeightCache::ParagraphHeightCache(ParagraphMeasureFn measure, size_t maxEntries)
+    : measure_(std::move(measure)), maxEntries_(std::max<size_t>(1, maxEntries)) {}
+
+int ParagraphHeightCache::Height(std::wstring_view paragraph, uint64_t hash, int fontPx, int width) {
+    const Key key{hash, static_cast<uint32_t>(paragraph.size()), fontPx, width};
+    auto it = heights_.find(key);
+    if (it != heights_.end()) return it->second;
+
+    // niente LRU: quando e' piena si riparte, le tile aperte si ripopolano alla prossima misura
+    if (heights_.size() >= maxEntries_) heights_.clear();
+    const int h = std::max(0, measure_(paragraph, fontPx, width));
+    ++measured_;
+    heights_.emplace(key, h);
+    return h;
+}
+
+void ParagraphHeightCache::Clear() { heights_.clear(); }
+
+void FitLayout::SetText(std::wstring_view text) {
+    std::vector<Span> spans;
+    SplitParagraphs(text, 0, text.size(), spans);
+
+    Paragraph blank;
+    blank.height.fill(-1);
+    paras_.assign(spans.size(), blank);
+    for (size_t i = 0; i < spans.size(); ++i) {
+        paras_[i].begin = spans[i].begin;
+        paras_[i].length = spans[i].length;
+        paras_[i].hash = spans[i].hash;
+    }
+    complete_.fill(false);
+    pending_.clear();
+    textSize_ = text.size();
+}
+
+void FitLayout::ApplyEdit(std::wstring_view text, const TextEdit& e) {
+    if (paras_.empty() || e.at + e.removed > textSize_ || text.size() != textSize_ - e.removed + e.inserted) {
+        SetText(text); // fuori sincrono col testo di prima
+        return;
+    }
+
+    // paragrafi vecchi toccati: da quello che contiene at a quello che contiene la fine del tratto tolto
+    auto containing = [&](size_t pos) {
+        auto it = std::upper_bound(paras_.begin(), paras_.end(), pos, [](size_t v, const Paragraph& p) { return v < p.begin; });
+        return static_cast<size_t>(it - paras_.begin()) - 1;
+    };
+    const size_t first = containing(e.at);
+    const size_t last = containing(e.at + e.removed);
+    const ptrdiff_t delta = static_cast<ptrdiff_t>(e.inserted) - static_cast<ptrdiff_t>(e.removed);
+
+    // il '\n' che chiude last sta nel suffisso invariato: si risegmenta solo fino a li'
+    const size_t regionBegin = paras_[first].begin;
+    const size_t regionEnd = last + 1 < paras_.size() ? static_cast<size_t>(static_cast<ptrdiff_t>(paras_[last + 1].begin - 1) + delta) : text.size();
+    std::vector<Span> spans;
+    SplitParagraphs(text, regionBegin, regionEnd, spans);
+
+    const size_t removed = last - first + 1;
+    const size_t added = spans.size();
+    for (size_t i = first; i <= last; ++i) {
+        for (size_t s = 0; s < kFontLadderSize; ++s) {
+            if (complete_[s] && paras_[i].height[s] >= 0) total_[s] -= paras_[i].height[s];
+        }
+    }
+
+    Paragraph blank;
+    blank.height.fill(-1);
+    if (added > removed) paras_.insert(paras_.begin() + first, added - removed, blank);
+    else paras_.erase(paras_.begin() + first, paras_.begin() + first + (removed - added));
+    for (size_t i = 0; i < added; ++i) {
+        Paragraph& p = paras_[first + i];
+        p.begin = spans[i].begin;
+        p.length = spans[i].length;
+        p.hash = spans[i].hash;
+        p.height.fill(-1);
+    }
+    for (size_t i = first + added; i < paras_.size(); ++i) paras_[i].begin = static_cast<size_t>(static_cast<ptrdiff_t>(paras_[i].begin) + delta);
+    textSize_ = text.size();
+
+    // indici in attesa: via quelli tolti, spostati quelli dopo, aggiunti i nuovi
+    size_t kept = 0;
+    for (uint32_t i : pending_) {
+        if (i < first) pending_[kept++] = i;
+        else if (i > last) pending_[kept++] = static_cast<uint32_t>(i - removed + added);
+    }
+    pending_.resize(kept);
+    for (size_t i = first; i < first + added; ++i) pending_.push_back(static_cast<uint32_t>(i));
+}
+
+void FitLayout::SetWidth(int width) {
+    if (width == width_) return;
+    width_ = width;
+    complete_.fill(false);
+    pending_.clear();
+    for (auto& p : paras_) p.height.fill(-1);
+}
+
+int64_t FitLayout::TotalHeight(std::wstring_view text, size_t sizeIdx, ParagraphHeightCache& cache) {
+    auto measure = [&](Paragraph& p) {
+        if (p.height[sizeIdx] < 0) p.height[sizeIdx] = cache.Height(text.substr(p.begin, p.length), p.hash, kFontLadderPx[sizeIdx], width_);
+        return p.height[sizeIdx];
+    };
+
+    if (!complete_[sizeIdx]) {
+        total_[sizeIdx] = 0;
+        for (auto& p : paras_) total_[sizeIdx] += measure(p);
+        complete_[sizeIdx] = true;
+        return total_[sizeIdx];
+    }
+
+    if (pending_.empty()) return total_[sizeIdx];
+    for (uint32_t i : pending_) {
+        if (paras_[i].height[sizeIdx] < 0) total_[sizeIdx] += measure(paras_[i]);
+    }
+    // un paragrafo esce dall'attesa quando tutte le dimensioni complete lo hanno misurato
+    pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+                                  [&](uint32_t i) {
+                                      for (size_t s = 0; s < kFontLadderSize; ++s) {
+                                          if (complete_[s] && paras_[i].height[s] < 0) return false;
+                                      }
+                                      return true;
+                                  }),
+                   pending_.end());
+    return total_[sizeIdx];
+}
+
+int FitLayout::Fit(std::wstring_view text, int height, int maxPx, ParagraphHeightCache& cache) {
+    // le altezze crescono col font: ricerca binaria sul ladder
+    int lo = 0;
+    int hi = static_cast<int>(std::upper_bound(kFontLadderPx.begin(), kFontLadderPx.end(), maxPx) - kFontLadderPx.begin()) - 1;
+    hi = std::max(hi, 0);
+    int best = -1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        if (TotalHeight(text, mid, cache) <= height) {
+            best = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Font ad adattamento automatico: per una tile si cerca la dimensione piu' grande
+// del ladder a cui il testo sta nell'altezza disponibile. Le altezze si misurano
+// per paragrafo (cache condivisa per hash, dimensione e larghezza) e per ogni
+// dimensione si tiene il totale della tile: una modifica rimisura solo i paragrafi
+// cambiati e la ricerca binaria sul ladder lavora su somme gia' pronte.
+// La misura vera (DrawTextW) sta in main.cpp; qui si passa una funzione, cosi'
+// l'algoritmo gira anche con metriche sintetiche.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "textutil.h" // TextEdit
+
+// altezze in px (lfHeight negativo), crescenti
+constexpr std::array<int, 16> kFontLadderPx = {8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 20, 22, 24, 28, 32};
+constexpr size_t kFontLadderSize = kFontLadderPx.size();
+
+// altezza in px di un paragrafo (senza a capo; vuoto = una riga) a quel font e larghezza
+using ParagraphMeasureFn = std::function<int(std::wstring_view paragraph, int fontPx, int width)>;
+
+class ParagraphHeightCache {
+public:
+    explicit ParagraphHeightCache(ParagraphMeasureFn measure, size_t maxEntries = 1 << 16);
+
+    int Height(std::wstring_view paragraph, uint64_t hash, int fontPx, int width);
+    void Clear(); // da chiamare se cambia il font di base
+    size_t Measured() const { return measured_; } // misure vere fatte finora
+
+private:
+    struct Key {
+        uint64_t hash;
+        uint32_t length;
+        int fontPx;
+        int width;
+        bool operator==(const Key& o) const { return hash == o.hash && length == o.length && fontPx == o.fontPx && width == o.width; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const;
+    };
+
+    ParagraphMeasureFn measure_;
+    size_t maxEntries_;
+    size_t measured_{0};
+    std::unordered_map<Key, int, KeyHash> heights_;
+};
+
+// Stato di una tile. Tiene solo offset nel testo: Fit e TotalHeight vogliono lo
+// stesso testo passato all'ultima SetText/ApplyEdit.
+class FitLayout {
+public:
+    void SetText(std::wstring_view text);                     // da zero
+    void ApplyEdit(std::wstring_view text, const TextEdit& e); // text e' gia' quello nuovo
+    void SetWidth(int width);                                  // larghezza diversa: tutte le altezze da rifare
+
+    // indice nel ladder della dimensione piu' grande (fino a maxPx) con altezza <= height;
+    // -1 se non basta nemmeno la piu' piccola
+    int Fit(std::wstring_view text, int height, int maxPx, ParagraphHeightCache& cache);
+    int64_t TotalHeight(std::wstring_view text, size_t sizeIdx, ParagraphHeightCache& cache);
+
+    size_t ParagraphCount() const { return paras_.size(); }
+
+private:
+    struct Paragraph {
+        size_t begin{0};
+        size_t length{0};
+        uint64_t hash{0};
+        std::array<int, kFontLadderSize> height; // -1: da misurare
+    };
+
+    std::vector<Paragraph> paras_;
+    // Una dimensione "completa" ha il totale aggiornato: le manca solo qualche paragrafo
+    // di pending_. Le altre (mai chiesta, larghezza cambiata) si sommano da zero alla prima richiesta.
+    std::array<bool, kFontLadderSize> complete_{};
+    std::array<int64_t, kFontLadderSize> total_{};
+    std::vector<uint32_t> pending_; // paragrafi nuovi dall'ultima misura delle dimensioni complete
+    size_t textSize_{0};
+    int width_{-1};
+};
@@ -0,0 +1,156 @@
+#include "collision.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_set>
+
+namespace {
+
+// divisione per difetto anche per coordinate negative
+int FloorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+uint64_t BucketKey(int bx, int by) { return (static_cast<uint64_t>(static_cast<uint32_t>(bx)) << 32) | static_cast<uint32_t>(by); }
+
+bool Overlaps(const CellRect& a, const CellRect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+CellRect Shifted(const CellRect& r, int dx, int dy) { return CellRect{r.x + dx, r.y + dy, r.w, r.h}; }
+
+// celle in cui r entra spostandosi di un passo (dx, dy)
+CellRect EnteredStrip(const CellRect& r, int dx, int dy) {
+    if (dx > 0) return CellRect{r.x + r.w, r.y, 1, r.h};
+    if (dx < 0) return CellRect{r.x - 1, r.y, 1, r.h};
+    if (dy > 0) return CellRect{r.x, r.y + r.h, r.w, 1};
+    return CellRect{r.x, r.y - 1, r.w, 1};
+}
+
+bool InsideBoard(const CellRect& r, int boardW, int boardH) {
+    return r.x >= 0 && r.y >= 0 && r.x + r.w <= boardW && r.y + r.h <= boardH;
+}
+
+// Un passo di una cella. Con push le tile colpite si spostano insieme (chiusura sulla
+// striscia di ingresso di ciascuna); se una qualsiasi uscirebbe dalla board non si muove nulla.
+bool Step(TileGrid& grid, uint64_t id, int dx, int dy, bool push, int boardW, int boardH, TileMoves& moved) {
+    std::vector<uint64_t> group{id};
+    std::unordered_set<uint64_t> inGroup{id};
+    std::vector<uint64_t> hits;
+
+    for (size_t i = 0; i < group.size(); ++i) {
+        const CellRect& r = *grid.Rect(group[i]);
+        if (!InsideBoard(Shifted(r, dx, dy), boardW, boardH)) return false;
+        grid.Query(EnteredStrip(r, dx, dy), group[i], hits);
+        for (uint64_t h : hits) {
+            if (!push) return false;
+            if (inGroup.insert(h).second) group.push_back(h);
+        }
+    }
+
+    for (uint64_t g : group) {
+        const CellRect next = Shifted(*grid.Rect(g), dx, dy);
+        grid.Move(g, next);
+        moved.push_back({g, next});
+    }
+    return true;
+}
+
+} // namespace
+
+template <typename Fn>
+void TileGrid::ForEachBucket(const CellRect& r, Fn&& fn) const {
+    const int bx0 = FloorDiv(r.x, kBucketCells);
+    const int by0 = FloorDiv(r.y, kBucketCells);
+    const int bx1 = FloorDiv(r.x + r.w - 1, kBucketCells);
+    const int by1 = FloorDiv(r.y + r.h - 1, kBucketCells);
+    for (int by = by0; by <= by1; ++by) {
+        for (int bx = bx0; bx <= bx1; ++bx) fn(BucketKey(bx, by));
+    }
+}
+
+void TileGrid::Clear() {
+    rects_.clear();
+    buckets_.clear();
+}
+
+void TileGrid::Insert(uint64_t id, const CellRect& r) {
+    if (rects_.count(id)) Remove(id);
+    rects_[id] = r;
+    ForEachBucket(r, [&](uint64_t key) { buckets_[key].push_back(id); });
+}
+
+void TileGrid::Remove(uint64_t id) {
+    auto it = rects_.find(id);
+    if (it == rects_.end()) return;
+    ForEachBucket(it->second, [&](uint64_t key) {
+        auto b = buckets_.find(key);
+        if (b == buckets_.end()) return;
+        auto& v = b->second;
+        auto pos = std::find(v.begin(), v.end(), id);
+        if (pos != v.end()) {
+            *pos = v.back();
+            v.pop_back();
+        }
+        if (v.empty()) buckets_.erase(b);
+    });
+    rects_.erase(it);
+}
+
+void TileGrid::Move(uint64_t id, const CellRect& r) {
+    auto it = rects_.find(id);
+    if (it != rects_.end() && it->second.x == r.x && it->second.y == r.y && it->second.w == r.w && it->second.h == r.h) return;
+    Remove(id);
+    Insert(id, r);
+}
+
+const CellRect* TileGrid::Rect(uint64_t id) const {
+    auto it = rects_.find(id);
+    return it == rects_.end() ? nullptr : &it->second;
+}
+
+void TileGrid::Query(const CellRect& r, uint64_t ignore, std::vector<uint64_t>& out) const {
+    out.clear();
+    if (r.w <= 0 || r.h <= 0) return;
+    ForEachBucket(r, [&](uint64_t key) {
+        auto b = buckets_.find(key);
+        if (b == buckets_.end()) return;
+        for (uint64_t id : b->second) {
+            if (id != ignore && Overlaps(rects_.at(id), r)) out.push_back(id);
+        }
+    });
+    // una tile su piu' bucket compare piu' volte
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void MoveTileToward(TileGrid& grid, uint64_t id, int targetX, int targetY, bool push, int boardW, int boardH, TileMoves& moved) {
+    bool blockedX = false;
+    bool blockedY = false;
+    for (;;) {
+        const CellRect* r = grid.Rect(id);
+        if (!r) return;
+        const int dx = targetX > r->x ? 1 : targetX < r->x ? -1 : 0;
+        const int dy = targetY > r->y ? 1 : targetY < r->y ? -1 : 0;
+        const bool tryX = dx != 0 && !blockedX;
+        const bool tryY = dy != 0 && !blockedY;
+        if (!tryX && !tryY) return;
+
+        // un passo per asse a giro: la tile segue la diagonale e aggira gli spigoli
+        if (tryX && !Step(grid, id, dx, 0, push, boardW, boardH, moved)) blockedX = true;
+        else if (tryX) blockedY = false;
+        if (tryY && !Step(grid, id, 0, dy, push, boardW, boardH, moved)) blockedY = true;
+        else if (tryY) blockedX = false;
+    }
+}
+
+bool SwapTiles(TileGrid& grid, uint64_t a, uint64_t b, TileMoves& moved) {
+    const CellRect* ra = grid.Rect(a);
+    const CellRect* rb = grid.Rect(b);
+    if (!ra || !rb || a == b) return false;
+    const CellRect first = *ra;
+    const CellRect second = *rb;
+    grid.Move(a, second);
+    grid.Move(b, first);
+    moved.emplace_back(b, first);
+    moved.emplace_back(a, second);
+    return true;
+}
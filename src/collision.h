@@ -0,0 +1,45 @@
+#pragma once
+
+// Collisioni durante lo spostamento delle tile: broad phase a griglia uniforme
+// (bucket di kBucketCells x kBucketCells celle) e spostamento cella per cella.
+// Ogni passo controlla solo la striscia di celle in cui la tile entra, quindi
+// il costo dipende dalla tile e dai suoi vicini, non dal numero di tile.
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "layoutcheck.h" // CellRect
+
+class TileGrid {
+public:
+    static constexpr int kBucketCells = 8;
+
+    void Clear();
+    void Insert(uint64_t id, const CellRect& r);
+    void Remove(uint64_t id);
+    void Move(uint64_t id, const CellRect& r);
+
+    const CellRect* Rect(uint64_t id) const;
+    // tile che si sovrappongono a r, esclusa `ignore` (senza duplicati)
+    void Query(const CellRect& r, uint64_t ignore, std::vector<uint64_t>& out) const;
+
+private:
+    template <typename Fn>
+    void ForEachBucket(const CellRect& r, Fn&& fn) const;
+
+    std::unordered_map<uint64_t, CellRect> rects_;
+    std::unordered_map<uint64_t, std::vector<uint64_t>> buckets_; // (bx, by) impacchettati -> id
+};
+
+using TileMoves = std::vector<std::pair<uint64_t, CellRect>>; // (id, nuovo rettangolo)
+
+// Porta id verso (targetX, targetY) una cella alla volta, alternando gli assi.
+// push=false: si ferma davanti al primo ostacolo; push=true: spinge a catena le
+// tile incontrate, finche' la catena resta dentro la board.
+// La griglia viene aggiornata; moved riceve ogni spostamento in ordine di applicazione.
+void MoveTileToward(TileGrid& grid, uint64_t id, int targetX, int targetY, bool push, int boardW, int boardH, TileMoves& moved);
+// Scambia i rettangoli di a e b: le celle occupate restano le stesse, quindi un layout
+// valido resta valido anche con tile di dimensioni diverse. false se manca una delle due.
+bool SwapTiles(TileGrid& grid, uint64_t a, uint64_t b, TileMoves& moved);
@@ -0,0 +1,415 @@
+#include "crdtsync.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <system_error>
+
+namespace {
+
+// Formato delle righe (campi separati da uno spazio, il testo e' l'ultimo campo):
+//   T <tile> <counter> <replica> <originCounter> <originReplica> <testo>   inserimento
+//   D <tile> <counter> <replica> <lunghezza>                                cancellazione
+//   G <tile> <counter> <replica> <x> <y> <w> <h> <fit> <removed>            geometria
+// Il testo e' UTF-8 con \\, \n e \r preceduti da backslash.
+
+void AppendUtf8(std::string& out, char32_t c) {
+    if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) c = 0xFFFD;
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+void AppendEscaped(std::string& out, std::u32string_view text) {
+    for (char32_t c : text) {
+        if (c == U'\\') out += "\\\\";
+        else if (c == U'\n') out += "\\n";
+        else if (c == U'\r') out += "\\r";
+        else AppendUtf8(out, c);
+    }
+}
+
+// false se il testo non e' UTF-8 valido o ha escape sconosciuti
+bool Unescape(std::string_view in, std::u32string& out) {
+    out.clear();
+    for (size_t i = 0; i < in.size();) {
+        const unsigned char b = static_cast<unsigned char>(in[i]);
+        if (b == '\\') {
+            if (i + 1 >= in.size()) return false;
+            const char e = in[i + 1];
+            if (e == '\\') out += U'\\';
+            else if (e == 'n') out += U'\n';
+            else if (e == 'r') out += U'\r';
+            else return false;
+            i += 2;
+            continue;
+        }
+        int extra = b < 0x80 ? 0 : (b >> 5) == 0x6 ? 1 : (b >> 4) == 0xE ? 2 : (b >> 3) == 0x1E ? 3 : -1;
+        if (extra < 0 || i + extra >= in.size()) return false;
+        char32_t c = extra == 0 ? b : b & (0x3F >> extra);
+        for (int k = 1; k <= extra; ++k) {
+            const unsigned char cont = static_cast<unsigned char>(in[i + k]);
+            if ((cont & 0xC0) != 0x80) return false;
+            c = (c << 6) | (cont & 0x3F);
+        }
+        out += c;
+        i += extra + 1;
+    }
+    return true;
+}
+
+// campo successivo fino allo spazio; false se finito
+bool NextField(std::string_view& rest, std::string_view& field) {
+    if (rest.empty()) return false;
+    const size_t sp = rest.find(' ');
+    field = rest.substr(0, sp);
+    rest = sp == std::string_view::npos ? std::string_view{} : rest.substr(sp + 1);
+    return true;
+}
+
+template <typename T>
+bool NextNumber(std::string_view& rest, T& value) {
+    std::string_view field;
+    if (!NextField(rest, field) || field.empty()) return false;
+    const auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+    return ec == std::errc{} && end == field.data() + field.size();
+}
+
+void AppendNumbers(std::string& out, std::initializer_list<uint64_t> values) {
+    for (uint64_t v : values) {
+        out += ' ';
+        out += std::to_string(v);
+    }
+}
+
+} // namespace
+
+size_t SyncDoc::IdHash::operator()(const SyncId& id) const {
+    uint64_t h = id.counter * 0x9E3779B97F4A7C15ull ^ id.replica;
+    h ^= h >> 29;
+    return static_cast<size_t>(h * 0xBF58476D1CE4E5B9ull ^ (h >> 32));
+}
+
+SyncDoc::SyncDoc(uint64_t replica) : replica_(replica) {}
+
+void SyncDoc::SetText(uint64_t tile, std::u32string_view text, std::string& log) {
+    Sequence& seq = texts_[tile];
+    std::vector<int> visible;
+    for (int n = seq.head; n >= 0; n = seq.nodes[n].next) {
+        if (!seq.nodes[n].deleted) visible.push_back(n);
+    }
+
+    // tratto cambiato: prefisso e suffisso comuni
+    size_t prefix = 0;
+    const size_t common = std::min(visible.size(), text.size());
+    while (prefix < common && seq.nodes[visible[prefix]].ch == text[prefix]) ++prefix;
+    size_t suffix = 0;
+    while (suffix < common - prefix && seq.nodes[visible[visible.size() - 1 - suffix]].ch == text[text.size() - 1 - suffix]) ++suffix;
+    const size_t removed = visible.size() - prefix - suffix;
+    const size_t inserted = text.size() - prefix - suffix;
+    if (removed == 0 && inserted == 0) return;
+
+    // cancellazioni raggruppate per id consecutivi della stessa replica
+    SyncId runStart;
+    uint64_t runLength = 0;
+    auto flush = [&] {
+        if (runLength == 0) return;
+        log += 'D';
+        AppendNumbers(log, {tile, runStart.counter, runStart.replica, runLength});
+        log += '\n';
+        runLength = 0;
+    };
+    for (size_t i = prefix; i < prefix + removed; ++i) {
+        Node& n = seq.nodes[visible[i]];
+        n.deleted = true;
+        if (runLength > 0 && n.id.replica == runStart.replica && n.id.counter == runStart.counter + runLength) {
+            ++runLength;
+            continue;
+        }
+        flush();
+        runStart = n.id;
+        runLength = 1;
+    }
+    flush();
+
+    if (inserted > 0) {
+        Insert op{tile, SyncId{clock_ + 1, replica_}, prefix > 0 ? seq.nodes[visible[prefix - 1]].id : SyncId{},
+                  std::u32string(text.substr(prefix, inserted))};
+        log += 'T';
+        AppendNumbers(log, {tile, op.start.counter, op.start.replica, op.origin.counter, op.origin.replica});
+        log += ' ';
+        AppendEscaped(log, op.text);
+        log += '\n';
+        std::unordered_set<uint64_t> touched;
+        Integrate(std::move(op), touched);
+    }
+}
+
+void SyncDoc::SetGeometry(uint64_t tile, const SyncGeometry& g, std::string& log) {
+    auto it = geometry_.find(tile);
+    if (it != geometry_.end() && it->second.value == g) return;
+
+    const SyncId stamp{clock_ + 1, replica_};
+    SetRegister(tile, stamp, g);
+    log += 'G';
+    AppendNumbers(log, {tile, stamp.counter, stamp.replica});
+    log += ' ' + std::to_string(g.x) + ' ' + std::to_string(g.y) + ' ' + std::to_string(g.w) + ' ' + std::to_string(g.h);
+    log += g.autoFit ? " 1" : " 0";
+    log += g.removed ? " 1\n" : " 0\n";
+}
+
+void SyncDoc::Apply(std::string_view lines, std::unordered_set<uint64_t>& touched) {
+    while (!lines.empty()) {
+        const size_t nl = lines.find('\n');
+        std::string_view line = lines.substr(0, nl);
+        lines = nl == std::string_view::npos ? std::string_view{} : lines.substr(nl + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty()) ApplyLine(line, touched);
+    }
+}
+
+void SyncDoc::ApplyLine(std::string_view line, std::unordered_set<uint64_t>& touched) {
+    std::string_view kind;
+    if (!NextField(line, kind) || kind.size() != 1) return;
+
+    uint64_t tile = 0;
+    SyncId id;
+    if (!NextNumber(line, tile) || !NextNumber(line, id.counter) || !NextNumber(line, id.replica) || id.counter == 0) return;
+
+    if (kind[0] == 'T') {
+        Insert op{tile, id, SyncId{}, {}};
+        if (!NextNumber(line, op.origin.counter) || !NextNumber(line, op.origin.replica)) return;
+        if (!Unescape(line, op.text) || op.text.empty()) return;
+        Observe(id.counter + op.text.size() - 1);
+        Integrate(std::move(op), touched);
+    } else if (kind[0] == 'D') {
+        uint64_t length = 0;
+        if (!NextNumber(line, length) || length == 0 || length > (1u << 30)) return;
+        DeleteRun(tile, id, length, touched);
+    } else if (kind[0] == 'G') {
+        SyncGeometry g;
+        int fit = 0;
+        int removed = 0;
+        if (!NextNumber(line, g.x) || !NextNumber(line, g.y) || !NextNumber(line, g.w) || !NextNumber(line, g.h) || !NextNumber(line, fit) ||
+            !NextNumber(line, removed))
+            return;
+        g.autoFit = fit != 0;
+        g.removed = removed != 0;
+        Observe(id.counter);
+        if (SetRegister(tile, id, g)) touched.insert(tile);
+    }
+}
+
+void SyncDoc::Integrate(Insert op, std::unordered_set<uint64_t>& touched) {
+    // un inserimento puo' sbloccarne altri che aspettavano i suoi caratteri: coda invece di ricorsione
+    std::vector<Insert> ready;
+    ready.push_back(std::move(op));
+    while (!ready.empty()) {
+        Insert next = std::move(ready.back());
+        ready.pop_back();
+        if (InsertRun(next, ready)) touched.insert(next.tile);
+    }
+}
+
+bool SyncDoc::InsertRun(const Insert& op, std::vector<Insert>& ready) {
+    Sequence& seq = texts_[op.tile];
+    int prev = -1;
+    if (op.origin.counter != 0) {
+        auto it = seq.index.find(op.origin);
+        if (it == seq.index.end()) {
+            waiting_[op.origin].push_back(op);
+            return false;
+        }
+        prev = it->second;
+    }
+
+    for (size_t k = 0; k < op.text.size(); ++k) {
+        const SyncId id{op.start.counter + k, op.start.replica};
+        auto known = seq.index.find(id);
+        if (known != seq.index.end()) { // gia' ricevuto
+            prev = known->second;
+            continue;
+        }
+
+        // RGA: dopo l'origine si saltano i nodi piu' recenti (e con loro i loro discendenti)
+        int next = prev < 0 ? seq.head : seq.nodes[prev].next;
+        while (next >= 0 && id < seq.nodes[next].id) {
+            prev = next;
+            next = seq.nodes[next].next;
+        }
+
+        const int at = static_cast<int>(seq.nodes.size());
+        seq.nodes.push_back(Node{id, op.text[k], deletedEarly_.erase(id) > 0, next});
+        if (prev < 0) seq.head = at;
+        else seq.nodes[prev].next = at;
+        seq.index.emplace(id, at);
+        prev = at;
+        Observe(id.counter);
+
+        auto waiting = waiting_.find(id);
+        if (waiting != waiting_.end()) {
+            for (auto& w : waiting->second) ready.push_back(std::move(w));
+            waiting_.erase(waiting);
+        }
+    }
+    return true;
+}
+
+void SyncDoc::DeleteRun(uint64_t tile, SyncId start, uint64_t length, std::unordered_set<uint64_t>& touched) {
+    Sequence& seq = texts_[tile];
+    for (uint64_t k = 0; k < length; ++k) {
+        const SyncId id{start.counter + k, start.replica};
+        auto it = seq.index.find(id);
+        if (it == seq.index.end()) {
+            deletedEarly_.insert(id);
+            continue;
+        }
+        Node& n = seq.nodes[it->second];
+        if (n.deleted) continue;
+        n.deleted = true;
+        touched.insert(tile);
+    }
+}
+
+bool SyncDoc::SetRegister(uint64_t tile, SyncId stamp, const SyncGeometry& g) {
+    auto [it, added] = geometry_.try_emplace(tile, Register{stamp, g});
+    if (added) {
+        Observe(stamp.counter);
+        return true;
+    }
+    if (!(it->second.stamp < stamp)) return false; // piu' vecchio o ripetuto
+    it->second = Register{stamp, g};
+    Observe(stamp.counter);
+    return true;
+}
+
+const SyncGeometry* SyncDoc::Geometry(uint64_t tile) const {
+    auto it = geometry_.find(tile);
+    return it == geometry_.end() ? nullptr : &it->second.value;
+}
+
+std::u32string SyncDoc::Text(uint64_t tile) const {
+    std::u32string out;
+    auto it = texts_.find(tile);
+    if (it == texts_.end()) return out;
+    const Sequence& seq = it->second;
+    for (int n = seq.head; n >= 0; n = seq.nodes[n].next) {
+        if (!seq.nodes[n].deleted) out += seq.nodes[n].ch;
+    }
+    return out;
+}
+
+std::vector<uint64_t> SyncDoc::Tiles() const {
+    std::vector<uint64_t> out;
+    for (const auto& [id, reg] : geometry_) {
+        if (!reg.value.removed) out.push_back(id);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+size_t SyncDoc::Waiting() const {
+    size_t n = 0;
+    for (const auto& [id, list] : waiting_) n += list.size();
+    return n;
+}
+
+std::u32string WideToCodepoints(std::wstring_view s) {
+    std::u32string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        char32_t c = static_cast<char32_t>(s[i]);
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (c >= 0xD800 && c <= 0xDBFF && i + 1 < s.size() && s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<char32_t>(s[i + 1]) - 0xDC00);
+                ++i;
+            } else if (c >= 0xD800 && c <= 0xDFFF) {
+                c = 0xFFFD; // surrogato isolato
+            }
+        }
+        out += c;
+    }
+    return out;
+}
+
+std::wstring CodepointsToWide(std::u32string_view s) {
+    std::wstring out;
+    out.reserve(s.size());
+    for (char32_t c : s) {
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (c >= 0x10000) {
+                c -= 0x10000;
+                out += static_cast<wchar_t>(0xD800 + (c >> 10));
+                out += static_cast<wchar_t>(0xDC00 + (c & 0x3FF));
+                continue;
+            }
+        }
+        out += static_cast<wchar_t>(c);
+    }
+    return out;
+}
+
+bool SyncLog::Open(const std::filesystem::path& dir, uint64_t replica) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (!std::filesystem::is_directory(dir, ec)) return false;
+
+    char name[32];
+    const auto [end, err] = std::to_chars(name, name + sizeof(name), replica, 16);
+    dir_ = dir;
+    own_ = dir / (std::string(name, end) + ".ops");
+    offsets_.clear();
+    return true;
+}
+
+bool SyncLog::Append(const std::string& lines) {
+    if (lines.empty()) return true;
+    std::ofstream f(own_, std::ios::binary | std::ios::app);
+    if (!f) return false;
+    f.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+    f.flush();
+    if (!f) return false;
+    offsets_[own_.filename().wstring()] += lines.size();
+    return true;
+}
+
+std::string SyncLog::ReadNew() {
+    std::string out;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".ops" || !it->is_regular_file(ec)) continue;
+
+        const uint64_t size = it->file_size(ec);
+        if (ec) continue;
+        uint64_t& offset = offsets_[it->path().filename().wstring()];
+        if (size < offset) offset = 0; // sostituito da fuori: si rilegge, le righe ripetute non fanno danni
+        if (size == offset) continue;
+
+        std::ifstream f(it->path(), std::ios::binary);
+        if (!f) continue;
+        f.seekg(static_cast<std::streamoff>(offset));
+        std::string chunk(static_cast<size_t>(size - offset), '\0');
+        f.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        chunk.resize(static_cast<size_t>(f.gcount()));
+
+        // l'ultima riga puo' essere ancora in arrivo: si prende fino all'ultimo a capo
+        const size_t complete = chunk.rfind('\n');
+        if (complete == std::string::npos) continue;
+        chunk.resize(complete + 1);
+        offset += chunk.size();
+        out += chunk;
+    }
+    return out;
+}
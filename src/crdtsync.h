@@ -0,0 +1,121 @@
+#pragma once
+
+// Sincronizzazione tra dispositivi attraverso una cartella condivisa (Dropbox, OneDrive,
+// Syncthing...). Ogni replica scrive solo il proprio file <replica>.ops, in append, con
+// operazioni CRDT a stato delta, una per riga:
+// - testo di una tile: sequenza RGA, un nodo per code point con id (lamport, replica);
+//   inserimenti e cancellazioni viaggiano a tratti consecutivi
+// - geometria: registro last-writer-wins per id di tile (rimozione compresa)
+// Le righe si possono ricevere in qualunque ordine e piu' volte: un inserimento che
+// segue caratteri non ancora arrivati aspetta, una cancellazione di caratteri mai visti
+// si ricorda. Unire costa in base alle righe nuove, non alla dimensione della board.
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// id di un carattere o timestamp di un registro: ordine di Lamport, poi replica
+struct SyncId {
+    uint64_t counter{0}; // 0 = nessuno (inizio del testo)
+    uint64_t replica{0};
+
+    bool operator==(const SyncId& o) const { return counter == o.counter && replica == o.replica; }
+    bool operator<(const SyncId& o) const { return counter != o.counter ? counter < o.counter : replica < o.replica; }
+};
+
+struct SyncGeometry {
+    int x{0};
+    int y{0};
+    int w{1};
+    int h{1};
+    bool autoFit{false};
+    bool removed{false};
+
+    bool operator==(const SyncGeometry& o) const {
+        return x == o.x && y == o.y && w == o.w && h == o.h && autoFit == o.autoFit && removed == o.removed;
+    }
+};
+
+class SyncDoc {
+public:
+    explicit SyncDoc(uint64_t replica);
+    uint64_t Replica() const { return replica_; }
+
+    // Modifiche locali: applicate subito, le righe da appendere al proprio file finiscono
+    // in log. Nessuna riga se non cambia niente.
+    void SetText(uint64_t tile, std::u32string_view text, std::string& log);
+    void SetGeometry(uint64_t tile, const SyncGeometry& g, std::string& log);
+
+    // Righe complete di qualunque replica (anche la propria, al caricamento); le tile
+    // cambiate finiscono in touched. Righe ripetute o illeggibili sono ignorate.
+    void Apply(std::string_view lines, std::unordered_set<uint64_t>& touched);
+
+    const SyncGeometry* Geometry(uint64_t tile) const; // nullptr se mai vista
+    std::u32string Text(uint64_t tile) const;
+    std::vector<uint64_t> Tiles() const; // con geometria e non rimosse, in ordine di id
+    size_t Waiting() const;              // inserimenti in attesa di caratteri non ancora arrivati
+
+private:
+    struct IdHash {
+        size_t operator()(const SyncId& id) const;
+    };
+    struct Node {
+        SyncId id;
+        char32_t ch;
+        bool deleted;
+        int next; // lista concatenata nell'ordine del testo, -1 = fine
+    };
+    struct Sequence {
+        std::vector<Node> nodes;
+        int head{-1};
+        std::unordered_map<SyncId, int, IdHash> index;
+    };
+    struct Insert {
+        uint64_t tile;
+        SyncId start; // primo carattere; gli altri hanno counter consecutivi
+        SyncId origin;
+        std::u32string text;
+    };
+    struct Register {
+        SyncId stamp;
+        SyncGeometry value;
+    };
+
+    void ApplyLine(std::string_view line, std::unordered_set<uint64_t>& touched);
+    void Integrate(Insert op, std::unordered_set<uint64_t>& touched);
+    bool InsertRun(const Insert& op, std::vector<Insert>& ready); // false: origine non ancora arrivata
+    void DeleteRun(uint64_t tile, SyncId start, uint64_t length, std::unordered_set<uint64_t>& touched);
+    bool SetRegister(uint64_t tile, SyncId stamp, const SyncGeometry& g);
+    void Observe(uint64_t counter) { clock_ = counter > clock_ ? counter : clock_; }
+
+    uint64_t replica_;
+    uint64_t clock_{0};
+    std::unordered_map<uint64_t, Sequence> texts_;
+    std::unordered_map<uint64_t, Register> geometry_;
+    std::unordered_map<SyncId, std::vector<Insert>, IdHash> waiting_; // origine mancante -> inserimenti
+    std::unordered_set<SyncId, IdHash> deletedEarly_;                  // cancellati prima di arrivare
+};
+
+// Testo dell'app (UTF-16 su Windows) <-> code point del documento
+std::u32string WideToCodepoints(std::wstring_view s);
+std::wstring CodepointsToWide(std::u32string_view s);
+
+// I file *.ops della cartella: append sul proprio, lettura incrementale di tutti.
+class SyncLog {
+public:
+    bool Open(const std::filesystem::path& dir, uint64_t replica);
+    // da chiamare dopo la prima ReadNew, cosi' il proprio file non si rilegge
+    bool Append(const std::string& lines);
+    // righe complete arrivate dall'ultima lettura (alla prima: tutte, proprie comprese)
+    std::string ReadNew();
+    const std::filesystem::path& Dir() const { return dir_; }
+
+private:
+    std::filesystem::path dir_;
+    std::filesystem::path own_;
+    std::unordered_map<std::wstring, uint64_t> offsets_; // nome del file -> byte gia' letti
+};
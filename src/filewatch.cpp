@@ -0,0 +1,166 @@
+#include "filewatch.h"
+
+#include <atomic>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+struct DirWatcher::Impl {
+    std::filesystem::path dir;
+    ChangeFn onChange;
+    std::atomic<bool> running{false};
+    std::thread thread;
+#ifdef _WIN32
+    HANDLE dirHandle{INVALID_HANDLE_VALUE};
+    HANDLE stopEvent{nullptr};
+#else
+    int inotifyFd{-1};
+    int stopRd{-1};
+    int stopWr{-1};
+#endif
+
+    void Loop();
+};
+
+DirWatcher::DirWatcher() : impl_(std::make_unique<Impl>()) {}
+
+DirWatcher::~DirWatcher() { Stop(); }
+
+bool DirWatcher::Running() const { return impl_->running; }
+
+#ifdef _WIN32
+
+void DirWatcher::Impl::Loop() {
+    alignas(DWORD) char buf[32 * 1024];
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    while (running) {
+        ResetEvent(ov.hEvent);
+        DWORD got = 0;
+        const DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+        if (!ReadDirectoryChangesW(dirHandle, buf, sizeof(buf), FALSE, filter, nullptr, &ov, nullptr)) break;
+
+        HANDLE waits[2] = {ov.hEvent, stopEvent};
+        if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+            CancelIoEx(dirHandle, &ov);
+            GetOverlappedResult(dirHandle, &ov, &got, TRUE);
+            break;
+        }
+        if (!GetOverlappedResult(dirHandle, &ov, &got, FALSE)) break;
+
+        if (got == 0) {
+            // buffer traboccato: non sappiamo cosa e' cambiato, si segnala la cartella intera
+            onChange(std::filesystem::path());
+            continue;
+        }
+
+        size_t off = 0;
+        for (;;) {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buf + off);
+            onChange(std::filesystem::path(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR))));
+            if (info->NextEntryOffset == 0) break;
+            off += info->NextEntryOffset;
+        }
+    }
+    CloseHandle(ov.hEvent);
+}
+
+bool DirWatcher::Start(const std::filesystem::path& dir, ChangeFn onChange) {
+    Stop();
+    HANDLE h = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    impl_->dir = dir;
+    impl_->onChange = std::move(onChange);
+    impl_->dirHandle = h;
+    impl_->stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    impl_->running = true;
+    impl_->thread = std::thread(&Impl::Loop, impl_.get());
+    return true;
+}
+
+void DirWatcher::Stop() {
+    if (!impl_->running) return;
+    impl_->running = false;
+    SetEvent(impl_->stopEvent);
+    if (impl_->thread.joinable()) impl_->thread.join();
+    CloseHandle(impl_->dirHandle);
+    CloseHandle(impl_->stopEvent);
+    impl_->dirHandle = INVALID_HANDLE_VALUE;
+    impl_->stopEvent = nullptr;
+}
+
+#else
+
+void DirWatcher::Impl::Loop() {
+    alignas(inotify_event) char buf[32 * 1024];
+
+    while (running) {
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopRd, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        const ssize_t got = read(inotifyFd, buf, sizeof(buf));
+        if (got <= 0) continue;
+
+        for (ssize_t off = 0; off < got;) {
+            const auto* ev = reinterpret_cast<const inotify_event*>(buf + off);
+            if (ev->mask & IN_Q_OVERFLOW) onChange(std::filesystem::path());
+            else if (ev->len > 0) onChange(std::filesystem::path(ev->name));
+            off += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+        }
+    }
+}
+
+bool DirWatcher::Start(const std::filesystem::path& dir, ChangeFn onChange) {
+    Stop();
+    const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return false;
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+    if (inotify_add_watch(fd, dir.c_str(), mask) < 0) {
+        close(fd);
+        return false;
+    }
+    int p[2];
+    if (pipe(p) != 0) {
+        close(fd);
+        return false;
+    }
+
+    impl_->dir = dir;
+    impl_->onChange = std::move(onChange);
+    impl_->inotifyFd = fd;
+    impl_->stopRd = p[0];
+    impl_->stopWr = p[1];
+    impl_->running = true;
+    impl_->thread = std::thread(&Impl::Loop, impl_.get());
+    return true;
+}
+
+void DirWatcher::Stop() {
+    if (!impl_->running) return;
+    impl_->running = false;
+    const char b = 0;
+    [[maybe_unused]] ssize_t r = write(impl_->stopWr, &b, 1);
+    if (impl_->thread.joinable()) impl_->thread.join();
+    close(impl_->inotifyFd);
+    close(impl_->stopRd);
+    close(impl_->stopWr);
+    impl_->inotifyFd = impl_->stopRd = impl_->stopWr = -1;
+}
+
+#endif
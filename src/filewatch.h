@@ -0,0 +1,30 @@
+#pragma once
+
+// Notifiche di modifica dei file in una cartella (non ricorsivo).
+// Windows: ReadDirectoryChangesW. Linux: inotify.
+// La callback gira sul thread del watcher: chi la usa deve rimandare il lavoro
+// al thread UI (PostMessage) o proteggere i propri dati.
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+class DirWatcher {
+public:
+    // nome del file (relativo alla cartella) che e' stato creato/modificato/rinominato/rimosso
+    using ChangeFn = std::function<void(const std::filesystem::path& name)>;
+
+    DirWatcher();
+    ~DirWatcher();
+    DirWatcher(const DirWatcher&) = delete;
+    DirWatcher& operator=(const DirWatcher&) = delete;
+
+    bool Start(const std::filesystem::path& dir, ChangeFn onChange);
+    void Stop();
+    bool Running() const;
+
+    struct Impl;
+
+private:
+    std::unique_ptr<Impl> impl_;
+};
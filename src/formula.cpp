@@ -0,0 +1,701 @@
+#include "formula.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cwchar>
+#include <cwctype>
+
+namespace {
+
+constexpr int kMaxDepth = 200; // oltre: "#sintassi" invece di finire lo stack
+
+enum class Fn { Sum, Avg, Min, Max, Count, Round, Abs };
+
+struct FnName {
+    const wchar_t* name;
+    Fn fn;
+};
+
+constexpr FnName kFunctions[] = {
+    {L"somma", Fn::Sum}, {L"sum", Fn::Sum},     {L"media", Fn::Avg},      {L"avg", Fn::Avg},
+    {L"min", Fn::Min},   {L"max", Fn::Max},     {L"conta", Fn::Count},    {L"count", Fn::Count},
+    {L"abs", Fn::Abs},   {L"round", Fn::Round}, {L"arrotonda", Fn::Round},
+};
+
+bool IsSpace(wchar_t c) { return c == L' ' || c == L'\t' || c == L'\r' || c == L'\n'; }
+bool IsDigit(wchar_t c) { return c >= L'0' && c <= L'9'; }
+
+std::wstring NormalizeName(std::wstring_view s) {
+    size_t b = 0, e = s.size();
+    while (b < e && IsSpace(s[b])) ++b;
+    while (e > b && IsSpace(s[e - 1])) --e;
+    std::wstring out(s.substr(b, e - b));
+    for (auto& c : out) c = static_cast<wchar_t>(std::towlower(c));
+    return out;
+}
+
+// numero da cifre ASCII e al piu' un '.' (gia' normalizzato)
+double ToNumber(const std::string& digits) { return std::strtod(digits.c_str(), nullptr); }
+
+// I numeri scritti in un testo. "1.234,50" e "1,234.50" valgono 1234.5: se ci sono
+// tutti e due i separatori l'ultimo e' quello decimale; uno solo ripetuto separa le
+// migliaia; uno solo, una volta, e' decimale. Cifre attaccate a una lettera ("mp3",
+// "A4") non sono numeri.
+template <class Sink> void ExtractNumbers(std::wstring_view text, Sink&& out) {
+    size_t i = 0;
+    while (i < text.size()) {
+        if (!IsDigit(text[i]) || (i > 0 && (std::iswalnum(text[i - 1]) || text[i - 1] == L'#'))) {
+            ++i;
+            continue;
+        }
+        const bool negative = i > 0 && text[i - 1] == L'-' && (i < 2 || !std::iswalnum(text[i - 2]));
+        const size_t start = i;
+        size_t dots = 0, commas = 0;
+        wchar_t last = 0;
+        while (i < text.size()) {
+            if (IsDigit(text[i])) {
+                ++i;
+            } else if ((text[i] == L'.' || text[i] == L',') && i + 1 < text.size() && IsDigit(text[i + 1])) {
+                (text[i] == L'.' ? dots : commas)++;
+                last = text[i];
+                ++i;
+            } else {
+                break;
+            }
+        }
+        wchar_t decimal = 0;
+        if (dots > 0 && commas > 0) decimal = last;
+        else if (dots + commas == 1) decimal = last;
+        std::string digits;
+        if (negative) digits += '-';
+        for (size_t k = start; k < i; ++k) {
+            if (IsDigit(text[k])) digits += static_cast<char>(text[k]);
+            else if (text[k] == decimal) digits += '.';
+        }
+        out(ToNumber(digits));
+    }
+}
+
+// prima riga della tile; se e' l'unica conta anche come numeri
+std::wstring_view FirstLine(std::wstring_view text, bool& onlyLine) {
+    const size_t nl = text.find_first_of(L"\r\n");
+    onlyLine = nl == std::wstring_view::npos;
+    return onlyLine ? text : text.substr(0, nl);
+}
+
+} // namespace
+
+bool IsFormulaText(std::wstring_view text) {
+    size_t i = 0;
+    while (i < text.size() && IsSpace(text[i])) ++i;
+    return i < text.size() && text[i] == L'=';
+}
+
+struct FormulaEngine::Expr {
+    enum class Kind { Number, Id, Name, Neg, Add, Sub, Mul, Div, Pow, Call };
+    struct Node {
+        Kind kind{Kind::Number};
+        double number{0};
+        uint64_t id{0};
+        std::wstring name;
+        Fn fn{Fn::Sum};
+        std::vector<int> args;
+    };
+    std::vector<Node> nodes;
+    int root{-1};
+    bool bad{false};               // errore di sintassi
+    std::vector<uint64_t> ids;     // tile citate per id, senza doppioni
+    std::vector<std::wstring> names; // nomi citati, normalizzati, senza doppioni
+};
+
+struct FormulaEngine::TileInfo {
+    std::wstring name;            // prima riga normalizzata; vuoto per le formule
+    Values numbers;               // numeri del testo (tile non calcolate)
+    std::wstring source;          // testo della formula
+    std::shared_ptr<const Expr> expr;
+    double value{0};
+    std::wstring error;
+    bool evaluated{false};        // formula mai valutata: il primo risultato conta come cambiato
+    bool inCycle{false};          // "#ciclo" senza valutarla: fuori dal ciclo va valutata
+};
+
+namespace {
+
+class Parser {
+public:
+    Parser(std::wstring_view s, FormulaEngine::Expr& e) : s_(s), e_(e) {}
+
+    void Run() {
+        while (pos_ < s_.size() && s_[pos_] != L'=') ++pos_;
+        ++pos_;
+        e_.root = Sum(0);
+        Skip();
+        if (e_.root < 0 || pos_ != s_.size()) e_.bad = true;
+    }
+
+private:
+    using Kind = FormulaEngine::Expr::Kind;
+
+    void Skip() {
+        while (pos_ < s_.size() && IsSpace(s_[pos_])) ++pos_;
+    }
+    bool Eat(wchar_t c) {
+        Skip();
+        if (pos_ < s_.size() && s_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+    int Add(FormulaEngine::Expr::Node node) {
+        e_.nodes.push_back(std::move(node));
+        return static_cast<int>(e_.nodes.size()) - 1;
+    }
+    int Binary(Kind kind, int a, int b) {
+        if (a < 0 || b < 0) return -1;
+        FormulaEngine::Expr::Node n;
+        n.kind = kind;
+        n.args = {a, b};
+        return Add(std::move(n));
+    }
+
+    int Sum(int depth) {
+        int left = Product(depth);
+        while (left >= 0) {
+            if (Eat(L'+')) left = Binary(Kind::Add, left, Product(depth));
+            else if (Eat(L'-')) left = Binary(Kind::Sub, left, Product(depth));
+            else break;
+        }
+        return left;
+    }
+    int Product(int depth) {
+        int left = Unary(depth);
+        while (left >= 0) {
+            if (Eat(L'*')) left = Binary(Kind::Mul, left, Unary(depth));
+            else if (Eat(L'/')) left = Binary(Kind::Div, left, Unary(depth));
+            else break;
+        }
+        return left;
+    }
+    int Unary(int depth) {
+        if (depth > kMaxDepth) return -1;
+        if (Eat(L'-')) {
+            const int arg = Unary(depth + 1);
+            if (arg < 0) return -1;
+            FormulaEngine::Expr::Node n;
+            n.kind = Kind::Neg;
+            n.args = {arg};
+            return Add(std::move(n));
+        }
+        if (Eat(L'+')) return Unary(depth + 1);
+        const int base = Primary(depth);
+        if (base >= 0 && Eat(L'^')) return Binary(Kind::Pow, base, Unary(depth + 1));
+        return base;
+    }
+    int Primary(int depth) {
+        Skip();
+        if (pos_ >= s_.size()) return -1;
+        const wchar_t c = s_[pos_];
+        if (c == L'(') {
+            ++pos_;
+            const int inner = Sum(depth + 1);
+            return Eat(L')') ? inner : -1;
+        }
+        if (IsDigit(c) || c == L'.') return Number();
+        if (c == L'#') return IdRef();
+        if (c == L'[') return NameRef();
+        if (std::iswalpha(c)) return Call(depth);
+        return -1;
+    }
+    int Number() {
+        std::string digits;
+        bool dot = false;
+        while (pos_ < s_.size() && (IsDigit(s_[pos_]) || (s_[pos_] == L'.' && !dot))) {
+            dot = dot || s_[pos_] == L'.';
+            digits += static_cast<char>(s_[pos_++]);
+        }
+        if (digits == ".") return -1;
+        FormulaEngine::Expr::Node n;
+        n.number = ToNumber(digits);
+        return Add(std::move(n));
+    }
+    int IdRef() {
+        ++pos_;
+        uint64_t id = 0;
+        size_t n = 0;
+        while (pos_ < s_.size() && IsDigit(s_[pos_]) && n < 19) {
+            id = id * 10 + static_cast<uint64_t>(s_[pos_++] - L'0');
+            ++n;
+        }
+        if (n == 0) return -1;
+        bool seen = false;
+        for (uint64_t x : e_.ids) seen = seen || x == id;
+        if (!seen) e_.ids.push_back(id);
+        FormulaEngine::Expr::Node node;
+        node.kind = Kind::Id;
+        node.id = id;
+        return Add(std::move(node));
+    }
+    int NameRef() {
+        const size_t close = s_.find(L']', pos_);
+        if (close == std::wstring_view::npos) return -1;
+        std::wstring name = NormalizeName(s_.substr(pos_ + 1, close - pos_ - 1));
+        pos_ = close + 1;
+        if (name.empty()) return -1;
+        bool seen = false;
+        for (const auto& x : e_.names) seen = seen || x == name;
+        if (!seen) e_.names.push_back(name);
+        FormulaEngine::Expr::Node node;
+        node.kind = Kind::Name;
+        node.name = std::move(name);
+        return Add(std::move(node));
+    }
+    int Call(int depth) {
+        const size_t start = pos_;
+        while (pos_ < s_.size() && std::iswalpha(s_[pos_])) ++pos_;
+        const std::wstring name = NormalizeName(s_.substr(start, pos_ - start));
+        FormulaEngine::Expr::Node node;
+        node.kind = Kind::Call;
+        bool known = false;
+        for (const auto& f : kFunctions) {
+            if (name == f.name) {
+                node.fn = f.fn;
+                known = true;
+            }
+        }
+        if (!known || !Eat(L'(')) return -1;
+        if (!Eat(L')')) {
+            do {
+                const int arg = Sum(depth + 1);
+                if (arg < 0) return -1;
+                node.args.push_back(arg);
+            } while (Eat(L';') || Eat(L','));
+            if (!Eat(L')')) return -1;
+        }
+        const size_t want = node.fn == Fn::Abs ? 1 : 0;
+        if (want != 0 && node.args.size() != want) return -1;
+        if (node.fn == Fn::Round && (node.args.empty() || node.args.size() > 2)) return -1;
+        return Add(std::move(node));
+    }
+
+    std::wstring_view s_;
+    FormulaEngine::Expr& e_;
+    size_t pos_{0};
+};
+
+} // namespace
+
+FormulaEngine::FormulaEngine() = default;
+FormulaEngine::~FormulaEngine() = default;
+
+std::shared_ptr<const FormulaEngine::Expr> FormulaEngine::Parse(std::wstring_view source) {
+    std::wstring key(source);
+    auto it = cache_.find(key);
+    if (it != cache_.end()) return it->second;
+
+    if (cache_.size() > tiles_.size() + 64) {
+        // espressioni che nessuna tile usa piu'
+        for (auto c = cache_.begin(); c != cache_.end();) {
+            if (c->second.use_count() == 1) c = cache_.erase(c);
+            else ++c;
+        }
+    }
+    auto e = std::make_shared<Expr>();
+    Parser(source, *e).Run();
+    ++parses_;
+    cache_.emplace(std::move(key), e);
+    return e;
+}
+
+void FormulaEngine::Link(uint64_t id, const Expr& e) {
+    for (uint64_t ref : e.ids) byId_[ref].insert(id);
+    for (const auto& name : e.names) byName_[name].insert(id);
+}
+
+void FormulaEngine::Unlink(uint64_t id, const Expr& e) {
+    for (uint64_t ref : e.ids) {
+        auto it = byId_.find(ref);
+        if (it == byId_.end()) continue;
+        it->second.erase(id);
+        if (it->second.empty()) byId_.erase(it);
+    }
+    for (const auto& name : e.names) {
+        auto it = byName_.find(name);
+        if (it == byName_.end()) continue;
+        it->second.erase(id);
+        if (it->second.empty()) byName_.erase(it);
+    }
+}
+
+void FormulaEngine::MarkDependents(uint64_t id, const std::wstring& name) {
+    auto it = byId_.find(id);
+    if (it != byId_.end()) dirty_.insert(it->second.begin(), it->second.end());
+    if (name.empty()) return;
+    auto n = byName_.find(name);
+    if (n != byName_.end()) dirty_.insert(n->second.begin(), n->second.end());
+}
+
+void FormulaEngine::SetTile(uint64_t id, std::wstring_view text) {
+    auto [slot, created] = tiles_.try_emplace(id);
+    TileInfo& t = slot->second;
+    // una tile nuova: chi la citava per id aveva "#rif?"
+    if (created) MarkDependents(id, std::wstring());
+    auto rename = [&](std::wstring name) {
+        if (name == t.name) return;
+        MarkDependents(id, t.name);
+        if (!t.name.empty()) {
+            auto it = names_.find(t.name);
+            if (it != names_.end()) {
+                it->second.erase(id);
+                if (it->second.empty()) names_.erase(it);
+            }
+        }
+        t.name = std::move(name);
+        if (!t.name.empty()) names_[t.name].insert(id);
+        MarkDependents(id, t.name);
+    };
+
+    if (IsFormulaText(text)) {
+        if (t.expr && t.source == text) return;
+        if (t.expr) Unlink(id, *t.expr);
+        else MarkDependents(id, t.name); // chi la cita ora vede il risultato, non i numeri del testo
+        rename(std::wstring());
+        t.numbers = Values();
+        t.source.assign(text);
+        t.expr = Parse(text);
+        t.evaluated = false;
+        Link(id, *t.expr);
+        dirty_.insert(id);
+        return;
+    }
+
+    if (t.expr) {
+        // non e' piu' una formula: chi la citava vede i numeri del testo
+        Unlink(id, *t.expr);
+        t.expr.reset();
+        t.source.clear();
+        t.error.clear();
+        t.value = 0;
+        t.evaluated = false;
+        MarkDependents(id, t.name);
+    }
+    bool onlyLine = false;
+    const std::wstring_view first = FirstLine(text, onlyLine);
+    rename(NormalizeName(first));
+    Values numbers;
+    ExtractNumbers(onlyLine ? text : text.substr(first.size()), [&](double v) { numbers.Add(v); });
+    if (!(numbers == t.numbers)) {
+        t.numbers = numbers;
+        MarkDependents(id, t.name);
+    }
+}
+
+void FormulaEngine::RemoveTile(uint64_t id) {
+    auto it = tiles_.find(id);
+    if (it == tiles_.end()) return;
+    TileInfo& t = it->second;
+    MarkDependents(id, t.name);
+    if (t.expr) Unlink(id, *t.expr);
+    if (!t.name.empty()) {
+        auto n = names_.find(t.name);
+        if (n != names_.end()) {
+            n->second.erase(id);
+            if (n->second.empty()) names_.erase(n);
+        }
+    }
+    tiles_.erase(it);
+    dirty_.erase(id);
+}
+
+void FormulaEngine::Clear() {
+    tiles_.clear();
+    names_.clear();
+    byId_.clear();
+    byName_.clear();
+    cache_.clear();
+    dirty_.clear();
+}
+
+bool FormulaEngine::IsFormula(uint64_t id) const {
+    auto it = tiles_.find(id);
+    return it != tiles_.end() && it->second.expr != nullptr;
+}
+
+std::wstring FormulaEngine::Display(uint64_t id) const {
+    auto it = tiles_.find(id);
+    if (it == tiles_.end() || !it->second.expr) return std::wstring();
+    const TileInfo& t = it->second;
+    if (!t.error.empty()) return t.error;
+    wchar_t buf[64];
+    std::swprintf(buf, 64, L"%.10g", t.value == 0 ? 0.0 : t.value); // niente "-0"
+    return buf;
+}
+
+void FormulaEngine::Values::Add(double v) {
+    min = count == 0 ? v : std::fmin(min, v);
+    max = count == 0 ? v : std::fmax(max, v);
+    sum += v;
+    count += 1;
+}
+
+void FormulaEngine::Values::Add(const Values& v) {
+    if (v.count == 0) return;
+    min = count == 0 ? v.min : std::fmin(min, v.min);
+    max = count == 0 ? v.max : std::fmax(max, v.max);
+    sum += v.sum;
+    count += v.count;
+}
+
+const FormulaEngine::Values& FormulaEngine::NameValues(const std::wstring& name) {
+    // molte formule sullo stesso nome: le tile si sommano una volta per ricalcolo
+    auto [it, added] = nameValues_.try_emplace(name);
+    if (added) {
+        for (uint64_t id : names_.at(name)) it->second.Add(tiles_.at(id).numbers);
+    }
+    return it->second;
+}
+
+bool FormulaEngine::Eval(const Expr& e, int node, Values& out, std::wstring& error) {
+    const Expr::Node& n = e.nodes[static_cast<size_t>(node)];
+    out = Values();
+    switch (n.kind) {
+    case Expr::Kind::Number:
+        out.Add(n.number);
+        return true;
+    case Expr::Kind::Id: {
+        auto it = tiles_.find(n.id);
+        if (it == tiles_.end()) {
+            error = L"#rif?";
+            return false;
+        }
+        const TileInfo& t = it->second;
+        if (!t.expr) {
+            out = t.numbers;
+            return true;
+        }
+        if (!t.error.empty()) {
+            error = t.error;
+            return false;
+        }
+        out.Add(t.value);
+        return true;
+    }
+    case Expr::Kind::Name:
+        if (names_.count(n.name) == 0) {
+            error = L"#nome?";
+            return false;
+        }
+        out = NameValues(n.name);
+        return true;
+    default:
+        break;
+    }
+
+    Values args[2];
+    Values all;
+    for (size_t i = 0; i < n.args.size(); ++i) {
+        Values& v = i < 2 ? args[i] : args[1];
+        if (!Eval(e, n.args[i], v, error)) return false;
+        all.Add(v);
+    }
+    const double a = args[0].sum, b = args[1].sum;
+    double v = 0;
+    switch (n.kind) {
+    case Expr::Kind::Neg: v = -a; break;
+    case Expr::Kind::Add: v = a + b; break;
+    case Expr::Kind::Sub: v = a - b; break;
+    case Expr::Kind::Mul: v = a * b; break;
+    case Expr::Kind::Pow: v = std::pow(a, b); break;
+    case Expr::Kind::Div:
+        if (b == 0) {
+            error = L"#div/0";
+            return false;
+        }
+        v = a / b;
+        break;
+    case Expr::Kind::Call:
+        switch (n.fn) {
+        case Fn::Sum: v = all.sum; break;
+        case Fn::Count: v = all.count; break;
+        case Fn::Min: v = all.min; break;
+        case Fn::Max: v = all.max; break;
+        case Fn::Abs: v = std::fabs(a); break;
+        case Fn::Avg:
+            if (all.count == 0) {
+                error = L"#div/0";
+                return false;
+            }
+            v = all.sum / all.count;
+            break;
+        case Fn::Round: {
+            const double scale = std::pow(10.0, n.args.size() > 1 ? std::round(b) : 0.0);
+            v = std::round(a * scale) / scale;
+            break;
+        }
+        }
+        break;
+    default:
+        break;
+    }
+    out.Add(v);
+    return true;
+}
+
+std::vector<uint64_t> FormulaEngine::Recalculate() {
+    std::vector<uint64_t> changed;
+    if (dirty_.empty()) return changed;
+
+    // da ricalcolare: le formule sporche e, a cascata, quelle che le citano per id
+    // (le formule non hanno nome, quindi la cascata passa solo dagli id)
+    std::unordered_set<uint64_t> closure;
+    std::vector<uint64_t> stack;
+    for (uint64_t id : dirty_) {
+        if (IsFormula(id)) stack.push_back(id);
+    }
+    std::unordered_set<uint64_t> stale(stack.begin(), stack.end());
+    dirty_.clear();
+    while (!stack.empty()) {
+        const uint64_t f = stack.back();
+        stack.pop_back();
+        if (!closure.insert(f).second) continue;
+        auto it = byId_.find(f);
+        if (it == byId_.end()) continue;
+        for (uint64_t g : it->second) {
+            if (closure.count(g) == 0) stack.push_back(g);
+        }
+    }
+
+    // ordine topologico (Kahn) sugli archi interni all'insieme
+    std::unordered_map<uint64_t, int> pending;
+    for (uint64_t f : closure) {
+        int n = 0;
+        for (uint64_t ref : tiles_.at(f).expr->ids) n += closure.count(ref) ? 1 : 0;
+        pending[f] = n;
+        if (n == 0) stack.push_back(f);
+    }
+    nameValues_.clear();
+    // f e' sistemata: le formule che la citano hanno un ingresso in meno
+    auto release = [&](uint64_t f, bool moved) {
+        auto it = byId_.find(f);
+        if (it == byId_.end()) return;
+        for (uint64_t g : it->second) {
+            if (closure.count(g) == 0 || pending[g] == 0) continue;
+            if (moved) stale.insert(g);
+            if (--pending[g] == 0) stack.push_back(g);
+        }
+    };
+    Values out;
+    for (;;) {
+        while (!stack.empty()) {
+            const uint64_t f = stack.back();
+            stack.pop_back();
+            TileInfo& t = tiles_.at(f);
+            bool moved = false;
+            if (stale.count(f) || t.inCycle) {
+                // a valle di una formula il cui risultato non e' cambiato non si rivaluta
+                std::wstring error;
+                double value = 0;
+                if (t.expr->bad) {
+                    error = L"#sintassi";
+                } else if (Eval(*t.expr, t.expr->root, out, error)) {
+                    value = out.sum;
+                    if (!std::isfinite(value)) error = L"#num!";
+                }
+                if (!error.empty()) value = 0;
+                moved = !t.evaluated || value != t.value || error != t.error;
+                t.value = value;
+                t.error = std::move(error);
+                t.evaluated = true;
+                t.inCycle = false;
+                if (moved) changed.push_back(f);
+            }
+            release(f, moved);
+        }
+
+        // Rimasti con archi entranti: in un ciclo o a valle di uno. Quelle nel ciclo danno
+        // "#ciclo" senza valutarle; quelle a valle si valutano poi come le altre, cosi'
+        // l'errore che mostrano dipende solo dalle formule e non dall'ordine delle modifiche.
+        std::unordered_map<uint64_t, int> left;
+        for (const auto& [g, n] : pending) {
+            if (n > 0) left.emplace(g, n);
+        }
+        if (left.empty()) break;
+        const std::unordered_set<uint64_t> cycle = CycleMembers(left);
+        if (cycle.empty()) break; // non succede: chi resta fuori da Kahn ha un ciclo a monte
+        for (uint64_t g : cycle) pending[g] = 0;
+        for (uint64_t g : cycle) {
+            TileInfo& t = tiles_.at(g);
+            const bool moved = !t.evaluated || t.error != L"#ciclo";
+            t.error = L"#ciclo";
+            t.value = 0;
+            t.evaluated = true;
+            t.inCycle = true;
+            if (moved) changed.push_back(g);
+            release(g, moved);
+        }
+    }
+    return changed;
+}
+
+std::unordered_set<uint64_t> FormulaEngine::CycleMembers(const std::unordered_map<uint64_t, int>& pending) const {
+    // Tarjan iterativo sul sottografo (catene di migliaia di formule: niente ricorsione)
+    struct Frame {
+        uint64_t id;
+        std::vector<uint64_t> next;
+        size_t at{0};
+    };
+    std::unordered_map<uint64_t, int> index, low;
+    std::unordered_set<uint64_t> onStack;
+    std::vector<uint64_t> path;
+    std::unordered_set<uint64_t> members;
+    int counter = 0;
+
+    auto successors = [&](uint64_t f) {
+        std::vector<uint64_t> out;
+        auto it = byId_.find(f);
+        if (it == byId_.end()) return out;
+        for (uint64_t g : it->second) {
+            if (pending.count(g)) out.push_back(g);
+        }
+        return out;
+    };
+
+    for (const auto& [start, n] : pending) {
+        if (index.count(start)) continue;
+        std::vector<Frame> frames;
+        auto open = [&](uint64_t f) {
+            index[f] = low[f] = counter++;
+            path.push_back(f);
+            onStack.insert(f);
+            frames.push_back(Frame{f, successors(f)});
+        };
+        open(start);
+        while (!frames.empty()) {
+            Frame& fr = frames.back();
+            if (fr.at < fr.next.size()) {
+                const uint64_t g = fr.next[fr.at++];
+                if (!index.count(g)) open(g);
+                else if (onStack.count(g)) low[fr.id] = std::min(low[fr.id], index[g]);
+                continue;
+            }
+            const uint64_t f = fr.id;
+            frames.pop_back();
+            if (!frames.empty()) low[frames.back().id] = std::min(low[frames.back().id], low[f]);
+            if (low[f] != index[f]) continue;
+            // radice di una componente: e' un ciclo se ha piu' nodi o un arco su se stessa
+            std::vector<uint64_t> component;
+            uint64_t g = 0;
+            do {
+                g = path.back();
+                path.pop_back();
+                onStack.erase(g);
+                component.push_back(g);
+            } while (g != f);
+            auto self = byId_.find(f);
+            if (component.size() > 1 || (self != byId_.end() && self->second.count(f))) {
+                members.insert(component.begin(), component.end());
+            }
+        }
+    }
+    return members;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// Tile calcolate: un testo che comincia con '=' e' un'espressione, come in un foglio
+// di calcolo. Riferimenti:
+// - #12      la tile con id 12
+// - [spese]  le tile la cui prima riga e' "spese" (maiuscole e spazi ai lati non contano)
+// Un riferimento vale i numeri scritti nella tile (o il risultato, se e' a sua volta
+// calcolata): in un'operazione conta la loro somma, nelle funzioni ogni numero. La
+// prima riga e' il titolo e i suoi numeri contano solo se la tile ha una riga sola.
+// Funzioni: somma/sum, media/avg, min, max, conta/count, arrotonda/round(x; cifre), abs.
+// Argomenti separati da ';' o ','; nelle espressioni il separatore decimale e' '.',
+// nel testo delle tile vanno bene '.' e ','.
+//
+// Le dipendenze sono un grafo: un testo cambiato rende da ricalcolare solo le formule
+// che lo usano, e Recalculate le valuta (con quelle che dipendono da loro) in ordine
+// topologico. Le formule in un ciclo danno "#ciclo", quelle a valle lo ricevono come
+// qualunque altro errore di una tile citata. Le espressioni analizzate sono in
+// cache per testo: tile con la stessa formula la analizzano una volta.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+bool IsFormulaText(std::wstring_view text);
+
+class FormulaEngine {
+public:
+    FormulaEngine();
+    ~FormulaEngine();
+
+    // testo nuovo di una tile (anche non calcolata): aggiorna numeri, nome, formula e
+    // dipendenze; il ricalcolo aspetta Recalculate
+    void SetTile(uint64_t id, std::wstring_view text);
+    void RemoveTile(uint64_t id);
+    void Clear();
+
+    // formule da ricalcolare dall'ultima volta; ritorna quelle con risultato cambiato
+    std::vector<uint64_t> Recalculate();
+
+    bool IsFormula(uint64_t id) const;
+    std::wstring Display(uint64_t id) const; // risultato formattato o errore ("#ciclo", "#rif?"...)
+    size_t Parses() const { return parses_; } // espressioni analizzate davvero (non dalla cache)
+
+    struct Expr;
+
+private:
+    struct TileInfo;
+
+    // i numeri visti da una formula: alle funzioni bastano somma, quanti, min e max
+    struct Values {
+        double sum{0};
+        double count{0};
+        double min{0};
+        double max{0};
+        void Add(double v);
+        void Add(const Values& v);
+        bool operator==(const Values&) const = default;
+    };
+
+    void Link(uint64_t id, const Expr& e);
+    void Unlink(uint64_t id, const Expr& e);
+    void MarkDependents(uint64_t id, const std::wstring& name);
+    // tra le formule rimaste fuori dall'ordine topologico, quelle davvero in un ciclo
+    std::unordered_set<uint64_t> CycleMembers(const std::unordered_map<uint64_t, int>& pending) const;
+    std::shared_ptr<const Expr> Parse(std::wstring_view source);
+    bool Eval(const Expr& e, int node, Values& out, std::wstring& error);
+    const Values& NameValues(const std::wstring& name);
+
+    std::unordered_map<uint64_t, TileInfo> tiles_;
+    std::unordered_map<std::wstring, std::unordered_set<uint64_t>> names_;  // nome -> tile con quel nome
+    std::unordered_map<uint64_t, std::unordered_set<uint64_t>> byId_;      // tile -> formule che la citano per id
+    std::unordered_map<std::wstring, std::unordered_set<uint64_t>> byName_; // nome -> formule che lo citano
+    std::unordered_map<std::wstring, std::shared_ptr<const Expr>> cache_;  // testo -> espressione
+    std::unordered_set<uint64_t> dirty_;
+    std::unordered_map<std::wstring, Values> nameValues_; // somme per nome, valide in un Recalculate
+    size_t parses_{0};
+};
@@ -0,0 +1,161 @@
+#include "freespace.h"
+
+#include <algorithm>
+
+void FreeSpaceIndex::Reset(int cellsX, int cellsY) {
+    w_ = std::max(0, cellsX);
+    h_ = std::max(0, cellsY);
+    const size_t n = static_cast<size_t>(w_) * h_;
+    count_.assign(n, 0);
+    up_.assign(n, 0);
+    down_.assign(n, 0);
+    for (int y = 0; y < h_; ++y) {
+        for (int x = 0; x < w_; ++x) {
+            up_[Index(x, y)] = y + 1;
+            down_[Index(x, y)] = h_ - y;
+        }
+    }
+    rows_.assign(h_, RowInfo{});
+    rowDirty_.assign(h_, 0);
+    dirtyRows_.clear();
+    for (int y = 0; y < h_; ++y) MarkRow(y);
+}
+
+bool FreeSpaceIndex::IsFree(int x, int y) const {
+    return x >= 0 && y >= 0 && x < w_ && y < h_ && count_[Index(x, y)] == 0;
+}
+
+void FreeSpaceIndex::MarkRow(int y) {
+    if (rowDirty_[y]) return;
+    rowDirty_[y] = 1;
+    dirtyRows_.push_back(y);
+}
+
+void FreeSpaceIndex::Apply(const CellRect& r, int delta) {
+    const int x0 = std::max(0, r.x);
+    const int y0 = std::max(0, r.y);
+    const int x1 = std::min(w_, r.x + r.w);
+    const int y1 = std::min(h_, r.y + r.h);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            uint16_t& c = count_[Index(x, y)];
+            c = static_cast<uint16_t>(std::max(0, c + delta));
+        }
+    }
+
+    // up/down cambiano solo nelle colonne toccate, e solo finche' il nuovo valore differisce dal vecchio
+    for (int x = x0; x < x1; ++x) {
+        for (int y = y0; y < h_; ++y) {
+            const int above = y > 0 ? up_[Index(x, y - 1)] : 0;
+            const int v = count_[Index(x, y)] == 0 ? above + 1 : 0;
+            int& cur = up_[Index(x, y)];
+            if (y >= y1 && cur == v) break;
+            if (cur != v) MarkRow(y);
+            cur = v;
+        }
+        for (int y = y1 - 1; y >= 0; --y) {
+            const int below = y + 1 < h_ ? down_[Index(x, y + 1)] : 0;
+            const int v = count_[Index(x, y)] == 0 ? below + 1 : 0;
+            int& cur = down_[Index(x, y)];
+            if (y < y0 && cur == v) break;
+            cur = v;
+        }
+    }
+}
+
+void FreeSpaceIndex::RefreshRows() const {
+    for (int y : dirtyRows_) {
+        // rettangolo massimo nell'istogramma up_[y], con stack monotono
+        RowInfo info;
+        stack_.clear();
+        const int* hist = &up_[Index(0, y)];
+        for (int x = 0; x <= w_; ++x) {
+            const int hx = x < w_ ? hist[x] : 0;
+            if (x < w_) info.maxUp = std::max(info.maxUp, hx);
+            while (!stack_.empty() && hist[stack_.back()] >= hx) {
+                const int height = hist[stack_.back()];
+                stack_.pop_back();
+                const int left = stack_.empty() ? 0 : stack_.back() + 1;
+                const int64_t area = static_cast<int64_t>(height) * (x - left);
+                if (height > 0 && area > info.area) {
+                    info.area = area;
+                    info.best = CellRect{left, y - height + 1, x - left, height};
+                }
+            }
+            stack_.push_back(x);
+        }
+        rows_[y] = info;
+        rowDirty_[y] = 0;
+    }
+    dirtyRows_.clear();
+}
+
+bool FreeSpaceIndex::LargestEmpty(CellRect& out) const {
+    RefreshRows();
+    int64_t best = 0;
+    for (int y = 0; y < h_; ++y) {
+        const RowInfo& r = rows_[y];
+        if (r.area > best || (r.area == best && best > 0 && r.best.y < out.y)) {
+            best = r.area;
+            out = r.best;
+        }
+    }
+    return best > 0;
+}
+
+bool FreeSpaceIndex::FirstEmpty(int w, int h, CellRect& out) const {
+    if (w <= 0 || h <= 0 || w > w_ || h > h_) return false;
+    RefreshRows();
+    // un w x h con il bordo inferiore sulla riga y esiste se ci sono w colonne di fila con up >= h;
+    // scorrendo y in ordine si trova anche il bordo superiore piu' alto
+    for (int y = h - 1; y < h_; ++y) {
+        if (rows_[y].maxUp < h || rows_[y].area < static_cast<int64_t>(w) * h) continue;
+        const int* hist = &up_[Index(0, y)];
+        int run = 0;
+        for (int x = 0; x < w_; ++x) {
+            run = hist[x] >= h ? run + 1 : 0;
+            if (run == w) {
+                out = CellRect{x - w + 1, y - h + 1, w, h};
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool FreeSpaceIndex::EmptyRegionAt(int px, int py, CellRect& out) const {
+    if (!IsFree(px, py)) return false;
+
+    // corsa libera orizzontale che contiene la cella
+    int left = px;
+    int right = px;
+    while (left > 0 && count_[Index(left - 1, py)] == 0) --left;
+    while (right + 1 < w_ && count_[Index(right + 1, py)] == 0) ++right;
+
+    // per ogni coppia di colonne [a, b] con a <= px <= b l'altezza e' limitata dal minimo di up/down;
+    // si allarga a destra da ogni a e si smette quando nemmeno l'altezza piena basterebbe a battere il migliore
+    int64_t best = 0;
+    int upA = up_[Index(px, py)];
+    int downA = down_[Index(px, py)];
+    for (int a = px; a >= left; --a) {
+        upA = std::min(upA, up_[Index(a, py)]);
+        downA = std::min(downA, down_[Index(a, py)]);
+        int upAB = upA;
+        int downAB = downA;
+        for (int b = px; b <= right; ++b) {
+            upAB = std::min(upAB, up_[Index(b, py)]);
+            downAB = std::min(downAB, down_[Index(b, py)]);
+            const int height = upAB + downAB - 1;
+            const int64_t area = static_cast<int64_t>(height) * (b - a + 1);
+            if (area > best) {
+                best = area;
+                out = CellRect{a, py - upAB + 1, b - a + 1, height};
+            }
+            if (static_cast<int64_t>(height) * (right - a + 1) <= best) break;
+        }
+        if (static_cast<int64_t>(upA + downA - 1) * (right - left + 1) <= best) break;
+    }
+    return best > 0;
+}
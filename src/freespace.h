@@ -0,0 +1,56 @@
+#pragma once
+
+// Indice dello spazio libero sulla griglia della board, aggiornato in modo
+// incrementale quando le tile cambiano (aggiunta, eliminazione, resize).
+// Per ogni cella tiene quante celle libere consecutive ci sono sopra (up) e
+// sotto (down); per ogni riga il rettangolo vuoto piu' grande che ha li' il
+// bordo inferiore (istogramma), ricalcolato solo per le righe toccate.
+
+#include <cstdint>
+#include <vector>
+
+#include "layoutcheck.h" // CellRect
+
+class FreeSpaceIndex {
+public:
+    void Reset(int cellsX, int cellsY); // tutto libero
+    void Occupy(const CellRect& r) { Apply(r, +1); }
+    void Release(const CellRect& r) { Apply(r, -1); }
+    void Move(const CellRect& from, const CellRect& to) {
+        Release(from);
+        Occupy(to);
+    }
+
+    int Width() const { return w_; }
+    int Height() const { return h_; }
+    bool IsFree(int x, int y) const;
+
+    // rettangolo vuoto di area massima (a parita': quello piu' in alto)
+    bool LargestEmpty(CellRect& out) const;
+    // primo rettangolo vuoto w x h in ordine di lettura (riga, poi colonna)
+    bool FirstEmpty(int w, int h, CellRect& out) const;
+    // rettangolo vuoto di area massima che contiene la cella (x, y)
+    bool EmptyRegionAt(int x, int y, CellRect& out) const;
+
+private:
+    size_t Index(int x, int y) const { return static_cast<size_t>(y) * w_ + x; }
+    void Apply(const CellRect& r, int delta);
+    void MarkRow(int y);
+    void RefreshRows() const;
+
+    int w_{0};
+    int h_{0};
+    std::vector<uint16_t> count_; // tile che coprono la cella: 0 = libera
+    std::vector<int> up_;
+    std::vector<int> down_;
+
+    struct RowInfo {
+        CellRect best;     // rettangolo migliore con il bordo inferiore su questa riga
+        int64_t area{0};
+        int maxUp{0};
+    };
+    mutable std::vector<RowInfo> rows_;
+    mutable std::vector<uint8_t> rowDirty_;
+    mutable std::vector<int> dirtyRows_;
+    mutable std::vector<int> stack_;
+};
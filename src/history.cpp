@@ -0,0 +1,403 @@
+#include "history.h"
+
+#include "sha256.h"
+#include "statefile.h"
+#include "textutil.h"
+
+#include <algorithm>
+#include <charconv>
+#include <map>
+#include <system_error>
+
+namespace {
+
+constexpr char kHeader[] = "gridnotes-history 1\n";
+constexpr size_t kMaxGroupLines = 128;
+constexpr uint64_t kGroupMask = 15; // in media 16 righe per gruppo
+constexpr size_t kMaxTopNodes = 16; // oltre si aggiunge un livello
+constexpr int kMaxDepth = 16;
+
+constexpr int64_t kHour = 3600;
+constexpr int64_t kDay = 24 * kHour;
+
+bool ParseInt64(std::string_view s, int64_t& v) {
+    const auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+// prossima parola di s (separata da spazi), s avanza
+std::string_view NextWord(std::string_view& s) {
+    const size_t start = s.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        s = {};
+        return {};
+    }
+    s.remove_prefix(start);
+    const size_t end = std::min(s.find(' '), s.size());
+    const std::string_view word = s.substr(0, end);
+    s.remove_prefix(end);
+    return word;
+}
+
+bool IsHash(std::string_view s) {
+    return s.size() == 64 && s.find_first_not_of("0123456789abcdef") == std::string_view::npos;
+}
+
+std::string TracksLine(const char* name, const std::vector<std::pair<int, int>>& tracks) {
+    std::string line = name;
+    for (const auto& [index, px] : tracks) line += " " + std::to_string(index) + " " + std::to_string(px);
+    return line + "\n";
+}
+
+void ParseTracks(std::string_view rest, std::vector<std::pair<int, int>>& out) {
+    for (;;) {
+        int64_t index = 0;
+        int64_t px = 0;
+        if (!ParseInt64(NextWord(rest), index) || !ParseInt64(NextWord(rest), px)) return;
+        out.emplace_back(static_cast<int>(index), static_cast<int>(px));
+    }
+}
+
+std::string TileLine(const HistoryTile& t) {
+    return std::to_string(t.id) + " " + std::to_string(t.x) + " " + std::to_string(t.y) + " " + std::to_string(t.w) + " " +
+           std::to_string(t.h) + (t.autoFit ? " 1 " : " 0 ") + t.textHash + "\n";
+}
+
+bool ParseTileLine(std::string_view line, HistoryTile& t) {
+    int64_t v[6];
+    for (int64_t& x : v) {
+        if (!ParseInt64(NextWord(line), x)) return false;
+    }
+    const std::string_view hash = NextWord(line);
+    if (v[0] <= 0 || !IsHash(hash)) return false;
+    t.id = static_cast<uint64_t>(v[0]);
+    t.x = static_cast<int>(v[1]);
+    t.y = static_cast<int>(v[2]);
+    t.w = static_cast<int>(v[3]);
+    t.h = static_cast<int>(v[4]);
+    t.autoFit = v[5] != 0;
+    t.textHash = hash;
+    return true;
+}
+
+// righe di bytes, senza '\n'
+template <typename Fn>
+void ForEachLine(std::string_view bytes, Fn fn) {
+    while (!bytes.empty()) {
+        const size_t nl = std::min(bytes.find('\n'), bytes.size());
+        fn(bytes.substr(0, nl));
+        bytes.remove_prefix(std::min(nl + 1, bytes.size()));
+    }
+}
+
+} // namespace
+
+std::vector<HistoryChange> DiffSnapshots(const HistorySnapshot& from, const HistorySnapshot& to) {
+    // entrambe in ordine di id: un passaggio solo
+    std::vector<HistoryChange> out;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < from.tiles.size() || j < to.tiles.size()) {
+        const HistoryTile* a = i < from.tiles.size() ? &from.tiles[i] : nullptr;
+        const HistoryTile* b = j < to.tiles.size() ? &to.tiles[j] : nullptr;
+        HistoryChange c;
+        if (a && (!b || a->id < b->id)) {
+            c.id = a->id;
+            c.removed = true;
+            ++i;
+        } else if (b && (!a || b->id < a->id)) {
+            c.id = b->id;
+            c.added = true;
+            ++j;
+        } else {
+            c.id = a->id;
+            c.moved = a->x != b->x || a->y != b->y || a->w != b->w || a->h != b->h || a->autoFit != b->autoFit;
+            c.text = a->textHash != b->textHash;
+            ++i;
+            ++j;
+            if (!c.moved && !c.text) continue;
+        }
+        out.push_back(c);
+    }
+    return out;
+}
+
+std::filesystem::path ChunkStore::PathOf(const std::string& hash) const {
+    // 256 sottocartelle: nessuna cartella con centinaia di migliaia di file
+    return dir_ / hash.substr(0, 2) / hash.substr(2);
+}
+
+std::string ChunkStore::Put(std::string_view bytes) {
+    std::string hash = Sha256Hex(bytes);
+    if (known_.count(hash)) return hash;
+
+    const std::filesystem::path path = PathOf(hash);
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        std::filesystem::create_directories(path.parent_path(), ec);
+        if (!WriteFileAtomic(path, std::string(bytes))) return {};
+    }
+    known_.insert(hash);
+    return hash;
+}
+
+bool ChunkStore::Get(const std::string& hash, std::string& bytes) const {
+    bytes.clear();
+    if (!IsHash(hash) || !ReadWholeFile(PathOf(hash), bytes)) return false;
+    if (Sha256Hex(bytes) == hash) return true;
+    bytes.clear(); // file rovinato: meglio niente che un testo sbagliato
+    return false;
+}
+
+size_t ChunkStore::Sweep(const std::unordered_set<std::string>& live) {
+    size_t removed = 0;
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        const std::string name = it->path().filename().string();
+        const std::string hash = it->path().parent_path().filename().string() + name;
+        // .tmp rimasti da una scrittura interrotta se ne vanno anche loro
+        if (IsHash(hash) && live.count(hash)) continue;
+        std::error_code rmEc;
+        if (std::filesystem::remove(it->path(), rmEc)) {
+            known_.erase(hash);
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+History::~History() { Stop(); }
+
+bool History::Open(const std::filesystem::path& dir) {
+    std::error_code ec;
+    chunks_.Open(dir / "chunks");
+    snapshots_ = dir / "snapshots";
+    std::filesystem::create_directories(dir / "chunks", ec);
+    std::filesystem::create_directories(snapshots_, ec);
+    if (ec) return false;
+
+    // l'ultima istantanea della volta scorsa: se al riavvio non e' cambiato niente non se ne fa un'altra
+    const std::vector<int64_t> times = List();
+    if (!times.empty()) {
+        std::string bytes;
+        ReadWholeFile(SnapshotPath(times.back()), bytes);
+        const size_t body = bytes.find('\n', bytes.find("\ntime ") + 1);
+        if (body != std::string::npos) lastBody_ = bytes.substr(body + 1);
+        lastTime_ = times.back();
+    }
+    return true;
+}
+
+std::filesystem::path History::SnapshotPath(int64_t time) const { return snapshots_ / (std::to_string(time) + ".snap"); }
+
+bool History::Take(HistorySnapshot snap, const std::unordered_map<uint64_t, std::string>& texts) {
+    std::sort(snap.tiles.begin(), snap.tiles.end(), [](const HistoryTile& a, const HistoryTile& b) { return a.id < b.id; });
+
+    std::unordered_map<uint64_t, std::string> textHashes;
+    textHashes.reserve(snap.tiles.size());
+    for (HistoryTile& t : snap.tiles) {
+        auto changed = texts.find(t.id);
+        auto last = lastText_.find(t.id);
+        if (changed != texts.end()) t.textHash = chunks_.Put(changed->second);
+        else if (last != lastText_.end()) t.textHash = last->second;
+        else t.textHash = chunks_.Put(std::string_view()); // mai vista e senza testo
+        if (t.textHash.empty()) return false;
+        textHashes[t.id] = t.textHash;
+    }
+
+    std::vector<std::string> level;
+    level.reserve(snap.tiles.size());
+    for (const HistoryTile& t : snap.tiles) level.push_back(TileLine(t));
+    std::unordered_map<uint64_t, std::string> previous;
+    previous.swap(groupHashes_);
+    groupHashes_.reserve(previous.size());
+
+    // gruppi di righe, poi gruppi di hash dei gruppi, finche' la cima e' corta
+    int depth = 0;
+    do {
+        std::vector<std::string> parents;
+        if (!PutLevel(level, parents, previous)) return false;
+        level = std::move(parents);
+        ++depth;
+    } while (level.size() > kMaxTopNodes && depth < kMaxDepth);
+
+    std::string body = TracksLine("columns", snap.columns) + TracksLine("rows", snap.rows) + "depth " + std::to_string(depth) + "\n";
+    for (const std::string& hash : level) body += "node " + hash;
+    lastText_ = std::move(textHashes);
+    if (body == lastBody_) return false;
+
+    snap.time = std::max(snap.time, lastTime_ + 1);
+    if (!WriteFileAtomic(SnapshotPath(snap.time), kHeader + ("time " + std::to_string(snap.time) + "\n") + body)) return false;
+    lastBody_ = std::move(body);
+    lastTime_ = snap.time;
+    return true;
+}
+
+// I confini dei gruppi dipendono dalle righe e non dalla loro posizione: una riga
+// cambiata, aggiunta o tolta sposta solo il gruppo in cui cade.
+bool History::PutLevel(const std::vector<std::string>& lines, std::vector<std::string>& parents,
+                       const std::unordered_map<uint64_t, std::string>& previous) {
+    std::string group;
+    size_t count = 0;
+    auto close = [&] {
+        // gruppo uguale alla volta scorsa: niente SHA-256 ne' accesso al disco
+        const uint64_t quick = ContentHash64(group.data(), group.size(), group.size());
+        auto known = previous.find(quick);
+        std::string hash = known != previous.end() ? known->second : chunks_.Put(group);
+        if (hash.empty()) return false;
+        groupHashes_[quick] = hash;
+        parents.push_back(hash + "\n");
+        group.clear();
+        count = 0;
+        return true;
+    };
+    for (const std::string& line : lines) {
+        group += line;
+        if ((ContentHash64(line) & kGroupMask) == kGroupMask || ++count >= kMaxGroupLines) {
+            if (!close()) return false;
+        }
+    }
+    return group.empty() && !parents.empty() ? true : close();
+}
+
+bool History::ExpandTree(std::vector<std::string> nodes, int depth, const std::function<void(std::string_view)>& onTile,
+                         const std::function<void(const std::string&)>& onNode) const {
+    bool ok = true;
+    for (; depth > 0; --depth) {
+        std::vector<std::string> children;
+        for (const std::string& hash : nodes) {
+            if (onNode) onNode(hash);
+            std::string bytes;
+            if (!chunks_.Get(hash, bytes)) {
+                ok = false;
+                continue;
+            }
+            ForEachLine(bytes, [&](std::string_view line) {
+                if (depth > 1) children.emplace_back(line);
+                else if (onTile) onTile(line);
+            });
+        }
+        nodes = std::move(children);
+    }
+    return ok;
+}
+
+std::vector<int64_t> History::List() const {
+    std::vector<int64_t> times;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(snapshots_, ec), end; !ec && it != end; it.increment(ec)) {
+        int64_t t = 0;
+        if (it->path().extension() == ".snap" && ParseInt64(it->path().stem().string(), t)) times.push_back(t);
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+bool History::Load(int64_t time, HistorySnapshot& out) const {
+    out = HistorySnapshot{};
+    std::string bytes;
+    if (!ReadWholeFile(SnapshotPath(time), bytes) || bytes.compare(0, sizeof(kHeader) - 1, kHeader) != 0) return false;
+
+    out.time = time;
+    int depth = 0;
+    std::vector<std::string> top;
+    ForEachLine(std::string_view(bytes).substr(sizeof(kHeader) - 1), [&](std::string_view line) {
+        const std::string_view kind = NextWord(line);
+        int64_t v = 0;
+        if (kind == "columns") ParseTracks(line, out.columns);
+        if (kind == "rows") ParseTracks(line, out.rows);
+        if (kind == "depth" && ParseInt64(NextWord(line), v)) depth = static_cast<int>(std::clamp<int64_t>(v, 0, kMaxDepth));
+        if (kind == "node") top.emplace_back(NextWord(line));
+    });
+    return ExpandTree(std::move(top), depth, [&](std::string_view line) {
+        HistoryTile t;
+        if (ParseTileLine(line, t)) out.tiles.push_back(std::move(t));
+    }, nullptr);
+}
+
+size_t History::Prune(int64_t now) {
+    const std::vector<int64_t> times = List();
+    if (times.size() <= 1) return 0;
+
+    // per ogni fascia d'eta' si tiene la piu' recente del suo intervallo
+    std::map<std::pair<int, int64_t>, int64_t> keep;
+    for (int64_t t : times) {
+        const int64_t age = now - t;
+        std::pair<int, int64_t> bucket;
+        if (age < kDay) bucket = {0, t};
+        else if (age < 30 * kDay) bucket = {1, t / kHour};
+        else if (age < 365 * kDay) bucket = {2, t / kDay};
+        else bucket = {3, t / (7 * kDay)};
+        int64_t& newest = keep[bucket];
+        newest = std::max(newest, t);
+    }
+
+    std::unordered_set<int64_t> kept;
+    for (const auto& [bucket, t] : keep) kept.insert(t);
+    kept.insert(times.back());
+
+    size_t removed = 0;
+    for (int64_t t : times) {
+        std::error_code ec;
+        if (!kept.count(t) && std::filesystem::remove(SnapshotPath(t), ec)) ++removed;
+    }
+    return removed;
+}
+
+size_t History::CollectGarbage() {
+    std::unordered_set<std::string> live;
+    for (const auto& [id, hash] : lastText_) live.insert(hash);
+    for (int64_t t : List()) {
+        std::string bytes;
+        if (!ReadWholeFile(SnapshotPath(t), bytes)) continue;
+        int depth = 0;
+        std::vector<std::string> top;
+        ForEachLine(bytes, [&](std::string_view line) {
+            const std::string_view kind = NextWord(line);
+            int64_t v = 0;
+            if (kind == "depth" && ParseInt64(NextWord(line), v)) depth = static_cast<int>(std::clamp<int64_t>(v, 0, kMaxDepth));
+            if (kind == "node") top.emplace_back(NextWord(line));
+        });
+        ExpandTree(std::move(top), depth, [&](std::string_view line) {
+            HistoryTile tile;
+            if (ParseTileLine(line, tile)) live.insert(tile.textHash);
+        }, [&](const std::string& hash) { live.insert(hash); });
+    }
+    return chunks_.Sweep(live);
+}
+
+void History::Start() {
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return; // stopping_ e coda finita
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+            job(*this);
+            lock.lock();
+        }
+    });
+}
+
+void History::Post(std::function<void(History&)> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void History::Stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
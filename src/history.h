@@ -0,0 +1,122 @@
+#pragma once
+
+// Cronologia della board: istantanee periodiche in uno store di chunk indirizzati per
+// contenuto (SHA-256), sotto <cartella>/chunks e <cartella>/snapshots.
+// - il testo di ogni tile e' un chunk: tile uguali (anche tra istantanee) si salvano una volta
+// - la geometria sta in righe "id x y w h fit hash" raggruppate a confini decisi dal
+//   contenuto, e i gruppi in un albero dello stesso tipo: una tile cambiata riscrive il
+//   suo gruppo e il percorso fino alla radice, non tutta la lista
+// - l'istantanea vera e' un file piccolo con le tracce e la cima dell'albero
+// Su disco un'istantanea costa i byte cambiati: i testi non toccati non si rileggono
+// ne' si riscrivono, i gruppi non toccati non si riscrivono. Take, Prune e CollectGarbage girano sul thread della cronologia;
+// List, Load e Text leggono solo file e si possono chiamare da qualunque thread.
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+struct HistoryTile {
+    uint64_t id{0};
+    int x{0};
+    int y{0};
+    int w{1};
+    int h{1};
+    bool autoFit{false};
+    std::string textHash; // chunk del testo (UTF-8); vuoto in ingresso a Take
+};
+
+struct HistorySnapshot {
+    int64_t time{0}; // secondi dal 1970, e' anche il nome del file
+    std::vector<std::pair<int, int>> columns; // tracce diverse dal default, come TrackAxis::Overrides
+    std::vector<std::pair<int, int>> rows;
+    std::vector<HistoryTile> tiles; // in ordine di id
+};
+
+// Cosa e' cambiato di una tile passando da un'istantanea a un'altra
+struct HistoryChange {
+    uint64_t id{0};
+    bool added{false};
+    bool removed{false};
+    bool moved{false}; // posizione, dimensioni o autoFit
+    bool text{false};
+};
+
+std::vector<HistoryChange> DiffSnapshots(const HistorySnapshot& from, const HistorySnapshot& to);
+
+class ChunkStore {
+public:
+    void Open(const std::filesystem::path& dir) { dir_ = dir; }
+    // hash del contenuto; il file si scrive solo se non c'e' gia'. Vuoto se la scrittura fallisce.
+    std::string Put(std::string_view bytes);
+    // false se manca o se il contenuto non corrisponde piu' all'hash
+    bool Get(const std::string& hash, std::string& bytes) const;
+    // elimina i chunk fuori da live, ritorna quanti
+    size_t Sweep(const std::unordered_set<std::string>& live);
+
+private:
+    std::filesystem::path PathOf(const std::string& hash) const;
+
+    std::filesystem::path dir_;
+    std::unordered_set<std::string> known_; // su disco di sicuro: Put non li riguarda
+};
+
+class History {
+public:
+    History() = default;
+    ~History();
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+
+    bool Open(const std::filesystem::path& dir);
+
+    // Geometria di tutte le tile, testo solo di quelle cambiate dall'ultima Take (alla
+    // prima: di tutte). Le tile senza testo riusano l'hash della volta prima. false se
+    // non c'e' niente di nuovo rispetto all'ultima istantanea o la scrittura fallisce.
+    bool Take(HistorySnapshot snap, const std::unordered_map<uint64_t, std::string>& texts);
+
+    // Conservazione: tutto l'ultimo giorno, poi una per ora fino a 30 giorni, una al
+    // giorno fino a un anno, una alla settimana oltre. Ritorna quante ne ha tolte.
+    size_t Prune(int64_t now);
+    // chunk non piu' raggiungibili da nessuna istantanea
+    size_t CollectGarbage();
+
+    std::vector<int64_t> List() const; // dalla piu' vecchia
+    bool Load(int64_t time, HistorySnapshot& out) const;
+    bool Text(const std::string& hash, std::string& utf8) const { return chunks_.Get(hash, utf8); }
+
+    // Lavoro in ordine su un thread a parte; Stop finisce la coda prima di uscire.
+    void Start();
+    void Post(std::function<void(History&)> job);
+    void Stop();
+
+private:
+    std::filesystem::path SnapshotPath(int64_t time) const;
+    bool PutLevel(const std::vector<std::string>& lines, std::vector<std::string>& parents,
+                  const std::unordered_map<uint64_t, std::string>& previous);
+    // righe "id x y w h fit hash" sotto i nodi dati; onNode vede anche gli hash dei nodi
+    bool ExpandTree(std::vector<std::string> nodes, int depth, const std::function<void(std::string_view)>& onTile,
+                    const std::function<void(const std::string&)>& onNode) const;
+
+    ChunkStore chunks_;
+    std::filesystem::path snapshots_;
+    std::unordered_map<uint64_t, std::string> lastText_; // id -> hash del testo all'ultima Take
+    std::string lastBody_;                               // ultima istantanea senza la riga del tempo
+    int64_t lastTime_{0};
+    std::unordered_map<uint64_t, std::string> groupHashes_; // XXH64 del gruppo -> SHA-256, dall'ultima Take
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::function<void(History&)>> jobs_;
+    bool stopping_{false};
+};
@@ -0,0 +1,1060 @@
+#include "imagecodec.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+uint32_t Be32(const uint8_t* p) { return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | p[3]; }
+uint32_t Le32(const uint8_t* p) { return p[0] | (uint32_t{p[1]} << 8) | (uint32_t{p[2]} << 16) | (uint32_t{p[3]} << 24); }
+uint16_t Le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+const uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+constexpr uint16_t kLenBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// ---------------------------------------------------------------- inflate (RFC 1951)
+
+// Bit letti dal meno significativo. Oltre la fine arrivano zeri, contati: se se ne
+// consumano (non solo guardati in anticipo) il flusso era troncato.
+class BitReader {
+public:
+    BitReader(const uint8_t* p, size_t n) : p_(p), end_(p + n) {}
+
+    void Refill() {
+        while (bits_ <= 56) {
+            uint64_t b = 0;
+            if (p_ < end_) b = *p_++;
+            else ++fake_;
+            buf_ |= b << bits_;
+            bits_ += 8;
+        }
+    }
+    uint64_t Peek() const { return buf_; }
+    void Drop(int n) {
+        buf_ >>= n;
+        bits_ -= n;
+    }
+    uint32_t Get(int n) {
+        if (n == 0) return 0;
+        if (bits_ < n) Refill();
+        const uint32_t v = static_cast<uint32_t>(buf_ & ((uint64_t{1} << n) - 1));
+        Drop(n);
+        return v;
+    }
+    void AlignByte() { Drop(bits_ & 7); }
+    bool Overrun() const { return fake_ * 8 > bits_; }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    uint64_t buf_{0};
+    int bits_{0};
+    int fake_{0};
+};
+
+constexpr int kFastBits = 10;
+
+struct Huffman {
+    uint16_t fast[1 << kFastBits]; // codici corti: (simbolo << 4) | lunghezza, 0 = piu' lungo
+    uint16_t count[16];
+    uint16_t symbols[288];
+
+    // false se le lunghezze descrivono troppi codici; codici incompleti vanno bene
+    // (una sola distanza e' lecita)
+    bool Build(const uint8_t* lengths, int n) {
+        std::memset(count, 0, sizeof(count));
+        std::memset(fast, 0, sizeof(fast));
+        for (int i = 0; i < n; ++i) ++count[lengths[i]];
+        count[0] = 0;
+        int left = 1;
+        for (int len = 1; len < 16; ++len) {
+            left = (left << 1) - count[len];
+            if (left < 0) return false;
+        }
+        uint16_t offs[16];
+        offs[1] = 0;
+        for (int len = 1; len < 15; ++len) offs[len + 1] = static_cast<uint16_t>(offs[len] + count[len]);
+        for (int i = 0; i < n; ++i) {
+            if (lengths[i]) symbols[offs[lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+        // codici canonici in ordine; nel flusso sono rovesciati (primo bit = il piu' alto)
+        int code = 0;
+        int index = 0;
+        for (int len = 1; len <= kFastBits; ++len) {
+            for (int k = 0; k < count[len]; ++k, ++code, ++index) {
+                int rev = 0;
+                for (int b = 0; b < len; ++b) rev |= ((code >> b) & 1) << (len - 1 - b);
+                for (int r = rev; r < (1 << kFastBits); r += 1 << len) fast[r] = static_cast<uint16_t>((symbols[index] << 4) | len);
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    // -1 se il codice non esiste
+    int Decode(BitReader& in) const {
+        in.Refill();
+        const uint64_t bits = in.Peek();
+        const uint16_t e = fast[bits & ((1 << kFastBits) - 1)];
+        if (e) {
+            in.Drop(e & 15);
+            return e >> 4;
+        }
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (int len = 1; len < 16; ++len) {
+            code |= static_cast<int>((bits >> (len - 1)) & 1);
+            const int n = count[len];
+            if (code - n < first) {
+                in.Drop(len);
+                return symbols[index + (code - first)];
+            }
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+};
+
+// Il risultato esce a blocchi verso out; restano solo gli ultimi 32 KB (la finestra
+// delle distanze). out ritorna false per fermarsi: si ferma senza errore.
+class Inflater {
+public:
+    explicit Inflater(std::function<bool(const uint8_t*, size_t)> out) : out_(std::move(out)), win_(new uint8_t[kWinCap]) {}
+
+    bool Run(const uint8_t* data, size_t size) {
+        // intestazione zlib (RFC 1950): deflate, finestra <= 32 KB, niente dizionario
+        if (size < 2 || (data[0] & 0x0f) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) return false;
+        BitReader in(data + 2, size - 2);
+        bool last = false;
+        while (!last && !stopped_) {
+            last = in.Get(1) != 0;
+            const uint32_t type = in.Get(2);
+            bool ok = false;
+            if (type == 0) ok = Stored(in);
+            else if (type == 1) ok = FixedBlock(in);
+            else if (type == 2) ok = DynamicBlock(in);
+            if (!ok || in.Overrun()) return stopped_;
+        }
+        Flush(true);
+        return true;
+    }
+
+private:
+    static constexpr size_t kWindow = 32768;
+    static constexpr size_t kFlushAt = kWindow + (size_t{1} << 18);
+    static constexpr size_t kWinCap = kFlushAt + 300;
+
+    void Flush(bool final) {
+        if (stopped_ || size_ == sent_) return;
+        if (!out_(win_.get() + sent_, size_ - sent_)) {
+            stopped_ = true;
+            return;
+        }
+        sent_ = size_;
+        if (!final && size_ > kWindow) {
+            std::memmove(win_.get(), win_.get() + size_ - kWindow, kWindow);
+            size_ = sent_ = kWindow;
+        }
+    }
+
+    bool Stored(BitReader& in) {
+        in.AlignByte();
+        const uint32_t len = in.Get(16);
+        const uint32_t nlen = in.Get(16);
+        if ((len ^ 0xffff) != nlen) return false;
+        for (uint32_t i = 0; i < len; ++i) {
+            win_[size_++] = static_cast<uint8_t>(in.Get(8));
+            if (size_ >= kFlushAt) {
+                if (in.Overrun()) return false;
+                Flush(false);
+                if (stopped_) return false;
+            }
+        }
+        return true;
+    }
+
+    bool FixedBlock(BitReader& in) {
+        if (!fixedBuilt_) {
+            uint8_t lengths[288 + 30];
+            std::fill(lengths, lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            std::fill(lengths + 288, lengths + 318, 5);
+            fixedLit_.Build(lengths, 288);
+            fixedDist_.Build(lengths + 288, 30);
+            fixedBuilt_ = true;
+        }
+        return Codes(in, fixedLit_, fixedDist_);
+    }
+
+    bool DynamicBlock(BitReader& in) {
+        static const uint8_t kOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        const int nlen = static_cast<int>(in.Get(5)) + 257;
+        const int ndist = static_cast<int>(in.Get(5)) + 1;
+        const int ncode = static_cast<int>(in.Get(4)) + 4;
+        if (nlen > 286 || ndist > 30) return false;
+
+        uint8_t lengths[320]{};
+        for (int i = 0; i < ncode; ++i) lengths[kOrder[i]] = static_cast<uint8_t>(in.Get(3));
+        Huffman lencode;
+        if (!lencode.Build(lengths, 19)) return false;
+
+        std::memset(lengths, 0, sizeof(lengths));
+        for (int i = 0; i < nlen + ndist;) {
+            const int sym = lencode.Decode(in);
+            if (sym < 0) return false;
+            if (sym < 16) {
+                lengths[i++] = static_cast<uint8_t>(sym);
+                continue;
+            }
+            uint8_t value = 0;
+            int repeat = 0;
+            if (sym == 16) {
+                if (i == 0) return false;
+                value = lengths[i - 1];
+                repeat = 3 + static_cast<int>(in.Get(2));
+            } else if (sym == 17) {
+                repeat = 3 + static_cast<int>(in.Get(3));
+            } else {
+                repeat = 11 + static_cast<int>(in.Get(7));
+            }
+            if (i + repeat > nlen + ndist) return false;
+            while (repeat--) lengths[i++] = value;
+            if (in.Overrun()) return false;
+        }
+        if (lengths[256] == 0) return false; // senza fine blocco non si esce
+        Huffman lit;
+        Huffman dist;
+        if (!lit.Build(lengths, nlen) || !dist.Build(lengths + nlen, ndist)) return false;
+        return Codes(in, lit, dist);
+    }
+
+    bool Codes(BitReader& in, const Huffman& lit, const Huffman& dist) {
+        uint8_t* w = win_.get();
+        for (;;) {
+            const int sym = lit.Decode(in);
+            if (sym < 0 || in.Overrun()) return false;
+            if (sym < 256) {
+                w[size_++] = static_cast<uint8_t>(sym);
+            } else if (sym == 256) {
+                return true;
+            } else {
+                const int li = sym - 257;
+                if (li >= 29) return false;
+                const size_t len = kLenBase[li] + in.Get(kLenExtra[li]);
+                const int di = dist.Decode(in);
+                if (di < 0 || di >= 30) return false;
+                const size_t d = kDistBase[di] + in.Get(kDistExtra[di]);
+                if (d > size_ || in.Overrun()) return false;
+                const uint8_t* from = w + size_ - d;
+                uint8_t* to = w + size_;
+                for (size_t k = 0; k < len; ++k) to[k] = from[k]; // sovrapposti: byte per byte
+                size_ += len;
+            }
+            if (size_ >= kFlushAt) {
+                Flush(false);
+                if (stopped_) return false;
+            }
+        }
+    }
+
+    std::function<bool(const uint8_t*, size_t)> out_;
+    std::unique_ptr<uint8_t[]> win_;
+    size_t size_{0};
+    size_t sent_{0};
+    bool stopped_{false};
+    bool fixedBuilt_{false};
+    Huffman fixedLit_;
+    Huffman fixedDist_;
+};
+
+// ---------------------------------------------------------------- PNG
+
+struct PngHeader {
+    uint32_t width{0};
+    uint32_t height{0};
+    int depth{0};
+    int colorType{0};
+    bool interlaced{false};
+};
+
+int PngChannels(int colorType) {
+    switch (colorType) {
+        case 0: return 1;
+        case 2: return 3;
+        case 3: return 1;
+        case 4: return 2;
+        case 6: return 4;
+    }
+    return 0;
+}
+
+bool PngDepthOk(int colorType, int depth) {
+    switch (colorType) {
+        case 0: return depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+        case 3: return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+        case 2:
+        case 4:
+        case 6: return depth == 8 || depth == 16;
+    }
+    return false;
+}
+
+bool ReadPngHeader(std::string_view bytes, PngHeader& h) {
+    const auto* p = reinterpret_cast<const uint8_t*>(bytes.data());
+    if (bytes.size() < 33 || std::memcmp(p, kPngSignature, 8) != 0 || Be32(p + 8) != 13 || std::memcmp(p + 12, "IHDR", 4) != 0) return false;
+    h.width = Be32(p + 16);
+    h.height = Be32(p + 20);
+    h.depth = p[24];
+    h.colorType = p[25];
+    h.interlaced = p[28] == 1;
+    if (h.width == 0 || h.height == 0 || h.width > 0x7fffffff || h.height > 0x7fffffff) return false;
+    if (!PngDepthOk(h.colorType, h.depth) || p[26] != 0 || p[27] != 0 || p[28] > 1) return false;
+    return static_cast<int64_t>(h.width) * h.height <= kMaxImagePixels;
+}
+
+uint8_t Paeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+bool Unfilter(uint8_t* row, const uint8_t* prev, size_t n, size_t bpp) {
+    const int type = row[-1];
+    switch (type) {
+        case 0: return true;
+        case 1:
+            for (size_t i = bpp; i < n; ++i) row[i] = static_cast<uint8_t>(row[i] + row[i - bpp]);
+            return true;
+        case 2:
+            for (size_t i = 0; i < n; ++i) row[i] = static_cast<uint8_t>(row[i] + prev[i]);
+            return true;
+        case 3:
+            for (size_t i = 0; i < n; ++i) row[i] = static_cast<uint8_t>(row[i] + (((i >= bpp ? row[i - bpp] : 0) + prev[i]) >> 1));
+            return true;
+        case 4:
+            for (size_t i = 0; i < n; ++i) {
+                row[i] = static_cast<uint8_t>(row[i] + Paeth(i >= bpp ? row[i - bpp] : 0, prev[i], i >= bpp ? prev[i - bpp] : 0));
+            }
+            return true;
+    }
+    return false;
+}
+
+struct Adam7Pass {
+    int x0, y0, dx, dy;
+};
+constexpr Adam7Pass kAdam7[7] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+
+class PngDecoder {
+public:
+    PngDecoder(const PngHeader& h, const ImageRows& rows) : h_(h), rows_(rows) {
+        channels_ = PngChannels(h.colorType);
+        bitsPerPixel_ = channels_ * h.depth;
+        bpp_ = std::max<size_t>(1, bitsPerPixel_ / 8);
+        for (int i = 0; i < 256; ++i) palette_[i] = 0xff000000u; // indici fuori palette: nero
+    }
+
+    void SetPalette(const uint8_t* p, size_t entries) {
+        for (size_t i = 0; i < entries && i < 256; ++i) palette_[i] = p[i * 3] | (p[i * 3 + 1] << 8) | (p[i * 3 + 2] << 16) | 0xff000000u;
+        paletteSize_ = entries;
+    }
+    void SetTransparency(const uint8_t* p, size_t n) {
+        if (h_.colorType == 3) {
+            for (size_t i = 0; i < n && i < 256; ++i) palette_[i] = (palette_[i] & 0x00ffffffu) | (uint32_t{p[i]} << 24);
+        } else if (h_.colorType == 0 && n >= 2) {
+            hasKey_ = true;
+            key_[0] = static_cast<uint16_t>((p[0] << 8) | p[1]);
+        } else if (h_.colorType == 2 && n >= 6) {
+            hasKey_ = true;
+            for (int c = 0; c < 3; ++c) key_[c] = static_cast<uint16_t>((p[c * 2] << 8) | p[c * 2 + 1]);
+        }
+    }
+
+    bool Run(const std::vector<uint8_t>& idat) {
+        if (h_.colorType == 3 && paletteSize_ == 0) return false;
+        if (h_.interlaced) full_.assign(static_cast<size_t>(h_.width) * h_.height * 4, 0);
+        line_.resize(static_cast<size_t>(h_.width) * 4);
+        pass_ = h_.interlaced ? -1 : 0;
+        if (h_.interlaced) NextPass();
+        else StartPass(h_.width, h_.height);
+
+        Inflater inflater([this](const uint8_t* p, size_t n) { return Feed(p, n); });
+        if (!inflater.Run(idat.data(), idat.size()) || failed_ || !done_) return false;
+        if (h_.interlaced) {
+            for (uint32_t y = 0; y < h_.height; ++y) rows_.row(static_cast<int>(y), full_.data() + static_cast<size_t>(y) * h_.width * 4);
+        }
+        return true;
+    }
+
+private:
+    void StartPass(uint32_t w, uint32_t h) {
+        passW_ = w;
+        passH_ = h;
+        passY_ = 0;
+        stride_ = (static_cast<size_t>(w) * bitsPerPixel_ + 7) / 8;
+        cur_.assign(stride_ + 1, 0);
+        prev_.assign(stride_ + 1, 0);
+        fill_ = 0;
+    }
+
+    // passata successiva con almeno un pixel; false se erano finite
+    bool NextPass() {
+        while (++pass_ < 7) {
+            const Adam7Pass& p = kAdam7[pass_];
+            const uint32_t w = h_.width > static_cast<uint32_t>(p.x0) ? (h_.width - p.x0 + p.dx - 1) / p.dx : 0;
+            const uint32_t h = h_.height > static_cast<uint32_t>(p.y0) ? (h_.height - p.y0 + p.dy - 1) / p.dy : 0;
+            if (w && h) {
+                StartPass(w, h);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Feed(const uint8_t* p, size_t n) {
+        while (n && !done_) {
+            const size_t take = std::min(n, stride_ + 1 - fill_);
+            std::memcpy(cur_.data() + fill_, p, take);
+            fill_ += take;
+            p += take;
+            n -= take;
+            if (fill_ < stride_ + 1) break;
+            fill_ = 0;
+            if (!Unfilter(cur_.data() + 1, prev_.data() + 1, stride_, bpp_)) {
+                failed_ = true;
+                return false;
+            }
+            EmitRow();
+            std::swap(cur_, prev_);
+            if (++passY_ == passH_ && !(h_.interlaced && NextPass())) done_ = true;
+        }
+        return !done_; // il resto (adler, dati in piu') non serve
+    }
+
+    uint32_t Sample(const uint8_t* row, uint32_t x, int c) const {
+        const int d = h_.depth;
+        if (d == 8) return row[x * channels_ + c];
+        if (d == 16) return (row[(x * channels_ + c) * 2] << 8) | row[(x * channels_ + c) * 2 + 1];
+        const size_t bit = static_cast<size_t>(x) * d; // d < 8: un solo canale
+        return (row[bit >> 3] >> (8 - d - (bit & 7))) & ((1u << d) - 1);
+    }
+
+    uint8_t To8(uint32_t v) const {
+        if (h_.depth == 16) return static_cast<uint8_t>(v >> 8);
+        if (h_.depth == 8) return static_cast<uint8_t>(v);
+        return static_cast<uint8_t>(v * 255 / ((1u << h_.depth) - 1));
+    }
+
+    void EmitRow() {
+        const uint8_t* row = cur_.data() + 1;
+        uint8_t* out = line_.data();
+        for (uint32_t x = 0; x < passW_; ++x, out += 4) {
+            switch (h_.colorType) {
+                case 0: {
+                    const uint32_t v = Sample(row, x, 0);
+                    out[0] = out[1] = out[2] = To8(v);
+                    out[3] = hasKey_ && v == key_[0] ? 0 : 255;
+                    break;
+                }
+                case 2: {
+                    const uint32_t r = Sample(row, x, 0), g = Sample(row, x, 1), b = Sample(row, x, 2);
+                    out[0] = To8(r);
+                    out[1] = To8(g);
+                    out[2] = To8(b);
+                    out[3] = hasKey_ && r == key_[0] && g == key_[1] && b == key_[2] ? 0 : 255;
+                    break;
+                }
+                case 3: {
+                    const uint32_t c = palette_[Sample(row, x, 0) & 0xff];
+                    out[0] = static_cast<uint8_t>(c);
+                    out[1] = static_cast<uint8_t>(c >> 8);
+                    out[2] = static_cast<uint8_t>(c >> 16);
+                    out[3] = static_cast<uint8_t>(c >> 24);
+                    break;
+                }
+                case 4:
+                    out[0] = out[1] = out[2] = To8(Sample(row, x, 0));
+                    out[3] = To8(Sample(row, x, 1));
+                    break;
+                default:
+                    for (int c = 0; c < 4; ++c) out[c] = To8(Sample(row, x, c));
+                    break;
+            }
+        }
+        if (!h_.interlaced) {
+            rows_.row(static_cast<int>(passY_), line_.data());
+            return;
+        }
+        const Adam7Pass& p = kAdam7[pass_];
+        const size_t y = p.y0 + static_cast<size_t>(passY_) * p.dy;
+        for (uint32_t x = 0; x < passW_; ++x) {
+            std::memcpy(full_.data() + (y * h_.width + p.x0 + static_cast<size_t>(x) * p.dx) * 4, line_.data() + x * 4, 4);
+        }
+    }
+
+    PngHeader h_;
+    const ImageRows& rows_;
+    int channels_{0};
+    int bitsPerPixel_{0};
+    size_t bpp_{1};
+    uint32_t palette_[256];
+    size_t paletteSize_{0};
+    bool hasKey_{false};
+    uint16_t key_[3]{};
+
+    int pass_{0};
+    uint32_t passW_{0};
+    uint32_t passH_{0};
+    uint32_t passY_{0};
+    size_t stride_{0};
+    std::vector<uint8_t> cur_;
+    std::vector<uint8_t> prev_;
+    size_t fill_{0};
+    std::vector<uint8_t> line_;
+    std::vector<uint8_t> full_; // solo interlacciati
+    bool done_{false};
+    bool failed_{false};
+};
+
+bool DecodePng(std::string_view bytes, const ImageRows& rows) {
+    PngHeader h;
+    if (!ReadPngHeader(bytes, h)) return false;
+    if (!rows.begin(static_cast<int>(h.width), static_cast<int>(h.height))) return true;
+
+    PngDecoder decoder(h, rows);
+    std::vector<uint8_t> idat; // compressi: di solito molto meno dell'immagine
+    const auto* p = reinterpret_cast<const uint8_t*>(bytes.data());
+    size_t pos = 8;
+    while (pos + 12 <= bytes.size()) {
+        const uint32_t len = Be32(p + pos);
+        if (len > bytes.size() - pos - 12) return false;
+        const uint8_t* type = p + pos + 4;
+        const uint8_t* data = p + pos + 8;
+        if (std::memcmp(type, "PLTE", 4) == 0) {
+            if (len % 3 || len > 768) return false;
+            decoder.SetPalette(data, len / 3);
+        } else if (std::memcmp(type, "tRNS", 4) == 0) {
+            decoder.SetTransparency(data, len);
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            idat.insert(idat.end(), data, data + len);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + static_cast<size_t>(len);
+    }
+    return !idat.empty() && decoder.Run(idat);
+}
+
+// ---------------------------------------------------------------- BMP
+
+struct BmpHeader {
+    int width{0};
+    int height{0};
+    bool topDown{false};
+    int bpp{0};
+    uint32_t masks[4]{}; // r g b a; per 16 e 32 bit
+    uint32_t palette[256]{};
+    size_t pixels{0}; // inizio dei pixel in bytes
+    size_t stride{0};
+};
+
+// dib: dove comincia l'intestazione BITMAPINFOHEADER (o CORE); pixelOffset 0 = subito
+// dopo intestazione, maschere e palette (appunti)
+bool ReadBmpHeader(std::string_view bytes, size_t dib, size_t pixelOffset, BmpHeader& h) {
+    const auto* p = reinterpret_cast<const uint8_t*>(bytes.data());
+    if (bytes.size() < dib + 12) return false;
+    const uint32_t size = Le32(p + dib);
+    if (size < 12 || size > bytes.size() - dib) return false;
+    uint32_t compression = 0;
+    uint32_t colorsUsed = 0;
+    int height = 0;
+    size_t entryBytes = 4;
+    if (size == 12) { // BITMAPCOREHEADER
+        h.width = Le16(p + dib + 4);
+        height = static_cast<int16_t>(Le16(p + dib + 6));
+        h.bpp = Le16(p + dib + 10);
+        entryBytes = 3;
+    } else {
+        if (size < 40) return false;
+        h.width = static_cast<int32_t>(Le32(p + dib + 4));
+        height = static_cast<int32_t>(Le32(p + dib + 8));
+        h.bpp = Le16(p + dib + 14);
+        compression = Le32(p + dib + 16);
+        colorsUsed = Le32(p + dib + 32);
+    }
+    if (h.width <= 0 || height == 0 || height == INT32_MIN) return false;
+    h.topDown = height < 0;
+    h.height = height < 0 ? -height : height;
+    if (static_cast<int64_t>(h.width) * h.height > kMaxImagePixels) return false;
+
+    size_t after = dib + size;
+    if (compression == 3 || compression == 6) { // BI_BITFIELDS, BI_ALPHABITFIELDS
+        if (h.bpp != 16 && h.bpp != 32) return false;
+        const size_t count = compression == 6 ? 4 : 3;
+        const size_t at = size >= 52 ? dib + 40 : after; // V4/V5 le hanno dentro l'intestazione
+        if (at + count * 4 > bytes.size()) return false;
+        for (size_t i = 0; i < count; ++i) h.masks[i] = Le32(p + at + i * 4);
+        if (size >= 56 && compression == 3) h.masks[3] = Le32(p + dib + 52);
+        if (size < 52) after += count * 4;
+    } else if (compression != 0) {
+        return false; // RLE, JPEG e PNG dentro BMP: non servono per gli appunti
+    } else if (h.bpp == 16) {
+        h.masks[0] = 0x7c00;
+        h.masks[1] = 0x03e0;
+        h.masks[2] = 0x001f;
+    } else if (h.bpp == 32 || h.bpp == 24) {
+        h.masks[0] = 0xff0000;
+        h.masks[1] = 0x00ff00;
+        h.masks[2] = 0x0000ff; // BI_RGB a 32 bit: il quarto byte non e' alfa
+    }
+
+    if (h.bpp == 1 || h.bpp == 4 || h.bpp == 8) {
+        size_t entries = colorsUsed ? colorsUsed : size_t{1} << h.bpp;
+        if (entries > 256) return false;
+        if (after + entries * entryBytes > bytes.size()) return false;
+        for (size_t i = 0; i < entries; ++i) {
+            const uint8_t* e = p + after + i * entryBytes;
+            h.palette[i] = e[2] | (e[1] << 8) | (e[0] << 16) | 0xff000000u;
+        }
+        after += entries * entryBytes;
+    } else if (h.bpp != 16 && h.bpp != 24 && h.bpp != 32) {
+        return false;
+    }
+
+    h.pixels = pixelOffset ? pixelOffset : after;
+    h.stride = (static_cast<size_t>(h.width) * h.bpp + 31) / 32 * 4;
+    return h.pixels <= bytes.size() && h.stride * h.height <= bytes.size() - h.pixels;
+}
+
+// valore del canale sotto mask, portato a 8 bit
+uint8_t MaskChannel(uint32_t v, uint32_t mask) {
+    if (!mask) return 0;
+    int shift = 0;
+    while (!((mask >> shift) & 1)) ++shift;
+    const uint32_t max = mask >> shift;
+    return static_cast<uint8_t>(((v & mask) >> shift) * 255 / max);
+}
+
+bool DecodeBmpAt(std::string_view bytes, size_t dib, size_t pixelOffset, const ImageRows& rows) {
+    BmpHeader h;
+    if (!ReadBmpHeader(bytes, dib, pixelOffset, h)) return false;
+    if (!rows.begin(h.width, h.height)) return true;
+
+    const auto* base = reinterpret_cast<const uint8_t*>(bytes.data()) + h.pixels;
+    std::vector<uint8_t> line(static_cast<size_t>(h.width) * 4);
+    for (int r = 0; r < h.height; ++r) {
+        const uint8_t* src = base + h.stride * r;
+        uint8_t* out = line.data();
+        for (int x = 0; x < h.width; ++x, out += 4) {
+            uint32_t rgba = 0;
+            if (h.bpp <= 8) {
+                const size_t bit = static_cast<size_t>(x) * h.bpp;
+                const uint32_t index = (src[bit >> 3] >> (8 - h.bpp - (bit & 7))) & ((1u << h.bpp) - 1);
+                rgba = h.palette[index];
+                out[0] = static_cast<uint8_t>(rgba);
+                out[1] = static_cast<uint8_t>(rgba >> 8);
+                out[2] = static_cast<uint8_t>(rgba >> 16);
+                out[3] = 255;
+                continue;
+            }
+            const uint32_t v = h.bpp == 16 ? Le16(src + x * 2) : h.bpp == 24 ? (src[x * 3] | (src[x * 3 + 1] << 8) | (src[x * 3 + 2] << 16)) : Le32(src + x * 4);
+            out[0] = MaskChannel(v, h.masks[0]);
+            out[1] = MaskChannel(v, h.masks[1]);
+            out[2] = MaskChannel(v, h.masks[2]);
+            out[3] = h.masks[3] ? MaskChannel(v, h.masks[3]) : 255;
+        }
+        rows.row(h.topDown ? r : h.height - 1 - r, line.data());
+    }
+    return true;
+}
+
+bool IsBmp(std::string_view bytes) { return bytes.size() >= 26 && bytes[0] == 'B' && bytes[1] == 'M'; }
+
+ImageRows Collect(Image& out) {
+    return ImageRows{
+        [&out](int w, int h) {
+            out.width = w;
+            out.height = h;
+            out.rgba.assign(static_cast<size_t>(w) * h * 4, 0);
+            return true;
+        },
+        [&out](int y, const uint8_t* rgba) { std::memcpy(out.rgba.data() + static_cast<size_t>(y) * out.width * 4, rgba, static_cast<size_t>(out.width) * 4); }};
+}
+
+// ---------------------------------------------------------------- deflate veloce + PNG
+
+uint32_t Crc32(const uint8_t* p, size_t n, uint32_t crc = 0) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i) crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t Adler32(const uint8_t* p, size_t n) {
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (n) {
+        const size_t k = std::min<size_t>(n, 5552); // prima che b esca dai 32 bit
+        for (size_t i = 0; i < k; ++i) {
+            a += p[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        p += k;
+        n -= k;
+    }
+    return (b << 16) | a;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::string& out) : out_(out) {}
+    void Put(uint32_t v, int n) {
+        buf_ |= uint64_t{v} << bits_;
+        bits_ += n;
+        while (bits_ >= 8) {
+            out_.push_back(static_cast<char>(buf_ & 0xff));
+            buf_ >>= 8;
+            bits_ -= 8;
+        }
+    }
+    void Finish() {
+        if (bits_) out_.push_back(static_cast<char>(buf_ & 0xff));
+        buf_ = 0;
+        bits_ = 0;
+    }
+
+private:
+    std::string& out_;
+    uint64_t buf_{0};
+    int bits_{0};
+};
+
+uint32_t Reverse(uint32_t code, int len) {
+    uint32_t r = 0;
+    for (int i = 0; i < len; ++i) r |= ((code >> i) & 1) << (len - 1 - i);
+    return r;
+}
+
+// Un solo blocco a codici fissi con LZ77 a catene di hash corte: le schermate (grandi
+// tinte unite, righe ripetute) si riducono gia' molto; conta la velocita'.
+std::string ZlibCompress(const uint8_t* data, size_t n) {
+    struct Code {
+        uint16_t bits;
+        uint8_t len;
+    };
+    static const auto lit = [] {
+        std::vector<Code> t(288);
+        for (uint32_t s = 0; s < 288; ++s) {
+            if (s < 144) t[s] = {static_cast<uint16_t>(Reverse(0x30 + s, 8)), 8};
+            else if (s < 256) t[s] = {static_cast<uint16_t>(Reverse(0x190 + s - 144, 9)), 9};
+            else if (s < 280) t[s] = {static_cast<uint16_t>(Reverse(s - 256, 7)), 7};
+            else t[s] = {static_cast<uint16_t>(Reverse(0xc0 + s - 280, 8)), 8};
+        }
+        return t;
+    }();
+    static const auto lenCode = [] {
+        std::vector<uint8_t> t(259);
+        for (int i = 0; i < 29; ++i) {
+            for (int l = kLenBase[i]; l < (i == 28 ? 259 : kLenBase[i + 1]); ++l) t[l] = static_cast<uint8_t>(i);
+        }
+        return t;
+    }();
+
+    std::string out;
+    out.reserve(n / 4 + 64);
+    out.push_back(0x78);
+    out.push_back(0x01);
+    BitWriter bw(out);
+    bw.Put(1, 1); // ultimo blocco
+    bw.Put(1, 2); // codici fissi
+
+    constexpr int kHashBits = 15;
+    constexpr size_t kWindow = 32768;
+    constexpr int kMaxChain = 8;
+    std::vector<int32_t> head(size_t{1} << kHashBits, -1);
+    std::vector<int32_t> prev(kWindow, -1);
+    auto hashAt = [&](size_t i) { return ((uint32_t{data[i]} << 16 | uint32_t{data[i + 1]} << 8 | data[i + 2]) * 2654435761u) >> (32 - kHashBits); };
+    auto insert = [&](size_t i) {
+        const uint32_t hv = hashAt(i);
+        prev[i & (kWindow - 1)] = head[hv];
+        head[hv] = static_cast<int32_t>(i);
+    };
+
+    size_t i = 0;
+    while (i < n) {
+        size_t bestLen = 0;
+        size_t bestDist = 0;
+        if (i + 3 <= n) {
+            const size_t maxLen = std::min<size_t>(258, n - i);
+            int32_t cand = head[hashAt(i)];
+            for (int chain = 0; cand >= 0 && chain < kMaxChain; ++chain) {
+                const size_t d = i - static_cast<size_t>(cand);
+                if (d > kWindow - 1) break; // le posizioni piu' vecchie del giro sono gia' state sovrascritte
+                if (data[cand + bestLen] == data[i + bestLen]) {
+                    size_t l = 0;
+                    while (l < maxLen && data[cand + l] == data[i + l]) ++l;
+                    if (l > bestLen) {
+                        bestLen = l;
+                        bestDist = d;
+                        if (l == maxLen) break;
+                    }
+                }
+                const int32_t next = prev[cand & (kWindow - 1)];
+                if (next >= cand) break;
+                cand = next;
+            }
+        }
+        if (bestLen >= 3) {
+            const int li = lenCode[bestLen];
+            bw.Put(lit[257 + li].bits, lit[257 + li].len);
+            if (kLenExtra[li]) bw.Put(static_cast<uint32_t>(bestLen - kLenBase[li]), kLenExtra[li]);
+            int di = 29;
+            while (kDistBase[di] > bestDist) --di;
+            bw.Put(Reverse(static_cast<uint32_t>(di), 5), 5);
+            if (kDistExtra[di]) bw.Put(static_cast<uint32_t>(bestDist - kDistBase[di]), kDistExtra[di]);
+            // dentro una ripetizione lunga bastano le prime posizioni: le altre trovano la stessa cosa
+            const size_t end = i + bestLen;
+            const size_t indexed = std::min(end, i + 16);
+            for (; i < indexed; ++i) {
+                if (i + 3 <= n) insert(i);
+            }
+            i = end;
+        } else {
+            bw.Put(lit[data[i]].bits, lit[data[i]].len);
+            if (i + 3 <= n) insert(i);
+            ++i;
+        }
+    }
+    bw.Put(lit[256].bits, lit[256].len);
+    bw.Finish();
+    const uint32_t adler = Adler32(data, n);
+    for (int s = 24; s >= 0; s -= 8) out.push_back(static_cast<char>((adler >> s) & 0xff));
+    return out;
+}
+
+void FilterRow(uint8_t type, const uint8_t* cur, const uint8_t* prev, uint8_t* out, size_t n, size_t bpp) {
+    const size_t head = std::min(bpp, n);
+    switch (type) {
+        case 0:
+            std::memcpy(out, cur, n);
+            break;
+        case 1:
+            std::memcpy(out, cur, head);
+            for (size_t i = bpp; i < n; ++i) out[i] = static_cast<uint8_t>(cur[i] - cur[i - bpp]);
+            break;
+        case 2:
+            for (size_t i = 0; i < n; ++i) out[i] = static_cast<uint8_t>(cur[i] - prev[i]);
+            break;
+        case 3:
+            for (size_t i = 0; i < head; ++i) out[i] = static_cast<uint8_t>(cur[i] - (prev[i] >> 1));
+            for (size_t i = bpp; i < n; ++i) out[i] = static_cast<uint8_t>(cur[i] - ((cur[i - bpp] + prev[i]) >> 1));
+            break;
+        default:
+            for (size_t i = 0; i < head; ++i) out[i] = static_cast<uint8_t>(cur[i] - prev[i]);
+            for (size_t i = bpp; i < n; ++i) {
+                // Paeth senza salti (la stessa scelta di Paeth()): sulle foto i salti non si indovinano
+                const int a = cur[i - bpp], b = prev[i], c = prev[i - bpp];
+                const int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+                const int m1 = -static_cast<int>(pb <= pc);
+                const int m2 = -static_cast<int>((pa <= pb) & (pa <= pc));
+                const int pred = (a & m2) | (((b & m1) | (c & ~m1)) & ~m2);
+                out[i] = static_cast<uint8_t>(cur[i] - pred);
+            }
+            break;
+    }
+}
+
+void PutBe32(std::string& out, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8) out.push_back(static_cast<char>((v >> s) & 0xff));
+}
+
+void PutChunk(std::string& out, const char* type, const std::string& data) {
+    PutBe32(out, static_cast<uint32_t>(data.size()));
+    const size_t start = out.size();
+    out.append(type, 4);
+    out += data;
+    PutBe32(out, Crc32(reinterpret_cast<const uint8_t*>(out.data() + start), out.size() - start));
+}
+
+} // namespace
+
+bool ImageSize(std::string_view bytes, int& width, int& height) {
+    PngHeader png;
+    if (ReadPngHeader(bytes, png)) {
+        width = static_cast<int>(png.width);
+        height = static_cast<int>(png.height);
+        return true;
+    }
+    BmpHeader bmp;
+    if (IsBmp(bytes) && ReadBmpHeader(bytes, 14, Le32(reinterpret_cast<const uint8_t*>(bytes.data()) + 10), bmp)) {
+        width = bmp.width;
+        height = bmp.height;
+        return true;
+    }
+    return false;
+}
+
+bool DecodeImage(std::string_view bytes, const ImageRows& rows) {
+    if (bytes.size() >= 8 && std::memcmp(bytes.data(), kPngSignature, 8) == 0) return DecodePng(bytes, rows);
+    if (IsBmp(bytes)) return DecodeBmpAt(bytes, 14, Le32(reinterpret_cast<const uint8_t*>(bytes.data()) + 10), rows);
+    return false;
+}
+
+bool DecodeImage(std::string_view bytes, Image& out) {
+    out = Image{};
+    if (DecodeImage(bytes, Collect(out)) && out.width) return true;
+    out = Image{};
+    return false;
+}
+
+bool DecodeDib(std::string_view dib, Image& out) {
+    out = Image{};
+    if (DecodeBmpAt(dib, 0, 0, Collect(out)) && out.width) return true;
+    out = Image{};
+    return false;
+}
+
+void ThumbnailSize(int width, int height, int maxSide, int& outWidth, int& outHeight) {
+    const int longest = std::max(width, height);
+    if (longest <= maxSide) {
+        outWidth = width;
+        outHeight = height;
+        return;
+    }
+    outWidth = std::max(1, static_cast<int>((static_cast<int64_t>(width) * maxSide + longest / 2) / longest));
+    outHeight = std::max(1, static_cast<int>((static_cast<int64_t>(height) * maxSide + longest / 2) / longest));
+}
+
+bool MakeThumbnail(std::string_view bytes, int maxSide, uint32_t background, Image& out) {
+    out = Image{};
+    int srcW = 0;
+    int srcH = 0;
+    std::vector<uint32_t> colOf;  // colonna di destinazione di ogni colonna sorgente
+    std::vector<uint32_t> colN;   // colonne sorgente per colonna di destinazione
+    std::vector<uint32_t> rowN;
+    std::vector<uint64_t> sums;   // r*a, g*a, b*a (/255) e a per pixel di destinazione
+    ImageRows rows{
+        [&](int w, int h) {
+            srcW = w;
+            srcH = h;
+            ThumbnailSize(w, h, std::max(1, maxSide), out.width, out.height);
+            colOf.resize(w);
+            colN.assign(out.width, 0);
+            rowN.assign(out.height, 0);
+            for (int x = 0; x < w; ++x) {
+                colOf[x] = static_cast<uint32_t>(static_cast<int64_t>(x) * out.width / w);
+                ++colN[colOf[x]];
+            }
+            for (int y = 0; y < h; ++y) ++rowN[static_cast<int64_t>(y) * out.height / h];
+            sums.assign(static_cast<size_t>(out.width) * out.height * 4, 0);
+            return true;
+        },
+        [&](int y, const uint8_t* rgba) {
+            uint64_t* acc = sums.data() + static_cast<size_t>(static_cast<int64_t>(y) * out.height / srcH) * out.width * 4;
+            for (int x = 0; x < srcW; ++x, rgba += 4) {
+                uint64_t* a = acc + colOf[x] * 4;
+                const uint32_t alpha = rgba[3];
+                a[0] += rgba[0] * alpha / 255;
+                a[1] += rgba[1] * alpha / 255;
+                a[2] += rgba[2] * alpha / 255;
+                a[3] += alpha;
+            }
+        }};
+    if (!DecodeImage(bytes, rows) || !out.width) {
+        out = Image{};
+        return false;
+    }
+
+    const uint32_t bg[3] = {(background >> 16) & 0xff, (background >> 8) & 0xff, background & 0xff};
+    out.rgba.resize(static_cast<size_t>(out.width) * out.height * 4);
+    for (int y = 0; y < out.height; ++y) {
+        for (int x = 0; x < out.width; ++x) {
+            const size_t i = (static_cast<size_t>(y) * out.width + x) * 4;
+            const uint64_t n = uint64_t{colN[x]} * rowN[y];
+            if (!n) continue; // non capita: la miniatura non e' mai piu' grande dell'originale
+            const uint64_t alpha = (sums[i + 3] + n / 2) / n;
+            for (int c = 0; c < 3; ++c) out.rgba[i + c] = static_cast<uint8_t>(std::min<uint64_t>(255, (sums[i + c] + n / 2) / n + bg[c] * (255 - alpha) / 255));
+            out.rgba[i + 3] = 255;
+        }
+    }
+    return true;
+}
+
+std::string EncodePng(const Image& image) {
+    if (image.width <= 0 || image.height <= 0 || image.rgba.size() < static_cast<size_t>(image.width) * image.height * 4) return {};
+    bool opaque = true;
+    for (size_t i = 3; i < image.rgba.size() && opaque; i += 4) opaque = image.rgba[i] == 255;
+    const size_t channels = opaque ? 3 : 4;
+    const size_t stride = static_cast<size_t>(image.width) * channels;
+
+    // per ogni riga il filtro con la somma dei valori assoluti piu' bassa (euristica della specifica)
+    std::vector<uint8_t> raw((stride + 1) * image.height);
+    std::vector<uint8_t> cur(stride);
+    std::vector<uint8_t> prev(stride, 0);
+    std::vector<uint8_t> trial(stride);
+    std::vector<uint8_t> best(stride);
+    for (int y = 0; y < image.height; ++y) {
+        const uint8_t* src = image.rgba.data() + static_cast<size_t>(y) * image.width * 4;
+        if (opaque) {
+            for (int x = 0; x < image.width; ++x) std::memcpy(&cur[x * 3], src + x * 4, 3);
+        } else {
+            std::memcpy(cur.data(), src, stride);
+        }
+        uint64_t bestCost = UINT64_MAX;
+        uint8_t bestType = 0;
+        for (uint8_t type = 0; type < 5; ++type) {
+            // Paeth costa quanto gli altri quattro insieme: solo per le righe che non si
+            // riducono gia' quasi a zero (foto, sfumature)
+            if (type == 4 && bestCost <= stride) break;
+            FilterRow(type, cur.data(), prev.data(), trial.data(), stride, channels);
+            uint64_t cost = 0;
+            for (size_t i = 0; i < stride; ++i) cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(trial[i])));
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestType = type;
+                best.swap(trial);
+            }
+        }
+        uint8_t* dst = raw.data() + static_cast<size_t>(y) * (stride + 1);
+        dst[0] = bestType;
+        std::memcpy(dst + 1, best.data(), stride);
+        prev.swap(cur);
+    }
+
+    std::string ihdr;
+    PutBe32(ihdr, static_cast<uint32_t>(image.width));
+    PutBe32(ihdr, static_cast<uint32_t>(image.height));
+    ihdr.push_back(8);
+    ihdr.push_back(static_cast<char>(opaque ? 2 : 6));
+    ihdr.append(3, '\0');
+
+    std::string out(reinterpret_cast<const char*>(kPngSignature), 8);
+    PutChunk(out, "IHDR", ihdr);
+    PutChunk(out, "IDAT", ZlibCompress(raw.data(), raw.size()));
+    PutChunk(out, "IEND", {});
+    return out;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Immagini degli allegati senza librerie esterne: PNG (tutti i tipi di colore e le
+// profondita', anche interlacciati) e BMP in lettura, PNG in scrittura. Un PNG si
+// decomprime a pezzi e le righe escono man mano: per una miniatura non serve mai
+// l'immagine intera in memoria (tranne i PNG interlacciati, che arrivano a passate).
+//
+// Miniature: la media dei pixel che cadono in ogni pixel di destinazione (riduzione a
+// box, con l'alfa), composta su un colore di fondo. Mai ingrandite oltre l'originale.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// RGBA 8 bit per canale, non premoltiplicato, righe dall'alto
+struct Image {
+    int width{0};
+    int height{0};
+    std::vector<uint8_t> rgba;
+};
+
+struct ImageRows {
+    std::function<bool(int width, int height)> begin; // false: non interessa, ci si ferma
+    std::function<void(int y, const uint8_t* rgba)> row; // una volta per riga, in qualunque ordine
+};
+
+// immagini piu' grandi non si aprono (quasi sempre file rovinati o costruiti apposta)
+constexpr int64_t kMaxImagePixels = int64_t{1} << 27;
+
+// dimensioni dall'intestazione, senza decodificare; false se non e' un PNG o BMP
+bool ImageSize(std::string_view bytes, int& width, int& height);
+bool DecodeImage(std::string_view bytes, const ImageRows& rows);
+bool DecodeImage(std::string_view bytes, Image& out);
+
+// DIB degli appunti (CF_DIB: BITMAPINFOHEADER, colori e pixel, senza intestazione di file)
+bool DecodeDib(std::string_view dib, Image& out);
+
+// il lato piu' lungo al massimo maxSide; background 0xRRGGBB, il risultato e' opaco
+bool MakeThumbnail(std::string_view bytes, int maxSide, uint32_t background, Image& out);
+// dimensioni della miniatura di un'immagine width x height
+void ThumbnailSize(int width, int height, int maxSide, int& outWidth, int& outHeight);
+
+// PNG RGBA (RGB se l'immagine e' tutta opaca), compressione veloce
+std::string EncodePng(const Image& image);
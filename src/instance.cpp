@@ -0,0 +1,80 @@
+#include "instance.h"
+
+#include "ipc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+SingleInstanceGuard::~SingleInstanceGuard() { Release(); }
+
+#ifdef _WIN32
+
+bool SingleInstanceGuard::Acquire(const std::string& name) {
+    Release();
+    const std::wstring wname = L"Local\\" + std::wstring(name.begin(), name.end());
+    mutex_ = CreateMutexW(nullptr, TRUE, wname.c_str());
+    if (!mutex_) return true; // senza mutex non possiamo coordinarci: meglio partire comunque
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mutex_);
+        mutex_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void SingleInstanceGuard::Release() {
+    if (!mutex_) return;
+    ReleaseMutex(mutex_);
+    CloseHandle(mutex_);
+    mutex_ = nullptr;
+}
+
+#else
+
+bool SingleInstanceGuard::Acquire(const std::string& name) {
+    Release();
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    const std::string dir = runtime && *runtime ? runtime : "/tmp";
+    lockPath_ = dir + "/" + name + "-" + std::to_string(getuid()) + ".lock";
+
+    lockFd_ = open(lockPath_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd_ < 0) return true;
+    // il lock sparisce con il processo: nessun file "orfano" da ripulire dopo un crash
+    if (flock(lockFd_, LOCK_EX | LOCK_NB) != 0) {
+        close(lockFd_);
+        lockFd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+void SingleInstanceGuard::Release() {
+    if (lockFd_ < 0) return;
+    flock(lockFd_, LOCK_UN);
+    close(lockFd_);
+    lockFd_ = -1;
+}
+
+#endif
+
+bool ForwardToPrimary(const std::string& endpoint, const std::vector<std::string>& args, unsigned timeoutMs) {
+    IpcClient client;
+    if (!client.Connect(endpoint, timeoutMs)) return false;
+
+    std::string line = "{\"id\":1,\"cmd\":\"activate\",\"args\":[";
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i) line += ",";
+        line += JsonQuoteUtf8(args[i]);
+    }
+    line += "]}";
+    if (!client.Send(line)) return false;
+
+    std::string reply;
+    return client.ReadLine(reply);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Istanza unica: la prima esecuzione tiene il lock, le successive inoltrano la
+// riga di comando all'istanza attiva (via endpoint IPC) ed escono subito.
+// Windows: named mutex. Linux: lock file (flock) + socket unix dell'IPC.
+
+#include <string>
+#include <vector>
+
+class SingleInstanceGuard {
+public:
+    SingleInstanceGuard() = default;
+    ~SingleInstanceGuard();
+    SingleInstanceGuard(const SingleInstanceGuard&) = delete;
+    SingleInstanceGuard& operator=(const SingleInstanceGuard&) = delete;
+
+    // true se questo processo e' l'istanza primaria
+    bool Acquire(const std::string& name);
+    void Release();
+
+private:
+#ifdef _WIN32
+    void* mutex_{nullptr};
+#else
+    int lockFd_{-1};
+    std::string lockPath_;
+#endif
+};
+
+// Manda {"cmd":"activate","args":[...]} all'istanza primaria e attende la risposta.
+// timeoutMs copre anche il caso in cui la primaria stia ancora avviando l'endpoint.
+bool ForwardToPrimary(const std::string& endpoint, const std::vector<std::string>& args, unsigned timeoutMs);
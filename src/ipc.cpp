@@ -0,0 +1,862 @@
+#include "ipc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// --- parser JSON minimale: un oggetto piatto con stringhe, numeri, bool e array di stringhe ---
+
+struct Cursor {
+    const std::string& s;
+    size_t i{0};
+
+    void SkipWs() {
+        while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+    }
+    bool Eat(char c) {
+        SkipWs();
+        if (i < s.size() && s[i] == c) { ++i; return true; }
+        return false;
+    }
+};
+
+void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+bool ReadHex4(Cursor& c, uint32_t& v) {
+    if (c.i + 4 > c.s.size()) return false;
+    v = 0;
+    for (int k = 0; k < 4; ++k) {
+        const char h = c.s[c.i++];
+        v <<= 4;
+        if (h >= '0' && h <= '9') v |= h - '0';
+        else if (h >= 'a' && h <= 'f') v |= h - 'a' + 10;
+        else if (h >= 'A' && h <= 'F') v |= h - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+bool ParseString(Cursor& c, std::string& out) {
+    c.SkipWs();
+    if (c.i >= c.s.size() || c.s[c.i] != '"') return false;
+    ++c.i;
+    out.clear();
+    while (c.i < c.s.size()) {
+        const char ch = c.s[c.i++];
+        if (ch == '"') return true;
+        if (ch != '\\') { out += ch; continue; }
+        if (c.i >= c.s.size()) return false;
+        const char e = c.s[c.i++];
+        switch (e) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp = 0;
+                if (!ReadHex4(c, cp)) return false;
+                if (cp >= 0xD800 && cp <= 0xDBFF && c.i + 6 <= c.s.size() && c.s[c.i] == '\\' && c.s[c.i + 1] == 'u') {
+                    c.i += 2;
+                    uint32_t lo = 0;
+                    if (!ReadHex4(c, lo)) return false;
+                    if (lo >= 0xDC00 && lo <= 0xDFFF) cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    else { AppendUtf8(out, 0xFFFD); cp = lo; }
+                }
+                if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+                AppendUtf8(out, cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+struct JsonField {
+    enum Kind { Null, Bool, Number, String, Array } kind{Null};
+    std::string str;
+    long long num{0};
+    bool b{false};
+    std::vector<std::string> items;
+};
+
+bool ParseValue(Cursor& c, JsonField& v) {
+    c.SkipWs();
+    if (c.i >= c.s.size()) return false;
+    const char ch = c.s[c.i];
+    if (ch == '"') { v.kind = JsonField::String; return ParseString(c, v.str); }
+    if (ch == '[') {
+        ++c.i;
+        v.kind = JsonField::Array;
+        if (c.Eat(']')) return true;
+        do {
+            std::string item;
+            if (!ParseString(c, item)) return false;
+            v.items.push_back(std::move(item));
+        } while (c.Eat(','));
+        return c.Eat(']');
+    }
+    if (c.s.compare(c.i, 4, "true") == 0) { c.i += 4; v.kind = JsonField::Bool; v.b = true; return true; }
+    if (c.s.compare(c.i, 5, "false") == 0) { c.i += 5; v.kind = JsonField::Bool; v.b = false; return true; }
+    if (c.s.compare(c.i, 4, "null") == 0) { c.i += 4; v.kind = JsonField::Null; return true; }
+
+    const size_t start = c.i;
+    if (c.s[c.i] == '-' || c.s[c.i] == '+') ++c.i;
+    while (c.i < c.s.size() && ((c.s[c.i] >= '0' && c.s[c.i] <= '9') || c.s[c.i] == '.' || c.s[c.i] == 'e' || c.s[c.i] == 'E')) ++c.i;
+    if (c.i == start) return false;
+    v.kind = JsonField::Number;
+    v.num = std::strtoll(c.s.c_str() + start, nullptr, 10);
+    return true;
+}
+
+IpcOp OpFromName(const std::string& name) {
+    if (name == "list") return IpcOp::List;
+    if (name == "get") return IpcOp::Get;
+    if (name == "set") return IpcOp::Set;
+    if (name == "split") return IpcOp::Split;
+    if (name == "subscribe") return IpcOp::Subscribe;
+    if (name == "activate") return IpcOp::Activate;
+    if (name == "stats") return IpcOp::Stats;
+    return IpcOp::Unknown;
+}
+
+} // namespace
+
+IpcCommand ParseIpcLine(const std::string& line) {
+    IpcCommand cmd;
+    Cursor c{line};
+    if (!c.Eat('{')) { cmd.error = "expected object"; return cmd; }
+    if (!c.Eat('}')) {
+        do {
+            std::string key;
+            JsonField v;
+            if (!ParseString(c, key) || !c.Eat(':') || !ParseValue(c, v)) {
+                cmd.error = "malformed json";
+                return cmd;
+            }
+            if (key == "id" && v.kind == JsonField::Number) cmd.reqId = v.num;
+            else if (key == "cmd" && v.kind == JsonField::String) cmd.cmd = v.str;
+            else if (key == "tile" && v.kind == JsonField::Number) cmd.tile = static_cast<uint64_t>(v.num);
+            else if (key == "text" && v.kind == JsonField::String) cmd.text = std::move(v.str);
+            else if (key == "mode" && v.kind == JsonField::String) cmd.mode = v.str;
+            else if (key == "args" && v.kind == JsonField::Array) cmd.args = std::move(v.items);
+        } while (c.Eat(','));
+        if (!c.Eat('}')) { cmd.error = "malformed json"; return cmd; }
+    }
+    cmd.op = OpFromName(cmd.cmd);
+    if (cmd.cmd.empty()) cmd.error = "missing cmd";
+    return cmd;
+}
+
+std::string JsonQuoteUtf8(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 2);
+    out += '"';
+    for (unsigned char ch : s) {
+        switch (ch) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (ch < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(ch);
+                }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+std::string IpcOkReply(long long reqId, const std::string& extraFields) {
+    std::string out = "{\"id\":" + std::to_string(reqId) + ",\"ok\":true";
+    if (!extraFields.empty()) out += "," + extraFields;
+    out += "}";
+    return out;
+}
+
+std::string IpcErrorReply(long long reqId, const std::string& message) {
+    return "{\"id\":" + std::to_string(reqId) + ",\"ok\":false,\"error\":" + JsonQuoteUtf8(message) + "}";
+}
+
+bool IpcLineFramer::Feed(const char* data, size_t len, std::vector<std::string>& lines) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (data[i] != '\n') continue;
+        pending_.append(data + start, i - start);
+        if (!pending_.empty() && pending_.back() == '\r') pending_.pop_back();
+        if (!pending_.empty()) lines.push_back(std::move(pending_));
+        pending_.clear();
+        start = i + 1;
+    }
+    pending_.append(data + start, len - start);
+    return pending_.size() <= kMaxLine;
+}
+
+std::string IpcDefaultEndpoint() {
+#ifdef _WIN32
+    char user[128]{};
+    DWORD n = GetEnvironmentVariableA("USERNAME", user, sizeof(user));
+    std::string name = n > 0 && n < sizeof(user) ? user : "default";
+    return "\\\\.\\pipe\\GridNotes-" + name;
+#else
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) return std::string(runtime) + "/gridnotes.sock";
+    // in /tmp il socket sta in una cartella dell'utente a 0700 (la crea IpcServer::Start)
+    return "/tmp/gridnotes-" + std::to_string(getuid()) + "/gridnotes.sock";
+#endif
+}
+
+// --- stato condiviso tra thread di I/O e thread UI ---
+
+struct IpcServer::Impl {
+    // Risposte ed eventi non ancora scritti, per client. Il thread di I/O continua a leggere
+    // mentre scrive, quindi chi manda comandi in pipeline senza leggere le risposte non
+    // blocca nessuno: oltre questo tetto pero' il client si chiude.
+    static constexpr size_t kMaxOutbox = 16u << 20;
+
+    struct Client {
+        std::string outbox;
+        bool subscribed{false};
+        bool overflow{false}; // outbox oltre kMaxOutbox: da chiudere
+#ifdef _WIN32
+        HANDLE pipe{INVALID_HANDLE_VALUE};
+        HANDLE outEvent{nullptr}; // vive quanto l'ultimo shared_ptr: Reply/Publish lo segnalano fuori dal lock
+        std::atomic<bool> finished{false}; // ClientLoop uscito: il thread si puo' raccogliere
+        ~Client() {
+            if (outEvent) CloseHandle(outEvent);
+        }
+#else
+        int fd{-1};
+        IpcLineFramer framer;
+#endif
+    };
+
+#ifdef _WIN32
+    struct Worker {
+        std::thread thread;
+        std::shared_ptr<Client> client;
+    };
+#endif
+
+    mutable std::mutex mu;
+    std::deque<IpcCommand> queue;
+    std::map<uint64_t, std::shared_ptr<Client>> clients;
+    uint64_t nextClient{1};
+    size_t subscribers{0};
+    WakeFn wake;
+    std::atomic<bool> running{false};
+    std::thread ioThread;
+#ifdef _WIN32
+    std::wstring pipeName;
+    HANDLE stopEvent{nullptr};
+    std::vector<Worker> clientThreads; // solo AcceptLoop (e Stop, dopo averlo fermato)
+#else
+    std::string path;
+    int listenFd{-1};
+    int wakeRd{-1};
+    int wakeWr{-1};
+#endif
+
+    // chiamata dai thread di I/O con mu NON acquisito
+    void Enqueue(uint64_t client, std::vector<std::string>& lines) {
+        if (lines.empty()) return;
+        bool wasEmpty = false;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            wasEmpty = queue.empty();
+            for (auto& l : lines) {
+                IpcCommand c = ParseIpcLine(l);
+                c.client = client;
+                queue.push_back(std::move(c));
+            }
+        }
+        lines.clear();
+        if (wasEmpty && wake) wake();
+    }
+
+    // con mu acquisito
+    static void Append(Client& c, const std::string& line) {
+        if (c.overflow) return;
+        if (c.outbox.size() + line.size() + 1 > kMaxOutbox) {
+            c.overflow = true;
+            return;
+        }
+        c.outbox += line;
+        c.outbox += '\n';
+    }
+
+    void Drop(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = clients.find(id);
+        if (it == clients.end()) return;
+        if (it->second->subscribed) --subscribers;
+        clients.erase(it);
+    }
+
+    void Signal(const std::shared_ptr<Client>& c) {
+#ifdef _WIN32
+        SetEvent(c->outEvent);
+#else
+        (void)c;
+        const char b = 1;
+        [[maybe_unused]] ssize_t r = write(wakeWr, &b, 1);
+#endif
+    }
+
+#ifdef _WIN32
+    void ClientLoop(uint64_t id, std::shared_ptr<Client> c);
+    void AcceptLoop();
+    void ReapClientThreads();
+#else
+    void PollLoop();
+#endif
+};
+
+IpcServer::IpcServer() : impl_(std::make_unique<Impl>()) {}
+
+IpcServer::~IpcServer() { Stop(); }
+
+bool IpcServer::Running() const { return impl_->running; }
+
+std::vector<IpcCommand> IpcServer::TakeBatch() {
+    std::vector<IpcCommand> out;
+    std::lock_guard<std::mutex> lock(impl_->mu);
+    out.reserve(impl_->queue.size());
+    for (auto& c : impl_->queue) out.push_back(std::move(c));
+    impl_->queue.clear();
+    return out;
+}
+
+void IpcServer::Reply(uint64_t client, const std::string& line) {
+    std::shared_ptr<Impl::Client> c;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mu);
+        auto it = impl_->clients.find(client);
+        if (it == impl_->clients.end()) return;
+        c = it->second;
+        Impl::Append(*c, line);
+    }
+    impl_->Signal(c);
+}
+
+void IpcServer::Subscribe(uint64_t client) {
+    std::lock_guard<std::mutex> lock(impl_->mu);
+    auto it = impl_->clients.find(client);
+    if (it == impl_->clients.end() || it->second->subscribed) return;
+    it->second->subscribed = true;
+    ++impl_->subscribers;
+}
+
+bool IpcServer::HasSubscribers() const {
+    std::lock_guard<std::mutex> lock(impl_->mu);
+    return impl_->subscribers > 0;
+}
+
+void IpcServer::Publish(const std::string& line) {
+    std::vector<std::shared_ptr<Impl::Client>> targets;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mu);
+        for (auto& [id, c] : impl_->clients) {
+            if (!c->subscribed) continue;
+            Impl::Append(*c, line);
+            targets.push_back(c);
+        }
+    }
+    for (auto& c : targets) impl_->Signal(c);
+}
+
+#ifdef _WIN32
+
+static std::wstring WidenAscii(const std::string& s) {
+    return std::wstring(s.begin(), s.end());
+}
+
+// Una lettura sempre in corso e al piu' una scrittura, entrambe overlapped: il client puo'
+// mandare comandi mentre le risposte precedenti aspettano che lui le legga.
+void IpcServer::Impl::ClientLoop(uint64_t id, std::shared_ptr<Client> c) {
+    OVERLAPPED rd{};
+    rd.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    OVERLAPPED wr{};
+    wr.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    char buf[16 * 1024];
+    std::string writing; // il kernel lo legge finche' la scrittura non e' completata
+    IpcLineFramer framer;
+    std::vector<std::string> lines;
+    bool readPending = false;
+    bool writePending = false;
+
+    while (running) {
+        bool readDone = false; // lettura completata subito: non si aspetta, ma si scrive lo stesso
+        if (!readPending) {
+            ResetEvent(rd.hEvent);
+            DWORD got = 0;
+            if (ReadFile(c->pipe, buf, sizeof(buf), &got, &rd)) {
+                if (!framer.Feed(buf, got, lines)) break;
+                Enqueue(id, lines);
+                readDone = true;
+            } else if (GetLastError() != ERROR_IO_PENDING) {
+                break;
+            } else {
+                readPending = true;
+            }
+        }
+        if (!writePending) {
+            bool overflow = false;
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                overflow = c->overflow;
+                const size_t n = std::min<size_t>(c->outbox.size(), 64 * 1024);
+                writing.assign(c->outbox, 0, n);
+                c->outbox.erase(0, n);
+                if (c->outbox.empty()) ResetEvent(c->outEvent);
+            }
+            if (overflow) break;
+            if (!writing.empty()) {
+                ResetEvent(wr.hEvent);
+                DWORD put = 0;
+                // anche se completa subito l'evento e' segnalato: il risultato si prende sotto
+                if (!WriteFile(c->pipe, writing.data(), static_cast<DWORD>(writing.size()), &put, &wr) && GetLastError() != ERROR_IO_PENDING) break;
+                writePending = true;
+            }
+        }
+
+        // dopo una lettura gia' completata rd.hEvent e' segnalato ma non c'e' niente da
+        // raccogliere: si guarda solo se la scrittura e' finita e si torna a leggere
+        DWORD w = WAIT_TIMEOUT;
+        if (!readDone) {
+            HANDLE waits[3] = {rd.hEvent, writePending ? wr.hEvent : c->outEvent, stopEvent};
+            w = WaitForMultipleObjects(3, waits, FALSE, INFINITE);
+        } else if (writePending && WaitForSingleObject(wr.hEvent, 0) == WAIT_OBJECT_0) {
+            w = WAIT_OBJECT_0 + 1;
+        }
+        if (w == WAIT_TIMEOUT) continue;
+        if (w == WAIT_OBJECT_0) {
+            DWORD got = 0;
+            readPending = false;
+            if (!GetOverlappedResult(c->pipe, &rd, &got, FALSE) || !framer.Feed(buf, got, lines)) break;
+            Enqueue(id, lines);
+        } else if (w == WAIT_OBJECT_0 + 1) {
+            if (!writePending) continue; // outEvent: c'e' altro da scrivere
+            DWORD put = 0;
+            writePending = false;
+            if (!GetOverlappedResult(c->pipe, &wr, &put, FALSE)) break;
+            if (put < writing.size()) {
+                std::lock_guard<std::mutex> lock(mu);
+                c->outbox.insert(0, writing, put, std::string::npos);
+            }
+            writing.clear();
+        } else {
+            break;
+        }
+    }
+
+    // l'I/O annullato scrive ancora in rd/wr e nei buffer finche' non e' completato
+    if (readPending || writePending) {
+        CancelIoEx(c->pipe, nullptr);
+        DWORD n = 0;
+        if (readPending) GetOverlappedResult(c->pipe, &rd, &n, TRUE);
+        if (writePending) GetOverlappedResult(c->pipe, &wr, &n, TRUE);
+    }
+    DisconnectNamedPipe(c->pipe);
+    CloseHandle(c->pipe);
+    CloseHandle(rd.hEvent);
+    CloseHandle(wr.hEvent);
+    Drop(id);
+    c->finished = true;
+}
+
+// thread dei client gia' usciti (connessioni chiuse): non si accumulano fino a Stop
+void IpcServer::Impl::ReapClientThreads() {
+    for (auto it = clientThreads.begin(); it != clientThreads.end();) {
+        if (!it->client->finished) {
+            ++it;
+            continue;
+        }
+        it->thread.join();
+        it = clientThreads.erase(it);
+    }
+}
+
+void IpcServer::Impl::AcceptLoop() {
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    while (running) {
+        ReapClientThreads();
+        HANDLE pipe = CreateNamedPipeW(
+            pipeName.c_str(),
+            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE) break;
+
+        ResetEvent(ov.hEvent);
+        bool connected = ConnectNamedPipe(pipe, &ov) != 0;
+        if (!connected) {
+            const DWORD err = GetLastError();
+            if (err == ERROR_PIPE_CONNECTED) {
+                connected = true;
+            } else if (err == ERROR_IO_PENDING) {
+                HANDLE waits[2] = {ov.hEvent, stopEvent};
+                if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) == WAIT_OBJECT_0) {
+                    DWORD dummy = 0;
+                    connected = GetOverlappedResult(pipe, &ov, &dummy, FALSE) != 0;
+                } else {
+                    CancelIoEx(pipe, &ov);
+                    DWORD dummy = 0;
+                    GetOverlappedResult(pipe, &ov, &dummy, TRUE); // ov vive sullo stack: si aspetta l'annullamento
+                }
+            }
+        }
+        if (!connected) {
+            CloseHandle(pipe);
+            continue;
+        }
+
+        auto c = std::make_shared<Client>();
+        c->pipe = pipe;
+        c->outEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        uint64_t id = 0;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            id = nextClient++;
+            clients[id] = c;
+        }
+        clientThreads.push_back(Worker{std::thread(&Impl::ClientLoop, this, id, c), c});
+    }
+    CloseHandle(ov.hEvent);
+}
+
+bool IpcServer::Start(const std::string& endpoint, WakeFn wake) {
+    if (impl_->running) return true;
+    impl_->pipeName = WidenAscii(endpoint);
+    impl_->wake = std::move(wake);
+    impl_->stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    impl_->running = true;
+    impl_->ioThread = std::thread(&Impl::AcceptLoop, impl_.get());
+    return true;
+}
+
+void IpcServer::Stop() {
+    if (!impl_->running) return;
+    impl_->running = false;
+    SetEvent(impl_->stopEvent);
+    if (impl_->ioThread.joinable()) impl_->ioThread.join();
+    for (auto& worker : impl_->clientThreads) {
+        if (worker.thread.joinable()) worker.thread.join();
+    }
+    impl_->clientThreads.clear();
+    CloseHandle(impl_->stopEvent);
+    impl_->stopEvent = nullptr;
+}
+
+IpcClient::~IpcClient() { Close(); }
+
+bool IpcClient::Connect(const std::string& endpoint, unsigned timeoutMs) {
+    Close();
+    const std::wstring name = WidenAscii(endpoint);
+    const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    for (;;) {
+        HANDLE h = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (h != INVALID_HANDLE_VALUE) {
+            pipe_ = h;
+            return true;
+        }
+        const DWORD err = GetLastError();
+        const ULONGLONG now = GetTickCount64();
+        if (now >= deadline) return false;
+        if (err == ERROR_PIPE_BUSY) WaitNamedPipeW(name.c_str(), static_cast<DWORD>(deadline - now));
+        else Sleep(2); // la primaria non ha ancora creato la pipe
+    }
+}
+
+bool IpcClient::Send(const std::string& line) {
+    if (!pipe_) return false;
+    std::string data = line + "\n";
+    DWORD put = 0;
+    return WriteFile(pipe_, data.data(), static_cast<DWORD>(data.size()), &put, nullptr) && put == data.size();
+}
+
+bool IpcClient::ReadLine(std::string& line) {
+    while (ready_.empty()) {
+        if (!pipe_) return false;
+        char buf[4096];
+        DWORD got = 0;
+        if (!ReadFile(pipe_, buf, sizeof(buf), &got, nullptr) || got == 0) return false;
+        if (!framer_.Feed(buf, got, ready_)) return false;
+    }
+    line = std::move(ready_.front());
+    ready_.erase(ready_.begin());
+    return true;
+}
+
+void IpcClient::Close() {
+    if (pipe_) CloseHandle(pipe_);
+    pipe_ = nullptr;
+}
+
+#else // POSIX
+
+static void SetNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+// La cartella del socket non deve poterla toccare un altro utente: metterebbe li' il suo
+// socket al posto del nostro e riceverebbe i comandi. Va bene se e' nostra o di root e nessun
+// altro puo' scriverci, oppure ha lo sticky bit (/tmp). create: la si crea a 0700 se manca.
+static bool TrustedSocketDir(const std::string& endpoint, bool create) {
+    const size_t slash = endpoint.rfind('/');
+    const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : endpoint.substr(0, slash);
+    if (create && mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) return false;
+    struct stat st {};
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+    if (st.st_uid != getuid() && st.st_uid != 0) return false;
+    return !(st.st_mode & (S_IWGRP | S_IWOTH)) || (st.st_mode & S_ISVTX);
+}
+
+void IpcServer::Impl::PollLoop() {
+    std::vector<pollfd> fds;
+    std::vector<uint64_t> ids;
+    std::vector<std::string> lines;
+    char buf[16 * 1024];
+
+    while (running) {
+        fds.clear();
+        ids.clear();
+        fds.push_back({wakeRd, POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            for (auto& [id, c] : clients) {
+                short ev = POLLIN;
+                if (!c->outbox.empty()) ev |= POLLOUT;
+                fds.push_back({c->fd, ev, 0});
+                ids.push_back(id);
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while (read(wakeRd, buf, sizeof(buf)) > 0) {}
+        }
+
+        if (fds[1].revents & POLLIN) {
+            for (;;) {
+                const int fd = accept(listenFd, nullptr, nullptr);
+                if (fd < 0) break;
+                SetNonBlocking(fd);
+                auto c = std::make_shared<Client>();
+                c->fd = fd;
+                std::lock_guard<std::mutex> lock(mu);
+                clients[nextClient++] = c;
+            }
+        }
+
+        for (size_t k = 2; k < fds.size(); ++k) {
+            const uint64_t id = ids[k - 2];
+            std::shared_ptr<Client> c;
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                auto it = clients.find(id);
+                if (it == clients.end()) continue;
+                c = it->second;
+            }
+
+            bool alive = (fds[k].revents & (POLLERR | POLLNVAL)) == 0;
+            if (alive && (fds[k].revents & (POLLIN | POLLHUP))) {
+                for (;;) {
+                    const ssize_t got = read(c->fd, buf, sizeof(buf));
+                    if (got > 0) {
+                        if (!c->framer.Feed(buf, static_cast<size_t>(got), lines)) { alive = false; break; }
+                        continue;
+                    }
+                    if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) alive = false;
+                    break;
+                }
+                Enqueue(id, lines);
+            }
+            if (alive && (fds[k].revents & POLLOUT)) {
+                std::lock_guard<std::mutex> lock(mu);
+                const ssize_t put = send(c->fd, c->outbox.data(), c->outbox.size(), MSG_NOSIGNAL);
+                if (put > 0) c->outbox.erase(0, static_cast<size_t>(put));
+                else if (put < 0 && errno != EAGAIN && errno != EWOULDBLOCK) alive = false;
+            }
+            if (alive) {
+                std::lock_guard<std::mutex> lock(mu);
+                alive = !c->overflow;
+            }
+            if (!alive) {
+                close(c->fd);
+                Drop(id);
+            }
+        }
+    }
+}
+
+bool IpcServer::Start(const std::string& endpoint, WakeFn wake) {
+    if (impl_->running) return true;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (endpoint.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, endpoint.c_str(), endpoint.size() + 1);
+
+    if (!TrustedSocketDir(endpoint, true)) return false;
+
+    // socket rimasto da un processo terminato male: lo si rimuove solo se nessuno risponde
+    IpcClient probe;
+    if (probe.Connect(endpoint, 0)) return false;
+    unlink(endpoint.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    // solo l'utente puo' collegarsi: i permessi si mettono prima di listen, quando ancora
+    // nessuno riesce a connettersi
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || chmod(endpoint.c_str(), 0600) != 0 ||
+        listen(fd, 64) != 0) {
+        close(fd);
+        return false;
+    }
+    SetNonBlocking(fd);
+
+    int p[2];
+    if (pipe(p) != 0) {
+        close(fd);
+        return false;
+    }
+    SetNonBlocking(p[0]);
+    SetNonBlocking(p[1]);
+
+    impl_->path = endpoint;
+    impl_->listenFd = fd;
+    impl_->wakeRd = p[0];
+    impl_->wakeWr = p[1];
+    impl_->wake = std::move(wake);
+    impl_->running = true;
+    impl_->ioThread = std::thread(&Impl::PollLoop, impl_.get());
+    return true;
+}
+
+void IpcServer::Stop() {
+    if (!impl_->running) return;
+    impl_->running = false;
+    const char b = 0;
+    [[maybe_unused]] ssize_t r = write(impl_->wakeWr, &b, 1);
+    if (impl_->ioThread.joinable()) impl_->ioThread.join();
+
+    for (auto& [id, c] : impl_->clients) close(c->fd);
+    impl_->clients.clear();
+    impl_->subscribers = 0;
+    close(impl_->listenFd);
+    close(impl_->wakeRd);
+    close(impl_->wakeWr);
+    unlink(impl_->path.c_str());
+    impl_->listenFd = impl_->wakeRd = impl_->wakeWr = -1;
+}
+
+IpcClient::~IpcClient() { Close(); }
+
+bool IpcClient::Connect(const std::string& endpoint, unsigned timeoutMs) {
+    Close();
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (endpoint.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, endpoint.c_str(), endpoint.size() + 1);
+    if (!TrustedSocketDir(endpoint, false)) return false;
+
+    for (unsigned waited = 0;; waited += 5) {
+        fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd_ < 0) return false;
+        if (connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return true;
+        Close();
+        if (waited >= timeoutMs) return false;
+        usleep(5000);
+    }
+}
+
+bool IpcClient::Send(const std::string& line) {
+    if (fd_ < 0) return false;
+    std::string data = line + "\n";
+    size_t off = 0;
+    while (off < data.size()) {
+        const ssize_t put = send(fd_, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (put <= 0) {
+            if (put < 0 && errno == EINTR) continue;
+            return false;
+        }
+        off += static_cast<size_t>(put);
+    }
+    return true;
+}
+
+bool IpcClient::ReadLine(std::string& line) {
+    while (ready_.empty()) {
+        if (fd_ < 0) return false;
+        char buf[4096];
+        const ssize_t got = read(fd_, buf, sizeof(buf));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        if (!framer_.Feed(buf, static_cast<size_t>(got), ready_)) return false;
+    }
+    line = std::move(ready_.front());
+    ready_.erase(ready_.begin());
+    return true;
+}
+
+void IpcClient::Close() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+}
+
+#endif
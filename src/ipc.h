@@ -0,0 +1,110 @@
+#pragma once
+
+// Endpoint di automazione locale dell'istanza in esecuzione.
+// Windows: named pipe. Linux: socket unix (serve a testare il nucleo).
+//
+// Protocollo JSON-lines (UTF-8), una richiesta per riga, una risposta per riga,
+// le richieste possono essere inviate in pipeline senza attendere le risposte:
+//   {"id":1,"cmd":"list"}
+//   {"id":2,"cmd":"get","tile":7}
+//   {"id":3,"cmd":"set","tile":7,"text":"ciao"}
+//   {"id":4,"cmd":"split","tile":7,"mode":"h"}      mode: h | v | 4
+//   {"id":5,"cmd":"subscribe"}
+//   {"id":6,"cmd":"activate","args":["..."]}       inoltro da una seconda istanza
+//   {"id":7,"cmd":"stats","mode":"log"}            memoria e handle; mode: (vuoto) | log | off
+// risposte: {"id":2,"ok":true,...}  /  {"id":2,"ok":false,"error":"..."}
+// eventi ai sottoscrittori: {"event":"changed","tile":7}
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class IpcOp { Unknown, List, Get, Set, Split, Subscribe, Activate, Stats };
+
+struct IpcCommand {
+    uint64_t client{0};          // connessione di provenienza (per la risposta)
+    long long reqId{0};
+    IpcOp op{IpcOp::Unknown};
+    std::string cmd;             // nome originale del comando
+    uint64_t tile{0};
+    std::string text;            // UTF-8
+    std::string mode;
+    std::vector<std::string> args;
+    std::string error;           // non vuoto se la riga non e' valida
+};
+
+// Parsing di una singola riga del protocollo (senza '\n').
+IpcCommand ParseIpcLine(const std::string& line);
+
+// Helpers per comporre le risposte.
+std::string JsonQuoteUtf8(const std::string& s);
+std::string IpcOkReply(long long reqId, const std::string& extraFields = {});
+std::string IpcErrorReply(long long reqId, const std::string& message);
+
+// Framing a righe: accumula byte e restituisce le righe complete.
+class IpcLineFramer {
+public:
+    static constexpr size_t kMaxLine = 4u << 20;
+
+    // ritorna false se una riga supera kMaxLine (connessione da chiudere)
+    bool Feed(const char* data, size_t len, std::vector<std::string>& lines);
+
+private:
+    std::string pending_;
+};
+
+std::string IpcDefaultEndpoint();
+
+class IpcServer {
+public:
+    // wake viene chiamata (da un thread di I/O) quando la coda passa da vuota
+    // a non vuota: il thread UI deve poi chiamare TakeBatch.
+    using WakeFn = std::function<void()>;
+
+    IpcServer();
+    ~IpcServer();
+    IpcServer(const IpcServer&) = delete;
+    IpcServer& operator=(const IpcServer&) = delete;
+
+    bool Start(const std::string& endpoint, WakeFn wake);
+    void Stop();
+    bool Running() const;
+
+    // Tutti i comandi arrivati dall'ultimo giro, nell'ordine di arrivo.
+    std::vector<IpcCommand> TakeBatch();
+
+    void Reply(uint64_t client, const std::string& line);
+    void Subscribe(uint64_t client);
+    bool HasSubscribers() const;
+    void Publish(const std::string& line);
+
+    struct Impl;
+
+private:
+    std::unique_ptr<Impl> impl_;
+};
+
+// Client minimale: usato dalla seconda istanza e dagli script/test.
+class IpcClient {
+public:
+    IpcClient() = default;
+    ~IpcClient();
+    IpcClient(const IpcClient&) = delete;
+    IpcClient& operator=(const IpcClient&) = delete;
+
+    bool Connect(const std::string& endpoint, unsigned timeoutMs);
+    bool Send(const std::string& line);
+    bool ReadLine(std::string& line);
+    void Close();
+
+private:
+#ifdef _WIN32
+    void* pipe_{nullptr};
+#else
+    int fd_{-1};
+#endif
+    IpcLineFramer framer_;
+    std::vector<std::string> ready_;
+};
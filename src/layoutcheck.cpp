@@ -0,0 +1,280 @@
+#include "layoutcheck.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+
+// oltre questa dimensione la ricerca di spazio libero non usa la griglia di occupazione
+constexpr size_t kMaxOccupancyCells = 16u << 20;
+
+bool ClampToBoard(CellRect& r, int boardW, int boardH) {
+    const CellRect before = r;
+    r.w = std::max(1, r.w);
+    r.h = std::max(1, r.h);
+    r.x = std::max(0, r.x);
+    r.y = std::max(0, r.y);
+    if (boardW > 0) {
+        r.w = std::min(r.w, boardW);
+        r.x = std::min(r.x, boardW - r.w);
+    }
+    if (boardH > 0) {
+        r.h = std::min(r.h, boardH);
+        r.y = std::min(r.y, boardH - r.h);
+    }
+    return r.x != before.x || r.y != before.y || r.w != before.w || r.h != before.h;
+}
+
+// Insieme attivo dello sweep: tile gia' accettate che contengono la colonna corrente.
+// Essendo disgiunte tra loro, sulle y sono intervalli ordinati e non sovrapposti.
+class ActiveSet {
+public:
+    void ExpireBefore(int x, const std::vector<CellRect>& rects) {
+        while (!expiry_.empty() && expiry_.top().first <= x) {
+            const size_t idx = expiry_.top().second;
+            expiry_.pop();
+            auto it = byTop_.find(rects[idx].y);
+            if (it != byTop_.end() && it->second == idx) byTop_.erase(it);
+        }
+    }
+
+    void Insert(size_t idx, const CellRect& r) {
+        byTop_[r.y] = idx;
+        expiry_.push({r.x + r.w, idx});
+    }
+
+    // indici delle tile attive che intersecano [y0, y1), in ordine di y
+    void Query(int y0, int y1, const std::vector<CellRect>& rects, std::vector<size_t>& out) const {
+        out.clear();
+        auto it = byTop_.upper_bound(y0);
+        if (it != byTop_.begin()) {
+            auto prev = std::prev(it);
+            const CellRect& p = rects[prev->second];
+            if (p.y + p.h > y0) out.push_back(prev->second);
+        }
+        for (; it != byTop_.end() && it->first < y1; ++it) out.push_back(it->second);
+    }
+
+private:
+    using Expiry = std::pair<int, size_t>; // (x1, indice)
+    std::map<int, size_t> byTop_;
+    std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>> expiry_;
+};
+
+std::vector<size_t> SweepOrder(const std::vector<CellRect>& rects) {
+    // chiave (x, -indice): stessa colonna, vince chi sta sopra (indice piu' alto)
+    std::vector<std::pair<int, int64_t>> keys(rects.size());
+    for (size_t i = 0; i < rects.size(); ++i) keys[i] = {rects[i].x, -static_cast<int64_t>(i)};
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<size_t> order(rects.size());
+    for (size_t i = 0; i < keys.size(); ++i) order[i] = static_cast<size_t>(-keys[i].second);
+    return order;
+}
+
+// Griglia di occupazione, usata solo per le tile da ricollocare.
+// Per ogni cella: quante celle libere consecutive ci sono verso destra; per ogni riga: la corsa piu' lunga.
+// Le righe senza una corsa abbastanza lunga vengono scartate senza guardarne le colonne.
+class Occupancy {
+public:
+    Occupancy(int w, int h, const std::vector<CellRect>& rects, const std::vector<bool>& include)
+        : w_(w), h_(h), used_(static_cast<size_t>(w) * h, 0), runRight_(static_cast<size_t>(w) * h, 0), rowMaxRun_(h, 0) {
+        for (size_t i = 0; i < rects.size(); ++i) {
+            if (include[i]) Mark(rects[i], nullptr);
+        }
+        for (int y = 0; y < h_; ++y) RebuildRow(y);
+    }
+
+    void Fill(const CellRect& r) { Mark(r, this); }
+
+    bool FindFirstFree(int w, int h, CellRect& out) {
+        if (w > w_ || h > h_) return false;
+        // Fill toglie solo spazio: una ricerca della stessa misura puo' ripartire da dove era finita la precedente
+        int& from = resumeRow_[(static_cast<int64_t>(w) << 32) | static_cast<uint32_t>(h)];
+        int shortRows = 0; // righe nella finestra [y, y+h) con corsa massima < w
+        for (int y = from; y < from + h - 1 && y < h_; ++y) shortRows += rowMaxRun_[y] < w;
+        for (int y = from; y + h <= h_; ++y) {
+            shortRows += rowMaxRun_[y + h - 1] < w;
+            if (y > from) shortRows -= rowMaxRun_[y - 1] < w;
+            if (shortRows > 0) continue;
+
+            for (int x = 0; x + w <= w_; ++x) {
+                int row = y;
+                while (row < y + h && runRight_[Index(x, row)] >= w) ++row;
+                if (row == y + h) {
+                    from = y;
+                    out = CellRect{x, y, w, h};
+                    return true;
+                }
+            }
+        }
+        from = h_;
+        return false;
+    }
+
+private:
+    size_t Index(int x, int y) const { return static_cast<size_t>(y) * w_ + x; }
+
+    void Mark(const CellRect& r, Occupancy* rebuild) {
+        const int x1 = std::min(w_, r.x + r.w);
+        const int y1 = std::min(h_, r.y + r.h);
+        for (int y = std::max(0, r.y); y < y1; ++y) {
+            for (int x = std::max(0, r.x); x < x1; ++x) used_[Index(x, y)] = 1;
+            if (rebuild) RebuildRow(y);
+        }
+    }
+
+    void RebuildRow(int y) {
+        int run = 0;
+        int best = 0;
+        for (int x = w_ - 1; x >= 0; --x) {
+            run = used_[Index(x, y)] ? 0 : run + 1;
+            runRight_[Index(x, y)] = run;
+            best = std::max(best, run);
+        }
+        rowMaxRun_[y] = best;
+    }
+
+    int w_;
+    int h_;
+    std::vector<uint8_t> used_;
+    std::vector<int> runRight_;
+    std::vector<int> rowMaxRun_;
+    std::unordered_map<int64_t, int> resumeRow_;
+};
+
+} // namespace
+
+LayoutReport RepairLayout(std::vector<CellRect>& rects, int boardW, int boardH) {
+    LayoutReport report;
+
+    for (size_t i = 0; i < rects.size(); ++i) {
+        const CellRect before = rects[i];
+        if (ClampToBoard(rects[i], boardW, boardH)) {
+            ++report.outOfBounds;
+            report.fixes.push_back({i, LayoutFix::Kind::Clamped, before, rects[i]});
+        }
+    }
+
+    ActiveSet active;
+    std::vector<size_t> hits;
+    std::vector<size_t> deferred;
+    std::vector<bool> accepted(rects.size(), false);
+
+    for (size_t idx : SweepOrder(rects)) {
+        CellRect& r = rects[idx];
+        active.ExpireBefore(r.x, rects);
+        active.Query(r.y, r.y + r.h, rects, hits);
+
+        if (!hits.empty()) {
+            report.overlaps += hits.size();
+
+            // gli ostacoli contengono tutti la colonna r.x: resta libero solo cio' che sta tra loro sulle y
+            int bestY = 0;
+            int bestH = 0;
+            int cur = r.y;
+            for (size_t h : hits) {
+                const CellRect& o = rects[h];
+                if (o.y - cur > bestH) { bestY = cur; bestH = o.y - cur; }
+                cur = std::max(cur, o.y + o.h);
+            }
+            if (r.y + r.h - cur > bestH) { bestY = cur; bestH = r.y + r.h - cur; }
+
+            if (bestH <= 0) {
+                deferred.push_back(idx);
+                continue;
+            }
+            const CellRect before = r;
+            r.y = bestY;
+            r.h = bestH;
+            report.fixes.push_back({idx, LayoutFix::Kind::Shrunk, before, r});
+        }
+
+        active.Insert(idx, r);
+        accepted[idx] = true;
+    }
+
+    if (deferred.empty()) return report;
+    std::sort(deferred.begin(), deferred.end());
+
+    int stackY = 0;
+    for (size_t i = 0; i < rects.size(); ++i) {
+        if (accepted[i]) stackY = std::max(stackY, rects[i].y + rects[i].h);
+    }
+    if (boardH > 0) stackY = std::max(stackY, boardH);
+
+    const bool useGrid = boardW > 0 && boardH > 0 && static_cast<size_t>(boardW) * boardH <= kMaxOccupancyCells;
+    std::unique_ptr<Occupancy> grid;
+    if (useGrid) grid = std::make_unique<Occupancy>(boardW, boardH, rects, accepted);
+
+    for (size_t idx : deferred) {
+        CellRect& r = rects[idx];
+        const CellRect before = r;
+
+        bool placed = false;
+        if (grid) {
+            // prima la dimensione originale, poi dimezzando il lato piu' lungo fino a 1x1
+            int w = r.w;
+            int h = r.h;
+            for (;;) {
+                CellRect spot;
+                if (grid->FindFirstFree(w, h, spot)) {
+                    r = spot;
+                    placed = true;
+                    break;
+                }
+                if (w == 1 && h == 1) break;
+                if (w >= h) w = std::max(1, w / 2);
+                else h = std::max(1, h / 2);
+            }
+        }
+
+        if (placed) {
+            grid->Fill(r);
+            report.fixes.push_back({idx, LayoutFix::Kind::Relocated, before, r});
+        } else {
+            r.x = 0;
+            r.y = stackY;
+            stackY += r.h;
+            report.fixes.push_back({idx, LayoutFix::Kind::Stacked, before, r});
+        }
+    }
+
+    return report;
+}
+
+bool LayoutIsValid(const std::vector<CellRect>& rects, int boardW, int boardH) {
+    for (const CellRect& r : rects) {
+        CellRect c = r;
+        if (ClampToBoard(c, boardW, boardH)) return false;
+    }
+
+    ActiveSet active;
+    std::vector<size_t> hits;
+    for (size_t idx : SweepOrder(rects)) {
+        const CellRect& r = rects[idx];
+        active.ExpireBefore(r.x, rects);
+        active.Query(r.y, r.y + r.h, rects, hits);
+        if (!hits.empty()) return false;
+        active.Insert(idx, r);
+    }
+    return true;
+}
+
+std::wstring DescribeLayoutFix(const LayoutFix& fix) {
+    auto rect = [](const CellRect& r) {
+        return L"(" + std::to_wstring(r.x) + L"," + std::to_wstring(r.y) + L" " + std::to_wstring(r.w) + L"x" + std::to_wstring(r.h) + L")";
+    };
+    const wchar_t* what = L"";
+    switch (fix.kind) {
+        case LayoutFix::Kind::Clamped: what = L"riportata nella board"; break;
+        case LayoutFix::Kind::Shrunk: what = L"ridotta per togliere la sovrapposizione"; break;
+        case LayoutFix::Kind::Relocated: what = L"spostata in uno spazio libero"; break;
+        case LayoutFix::Kind::Stacked: what = L"impilata sotto la board (nessuno spazio libero)"; break;
+    }
+    return L"tile " + std::to_wstring(fix.index) + L" " + rect(fix.before) + L" -> " + rect(fix.after) + L": " + what;
+}
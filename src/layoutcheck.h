@@ -0,0 +1,46 @@
+#pragma once
+
+// Validazione della griglia dopo il caricamento: tile fuori dalla board e
+// sovrapposizioni (file scritti a mano, troncati o uniti da fuori).
+// Sweep line sulle x con insieme attivo ordinato sulle y: O(n log n + k).
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct CellRect {
+    int x{0};
+    int y{0};
+    int w{1};
+    int h{1};
+};
+
+struct LayoutFix {
+    enum class Kind {
+        Clamped,   // riportata dentro la board (spostata e/o ridotta)
+        Shrunk,    // ridotta in altezza fino allo spazio libero
+        Relocated, // spostata nel primo spazio libero della board
+        Stacked    // nessuno spazio libero: impilata sotto la board
+    };
+    size_t index{0}; // posizione nel vettore passato
+    Kind kind{Kind::Clamped};
+    CellRect before;
+    CellRect after;
+};
+
+struct LayoutReport {
+    size_t outOfBounds{0};
+    size_t overlaps{0}; // coppie sovrapposte trovate durante lo sweep
+    std::vector<LayoutFix> fixes;
+};
+
+// Ripara i rettangoli in posto, in modo deterministico.
+// Priorita': a parita' di colonna sinistra vince la tile con indice piu' alto
+// (quella che HitTestTile trova per prima); altrimenti quella piu' a sinistra.
+// boardW/boardH <= 0: board senza limite su quell'asse.
+LayoutReport RepairLayout(std::vector<CellRect>& rects, int boardW, int boardH);
+
+// Solo verifica: true se non ci sono sovrapposizioni ne' tile fuori board.
+bool LayoutIsValid(const std::vector<CellRect>& rects, int boardW, int boardH);
+
+std::wstring DescribeLayoutFix(const LayoutFix& fix);
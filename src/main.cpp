@@ -1,19 +1,105 @@
 #include <windows.h>
 #include <windowsx.h>
 #include <shlobj.h>
+#include <shellapi.h>
+#include <commdlg.h>
+#include <psapi.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <ctime>
 #include <cwctype>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include "adjacency.h"
+#include "attachments.h"
+#include "autofit.h"
+#include "collision.h"
+#include "crdtsync.h"
+#include "filewatch.h"
+#include "formula.h"
+#include "freespace.h"
+#include "history.h"
+#include "imagecodec.h"
+#include "instance.h"
+#include "ipc.h"
+#include "layoutcheck.h"
+#include "markdown.h"
+#include "memstats.h"
+#include "mirror.h"
+#include "quadtree.h"
+#include "searchindex.h"
+#include "sha256.h"
+#include "statefile.h"
+#include "tail.h"
+#include "textcodec.h"
+#include "textseg.h"
+#include "textutil.h"
+#include "textview.h"
+#include "spell.h"
+#include "timewheel.h"
+#include "tracks.h"
 #define BACKGROUND 0
 #define TILE_COLOR 26
 
 //#include "startup.h"
 
 HFONT g_bigFont = nullptr;
+LOGFONT g_baseLogFont{};
+int g_baseFontPx = 17;
+std::unordered_map<int, HFONT> g_fontsByPx; // px -> font, per le tile ad adattamento automatico
+std::unordered_map<int, HFONT> g_mdFonts;   // (px << 8 | stile) -> font del Markdown in lettura
+HDC g_measureDc = nullptr;
+
+// Oggetti GDI contati per area (memstats.h): chi crea dice di chi e', chi distrugge lo
+// scala dalla stessa area. Un handle che sfugge si vede come area che non torna a zero.
+HFONT TrackedFont(MemArea area, const LOGFONT& lf) {
+    HFONT font = CreateFontIndirect(&lf);
+    if (font) MemHandle(area, 1);
+    return font;
+}
+
+HBRUSH TrackedBrush(MemArea area, COLORREF color) {
+    HBRUSH brush = CreateSolidBrush(color);
+    if (brush) MemHandle(area, 1);
+    return brush;
+}
+
+HPEN TrackedPen(MemArea area, int width, COLORREF color) {
+    HPEN pen = CreatePen(PS_SOLID, width, color);
+    if (pen) MemHandle(area, 1);
+    return pen;
+}
+
+HBITMAP TrackedBitmap(MemArea area, HDC dc, int w, int h) {
+    HBITMAP bmp = CreateCompatibleBitmap(dc, w, h);
+    if (bmp) MemHandle(area, 1);
+    return bmp;
+}
+
+HDC TrackedMemDc(MemArea area, HDC dc) {
+    HDC mem = CreateCompatibleDC(dc);
+    if (mem) MemHandle(area, 1);
+    return mem;
+}
+
+void FreeGdi(MemArea area, HGDIOBJ obj) {
+    if (obj && DeleteObject(obj)) MemHandle(area, -1);
+}
+
+void FreeMemDc(MemArea area, HDC dc) {
+    if (dc && DeleteDC(dc)) MemHandle(area, -1);
+}
+
 void CreateGlobalFont()
 {
     if (g_bigFont)
@@ -24,7 +110,73 @@ void CreateGlobalFont()
 
     lf.lfHeight = (LONG)(lf.lfHeight * 1.6);
 
-    g_bigFont = CreateFontIndirect(&lf);
+    g_bigFont = TrackedFont(MemArea::Fonts, lf);
+    g_baseLogFont = lf;
+    g_baseFontPx = std::max(1L, lf.lfHeight < 0 ? -lf.lfHeight : lf.lfHeight);
+}
+
+// Font delle tile ad adattamento automatico e della board zoomata: uno per dimensione,
+// condivisi tra le tile e distrutti solo in uscita.
+HFONT FontForPx(int px)
+{
+    auto it = g_fontsByPx.find(px);
+    if (it != g_fontsByPx.end()) return it->second;
+
+    LOGFONT lf = g_baseLogFont;
+    lf.lfHeight = -px;
+    HFONT font = TrackedFont(MemArea::Fonts, lf);
+    if (!font) return g_bigFont;
+    g_fontsByPx.emplace(px, font);
+    return font;
+}
+
+// Font di un tratto Markdown (kMd*) alla dimensione della EDIT: titoli piu' grandi e
+// in grassetto, codice a spaziatura fissa, link sottolineati.
+HFONT MarkdownFont(int px, uint8_t style)
+{
+    style = static_cast<uint8_t>(style & ~kMdBreak);
+    const int key = px << 8 | style;
+    auto it = g_mdFonts.find(key);
+    if (it != g_mdFonts.end()) return it->second;
+
+    static constexpr int kHeadingPercent[] = {100, 150, 130, 115, 100, 100, 100};
+    const int level = std::min(6, MdHeadingLevel(style));
+    LOGFONT lf = g_baseLogFont;
+    lf.lfHeight = -std::max(1, px * kHeadingPercent[level] / 100);
+    if ((style & kMdBold) || level > 0) lf.lfWeight = FW_BOLD;
+    if (style & kMdItalic) lf.lfItalic = TRUE;
+    if (style & kMdLink) lf.lfUnderline = TRUE;
+    if (style & kMdCode) wcscpy_s(lf.lfFaceName, L"Consolas");
+    HFONT font = TrackedFont(MemArea::Fonts, lf);
+    if (!font) return g_bigFont;
+    g_mdFonts.emplace(key, font);
+    return font;
+}
+
+void DestroyFontCache()
+{
+    for (auto& [px, font] : g_fontsByPx) FreeGdi(MemArea::Fonts, font);
+    g_fontsByPx.clear();
+    for (auto& [key, font] : g_mdFonts) FreeGdi(MemArea::Fonts, font);
+    g_mdFonts.clear();
+    if (g_measureDc) {
+        FreeMemDc(MemArea::Fonts, g_measureDc);
+        g_measureDc = nullptr;
+    }
+}
+
+// Altezza di un paragrafo con gli stessi flag di TextFitsInEdit; vuoto = una riga.
+int MeasureParagraphPx(std::wstring_view paragraph, int px, int width)
+{
+    if (!g_measureDc) g_measureDc = TrackedMemDc(MemArea::Fonts, nullptr);
+    if (!g_measureDc) return 0;
+
+    HGDIOBJ oldFont = SelectObject(g_measureDc, FontForPx(px));
+    RECT calc{0, 0, std::max(1, width), 0};
+    if (paragraph.empty()) DrawTextW(g_measureDc, L" ", 1, &calc, DT_WORDBREAK | DT_EDITCONTROL | DT_CALCRECT | DT_NOPREFIX);
+    else DrawTextW(g_measureDc, paragraph.data(), static_cast<int>(paragraph.size()), &calc, DT_WORDBREAK | DT_EDITCONTROL | DT_CALCRECT | DT_NOPREFIX);
+    SelectObject(g_measureDc, oldFont);
+    return static_cast<int>(calc.bottom - calc.top);
 }
 static BOOL CALLBACK EnumMonitorsProc(HMONITOR hMon, HDC, LPRECT, LPARAM lParam)
 {
@@ -73,7 +225,15 @@ struct Tile {
     int h{4};
     std::wstring text;
     HWND edit{};
+    uint64_t id{0}; // stabile tra salvataggi, usato da IPC e indici
+    bool autoFit{false}; // il font si riduce (dal ladder di autofit.h) invece di rifiutare il testo
+    int fontPx{0};       // dimensione applicata alla EDIT in autoFit, 0 = g_bigFont
+    std::wstring tailPath; // tile "tail": mostra le ultime righe di questo file (sola lettura, text resta da parte)
+    int64_t remindAt{0};   // promemoria, ms Unix; 0 = nessuno (tolto quando scatta)
+    bool scroll{false};    // nota lunga: vista che scorre (textview.h) al posto della EDIT, senza limite di spazio
+    std::vector<Attachment> files; // allegati, in una striscia sotto il testo (byte in g_blobs)
 };
+using TileList = std::vector<Tile, TrackedAllocator<Tile, MemArea::Tiles>>; // crescita contata in memstats
 
 struct AppState {
     int cellSize{48};
@@ -81,12 +241,49 @@ struct AppState {
     bool startWithWindows{false};
     int windowWidth{1008};
     int windowHeight{660};
-    std::vector<Tile> tiles;
+    int viewX{0}; // origine della viewport in px del mondo (>= 0), alla scala corrente
+    int viewY{0};
+    double zoom{1.0}; // scala della board: una traccia da N px ne occupa N * zoom
+    TrackAxis columns; // larghezze delle colonne (px a zoom 1); il default e' cellSize
+    TrackAxis rows;
+    uint64_t nextTileId{1};
+    TileList tiles;
+    std::wstring syncFolder; // cartella condivisa tra dispositivi, vuota = niente sincronizzazione
+    uint64_t replicaId{0};   // questo dispositivo nei log della cartella
+    std::wstring mirrorFolder; // copia delle tile come <id>.md, vuota = spenta
+    bool spellCheck{false};    // controllo ortografico coi dizionari di <stato>\\dictionaries
 };
 
 static constexpr UINT_PTR kTimerSaveDebounce = 1;
 static constexpr UINT kSaveDebounceMs = 800;
 static bool g_savePending = false;
+static constexpr UINT kMsgIpcBatch = WM_APP + 1;
+static constexpr UINT kMsgStateFileChanged = WM_APP + 2;
+static constexpr UINT kMsgSyncChanged = WM_APP + 3;
+static constexpr UINT kMsgMirrorChanged = WM_APP + 4;
+static constexpr UINT kMsgTailChanged = WM_APP + 5;
+static constexpr UINT kMsgRecalc = WM_APP + 6;
+static constexpr UINT kMsgSpellReady = WM_APP + 7; // wParam = id della tile con errori nuovi
+static constexpr UINT kMsgThumbReady = WM_APP + 8;  // miniature pronte: si ridisegna la board
+static constexpr UINT kMsgAttachDone = WM_APP + 9;  // allegati copiati nello store, in g_attachDone
+static constexpr UINT_PTR kTimerTailRepaint = 5;
+static constexpr UINT_PTR kTimerTailPoll = 6;
+static constexpr UINT_PTR kTimerReminder = 7;   // uno solo, sulla prossima scadenza della ruota
+static constexpr UINT_PTR kTimerRingBlink = 8;
+static constexpr UINT kReminderMaxSleepMs = 15 * 60 * 1000; // rete di sicurezza per gli spostamenti dell'ora
+static constexpr UINT kRingBlinkMs = 500;
+static constexpr COLORREF kRingColor = RGB(120, 84, 20);
+static constexpr UINT_PTR kTimerMemStats = 9;
+static constexpr UINT_PTR kTimerSpell = 10; // testi cambiati al controllo ortografico
+static constexpr UINT kSpellDebounceMs = 150;
+static constexpr UINT kMemSampleMs = 10 * 1000; // con la finestra di MemTrend: ~16 minuti di storia
+static constexpr UINT kTailPollMs = 1000; // rete di sicurezza: su NTFS le append a un file aperto non sempre notificano
+constexpr size_t kTailLines = 200;
+static constexpr UINT_PTR kTimerStateReload = 2;
+static constexpr UINT kStateReloadDelayMs = 200; // lascia finire chi scrive il file in piu' passate
+static constexpr UINT_PTR kTimerSnapshot = 4;
+static constexpr UINT kSnapshotIntervalMs = 10 * 60 * 1000;
+static constexpr int kSnapshotsPerMaintenance = 36; // conservazione e pulizia dei chunk ogni 6 ore
 
 constexpr wchar_t kAppName[] = L"GridNotes";
 constexpr wchar_t kRunKey[] = L"Software\\Microsoft\\Windows\\CurrentVersion\\Run";
@@ -97,6 +294,7 @@ constexpr int kCmdEditLayout = 101;
 constexpr int kCmdStartup = 102;
 
 AppState g_state;
+HWND g_mainWnd{};
 HWND g_board{};
 HWND g_editToggle{};
 HWND g_startupToggle{};
@@ -105,101 +303,275 @@ HBRUSH g_toolbarBgBrush{};
 WNDPROC g_defaultEditProc{};
 bool g_internalTextSet{};
 bool g_dragging{};
-int g_dragTile{-1};
 enum class DragEdge { None, Left, Right, Top, Bottom };
-DragEdge g_dragEdge = DragEdge::None;
 POINT g_dragStart{};
-Tile g_originalTile{};
+// drag di un bordo: la linea si sposta insieme a tutte le tile che la toccano
+struct EdgeDrag {
+    EdgeGroup group;
+    std::vector<std::pair<uint64_t, CellRect>> original; // geometria a inizio drag
+    int applied{0};                                      // spostamento gia' applicato, in celle
+};
+EdgeDrag g_edgeDrag;
+// drag dell'interno di una tile: la sposta (Shift: spinge i vicini; Ctrl al rilascio: scambio)
+struct MoveDrag {
+    bool active{false};
+    uint64_t id{0};
+    CellRect original;
+};
+MoveDrag g_moveDrag;
+// Alt+drag di un bordo: ridimensiona la riga/colonna che finisce su quel bordo
+struct TrackDrag {
+    bool active{false};
+    bool column{false};
+    int index{0};
+    int original{0}; // px a zoom 1
+};
+TrackDrag g_trackDrag;
+IpcServer g_ipc;
+bool g_layoutBatch{};   // durante un batch IPC layout e salvataggio vengono rimandati a fine giro
+bool g_layoutPending{};
+std::unordered_map<uint64_t, int> g_tileIndexById;
+bool g_tileIndexStale{true}; // tile aggiunte o tolte dopo l'ultima ricostruzione della mappa
+SingleInstanceGuard g_instance;
+DirWatcher g_stateWatcher;
+uint64_t g_stateHash{};                  // hash dell'ultimo state.json letto o scritto da noi
+std::unordered_set<uint64_t> g_dirtyTiles; // testi cambiati qui dall'ultimo salvataggio
+bool g_layoutDirty{};                    // geometria cambiata qui dall'ultimo salvataggio
+std::unique_ptr<SyncDoc> g_sync;         // nullptr = sincronizzazione spenta
+SyncLog g_syncLog;
+DirWatcher g_syncWatcher;
+History g_history;                       // istantanee periodiche in %APPDATA%\\GridNotes\\history
+std::unordered_set<uint64_t> g_historyTexts; // testi cambiati dall'ultima istantanea
+int g_snapshotTicks{};
+MarkdownMirror g_mirror;
+DirWatcher g_mirrorWatcher;
+bool g_mirrorOn{};
+bool g_mirrorPending{};                  // notifiche dalla cartella da leggere al prossimo giro del debounce
+std::unordered_set<uint64_t> g_mirrorTexts; // testi da riportare nei file .md al prossimo salvataggio
+std::unordered_map<uint64_t, std::unique_ptr<FileTail>> g_tails;               // per id delle tile "tail"
+std::unordered_map<std::wstring, std::unique_ptr<DirWatcher>> g_tailWatchers; // una per cartella seguita
+std::atomic<bool> g_tailSignaled{};     // notifica gia' in coda: le altre si accorpano
+bool g_tailRepaintArmed{};
+FormulaEngine g_formulas;                // tile "=..." e chi citano
+std::unordered_set<uint64_t> g_formulaTexts; // testi da ridare al motore al prossimo ricalcolo
+std::unordered_set<uint64_t> g_formulaShown; // EDIT che mostrano il risultato invece del testo
+TimingWheel g_reminders;                 // promemoria delle tile, per id
+std::unordered_set<uint64_t> g_ringing;  // promemoria scattati: la tile lampeggia finche' non la si apre
+bool g_ringPhase{};
+HBRUSH g_ringBrush{};
+MemTrend g_memTrend;  // campioni periodici per vedere le crescite a regime
+bool g_memOverlay{};  // contatori disegnati sulla board
+bool g_memLog{};      // ogni campione anche in memstats.jsonl (prove di durata)
+std::unordered_map<uint64_t, MarkdownDoc> g_markdown; // tile con una EDIT: blocchi e layout per la lettura
+SpellChecker g_spell;                    // controllo ortografico, sul suo thread
+std::unordered_set<uint64_t> g_spellTexts; // testi da passare al controllo allo scadere di kTimerSpell
+SearchIndex g_index;                       // ricerca su board e cronologia, sul suo thread
+bool g_indexStarted = false;
+std::unordered_set<uint64_t> g_indexTexts; // testi da indicizzare al prossimo salvataggio
+BlobStore g_blobs;                         // byte degli allegati, per contenuto
+ThumbCache g_thumbs;                       // miniature (disco + LRU) e copia degli allegati, sul suo thread
+std::atomic<bool> g_thumbSignaled{};       // kMsgThumbReady gia' in coda: le altre si accorpano
+std::mutex g_attachMutex;
+std::vector<std::pair<uint64_t, Attachment>> g_attachDone; // dal thread delle miniature: tile -> allegato pronto
+constexpr size_t kThumbMemoryBytes = size_t{64} << 20;
+constexpr uint64_t kThumbDiskBytes = uint64_t{256} << 20;
+bool g_recalcPosted{};
+FreeSpaceIndex g_freeSpace;              // celle libere della board, per aggiungere tile nei buchi
+AdjacencyIndex g_adjacency;              // tile che condividono un bordo, per il drag delle linee
+TileGrid g_tileGrid;                     // broad phase per le collisioni mentre si sposta una tile
+TileQuadtree g_tileTree;                 // tile nel mondo: layout, disegno e hit-test guardano solo la viewport
+POINT g_freeSpaceOrigin{};               // cella del mondo che in g_freeSpace e' (0, 0)
+bool g_freeSpaceStale{true};             // tile sostituite: g_freeSpace va rifatto prima di interrogarlo
+std::unordered_set<uint64_t> g_liveEdits; // tile con una EDIT: le visibili piu' quella col focus
+// drag col tasto centrale: sposta la viewport
+struct PanDrag {
+    bool active{false};
+    POINT start{};  // punto del click, px della board
+    POINT origin{}; // viewport a inizio drag
+};
+PanDrag g_pan;
+constexpr int kWorldCells = 1 << 20; // lato del mondo: verso destra e verso il basso non si arriva mai in fondo
+std::unordered_map<uint64_t, FitLayout> g_fitLayouts; // stato dell'adattamento per tile autoFit
+ParagraphHeightCache g_paragraphHeights{MeasureParagraphPx}; // condivisa: paragrafi uguali si misurano una volta
+// Zoom con Ctrl+rotella: durante il gesto le EDIT (tranne quella col focus) sono nascoste
+// e le tile si disegnano dalle istantanee scalate; il layout vero si fa una volta sola
+// quando il gesto si ferma.
+struct TileSnapshot {
+    HBITMAP bmp{};
+    int w{0}; // client della EDIT al momento della cattura
+    int h{0};
+};
+std::unordered_map<uint64_t, TileSnapshot> g_snapshots; // valide finche' testo, geometria e font non cambiano
+bool g_zooming{};
+static constexpr UINT_PTR kTimerZoomSettle = 3; // sulla board
+static constexpr UINT kZoomSettleMs = 200;
+constexpr double kZoomStep = 1.1; // per scatto di rotella
+constexpr double kMinZoom = 0.25;
+constexpr double kMaxZoom = 4.0;
+
+void DropSnapshot(uint64_t id) {
+    auto it = g_snapshots.find(id);
+    if (it == g_snapshots.end()) return;
+    FreeGdi(MemArea::Snapshots, it->second.bmp);
+    g_snapshots.erase(it);
+}
+
+void DropAllSnapshots() {
+    for (auto& [id, snap] : g_snapshots) FreeGdi(MemArea::Snapshots, snap.bmp);
+    g_snapshots.clear();
+}
 
 void SaveState();
+void FlushSyncChanges();
+void ExportMirror();
 void LayoutTiles();
-void Split2(int idx, bool vertical);
-void Split4(int idx);
+bool Split2(int idx, bool vertical);
+bool Split4(int idx);
 bool TextFitsInEdit(HWND edit, const std::wstring& text);
+RECT EditRect(const Tile& t);
+bool FitTextToTile(Tile& t, const std::wstring& text);
+void SetTileAutoFit(int idx, bool on);
+void SetTileScroll(int idx, bool on);
+void RevealTile(int idx);
+void ResetTracks();
+void ShowHistoryWindow();
+void ShowSearchWindow();
+void IndexSavedTexts();
+void FollowFileInTile(int idx);
+void UpdateTails();
+void StopFollowingFile(int idx);
+void RecalcFormulas();
+void ArmReminderTimer();
+int64_t ReminderPreset(int preset);
+void SetTileReminder(int idx, int64_t at);
+void PaintMemOverlay(HDC hdc, const RECT& client);
+void SetMemOverlay(bool on);
+void SetSpellCheck(bool on);
+std::wstring SnapshotLabel(int64_t time);
+bool AttachFromClipboard(uint64_t tileId);
+void AttachFileDialog(int idx);
+void OpenAttachment(const Attachment& a);
+void RemoveAttachment(int idx, size_t i);
+
+uint64_t NewTileId() { return g_state.nextTileId++; }
+
+// ora di sistema in ms Unix: le scadenze dei promemoria sono date vere
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
-static inline bool Overlap1D(int a0, int a1, int b0, int b1) {
-    // intervalli half-open: [a0,a1) e [b0,b1)
-    return a0 < b1 && b0 < a1;
+int FindTileIndexById(uint64_t id) {
+    // la mappa si ricostruisce da sola quando split/eliminazioni spostano gli indici; un id
+    // che non c'e' (tile gia' eliminata, richiesta IPC sbagliata) costa O(n) solo se nel
+    // frattempo sono state aggiunte o tolte tile
+    auto it = g_tileIndexById.find(id);
+    if (it != g_tileIndexById.end() && it->second < static_cast<int>(g_state.tiles.size()) && g_state.tiles[it->second].id == id)
+        return it->second;
+    if (it == g_tileIndexById.end() && !g_tileIndexStale) return -1;
+
+    g_tileIndexById.clear();
+    for (int i = 0; i < static_cast<int>(g_state.tiles.size()); ++i) g_tileIndexById[g_state.tiles[i].id] = i;
+    g_tileIndexStale = false;
+    it = g_tileIndexById.find(id);
+    return it == g_tileIndexById.end() ? -1 : it->second;
 }
-/* helpers per il clamping!*/
-int LimitRightEdgeCells(int idx, const Tile& orig, int desiredRight, int boardCellsX) {
-    int limit = std::min(desiredRight, boardCellsX);
-    const int origRight = orig.x + orig.w;
 
-    for (int j = 0; j < (int)g_state.tiles.size(); ++j) {
-        if (j == idx) continue;
-        const Tile& o = g_state.tiles[j];
+// textcodec.h: a blocchi SIMD sul testo ASCII, stesse sostituzioni (U+FFFD) delle API Win32
+std::string WideToUtf8(const std::wstring& w) {
+    std::string out;
+    AppendUtf8(out, w);
+    return out;
+}
 
-        // devono sovrapporsi verticalmente
-        if (!Overlap1D(orig.y, orig.y + orig.h, o.y, o.y + o.h)) continue;
+std::wstring Utf8ToWide(const std::string& s) {
+    std::wstring out;
+    AppendUtf16(out, s);
+    return out;
+}
 
-        // consideriamo solo ostacoli alla DESTRA del bordo originale
-        if (o.x >= origRight) {
-            limit = std::min(limit, o.x); // non puoi oltrepassare il left dell'ostacolo
-        }
-    }
-    return limit;
+void PublishTileChanged(uint64_t id) {
+    if (!g_ipc.HasSubscribers()) return;
+    g_ipc.Publish("{\"event\":\"changed\",\"tile\":" + std::to_string(id) + "}");
 }
 
-int LimitBottomEdgeCells(int idx, const Tile& orig, int desiredBottom, int boardCellsY) {
-    int limit = std::min(desiredBottom, boardCellsY);
-    const int origBottom = orig.y + orig.h;
+void ScheduleSave() {
+    g_savePending = true;
+    KillTimer(g_mainWnd, kTimerSaveDebounce);
+    SetTimer(g_mainWnd, kTimerSaveDebounce, kSaveDebounceMs, nullptr);
+}
 
-    for (int j = 0; j < (int)g_state.tiles.size(); ++j) {
-        if (j == idx) continue;
-        const Tile& o = g_state.tiles[j];
+// Il ricalcolo delle formule parte al prossimo giro di messaggi (o subito, da
+// OnTileTextChanged): piu' tile toccate insieme costano un solo Recalculate.
+void PostRecalc() {
+    if (g_recalcPosted || !g_mainWnd) return;
+    g_recalcPosted = true;
+    PostMessageW(g_mainWnd, kMsgRecalc, 0, 0);
+}
 
-        // devono sovrapporsi orizzontalmente
-        if (!Overlap1D(orig.x, orig.x + orig.w, o.x, o.x + o.w)) continue;
+void QueueRecalc(uint64_t id) {
+    g_formulaTexts.insert(id);
+    PostRecalc();
+}
 
-        // ostacoli sotto il bordo originale
-        if (o.y >= origBottom) {
-            limit = std::min(limit, o.y);
-        }
+// Testo cambiato per qualunque motivo: cronologia, cartella Markdown, formule e ricerca lo riprendono.
+void NoteTextChanged(uint64_t id) {
+    g_historyTexts.insert(id);
+    g_mirrorTexts.insert(id);
+    g_indexTexts.insert(id);
+    QueueRecalc(id);
+    if (g_state.spellCheck && g_mainWnd) {
+        // una raffica di tasti arriva al controllo come un testo solo
+        g_spellTexts.insert(id);
+        SetTimer(g_mainWnd, kTimerSpell, kSpellDebounceMs, nullptr);
     }
-    return limit;
 }
 
-int LimitLeftEdgeCells(int idx, const Tile& orig, int desiredLeft) {
-    int limit = std::max(desiredLeft, 0);
-    const int origLeft = orig.x;
-
-    for (int j = 0; j < (int)g_state.tiles.size(); ++j) {
-        if (j == idx) continue;
-        const Tile& o = g_state.tiles[j];
-
-        if (!Overlap1D(orig.y, orig.y + orig.h, o.y, o.y + o.h)) continue;
+// Punto unico per le modifiche di testo: EN_CHANGE e comandi IPC passano di qui.
+void OnTileTextChanged(const Tile& t) {
+    DropSnapshot(t.id);
+    g_dirtyTiles.insert(t.id);
+    NoteTextChanged(t.id);
+    RecalcFormulas(); // chi scrive vede i totali aggiornati a ogni tasto
+    ScheduleSave();
+    PublishTileChanged(t.id);
+}
 
-        const int oRight = o.x + o.w;
-        // ostacoli a sinistra del bordo originale
-        if (oRight <= origLeft) {
-            limit = std::max(limit, oRight); // non puoi entrare: left >= right dell'ostacolo
-        }
+// Layout + salvataggio dopo split/eliminazioni; durante un batch IPC vengono fatti una volta sola a fine giro.
+void CommitLayoutChange() {
+    if (g_layoutBatch) {
+        g_layoutPending = true;
+        return;
     }
-    return limit;
+    g_layoutDirty = true;
+    LayoutTiles();
+    SaveState();
+    if (g_ipc.HasSubscribers()) g_ipc.Publish("{\"event\":\"layout\"}");
 }
 
-int LimitTopEdgeCells(int idx, const Tile& orig, int desiredTop) {
-    int limit = std::max(desiredTop, 0);
-    const int origTop = orig.y;
-
-    for (int j = 0; j < (int)g_state.tiles.size(); ++j) {
-        if (j == idx) continue;
-        const Tile& o = g_state.tiles[j];
-
-        if (!Overlap1D(orig.x, orig.x + orig.w, o.x, o.x + o.w)) continue;
+// Con la sincronizzazione ogni dispositivo crea id in un intervallo suo (2^32 id dalla
+// base), cosi' due tile create insieme su due macchine non si scontrano. 0 = senza.
+uint64_t TileIdBase() {
+    if (g_state.syncFolder.empty() || g_state.replicaId == 0) return 0;
+    return (g_state.replicaId % ((1ull << 20) - 1) + 1) << 32;
+}
 
-        const int oBottom = o.y + o.h;
-        if (oBottom <= origTop) {
-            limit = std::max(limit, oBottom);
-        }
+void AssignMissingTileIds() {
+    const uint64_t base = TileIdBase();
+    uint64_t maxId = 0;
+    for (const auto& t : g_state.tiles) {
+        // le tile arrivate dagli altri dispositivi non spostano il nostro contatore
+        if (base == 0 || (t.id >= base && t.id - base < (1ull << 32))) maxId = std::max(maxId, t.id);
+    }
+    g_state.nextTileId = std::max({g_state.nextTileId, maxId + 1, base});
+    for (auto& t : g_state.tiles) {
+        if (t.id == 0) t.id = NewTileId();
     }
-    return limit;
 }
 
 void SyncTileTextsFromWindows() {
     for (auto& t : g_state.tiles) {
-        if (!t.edit) continue;
+        // nella EDIT di una tail c'e' il file, in quella di una formula il risultato
+        if (!t.edit || !t.tailPath.empty() || g_formulaShown.count(t.id)) continue;
 
         int len = GetWindowTextLengthW(t.edit);
         std::wstring text(len + 1, L'\0');
@@ -209,60 +581,167 @@ void SyncTileTextsFromWindows() {
     }
 }
 
-POINT GetBoardCellBounds() {
+// Lato della cella di default in px, frazionario con lo zoom
+double Cell() { return std::max(16, g_state.cellSize) * g_state.zoom; }
+
+// Celle del mondo <-> px del mondo lungo un asse. Ogni confine si arrotonda per conto
+// suo, cosi' due tile che condividono un lato finiscono sullo stesso pixel.
+int TrackToPx(const TrackAxis& axis, int c) { return static_cast<int>(std::lround(axis.Offset(c) * g_state.zoom)); }
+
+// traccia che contiene il pixel, coerente con l'arrotondamento di TrackToPx
+int PxToTrack(const TrackAxis& axis, int px) {
+    int c = axis.IndexAt(static_cast<int64_t>(std::floor(px / g_state.zoom)));
+    if (TrackToPx(axis, c) > px) --c;
+    else if (TrackToPx(axis, c + 1) <= px) ++c;
+    return c;
+}
+
+int SnapToLine(const TrackAxis& axis, int px) { return axis.NearestLine(std::llround(px / g_state.zoom)); }
+
+int ToPxX(int c) { return TrackToPx(g_state.columns, c); }
+int ToPxY(int r) { return TrackToPx(g_state.rows, r); }
+int PxToColumn(int px) { return PxToTrack(g_state.columns, px); }
+int PxToRow(int px) { return PxToTrack(g_state.rows, px); }
+
+// Celle del mondo sotto la board: whole = solo quelle interamente visibili
+// (spazio libero), altrimenti anche quelle tagliate dal bordo (layout, disegno).
+CellRect GetViewportCells(bool whole = false) {
     RECT rc{};
-    if (!g_board || !GetClientRect(g_board, &rc)) return POINT{1, 1};
+    if (!g_board || !GetClientRect(g_board, &rc)) return CellRect{0, 0, 1, 1};
 
     const int boardW = std::max(1, static_cast<int>(rc.right - rc.left));
     const int boardH = std::max(1, static_cast<int>(rc.bottom - rc.top));
-    const int cell = std::max(16, g_state.cellSize);
-    const int cellsX = std::max(1, boardW / cell);
-    const int cellsY = std::max(1, boardH / cell);
-    return POINT{cellsX, cellsY};
+    const int right = g_state.viewX + boardW;
+    const int bottom = g_state.viewY + boardH;
+    int x0 = PxToColumn(g_state.viewX);
+    int y0 = PxToRow(g_state.viewY);
+    int x1 = PxToColumn(right - 1) + 1;
+    int y1 = PxToRow(bottom - 1) + 1;
+    if (whole) {
+        if (ToPxX(x0) < g_state.viewX) ++x0;
+        if (ToPxY(y0) < g_state.viewY) ++y0;
+        x1 = PxToColumn(right);
+        y1 = PxToRow(bottom);
+    }
+    return CellRect{x0, y0, std::max(1, x1 - x0), std::max(1, y1 - y0)};
 }
 
-std::wstring GetStatePath() {
+CellRect TileRect(const Tile& t) { return CellRect{t.x, t.y, t.w, t.h}; }
+
+// g_freeSpace copre solo la viewport (il mondo non ha un fondo da indicizzare)
+CellRect ToFreeSpaceRect(const CellRect& r) {
+    return CellRect{r.x - static_cast<int>(g_freeSpaceOrigin.x), r.y - static_cast<int>(g_freeSpaceOrigin.y), r.w, r.h};
+}
+
+// Indici spaziali sulle tile: ricostruiti da zero al caricamento e quando le tile
+// vengono sostituite, poi aggiornati tile per tile da chi modifica la geometria.
+void RebuildTileIndexes() {
+    g_tileIndexStale = true;
+    g_adjacency.Clear();
+    g_tileGrid.Clear();
+    g_tileTree.Clear();
+    for (const auto& t : g_state.tiles) {
+        g_adjacency.Add(t.id, TileRect(t));
+        g_tileGrid.Insert(t.id, TileRect(t));
+        g_tileTree.Insert(t.id, TileRect(t));
+    }
+    g_freeSpaceStale = true;
+    g_formulas.Clear();
+    for (const auto& t : g_state.tiles) QueueRecalc(t.id);
+    g_reminders.Reset(NowMs());
+    for (const auto& t : g_state.tiles) {
+        if (t.remindAt) g_reminders.Add(t.id, t.remindAt); // gia' scaduti: scattano al primo timer
+    }
+    ArmReminderTimer();
+}
+
+// Rifa g_freeSpace se la viewport e' cambiata: costa le tile visibili, e si fa solo
+// quando serve davvero (apertura dei menu di aggiunta), non a ogni pan.
+void EnsureFreeSpaceIndex() {
+    const CellRect view = GetViewportCells(true);
+    if (!g_freeSpaceStale && view.x == g_freeSpaceOrigin.x && view.y == g_freeSpaceOrigin.y && view.w == g_freeSpace.Width() &&
+        view.h == g_freeSpace.Height())
+        return;
+
+    g_freeSpace.Reset(view.w, view.h);
+    g_freeSpaceOrigin = POINT{view.x, view.y};
+    std::vector<uint64_t> ids;
+    g_tileTree.Query(view, ids);
+    for (uint64_t id : ids) g_freeSpace.Occupy(ToFreeSpaceRect(*g_tileGrid.Rect(id)));
+    g_freeSpaceStale = false;
+}
+
+void IndexTileAdded(const Tile& t) {
+    g_tileIndexStale = true;
+    if (!g_freeSpaceStale) g_freeSpace.Occupy(ToFreeSpaceRect(TileRect(t)));
+    g_adjacency.Add(t.id, TileRect(t));
+    g_tileGrid.Insert(t.id, TileRect(t));
+    g_tileTree.Insert(t.id, TileRect(t));
+    QueueRecalc(t.id);
+    if (t.remindAt) {
+        g_reminders.Add(t.id, t.remindAt);
+        ArmReminderTimer();
+    }
+}
+
+void IndexTileRemoved(const Tile& t) {
+    g_tileIndexStale = true;
+    DropSnapshot(t.id);
+    g_formulas.RemoveTile(t.id); // chi la citava va ricalcolato
+    g_formulaShown.erase(t.id);
+    g_markdown.erase(t.id);
+    if (g_state.spellCheck) g_spell.Remove(t.id);
+    PostRecalc();
+    if (g_reminders.Remove(t.id)) ArmReminderTimer();
+    g_ringing.erase(t.id);
+    if (!g_freeSpaceStale) g_freeSpace.Release(ToFreeSpaceRect(TileRect(t)));
+    g_adjacency.Remove(t.id);
+    g_tileGrid.Remove(t.id);
+    g_tileTree.Remove(t.id);
+}
+
+void IndexTileMoved(const CellRect& before, const Tile& t) {
+    DropSnapshot(t.id);
+    if (!g_freeSpaceStale) g_freeSpace.Move(ToFreeSpaceRect(before), ToFreeSpaceRect(TileRect(t)));
+    g_adjacency.Move(t.id, TileRect(t));
+    g_tileGrid.Move(t.id, TileRect(t));
+    g_tileTree.Move(t.id, TileRect(t));
+}
+
+std::wstring GetStateFolder() {
     wchar_t appData[MAX_PATH]{};
     SHGetFolderPathW(nullptr, CSIDL_APPDATA, nullptr, SHGFP_TYPE_CURRENT, appData);
     std::wstring folder = std::wstring(appData) + L"\\GridNotes";
     CreateDirectoryW(folder.c_str(), nullptr);
-    return folder + L"\\state.json";
+    return folder;
+}
+
+std::wstring GetStatePath() {
+    return GetStateFolder() + L"\\state.json";
+}
+
+// state.json e' UTF-8; i file scritti dalle versioni con wofstream sono nella code page locale
+std::wstring DecodeStateBytes(const std::string& bytes) {
+    if (bytes.empty()) return {};
+    if (IsValidUtf8(bytes)) return Utf8ToWide(bytes);
+
+    const int m = MultiByteToWideChar(CP_ACP, 0, bytes.data(), static_cast<int>(bytes.size()), nullptr, 0);
+    std::wstring out(m, L'\0');
+    MultiByteToWideChar(CP_ACP, 0, bytes.data(), static_cast<int>(bytes.size()), out.data(), m);
+    return out;
 }
 
+// RFC 8259: anche gli altri controlli (\u0001...) e i surrogati spaiati, che prima
+// finivano crudi nel file e lo rendevano JSON non valido
 std::wstring JsonEscape(const std::wstring& s) {
     std::wstring out;
-    out.reserve(s.size());
-    for (wchar_t c : s) {
-        switch (c) {
-            case L'\\': out += L"\\\\"; break;
-            case L'"': out += L"\\\""; break;
-            case L'\n': out += L"\\n"; break;
-            case L'\r': out += L"\\r"; break;
-            case L'\t': out += L"\\t"; break;
-            default: out += c; break;
-        }
-    }
+    AppendJsonEscaped(out, s);
     return out;
 }
 
 std::wstring JsonUnescape(const std::wstring& s) {
     std::wstring out;
-    out.reserve(s.size());
-    for (size_t i = 0; i < s.size(); ++i) {
-        if (s[i] == L'\\' && i + 1 < s.size()) {
-            ++i;
-            switch (s[i]) {
-                case L'\\': out += L'\\'; break;
-                case L'"': out += L'"'; break;
-                case L'n': out += L'\n'; break;
-                case L'r': out += L'\r'; break;
-                case L't': out += L'\t'; break;
-                default: out += s[i]; break;
-            }
-        } else {
-            out += s[i];
-        }
-    }
+    AppendJsonUnescaped(out, s);
     return out;
 }
 
@@ -307,6 +786,45 @@ int ExtractJsonInt(const std::wstring& src, const std::wstring& key, int fallbac
     return _wtoi(src.substr(i, end - i).c_str());
 }
 
+double ExtractJsonDouble(const std::wstring& src, const std::wstring& key, double fallback) {
+    const std::wstring token = L"\"" + key + L"\":";
+    const size_t pos = src.find(token);
+    if (pos == std::wstring::npos) return fallback;
+
+    const wchar_t* begin = src.c_str() + pos + token.size();
+    wchar_t* end = nullptr;
+    const double v = wcstod(begin, &end); // salta da solo gli spazi iniziali
+    return end != begin && std::isfinite(v) ? v : fallback;
+}
+
+// Tutti gli interi dentro l'array di key (anche annidati), in ordine
+std::vector<int> ExtractJsonIntList(const std::wstring& src, const std::wstring& key) {
+    std::vector<int> out;
+    const std::wstring token = L"\"" + key + L"\":";
+    const size_t pos = src.find(token);
+    if (pos == std::wstring::npos) return out;
+
+    size_t i = pos + token.size();
+    while (i < src.size() && iswspace(src[i])) ++i;
+    if (i >= src.size() || src[i] != L'[') return out;
+
+    int depth = 0;
+    for (; i < src.size(); ++i) {
+        const wchar_t c = src[i];
+        if (c == L'[') {
+            ++depth;
+        } else if (c == L']') {
+            if (--depth == 0) break;
+        } else if (c == L'-' || iswdigit(c)) {
+            size_t end = i + 1;
+            while (end < src.size() && iswdigit(src[end])) ++end;
+            out.push_back(_wtoi(src.substr(i, end - i).c_str()));
+            i = end - 1;
+        }
+    }
+    return out;
+}
+
 bool ExtractJsonBool(const std::wstring& src, const std::wstring& key, bool fallback) {
     const std::wstring token = L"\"" + key + L"\":";
     const size_t pos = src.find(token);
@@ -319,128 +837,471 @@ bool ExtractJsonBool(const std::wstring& src, const std::wstring& key, bool fall
     return fallback;
 }
 
-std::vector<Tile> ExtractTiles(const std::wstring& src) {
-    std::vector<Tile> tiles;
+uint64_t ExtractJsonU64(const std::wstring& src, const std::wstring& key, uint64_t fallback) {
+    const std::wstring token = L"\"" + key + L"\":";
+    const size_t pos = src.find(token);
+    if (pos == std::wstring::npos) return fallback;
+
+    size_t i = pos + token.size();
+    while (i < src.size() && iswspace(src[i])) ++i;
+    uint64_t v = 0;
+    size_t end = i;
+    while (end < src.size() && iswdigit(src[end])) v = v * 10 + (src[end++] - L'0');
+    return end > i ? v : fallback;
+}
+
+std::wstring ExtractJsonString(const std::wstring& src, const std::wstring& key, const std::wstring& fallback) {
+    const std::wstring token = L"\"" + key + L"\":";
+    const size_t pos = src.find(token);
+    if (pos == std::wstring::npos) return fallback;
+
+    size_t i = pos + token.size();
+    while (i < src.size() && iswspace(src[i])) ++i;
+    if (i >= src.size() || src[i] != L'"') return fallback;
+    const size_t end = FindJsonStringEnd(src, ++i);
+    if (end == std::wstring::npos) return fallback;
+    std::wstring out;
+    AppendJsonUnescaped(out, std::wstring_view(src).substr(i, end - i));
+    return out;
+}
+
+// Fine dell'oggetto o dell'array che si apre in src[open], con le parentesi contate
+// fuori dalle stringhe: i testi delle tile possono contenere { } [ ] e \"
+size_t MatchingBracket(const std::wstring& src, size_t open) {
+    int depth = 0;
+    for (size_t i = open; i < src.size(); ++i) {
+        const wchar_t c = src[i];
+        if (c == L'"') {
+            i = FindJsonStringEnd(src, i + 1);
+            if (i == std::wstring::npos) break;
+        } else if (c == L'{' || c == L'[') {
+            ++depth;
+        } else if ((c == L'}' || c == L']') && --depth == 0) {
+            return i;
+        }
+    }
+    return std::wstring::npos;
+}
+
+// "files": [{"hash": ..., "name": ..., "size": ..., "iw": ..., "ih": ...}, ...] di una tile,
+// tolto da obj: i nomi dei file non devono poter sembrare chiavi della tile
+std::vector<Attachment> ExtractAttachments(std::wstring& obj) {
+    std::vector<Attachment> files;
+    const std::wstring key = L"\"files\":";
+    const size_t keyPos = obj.find(key);
+    if (keyPos == std::wstring::npos) return files;
+    const size_t arrayStart = obj.find(L'[', keyPos + key.size());
+    if (arrayStart == std::wstring::npos) return files;
+    const size_t arrayEnd = MatchingBracket(obj, arrayStart);
+    if (arrayEnd == std::wstring::npos) return files;
+
+    size_t pos = arrayStart + 1;
+    while (true) {
+        const size_t open = obj.find(L'{', pos);
+        if (open == std::wstring::npos || open > arrayEnd) break;
+        const size_t close = MatchingBracket(obj, open);
+        if (close == std::wstring::npos || close > arrayEnd) break;
+        const std::wstring item = obj.substr(open, close - open + 1);
+        Attachment a;
+        a.hash = WideToUtf8(ExtractJsonString(item, L"hash", L""));
+        a.name = WideToUtf8(ExtractJsonString(item, L"name", L""));
+        a.size = ExtractJsonU64(item, L"size", 0);
+        a.width = std::max(0, ExtractJsonInt(item, L"iw", 0));
+        a.height = std::max(0, ExtractJsonInt(item, L"ih", 0));
+        if (IsBlobHash(a.hash)) files.push_back(std::move(a));
+        pos = close + 1;
+    }
+    obj.erase(keyPos, arrayEnd + 1 - keyPos);
+    return files;
+}
+
+std::wstring AttachmentsJson(const std::vector<Attachment>& files) {
+    std::wstring out = L", \"files\": [";
+    for (size_t i = 0; i < files.size(); ++i) {
+        const Attachment& a = files[i];
+        if (i) out += L", ";
+        out += L"{\"hash\": \"" + Utf8ToWide(a.hash) + L"\", \"name\": \"" + JsonEscape(Utf8ToWide(a.name)) + L"\", \"size\": " + std::to_wstring(a.size);
+        if (a.width > 0) out += L", \"iw\": " + std::to_wstring(a.width) + L", \"ih\": " + std::to_wstring(a.height);
+        out += L"}";
+    }
+    return out + L"]";
+}
+
+TileList ExtractTiles(const std::wstring& src) {
+    TileList tiles;
     const std::wstring key = L"\"tiles\":";
     const size_t keyPos = src.find(key);
     if (keyPos == std::wstring::npos) return tiles;
 
     const size_t arrayStart = src.find(L'[', keyPos + key.size());
-    const size_t arrayEnd = src.find(L']', arrayStart + 1);
-    if (arrayStart == std::wstring::npos || arrayEnd == std::wstring::npos) return tiles;
+    if (arrayStart == std::wstring::npos) return tiles;
+    const size_t arrayEnd = MatchingBracket(src, arrayStart);
+    if (arrayEnd == std::wstring::npos) return tiles;
 
-    size_t objPos = arrayStart;
+    size_t objPos = arrayStart + 1;
     while (true) {
         const size_t open = src.find(L'{', objPos);
         if (open == std::wstring::npos || open > arrayEnd) break;
-        const size_t close = src.find(L'}', open + 1);
+        const size_t close = MatchingBracket(src, open);
         if (close == std::wstring::npos || close > arrayEnd) break;
 
         std::wstring obj = src.substr(open, close - open + 1);
         Tile t;
+        t.files = ExtractAttachments(obj);
         t.x = ExtractJsonInt(obj, L"x", 0);
         t.y = ExtractJsonInt(obj, L"y", 0);
         t.w = std::max(1, ExtractJsonInt(obj, L"w", 1));
         t.h = std::max(1, ExtractJsonInt(obj, L"h", 1));
-            //printf("ken");
-
-        std::wstring token = L"\"text\":";
-size_t pos = obj.find(token);
-
-if (pos != std::wstring::npos) {
-    size_t i = pos + token.size();
-
-    // salta eventuali spazi
-    while (i < obj.size() && obj[i] == L' ')
-        ++i;
-
-    // deve iniziare con "
-    if (i < obj.size() && obj[i] == L'"') {
-        ++i;
-
-        std::wstring raw;
-        while (i < obj.size() && obj[i] != L'"') {
-            raw += obj[i++];
-        }
-        t.text = JsonUnescape(raw); //fondamentale per evitare doppi \
-        t.text = raw;  // testo estratto
-    }
-}
-
-        tiles.push_back(t);
+        t.id = ExtractJsonU64(obj, L"id", 0);
+        t.autoFit = ExtractJsonBool(obj, L"fit", false);
+        t.tailPath = ExtractJsonString(obj, L"tail", L"");
+        t.remindAt = static_cast<int64_t>(ExtractJsonU64(obj, L"remind", 0));
+        t.scroll = ExtractJsonBool(obj, L"scroll", false);
+        t.text = ExtractJsonString(obj, L"text", L""); // anche con \" dentro: prima si fermava li'
+
+        tiles.push_back(std::move(t));
         objPos = close + 1;
     }
 
     return tiles;
 }
 
-void SaveState() {
-    SyncTileTextsFromWindows();
+// [[indice, px], ...] delle sole tracce diverse dal default
+std::wstring TrackSizesJson(const TrackAxis& axis) {
+    std::wstring out = L"[";
+    for (const auto& [index, px] : axis.Overrides()) {
+        if (out.size() > 1) out += L", ";
+        out += L"[" + std::to_wstring(index) + L", " + std::to_wstring(px) + L"]";
+    }
+    return out + L"]";
+}
 
-    const std::wstring statePath = GetStatePath();
-    std::wofstream out(statePath.c_str());
-    if (!out) return;
+void ParseTrackSizes(const std::wstring& json, const std::wstring& key, int defaultSize, TrackAxis& axis) {
+    axis.Clear();
+    axis.SetDefaultSize(defaultSize);
+    const std::vector<int> values = ExtractJsonIntList(json, key);
+    for (size_t i = 0; i + 1 < values.size(); i += 2) {
+        if (values[i] >= 0 && values[i] < kWorldCells) axis.SetSize(values[i], values[i + 1]);
+    }
+}
 
+std::wstring SerializeState() {
+    std::wostringstream out;
     out << L"{\n";
     out << L"  \"cellSize\": " << g_state.cellSize << L",\n";
     out << L"  \"startWithWindows\": " << (g_state.startWithWindows ? L"true" : L"false") << L",\n";
     out << L"  \"windowWidth\": " << g_state.windowWidth << L",\n";
     out << L"  \"windowHeight\": " << g_state.windowHeight << L",\n";
+    out << L"  \"viewX\": " << g_state.viewX << L",\n";
+    out << L"  \"viewY\": " << g_state.viewY << L",\n";
+    out << L"  \"zoom\": " << g_state.zoom << L",\n";
+    out << L"  \"columnSizes\": " << TrackSizesJson(g_state.columns) << L",\n";
+    out << L"  \"rowSizes\": " << TrackSizesJson(g_state.rows) << L",\n";
+    if (!g_state.mirrorFolder.empty()) out << L"  \"mirrorFolder\": \"" << JsonEscape(g_state.mirrorFolder) << L"\",\n";
+    if (g_state.spellCheck) out << L"  \"spellCheck\": true,\n";
+    if (!g_state.syncFolder.empty()) {
+        out << L"  \"syncFolder\": \"" << JsonEscape(g_state.syncFolder) << L"\",\n";
+        out << L"  \"replicaId\": " << g_state.replicaId << L",\n";
+    }
     out << L"  \"tiles\": [\n";
     for (size_t i = 0; i < g_state.tiles.size(); ++i) {
         const Tile& t = g_state.tiles[i];
-        out << L"    {\"x\": " << t.x << L", \"y\": " << t.y << L", \"w\": " << t.w << L", \"h\": " << t.h
+        out << L"    {\"id\": " << t.id << L", \"x\": " << t.x << L", \"y\": " << t.y << L", \"w\": " << t.w << L", \"h\": " << t.h
+            << (t.autoFit ? L", \"fit\": true" : L"") << (t.scroll ? L", \"scroll\": true" : L"") << (t.tailPath.empty() ? L"" : L", \"tail\": \"" + JsonEscape(t.tailPath) + L"\"")
+            << (t.remindAt ? L", \"remind\": " + std::to_wstring(t.remindAt) : L"")
+            << (t.files.empty() ? L"" : AttachmentsJson(t.files))
             << L", \"text\": \"" << JsonEscape(t.text) << L"\"}";
         if (i + 1 < g_state.tiles.size()) out << L",";
         out << L"\n";
     }
     out << L"  ]\n";
     out << L"}\n";
+    return out.str();
 }
 
-void LoadState() {
-    g_state = AppState{};
+void ParseState(const std::wstring& json, AppState& st) {
+    // le chiavi di primo livello stanno prima di "tiles": cercarle in tutto il file farebbe
+    // contare anche quelle che compaiono nelle tile (testo, allegati) o mancano in testa
+    const std::wstring header = json.substr(0, json.find(L"\"tiles\":"));
+    st.cellSize = std::max(16, ExtractJsonInt(header, L"cellSize", st.cellSize));
+    st.startWithWindows = ExtractJsonBool(header, L"startWithWindows", false);
+    st.windowWidth = std::max(600, ExtractJsonInt(header, L"windowWidth", st.windowWidth));
+    st.windowHeight = std::max(400, ExtractJsonInt(header, L"windowHeight", st.windowHeight));
+    st.viewX = std::max(0, ExtractJsonInt(header, L"viewX", st.viewX));
+    st.viewY = std::max(0, ExtractJsonInt(header, L"viewY", st.viewY));
+    st.zoom = std::clamp(ExtractJsonDouble(header, L"zoom", st.zoom), kMinZoom, kMaxZoom);
+    ParseTrackSizes(header, L"columnSizes", st.cellSize, st.columns);
+    ParseTrackSizes(header, L"rowSizes", st.cellSize, st.rows);
+    st.syncFolder = ExtractJsonString(header, L"syncFolder", L"");
+    st.replicaId = ExtractJsonU64(header, L"replicaId", 0);
+    st.mirrorFolder = ExtractJsonString(header, L"mirrorFolder", L"");
+    st.spellCheck = ExtractJsonBool(header, L"spellCheck", false);
+    st.tiles = ExtractTiles(json);
+}
+
+// Tile fuori board o sovrapposte (file scritto a mano, troncato, unito da fuori) rompono
+// le assunzioni di Limit*EdgeCells e di HitTestTile: si riparano e si annota cosa e' cambiato.
+void ValidateLayout(bool notifyUser) {
+    std::vector<CellRect> rects;
+    rects.reserve(g_state.tiles.size());
+    for (const auto& t : g_state.tiles) rects.push_back(CellRect{t.x, t.y, t.w, t.h});
+
+    // il mondo non ha fondo: le tile sovrapposte vanno in pila sotto il contenuto
+    const LayoutReport report = RepairLayout(rects, kWorldCells, 0);
+    if (report.fixes.empty()) return;
+
+    for (size_t i = 0; i < rects.size(); ++i) {
+        Tile& t = g_state.tiles[i];
+        t.x = rects[i].x;
+        t.y = rects[i].y;
+        t.w = rects[i].w;
+        t.h = rects[i].h;
+    }
+    g_layoutDirty = true;
+
+    std::wstring details;
+    for (const auto& fix : report.fixes) {
+        details += L"  id " + std::to_wstring(g_state.tiles[fix.index].id) + L", " + DescribeLayoutFix(fix) + L"\n";
+    }
+    const std::wstring summary = std::to_wstring(report.overlaps) + L" sovrapposizioni, " + std::to_wstring(report.outOfBounds) +
+                                 L" tile fuori board, " + std::to_wstring(report.fixes.size()) + L" correzioni";
+
+    std::ofstream log(std::filesystem::path(GetStateFolder()) / L"layout-repair.log", std::ios::binary | std::ios::app);
+    log << WideToUtf8(L"layout riparato: " + summary + L"\n" + details);
+
+    if (notifyUser) {
+        const std::wstring msg = L"Il layout salvato non era valido (" + summary + L").\nDettagli in layout-repair.log";
+        MessageBoxW(g_mainWnd, msg.c_str(), kAppName, MB_OK | MB_ICONWARNING);
+    }
+}
+
+// Sostituisce le tile mantenendo le EDIT di quelle che esistono ancora (stesso id).
+void ReplaceTiles(TileList tiles) {
+    std::unordered_map<uint64_t, const Tile*> old;
+    for (const auto& t : g_state.tiles) old[t.id] = &t;
+
+    for (auto& t : tiles) {
+        t.edit = nullptr;
+        auto it = old.find(t.id);
+        if (it == old.end() || it->second->text != t.text) NoteTextChanged(t.id);
+        if (it == old.end() || !it->second->edit) continue;
+        if (it->second->scroll != t.scroll) continue; // classe diversa: la vecchia finestra si distrugge sotto
+        t.edit = it->second->edit;
+        const Tile& before = *it->second;
+        if (before.text != t.text || before.x != t.x || before.y != t.y || before.w != t.w || before.h != t.h) DropSnapshot(t.id);
+        if (it->second->text != t.text && t.tailPath.empty()) {
+            g_internalTextSet = true;
+            SetWindowTextW(t.edit, t.text.c_str());
+            g_internalTextSet = false;
+        }
+        old.erase(it);
+    }
+    for (auto& [id, t] : old) {
+        if (t->edit) DestroyWindow(t->edit);
+        DropSnapshot(id);
+    }
+
+    g_state.tiles = std::move(tiles);
+    g_fitLayouts.clear(); // testi cambiati da fuori: l'adattamento riparte da zero
+    AssignMissingTileIds();
+    ValidateLayout(false);
+    RebuildTileIndexes();
+    if (g_state.spellCheck) {
+        std::unordered_set<uint64_t> ids;
+        for (const auto& t : g_state.tiles) ids.insert(t.id);
+        g_spell.Retain(std::move(ids));
+    }
+    UpdateTails();
+    LayoutTiles();
+}
+
+// state.json e' stato cambiato da fuori (CLI, script, editor): invece di sovrascriverlo
+// si riparte dal contenuto esterno e si riapplicano solo le modifiche locali non ancora salvate.
+void MergeExternalState(const std::string& bytes) {
+    g_stateHash = ContentHash64(bytes);
+    const std::wstring json = DecodeStateBytes(bytes);
+    if (json.find(L"\"tiles\":") == std::wstring::npos) return; // file vuoto o troncato: teniamo il nostro
+
+    AppState ext;
+    ParseState(json, ext);
+    SyncTileTextsFromWindows();
+
+    std::unordered_map<uint64_t, size_t> extIndex;
+    for (size_t i = 0; i < ext.tiles.size(); ++i) extIndex[ext.tiles[i].id] = i;
+
+    // una tile editata qui ma sparita dal file esterno non va persa: resta la geometria locale
+    bool keepLocalLayout = g_layoutDirty;
+    for (uint64_t id : g_dirtyTiles) {
+        if (!extIndex.count(id)) keepLocalLayout = true;
+    }
+
+    // l'insieme delle tile e i testi vengono dal file esterno (tile aggiunte o cancellate da fuori
+    // comprese); da qui solo i testi editati e, se il layout locale e' cambiato, le posizioni delle
+    // tile presenti da entrambe le parti
+    TileList merged = ext.tiles;
+    for (auto& t : merged) {
+        const int local = FindTileIndexById(t.id);
+        if (local < 0) continue;
+        const Tile& mine = g_state.tiles[local];
+        if (g_dirtyTiles.count(t.id)) t.text = mine.text;
+        if (keepLocalLayout) {
+            t.x = mine.x;
+            t.y = mine.y;
+            t.w = mine.w;
+            t.h = mine.h;
+        }
+    }
+    for (const auto& t : g_state.tiles) {
+        if (g_dirtyTiles.count(t.id) && !extIndex.count(t.id)) merged.push_back(t);
+    }
+    if (!keepLocalLayout) {
+        g_state.cellSize = ext.cellSize;
+        g_state.columns = ext.columns;
+        g_state.rows = ext.rows;
+        DropAllSnapshots(); // le tracce spostano tutte le tile in px
+    }
+
+    ReplaceTiles(std::move(merged));
+}
+
+void SaveState() {
+    SyncTileTextsFromWindows();
+    FlushSyncChanges();
 
     const std::wstring statePath = GetStatePath();
-    std::wifstream in(statePath.c_str());
-    if (!in) return;
 
-    std::wstringstream buffer;
-    buffer << in.rdbuf();
-    std::wstring json = buffer.str();
+    // confronto per contenuto, non per timestamp: se il file non e' quello che abbiamo lasciato noi si unisce prima
+    std::string onDisk;
+    ReadWholeFile(statePath, onDisk);
+    if (ContentHash64(onDisk) != g_stateHash) MergeExternalState(onDisk);
+    ExportMirror();
+
+    const std::string bytes = WideToUtf8(SerializeState());
+    if (!WriteFileAtomic(statePath, bytes)) return;
 
-    g_state.cellSize = std::max(16, ExtractJsonInt(json, L"cellSize", g_state.cellSize));
-    g_state.startWithWindows = ExtractJsonBool(json, L"startWithWindows", false);
-    g_state.windowWidth = std::max(600, ExtractJsonInt(json, L"windowWidth", g_state.windowWidth));
-    g_state.windowHeight = std::max(400, ExtractJsonInt(json, L"windowHeight", g_state.windowHeight));
-    g_state.tiles = ExtractTiles(json);
+    g_stateHash = ContentHash64(bytes);
+    g_dirtyTiles.clear();
+    g_layoutDirty = false;
+    IndexSavedTexts();
+}
+
+void CheckExternalStateChange() {
+    std::string onDisk;
+    if (!ReadWholeFile(GetStatePath(), onDisk)) return;
+    if (ContentHash64(onDisk) == g_stateHash) return; // e' il nostro ultimo salvataggio
+
+    MergeExternalState(onDisk);
+    if (!g_dirtyTiles.empty() || g_layoutDirty) ScheduleSave();
+}
+
+void LoadState() {
+    g_state = AppState{};
+
+    std::string bytes;
+    ReadWholeFile(GetStatePath(), bytes);
+    g_stateHash = ContentHash64(bytes);
+    if (bytes.empty()) return;
+
+    ParseState(DecodeStateBytes(bytes), g_state);
+    AssignMissingTileIds();
 }
 
 void CreateDefault2x2(RECT rcBoard) {
     const int boardW = static_cast<int>(rcBoard.right - rcBoard.left);
     const int boardH = static_cast<int>(rcBoard.bottom - rcBoard.top);
-    const int cell = std::max(16, g_state.cellSize);
-    const int cellsX = std::max(2, boardW / cell);
-    const int cellsY = std::max(2, boardH / cell);
+    const int cellsX = std::max(2, PxToColumn(boardW));
+    const int cellsY = std::max(2, PxToRow(boardH));
     const int halfX = cellsX / 2;
     const int halfY = cellsY / 2;
 
     g_state.tiles.clear();
-    g_state.tiles.push_back(Tile{0, 0, halfX, halfY, L"", nullptr});
-    g_state.tiles.push_back(Tile{halfX, 0, cellsX - halfX, halfY, L"", nullptr});
-    g_state.tiles.push_back(Tile{0, halfY, halfX, cellsY - halfY, L"", nullptr});
-    g_state.tiles.push_back(Tile{halfX, halfY, cellsX - halfX, cellsY - halfY, L"", nullptr});
+    g_state.tiles.push_back(Tile{0, 0, halfX, halfY, L"", nullptr, NewTileId()});
+    g_state.tiles.push_back(Tile{halfX, 0, cellsX - halfX, halfY, L"", nullptr, NewTileId()});
+    g_state.tiles.push_back(Tile{0, halfY, halfX, cellsY - halfY, L"", nullptr, NewTileId()});
+    g_state.tiles.push_back(Tile{halfX, halfY, cellsX - halfX, cellsY - halfY, L"", nullptr, NewTileId()});
 }
 
-int Cell() { return std::max(16, g_state.cellSize); }
-int ToPx(int c) { return c * Cell(); }
-int SnapToCells(int px) { return static_cast<int>(std::round(static_cast<double>(px) / Cell())); }
+
+// Celle del mondo -> px della board (le EDIT e il disegno stanno in coordinate client)
+int ScreenX(int cellX) { return ToPxX(cellX) - g_state.viewX; }
+int ScreenY(int cellY) { return ToPxY(cellY) - g_state.viewY; }
+RECT ScreenRect(const CellRect& r) { return RECT{ScreenX(r.x), ScreenY(r.y), ScreenX(r.x + r.w), ScreenY(r.y + r.h)}; }
+POINT BoardToWorld(POINT pt) { return POINT{pt.x + g_state.viewX, pt.y + g_state.viewY}; }
 
 int FindTileIndexByEdit(HWND editHwnd) {
-    for (int i = 0; i < static_cast<int>(g_state.tiles.size()); ++i) {
-        if (g_state.tiles[i].edit == editHwnd) return i;
-    }
-    return -1;
+    const int idx = FindTileIndexById(static_cast<uint64_t>(GetWindowLongPtrW(editHwnd, GWLP_USERDATA)));
+    return idx >= 0 && g_state.tiles[idx].edit == editHwnd ? idx : -1;
+}
+
+bool DeleteTile(int idx) {
+    if (idx < 0 || idx >= static_cast<int>(g_state.tiles.size()) || g_state.tiles.size() <= 1) return false;
+
+    if (g_state.tiles[idx].edit) DestroyWindow(g_state.tiles[idx].edit);
+    IndexTileRemoved(g_state.tiles[idx]);
+    g_fitLayouts.erase(g_state.tiles[idx].id);
+    g_state.tiles.erase(g_state.tiles.begin() + idx);
+    CommitLayoutChange();
+    return true;
+}
+
+int AddTile(const CellRect& r) {
+    if (r.w <= 0 || r.h <= 0) return -1;
+    g_state.tiles.push_back(Tile{r.x, r.y, r.w, r.h, L"", nullptr, NewTileId()});
+    IndexTileAdded(g_state.tiles.back());
+    CommitLayoutChange();
+    return static_cast<int>(g_state.tiles.size()) - 1;
+}
+
+// Aggiunta nei buchi lasciati dalle eliminazioni: cellPt (celle del mondo) e' il punto
+// del click, x < 0 se il menu non e' stato aperto su uno spazio vuoto. Lo spazio libero
+// si cerca nella parte di mondo visibile.
+constexpr int kNewTileCells = 2;
+
+// regione libera per i comandi 10/11/12, in celle del mondo
+bool FindFreeRegion(int cmd, POINT cellPt, CellRect& r) {
+    EnsureFreeSpaceIndex();
+    bool found = false;
+    if (cmd == 10) found = cellPt.x >= 0 && g_freeSpace.EmptyRegionAt(cellPt.x - g_freeSpaceOrigin.x, cellPt.y - g_freeSpaceOrigin.y, r);
+    if (cmd == 11) found = g_freeSpace.LargestEmpty(r);
+    if (cmd == 12) found = g_freeSpace.FirstEmpty(kNewTileCells, kNewTileCells, r);
+    if (!found) return false;
+    r.x += g_freeSpaceOrigin.x;
+    r.y += g_freeSpaceOrigin.y;
+    return true;
+}
+
+void AppendAddTileItems(HMENU menu, POINT cellPt) {
+    CellRect r;
+    UINT here = FindFreeRegion(10, cellPt, r) ? MF_STRING : MF_STRING | MF_GRAYED;
+    AppendMenuW(menu, here, 10, L"Aggiungi tile qui");
+    UINT largest = FindFreeRegion(11, cellPt, r) ? MF_STRING : MF_STRING | MF_GRAYED;
+    AppendMenuW(menu, largest, 11, L"Aggiungi tile nello spazio libero piu' grande");
+    UINT first = FindFreeRegion(12, cellPt, r) ? MF_STRING : MF_STRING | MF_GRAYED;
+    AppendMenuW(menu, first, 12, L"Aggiungi tile 2x2 nel primo spazio libero");
+}
+
+bool RunAddTileCommand(int cmd, POINT cellPt) {
+    CellRect r;
+    if (cmd >= 10 && cmd <= 12 && FindFreeRegion(cmd, cellPt, r)) return AddTile(r) >= 0;
+    return false;
+}
+
+void ShowBoardContextMenu(HWND owner, POINT cellPt, POINT screenPt) {
+    HMENU menu = CreatePopupMenu();
+    AppendAddTileItems(menu, cellPt);
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    AppendMenuW(menu, MF_STRING, 20, L"Cronologia...");
+    AppendMenuW(menu, MF_STRING | (g_memOverlay ? MF_CHECKED : MF_UNCHECKED), 21, L"Memoria e handle");
+    AppendMenuW(menu, MF_STRING | (g_state.spellCheck ? MF_CHECKED : MF_UNCHECKED), 22, L"Controllo ortografico");
+    AppendMenuW(menu, MF_STRING, 23, L"Cerca...\tCtrl+F");
+
+    int cmd = TrackPopupMenu(menu, TPM_RETURNCMD | TPM_RIGHTBUTTON, screenPt.x, screenPt.y, 0, owner, nullptr);
+    DestroyMenu(menu);
+    RunAddTileCommand(cmd, cellPt);
+    if (cmd == 20) ShowHistoryWindow();
+    if (cmd == 21) SetMemOverlay(!g_memOverlay);
+    if (cmd == 22) SetSpellCheck(!g_state.spellCheck);
+    if (cmd == 23) ShowSearchWindow();
 }
 
 void ShowTileContextMenu(HWND owner, int idx, POINT screenPt) {
@@ -452,6 +1313,43 @@ void ShowTileContextMenu(HWND owner, int idx, POINT screenPt) {
     AppendMenuW(menu, MF_STRING, 3, L"Split in 4 +");
     AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
     AppendMenuW(menu, MF_STRING, 4, L"Elimina tile");
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    AppendMenuW(menu, MF_STRING | (g_state.tiles[idx].autoFit ? MF_CHECKED : MF_UNCHECKED), 5, L"Riduci il testo per farlo stare");
+    AppendMenuW(menu, MF_STRING | (g_state.tiles[idx].scroll ? MF_CHECKED : MF_UNCHECKED), 9, L"Nota lunga (scorre)");
+    const bool customTracks = !g_state.columns.Overrides().empty() || !g_state.rows.Overrides().empty();
+    AppendMenuW(menu, customTracks ? MF_STRING : MF_STRING | MF_GRAYED, 6, L"Righe e colonne tutte uguali");
+    if (g_state.tiles[idx].tailPath.empty()) AppendMenuW(menu, MF_STRING, 7, L"Segui un file...");
+    else AppendMenuW(menu, MF_STRING, 8, L"Smetti di seguire il file");
+    HMENU remind = CreatePopupMenu();
+    const int64_t remindAt = g_state.tiles[idx].remindAt;
+    if (remindAt) {
+        AppendMenuW(remind, MF_STRING | MF_GRAYED, 0, (L"Scade " + SnapshotLabel(remindAt / 1000)).c_str());
+        AppendMenuW(remind, MF_SEPARATOR, 0, nullptr);
+    }
+    AppendMenuW(remind, MF_STRING, 30, L"Tra 10 minuti");
+    AppendMenuW(remind, MF_STRING, 31, L"Tra un'ora");
+    AppendMenuW(remind, MF_STRING, 32, L"Domani alle 9");
+    AppendMenuW(remind, remindAt ? MF_STRING : MF_STRING | MF_GRAYED, 33, L"Togli il promemoria");
+    AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(remind), L"Promemoria");
+    HMENU attach = CreatePopupMenu();
+    const std::vector<Attachment>& files = g_state.tiles[idx].files;
+    const bool canPaste = IsClipboardFormatAvailable(CF_DIB) || IsClipboardFormatAvailable(CF_HDROP);
+    AppendMenuW(attach, MF_STRING, 40, L"Allega file...");
+    AppendMenuW(attach, canPaste ? MF_STRING : MF_STRING | MF_GRAYED, 41, L"Incolla immagine o file");
+    if (!files.empty()) AppendMenuW(attach, MF_SEPARATOR, 0, nullptr);
+    std::vector<std::wstring> names; // & nel nome sarebbe un tasto di scelta rapida
+    for (size_t i = 0; i < files.size() && i < 100; ++i) {
+        names.emplace_back();
+        for (wchar_t c : Utf8ToWide(files[i].name)) names.back() += c == L'&' ? std::wstring(L"&&") : std::wstring(1, c);
+    }
+    for (size_t i = 0; i < names.size(); ++i) AppendMenuW(attach, MF_STRING, 100 + i, (L"Apri " + names[i]).c_str());
+    if (!names.empty()) AppendMenuW(attach, MF_SEPARATOR, 0, nullptr);
+    for (size_t i = 0; i < names.size(); ++i) AppendMenuW(attach, MF_STRING, 200 + i, (L"Togli " + names[i]).c_str());
+    AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(attach), files.empty() ? L"Allegati" : (L"Allegati (" + std::to_wstring(files.size()) + L")").c_str());
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    AppendAddTileItems(menu, POINT{-1, -1});
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    AppendMenuW(menu, MF_STRING, 20, L"Cronologia...");
 
     int cmd = TrackPopupMenu(menu, TPM_RETURNCMD | TPM_RIGHTBUTTON, screenPt.x, screenPt.y, 0, owner, nullptr);
     DestroyMenu(menu);
@@ -459,12 +1357,19 @@ void ShowTileContextMenu(HWND owner, int idx, POINT screenPt) {
     if (cmd == 1) Split2(idx, false);
     if (cmd == 2) Split2(idx, true);
     if (cmd == 3) Split4(idx);
-    if (cmd == 4 && g_state.tiles.size() > 1) {
-        if (g_state.tiles[idx].edit) DestroyWindow(g_state.tiles[idx].edit);
-        g_state.tiles.erase(g_state.tiles.begin() + idx);
-        LayoutTiles();
-        SaveState();
-    }
+    if (cmd == 4) DeleteTile(idx);
+    if (cmd == 5) SetTileAutoFit(idx, !g_state.tiles[idx].autoFit);
+    if (cmd == 9) SetTileScroll(idx, !g_state.tiles[idx].scroll);
+    if (cmd == 6) ResetTracks();
+    if (cmd == 7) FollowFileInTile(idx);
+    if (cmd == 8) StopFollowingFile(idx);
+    if (cmd >= 30 && cmd <= 33) SetTileReminder(idx, ReminderPreset(cmd - 30));
+    if (cmd == 40) AttachFileDialog(idx);
+    if (cmd == 41) AttachFromClipboard(g_state.tiles[idx].id);
+    if (cmd >= 100 && cmd < 200 && static_cast<size_t>(cmd - 100) < g_state.tiles[idx].files.size()) OpenAttachment(g_state.tiles[idx].files[cmd - 100]);
+    if (cmd >= 200 && cmd < 300) RemoveAttachment(idx, static_cast<size_t>(cmd - 200));
+    if (cmd == 20) ShowHistoryWindow();
+    RunAddTileCommand(cmd, POINT{-1, -1});
 }
 /*
 LRESULT CALLBACK EditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -483,59 +1388,369 @@ LRESULT CALLBACK EditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
     return CallWindowProcW(g_defaultEditProc, hwnd, msg, wParam, lParam);
 }*/
-static bool IsWordChar(wchar_t c) {
-    return std::iswalnum((wint_t)c) || c == L'_';
+// Buffer interno della EDIT multilinea letto sul posto (niente GetWindowTextW a ogni tasto).
+// Va rilasciato prima di modificare il testo: il controllo puo' riallocarlo.
+// Se EM_GETHANDLE o LocalLock falliscono si ripiega su una copia con GetWindowTextW:
+// una vista vuota farebbe cancellare a Ctrl+Backspace tutto il testo prima del cursore.
+class EditTextLock {
+public:
+    explicit EditTextLock(HWND hEdit)
+        : handle_(reinterpret_cast<HLOCAL>(SendMessageW(hEdit, EM_GETHANDLE, 0, 0))) {
+        const int length = std::max(0, GetWindowTextLengthW(hEdit));
+        if (handle_) data_ = static_cast<const wchar_t*>(LocalLock(handle_));
+        if (data_) {
+            locked_ = true;
+            size_ = static_cast<size_t>(length);
+            return;
+        }
+        copy_.resize(static_cast<size_t>(length) + 1);
+        copy_.resize(static_cast<size_t>(std::max(0, GetWindowTextW(hEdit, copy_.data(), length + 1))));
+        data_ = copy_.c_str();
+        size_ = copy_.size();
+    }
+    ~EditTextLock() { Unlock(); }
+    EditTextLock(const EditTextLock&) = delete;
+    EditTextLock& operator=(const EditTextLock&) = delete;
+
+    void Unlock() {
+        if (locked_) LocalUnlock(handle_);
+        locked_ = false;
+        data_ = nullptr;
+        size_ = 0;
+    }
+    // su Windows wchar_t e' UTF-16
+    Utf16View View() const { return Utf16View{reinterpret_cast<const char16_t*>(data_), size_}; }
+    // la posizione (di EM_GETSEL) cade nel testo letto? Se no meglio non toccare nulla
+    bool Covers(size_t pos) const { return data_ && pos <= size_; }
+
+private:
+    HLOCAL handle_{nullptr};
+    bool locked_{false};
+    std::wstring copy_;
+    const wchar_t* data_{nullptr};
+    size_t size_{0};
+};
+
+// forma a puntatori di EM_GETSEL: LOWORD/HIWORD si fermano a 65535 caratteri
+static void GetEditSel(HWND hEdit, DWORD& start, DWORD& end)
+{
+    start = end = 0;
+    SendMessageW(hEdit, EM_GETSEL, reinterpret_cast<WPARAM>(&start), reinterpret_cast<LPARAM>(&end));
 }
-static void DoCtrlBackspace(HWND hEdit)
+
+static void DeleteEditRange(HWND hEdit, size_t from, size_t to)
 {
-    DWORD sel = (DWORD)SendMessageW(hEdit, EM_GETSEL, 0, 0);
-    int start = LOWORD(sel);
-    int end   = HIWORD(sel);
+    if (from == to) return;
+    SendMessageW(hEdit, WM_SETREDRAW, FALSE, 0);
+    SendMessageW(hEdit, EM_SETSEL, from, to);
+    SendMessageW(hEdit, EM_REPLACESEL, TRUE, (LPARAM)L"");
+    SendMessageW(hEdit, WM_SETREDRAW, TRUE, 0);
+    //InvalidateRect(hEdit, nullptr, TRUE); //riga suggerita ma disattivata perchè non ritengo attualmente necessaria
+}
+
+static void DoCtrlBackspace(HWND hEdit)
+{
+    DWORD start = 0, end = 0;
+    GetEditSel(hEdit, start, end);
 
     // Se c'è selezione, Backspace cancella la selezione
     if (start != end) {
         SendMessageW(hEdit, EM_REPLACESEL, TRUE, (LPARAM)L"");
         return;
     }
+    if (start == 0) return;
+
+    // spazi a sinistra, poi la parola oppure il blocco di simboli fino allo spazio precedente
+    EditTextLock text(hEdit);
+    if (!text.Covers(start)) return;
+    const size_t from = WordDeleteLeft(text.View(), start);
+    text.Unlock();
 
-    if (start <= 0) return;
+    // Cancella [from, start)
+    DeleteEditRange(hEdit, from, start);
+}
 
-    const int len = GetWindowTextLengthW(hEdit);
-    if (len <= 0) return;
+static void DoCtrlDelete(HWND hEdit)
+{
+    DWORD start = 0, end = 0;
+    GetEditSel(hEdit, start, end);
+    if (start != end) {
+        SendMessageW(hEdit, EM_REPLACESEL, TRUE, (LPARAM)L"");
+        return;
+    }
 
-   // std::wstring text;
-    //text.resize(len);
-    //old?
-    std::wstring text(len, L'\0');
-    GetWindowTextW(hEdit, text.data(), len + 1);
+    EditTextLock text(hEdit);
+    if (!text.Covers(start)) return;
+    const size_t to = WordDeleteRight(text.View(), start);
+    text.Unlock();
 
-    int i = start;
+    DeleteEditRange(hEdit, start, to);
+}
 
-    // 1) Salta gli spazi a SINISTRA del cursore
-    while (i > 0 && std::iswspace((wint_t)text[i - 1])) i--;
+// Ctrl+Left / Ctrl+Right (con Shift estende la selezione) con i confini di textseg
+static void DoCtrlArrow(HWND hEdit, bool right, bool extend)
+{
+    DWORD start = 0, end = 0;
+    GetEditSel(hEdit, start, end);
 
-    // 2) Cancella la "parola" (alfanumerico/underscore) oppure blocco di simboli
-    if (i > 0) {
-        if (IsWordChar(text[i - 1])) {
-            while (i > 0 && IsWordChar(text[i - 1])) i--;
-        } else {
-            // punteggiatura/simboli: elimina fino allo spazio precedente
-            while (i > 0 && !std::iswspace((wint_t)text[i - 1])) i--;
+    // la EDIT non dice quale estremo e' il cursore: lo si ricava dalla posizione del caret
+    DWORD anchor = start, active = end;
+    if (start != end) {
+        POINT caret{};
+        GetCaretPos(&caret);
+        const LRESULT startPos = SendMessageW(hEdit, EM_POSFROMCHAR, start, 0);
+        if (caret.x == GET_X_LPARAM(startPos) && caret.y == GET_Y_LPARAM(startPos)) {
+            anchor = end;
+            active = start;
         }
     }
 
-    // 3) (facoltativo ma tipico) cancella anche gli spazi subito PRIMA della parola
-    
-    //while (i > 0 && std::iswspace((wint_t)text[i - 1])) i--;
+    EditTextLock text(hEdit);
+    if (!text.Covers(active)) return;
+    const size_t next = right ? WordRight(text.View(), active) : WordLeft(text.View(), active);
+    text.Unlock();
 
-    // Cancella [i, start)
-        SendMessageW(hEdit, WM_SETREDRAW, FALSE, 0);
-    SendMessageW(hEdit, EM_SETSEL, i, start);
-    SendMessageW(hEdit, EM_REPLACESEL, TRUE, (LPARAM)L"");
-        SendMessageW(hEdit, WM_SETREDRAW, TRUE, 0);
-        //InvalidateRect(hEdit, nullptr, TRUE); //riga suggerita ma disattivata perchè non ritengo attualmente necessaria
+    SendMessageW(hEdit, EM_SETSEL, extend ? anchor : next, next);
+    SendMessageW(hEdit, EM_SCROLLCARET, 0, 0);
+}
+
+// Doppio click: seleziona il segmento (parola, spazi o simboli) sotto il cursore
+static void SelectWordAtClick(HWND hEdit, LPARAM lParam)
+{
+    // EM_CHARFROMPOS restituisce solo 16 bit dell'indice: si ricostruiscono
+    // partendo dal cursore che il click appena gestito ha messo li' vicino
+    DWORD start = 0, end = 0;
+    GetEditSel(hEdit, start, end);
+    const DWORD lo = LOWORD(SendMessageW(hEdit, EM_CHARFROMPOS, 0, lParam));
+    const DWORD delta = (lo - (start & 0xFFFF)) & 0xFFFF;
+    size_t idx = delta < 0x8000 ? start + delta : start - (0x10000 - delta);
+
+    EditTextLock text(hEdit);
+    const Utf16View view = text.View();
+    if (view.size == 0) return;
+    idx = std::min(idx, view.size - 1);
+    WordSegment seg = WordSegmentAt(view, idx);
+    // click oltre la fine riga: si prende quel che la precede, non l'a capo
+    if (seg.kind == WordSegment::Kind::Newline && seg.begin > 0) seg = WordSegmentAt(view, seg.begin - 1);
+    text.Unlock();
+
+    SendMessageW(hEdit, EM_SETSEL, seg.begin, seg.end);
+}
+// Ctrl+Alt+freccia: tile piu' vicina in quella direzione. Ctrl+Tab / Ctrl+Shift+Tab: ordine di lettura.
+// Le risposte vengono da g_adjacency, aggiornato insieme al layout. Ctrl+F: ricerca su tutte le note.
+static bool HandleNavigationKey(HWND hEdit, WPARAM key)
+{
+    if (!(GetKeyState(VK_CONTROL) & 0x8000)) return false;
+    const bool alt = GetKeyState(VK_MENU) & 0x8000;
+    if (key == 'F' && !alt) {
+        ShowSearchWindow();
+        return true;
+    }
+
+    const int idx = FindTileIndexByEdit(hEdit);
+    if (idx < 0) return false;
+    const Tile& t = g_state.tiles[idx];
+
+    uint64_t target = 0;
+    if (key == VK_TAB && !alt) {
+        target = g_adjacency.NextInReadingOrder(t.id, (GetKeyState(VK_SHIFT) & 0x8000) != 0);
+    } else if (alt) {
+        switch (key) {
+            case VK_LEFT: target = g_adjacency.Nearest(t.id, TileSide::Left, t.y + t.h / 2); break;
+            case VK_RIGHT: target = g_adjacency.Nearest(t.id, TileSide::Right, t.y + t.h / 2); break;
+            case VK_UP: target = g_adjacency.Nearest(t.id, TileSide::Top, t.x + t.w / 2); break;
+            case VK_DOWN: target = g_adjacency.Nearest(t.id, TileSide::Bottom, t.x + t.w / 2); break;
+            default: return false;
+        }
+    } else {
+        return false;
+    }
+
+    const int next = FindTileIndexById(target);
+    if (next >= 0) RevealTile(next); // fuori viewport non ha ancora una EDIT
+    if (next >= 0 && g_state.tiles[next].edit) SetFocus(g_state.tiles[next].edit);
+    return true; // consumato anche senza destinazione: niente caratteri/spostamenti nella EDIT
+}
+
+// Menu della tile dalla sua finestra di testo (EDIT o vista che scorre)
+static void ShowTileMenuFromEdit(HWND hEdit, LPARAM lParam)
+{
+    const int idx = FindTileIndexByEdit(hEdit);
+
+    POINT screenPt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+
+    // Distinzione corretta: menu da tastiera
+    if (lParam == (LPARAM)-1)
+    {
+        RECT rc{};
+        GetWindowRect(hEdit, &rc);
+        screenPt.x = rc.left + 12;
+        screenPt.y = rc.top + 12;
+    }
+
+    ShowTileContextMenu(g_board ? g_board : hEdit, idx, screenPt);
+}
+
+// Controllo ortografico: il testo della tile, non tail (file di altri) ne' formule
+bool SpellChecksTile(const Tile& t) {
+    return g_state.spellCheck && t.tailPath.empty() && !g_formulas.IsFormula(t.id);
+}
+
+// Errori da disegnare sopra il testo: quelli ancora al loro posto nel testo attuale (il
+// controllo puo' essere indietro di qualche tasto) e non la parola che si sta scrivendo.
+template <typename Fn>
+void ForEachMisspelling(const Tile& t, std::u16string_view text, size_t caret, bool focused, Fn&& fn) {
+    if (!SpellChecksTile(t) || g_formulaShown.count(t.id)) return;
+    const SpellRanges ranges = g_spell.Misspelled(t.id);
+    if (!ranges) return;
+    for (const SpellRange& r : *ranges) {
+        if (r.end > text.size() || text.substr(r.begin, r.end - r.begin) != r.word) continue;
+        if (focused && caret >= r.begin && caret <= r.end) continue;
+        fn(r);
+    }
+}
+
+// sottolineatura ondulata sotto [x0, x1), con il fondo a yBottom
+void PaintSpellSquiggle(HDC hdc, int x0, int x1, int yBottom) {
+    if (x1 <= x0) return;
+    std::vector<POINT> pts;
+    for (int x = x0, i = 0; x <= x1; x += 2, ++i) pts.push_back(POINT{x, yBottom - ((i & 1) ? 2 : 0)});
+    HPEN pen = TrackedPen(MemArea::Paint, 1, RGB(230, 70, 70));
+    HGDIOBJ oldPen = SelectObject(hdc, pen);
+    Polyline(hdc, pts.data(), static_cast<int>(pts.size()));
+    SelectObject(hdc, oldPen);
+    FreeGdi(MemArea::Paint, pen);
+}
+
+// Sopra quello che ha disegnato la EDIT: posizioni da EM_POSFROMCHAR, larghezza col font
+// della EDIT (una parola non va a capo, salvo quelle piu' larghe della tile)
+void PaintEditSpelling(HWND hEdit, const Tile& t, HDC hdc) {
+    DWORD selStart = 0, selEnd = 0;
+    SendMessageW(hEdit, EM_GETSEL, reinterpret_cast<WPARAM>(&selStart), reinterpret_cast<LPARAM>(&selEnd));
+    HGDIOBJ oldFont = SelectObject(hdc, reinterpret_cast<HFONT>(SendMessageW(hEdit, WM_GETFONT, 0, 0)));
+    TEXTMETRICW tm{};
+    GetTextMetricsW(hdc, &tm);
+    ForEachMisspelling(t, AsUtf16(t.text), selEnd, GetFocus() == hEdit, [&](const SpellRange& r) {
+        const LRESULT pos = SendMessageW(hEdit, EM_POSFROMCHAR, static_cast<WPARAM>(r.begin), 0);
+        if (pos == -1) return;
+        SIZE size{};
+        GetTextExtentPoint32W(hdc, reinterpret_cast<LPCWSTR>(r.word.data()), static_cast<int>(r.word.size()), &size);
+        const int x = static_cast<short>(LOWORD(pos));
+        const int y = static_cast<short>(HIWORD(pos));
+        PaintSpellSquiggle(hdc, x, x + size.cx, y + tm.tmHeight - 1);
+    });
+    SelectObject(hdc, oldFont);
+}
+
+// Una tile senza focus con del Markdown si legge formattata; col focus torna la EDIT
+// normale. Tail e formule mostrano gia' altro. Update costa i blocchi cambiati.
+bool ShowsMarkdown(const Tile& t) {
+    // la vista che scorre disegna da se': il Markdown partirebbe dall'inizio della nota
+    if (!t.edit || t.scroll || !t.tailPath.empty() || g_formulaShown.count(t.id) || GetFocus() == t.edit) return false;
+    MarkdownDoc& doc = g_markdown[t.id];
+    doc.Update(t.text);
+    return doc.HasMarkup();
+}
+
+// Sfondo della tile: acceso a fasi alterne mentre il suo promemoria suona
+HBRUSH TileBackBrush(HWND edit) {
+    if (!g_ringPhase || g_ringing.empty()) return g_editBgBrush;
+    const int idx = FindTileIndexByEdit(edit);
+    if (idx < 0 || !g_ringing.count(g_state.tiles[idx].id)) return g_editBgBrush;
+    if (!g_ringBrush) g_ringBrush = TrackedBrush(MemArea::Brushes, kRingColor);
+    return g_ringBrush;
+}
+
+// Disegna al posto della EDIT solo i blocchi che entrano nella tile (dall'inizio della nota)
+void PaintMarkdown(const Tile& t, HDC hdc) {
+    MarkdownDoc& doc = g_markdown[t.id];
+    RECT client{};
+    GetClientRect(t.edit, &client);
+    RECT area = client;
+    SendMessageW(t.edit, EM_GETRECT, 0, reinterpret_cast<LPARAM>(&area)); // margini della EDIT
+    FillRect(hdc, &client, TileBackBrush(t.edit));
 
+    LOGFONT lf{};
+    GetObject(reinterpret_cast<HFONT>(SendMessageW(t.edit, WM_GETFONT, 0, 0)), sizeof(lf), &lf);
+    const int px = std::max(1, static_cast<int>(lf.lfHeight < 0 ? -lf.lfHeight : lf.lfHeight));
+
+    HGDIOBJ oldFont = SelectObject(hdc, MarkdownFont(px, 0));
+    uint8_t selected = 0;
+    auto select = [&](uint8_t style) {
+        if (style == selected) return;
+        SelectObject(hdc, MarkdownFont(px, style));
+        selected = style;
+    };
+    int heights[256] = {};
+    MdMetrics m;
+    m.version = px; // il resto del font non cambia
+    m.width = [&](std::wstring_view s, uint8_t style) {
+        select(static_cast<uint8_t>(style & ~kMdBreak));
+        SIZE size{};
+        GetTextExtentPoint32W(hdc, s.data(), static_cast<int>(s.size()), &size);
+        return static_cast<int>(size.cx);
+    };
+    m.lineHeight = [&](uint8_t style) {
+        int& h = heights[style & ~kMdBreak];
+        if (h == 0) {
+            select(static_cast<uint8_t>(style & ~kMdBreak));
+            TEXTMETRICW tm{};
+            GetTextMetricsW(hdc, &tm);
+            h = std::max(1, static_cast<int>(tm.tmHeight));
+        }
+        return h;
+    };
+
+    const COLORREF textColor = RGB(235, 235, 235);
+    const COLORREF dimColor = RGB(110, 110, 110);
+    SetBkMode(hdc, TRANSPARENT);
+    HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(DC_BRUSH));
+    auto fill = [&](const RECT& r, COLORREF color) {
+        SetDCBrushColor(hdc, color);
+        FillRect(hdc, &r, static_cast<HBRUSH>(GetStockObject(DC_BRUSH)));
+    };
+
+    const std::wstring& text = doc.Text();
+    const int width = std::max(1, static_cast<int>(area.right - area.left));
+    int y = area.top;
+    for (size_t i = 0; i < doc.BlockCount() && y < client.bottom; ++i) {
+        const MdBlock& b = doc.Layout(i, width, m);
+        for (const MdFragment& f : b.fragments) {
+            const RECT r{area.left + f.x, y + f.y, area.left + f.x + f.w, y + f.y + f.h};
+            const int side = std::max(4, f.h / 2);
+            const RECT box{r.left + (f.w - side) / 2, r.top + (f.h - side) / 2, r.left + (f.w + side) / 2, r.top + (f.h + side) / 2};
+            switch (f.kind) {
+            case MdFragment::Kind::Text:
+                select(f.style);
+                SetTextColor(hdc, (f.style & kMdLink) ? RGB(120, 170, 255) : (f.style & kMdCode) ? RGB(215, 200, 150) : textColor);
+                TextOutW(hdc, r.left, r.top, text.data() + b.begin + f.begin, static_cast<int>(f.length));
+                break;
+            case MdFragment::Kind::Bullet: {
+                const int d = std::max(2, f.h / 6);
+                fill(RECT{box.left + side / 2 - d, box.top + side / 2 - d, box.left + side / 2 + d, box.top + side / 2 + d}, textColor);
+                break;
+            }
+            case MdFragment::Kind::Box:
+            case MdFragment::Kind::CheckedBox:
+                fill(box, textColor);
+                fill(RECT{box.left + 1, box.top + 1, box.right - 1, box.bottom - 1}, RGB(TILE_COLOR, TILE_COLOR, TILE_COLOR));
+                if (f.kind == MdFragment::Kind::CheckedBox) fill(RECT{box.left + 3, box.top + 3, box.right - 3, box.bottom - 3}, textColor);
+                break;
+            case MdFragment::Kind::Rule:
+            case MdFragment::Kind::QuoteBar:
+                fill(r, dimColor);
+                break;
+            case MdFragment::Kind::CodeBack:
+                fill(r, RGB(TILE_COLOR + 14, TILE_COLOR + 14, TILE_COLOR + 14));
+                break;
+            }
+        }
+        y += b.height;
+    }
+    SelectObject(hdc, oldBrush);
+    SelectObject(hdc, oldFont);
 }
+
 LRESULT CALLBACK EditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     switch (msg)
@@ -544,39 +1759,101 @@ LRESULT CALLBACK EditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
  // Sopprimi il carattere generato da Ctrl+Backspace / Ctrl+Delete
     if (GetKeyState(VK_CONTROL) & 0x8000)
     {
-        // 0x7F = DEL (il tuo ""), 0x08 = BS (backspace)
-        if (wParam == 0x7F || wParam == 0x08)
+        // 0x7F = DEL (il tuo ""), 0x08 = BS (backspace), '\t' = Ctrl+Tab (navigazione)
+        if (wParam == 0x7F || wParam == 0x08 || wParam == L'\t')
             return 0;
     }
     break;
         }
    
-    case WM_KEYDOWN:
-        if (wParam == VK_BACK && (GetKeyState(VK_CONTROL) & 0x8000))
+    case WM_LBUTTONDOWN:
+        // in modalita' layout si trascina la tile intera: il click passa alla board
+        if (g_state.editLayout && g_board)
         {
-            DoCtrlBackspace(hwnd);
-            return 0; // consumato
+            POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+            MapWindowPoints(hwnd, g_board, &pt, 1);
+            SendMessageW(g_board, WM_LBUTTONDOWN, wParam, MAKELPARAM(pt.x, pt.y));
+            return 0;
         }
         break;
 
-    case WM_CONTEXTMENU:
-    {
-        int idx = FindTileIndexByEdit(hwnd);
+    case WM_MBUTTONDOWN: // pan della board anche partendo da sopra una tile
+        if (g_board)
+        {
+            POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+            MapWindowPoints(hwnd, g_board, &pt, 1);
+            SendMessageW(g_board, WM_MBUTTONDOWN, wParam, MAKELPARAM(pt.x, pt.y));
+            return 0;
+        }
+        break;
+
+    case WM_PAINT:
+    case WM_PRINTCLIENT: { // WM_PRINTCLIENT: istantanee per lo zoom (PrintWindow)
+        const int idx = FindTileIndexByEdit(hwnd);
+        if (idx >= 0 && !ShowsMarkdown(g_state.tiles[idx]) && SpellChecksTile(g_state.tiles[idx])) {
+            // la EDIT disegna il testo, poi le sottolineature sopra
+            const LRESULT r = CallWindowProcW(g_defaultEditProc, hwnd, msg, wParam, lParam);
+            HDC hdc = msg == WM_PRINTCLIENT ? reinterpret_cast<HDC>(wParam) : GetDC(hwnd);
+            PaintEditSpelling(hwnd, g_state.tiles[idx], hdc);
+            if (msg == WM_PAINT) ReleaseDC(hwnd, hdc);
+            return r;
+        }
+        if (idx < 0 || !ShowsMarkdown(g_state.tiles[idx])) break;
+        if (msg == WM_PRINTCLIENT) {
+            PaintMarkdown(g_state.tiles[idx], reinterpret_cast<HDC>(wParam));
+            return 0;
+        }
+        PAINTSTRUCT ps{};
+        HDC hdc = BeginPaint(hwnd, &ps);
+        PaintMarkdown(g_state.tiles[idx], hdc);
+        EndPaint(hwnd, &ps);
+        return 0;
+    }
+
+    case WM_NCDESTROY:
+        MemHandle(MemArea::Edits, -1);
+        break;
+
+    case WM_PASTE: { // un'immagine o dei file negli appunti diventano allegati della tile
+        const int idx = FindTileIndexByEdit(hwnd);
+        if (idx >= 0 && !(GetWindowLongPtrW(hwnd, GWL_STYLE) & ES_READONLY) && AttachFromClipboard(g_state.tiles[idx].id)) return 0;
+        break;
+    }
+
+    case WM_MOUSEWHEEL: // il testo sta sempre nella tile: la rotella muove la board
+    case WM_MOUSEHWHEEL:
+        if (g_board) return SendMessageW(g_board, msg, wParam, lParam); // coordinate gia' di schermo
+        break;
 
-        POINT screenPt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+    case WM_SYSKEYDOWN: // con Alt premuto i tasti arrivano come WM_SYSKEYDOWN
+        if (HandleNavigationKey(hwnd, wParam)) return 0;
+        break;
 
-        // Distinzione corretta: menu da tastiera
-        if (lParam == (LPARAM)-1)
+    case WM_KEYDOWN:
+        if (HandleNavigationKey(hwnd, wParam)) return 0;
+        if (GetKeyState(VK_CONTROL) & 0x8000)
         {
-            RECT rc{};
-            GetWindowRect(hwnd, &rc);
-            screenPt.x = rc.left + 12;
-            screenPt.y = rc.top + 12;
+            const bool shift = (GetKeyState(VK_SHIFT) & 0x8000) != 0;
+            switch (wParam)
+            {
+                case VK_BACK: DoCtrlBackspace(hwnd); return 0; // consumato
+                case VK_DELETE: DoCtrlDelete(hwnd); return 0;
+                case VK_LEFT: DoCtrlArrow(hwnd, false, shift); return 0;
+                case VK_RIGHT: DoCtrlArrow(hwnd, true, shift); return 0;
+            }
         }
+        break;
 
-        ShowTileContextMenu(g_board ? g_board : hwnd, idx, screenPt);
+    case WM_LBUTTONDBLCLK:
+        if (g_state.editLayout) break;
+        // il click normale posiziona il cursore, poi si allarga al segmento
+        CallWindowProcW(g_defaultEditProc, hwnd, msg, wParam, lParam);
+        SelectWordAtClick(hwnd, lParam);
+        return 0;
+
+    case WM_CONTEXTMENU:
+        ShowTileMenuFromEdit(hwnd, lParam);
         return 0; // consumato
-    }
 
     }
     
@@ -585,21 +1862,510 @@ LRESULT CALLBACK EditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return CallWindowProcW(g_defaultEditProc, hwnd, msg, wParam, lParam);
 }
 
-bool TextFitsInEdit(HWND edit, const std::wstring& text) {
+// Tile "scroll": al posto della EDIT una finestra che tiene il testo in un TextView
+// (textview.h) e disegna solo le righe in vista, cosi' una nota di megabyte si apre,
+// scorre e si scrive senza che la EDIT rifaccia gli a capo di tutto a ogni tasto.
+// Risponde ai messaggi della EDIT che il resto del programma usa (testo, selezione,
+// font, sola lettura, EM_GETRECT) e manda al padre le stesse EN_*: t.edit resta la
+// finestra della tile per layout, istantanee, tail, formule e IPC.
+struct ScrollEdit {
+    TextView view;
+    HFONT font{};
+    int fontVersion{0};
+    bool readOnly{false};
+    bool selecting{false}; // trascinamento col tasto sinistro
+    int wheelRest{0};      // frazioni di scatto della rotella (rotelle ad alta risoluzione)
+};
+
+constexpr int kScrollEditMargin = 2; // come i margini della EDIT
+
+LRESULT CALLBACK ScrollEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+// nullptr se hwnd e' una EDIT normale
+ScrollEdit* GetScrollEdit(HWND hwnd) {
+    if (!hwnd || GetWindowLongPtrW(hwnd, GWLP_WNDPROC) != reinterpret_cast<LONG_PTR>(ScrollEditProc)) return nullptr;
+    return reinterpret_cast<ScrollEdit*>(GetWindowLongPtrW(hwnd, 0));
+}
+
+void NotifyEditParent(HWND hwnd, WORD code) {
+    SendMessageW(GetParent(hwnd), WM_COMMAND, MAKEWPARAM(GetDlgCtrlID(hwnd), code), reinterpret_cast<LPARAM>(hwnd));
+}
+
+RECT ScrollEditTextRect(HWND hwnd) {
+    RECT r{};
+    GetClientRect(hwnd, &r);
+    r.left += kScrollEditMargin;
+    r.right = std::max(r.left + 1, r.right - kScrollEditMargin);
+    return r;
+}
+
+// Font e dimensioni -> metriche del modello. Misura con GetTextExtentExPointW sul DC
+// condiviso: gli a capo sono quelli di ExtTextOutW che poi disegna.
+void UpdateScrollEditLayout(HWND hwnd, ScrollEdit& se) {
+    if (!g_measureDc) g_measureDc = TrackedMemDc(MemArea::Fonts, nullptr);
+    const HFONT font = se.font ? se.font : g_bigFont;
+    TextViewMetrics m;
+    m.version = se.fontVersion;
+    if (g_measureDc) {
+        HGDIOBJ oldFont = SelectObject(g_measureDc, font);
+        TEXTMETRICW tm{};
+        GetTextMetricsW(g_measureDc, &tm);
+        SelectObject(g_measureDc, oldFont);
+        m.lineHeight = std::max(1, static_cast<int>(tm.tmHeight));
+        m.charWidth = std::max(1, static_cast<int>(tm.tmAveCharWidth));
+        m.extents = [font](std::u16string_view text, std::vector<int>& ends) {
+            ends.assign(text.size(), 0);
+            if (!g_measureDc || text.empty()) return;
+            HGDIOBJ old = SelectObject(g_measureDc, font);
+            SIZE size{};
+            GetTextExtentExPointW(g_measureDc, reinterpret_cast<LPCWSTR>(text.data()), static_cast<int>(text.size()), 0, nullptr, ends.data(), &size);
+            SelectObject(g_measureDc, old);
+        };
+    }
+    se.view.SetMetrics(m);
+    const RECT r = ScrollEditTextRect(hwnd);
+    se.view.SetViewport(r.right - r.left, r.bottom - r.top);
+}
+
+// Dopo ogni cambiamento: barra (sempre presente, cosi' la larghezza non cambia e gli a
+// capo restano quelli), cursore e ridisegno
+void RefreshScrollEdit(HWND hwnd, ScrollEdit& se) {
+    SCROLLINFO si{};
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS | SIF_DISABLENOSCROLL;
+    si.nMax = static_cast<int>(std::max<size_t>(1, se.view.TotalRows()) - 1);
+    si.nPage = static_cast<UINT>(se.view.PageRows());
+    si.nPos = static_cast<int>(se.view.TopRow());
+    SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
+    if (GetFocus() == hwnd) {
+        const RECT r = ScrollEditTextRect(hwnd);
+        int x = 0, y = 0;
+        if (se.view.PointOf(se.view.Caret(), se.view.CaretAtRowEnd(), x, y)) SetCaretPos(r.left + x, r.top + y);
+        else SetCaretPos(-100, -100); // scorrendo il cursore puo' restare fuori vista
+    }
+    InvalidateRect(hwnd, nullptr, FALSE);
+}
+
+// Modifica fatta o no: al padre EN_CHANGE come dalla EDIT, poi barra e cursore
+void ScrollEditChanged(HWND hwnd, ScrollEdit& se, bool changed) {
+    if (changed) NotifyEditParent(hwnd, EN_CHANGE);
+    RefreshScrollEdit(hwnd, se);
+}
+
+void PaintScrollEdit(HWND hwnd, ScrollEdit& se, HDC hdc) {
     RECT client{};
-    GetClientRect(edit, &client);
-    const int rawW = static_cast<int>(client.right - client.left);
-    const int rawH = static_cast<int>(client.bottom - client.top);
-    const int clientW = std::max(1, rawW);
-    const int clientH = std::max(1, rawH);
+    GetClientRect(hwnd, &client);
+    // colori dal padre come per la EDIT (promemoria che suona compreso)
+    const HBRUSH back = reinterpret_cast<HBRUSH>(SendMessageW(GetParent(hwnd), WM_CTLCOLOREDIT, reinterpret_cast<WPARAM>(hdc), reinterpret_cast<LPARAM>(hwnd)));
+    FillRect(hdc, &client, back ? back : g_editBgBrush);
+    const COLORREF textColor = GetTextColor(hdc);
+    HGDIOBJ oldFont = SelectObject(hdc, se.font ? se.font : g_bigFont);
+    SetBkMode(hdc, TRANSPARENT);
+
+    const RECT area = ScrollEditTextRect(hwnd);
+    const std::u16string& text = se.view.Text();
+    const size_t selStart = se.view.SelStart();
+    const size_t selEnd = se.view.SelEnd();
+    const bool showSel = GetFocus() == hwnd && selStart != selEnd;
+    const int lh = se.view.LineHeight();
+    const std::vector<TextRow> rows = se.view.VisibleRows();
+    int y = area.top;
+    for (const TextRow& row : rows) {
+        const LPCWSTR s = reinterpret_cast<LPCWSTR>(text.data() + row.begin);
+        const UINT n = static_cast<UINT>(row.end - row.begin);
+        ExtTextOutW(hdc, area.left, y, ETO_CLIPPED, &area, s, n, nullptr);
+        const size_t a = std::max(selStart, row.begin);
+        const size_t b = std::min(selEnd, row.end);
+        // a capo selezionato: un pezzetto oltre la fine della riga, come la EDIT
+        const bool newline = row.last && selStart <= row.end && selEnd > row.end;
+        if (showSel && (a < b || newline)) {
+            RECT sel{area.left + se.view.XOf(row, a), y, area.left + se.view.XOf(row, std::max(a, b)) + (newline ? lh / 3 : 0), y + lh};
+            IntersectRect(&sel, &sel, &area);
+            FillRect(hdc, &sel, GetSysColorBrush(COLOR_HIGHLIGHT));
+            SetTextColor(hdc, GetSysColor(COLOR_HIGHLIGHTTEXT));
+            ExtTextOutW(hdc, area.left, y, ETO_CLIPPED, &sel, s, n, nullptr);
+            SetTextColor(hdc, textColor);
+        }
+        y += lh;
+    }
 
-    HDC hdc = GetDC(edit);
-    if (!hdc) return true;
+    const int idx = FindTileIndexByEdit(hwnd);
+    if (idx >= 0 && !rows.empty()) {
+        ForEachMisspelling(g_state.tiles[idx], text, se.view.Caret(), GetFocus() == hwnd, [&](const SpellRange& r) {
+            if (r.end <= rows.front().begin || r.begin >= rows.back().end) return; // fuori vista
+            int rowY = area.top;
+            for (const TextRow& row : rows) {
+                if (r.begin < row.end && r.end > row.begin) {
+                    const int x0 = se.view.XOf(row, std::max(r.begin, row.begin));
+                    const int x1 = se.view.XOf(row, std::min(r.end, row.end));
+                    PaintSpellSquiggle(hdc, area.left + x0, area.left + x1, rowY + lh - 1);
+                }
+                rowY += lh;
+            }
+        });
+    }
+    SelectObject(hdc, oldFont);
+}
+
+void CopyToClipboard(HWND hwnd, const std::u16string& text) {
+    if (text.empty() || !OpenClipboard(hwnd)) return;
+    EmptyClipboard();
+    HGLOBAL mem = GlobalAlloc(GMEM_MOVEABLE, (text.size() + 1) * sizeof(wchar_t));
+    if (auto* dst = mem ? static_cast<wchar_t*>(GlobalLock(mem)) : nullptr) {
+        std::copy(text.begin(), text.end(), dst);
+        dst[text.size()] = L'\0';
+        GlobalUnlock(mem);
+        if (!SetClipboardData(CF_UNICODETEXT, mem)) GlobalFree(mem);
+    }
+    CloseClipboard();
+}
+
+// testo degli appunti con gli a capo della EDIT (\r\n), qualunque cosa ci sia dentro
+std::u16string ClipboardText(HWND hwnd) {
+    std::u16string out;
+    if (!IsClipboardFormatAvailable(CF_UNICODETEXT) || !OpenClipboard(hwnd)) return out;
+    HANDLE data = GetClipboardData(CF_UNICODETEXT);
+    if (const auto* src = data ? static_cast<const wchar_t*>(GlobalLock(data)) : nullptr) {
+        const size_t n = GlobalSize(data) / sizeof(wchar_t);
+        for (size_t i = 0; i < n && src[i]; ++i) {
+            if (src[i] == L'\r' || src[i] == L'\n') {
+                if (src[i] == L'\r' && i + 1 < n && src[i + 1] == L'\n') ++i;
+                out += u"\r\n";
+            } else {
+                out += static_cast<char16_t>(src[i]);
+            }
+        }
+        GlobalUnlock(data);
+    }
+    CloseClipboard();
+    return out;
+}
+
+void ScrollEditCopy(HWND hwnd, ScrollEdit& se, bool cut) {
+    CopyToClipboard(hwnd, se.view.SelectedText());
+    if (cut && !se.readOnly) ScrollEditChanged(hwnd, se, se.view.Type(u""));
+}
+
+void ScrollEditPaste(HWND hwnd, ScrollEdit& se) {
+    if (se.readOnly || AttachFromClipboard(static_cast<uint64_t>(GetWindowLongPtrW(hwnd, GWLP_USERDATA)))) return;
+    const std::u16string text = ClipboardText(hwnd);
+    if (!text.empty()) ScrollEditChanged(hwnd, se, se.view.Type(text));
+}
+
+// Tasti: movimenti e modifiche sul modello. Come in EditProc passano prima dalla
+// navigazione tra tile; Ctrl+Alt (AltGr) resta ai caratteri.
+bool ScrollEditKey(HWND hwnd, ScrollEdit& se, WPARAM key) {
+    const bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) && !(GetKeyState(VK_MENU) & 0x8000);
+    const bool shift = (GetKeyState(VK_SHIFT) & 0x8000) != 0;
+    TextView& v = se.view;
+    switch (key) {
+    case VK_LEFT: v.Move(ctrl ? CaretMove::WordLeft : CaretMove::Left, shift); break;
+    case VK_RIGHT: v.Move(ctrl ? CaretMove::WordRight : CaretMove::Right, shift); break;
+    case VK_UP: v.Move(CaretMove::Up, shift); break;
+    case VK_DOWN: v.Move(CaretMove::Down, shift); break;
+    case VK_PRIOR: v.Move(CaretMove::PageUp, shift); break;
+    case VK_NEXT: v.Move(CaretMove::PageDown, shift); break;
+    case VK_HOME: v.Move(ctrl ? CaretMove::DocStart : CaretMove::Home, shift); break;
+    case VK_END: v.Move(ctrl ? CaretMove::DocEnd : CaretMove::End, shift); break;
+    case VK_BACK:
+        ScrollEditChanged(hwnd, se, !se.readOnly && v.DeleteBack(ctrl));
+        return true;
+    case VK_DELETE:
+        if (shift) ScrollEditCopy(hwnd, se, true);
+        else ScrollEditChanged(hwnd, se, !se.readOnly && v.DeleteForward(ctrl));
+        return true;
+    case VK_INSERT:
+        if (ctrl) ScrollEditCopy(hwnd, se, false);
+        else if (shift) ScrollEditPaste(hwnd, se);
+        return true;
+    default:
+        if (!ctrl) return false;
+        switch (key) {
+        case 'A': v.SetSel(0, v.Text().size()); break;
+        case 'C': ScrollEditCopy(hwnd, se, false); return true;
+        case 'X': ScrollEditCopy(hwnd, se, true); return true;
+        case 'V': ScrollEditPaste(hwnd, se); return true;
+        case 'Z': ScrollEditChanged(hwnd, se, !se.readOnly && v.Undo()); return true;
+        case 'Y': ScrollEditChanged(hwnd, se, !se.readOnly && v.Redo()); return true;
+        default: return false;
+        }
+        break;
+    }
+    RefreshScrollEdit(hwnd, se);
+    return true;
+}
+
+size_t ScrollEditPosAt(HWND hwnd, ScrollEdit& se, LPARAM lParam, bool* atRowEnd) {
+    const RECT r = ScrollEditTextRect(hwnd);
+    return se.view.PosAt(GET_X_LPARAM(lParam) - r.left, GET_Y_LPARAM(lParam) - r.top, atRowEnd);
+}
+
+LRESULT CALLBACK ScrollEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    if (msg == WM_NCCREATE) SetWindowLongPtrW(hwnd, 0, reinterpret_cast<LONG_PTR>(new ScrollEdit));
+    ScrollEdit* se = reinterpret_cast<ScrollEdit*>(GetWindowLongPtrW(hwnd, 0));
+    if (!se) return DefWindowProcW(hwnd, msg, wParam, lParam);
+
+    switch (msg) {
+    case WM_NCDESTROY:
+        SetWindowLongPtrW(hwnd, 0, 0);
+        delete se;
+        MemHandle(MemArea::Edits, -1);
+        break;
+
+    // --- la parte di EDIT che il programma usa ---
+    case WM_SETTEXT:
+        se->view.SetText(AsUtf16(lParam ? reinterpret_cast<LPCWSTR>(lParam) : L""));
+        RefreshScrollEdit(hwnd, *se);
+        return TRUE; // come la EDIT multilinea: niente EN_CHANGE
+    case WM_GETTEXT: {
+        if (wParam == 0) return 0;
+        const std::u16string& text = se->view.Text();
+        const size_t n = std::min<size_t>(text.size(), wParam - 1);
+        auto* dst = reinterpret_cast<wchar_t*>(lParam);
+        std::copy(text.begin(), text.begin() + n, dst);
+        dst[n] = L'\0';
+        return static_cast<LRESULT>(n);
+    }
+    case WM_GETTEXTLENGTH:
+        return static_cast<LRESULT>(se->view.Text().size());
+    case WM_SETFONT:
+        se->font = reinterpret_cast<HFONT>(wParam);
+        ++se->fontVersion;
+        UpdateScrollEditLayout(hwnd, *se);
+        if (GetFocus() == hwnd) {
+            CreateCaret(hwnd, nullptr, 1, se->view.LineHeight());
+            ShowCaret(hwnd);
+        }
+        if (LOWORD(lParam)) RefreshScrollEdit(hwnd, *se);
+        return 0;
+    case WM_GETFONT:
+        return reinterpret_cast<LRESULT>(se->font);
+    case EM_SETREADONLY:
+        se->readOnly = wParam != 0;
+        return TRUE;
+    case EM_GETSEL: {
+        const size_t start = se->view.SelStart(), end = se->view.SelEnd();
+        if (wParam) *reinterpret_cast<DWORD*>(wParam) = static_cast<DWORD>(start);
+        if (lParam) *reinterpret_cast<DWORD*>(lParam) = static_cast<DWORD>(end);
+        return start > 0xFFFF || end > 0xFFFF ? -1 : MAKELRESULT(start, end);
+    }
+    case EM_SETSEL: {
+        const int start = static_cast<int>(wParam), end = static_cast<int>(lParam);
+        const size_t size = se->view.Text().size();
+        if (start < 0) se->view.SetSel(se->view.Caret(), se->view.Caret());
+        else se->view.SetSel(static_cast<size_t>(start), end < 0 ? size : static_cast<size_t>(end));
+        RefreshScrollEdit(hwnd, *se);
+        return 0;
+    }
+    case EM_REPLACESEL:
+        if (lParam) ScrollEditChanged(hwnd, *se, se->view.Type(AsUtf16(reinterpret_cast<LPCWSTR>(lParam))));
+        return 0;
+    case EM_SCROLLCARET:
+        se->view.ScrollToCaret();
+        RefreshScrollEdit(hwnd, *se);
+        return TRUE;
+    case EM_GETRECT:
+        if (lParam) *reinterpret_cast<RECT*>(lParam) = ScrollEditTextRect(hwnd);
+        return 0;
+    case EM_CHARFROMPOS: {
+        const size_t pos = ScrollEditPosAt(hwnd, *se, lParam, nullptr);
+        return MAKELRESULT(pos & 0xFFFF, se->view.LineOf(pos) & 0xFFFF);
+    }
+    case EM_POSFROMCHAR: {
+        const RECT r = ScrollEditTextRect(hwnd);
+        int x = 0, y = 0;
+        if (!se->view.PointOf(static_cast<size_t>(wParam), false, x, y)) return -1;
+        return MAKELRESULT(r.left + x, r.top + y);
+    }
+    case EM_UNDO:
+    case WM_UNDO:
+        ScrollEditChanged(hwnd, *se, !se->readOnly && se->view.Undo());
+        return TRUE;
+    case WM_COPY:
+    case WM_CUT:
+        ScrollEditCopy(hwnd, *se, msg == WM_CUT);
+        return 0;
+    case WM_PASTE:
+        ScrollEditPaste(hwnd, *se);
+        return 0;
+    case WM_CLEAR:
+        if (!se->readOnly) ScrollEditChanged(hwnd, *se, se->view.Type(u""));
+        return 0;
+
+    // --- disegno ---
+    case WM_ERASEBKGND:
+        return 1;
+    case WM_PRINTCLIENT: // istantanee per lo zoom (PrintWindow)
+        PaintScrollEdit(hwnd, *se, reinterpret_cast<HDC>(wParam));
+        return 0;
+    case WM_PAINT: {
+        PAINTSTRUCT ps{};
+        HDC hdc = BeginPaint(hwnd, &ps);
+        RECT rc{};
+        GetClientRect(hwnd, &rc);
+        // su un bitmap e poi una copia: scorrendo non si vede lo sfondo tra una riga e l'altra
+        HDC mem = TrackedMemDc(MemArea::Paint, hdc);
+        HBITMAP bmp = mem ? TrackedBitmap(MemArea::Paint, hdc, rc.right - rc.left, rc.bottom - rc.top) : nullptr;
+        if (bmp) {
+            HGDIOBJ oldBmp = SelectObject(mem, bmp);
+            PaintScrollEdit(hwnd, *se, mem);
+            BitBlt(hdc, 0, 0, rc.right - rc.left, rc.bottom - rc.top, mem, 0, 0, SRCCOPY);
+            SelectObject(mem, oldBmp);
+        } else {
+            PaintScrollEdit(hwnd, *se, hdc);
+        }
+        FreeGdi(MemArea::Paint, bmp);
+        FreeMemDc(MemArea::Paint, mem);
+        EndPaint(hwnd, &ps);
+        return 0;
+    }
+    case WM_SIZE:
+        UpdateScrollEditLayout(hwnd, *se);
+        RefreshScrollEdit(hwnd, *se);
+        return 0;
+
+    // --- focus ---
+    case WM_SETFOCUS:
+        CreateCaret(hwnd, nullptr, 1, se->view.LineHeight());
+        ShowCaret(hwnd);
+        RefreshScrollEdit(hwnd, *se);
+        NotifyEditParent(hwnd, EN_SETFOCUS);
+        return 0;
+    case WM_KILLFOCUS:
+        DestroyCaret();
+        se->selecting = false;
+        InvalidateRect(hwnd, nullptr, FALSE); // la selezione si vede solo col focus
+        NotifyEditParent(hwnd, EN_KILLFOCUS);
+        return 0;
+    case WM_GETDLGCODE:
+        return DLGC_WANTALLKEYS | DLGC_WANTARROWS | DLGC_WANTCHARS;
+
+    // --- tastiera ---
+    case WM_SYSKEYDOWN:
+        if (HandleNavigationKey(hwnd, wParam)) return 0;
+        break;
+    case WM_KEYDOWN:
+        if (HandleNavigationKey(hwnd, wParam)) return 0;
+        if (ScrollEditKey(hwnd, *se, wParam)) return 0;
+        break;
+    case WM_CHAR: {
+        const wchar_t c = static_cast<wchar_t>(wParam);
+        // Backspace, Ctrl+lettera e Ctrl+Tab sono gia' passati da WM_KEYDOWN
+        if (se->readOnly || (c < 0x20 && c != L'\r' && c != L'\t') || c == 0x7F) return 0;
+        if (c == L'\t' && (GetKeyState(VK_CONTROL) & 0x8000)) return 0;
+        const char16_t unit = static_cast<char16_t>(c);
+        ScrollEditChanged(hwnd, *se, se->view.Type(c == L'\r' ? std::u16string_view(u"\r\n") : std::u16string_view(&unit, 1)));
+        return 0;
+    }
+
+    // --- mouse ---
+    case WM_LBUTTONDOWN:
+    case WM_LBUTTONDBLCLK: {
+        // in modalita' layout si trascina la tile intera: il click passa alla board
+        if (g_state.editLayout && g_board) {
+            POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+            MapWindowPoints(hwnd, g_board, &pt, 1);
+            SendMessageW(g_board, WM_LBUTTONDOWN, wParam, MAKELPARAM(pt.x, pt.y));
+            return 0;
+        }
+        SetFocus(hwnd);
+        bool atRowEnd = false;
+        const size_t pos = ScrollEditPosAt(hwnd, *se, lParam, &atRowEnd);
+        if (msg == WM_LBUTTONDBLCLK) {
+            se->view.SelectWordAt(pos);
+        } else {
+            se->view.SetSel((wParam & MK_SHIFT) ? se->view.Anchor() : pos, pos, atRowEnd);
+            se->selecting = true;
+            SetCapture(hwnd);
+        }
+        RefreshScrollEdit(hwnd, *se);
+        return 0;
+    }
+    case WM_MOUSEMOVE:
+        if (se->selecting) {
+            // sopra o sotto la tile la posizione cade fuori vista e la vista la segue
+            bool atRowEnd = false;
+            const size_t pos = ScrollEditPosAt(hwnd, *se, lParam, &atRowEnd);
+            se->view.SetSel(se->view.Anchor(), pos, atRowEnd);
+            se->view.ScrollToCaret();
+            RefreshScrollEdit(hwnd, *se);
+            return 0;
+        }
+        break;
+    case WM_LBUTTONUP:
+        if (se->selecting) {
+            se->selecting = false;
+            ReleaseCapture();
+        }
+        return 0;
+    case WM_CAPTURECHANGED:
+        se->selecting = false;
+        return 0;
+    case WM_MBUTTONDOWN: // pan della board anche partendo da sopra una tile
+        if (g_board) {
+            POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+            MapWindowPoints(hwnd, g_board, &pt, 1);
+            SendMessageW(g_board, WM_MBUTTONDOWN, wParam, MAKELPARAM(pt.x, pt.y));
+            return 0;
+        }
+        break;
+    case WM_MOUSEWHEEL: {
+        // la rotella scorre la nota; con Ctrl (zoom) o se c'e' tutto va alla board come per le altre tile
+        if ((GET_KEYSTATE_WPARAM(wParam) & MK_CONTROL) || se->view.TotalRows() <= se->view.PageRows()) {
+            if (g_board) return SendMessageW(g_board, msg, wParam, lParam);
+            break;
+        }
+        UINT lines = 3;
+        SystemParametersInfoW(SPI_GETWHEELSCROLLLINES, 0, &lines, 0);
+        const ptrdiff_t step = lines == WHEEL_PAGESCROLL ? static_cast<ptrdiff_t>(se->view.PageRows()) : static_cast<ptrdiff_t>(lines);
+        se->wheelRest += GET_WHEEL_DELTA_WPARAM(wParam);
+        const int notches = se->wheelRest / WHEEL_DELTA;
+        se->wheelRest -= notches * WHEEL_DELTA;
+        se->view.ScrollBy(-notches * step);
+        RefreshScrollEdit(hwnd, *se);
+        return 0;
+    }
+    case WM_MOUSEHWHEEL:
+        if (g_board) return SendMessageW(g_board, msg, wParam, lParam);
+        break;
+    case WM_VSCROLL: {
+        const ptrdiff_t page = static_cast<ptrdiff_t>(se->view.PageRows());
+        switch (LOWORD(wParam)) {
+        case SB_LINEUP: se->view.ScrollBy(-1); break;
+        case SB_LINEDOWN: se->view.ScrollBy(1); break;
+        case SB_PAGEUP: se->view.ScrollBy(-page); break;
+        case SB_PAGEDOWN: se->view.ScrollBy(page); break;
+        case SB_TOP: se->view.ScrollTo(0); break;
+        case SB_BOTTOM: se->view.ScrollTo(se->view.TotalRows()); break;
+        case SB_THUMBTRACK:
+        case SB_THUMBPOSITION: {
+            SCROLLINFO si{};
+            si.cbSize = sizeof(si);
+            si.fMask = SIF_TRACKPOS; // 32 bit, non i 16 di HIWORD(wParam)
+            GetScrollInfo(hwnd, SB_VERT, &si);
+            se->view.ScrollTo(static_cast<size_t>(std::max(0, si.nTrackPos)));
+            break;
+        }
+        }
+        RefreshScrollEdit(hwnd, *se);
+        return 0;
+    }
+    case WM_CONTEXTMENU:
+        ShowTileMenuFromEdit(hwnd, lParam);
+        return 0;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
 
-    HFONT font = reinterpret_cast<HFONT>(SendMessageW(edit, WM_GETFONT, 0, 0));
+// Font di base alla scala corrente (g_bigFont a zoom 1)
+int ZoomedFontPx() { return std::max(6, static_cast<int>(std::lround(g_baseFontPx * g_state.zoom))); }
+HFONT TileBaseFont() { return g_state.zoom == 1.0 ? g_bigFont : FontForPx(ZoomedFontPx()); }
+
+// il testo a capo come nella EDIT sta in clientW x clientH col font dato?
+bool TextFitsInBox(HDC hdc, HFONT font, int clientW, int clientH, const std::wstring& text) {
     HGDIOBJ oldFont = font ? SelectObject(hdc, font) : nullptr;
 
-    RECT calc{0, 0, clientW, 0};
+    RECT calc{0, 0, std::max(1, clientW), 0};
     if (text.empty()) {
         calc.bottom = 1;
     } else {
@@ -607,177 +2373,2087 @@ bool TextFitsInEdit(HWND edit, const std::wstring& text) {
     }
 
     if (oldFont) SelectObject(hdc, oldFont);
+    return calc.bottom <= std::max(1, clientH);
+}
+
+bool TextFitsInEdit(HWND edit, const std::wstring& text) {
+    RECT client{};
+    GetClientRect(edit, &client);
+
+    HDC hdc = GetDC(edit);
+    if (!hdc) return true;
+    const HFONT font = reinterpret_cast<HFONT>(SendMessageW(edit, WM_GETFONT, 0, 0));
+    const bool fits = TextFitsInBox(hdc, font, static_cast<int>(client.right - client.left), static_cast<int>(client.bottom - client.top), text);
     ReleaseDC(edit, hdc);
+    return fits;
+}
 
-    return calc.bottom <= clientH;
+// Senza EDIT (tile fuori vista, o appena divisa da un comando IPC dello stesso batch: le
+// EDIT sono distrutte e il layout aspetta la fine del batch) si misura sul rettangolo
+// che la EDIT avra', col font che avra'. In autoFit basta il gradino piu' piccolo.
+bool TextFitsInTile(const Tile& t, const std::wstring& text) {
+    const RECT r = EditRect(t);
+    HDC hdc = GetDC(nullptr);
+    if (!hdc) return true;
+    const HFONT font = t.autoFit ? FontForPx(kFontLadderPx[0]) : TileBaseFont();
+    const bool fits = TextFitsInBox(hdc, font, std::max(24, static_cast<int>(r.right - r.left)), std::max(24, static_cast<int>(r.bottom - r.top)), text);
+    ReleaseDC(nullptr, hdc);
+    return fits;
 }
 
-void DestroyTileWindows() {
-    for (auto& t : g_state.tiles) {
-        if (t.edit) DestroyWindow(t.edit);
-        t.edit = nullptr;
+// Sceglie la dimensione per una tile autoFit e la applica se cambia. edit: il tratto
+// cambiato rispetto all'ultima chiamata (nullptr = testo invariato, cambia solo la tile).
+// false se il testo non sta nemmeno col font piu' piccolo (la tile resta a quello).
+bool RefitTileFont(Tile& t, const std::wstring& text, const TextEdit* edit) {
+    if (!t.edit) return true;
+    RECT client{};
+    GetClientRect(t.edit, &client);
+    const int clientW = std::max(1, static_cast<int>(client.right - client.left));
+    const int clientH = std::max(1, static_cast<int>(client.bottom - client.top));
+
+    FitLayout& layout = g_fitLayouts[t.id];
+    if (layout.ParagraphCount() == 0) layout.SetText(text);
+    else if (edit) layout.ApplyEdit(text, *edit);
+    layout.SetWidth(clientW);
+
+    const int fit = layout.Fit(text, clientH, ZoomedFontPx(), g_paragraphHeights);
+    const int px = kFontLadderPx[std::max(fit, 0)];
+    if (px != t.fontPx) {
+        t.fontPx = px;
+        DropSnapshot(t.id);
+        SendMessageW(t.edit, WM_SETFONT, (WPARAM)FontForPx(px), TRUE);
     }
+    return fit >= 0;
 }
 
-/*void LayoutTiles() {
-    for (auto& t : g_state.tiles) {
-        if (!t.edit) {
-            t.edit = CreateWindowExW(
-                0,
-                L"EDIT",
-                t.text.c_str(),
-                WS_CHILD | WS_VISIBLE | ES_LEFT | ES_MULTILINE | ES_WANTRETURN,
-                0,
-                0,
-                10,
-                10,
-                g_board,
-                nullptr,
-                GetModuleHandleW(nullptr),
-                nullptr);
-            if (!g_defaultEditProc) {
-                g_defaultEditProc = reinterpret_cast<WNDPROC>(GetWindowLongPtrW(t.edit, GWLP_WNDPROC));
+// Regola comune a tastiera e IPC: il nuovo testo deve stare nella tile. In autoFit
+// basta che stia a qualche dimensione del ladder; se no si torna allo stato di t.text.
+bool FitTextToTile(Tile& t, const std::wstring& text) {
+    if (t.scroll) return true; // la nota lunga scorre: nessun limite di spazio
+    if (!t.edit) return TextFitsInTile(t, text);
+    if (!t.autoFit) return TextFitsInEdit(t.edit, text);
+
+    const TextEdit edit = DiffTexts(t.text, text);
+    if (RefitTileFont(t, text, &edit)) return true;
+    const TextEdit undo{edit.at, edit.inserted, edit.removed};
+    RefitTileFont(t, t.text, &undo);
+    return false;
+}
+
+// Dopo un riposizionamento: le tile autoFit si riadattano alla nuova larghezza/altezza,
+// le altre tornano al font di base della scala corrente (EDIT riusate da ReplaceTiles,
+// modalita' appena spenta, zoom cambiato).
+void ApplyTileFont(Tile& t) {
+    if (!t.edit) return;
+    if (t.autoFit) {
+        RefitTileFont(t, t.text, nullptr);
+        return;
+    }
+    t.fontPx = 0;
+    const HFONT font = TileBaseFont();
+    if (reinterpret_cast<HFONT>(SendMessageW(t.edit, WM_GETFONT, 0, 0)) != font) {
+        SendMessageW(t.edit, WM_SETFONT, (WPARAM)font, TRUE);
+        DropSnapshot(t.id);
+    }
+}
+
+// Sincronizzazione tra dispositivi (crdtsync.h). Il documento CRDT e' la copia comune;
+// g_state.tiles ne e' la vista locale. Le modifiche locali entrano nel log a ogni
+// salvataggio, quelle degli altri arrivano dal watcher sulla cartella.
+SyncGeometry TileGeometry(const Tile& t) { return SyncGeometry{t.x, t.y, t.w, t.h, t.autoFit, false}; }
+
+// Solo cio' che e' cambiato qui: testi delle tile sporche e, se la geometria e' cambiata,
+// il confronto di tutte le tile col documento (SetGeometry non scrive se sono uguali).
+void FlushSyncChanges() {
+    if (!g_sync) return;
+    std::string lines;
+    for (uint64_t id : g_dirtyTiles) {
+        const int idx = FindTileIndexById(id);
+        if (idx >= 0) g_sync->SetText(id, WideToCodepoints(g_state.tiles[idx].text), lines);
+    }
+    if (g_layoutDirty) {
+        std::unordered_set<uint64_t> present;
+        for (const auto& t : g_state.tiles) {
+            present.insert(t.id);
+            g_sync->SetGeometry(t.id, TileGeometry(t), lines);
+        }
+        for (uint64_t id : g_sync->Tiles()) {
+            if (present.count(id)) continue;
+            SyncGeometry g = *g_sync->Geometry(id);
+            g.removed = true;
+            g_sync->SetGeometry(id, g, lines);
+        }
+    }
+    if (!lines.empty()) g_syncLog.Append(lines);
+}
+
+// Posizione nel testo dopo una modifica arrivata da fuori: prima del tratto resta,
+// dopo scorre, dentro finisce in fondo al testo nuovo.
+DWORD ShiftForEdit(DWORD pos, const TextEdit& e) {
+    if (pos >= e.at + e.removed) return static_cast<DWORD>(pos - e.removed + e.inserted);
+    if (pos > e.at) return static_cast<DWORD>(e.at + e.inserted);
+    return pos;
+}
+
+void ApplyRemoteText(Tile& t, const std::wstring& text) {
+    const TextEdit edit = DiffTexts(t.text, text);
+    DropSnapshot(t.id);
+    if (t.edit && t.tailPath.empty()) {
+        DWORD start = 0;
+        DWORD end = 0;
+        SendMessageW(t.edit, EM_GETSEL, (WPARAM)&start, (LPARAM)&end);
+        g_internalTextSet = true;
+        SetWindowTextW(t.edit, text.c_str());
+        SendMessageW(t.edit, EM_SETSEL, ShiftForEdit(start, edit), ShiftForEdit(end, edit));
+        g_internalTextSet = false;
+        // il testo degli altri si accetta anche se qui non sta: le copie devono restare uguali
+        if (t.autoFit) RefitTileFont(t, text, &edit);
+    }
+    t.text = text;
+    NoteTextChanged(t.id);
+    PublishTileChanged(t.id);
+}
+
+// Righe nuove nella cartella: prima le modifiche locali vanno nel documento (cosi' due
+// modifiche concorrenti allo stesso testo si uniscono), poi si aggiornano solo le tile toccate.
+void MergeSyncChanges() {
+    if (!g_sync) return;
+    FlushSyncChanges();
+    std::unordered_set<uint64_t> touched;
+    g_sync->Apply(g_syncLog.ReadNew(), touched);
+    if (touched.empty()) return;
+
+    std::vector<uint64_t> moved;
+    bool removed = false;
+    for (uint64_t id : touched) {
+        const SyncGeometry* g = g_sync->Geometry(id);
+        if (!g) continue; // testo di una tile la cui geometria non e' ancora arrivata
+        const int idx = FindTileIndexById(id);
+        if (g->removed) {
+            if (idx < 0) continue;
+            Tile& t = g_state.tiles[idx];
+            if (t.edit) DestroyWindow(t.edit);
+            IndexTileRemoved(t);
+            g_fitLayouts.erase(id);
+            g_dirtyTiles.erase(id);
+            g_state.tiles.erase(g_state.tiles.begin() + idx);
+            removed = true;
+            continue;
+        }
+        const std::wstring text = CodepointsToWide(g_sync->Text(id));
+        if (idx < 0) {
+            g_state.tiles.push_back(Tile{g->x, g->y, g->w, g->h, text, nullptr, id, g->autoFit});
+            IndexTileAdded(g_state.tiles.back());
+            NoteTextChanged(id);
+            moved.push_back(id);
+            continue;
+        }
+        Tile& t = g_state.tiles[idx];
+        if (TileGeometry(t) != *g) {
+            const CellRect before = TileRect(t);
+            t.x = g->x;
+            t.y = g->y;
+            t.w = g->w;
+            t.h = g->h;
+            if (t.autoFit != g->autoFit) g_fitLayouts.erase(id);
+            t.autoFit = g->autoFit;
+            IndexTileMoved(before, t);
+            moved.push_back(id);
+        }
+        if (t.text != text) ApplyRemoteText(t, text);
+    }
+
+    // due dispositivi possono occupare la stessa area nello stesso momento: la
+    // riparazione locale diventa a sua volta una modifica da propagare
+    std::vector<uint64_t> hits;
+    for (uint64_t id : moved) {
+        const int idx = FindTileIndexById(id);
+        if (idx < 0) continue;
+        g_tileGrid.Query(TileRect(g_state.tiles[idx]), id, hits);
+        if (hits.empty()) continue;
+        ValidateLayout(false);
+        RebuildTileIndexes();
+        break;
+    }
+    if (!moved.empty() || removed) {
+        LayoutTiles();
+        if (g_ipc.HasSubscribers()) g_ipc.Publish("{\"event\":\"layout\"}");
+    }
+    ScheduleSave();
+}
+
+// Con "syncFolder" nello stato (letto all'avvio). Se la cartella ha gia' un documento
+// comanda lui; se e' vuota la board locale diventa lo stato iniziale per tutti.
+void StartSync() {
+    if (g_state.syncFolder.empty()) return;
+    if (g_state.replicaId == 0) {
+        std::random_device rd;
+        g_state.replicaId = (static_cast<uint64_t>(rd()) << 32 | rd()) | 1;
+        g_layoutDirty = true;
+    }
+    g_state.nextTileId = std::max(g_state.nextTileId, TileIdBase());
+    if (!g_syncLog.Open(g_state.syncFolder, g_state.replicaId)) return;
+
+    g_sync = std::make_unique<SyncDoc>(g_state.replicaId);
+    std::unordered_set<uint64_t> touched;
+    g_sync->Apply(g_syncLog.ReadNew(), touched);
+
+    if (g_sync->Tiles().empty()) {
+        // il primo salvataggio mette tutta la board nel proprio log
+        for (const auto& t : g_state.tiles) g_dirtyTiles.insert(t.id);
+    } else {
+        // file seguiti dalle tile "tail" e promemoria sono di questo dispositivo: non passano dal documento
+        std::unordered_map<uint64_t, const Tile*> local;
+        for (const auto& t : g_state.tiles) local[t.id] = &t;
+        TileList tiles;
+        for (uint64_t id : g_sync->Tiles()) {
+            const SyncGeometry& g = *g_sync->Geometry(id);
+            tiles.push_back(Tile{g.x, g.y, g.w, g.h, CodepointsToWide(g_sync->Text(id)), nullptr, id, g.autoFit});
+            auto old = local.find(id);
+            if (old != local.end()) {
+                tiles.back().tailPath = old->second->tailPath;
+                tiles.back().remindAt = old->second->remindAt;
+                tiles.back().scroll = old->second->scroll;
+                tiles.back().files = old->second->files; // anche gli allegati: i byte sono solo qui
+            }
+        }
+        g_state.tiles = std::move(tiles);
+        g_tileIndexStale = true;
+        AssignMissingTileIds();
+    }
+    g_layoutDirty = true;
+    ScheduleSave();
+
+    g_syncWatcher.Start(g_state.syncFolder, [](const std::filesystem::path& name) {
+        if (name.empty() || name.extension() == L".ops") PostMessageW(g_mainWnd, kMsgSyncChanged, 0, 0);
+    });
+}
+
+// Cartella Markdown (mirror.h). Nei file il fine riga e' \n, come lo scrivono gli
+// editor; nelle EDIT e' \r\n.
+std::string MirrorBytes(const std::wstring& text) {
+    std::wstring lf;
+    lf.reserve(text.size());
+    for (wchar_t c : text) {
+        if (c != L'\r') lf += c;
+    }
+    return WideToUtf8(lf);
+}
+
+std::wstring MirrorText(std::string bytes) {
+    if (bytes.compare(0, 3, "\xEF\xBB\xBF") == 0) bytes.erase(0, 3); // BOM di qualche editor
+    const std::wstring w = Utf8ToWide(bytes);
+    std::wstring out;
+    out.reserve(w.size());
+    for (wchar_t c : w) {
+        if (c == L'\n' && (out.empty() || out.back() != L'\r')) out += L'\r';
+        out += c;
+    }
+    return out;
+}
+
+// Dal salvataggio: solo i testi cambiati; con la geometria cambiata anche i file di
+// tile nuove o eliminate. Export non scrive se il file ha gia' quel contenuto.
+void ExportMirror() {
+    if (!g_mirrorOn) return;
+    for (uint64_t id : g_mirrorTexts) {
+        const int idx = FindTileIndexById(id);
+        if (idx >= 0) g_mirror.Export(id, MirrorBytes(g_state.tiles[idx].text));
+    }
+    g_mirrorTexts.clear();
+    if (!g_layoutDirty) return;
+
+    std::unordered_set<uint64_t> present;
+    for (const auto& t : g_state.tiles) {
+        present.insert(t.id);
+        if (!g_mirror.Has(t.id)) g_mirror.Export(t.id, MirrorBytes(t.text));
+    }
+    for (uint64_t id : g_mirror.Ids()) {
+        if (!present.count(id)) g_mirror.Remove(id);
+    }
+}
+
+// Dal debounce del salvataggio: si leggono solo i file notificati. Un file cancellato
+// da fuori torna al prossimo salvataggio (le tile si eliminano dall'app); un <id>.md
+// senza tile resta com'e'.
+void ImportMirrorChanges() {
+    for (const MirrorFile& f : g_mirror.TakeChanges()) {
+        const int idx = FindTileIndexById(f.id);
+        if (idx < 0) continue;
+        Tile& t = g_state.tiles[idx];
+        if (f.deleted) {
+            g_mirrorTexts.insert(t.id);
+            g_savePending = true;
+            continue;
+        }
+        const std::wstring text = MirrorText(f.bytes);
+        if (text == t.text) continue;
+        ApplyRemoteText(t, text);
+        g_dirtyTiles.insert(t.id);
+        g_savePending = true;
+    }
+}
+
+// Con "mirrorFolder" nello stato (letto all'avvio). I file modificati ad app chiusa
+// (piu' recenti di state.json) entrano nelle tile; per il resto vincono le tile.
+void StartMirror() {
+    if (g_state.mirrorFolder.empty() || !g_mirror.Open(g_state.mirrorFolder)) return;
+    g_mirrorOn = true;
+
+    std::error_code ec;
+    const auto saved = std::filesystem::last_write_time(GetStatePath(), ec);
+    std::unordered_map<uint64_t, MirrorFile> files;
+    for (MirrorFile& f : g_mirror.Scan()) files[f.id] = std::move(f);
+    for (auto& t : g_state.tiles) {
+        auto it = files.find(t.id);
+        if (it != files.end() && !ec && it->second.modified > saved) {
+            const std::wstring text = MirrorText(it->second.bytes);
+            if (text != t.text) {
+                ApplyRemoteText(t, text);
+                g_dirtyTiles.insert(t.id);
+                ScheduleSave();
+            }
+            continue;
+        }
+        g_mirror.Export(t.id, MirrorBytes(t.text));
+    }
+
+    g_mirrorWatcher.Start(g_state.mirrorFolder, [](const std::filesystem::path& name) {
+        g_mirror.Notify(name);
+        PostMessageW(g_mainWnd, kMsgMirrorChanged, 0, 0);
+    });
+}
+
+void SetTileAutoFit(int idx, bool on) {
+    if (idx < 0 || idx >= static_cast<int>(g_state.tiles.size())) return;
+    Tile& t = g_state.tiles[idx];
+    if (t.autoFit == on) return;
+    if (on && t.scroll) {
+        SetTileScroll(idx, false); // adattare il font e scorrere si escludono
+    }
+    t.autoFit = on;
+    if (!on) g_fitLayouts.erase(t.id);
+    ApplyTileFont(t);
+    g_layoutDirty = true; // il flag sta nel file insieme alla geometria
+    SaveState();
+}
+
+// Nota lunga: la finestra della tile cambia classe (EDIT <-> vista che scorre), quindi
+// si distrugge e LayoutTiles la ricrea; il testo e' gia' in t.text.
+void SetTileScroll(int idx, bool on) {
+    if (idx < 0 || idx >= static_cast<int>(g_state.tiles.size())) return;
+    Tile& t = g_state.tiles[idx];
+    if (t.scroll == on) return;
+    if (on && t.autoFit) {
+        t.autoFit = false;
+        g_fitLayouts.erase(t.id);
+    }
+    if (t.edit) {
+        DestroyWindow(t.edit);
+        t.edit = nullptr;
+        t.fontPx = 0;
+        g_liveEdits.erase(t.id);
+    }
+    g_formulaShown.erase(t.id);
+    g_markdown.erase(t.id);
+    DropSnapshot(t.id);
+    t.scroll = on;
+    g_layoutDirty = true;
+    SaveState();
+    LayoutTiles();
+}
+
+void DestroyTileWindows() {
+    for (uint64_t id : g_liveEdits) {
+        const int idx = FindTileIndexById(id);
+        if (idx < 0 || !g_state.tiles[idx].edit) continue;
+        DestroyWindow(g_state.tiles[idx].edit);
+        g_state.tiles[idx].edit = nullptr;
+    }
+    g_liveEdits.clear();
+    DropAllSnapshots();
+}
+
+/*void LayoutTiles() {
+    for (auto& t : g_state.tiles) {
+        if (!t.edit) {
+            t.edit = CreateWindowExW(
+                0,
+                L"EDIT",
+                t.text.c_str(),
+                WS_CHILD | WS_VISIBLE | ES_LEFT | ES_MULTILINE | ES_WANTRETURN,
+                0,
+                0,
+                10,
+                10,
+                g_board,
+                nullptr,
+                GetModuleHandleW(nullptr),
+                nullptr);
+            if (!g_defaultEditProc) {
+                g_defaultEditProc = reinterpret_cast<WNDPROC>(GetWindowLongPtrW(t.edit, GWLP_WNDPROC));
+            }
+           SetWindowLongPtrW(t.edit, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(EditProc));
+
+LOGFONT lf;
+GetObject(GetStockObject(DEFAULT_GUI_FONT), sizeof(lf), &lf);
+lf.lfHeight *= 1.6; // font doppio
+
+HFONT bigFont = CreateFontIndirect(&lf);
+
+SendMessageW(t.edit, WM_SETFONT, (WPARAM)bigFont, TRUE);
+        }
+
+        const int inset = kEditPadding + (g_state.editLayout ? kResizeHandlePx : 0);
+        MoveWindow(
+            t.edit,
+            ToPx(t.x) + inset,
+            ToPx(t.y) + inset,
+            std::max(24, ToPx(t.w) - 2 * inset),
+            std::max(24, ToPx(t.h) - 2 * inset),
+            TRUE);
+}
+
+    InvalidateRect(g_board, nullptr, TRUE);
+}*/
+//old, without batching ^^^^
+
+
+// Tile "tail" (tail.h): la EDIT mostra le ultime righe di un file e resta in sola
+// lettura. Le notifiche della cartella si accorpano alla frequenza dello schermo; il
+// timer lento copre i casi in cui la notifica non arriva.
+int TailRepaintMs() {
+    HDC dc = GetDC(nullptr);
+    const int hz = GetDeviceCaps(dc, VREFRESH);
+    ReleaseDC(nullptr, dc);
+    return 1000 / (hz > 1 ? hz : 60);
+}
+
+void ShowTailText(Tile& t) {
+    auto it = g_tails.find(t.id);
+    if (!t.edit || it == g_tails.end()) return;
+    std::wstring text = Utf8ToWide(it->second->Text());
+    std::wstring crlf;
+    crlf.reserve(text.size() + it->second->Lines().Size());
+    for (wchar_t c : text) {
+        if (c == L'\n') crlf += L'\r';
+        crlf += c;
+    }
+    g_internalTextSet = true;
+    SetWindowTextW(t.edit, crlf.c_str());
+    g_internalTextSet = false;
+    // in fondo, come tail -f
+    SendMessageW(t.edit, EM_SETSEL, crlf.size(), crlf.size());
+    SendMessageW(t.edit, EM_SCROLLCARET, 0, 0);
+    DropSnapshot(t.id);
+}
+
+void RefreshTailWatchers() {
+    std::unordered_set<std::wstring> dirs;
+    for (const auto& [id, tail] : g_tails) dirs.insert(tail->Path().parent_path().wstring());
+    for (auto it = g_tailWatchers.begin(); it != g_tailWatchers.end();) {
+        it = dirs.count(it->first) ? std::next(it) : g_tailWatchers.erase(it);
+    }
+    for (const std::wstring& dir : dirs) {
+        if (g_tailWatchers.count(dir)) continue;
+        auto watcher = std::make_unique<DirWatcher>();
+        watcher->Start(dir, [](const std::filesystem::path&) {
+            if (!g_tailSignaled.exchange(true)) PostMessageW(g_mainWnd, kMsgTailChanged, 0, 0);
+        });
+        g_tailWatchers[dir] = std::move(watcher);
+    }
+    if (g_tails.empty()) KillTimer(g_mainWnd, kTimerTailPoll);
+    else SetTimer(g_mainWnd, kTimerTailPoll, kTailPollMs, nullptr);
+}
+
+// Le tail di tile sparite (eliminate, sostituite da fuori) si chiudono qui.
+void PollTails() {
+    g_tailSignaled = false; // prima di leggere: una scrittura da qui in poi rimanda un messaggio
+    bool dropped = false;
+    for (auto it = g_tails.begin(); it != g_tails.end();) {
+        const int idx = FindTileIndexById(it->first);
+        if (idx < 0 || g_state.tiles[idx].tailPath != it->second->Path().wstring()) {
+            it = g_tails.erase(it);
+            dropped = true;
+            continue;
+        }
+        if (it->second->Poll() != FileTail::Result::Unchanged) ShowTailText(g_state.tiles[idx]);
+        ++it;
+    }
+    if (dropped) RefreshTailWatchers();
+}
+
+void StartTail(Tile& t) {
+    auto tail = std::make_unique<FileTail>(std::filesystem::path(t.tailPath), kTailLines);
+    tail->Poll();
+    g_tails[t.id] = std::move(tail);
+    g_formulaShown.erase(t.id);
+    if (t.edit) {
+        SendMessageW(t.edit, EM_SETREADONLY, TRUE, 0);
+        ShowTailText(t);
+    }
+}
+
+// Una FileTail per ogni tile con "tail" (all'avvio e quando le tile arrivano da fuori)
+void UpdateTails() {
+    for (auto& t : g_state.tiles) {
+        if (t.tailPath.empty()) continue;
+        auto it = g_tails.find(t.id);
+        if (it == g_tails.end() || it->second->Path().wstring() != t.tailPath) StartTail(t);
+    }
+    PollTails(); // chiude quelle senza piu' tile e sistema le cartelle seguite
+    RefreshTailWatchers();
+}
+
+void FollowFileInTile(int idx) {
+    wchar_t path[MAX_PATH]{};
+    OPENFILENAMEW ofn{};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = g_mainWnd;
+    ofn.lpstrFilter = L"Log e testo\0*.log;*.txt;*.out\0Tutti i file\0*.*\0";
+    ofn.lpstrFile = path;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+    if (!GetOpenFileNameW(&ofn)) return;
+
+    Tile& t = g_state.tiles[idx];
+    SyncTileTextsFromWindows(); // il testo scritto resta in t.text e torna quando si smette di seguire
+    t.tailPath = path;
+    StartTail(t);
+    RefreshTailWatchers();
+    g_layoutDirty = true;
+    ScheduleSave();
+}
+
+void StopFollowingFile(int idx) {
+    Tile& t = g_state.tiles[idx];
+    t.tailPath.clear();
+    g_tails.erase(t.id);
+    if (t.edit) {
+        SendMessageW(t.edit, EM_SETREADONLY, FALSE, 0);
+        g_internalTextSet = true;
+        SetWindowTextW(t.edit, t.text.c_str());
+        g_internalTextSet = false;
+        DropSnapshot(t.id);
+    }
+    QueueRecalc(t.id); // se era una formula torna a mostrare il risultato
+    RefreshTailWatchers();
+    g_layoutDirty = true;
+    ScheduleSave();
+}
+
+// Un solo timer per tutti i promemoria, sulla prossima scadenza della ruota. Il tetto
+// serve se l'orologio si sposta senza WM_TIMECHANGE: al piu' tardi ci si riallinea li'.
+void ArmReminderTimer() {
+    if (!g_mainWnd) return;
+    const int64_t delay = g_reminders.NextDelay(NowMs());
+    if (delay < 0) {
+        KillTimer(g_mainWnd, kTimerReminder);
+        return;
+    }
+    const UINT ms = static_cast<UINT>(std::clamp<int64_t>(delay, USER_TIMER_MINIMUM, kReminderMaxSleepMs));
+    SetTimer(g_mainWnd, kTimerReminder, ms, nullptr);
+}
+
+// Scadenze passate (anche tante, dopo una sospensione): la tile lampeggia finche' non la
+// si apre, la finestra lampeggia nella barra se non e' in primo piano.
+void FireReminders() {
+    bool any = false;
+    for (uint64_t id : g_reminders.Advance(NowMs())) {
+        const int idx = FindTileIndexById(id);
+        if (idx < 0) continue;
+        Tile& t = g_state.tiles[idx];
+        t.remindAt = 0;
+        g_ringing.insert(id);
+        if (t.edit) InvalidateRect(t.edit, nullptr, TRUE);
+        if (g_ipc.HasSubscribers()) g_ipc.Publish("{\"event\":\"reminder\",\"tile\":" + std::to_string(id) + "}");
+        any = true;
+    }
+    if (any) {
+        g_layoutDirty = true;
+        ScheduleSave();
+        FLASHWINFO fi{sizeof(fi), g_mainWnd, FLASHW_ALL | FLASHW_TIMERNOFG, 0, 0};
+        FlashWindowEx(&fi);
+        MessageBeep(MB_ICONINFORMATION);
+        SetTimer(g_mainWnd, kTimerRingBlink, kRingBlinkMs, nullptr);
+    }
+    ArmReminderTimer();
+}
+
+// Voci del menu Promemoria: 0 = tra 10 minuti, 1 = tra un'ora, 2 = domani alle 9, altro = nessuno
+int64_t ReminderPreset(int preset) {
+    const int64_t now = NowMs();
+    if (preset == 0) return now + 10 * 60 * 1000;
+    if (preset == 1) return now + 60 * 60 * 1000;
+    if (preset != 2) return 0;
+    std::time_t t = static_cast<std::time_t>(now / 1000);
+    std::tm tm = *std::localtime(&t);
+    tm.tm_mday += 1; // mktime normalizza fine mese e ora legale
+    tm.tm_hour = 9;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&tm)) * 1000;
+}
+
+void SetTileReminder(int idx, int64_t at) {
+    Tile& t = g_state.tiles[idx];
+    t.remindAt = at;
+    if (at) g_reminders.Add(t.id, at);
+    else g_reminders.Remove(t.id);
+    if (g_ringing.erase(t.id) && t.edit) InvalidateRect(t.edit, nullptr, TRUE);
+    ArmReminderTimer();
+    g_layoutDirty = true;
+    ScheduleSave();
+}
+
+// Una tile calcolata mostra il risultato; la formula si vede solo mentre ha il focus
+// (EN_SETFOCUS la rimette, EN_KILLFOCUS torna qui). t.text resta sempre la formula.
+void ShowFormulaResult(Tile& t) {
+    if (!t.edit || !t.tailPath.empty() || GetFocus() == t.edit) return;
+    const bool formula = g_formulas.IsFormula(t.id);
+    if (!formula && g_formulaShown.erase(t.id) == 0) return; // mostra gia' il testo
+    const std::wstring shown = formula ? g_formulas.Display(t.id) : t.text;
+    g_internalTextSet = true;
+    SetWindowTextW(t.edit, shown.c_str());
+    g_internalTextSet = false;
+    if (formula) g_formulaShown.insert(t.id);
+    DropSnapshot(t.id);
+}
+
+// Testi toccati al motore, poi ricalcolo delle sole formule che ne dipendono
+void RecalcFormulas() {
+    std::vector<uint64_t> touched(g_formulaTexts.begin(), g_formulaTexts.end());
+    g_formulaTexts.clear();
+    for (uint64_t id : touched) {
+        const int idx = FindTileIndexById(id);
+        if (idx >= 0) g_formulas.SetTile(id, g_state.tiles[idx].text);
+    }
+    const std::vector<uint64_t> changed = g_formulas.Recalculate();
+    touched.insert(touched.end(), changed.begin(), changed.end());
+    for (uint64_t id : touched) {
+        const int idx = FindTileIndexById(id);
+        if (idx >= 0) ShowFormulaResult(g_state.tiles[idx]);
+    }
+}
+
+void EnsureTileEdit(Tile& t) {
+    if (t.edit) return;
+    if (t.scroll) {
+        // nota lunga: niente testo nel titolo (la EDIT lo copierebbe tutto), arriva con WM_SETTEXT
+        t.edit = CreateWindowExW(0, L"GridNotesTextView", L"", WS_CHILD | WS_VISIBLE | WS_VSCROLL, 0, 0, 10, 10, g_board, nullptr, GetModuleHandleW(nullptr), nullptr);
+        if (t.edit) MemHandle(MemArea::Edits, 1); // scende in WM_NCDESTROY di ScrollEditProc
+        SetWindowLongPtrW(t.edit, GWLP_USERDATA, static_cast<LONG_PTR>(t.id));
+        SendMessageW(t.edit, WM_SETFONT, (WPARAM)TileBaseFont(), FALSE);
+        SetWindowTextW(t.edit, t.text.c_str());
+    } else {
+        t.edit = CreateWindowExW(
+            0, L"EDIT", t.text.c_str(),
+            WS_CHILD | WS_VISIBLE | ES_LEFT | ES_MULTILINE | ES_WANTRETURN,
+            0, 0, 10, 10,
+            g_board, nullptr, GetModuleHandleW(nullptr), nullptr);
+        if (t.edit) MemHandle(MemArea::Edits, 1); // scende in WM_NCDESTROY di EditProc
+
+        if (!g_defaultEditProc) {
+            g_defaultEditProc = reinterpret_cast<WNDPROC>(
+                GetWindowLongPtrW(t.edit, GWLP_WNDPROC));
+        }
+        SetWindowLongPtrW(t.edit, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(EditProc));
+        SetWindowLongPtrW(t.edit, GWLP_USERDATA, static_cast<LONG_PTR>(t.id)); // EDIT -> tile senza scansioni
+
+        SendMessageW(t.edit, WM_SETFONT, (WPARAM)(t.autoFit && t.fontPx ? FontForPx(t.fontPx) : TileBaseFont()), TRUE);
+    }
+    g_liveEdits.insert(t.id);
+    if (!t.tailPath.empty()) {
+        SendMessageW(t.edit, EM_SETREADONLY, TRUE, 0);
+        ShowTailText(t);
+    } else if (g_formulas.IsFormula(t.id)) {
+        ShowFormulaResult(t);
+    }
+}
+
+// --- Allegati ---
+// Una striscia in fondo alla tile, sotto la EDIT, disegnata dalla board: le miniature si
+// chiedono solo per le tile in vista e arrivano dal thread di g_thumbs (kMsgThumbReady).
+
+constexpr int kAttachmentRowPx = 44;  // striscia con soli file, a zoom 1
+constexpr int kAttachmentFilePx = 140; // larghezza di un file nella striscia, a zoom 1
+constexpr int kAttachmentGapPx = 3;
+constexpr auto kBlobGrace = std::chrono::hours(24 * 7); // un allegato tolto resta nello store una settimana
+
+// con immagini tre quinti della tile, con soli file una riga di nomi
+int AttachmentStripPx(const Tile& t, int innerHeight) {
+    if (t.files.empty()) return 0;
+    const bool images = std::any_of(t.files.begin(), t.files.end(), [](const Attachment& a) { return a.width > 0; });
+    return images ? innerHeight * 3 / 5 : std::min(innerHeight / 2, static_cast<int>(std::lround(kAttachmentRowPx * g_state.zoom)));
+}
+
+RECT TileInnerRect(const Tile& t) {
+    const int inset = kEditPadding + (g_state.editLayout ? kResizeHandlePx : 0);
+    RECT r = ScreenRect(TileRect(t));
+    InflateRect(&r, -inset, -inset);
+    return r;
+}
+
+// dove sta la EDIT: la tile meno il bordo e la striscia degli allegati
+RECT EditRect(const Tile& t) {
+    RECT r = TileInnerRect(t);
+    r.bottom -= AttachmentStripPx(t, r.bottom - r.top);
+    return r;
+}
+
+RECT AttachmentStripRect(const Tile& t) {
+    RECT r = TileInnerRect(t);
+    r.top = r.bottom - AttachmentStripPx(t, r.bottom - r.top);
+    return r;
+}
+
+// Caselle degli allegati da sinistra, finche' ci stanno (la prima sempre, tagliata):
+// le immagini con le loro proporzioni (entro 1:2 e 2:1), i file larghi per il nome
+std::vector<RECT> AttachmentCells(const Tile& t) {
+    std::vector<RECT> cells;
+    const RECT strip = AttachmentStripRect(t);
+    const int h = static_cast<int>(strip.bottom - strip.top) - 2 * kAttachmentGapPx;
+    if (h < 8) return cells;
+    const int right = strip.right - kAttachmentGapPx;
+    int x = strip.left + kAttachmentGapPx;
+    for (const Attachment& a : t.files) {
+        int w = a.width > 0 && a.height > 0 ? static_cast<int>(std::clamp<int64_t>(int64_t{h} * a.width / a.height, h / 2, h * 2))
+                                            : std::max(h, static_cast<int>(std::lround(kAttachmentFilePx * g_state.zoom)));
+        if (x + w > right) {
+            if (!cells.empty()) break;
+            w = right - x;
+            if (w < 8) break;
+        }
+        cells.push_back(RECT{x, strip.top + kAttachmentGapPx, x + w, strip.top + kAttachmentGapPx + h});
+        x += w + kAttachmentGapPx;
+    }
+    return cells;
+}
+
+int AttachmentAt(const Tile& t, POINT ptBoard) {
+    const std::vector<RECT> cells = AttachmentCells(t);
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (PtInRect(&cells[i], ptBoard)) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+std::wstring SizeLabel(uint64_t bytes) {
+    if (bytes < 1024) return std::to_wstring(bytes) + L" B";
+    if (bytes < 1024 * 1024) return std::to_wstring(bytes / 1024) + L" KB";
+    return std::to_wstring(bytes / (1024 * 1024)) + L" MB";
+}
+
+// centrata nella casella, con le proporzioni dell'immagine
+void DrawThumb(HDC hdc, const Thumb& thumb, const RECT& cell) {
+    int w = cell.right - cell.left;
+    int h = cell.bottom - cell.top;
+    if (int64_t{thumb.width} * h > int64_t{thumb.height} * w) h = std::max(1, static_cast<int>(int64_t{w} * thumb.height / thumb.width));
+    else w = std::max(1, static_cast<int>(int64_t{h} * thumb.width / thumb.height));
+
+    BITMAPINFO bi{};
+    bi.bmiHeader.biSize = sizeof(bi.bmiHeader);
+    bi.bmiHeader.biWidth = thumb.width;
+    bi.bmiHeader.biHeight = -thumb.height; // righe dall'alto
+    bi.bmiHeader.biPlanes = 1;
+    bi.bmiHeader.biBitCount = 32;
+    bi.bmiHeader.biCompression = BI_RGB;
+    const int oldMode = SetStretchBltMode(hdc, HALFTONE);
+    SetBrushOrgEx(hdc, 0, 0, nullptr);
+    StretchDIBits(hdc, cell.left + (cell.right - cell.left - w) / 2, cell.top + (cell.bottom - cell.top - h) / 2, w, h, 0, 0, thumb.width, thumb.height,
+                  thumb.pixels.data(), &bi, DIB_RGB_COLORS, SRCCOPY);
+    SetStretchBltMode(hdc, oldMode);
+}
+
+// Con la penna e il pennello vuoto di WM_PAINT gia' selezionati. Un'immagine non ancora
+// pronta e' solo la cornice; una che non si legge (o il cui blob manca) diventa un file.
+void PaintAttachments(HDC hdc, const Tile& t) {
+    const RECT strip = AttachmentStripRect(t);
+    if (strip.bottom - strip.top < 8 || strip.right - strip.left < 8) return;
+    FillRect(hdc, &strip, g_editBgBrush);
+    const std::vector<RECT> cells = AttachmentCells(t);
+
+    HGDIOBJ oldFont = SelectObject(hdc, FontForPx(std::max(8, ZoomedFontPx() * 3 / 4)));
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, RGB(235, 235, 235));
+    for (size_t i = 0; i < cells.size(); ++i) {
+        const Attachment& a = t.files[i];
+        const RECT& c = cells[i];
+        bool failed = false;
+        if (a.width > 0) {
+            const ThumbPtr thumb = g_thumbs.Get(a.hash, ThumbCache::ThumbSide(std::max(c.right - c.left, c.bottom - c.top)), &failed);
+            if (thumb) {
+                DrawThumb(hdc, *thumb, c);
+                continue;
+            }
+        }
+        Rectangle(hdc, c.left, c.top, c.right, c.bottom);
+        if (a.width > 0 && !failed) continue;
+
+        RECT text = c;
+        InflateRect(&text, -4, -2);
+        const std::wstring name = Utf8ToWide(a.name);
+        const std::wstring size = failed ? L"non disponibile" : SizeLabel(a.size);
+        DrawTextW(hdc, name.c_str(), -1, &text, DT_LEFT | DT_TOP | DT_SINGLELINE | DT_END_ELLIPSIS | DT_NOPREFIX);
+        DrawTextW(hdc, size.c_str(), -1, &text, DT_LEFT | DT_BOTTOM | DT_SINGLELINE | DT_END_ELLIPSIS | DT_NOPREFIX);
+    }
+    if (!cells.empty() && cells.size() < t.files.size()) {
+        // quelli che non ci stanno: dal menu della tile
+        RECT more = cells.back();
+        InflateRect(&more, -4, -2);
+        const std::wstring label = L"+" + std::to_wstring(t.files.size() - cells.size());
+        DrawTextW(hdc, label.c_str(), -1, &more, DT_RIGHT | DT_BOTTOM | DT_SINGLELINE | DT_NOPREFIX);
+    }
+    SelectObject(hdc, oldFont);
+}
+
+// pronti dal thread delle miniature: nella tile (se c'e' ancora), poi layout e salvataggio
+void ApplyAttachments() {
+    std::vector<std::pair<uint64_t, Attachment>> done;
+    {
+        std::lock_guard<std::mutex> lock(g_attachMutex);
+        done.swap(g_attachDone);
+    }
+    bool changed = false;
+    for (auto& [id, a] : done) {
+        g_thumbs.Forget(a.hash); // se prima mancava, adesso c'e'
+        const int idx = FindTileIndexById(id);
+        if (idx < 0) continue; // tile eliminata nel frattempo: il blob se ne va con la pulizia
+        std::vector<Attachment>& files = g_state.tiles[idx].files;
+        if (std::any_of(files.begin(), files.end(), [&](const Attachment& f) { return f.hash == a.hash; })) continue;
+        files.push_back(std::move(a));
+        changed = true;
+    }
+    if (!changed) return;
+    LayoutTiles();
+    InvalidateRect(g_board, nullptr, FALSE);
+    g_layoutDirty = true;
+    ScheduleSave();
+}
+
+// dal thread delle miniature
+void FinishAttachment(uint64_t tileId, Attachment a) {
+    {
+        std::lock_guard<std::mutex> lock(g_attachMutex);
+        g_attachDone.emplace_back(tileId, std::move(a));
+    }
+    PostMessageW(g_mainWnd, kMsgAttachDone, 0, 0);
+}
+
+// Copia nello store sul thread delle miniature: un file di gigabyte non ferma la finestra.
+// Per le immagini bastano le misure dall'intestazione, la miniatura si fa quando serve.
+void AttachFilesToTile(uint64_t tileId, std::vector<std::wstring> paths) {
+    if (paths.empty()) return;
+    g_thumbs.Post([tileId, paths = std::move(paths)] {
+        for (const std::wstring& p : paths) {
+            const std::filesystem::path path(p);
+            Attachment a;
+            a.hash = g_blobs.PutFile(path, &a.size);
+            if (a.hash.empty()) continue; // cartelle, file spariti o non leggibili
+            a.name = WideToUtf8(path.filename().wstring());
+            MappedFile blob;
+            if (blob.Open(g_blobs.PathOf(a.hash)) &&
+                !ImageSize(std::string_view(reinterpret_cast<const char*>(blob.Data()), blob.Size()), a.width, a.height)) {
+                a.width = a.height = 0;
+            }
+            FinishAttachment(tileId, std::move(a));
+        }
+    });
+}
+
+// Immagine (CF_DIB) o file copiati (CF_HDROP) negli appunti, se non c'e' anche del testo:
+// in quel caso l'incolla resta alla EDIT. False se non c'era niente da allegare.
+bool AttachFromClipboard(uint64_t tileId) {
+    if (IsClipboardFormatAvailable(CF_UNICODETEXT)) return false;
+    if (!IsClipboardFormatAvailable(CF_DIB) && !IsClipboardFormatAvailable(CF_HDROP)) return false;
+    if (!OpenClipboard(g_mainWnd)) return false;
+
+    std::string dib;
+    std::vector<std::wstring> paths;
+    if (HANDLE h = GetClipboardData(CF_HDROP)) {
+        const HDROP drop = static_cast<HDROP>(h);
+        const UINT n = DragQueryFileW(drop, 0xFFFFFFFF, nullptr, 0);
+        for (UINT i = 0; i < n; ++i) {
+            std::wstring path(DragQueryFileW(drop, i, nullptr, 0), L'\0');
+            DragQueryFileW(drop, i, path.data(), static_cast<UINT>(path.size() + 1));
+            paths.push_back(std::move(path));
+        }
+    } else if (HANDLE h = GetClipboardData(CF_DIB)) {
+        if (const void* p = GlobalLock(h)) {
+            dib.assign(static_cast<const char*>(p), GlobalSize(h));
+            GlobalUnlock(h);
+        }
+    }
+    CloseClipboard();
+
+    if (!paths.empty()) {
+        AttachFilesToTile(tileId, std::move(paths));
+        return true;
+    }
+    if (dib.empty()) return false;
+
+    const std::time_t now = std::time(nullptr);
+    wchar_t stamp[32]{};
+    wcsftime(stamp, 32, L"%Y%m%d-%H%M%S", std::localtime(&now));
+    g_thumbs.Post([tileId, dib = std::move(dib), name = WideToUtf8(std::wstring(L"immagine-") + stamp + L".png")] {
+        Image image;
+        if (!DecodeDib(dib, image)) return;
+        const std::string png = EncodePng(image);
+        Attachment a;
+        a.hash = g_blobs.Put(png);
+        if (a.hash.empty()) return;
+        a.name = name;
+        a.size = png.size();
+        a.width = image.width;
+        a.height = image.height;
+        FinishAttachment(tileId, std::move(a));
+    });
+    return true;
+}
+
+void AttachFileDialog(int idx) {
+    std::vector<wchar_t> buffer(32 * 1024, L'\0');
+    OPENFILENAMEW ofn{};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = g_mainWnd;
+    ofn.lpstrFilter = L"Tutti i file\0*.*\0Immagini\0*.png;*.bmp\0";
+    ofn.lpstrFile = buffer.data();
+    ofn.nMaxFile = static_cast<DWORD>(buffer.size());
+    ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST | OFN_ALLOWMULTISELECT | OFN_EXPLORER;
+    if (!GetOpenFileNameW(&ofn)) return;
+
+    // un file: il percorso intero; piu' file: la cartella e poi i nomi, separati da \0
+    std::vector<std::wstring> parts;
+    for (const wchar_t* p = buffer.data(); *p; p += wcslen(p) + 1) parts.emplace_back(p);
+    std::vector<std::wstring> paths;
+    if (parts.size() == 1) paths = std::move(parts);
+    for (size_t i = 1; i < parts.size(); ++i) paths.push_back((std::filesystem::path(parts[0]) / parts[i]).wstring());
+    AttachFilesToTile(g_state.tiles[idx].id, std::move(paths));
+}
+
+// Il blob non ha estensione: si apre una copia col nome originale sotto %TEMP%\GridNotes,
+// fatta una volta per contenuto, col programma associato
+void OpenAttachment(const Attachment& a) {
+    std::error_code ec;
+    const std::filesystem::path blob = g_blobs.PathOf(a.hash);
+    if (!std::filesystem::is_regular_file(blob, ec)) {
+        MessageBoxW(g_mainWnd, (L"\"" + Utf8ToWide(a.name) + L"\" non e' su questo dispositivo.").c_str(), kAppName, MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+    std::wstring name = std::filesystem::path(Utf8ToWide(a.name)).filename().wstring();
+    for (wchar_t& c : name) {
+        if (c < 32 || wcschr(L"<>:\"/\\|?*", c)) c = L'_';
+    }
+    if (name.empty()) name = Utf8ToWide(a.hash);
+
+    wchar_t temp[MAX_PATH]{};
+    GetTempPathW(MAX_PATH, temp);
+    const std::filesystem::path dir = std::filesystem::path(temp) / L"GridNotes" / Utf8ToWide(a.hash.substr(0, 12));
+    const std::filesystem::path copy = dir / name;
+    std::filesystem::create_directories(dir, ec);
+    if (!std::filesystem::exists(copy, ec)) std::filesystem::copy_file(blob, copy, ec);
+    ShellExecuteW(g_mainWnd, L"open", copy.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
+}
+
+void RemoveAttachment(int idx, size_t i) {
+    Tile& t = g_state.tiles[idx];
+    if (i >= t.files.size()) return;
+    t.files.erase(t.files.begin() + static_cast<std::ptrdiff_t>(i)); // il blob resta finche' la pulizia non lo trova orfano
+    LayoutTiles();
+    InvalidateRect(g_board, nullptr, FALSE);
+    g_layoutDirty = true;
+    ScheduleSave();
+}
+
+// Blob e miniature che nessuna tile usa piu', poi il tetto delle miniature su disco:
+// l'elenco si fa qui, il giro delle cartelle sul thread delle miniature
+void PostAttachmentMaintenance() {
+    auto live = std::make_shared<std::unordered_set<std::string>>();
+    for (const auto& t : g_state.tiles) {
+        for (const Attachment& a : t.files) live->insert(a.hash);
+    }
+    g_thumbs.Post([live] {
+        g_blobs.Sweep(*live, kBlobGrace);
+        g_thumbs.TrimDisk(*live, kThumbDiskBytes);
+    });
+}
+
+// Store e miniature sotto %APPDATA%\GridNotes\blobs e \thumbs. All'avvio non si apre
+// nessun allegato: le miniature si fanno (o si rileggono) quando una tile entra in vista.
+void StartAttachments() {
+    const std::filesystem::path folder(GetStateFolder());
+    g_blobs.Open(folder / L"blobs");
+    g_thumbs.Open(&g_blobs, folder / L"thumbs", kThumbMemoryBytes, uint32_t{TILE_COLOR} * 0x010101);
+    g_thumbs.Start([] {
+        if (!g_thumbSignaled.exchange(true)) PostMessageW(g_mainWnd, kMsgThumbReady, 0, 0);
+    });
+}
+
+void MoveTileEdit(HDWP& hdwp, const Tile& t) {
+    const RECT r = EditRect(t);
+    hdwp = DeferWindowPos(hdwp, t.edit, nullptr, r.left, r.top, std::max(24, static_cast<int>(r.right - r.left)), std::max(24, static_cast<int>(r.bottom - r.top)),
+                          SWP_NOZORDER | SWP_NOACTIVATE | SWP_SHOWWINDOW); // nascoste durante lo zoom
+}
+
+// Solo le tile nella viewport hanno una EDIT: con migliaia di tile il costo di layout
+// e pan segue quello che si vede. Il testo di chi esce e' gia' in t.text (EN_CHANGE).
+void LayoutTiles() {
+    if (g_zooming) {
+        // gesto di zoom in corso: si muove solo la EDIT col focus, il resto e' disegnato da WM_PAINT
+        const int focused = FindTileIndexByEdit(GetFocus());
+        if (focused >= 0) {
+            HDWP hdwp = BeginDeferWindowPos(1);
+            if (hdwp) MoveTileEdit(hdwp, g_state.tiles[focused]);
+            if (hdwp) EndDeferWindowPos(hdwp);
+        }
+        InvalidateRect(g_board, nullptr, FALSE);
+        return;
+    }
+
+    std::vector<uint64_t> visible;
+    g_tileTree.Query(GetViewportCells(), visible);
+    const std::unordered_set<uint64_t> keep(visible.begin(), visible.end());
+
+    // 1) Via le EDIT uscite dalla viewport, tranne quella col focus (si sta scrivendo li')
+    const HWND focus = GetFocus();
+    for (auto it = g_liveEdits.begin(); it != g_liveEdits.end();) {
+        const int idx = FindTileIndexById(*it);
+        if (idx < 0 || !g_state.tiles[idx].edit) {
+            it = g_liveEdits.erase(it);
+            continue;
+        }
+        Tile& t = g_state.tiles[idx];
+        if (keep.count(t.id) || t.edit == focus) {
+            ++it;
+            continue;
+        }
+        DestroyWindow(t.edit);
+        t.edit = nullptr;
+        t.fontPx = 0;
+        g_formulaShown.erase(t.id);
+        g_markdown.erase(t.id);
+        DropSnapshot(t.id); // le istantanee vivono quanto la EDIT: la memoria segue la viewport
+        it = g_liveEdits.erase(it);
+    }
+
+    // 2) Crea le edit mancanti
+    for (uint64_t id : visible) {
+        const int idx = FindTileIndexById(id);
+        if (idx >= 0) EnsureTileEdit(g_state.tiles[idx]);
+    }
+
+    // 3) Batch delle posizioni
+    HDWP hdwp = BeginDeferWindowPos((int)g_liveEdits.size());
+    if (!hdwp) return; // fallimento raro, ma possibile
+
+    for (uint64_t id : g_liveEdits) {
+        MoveTileEdit(hdwp, g_state.tiles[FindTileIndexById(id)]);
+        if (!hdwp) return; // se DeferWindowPos fallisce, hdwp diventa NULL
+    }
+
+    EndDeferWindowPos(hdwp);
+    for (uint64_t id : g_liveEdits) ApplyTileFont(g_state.tiles[FindTileIndexById(id)]);
+
+    // 4) Invalida senza erase (importante per flicker)
+    InvalidateRect(g_board, nullptr, FALSE);
+}
+
+// Come LayoutTiles ma solo per le tile indicate (drag dei bordi): il costo segue
+// le tile toccate, non la dimensione della board. dirty: area da ridisegnare.
+void LayoutTileSubset(const std::vector<int>& indices, const RECT& dirty) {
+    // una tile spostata dentro la viewport ha bisogno della sua EDIT
+    const CellRect view = GetViewportCells();
+    for (int i : indices) {
+        const Tile& t = g_state.tiles[i];
+        if (!t.edit && t.x < view.x + view.w && view.x < t.x + t.w && t.y < view.y + view.h && view.y < t.y + t.h)
+            EnsureTileEdit(g_state.tiles[i]);
+    }
+
+    HDWP hdwp = BeginDeferWindowPos((int)indices.size());
+    if (!hdwp) return;
+
+    for (int i : indices) {
+        const Tile& t = g_state.tiles[i];
+        if (!t.edit) continue;
+        MoveTileEdit(hdwp, t);
+        if (!hdwp) return;
+    }
+    EndDeferWindowPos(hdwp);
+    for (int i : indices) ApplyTileFont(g_state.tiles[i]);
+
+    InvalidateRect(g_board, &dirty, FALSE);
+}
+
+// Sposta la viewport (px del mondo, mai negativi)
+void SetViewOrigin(int x, int y) {
+    const double limitX = std::min<double>(g_state.columns.Offset(kWorldCells) * g_state.zoom, INT_MAX / 2);
+    const double limitY = std::min<double>(g_state.rows.Offset(kWorldCells) * g_state.zoom, INT_MAX / 2);
+    x = std::clamp(x, 0, static_cast<int>(limitX));
+    y = std::clamp(y, 0, static_cast<int>(limitY));
+    if (x == g_state.viewX && y == g_state.viewY) return;
+    g_state.viewX = x;
+    g_state.viewY = y;
+    LayoutTiles();
+}
+
+// Copia di quello che la EDIT mostra ora, da scalare durante lo zoom
+void CaptureSnapshot(const Tile& t) {
+    RECT rc{};
+    if (!t.edit || !GetClientRect(t.edit, &rc)) return;
+    const int w = static_cast<int>(rc.right - rc.left);
+    const int h = static_cast<int>(rc.bottom - rc.top);
+    auto it = g_snapshots.find(t.id);
+    if (it != g_snapshots.end() && it->second.w == w && it->second.h == h) return;
+    DropSnapshot(t.id);
+    if (w <= 0 || h <= 0) return;
+
+    HDC screen = GetDC(g_board);
+    HDC mem = TrackedMemDc(MemArea::Paint, screen);
+    HBITMAP bmp = TrackedBitmap(MemArea::Snapshots, screen, w, h);
+    HGDIOBJ old = SelectObject(mem, bmp);
+    PrintWindow(t.edit, mem, PW_CLIENTONLY);
+    SelectObject(mem, old);
+    FreeMemDc(MemArea::Paint, mem);
+    ReleaseDC(g_board, screen);
+    g_snapshots[t.id] = TileSnapshot{bmp, w, h};
+}
+
+// Inizio del gesto: istantanee delle tile visibili (solo quelle cambiate dall'ultima
+// volta) e EDIT nascoste, cosi' ogni scatto costa un ridisegno e nessun layout.
+void BeginZoomGesture() {
+    const HWND focus = GetFocus();
+    HDWP hdwp = BeginDeferWindowPos((int)g_liveEdits.size());
+    for (uint64_t id : g_liveEdits) {
+        const Tile& t = g_state.tiles[FindTileIndexById(id)];
+        if (t.edit == focus) continue;
+        CaptureSnapshot(t);
+        if (hdwp) hdwp = DeferWindowPos(hdwp, t.edit, nullptr, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE | SWP_HIDEWINDOW);
+    }
+    if (hdwp) EndDeferWindowPos(hdwp);
+    g_zooming = true;
+}
+
+// Il gesto si e' fermato: un solo layout alla scala finale (posizioni, font, EDIT nuove)
+void EndZoomGesture() {
+    KillTimer(g_board, kTimerZoomSettle);
+    if (!g_zooming) return;
+    g_zooming = false;
+    LayoutTiles();
+}
+
+// Zoom attorno a un punto della board: la cella sotto il cursore resta ferma
+void ZoomAt(POINT ptBoard, double factor) {
+    const double zoom = std::clamp(g_state.zoom * factor, kMinZoom, kMaxZoom);
+    if (zoom == g_state.zoom) return;
+    if (!g_zooming) BeginZoomGesture();
+
+    // px a zoom 1 sotto il cursore: ogni px del mondo e' una posizione a zoom 1 per la scala
+    const double worldX = (g_state.viewX + ptBoard.x) / g_state.zoom;
+    const double worldY = (g_state.viewY + ptBoard.y) / g_state.zoom;
+    g_state.zoom = zoom;
+    const int x = static_cast<int>(std::lround(worldX * zoom)) - ptBoard.x;
+    const int y = static_cast<int>(std::lround(worldY * zoom)) - ptBoard.y;
+    SetViewOrigin(x, y);
+    LayoutTiles(); // anche se l'origine non cambia: la scala si'
+    SetTimer(g_board, kTimerZoomSettle, kZoomSettleMs, nullptr);
+}
+
+// Una traccia cambiata sposta in px tutte le tile dopo di lei, ma non le celle: gli
+// indici restano validi e basta rifare il layout della viewport.
+void ResizeTrack(bool column, int index, int px) {
+    TrackAxis& axis = column ? g_state.columns : g_state.rows;
+    const int before = axis.Size(index);
+    axis.SetSize(index, px);
+    if (axis.Size(index) == before) return;
+    DropAllSnapshots();
+    LayoutTiles();
+}
+
+void ResetTracks() {
+    if (g_state.columns.Overrides().empty() && g_state.rows.Overrides().empty()) return;
+    g_state.columns.Clear();
+    g_state.rows.Clear();
+    DropAllSnapshots();
+    g_layoutDirty = true;
+    LayoutTiles();
+    SaveState();
+}
+
+// Il minimo pan che porta la tile nella viewport (se ci sta, tutta)
+void RevealTile(int idx) {
+    RECT rc{};
+    GetClientRect(g_board, &rc);
+    const Tile& t = g_state.tiles[idx];
+    auto axis = [](int view, int extent, int lo, int hi) {
+        if (lo < view || hi - lo > extent) return lo;
+        if (hi > view + extent) return hi - extent;
+        return view;
+    };
+    SetViewOrigin(axis(g_state.viewX, rc.right - rc.left, ToPxX(t.x), ToPxX(t.x + t.w)),
+                  axis(g_state.viewY, rc.bottom - rc.top, ToPxY(t.y), ToPxY(t.y + t.h)));
+}
+
+// Applica a g_state e agli indici gli spostamenti di MoveTileToward / scambio (per ogni
+// tile conta l'ultimo) e riposiziona solo le EDIT toccate.
+void ApplyTileMoves(const TileMoves& moves) {
+    std::unordered_set<uint64_t> done;
+    std::vector<int> touched;
+    RECT dirty{LONG_MAX, LONG_MAX, LONG_MIN, LONG_MIN};
+    auto grow = [&](const CellRect& r) {
+        dirty.left = std::min<LONG>(dirty.left, ScreenX(r.x));
+        dirty.top = std::min<LONG>(dirty.top, ScreenY(r.y));
+        dirty.right = std::max<LONG>(dirty.right, ScreenX(r.x + r.w) + 1);
+        dirty.bottom = std::max<LONG>(dirty.bottom, ScreenY(r.y + r.h) + 1);
+    };
+
+    for (auto it = moves.rbegin(); it != moves.rend(); ++it) {
+        if (!done.insert(it->first).second) continue;
+        const int idx = FindTileIndexById(it->first);
+        if (idx < 0) continue;
+
+        Tile& t = g_state.tiles[idx];
+        const CellRect before = TileRect(t);
+        t.x = it->second.x;
+        t.y = it->second.y;
+        t.w = it->second.w;
+        t.h = it->second.h;
+        IndexTileMoved(before, t);
+        touched.push_back(idx);
+        grow(before);
+        grow(it->second);
+    }
+    if (!touched.empty()) LayoutTileSubset(touched, dirty);
+}
+
+int HitTestTile(POINT ptBoard, DragEdge* edge = nullptr) {
+    constexpr int margin = kResizeHandlePx;
+    const POINT world = BoardToWorld(ptBoard);
+    if (world.x < 0 || world.y < 0) return -1;
+
+    // la cella sotto il punto; a parita' (layout non ancora riparato) vince l'indice piu' alto
+    std::vector<uint64_t> hits;
+    g_tileTree.Query(CellRect{PxToColumn(world.x), PxToRow(world.y), 1, 1}, hits);
+    int i = -1;
+    for (uint64_t id : hits) i = std::max(i, FindTileIndexById(id));
+    if (i < 0) return -1;
+
+    if (edge) {
+        const RECT r = ScreenRect(TileRect(g_state.tiles[i]));
+        *edge = DragEdge::None;
+        if (ptBoard.x - r.left <= margin) *edge = DragEdge::Left;
+        else if (r.right - ptBoard.x <= margin) *edge = DragEdge::Right;
+        else if (ptBoard.y - r.top <= margin) *edge = DragEdge::Top;
+        else if (r.bottom - ptBoard.y <= margin) *edge = DragEdge::Bottom;
+    }
+    return i;
+}
+
+bool Split2(int idx, bool vertical) {
+    if (idx < 0 || idx >= static_cast<int>(g_state.tiles.size())) return false;
+
+    Tile t = g_state.tiles[idx];
+    HWND removedEdit = g_state.tiles[idx].edit;
+    if (vertical && t.w < 2) return false;
+    if (!vertical && t.h < 2) return false;
+
+    if (removedEdit) DestroyWindow(removedEdit);
+    IndexTileRemoved(t);
+    g_state.tiles.erase(g_state.tiles.begin() + idx);
+
+    if (vertical) {
+        int w1 = t.w / 2;
+        g_state.tiles.push_back(Tile{t.x, t.y, w1, t.h, t.text, nullptr, t.id, t.autoFit});
+        g_state.tiles.push_back(Tile{t.x + w1, t.y, t.w - w1, t.h, L"", nullptr, NewTileId()});
+    } else {
+        int h1 = t.h / 2;
+        g_state.tiles.push_back(Tile{t.x, t.y, t.w, h1, t.text, nullptr, t.id, t.autoFit});
+        g_state.tiles.push_back(Tile{t.x, t.y + h1, t.w, t.h - h1, L"", nullptr, NewTileId()});
+    }
+    g_state.tiles[g_state.tiles.size() - 2].scroll = t.scroll; // il testo lungo resta nella sua vista
+    g_state.tiles[g_state.tiles.size() - 2].files = t.files;
+    IndexTileAdded(g_state.tiles[g_state.tiles.size() - 2]);
+    IndexTileAdded(g_state.tiles.back());
+
+    DestroyTileWindows();
+    CommitLayoutChange();
+    return true;
+}
+
+bool Split4(int idx) {
+    if (idx < 0 || idx >= static_cast<int>(g_state.tiles.size())) return false;
+
+    Tile t = g_state.tiles[idx];
+    HWND removedEdit = g_state.tiles[idx].edit;
+    if (t.w < 2 || t.h < 2) return false;
+
+    int w1 = t.w / 2;
+    int h1 = t.h / 2;
+
+    if (removedEdit) DestroyWindow(removedEdit);
+    IndexTileRemoved(t);
+    g_state.tiles.erase(g_state.tiles.begin() + idx);
+    g_state.tiles.push_back(Tile{t.x, t.y, w1, h1, t.text, nullptr, t.id, t.autoFit});
+    g_state.tiles.push_back(Tile{t.x + w1, t.y, t.w - w1, h1, L"", nullptr, NewTileId()});
+    g_state.tiles.push_back(Tile{t.x, t.y + h1, w1, t.h - h1, L"", nullptr, NewTileId()});
+    g_state.tiles.push_back(Tile{t.x + w1, t.y + h1, t.w - w1, t.h - h1, L"", nullptr, NewTileId()});
+    g_state.tiles[g_state.tiles.size() - 4].scroll = t.scroll;
+    g_state.tiles[g_state.tiles.size() - 4].files = t.files;
+    for (size_t i = g_state.tiles.size() - 4; i < g_state.tiles.size(); ++i) IndexTileAdded(g_state.tiles[i]);
+
+    DestroyTileWindows();
+    CommitLayoutChange();
+    return true;
+}
+
+// Campione dei contatori: le aree che nessun wrapper conta si misurano adesso, i totali
+// del processo li da' il sistema (cosi' si vede anche quello che i wrapper non vedono)
+MemSample SampleMemory() {
+    const size_t inlineChars = std::wstring().capacity(); // fin qui il testo sta dentro la stringa
+    int64_t textBytes = 0;
+    for (const auto& t : g_state.tiles) {
+        if (t.text.capacity() > inlineChars) textBytes += static_cast<int64_t>((t.text.capacity() + 1) * sizeof(wchar_t));
+    }
+    MemItems(MemArea::Tiles, static_cast<int64_t>(g_state.tiles.size()));
+    MemSet(MemArea::TileText, textBytes, static_cast<int64_t>(g_state.tiles.size()));
+
+    int64_t editBytes = 0; // copia del testo nell'heap della EDIT
+    for (uint64_t id : g_liveEdits) {
+        const int idx = FindTileIndexById(id);
+        if (idx < 0 || !g_state.tiles[idx].edit) continue;
+        if (const ScrollEdit* se = GetScrollEdit(g_state.tiles[idx].edit)) editBytes += static_cast<int64_t>(se->view.MemoryBytes()); // testo, indice e a capo
+        else editBytes += static_cast<int64_t>((GetWindowTextLengthW(g_state.tiles[idx].edit) + 1) * sizeof(wchar_t));
+    }
+    MemSet(MemArea::Edits, editBytes, static_cast<int64_t>(g_liveEdits.size()));
+    MemItems(MemArea::Fonts, static_cast<int64_t>(g_fontsByPx.size() + g_mdFonts.size()) + (g_bigFont ? 1 : 0));
+
+    int64_t snapshotBytes = 0;
+    for (const auto& [id, snap] : g_snapshots) snapshotBytes += static_cast<int64_t>(snap.w) * snap.h * 4; // 32 bpp
+    MemSet(MemArea::Snapshots, snapshotBytes, static_cast<int64_t>(g_snapshots.size()));
+
+    int64_t markdownBytes = 0;
+    for (const auto& [id, doc] : g_markdown) {
+        markdownBytes += static_cast<int64_t>(doc.Text().capacity() * sizeof(wchar_t) + doc.BlockCount() * sizeof(MdBlock));
+    }
+    MemSet(MemArea::Markdown, markdownBytes, static_cast<int64_t>(g_markdown.size()));
+    const ThumbStats thumbs = g_thumbs.Stats();
+    MemSet(MemArea::Thumbs, static_cast<int64_t>(thumbs.bytes), static_cast<int64_t>(thumbs.items));
+
+    MemSample s = MemCapture(NowMs());
+    PROCESS_MEMORY_COUNTERS_EX pmc{};
+    pmc.cb = sizeof(pmc);
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc))) {
+        s.processBytes = static_cast<int64_t>(pmc.PrivateUsage);
+    }
+    s.gdiHandles = GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS);
+    s.userHandles = GetGuiResources(GetCurrentProcess(), GR_USEROBJECTS);
+    return s;
+}
+
+void RecordMemSample() {
+    const MemSample s = SampleMemory();
+    g_memTrend.Add(s);
+    if (g_memLog) {
+        std::ofstream log(std::filesystem::path(GetStateFolder()) / L"memstats.jsonl", std::ios::binary | std::ios::app);
+        log << MemSampleJson(s) << "\n";
+    }
+    if (g_memOverlay && g_board) InvalidateRect(g_board, nullptr, FALSE);
+}
+
+void SetMemOverlay(bool on) {
+    g_memOverlay = on;
+    if (on) RecordMemSample(); // subito numeri freschi, non quelli di 10 s fa
+    if (g_board) InvalidateRect(g_board, nullptr, FALSE);
+}
+
+std::filesystem::path SpellDictionaryFolder() { return std::filesystem::path(GetStateFolder()) / L"dictionaries"; }
+
+// Testi cambiati -> thread del controllo. Una copia per tile e per raffica di tasti: il
+// tratto cambiato lo trova il thread, qui non si misura niente.
+void FlushSpellTexts() {
+    KillTimer(g_mainWnd, kTimerSpell);
+    for (uint64_t id : g_spellTexts) {
+        const int idx = FindTileIndexById(id);
+        if (idx < 0) continue;
+        const Tile& t = g_state.tiles[idx];
+        if (SpellChecksTile(t)) g_spell.Update(id, std::u16string(AsUtf16(t.text)));
+        else g_spell.Remove(id); // diventata tail o formula
+    }
+    g_spellTexts.clear();
+}
+
+// Thread e dizionari (compilati la prima volta, poi mappati), poi tutte le tile
+void StartSpellCheck() {
+    std::error_code ec;
+    std::filesystem::create_directories(SpellDictionaryFolder(), ec);
+    g_spell.Start([](uint64_t id) { PostMessageW(g_mainWnd, kMsgSpellReady, static_cast<WPARAM>(id), 0); });
+    g_spell.LoadDictionaries(SpellDictionaryFolder());
+    for (const auto& t : g_state.tiles) g_spellTexts.insert(t.id);
+    FlushSpellTexts();
+}
+
+void SetSpellCheck(bool on) {
+    if (g_state.spellCheck == on) return;
+    g_state.spellCheck = on;
+    if (on) {
+        StartSpellCheck();
+        std::error_code ec;
+        if (std::filesystem::is_empty(SpellDictionaryFolder(), ec)) {
+            const std::wstring msg = L"Nessun dizionario: copia in\n" + SpellDictionaryFolder().wstring() +
+                                     L"\nun elenco di parole (.dic o .txt, una per riga) e riattiva il controllo.";
+            MessageBoxW(g_mainWnd, msg.c_str(), L"Controllo ortografico", MB_ICONINFORMATION);
+        }
+    } else {
+        KillTimer(g_mainWnd, kTimerSpell);
+        g_spellTexts.clear();
+        g_spell.Clear();
+    }
+    for (const auto& t : g_state.tiles) {
+        if (t.edit) InvalidateRect(t.edit, nullptr, TRUE);
+    }
+    SaveState();
+}
+
+// Ultimo campione in basso a sinistra della board: processo, poi le aree non vuote
+void PaintMemOverlay(HDC hdc, const RECT& client) {
+    const MemSample* s = g_memTrend.Last();
+    if (!s) return;
+    std::wstring text = L"processo: " + std::to_wstring(s->processBytes / 1024) + L" KB privati, " + std::to_wstring(s->gdiHandles) +
+                        L" GDI, " + std::to_wstring(s->userHandles) + L" USER";
+    for (size_t i = 0; i < kMemAreaCount; ++i) {
+        const MemAreaStats& a = s->areas[i];
+        if (!a.bytes && !a.handles && !a.items && !a.live) continue;
+        text += L"\n" + Utf8ToWide(MemAreaName(static_cast<MemArea>(i))) + L": " + std::to_wstring(a.bytes / 1024) + L" KB, " +
+                std::to_wstring(a.handles) + L" handle, " + std::to_wstring(a.items) + L" oggetti, " + std::to_wstring(a.allocs) + L" allocazioni";
+    }
+    std::wstring suspects;
+    for (const std::string& name : g_memTrend.Suspects()) suspects += (suspects.empty() ? L"" : L", ") + Utf8ToWide(name);
+    if (!suspects.empty()) text += L"\nin crescita: " + suspects;
+
+    HGDIOBJ oldFont = SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+    RECT r{0, 0, 0, 0};
+    DrawTextW(hdc, text.c_str(), -1, &r, DT_CALCRECT | DT_NOPREFIX);
+    const int w = static_cast<int>(r.right - r.left);
+    const int h = static_cast<int>(r.bottom - r.top);
+    RECT box{client.left + 8, client.bottom - h - 20, client.left + w + 20, client.bottom - 8};
+    FillRect(hdc, &box, g_editBgBrush);
+    InflateRect(&box, -6, -6);
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, suspects.empty() ? RGB(200, 200, 200) : RGB(240, 170, 60));
+    DrawTextW(hdc, text.c_str(), -1, &box, DT_NOPREFIX);
+    SelectObject(hdc, oldFont);
+}
+
+std::string TileJsonFields(const Tile& t) {
+    return "\"tile\":" + std::to_string(t.id) + ",\"x\":" + std::to_string(t.x) + ",\"y\":" + std::to_string(t.y) +
+           ",\"w\":" + std::to_string(t.w) + ",\"h\":" + std::to_string(t.h);
+}
+
+std::string HandleIpcCommand(const IpcCommand& c) {
+    if (!c.error.empty()) return IpcErrorReply(c.reqId, c.error);
+
+    switch (c.op) {
+        case IpcOp::List: {
+            std::string items;
+            for (const auto& t : g_state.tiles) {
+                if (!items.empty()) items += ",";
+                items += "{" + TileJsonFields(t) + "}";
             }
-           SetWindowLongPtrW(t.edit, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(EditProc));
+            return IpcOkReply(c.reqId, "\"tiles\":[" + items + "]");
+        }
+        case IpcOp::Get: {
+            const int idx = FindTileIndexById(c.tile);
+            if (idx < 0) return IpcErrorReply(c.reqId, "unknown tile");
+            const Tile& t = g_state.tiles[idx];
+            return IpcOkReply(c.reqId, TileJsonFields(t) + ",\"text\":" + JsonQuoteUtf8(WideToUtf8(t.text)));
+        }
+        case IpcOp::Set: {
+            const int idx = FindTileIndexById(c.tile);
+            if (idx < 0) return IpcErrorReply(c.reqId, "unknown tile");
+            Tile& t = g_state.tiles[idx];
+            const std::wstring text = Utf8ToWide(c.text);
+            if (t.text == text) return IpcOkReply(c.reqId);
+            // stesse regole dell'editing da tastiera: il testo deve stare nella tile
+            if (!FitTextToTile(t, text)) return IpcErrorReply(c.reqId, "text does not fit");
+
+            t.text = text;
+            if (t.edit) {
+                g_internalTextSet = true;
+                SetWindowTextW(t.edit, t.text.c_str());
+                g_internalTextSet = false;
+            }
+            OnTileTextChanged(t);
+            return IpcOkReply(c.reqId);
+        }
+        case IpcOp::Split: {
+            const int idx = FindTileIndexById(c.tile);
+            if (idx < 0) return IpcErrorReply(c.reqId, "unknown tile");
+            bool done = false;
+            int created = 2;
+            if (c.mode == "h") done = Split2(idx, false);
+            else if (c.mode == "v") done = Split2(idx, true);
+            else if (c.mode == "4") { done = Split4(idx); created = 4; }
+            else return IpcErrorReply(c.reqId, "mode must be h, v or 4");
+            if (!done) return IpcErrorReply(c.reqId, "tile too small");
+
+            std::string ids;
+            for (size_t i = g_state.tiles.size() - created; i < g_state.tiles.size(); ++i) {
+                if (!ids.empty()) ids += ",";
+                ids += std::to_string(g_state.tiles[i].id);
+            }
+            return IpcOkReply(c.reqId, "\"tiles\":[" + ids + "]");
+        }
+        case IpcOp::Subscribe:
+            g_ipc.Subscribe(c.client);
+            return IpcOkReply(c.reqId);
+        case IpcOp::Stats: {
+            // "log"/"off": campioni periodici in memstats.jsonl, per le prove di durata
+            if (c.mode == "log") g_memLog = true;
+            else if (c.mode == "off") g_memLog = false;
+            else if (!c.mode.empty()) return IpcErrorReply(c.reqId, "mode must be log or off");
+            std::string suspects;
+            for (const std::string& name : g_memTrend.Suspects()) suspects += (suspects.empty() ? "" : ",") + JsonQuoteUtf8(name);
+            return IpcOkReply(c.reqId, "\"sample\":" + MemSampleJson(SampleMemory()) + ",\"suspects\":[" + suspects + "],\"samples\":" +
+                                           std::to_string(g_memTrend.Size()) + ",\"logging\":" + (g_memLog ? "true" : "false"));
+        }
+        case IpcOp::Activate:
+            // seconda istanza avviata: si porta in primo piano questa
+            if (IsIconic(g_mainWnd)) ShowWindow(g_mainWnd, SW_RESTORE);
+            ShowWindow(g_mainWnd, SW_SHOW);
+            SetForegroundWindow(g_mainWnd);
+            return IpcOkReply(c.reqId);
+        case IpcOp::Unknown:
+            break;
+    }
+    return IpcErrorReply(c.reqId, "unknown command");
+}
 
-LOGFONT lf;
-GetObject(GetStockObject(DEFAULT_GUI_FONT), sizeof(lf), &lf);
-lf.lfHeight *= 1.6; // font doppio
+// Tutti i comandi arrivati dall'ultimo giro del message loop, applicati in un colpo solo.
+void ProcessIpcBatch() {
+    std::vector<IpcCommand> batch = g_ipc.TakeBatch();
+    if (batch.empty()) return;
 
-HFONT bigFont = CreateFontIndirect(&lf);
+    g_layoutBatch = true;
+    for (const auto& c : batch) g_ipc.Reply(c.client, HandleIpcCommand(c));
+    g_layoutBatch = false;
 
-SendMessageW(t.edit, WM_SETFONT, (WPARAM)bigFont, TRUE);
-        }
+    if (g_layoutPending) {
+        g_layoutPending = false;
+        CommitLayoutChange();
+    }
+}
 
-        const int inset = kEditPadding + (g_state.editLayout ? kResizeHandlePx : 0);
-        MoveWindow(
-            t.edit,
-            ToPx(t.x) + inset,
-            ToPx(t.y) + inset,
-            std::max(24, ToPx(t.w) - 2 * inset),
-            std::max(24, ToPx(t.h) - 2 * inset),
-            TRUE);
+// Cronologia (history.h). Sul thread UI si copia solo cio' che serve: geometria di
+// tutte le tile e testo di quelle cambiate; hash e scritture girano sul thread della cronologia.
+void TakeHistorySnapshot() {
+    HistorySnapshot snap;
+    snap.time = static_cast<int64_t>(std::time(nullptr));
+    snap.columns = g_state.columns.Overrides();
+    snap.rows = g_state.rows.Overrides();
+    snap.tiles.reserve(g_state.tiles.size());
+    std::unordered_map<uint64_t, std::string> texts;
+    for (const auto& t : g_state.tiles) {
+        snap.tiles.push_back(HistoryTile{t.id, t.x, t.y, t.w, t.h, t.autoFit, {}});
+        if (g_historyTexts.count(t.id)) texts[t.id] = WideToUtf8(t.text);
+    }
+    g_historyTexts.clear();
+    auto job = std::make_shared<std::pair<HistorySnapshot, std::unordered_map<uint64_t, std::string>>>(std::move(snap), std::move(texts));
+    g_history.Post([job](History& h) { h.Take(std::move(job->first), job->second); });
 }
 
-    InvalidateRect(g_board, nullptr, TRUE);
-}*/
-//old, without batching ^^^^
+void PostHistoryMaintenance() {
+    g_history.Post([](History& h) {
+        h.Prune(static_cast<int64_t>(std::time(nullptr)));
+        h.CollectGarbage();
+    });
+}
 
+void StartHistory() {
+    if (!g_history.Open(std::filesystem::path(GetStateFolder()) / L"history")) return;
+    for (const auto& t : g_state.tiles) g_historyTexts.insert(t.id); // la prima istantanea li vede tutti
+    g_history.Start();
+    PostHistoryMaintenance();
+    SetTimer(g_mainWnd, kTimerSnapshot, kSnapshotIntervalMs, nullptr);
+}
 
-void LayoutTiles() {
-    // 1) Crea le edit mancanti (come fai ora)
-    for (auto& t : g_state.tiles) {
-        if (!t.edit) {
-            t.edit = CreateWindowExW(
-                0, L"EDIT", t.text.c_str(),
-                WS_CHILD | WS_VISIBLE | ES_LEFT | ES_MULTILINE | ES_WANTRETURN,
-                0, 0, 10, 10,
-                g_board, nullptr, GetModuleHandleW(nullptr), nullptr);
+// Testi salvati -> indice: ogni versione salvata di una tile diventa cercabile (quelle
+// gia' viste si riconoscono dall'hash e non si rileggono). Le tile che seguono un file non
+// ci vanno: cambiano di continuo e il file e' gia' su disco.
+void IndexSavedTexts() {
+    if (!g_indexStarted || g_indexTexts.empty()) return;
+    auto texts = std::make_shared<std::vector<std::pair<uint64_t, std::string>>>();
+    for (uint64_t id : g_indexTexts) {
+        const int idx = FindTileIndexById(id);
+        if (idx >= 0 && g_state.tiles[idx].tailPath.empty()) texts->emplace_back(id, WideToUtf8(g_state.tiles[idx].text));
+    }
+    g_indexTexts.clear();
+    const int64_t now = static_cast<int64_t>(std::time(nullptr));
+    g_index.Post([texts, now](SearchIndex& ix) {
+        for (const auto& [id, text] : *texts) ix.Add(id, now, text);
+    });
+}
 
-            if (!g_defaultEditProc) {
-                g_defaultEditProc = reinterpret_cast<WNDPROC>(
-                    GetWindowLongPtrW(t.edit, GWLP_WNDPROC));
+// Indice sotto %APPDATA%\\GridNotes\\index, aperto sul suo thread (con gigabyte di note
+// mappare i segmenti e rileggere le versioni note costa un centinaio di ms). Poi le
+// istantanee che l'indice non ha ancora visto (la prima volta tutta la cronologia), una
+// alla volta: se si chiude prima, si riprende dalla prossima al prossimo avvio.
+void StartSearchIndex() {
+    g_index.Start();
+    g_indexStarted = true;
+    g_index.Post([folder = std::filesystem::path(GetStateFolder()) / L"index"](SearchIndex& ix) {
+        if (!ix.Open(folder)) return;
+        HistorySnapshot snap;
+        std::string text;
+        for (int64_t time : g_history.List()) {
+            if (ix.Stopping()) return;
+            if (time <= ix.HistoryTime() || !g_history.Load(time, snap)) continue;
+            for (const HistoryTile& t : snap.tiles) {
+                if (!ix.Contains(t.id, t.textHash) && g_history.Text(t.textHash, text)) ix.Add(t.id, time, text, t.textHash);
             }
-            SetWindowLongPtrW(t.edit, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(EditProc));
+            ix.SetHistoryTime(time);
+        }
+    });
+    for (const auto& t : g_state.tiles) g_indexTexts.insert(t.id);
+    IndexSavedTexts();
+}
+
+const HistoryTile* FindHistoryTile(const HistorySnapshot& s, uint64_t id) {
+    auto it = std::lower_bound(s.tiles.begin(), s.tiles.end(), id, [](const HistoryTile& t, uint64_t v) { return t.id < v; });
+    return it != s.tiles.end() && it->id == id ? &*it : nullptr;
+}
 
-            SendMessageW(t.edit, WM_SETFONT, (WPARAM)g_bigFont, TRUE);
+bool HistoryText(const HistoryTile& h, std::wstring& text) {
+    std::string utf8;
+    if (!g_history.Text(h.textHash, utf8)) return false;
+    text = Utf8ToWide(utf8);
+    return true;
+}
+
+// Una tile come era nell'istantanea: testo sempre, posizione se il posto e' libero.
+// Se la tile non c'e' piu' torna con lo stesso id, sotto il contenuto se il suo posto e' preso.
+bool RestoreTileFromHistory(const HistoryTile& h) {
+    std::wstring text;
+    if (!HistoryText(h, text)) return false;
+
+    CellRect r{h.x, h.y, h.w, h.h};
+    std::vector<uint64_t> hits;
+    g_tileGrid.Query(r, h.id, hits);
+    int idx = FindTileIndexById(h.id);
+    if (idx < 0) {
+        if (!hits.empty()) {
+            r.y = 0;
+            for (const auto& t : g_state.tiles) r.y = std::max(r.y, t.y + t.h);
+        }
+        g_state.tiles.push_back(Tile{r.x, r.y, r.w, r.h, text, nullptr, h.id, h.autoFit});
+        IndexTileAdded(g_state.tiles.back());
+        g_dirtyTiles.insert(h.id);
+        NoteTextChanged(h.id);
+        CommitLayoutChange();
+    } else {
+        Tile& t = g_state.tiles[idx];
+        if (hits.empty() && (t.x != r.x || t.y != r.y || t.w != r.w || t.h != r.h || t.autoFit != h.autoFit)) {
+            const CellRect before = TileRect(t);
+            t.x = r.x;
+            t.y = r.y;
+            t.w = r.w;
+            t.h = r.h;
+            t.autoFit = h.autoFit;
+            g_fitLayouts.erase(t.id);
+            IndexTileMoved(before, t);
+            g_layoutDirty = true;
+        }
+        if (t.text != text) {
+            t.text = text;
+            if (t.edit) {
+                g_internalTextSet = true;
+                SetWindowTextW(t.edit, t.text.c_str());
+                g_internalTextSet = false;
+            }
+            OnTileTextChanged(t);
         }
+        if (g_layoutDirty) CommitLayoutChange();
     }
+    idx = FindTileIndexById(h.id);
+    if (idx >= 0) RevealTile(idx);
+    return true;
+}
 
-    // 2) Batch delle posizioni
-    HDWP hdwp = BeginDeferWindowPos((int)g_state.tiles.size());
-    if (!hdwp) return; // fallimento raro, ma possibile
+bool RestoreBoardFromHistory(const HistorySnapshot& s) {
+    // la cronologia non registra gli allegati: restano alle tile che ci sono ancora
+    std::unordered_map<uint64_t, std::vector<Attachment>> files;
+    for (const auto& t : g_state.tiles) {
+        if (!t.files.empty()) files[t.id] = t.files;
+    }
+    TileList tiles;
+    tiles.reserve(s.tiles.size());
+    for (const HistoryTile& h : s.tiles) {
+        std::wstring text;
+        if (!HistoryText(h, text)) return false; // meglio niente che una board a meta'
+        tiles.push_back(Tile{h.x, h.y, h.w, h.h, text, nullptr, h.id, h.autoFit});
+        auto it = files.find(h.id);
+        if (it != files.end()) tiles.back().files = std::move(it->second);
+    }
 
-    for (auto& t : g_state.tiles) {
-        const int inset = kEditPadding + (g_state.editLayout ? kResizeHandlePx : 0);
+    g_state.columns.Clear();
+    g_state.rows.Clear();
+    for (const auto& [index, px] : s.columns) g_state.columns.SetSize(index, px);
+    for (const auto& [index, px] : s.rows) g_state.rows.SetSize(index, px);
+    DropAllSnapshots();
+    ReplaceTiles(std::move(tiles));
+    for (const auto& t : g_state.tiles) g_dirtyTiles.insert(t.id);
+    g_layoutDirty = true;
+    SaveState();
+    return true;
+}
 
-        int x = ToPx(t.x) + inset;
-        int y = ToPx(t.y) + inset;
-        int w = std::max(24, ToPx(t.w) - 2 * inset);
-        int h = std::max(24, ToPx(t.h) - 2 * inset);
+// Finestra della cronologia: a sinistra l'istantanea di partenza, a destra quella
+// d'arrivo; in mezzo le tile cambiate tra le due, sotto il testo prima e dopo.
+// I ripristini prendono la versione di destra (o di sinistra se a destra la tile non c'e').
+struct HistoryView {
+    HWND wnd{};
+    HWND from{};
+    HWND to{};
+    HWND changes{};
+    HWND preview{};
+    std::vector<int64_t> times;
+    HistorySnapshot a;
+    HistorySnapshot b;
+    std::vector<HistoryChange> diff;
+};
+HistoryView g_historyView;
+constexpr int kHistFrom = 201;
+constexpr int kHistTo = 202;
+constexpr int kHistChanges = 203;
+constexpr int kHistRestoreTile = 204;
+constexpr int kHistRestoreBoard = 205;
+
+std::wstring SnapshotLabel(int64_t time) {
+    const std::time_t t = static_cast<std::time_t>(time);
+    wchar_t buf[64]{};
+    wcsftime(buf, 64, L"%Y-%m-%d %H:%M:%S", std::localtime(&t));
+    return buf;
+}
 
-        hdwp = DeferWindowPos(
-            hdwp,
-            t.edit,
-            nullptr,
-            x, y, w, h,
-            SWP_NOZORDER | SWP_NOACTIVATE
-        );
+// prima riga del testo, accorciata, per l'elenco
+std::wstring TextPreviewLine(const std::wstring& text) {
+    std::wstring line = text.substr(0, text.find_first_of(L"\r\n"));
+    if (line.size() > 40) line = line.substr(0, 40) + L"...";
+    return line;
+}
 
-        if (!hdwp) return; // se DeferWindowPos fallisce, hdwp diventa NULL
+std::wstring ForEdit(const std::wstring& text) {
+    std::wstring out;
+    out.reserve(text.size());
+    for (wchar_t c : text) {
+        if (c == L'\n') out += L'\r';
+        if (c != L'\r') out += c;
     }
+    return out;
+}
 
-    EndDeferWindowPos(hdwp);
+void RefreshHistoryDiff() {
+    HistoryView& v = g_historyView;
+    SendMessageW(v.changes, LB_RESETCONTENT, 0, 0);
+    SetWindowTextW(v.preview, L"");
+    v.diff.clear();
+    const int from = static_cast<int>(SendMessageW(v.from, LB_GETCURSEL, 0, 0));
+    const int to = static_cast<int>(SendMessageW(v.to, LB_GETCURSEL, 0, 0));
+    if (from < 0 || to < 0 || from >= static_cast<int>(v.times.size()) || to >= static_cast<int>(v.times.size())) return;
+    if (!g_history.Load(v.times[from], v.a) || !g_history.Load(v.times[to], v.b)) {
+        SendMessageW(v.changes, LB_ADDSTRING, 0, (LPARAM)L"istantanea illeggibile (chunk mancanti o rovinati)");
+        return;
+    }
 
-    // 3) Invalida senza erase (importante per flicker)
-    InvalidateRect(g_board, nullptr, FALSE);
+    v.diff = DiffSnapshots(v.a, v.b);
+    for (const HistoryChange& c : v.diff) {
+        const HistoryTile* h = c.removed ? FindHistoryTile(v.a, c.id) : FindHistoryTile(v.b, c.id);
+        std::wstring text;
+        if (h) HistoryText(*h, text);
+        std::wstring what = c.added ? L"aggiunta" : c.removed ? L"eliminata" : c.text && c.moved ? L"testo e posizione" : c.text ? L"testo" : L"posizione";
+        const std::wstring label = L"tile " + std::to_wstring(c.id) + L" - " + what + L": " + TextPreviewLine(text);
+        SendMessageW(v.changes, LB_ADDSTRING, 0, (LPARAM)label.c_str());
+    }
+    if (v.diff.empty()) SendMessageW(v.changes, LB_ADDSTRING, 0, (LPARAM)L"nessuna differenza");
 }
 
-int HitTestTile(POINT ptBoard, DragEdge* edge = nullptr) {
-    constexpr int margin = kResizeHandlePx;
-    for (int i = static_cast<int>(g_state.tiles.size()) - 1; i >= 0; --i) {
-        RECT r{ToPx(g_state.tiles[i].x), ToPx(g_state.tiles[i].y), ToPx(g_state.tiles[i].x + g_state.tiles[i].w), ToPx(g_state.tiles[i].y + g_state.tiles[i].h)};
-        if (!PtInRect(&r, ptBoard)) continue;
+const HistoryChange* SelectedHistoryChange() {
+    const int sel = static_cast<int>(SendMessageW(g_historyView.changes, LB_GETCURSEL, 0, 0));
+    return sel >= 0 && sel < static_cast<int>(g_historyView.diff.size()) ? &g_historyView.diff[sel] : nullptr;
+}
 
-        if (edge) {
-            *edge = DragEdge::None;
-            if (ptBoard.x - r.left <= margin) *edge = DragEdge::Left;
-            else if (r.right - ptBoard.x <= margin) *edge = DragEdge::Right;
-            else if (ptBoard.y - r.top <= margin) *edge = DragEdge::Top;
-            else if (r.bottom - ptBoard.y <= margin) *edge = DragEdge::Bottom;
-        }
+void ShowHistoryPreview() {
+    const HistoryChange* c = SelectedHistoryChange();
+    if (!c) return;
+    std::wstring before;
+    std::wstring after;
+    if (const HistoryTile* h = FindHistoryTile(g_historyView.a, c->id)) HistoryText(*h, before);
+    if (const HistoryTile* h = FindHistoryTile(g_historyView.b, c->id)) HistoryText(*h, after);
+    const std::wstring text = L"Prima:\n" + (c->added ? L"(non c'era)" : before) + L"\n\nDopo:\n" + (c->removed ? L"(eliminata)" : after);
+    SetWindowTextW(g_historyView.preview, ForEdit(text).c_str());
+}
+
+void LayoutHistoryWindow(int w, int h) {
+    const HistoryView& v = g_historyView;
+    const int pad = 8;
+    const int listW = 170;
+    const int buttonH = 26;
+    const int midX = pad * 2 + listW;
+    const int midW = std::max(100, w - 2 * midX);
+    const int listH = std::max(60, h - 2 * pad - buttonH - pad);
+    MoveWindow(v.from, pad, pad, listW, listH, TRUE);
+    MoveWindow(v.to, w - pad - listW, pad, listW, listH, TRUE);
+    MoveWindow(v.changes, midX, pad, midW, listH / 2, TRUE);
+    MoveWindow(v.preview, midX, pad * 2 + listH / 2, midW, listH - listH / 2 - pad, TRUE);
+    MoveWindow(GetDlgItem(v.wnd, kHistRestoreTile), midX, h - pad - buttonH, 150, buttonH, TRUE);
+    MoveWindow(GetDlgItem(v.wnd, kHistRestoreBoard), midX + 160, h - pad - buttonH, 150, buttonH, TRUE);
+}
+
+LRESULT CALLBACK HistoryProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    HistoryView& v = g_historyView;
+    switch (msg) {
+        case WM_CREATE: {
+            v.wnd = hwnd;
+            const HINSTANCE inst = GetModuleHandleW(nullptr);
+            const DWORD listStyle = WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_BORDER | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT;
+            v.from = CreateWindowW(L"LISTBOX", nullptr, listStyle, 0, 0, 0, 0, hwnd, (HMENU)kHistFrom, inst, nullptr);
+            v.to = CreateWindowW(L"LISTBOX", nullptr, listStyle, 0, 0, 0, 0, hwnd, (HMENU)kHistTo, inst, nullptr);
+            v.changes = CreateWindowW(L"LISTBOX", nullptr, listStyle | WS_HSCROLL, 0, 0, 0, 0, hwnd, (HMENU)kHistChanges, inst, nullptr);
+            v.preview = CreateWindowW(L"EDIT", nullptr, WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_BORDER | ES_MULTILINE | ES_READONLY, 0, 0, 0, 0, hwnd, nullptr, inst, nullptr);
+            CreateWindowW(L"BUTTON", L"Ripristina tile", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0, 0, hwnd, (HMENU)kHistRestoreTile, inst, nullptr);
+            CreateWindowW(L"BUTTON", L"Ripristina board", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0, 0, hwnd, (HMENU)kHistRestoreBoard, inst, nullptr);
+            for (HWND child = GetWindow(hwnd, GW_CHILD); child; child = GetWindow(child, GW_HWNDNEXT)) {
+                SendMessageW(child, WM_SETFONT, (WPARAM)GetStockObject(DEFAULT_GUI_FONT), FALSE);
+            }
 
-        return i;
+            v.times = g_history.List();
+            for (int64_t t : v.times) {
+                const std::wstring label = SnapshotLabel(t);
+                SendMessageW(v.from, LB_ADDSTRING, 0, (LPARAM)label.c_str());
+                SendMessageW(v.to, LB_ADDSTRING, 0, (LPARAM)label.c_str());
+            }
+            // di default: cosa e' cambiato con l'ultima istantanea
+            const int n = static_cast<int>(v.times.size());
+            SendMessageW(v.from, LB_SETCURSEL, std::max(0, n - 2), 0);
+            SendMessageW(v.to, LB_SETCURSEL, n - 1, 0);
+            RefreshHistoryDiff();
+            return 0;
+        }
+        case WM_SIZE:
+            LayoutHistoryWindow(LOWORD(lParam), HIWORD(lParam));
+            return 0;
+        case WM_COMMAND: {
+            const int id = LOWORD(wParam);
+            if ((id == kHistFrom || id == kHistTo) && HIWORD(wParam) == LBN_SELCHANGE) RefreshHistoryDiff();
+            if (id == kHistChanges && HIWORD(wParam) == LBN_SELCHANGE) ShowHistoryPreview();
+            if (id == kHistRestoreTile) {
+                const HistoryChange* c = SelectedHistoryChange();
+                const HistoryTile* h = c ? FindHistoryTile(v.b, c->id) : nullptr;
+                if (c && !h) h = FindHistoryTile(v.a, c->id);
+                if (h && !RestoreTileFromHistory(*h)) MessageBoxW(hwnd, L"Testo della tile non leggibile dalla cronologia.", kAppName, MB_OK | MB_ICONWARNING);
+            }
+            if (id == kHistRestoreBoard && !v.b.tiles.empty()) {
+                const std::wstring question = L"Sostituire la board con l'istantanea del " + SnapshotLabel(v.b.time) + L"?";
+                if (MessageBoxW(hwnd, question.c_str(), kAppName, MB_YESNO | MB_ICONQUESTION) == IDYES && !RestoreBoardFromHistory(v.b)) {
+                    MessageBoxW(hwnd, L"Istantanea non leggibile: la board non e' stata toccata.", kAppName, MB_OK | MB_ICONWARNING);
+                }
+            }
+            return 0;
+        }
+        case WM_DESTROY:
+            g_historyView = HistoryView{};
+            return 0;
     }
-    return -1;
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
 }
 
-void Split2(int idx, bool vertical) {
-    if (idx < 0 || idx >= static_cast<int>(g_state.tiles.size())) return;
+void ShowHistoryWindow() {
+    if (g_historyView.wnd) {
+        SetForegroundWindow(g_historyView.wnd);
+        return;
+    }
+    static bool registered = false;
+    if (!registered) {
+        WNDCLASSW wc{};
+        wc.lpfnWndProc = HistoryProc;
+        wc.hInstance = GetModuleHandleW(nullptr);
+        wc.lpszClassName = L"GridNotesHistory";
+        wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+        wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+        RegisterClassW(&wc);
+        registered = true;
+    }
+    CreateWindowExW(0, L"GridNotesHistory", L"Cronologia", WS_OVERLAPPEDWINDOW | WS_VISIBLE, CW_USEDEFAULT, CW_USEDEFAULT, 900, 560,
+                    g_mainWnd, nullptr, GetModuleHandleW(nullptr), nullptr);
+}
 
-    Tile t = g_state.tiles[idx];
-    HWND removedEdit = g_state.tiles[idx].edit;
-    if (vertical && t.w < 2) return;
-    if (!vertical && t.h < 2) return;
+// Ricerca su tutte le note, board e cronologia: si cerca a ogni tasto, un risultato per
+// tile col pezzo di testo che corrisponde. A destra il testo intero della versione trovata;
+// doppio clic o il pulsante portano alla tile, se c'e' ancora.
+struct SearchView {
+    HWND wnd{};
+    HWND query{};
+    HWND status{};
+    HWND results{};
+    HWND preview{};
+    std::vector<SearchHit> hits;
+};
+SearchView g_searchView;
+constexpr int kSearchQuery = 211;
+constexpr int kSearchResults = 212;
+constexpr int kSearchOpen = 213;
+constexpr size_t kSearchLimit = 50;
+
+// Testo della versione trovata: dalla board se e' ancora quella, se no dai chunk della
+// cronologia; se le istantanee che l'avevano sono state potate resta l'anteprima dell'indice.
+std::string SearchHitText(const SearchHit& h, bool& live) {
+    live = false;
+    const int idx = FindTileIndexById(h.tileId);
+    if (idx >= 0) {
+        std::string text = WideToUtf8(g_state.tiles[idx].text);
+        if (Sha256Hex(text) == h.hash) {
+            live = true;
+            return text;
+        }
+    }
+    std::string text;
+    return g_history.Text(h.hash, text) ? text : h.preview;
+}
 
-    if (removedEdit) DestroyWindow(removedEdit);
-    g_state.tiles.erase(g_state.tiles.begin() + idx);
+std::string SearchQueryText() {
+    const int len = GetWindowTextLengthW(g_searchView.query);
+    std::wstring query(static_cast<size_t>(len) + 1, L'\0');
+    GetWindowTextW(g_searchView.query, query.data(), len + 1);
+    query.resize(static_cast<size_t>(len));
+    return WideToUtf8(query);
+}
 
-    if (vertical) {
-        int w1 = t.w / 2;
-        g_state.tiles.push_back(Tile{t.x, t.y, w1, t.h, t.text, nullptr});
-        g_state.tiles.push_back(Tile{t.x + w1, t.y, t.w - w1, t.h, L"", nullptr});
-    } else {
-        int h1 = t.h / 2;
-        g_state.tiles.push_back(Tile{t.x, t.y, t.w, h1, t.text, nullptr});
-        g_state.tiles.push_back(Tile{t.x, t.y + h1, t.w, t.h - h1, L"", nullptr});
+void RunSearch() {
+    SearchView& v = g_searchView;
+    const std::string query = SearchQueryText();
+    const auto start = std::chrono::steady_clock::now();
+    v.hits = g_index.Query(query, kSearchLimit);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    SendMessageW(v.results, WM_SETREDRAW, FALSE, 0);
+    SendMessageW(v.results, LB_RESETCONTENT, 0, 0);
+    for (const SearchHit& h : v.hits) {
+        bool live = false;
+        const std::string text = SearchHitText(h, live);
+        const std::wstring where = live ? L" (sulla board)" : FindTileIndexById(h.tileId) >= 0 ? L", versione del " + SnapshotLabel(h.time) : L", eliminata, versione del " + SnapshotLabel(h.time);
+        const std::wstring label = L"tile " + std::to_wstring(h.tileId) + where + L": " + Utf8ToWide(SearchSnippet(text, query, 160));
+        SendMessageW(v.results, LB_ADDSTRING, 0, (LPARAM)label.c_str());
     }
+    SendMessageW(v.results, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(v.results, nullptr, TRUE);
+    SetWindowTextW(v.preview, L"");
+
+    const SearchStats st = g_index.Stats();
+    wchar_t status[160]{};
+    swprintf(status, 160, L"%zu risultati in %.1f ms - %zu versioni indicizzate in %zu segmenti (%.1f MB)", v.hits.size(), ms, st.documents,
+             st.segments, st.bytes / 1048576.0);
+    SetWindowTextW(v.status, query.empty() ? L"" : status);
+}
 
-    DestroyTileWindows();
-    LayoutTiles();
-    SaveState();
+int SelectedSearchHit() {
+    const int sel = static_cast<int>(SendMessageW(g_searchView.results, LB_GETCURSEL, 0, 0));
+    return sel >= 0 && sel < static_cast<int>(g_searchView.hits.size()) ? sel : -1;
 }
 
-void Split4(int idx) {
-    if (idx < 0 || idx >= static_cast<int>(g_state.tiles.size())) return;
+void ShowSearchPreview() {
+    const int sel = SelectedSearchHit();
+    if (sel < 0) return;
+    bool live = false;
+    SetWindowTextW(g_searchView.preview, ForEdit(Utf8ToWide(SearchHitText(g_searchView.hits[sel], live))).c_str());
+}
 
-    Tile t = g_state.tiles[idx];
-    HWND removedEdit = g_state.tiles[idx].edit;
-    if (t.w < 2 || t.h < 2) return;
+void OpenSearchHit() {
+    const int sel = SelectedSearchHit();
+    if (sel < 0) return;
+    const int idx = FindTileIndexById(g_searchView.hits[sel].tileId);
+    if (idx < 0) {
+        MessageBoxW(g_searchView.wnd, L"La tile non c'e' piu'. Il testo e' a destra; per riaverla sulla board usa la Cronologia.", kAppName, MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+    RevealTile(idx); // fuori viewport non ha ancora una EDIT
+    SetForegroundWindow(g_mainWnd);
+    if (g_state.tiles[idx].edit) SetFocus(g_state.tiles[idx].edit);
+}
 
-    int w1 = t.w / 2;
-    int h1 = t.h / 2;
+void LayoutSearchWindow(int w, int h) {
+    const SearchView& v = g_searchView;
+    const int pad = 8;
+    const int editH = 24;
+    const int statusH = 18;
+    const int buttonH = 26;
+    const int top = pad + editH + 4 + statusH + pad;
+    const int listW = std::max(120, (w - 3 * pad) / 2);
+    const int listH = std::max(60, h - top - pad - buttonH - pad);
+    MoveWindow(v.query, pad, pad, std::max(60, w - 2 * pad), editH, TRUE);
+    MoveWindow(v.status, pad, pad + editH + 4, std::max(60, w - 2 * pad), statusH, TRUE);
+    MoveWindow(v.results, pad, top, listW, listH, TRUE);
+    MoveWindow(v.preview, pad * 2 + listW, top, std::max(60, w - 3 * pad - listW), listH, TRUE);
+    MoveWindow(GetDlgItem(v.wnd, kSearchOpen), pad, h - pad - buttonH, 150, buttonH, TRUE);
+}
 
-    if (removedEdit) DestroyWindow(removedEdit);
-    g_state.tiles.erase(g_state.tiles.begin() + idx);
-    g_state.tiles.push_back(Tile{t.x, t.y, w1, h1, t.text, nullptr});
-    g_state.tiles.push_back(Tile{t.x + w1, t.y, t.w - w1, h1, L"", nullptr});
-    g_state.tiles.push_back(Tile{t.x, t.y + h1, w1, t.h - h1, L"", nullptr});
-    g_state.tiles.push_back(Tile{t.x + w1, t.y + h1, t.w - w1, t.h - h1, L"", nullptr});
+LRESULT CALLBACK SearchProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    SearchView& v = g_searchView;
+    switch (msg) {
+        case WM_CREATE: {
+            v.wnd = hwnd;
+            const HINSTANCE inst = GetModuleHandleW(nullptr);
+            v.query = CreateWindowW(L"EDIT", nullptr, WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_AUTOHSCROLL, 0, 0, 0, 0, hwnd, (HMENU)kSearchQuery, inst, nullptr);
+            v.status = CreateWindowW(L"STATIC", nullptr, WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, hwnd, nullptr, inst, nullptr);
+            v.results = CreateWindowW(L"LISTBOX", nullptr, WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_HSCROLL | WS_BORDER | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT, 0, 0, 0, 0, hwnd,
+                                      (HMENU)kSearchResults, inst, nullptr);
+            v.preview = CreateWindowW(L"EDIT", nullptr, WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_BORDER | ES_MULTILINE | ES_READONLY, 0, 0, 0, 0, hwnd, nullptr, inst, nullptr);
+            CreateWindowW(L"BUTTON", L"Vai alla tile", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 0, 0, 0, 0, hwnd, (HMENU)kSearchOpen, inst, nullptr);
+            for (HWND child = GetWindow(hwnd, GW_CHILD); child; child = GetWindow(child, GW_HWNDNEXT)) {
+                SendMessageW(child, WM_SETFONT, (WPARAM)GetStockObject(DEFAULT_GUI_FONT), FALSE);
+            }
+            SendMessageW(v.results, LB_SETHORIZONTALEXTENT, 2000, 0);
+            return 0;
+        }
+        case WM_SIZE:
+            LayoutSearchWindow(LOWORD(lParam), HIWORD(lParam));
+            return 0;
+        case WM_SETFOCUS:
+            SetFocus(v.query);
+            return 0;
+        case WM_COMMAND: {
+            const int id = LOWORD(wParam);
+            if (id == kSearchQuery && HIWORD(wParam) == EN_CHANGE) RunSearch();
+            if (id == kSearchResults && HIWORD(wParam) == LBN_SELCHANGE) ShowSearchPreview();
+            if ((id == kSearchResults && HIWORD(wParam) == LBN_DBLCLK) || id == kSearchOpen) OpenSearchHit();
+            return 0;
+        }
+        case WM_DESTROY:
+            g_searchView = SearchView{};
+            return 0;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
 
-    DestroyTileWindows();
-    LayoutTiles();
-    SaveState();
+void ShowSearchWindow() {
+    if (g_searchView.wnd) {
+        SetForegroundWindow(g_searchView.wnd);
+        SetFocus(g_searchView.query);
+        SendMessageW(g_searchView.query, EM_SETSEL, 0, -1);
+        return;
+    }
+    static bool registered = false;
+    if (!registered) {
+        WNDCLASSW wc{};
+        wc.lpfnWndProc = SearchProc;
+        wc.hInstance = GetModuleHandleW(nullptr);
+        wc.lpszClassName = L"GridNotesSearch";
+        wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+        wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+        RegisterClassW(&wc);
+        registered = true;
+    }
+    HWND wnd = CreateWindowExW(0, L"GridNotesSearch", L"Cerca", WS_OVERLAPPEDWINDOW | WS_VISIBLE, CW_USEDEFAULT, CW_USEDEFAULT, 900, 560,
+                               g_mainWnd, nullptr, GetModuleHandleW(nullptr), nullptr);
+    if (wnd) SetFocus(g_searchView.query);
 }
 
 LRESULT CALLBACK BoardProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -789,72 +4465,179 @@ LRESULT CALLBACK BoardProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             DragEdge edge;
             int idx = HitTestTile(pt, &edge);
 
-            if (idx >= 0 && edge != DragEdge::None) {
+            if (idx >= 0 && edge != DragEdge::None && (GetKeyState(VK_MENU) & 0x8000)) {
+                const Tile& t = g_state.tiles[idx];
+                const bool column = edge == DragEdge::Left || edge == DragEdge::Right;
+                const int index = edge == DragEdge::Left ? t.x - 1 : edge == DragEdge::Right ? t.x + t.w - 1 : edge == DragEdge::Top ? t.y - 1 : t.y + t.h - 1;
+                if (index < 0) break; // bordo del mondo: non c'e' una traccia prima
+                g_trackDrag = TrackDrag{true, column, index, (column ? g_state.columns : g_state.rows).Size(index)};
+                g_dragStart = pt;
+                SetCapture(hwnd);
+            } else if (idx >= 0 && edge != DragEdge::None) {
+                static constexpr TileSide kSideOf[] = {TileSide::Left, TileSide::Left, TileSide::Right, TileSide::Top, TileSide::Bottom};
+                const TileSide side = kSideOf[static_cast<int>(edge)];
+                EdgeDrag drag;
+                if (!g_adjacency.SharedEdge(g_state.tiles[idx].id, side, kWorldCells, drag.group)) break;
+                for (uint64_t id : drag.group.before) drag.original.push_back({id, *g_adjacency.Rect(id)});
+                for (uint64_t id : drag.group.after) drag.original.push_back({id, *g_adjacency.Rect(id)});
+
+                g_edgeDrag = std::move(drag);
                 g_dragging = true;
-                g_dragTile = idx;
-                g_dragEdge = edge;
                 g_dragStart = pt;
-                g_originalTile = g_state.tiles[idx];
+                SetCapture(hwnd);
+            } else if (idx >= 0) {
+                g_moveDrag = MoveDrag{true, g_state.tiles[idx].id, TileRect(g_state.tiles[idx])};
+                g_dragStart = pt;
                 SetCapture(hwnd);
             }
             break;
         }
+        case WM_LBUTTONDBLCLK: {
+            POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+            const int idx = g_state.editLayout ? -1 : HitTestTile(pt);
+            const int file = idx >= 0 ? AttachmentAt(g_state.tiles[idx], pt) : -1;
+            if (file < 0) return SendMessageW(hwnd, WM_LBUTTONDOWN, wParam, lParam); // in layout il secondo click trascina come il primo
+            OpenAttachment(g_state.tiles[idx].files[file]);
+            return 0;
+        }
+        case WM_DROPFILES: {
+            // file trascinati sulla tile sotto il punto (anche sopra la EDIT: il drop risale alla board)
+            const HDROP drop = reinterpret_cast<HDROP>(wParam);
+            POINT pt{};
+            DragQueryPoint(drop, &pt);
+            std::vector<std::wstring> paths;
+            const UINT n = DragQueryFileW(drop, 0xFFFFFFFF, nullptr, 0);
+            for (UINT i = 0; i < n; ++i) {
+                std::wstring path(DragQueryFileW(drop, i, nullptr, 0), L'\0');
+                DragQueryFileW(drop, i, path.data(), static_cast<UINT>(path.size() + 1));
+                paths.push_back(std::move(path));
+            }
+            DragFinish(drop);
+            const int idx = HitTestTile(pt);
+            if (idx >= 0) AttachFilesToTile(g_state.tiles[idx].id, std::move(paths));
+            return 0;
+        }
+        case WM_MBUTTONDOWN:
+            g_pan = PanDrag{true, POINT{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)}, POINT{g_state.viewX, g_state.viewY}};
+            SetCapture(hwnd);
+            return 0;
+        case WM_MBUTTONUP:
+            if (!g_pan.active) break;
+            g_pan = PanDrag{};
+            ReleaseCapture();
+            return 0;
+        case WM_MOUSEWHEEL:
+        case WM_MOUSEHWHEEL: {
+            if (msg == WM_MOUSEWHEEL && (GET_KEYSTATE_WPARAM(wParam) & MK_CONTROL)) {
+                POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+                ScreenToClient(hwnd, &pt);
+                ZoomAt(pt, std::pow(kZoomStep, static_cast<double>(GET_WHEEL_DELTA_WPARAM(wParam)) / WHEEL_DELTA));
+                return 0;
+            }
+            // tre celle per scatto; Shift trasforma la rotella verticale in orizzontale
+            const int step = static_cast<int>(GET_WHEEL_DELTA_WPARAM(wParam) * 3 * Cell() / WHEEL_DELTA);
+            if (msg == WM_MOUSEHWHEEL) SetViewOrigin(g_state.viewX + step, g_state.viewY);
+            else if (GET_KEYSTATE_WPARAM(wParam) & MK_SHIFT) SetViewOrigin(g_state.viewX - step, g_state.viewY);
+            else SetViewOrigin(g_state.viewX, g_state.viewY - step);
+            return 0;
+        }
         case WM_MOUSEMOVE: {
-    if (!g_dragging || g_dragTile < 0) break;
-
-    POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
-    int dx = SnapToCells(pt.x - g_dragStart.x);
-    int dy = SnapToCells(pt.y - g_dragStart.y);
-    const POINT bounds = GetBoardCellBounds(); // bounds.x / bounds.y in CELLE
-
-    Tile t = g_originalTile;
-
-    const int origLeft   = g_originalTile.x;
-    const int origTop    = g_originalTile.y;
-    const int origRight  = g_originalTile.x + g_originalTile.w;
-    const int origBottom = g_originalTile.y + g_originalTile.h;
-
-    if (g_dragEdge == DragEdge::Right) {
-        int desiredRight = std::clamp(origRight + dx, origLeft + 1, (int)bounds.x);
-        desiredRight = LimitRightEdgeCells(g_dragTile, g_originalTile, desiredRight, bounds.x);
-        t.w = desiredRight - origLeft;
-    }
-
-    if (g_dragEdge == DragEdge::Bottom) {
-        int desiredBottom = std::clamp(origBottom + dy, origTop + 1, (int)bounds.y);
-        desiredBottom = LimitBottomEdgeCells(g_dragTile, g_originalTile, desiredBottom, bounds.y);
-        t.h = desiredBottom - origTop;
-    }
-
-    if (g_dragEdge == DragEdge::Left) {
-        int desiredLeft = std::clamp(origLeft + dx, 0, origRight - 1);
-        desiredLeft = LimitLeftEdgeCells(g_dragTile, g_originalTile, desiredLeft);
-        t.x = desiredLeft;
-        t.w = origRight - t.x;
-    }
-
-    if (g_dragEdge == DragEdge::Top) {
-        int desiredTop = std::clamp(origTop + dy, 0, origBottom - 1);
-        desiredTop = LimitTopEdgeCells(g_dragTile, g_originalTile, desiredTop);
-        t.y = desiredTop;
-        t.h = origBottom - t.y;
-    }
+            if (g_pan.active) {
+                SetViewOrigin(g_pan.origin.x - (GET_X_LPARAM(lParam) - g_pan.start.x), g_pan.origin.y - (GET_Y_LPARAM(lParam) - g_pan.start.y));
+                break;
+            }
+            if (g_trackDrag.active) {
+                POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+                const int delta = g_trackDrag.column ? pt.x - g_dragStart.x : pt.y - g_dragStart.y;
+                ResizeTrack(g_trackDrag.column, g_trackDrag.index, g_trackDrag.original + static_cast<int>(std::lround(delta / g_state.zoom)));
+                break;
+            }
+            if (g_moveDrag.active) {
+                if (GetKeyState(VK_CONTROL) & 0x8000) break; // scambio al rilascio: intanto la tile resta dov'e'
+
+                POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+                const CellRect& o = g_moveDrag.original;
+                TileMoves moves;
+                MoveTileToward(g_tileGrid, g_moveDrag.id, SnapToLine(g_state.columns, ToPxX(o.x) + pt.x - g_dragStart.x),
+                               SnapToLine(g_state.rows, ToPxY(o.y) + pt.y - g_dragStart.y),
+                               (GetKeyState(VK_SHIFT) & 0x8000) != 0, kWorldCells, kWorldCells, moves);
+                ApplyTileMoves(moves);
+                break;
+            }
+            if (!g_dragging) break;
 
-    g_state.tiles[g_dragTile] = t;
-    //g_state.tiles[g_dragTile].x = t.x;
-//g_state.tiles[g_dragTile].y = t.y;
-//g_state.tiles[g_dragTile].w = t.w;
-//g_state.tiles[g_dragTile].h = t.h;
-//old?
-    LayoutTiles();
-    break;
-}
+            POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+            const EdgeGroup& g = g_edgeDrag.group;
+            const TrackAxis& axis = g.vertical ? g_state.columns : g_state.rows;
+            const int linePx = TrackToPx(axis, g.line) + (g.vertical ? pt.x - g_dragStart.x : pt.y - g_dragStart.y);
+            const int d = std::clamp(SnapToLine(axis, linePx) - g.line, g.minDelta, g.maxDelta);
+            if (d == g_edgeDrag.applied) break;
+            // maxDelta puo' arrivare al bordo del mondo: si ridisegna tra la linea di prima e quella nuova
+            const int lineLo = g.line + std::min(d, g_edgeDrag.applied);
+            const int lineHi = g.line + std::max(d, g_edgeDrag.applied) + 1;
+            g_edgeDrag.applied = d;
+
+            // le prime g.before.size() voci di original sono le tile prima della linea
+            std::vector<int> touched;
+            touched.reserve(g_edgeDrag.original.size());
+            RECT dirty{g.vertical ? ScreenX(lineLo) : ScreenX(g.lo), g.vertical ? ScreenY(g.lo) : ScreenY(lineLo),
+                       g.vertical ? ScreenX(lineHi) : ScreenX(g.hi), g.vertical ? ScreenY(g.hi) : ScreenY(lineHi)};
+            for (size_t i = 0; i < g_edgeDrag.original.size(); ++i) {
+                const auto& [id, orig] = g_edgeDrag.original[i];
+                const int idx = FindTileIndexById(id);
+                if (idx < 0) continue;
+
+                Tile& t = g_state.tiles[idx];
+                const CellRect before = TileRect(t);
+                t.x = orig.x;
+                t.y = orig.y;
+                t.w = orig.w;
+                t.h = orig.h;
+                if (i < g.before.size()) {
+                    (g.vertical ? t.w : t.h) += d;
+                } else {
+                    (g.vertical ? t.x : t.y) += d;
+                    (g.vertical ? t.w : t.h) -= d;
+                }
+                IndexTileMoved(before, t);
+                touched.push_back(idx);
+
+                // la griglia disegnata copre anche i lati perpendicolari delle tile toccate
+                dirty.left = std::min<LONG>(dirty.left, ScreenX(orig.x));
+                dirty.top = std::min<LONG>(dirty.top, ScreenY(orig.y));
+                dirty.right = std::max<LONG>(dirty.right, ScreenX(orig.x + orig.w) + 1);
+                dirty.bottom = std::max<LONG>(dirty.bottom, ScreenY(orig.y + orig.h) + 1);
+            }
+            LayoutTileSubset(touched, dirty);
+            break;
+        }
         case WM_LBUTTONUP:
+            if (g_trackDrag.active) {
+                g_trackDrag = TrackDrag{};
+                ReleaseCapture();
+                g_layoutDirty = true;
+                SaveState();
+            }
+            if (g_moveDrag.active) {
+                if (GetKeyState(VK_CONTROL) & 0x8000) {
+                    // scambio dei rettangoli con la tile sotto il cursore: il layout resta valido
+                    POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
+                    std::vector<uint64_t> hits;
+                    const POINT world = BoardToWorld(pt);
+                    if (world.x >= 0 && world.y >= 0) g_tileGrid.Query(CellRect{PxToColumn(world.x), PxToRow(world.y), 1, 1}, g_moveDrag.id, hits);
+                    TileMoves swap;
+                    if (!hits.empty() && SwapTiles(g_tileGrid, g_moveDrag.id, hits[0], swap)) ApplyTileMoves(swap);
+                }
+                g_moveDrag = MoveDrag{};
+                ReleaseCapture();
+                g_layoutDirty = true;
+                SaveState();
+            }
             if (g_dragging) {
                 g_dragging = false;
-                g_dragTile = -1;
-                g_dragEdge = DragEdge::None;
+                g_edgeDrag = EdgeDrag{};
                 ReleaseCapture();
+                g_layoutDirty = true;
                 SaveState();
             }
             break;
@@ -863,15 +4646,20 @@ LRESULT CALLBACK BoardProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             POINT local = pt;
             ScreenToClient(hwnd, &local);
             int idx = HitTestTile(local);
-            if (idx < 0) break;
+            if (idx < 0) {
+                const POINT world = BoardToWorld(local);
+                ShowBoardContextMenu(hwnd, world.x >= 0 && world.y >= 0 ? POINT{PxToColumn(world.x), PxToRow(world.y)} : POINT{-1, -1}, pt);
+                break;
+            }
             ShowTileContextMenu(hwnd, idx, pt);
             break;
         }
         case WM_CTLCOLOREDIT: { 
             HDC hdc = reinterpret_cast<HDC>(wParam);
-            SetBkColor(hdc, RGB(TILE_COLOR, TILE_COLOR, TILE_COLOR));
             SetTextColor(hdc, RGB(235, 235, 235));
-            return reinterpret_cast<LRESULT>(g_editBgBrush);
+            const HBRUSH back = TileBackBrush(reinterpret_cast<HWND>(lParam));
+            SetBkColor(hdc, back == g_ringBrush ? kRingColor : RGB(TILE_COLOR, TILE_COLOR, TILE_COLOR));
+            return reinterpret_cast<LRESULT>(back);
         }
         /*case WM_PAINT: {
             PAINTSTRUCT ps{};
@@ -908,8 +4696,8 @@ LRESULT CALLBACK BoardProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     RECT rc{};
     GetClientRect(hwnd, &rc);
 
-    HDC mem = CreateCompatibleDC(hdc);
-    HBITMAP bmp = CreateCompatibleBitmap(hdc, rc.right - rc.left, rc.bottom - rc.top);
+    HDC mem = TrackedMemDc(MemArea::Paint, hdc);
+    HBITMAP bmp = TrackedBitmap(MemArea::Paint, hdc, rc.right - rc.left, rc.bottom - rc.top);
    BITMAP bm{};
 //GetObject(bmp, sizeof(bm), &bm);
 
@@ -921,35 +4709,73 @@ LRESULT CALLBACK BoardProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     HGDIOBJ oldBmp = SelectObject(mem, bmp);
 
     // --- disegna tutto su "mem" invece che su hdc ---
-    HBRUSH bg = CreateSolidBrush(RGB(BACKGROUND, BACKGROUND, BACKGROUND));
+    HBRUSH bg = TrackedBrush(MemArea::Paint, RGB(BACKGROUND, BACKGROUND, BACKGROUND));
     FillRect(mem, &rc, bg);
-    DeleteObject(bg);
+    FreeGdi(MemArea::Paint, bg);
 
-    HPEN pen = CreatePen(PS_SOLID, 1, RGB(80, 80, 80));
+    HPEN pen = TrackedPen(MemArea::Paint, 1, RGB(80, 80, 80));
     HGDIOBJ oldPen = SelectObject(mem, pen);
     HBRUSH hollow = (HBRUSH)GetStockObject(HOLLOW_BRUSH);
     HGDIOBJ oldBrush = SelectObject(mem, hollow);
 
-    for (const auto& t : g_state.tiles) {
-        Rectangle(mem, ToPx(t.x), ToPx(t.y), ToPx(t.x + t.w), ToPx(t.y + t.h));
+    // solo quello che si vede: il costo non cresce col numero di tile
+    std::vector<uint64_t> visible;
+    g_tileTree.Query(GetViewportCells(), visible);
+    for (uint64_t id : visible) {
+        const RECT r = ScreenRect(*g_tileGrid.Rect(id));
+        Rectangle(mem, r.left, r.top, r.right, r.bottom);
+    }
+
+    if (g_zooming) {
+        // EDIT nascoste: al loro posto l'istantanea scalata (o solo lo sfondo, se la tile
+        // e' entrata nella viewport durante il gesto). COLORONCOLOR: veloce, basta per un gesto.
+        const HWND focus = GetFocus();
+        HDC snapDc = TrackedMemDc(MemArea::Paint, mem);
+        const int oldMode = SetStretchBltMode(mem, COLORONCOLOR);
+        for (uint64_t id : visible) {
+            const int idx = FindTileIndexById(id);
+            if (idx >= 0 && g_state.tiles[idx].edit && g_state.tiles[idx].edit == focus) continue;
+            if (idx < 0) continue;
+            const RECT r = EditRect(g_state.tiles[idx]);
+            auto snap = g_snapshots.find(id);
+            if (snap == g_snapshots.end()) {
+                FillRect(mem, &r, g_editBgBrush);
+                continue;
+            }
+            HGDIOBJ oldSnap = SelectObject(snapDc, snap->second.bmp);
+            StretchBlt(mem, r.left, r.top, r.right - r.left, r.bottom - r.top, snapDc, 0, 0, snap->second.w, snap->second.h, SRCCOPY);
+            SelectObject(snapDc, oldSnap);
+        }
+        SetStretchBltMode(mem, oldMode);
+        FreeMemDc(MemArea::Paint, snapDc);
+    }
+
+    // allegati: solo le tile in vista chiedono le miniature
+    for (uint64_t id : visible) {
+        const int idx = FindTileIndexById(id);
+        if (idx >= 0 && !g_state.tiles[idx].files.empty()) PaintAttachments(mem, g_state.tiles[idx]);
     }
 
     SelectObject(mem, oldBrush);
     SelectObject(mem, oldPen);
-    DeleteObject(pen);
+    FreeGdi(MemArea::Paint, pen);
+    if (g_memOverlay) PaintMemOverlay(mem, rc);
 
     // copia su schermo in un colpo solo
     BitBlt(hdc, 0, 0, rc.right - rc.left, rc.bottom - rc.top, mem, 0, 0, SRCCOPY);
 
 
     SelectObject(mem, oldBmp);
-    DeleteObject(bmp);
-    DeleteDC(mem);
+    FreeGdi(MemArea::Paint, bmp);
+    FreeMemDc(MemArea::Paint, mem);
 
     EndPaint(hwnd, &ps);
    
     return 0;
 }
+        case WM_TIMER:
+            if (wParam == kTimerZoomSettle) EndZoomGesture();
+            return 0;
         case WM_COMMAND:
             return SendMessageW(GetParent(hwnd), msg, wParam, lParam);
         case WM_ERASEBKGND:
@@ -969,11 +4795,11 @@ LRESULT CALLBACK MainProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
     // scegli brush in base allo stato
     HBRUSH bg = g_state.editLayout
-        ? CreateSolidBrush(RGB(0, 0, 0))   // ON
-        : CreateSolidBrush(RGB(60, 60, 60)); // OFF
+        ? TrackedBrush(MemArea::Paint, RGB(0, 0, 0))   // ON
+        : TrackedBrush(MemArea::Paint, RGB(60, 60, 60)); // OFF
 
     FillRect(dis->hDC, &dis->rcItem, bg);
-    DeleteObject(bg);
+    FreeGdi(MemArea::Paint, bg);
 
     // bordo semplice
     FrameRect(dis->hDC, &dis->rcItem, (HBRUSH)GetStockObject(BLACK_BRUSH));
@@ -1004,8 +4830,9 @@ else if(hCheck== g_startupToggle){
     return TRUE;
 }
         case WM_CREATE: {
-            g_editBgBrush = CreateSolidBrush(RGB(TILE_COLOR, TILE_COLOR, TILE_COLOR));
-            g_toolbarBgBrush = CreateSolidBrush(RGB(TILE_COLOR, TILE_COLOR, TILE_COLOR));
+            g_mainWnd = hwnd;
+            g_editBgBrush = TrackedBrush(MemArea::Brushes, RGB(TILE_COLOR, TILE_COLOR, TILE_COLOR));
+            g_toolbarBgBrush = TrackedBrush(MemArea::Brushes, RGB(TILE_COLOR, TILE_COLOR, TILE_COLOR));
             
             /*g_editToggle = CreateWindowW(
                 L"BUTTON",
@@ -1060,20 +4887,31 @@ else if(hCheck== g_startupToggle){
                     GetModuleHandleW(nullptr),
                     nullptr);
             WNDCLASSW wc{};
+            wc.style = CS_DBLCLKS; // doppio click su un allegato
             wc.lpfnWndProc = BoardProc;
             wc.hInstance = GetModuleHandleW(nullptr);
             wc.lpszClassName = L"GridNotesBoard";
             wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
             RegisterClassW(&wc);
 
+            WNDCLASSW tv{}; // tile "nota lunga" (ScrollEditProc)
+            tv.style = CS_DBLCLKS;
+            tv.lpfnWndProc = ScrollEditProc;
+            tv.cbWndExtra = sizeof(ScrollEdit*);
+            tv.hInstance = GetModuleHandleW(nullptr);
+            tv.lpszClassName = L"GridNotesTextView";
+            tv.hCursor = LoadCursor(nullptr, IDC_IBEAM);
+            RegisterClassW(&tv);
+
             g_board = CreateWindowW(L"GridNotesBoard", nullptr, WS_CHILD | WS_VISIBLE | WS_CLIPCHILDREN | WS_CLIPSIBLINGS, 0, kToolbarHeight, 100, 100, hwnd, nullptr, GetModuleHandleW(nullptr), nullptr);
+            DragAcceptFiles(g_board, TRUE); // file trascinati da Esplora risorse: allegati
             return 0;
         }
         case WM_SIZE: {
             int w = LOWORD(lParam);
             int h = HIWORD(lParam);
             MoveWindow(g_board, 0, kToolbarHeight, w, std::max(1, h - kToolbarHeight), TRUE);
-            LayoutTiles();
+            LayoutTiles(); // viewport cambiata: g_freeSpace si rifa' alla prossima richiesta
             return 0;
         }
         case WM_COMMAND: {
@@ -1120,36 +4958,54 @@ else if(hCheck== g_startupToggle){
                 return 0;
             }
 */
+            if (HIWORD(wParam) == EN_SETFOCUS || HIWORD(wParam) == EN_KILLFOCUS) {
+                const int idx = FindTileIndexByEdit(reinterpret_cast<HWND>(lParam));
+                if (idx < 0) return 0;
+                Tile& t = g_state.tiles[idx];
+                InvalidateRect(t.edit, nullptr, TRUE); // Markdown in lettura <-> testo da modificare
+                g_ringing.erase(t.id); // promemoria visto
+                if (HIWORD(wParam) == EN_KILLFOCUS) {
+                    ShowFormulaResult(t);
+                } else if (g_formulaShown.erase(t.id)) {
+                    // si modifica la formula, non il risultato
+                    g_internalTextSet = true;
+                    SetWindowTextW(t.edit, t.text.c_str());
+                    SendMessageW(t.edit, EM_SETSEL, static_cast<WPARAM>(t.text.size()), static_cast<LPARAM>(t.text.size()));
+                    g_internalTextSet = false;
+                    DropSnapshot(t.id);
+                }
+                return 0;
+            }
             if (HIWORD(wParam) == EN_CHANGE) {
                 if (g_internalTextSet) return 0;
 
-                HWND changed = reinterpret_cast<HWND>(lParam);
-                for (auto& t : g_state.tiles) {
-                    if (t.edit != changed) continue;
+                const int idx = FindTileIndexByEdit(reinterpret_cast<HWND>(lParam));
+                if (idx >= 0) {
+                    Tile& t = g_state.tiles[idx];
+                    if (const ScrollEdit* se = GetScrollEdit(t.edit)) {
+                        // nota lunga: il testo si copia una volta dal modello, senza misure
+                        t.text.assign(se->view.Text().begin(), se->view.Text().end());
+                        OnTileTextChanged(t);
+                        return 0;
+                    }
 
                     int len = GetWindowTextLengthW(t.edit);
                     std::wstring text(len + 1, L'\0');
                     GetWindowTextW(t.edit, text.data(), len + 1);
                     text.resize(len);
 
-                    if (!TextFitsInEdit(t.edit, text)) {
+                    if (!FitTextToTile(t, text)) {
                         g_internalTextSet = true;
                         SetWindowTextW(t.edit, t.text.c_str());
                         SendMessageW(t.edit, EM_SETSEL, static_cast<WPARAM>(t.text.size()), static_cast<LPARAM>(t.text.size()));
                         g_internalTextSet = false;
                         MessageBeep(MB_ICONWARNING);
-                        break;
+                        return 0;
                     }
 
                     t.text = text;
                     // SaveState(); //esoso in termini di risorse:ogni lettera è un i/o
-
-g_savePending = true;
-KillTimer(hwnd, kTimerSaveDebounce);
-SetTimer(hwnd, kTimerSaveDebounce, kSaveDebounceMs, nullptr);
-
-
-                    break;
+                    OnTileTextChanged(t);
                 }
             }
             return 0;
@@ -1177,27 +5033,140 @@ SetTimer(hwnd, kTimerSaveDebounce, kSaveDebounceMs, nullptr);
             g_state.windowWidth = rc.right - rc.left;
             g_state.windowHeight = rc.bottom - rc.top;
             SaveState();
+            TakeHistorySnapshot();
             DestroyWindow(hwnd);
             return 0;
         }
         case WM_DESTROY:
+            g_ipc.Stop();
+            g_stateWatcher.Stop();
+            g_syncWatcher.Stop();
+            g_mirrorWatcher.Stop();
+            g_tailWatchers.clear();
+            KillTimer(hwnd, kTimerSnapshot);
+            KillTimer(hwnd, kTimerReminder);
+            KillTimer(hwnd, kTimerRingBlink);
+            KillTimer(hwnd, kTimerMemStats);
+            g_history.Stop(); // finisce di scrivere l'ultima istantanea
+            KillTimer(hwnd, kTimerSpell);
+            g_spell.Stop();
+            g_index.Stop(); // la memtable diventa un segmento
+            g_thumbs.Stop(); // finisce le copie nello store, lascia le miniature
             if (g_editBgBrush) {
-                DeleteObject(g_editBgBrush);
+                FreeGdi(MemArea::Brushes, g_editBgBrush);
                 g_editBgBrush = nullptr;
             }
             if (g_toolbarBgBrush) {
-                DeleteObject(g_toolbarBgBrush);
+                FreeGdi(MemArea::Brushes, g_toolbarBgBrush);
                 g_toolbarBgBrush = nullptr;
             }
-            if(g_bigFont){
-                  DeleteObject(g_toolbarBgBrush);
+            if (g_ringBrush) {
+                FreeGdi(MemArea::Brushes, g_ringBrush);
+                g_ringBrush = nullptr;
+            }
+            if (g_bigFont) {
+                FreeGdi(MemArea::Fonts, g_bigFont);
                 g_bigFont = nullptr;
             }
+            DestroyFontCache();
+            DropAllSnapshots();
             PostQuitMessage(0);
             return 0;
+        case kMsgIpcBatch:
+            ProcessIpcBatch();
+            return 0;
+        case kMsgStateFileChanged:
+            SetTimer(hwnd, kTimerStateReload, kStateReloadDelayMs, nullptr);
+            return 0;
+        case kMsgSyncChanged:
+            MergeSyncChanges();
+            return 0;
+        case kMsgRecalc:
+            g_recalcPosted = false;
+            RecalcFormulas();
+            return 0;
+        case kMsgThumbReady:
+            g_thumbSignaled = false; // prima di disegnare: una miniatura pronta da qui in poi rimanda un messaggio
+            InvalidateRect(g_board, nullptr, FALSE);
+            return 0;
+        case kMsgAttachDone:
+            ApplyAttachments();
+            return 0;
+        case kMsgSpellReady: {
+            // errori nuovi per una tile: se e' in vista si ridisegna (le altre li leggono quando tornano)
+            const int idx = FindTileIndexById(static_cast<uint64_t>(wParam));
+            if (idx >= 0 && g_state.tiles[idx].edit) InvalidateRect(g_state.tiles[idx].edit, nullptr, TRUE);
+            return 0;
+        }
+        case WM_TIMECHANGE:
+            FireReminders(); // ruota e timer si rifanno sull'ora nuova
+            return 0;
+        case WM_POWERBROADCAST:
+            // al risveglio i timer non sanno quanto si e' dormito: si recupera subito
+            if (wParam == PBT_APMRESUMEAUTOMATIC || wParam == PBT_APMRESUMESUSPEND) FireReminders();
+            return TRUE;
+        case kMsgTailChanged:
+            // una raffica di append diventa un solo aggiornamento per fotogramma
+            if (!g_tailRepaintArmed) {
+                g_tailRepaintArmed = true;
+                SetTimer(hwnd, kTimerTailRepaint, TailRepaintMs(), nullptr);
+            }
+            return 0;
+        case kMsgMirrorChanged:
+            // stessa cadenza del salvataggio: una raffica di scritture si legge una volta
+            g_mirrorPending = true;
+            KillTimer(hwnd, kTimerSaveDebounce);
+            SetTimer(hwnd, kTimerSaveDebounce, kSaveDebounceMs, nullptr);
+            return 0;
         case WM_TIMER: {
+    if (wParam == kTimerStateReload) {
+        KillTimer(hwnd, kTimerStateReload);
+        CheckExternalStateChange();
+        return 0;
+    }
+    if (wParam == kTimerTailRepaint || wParam == kTimerTailPoll) {
+        if (wParam == kTimerTailRepaint) {
+            KillTimer(hwnd, kTimerTailRepaint);
+            g_tailRepaintArmed = false;
+        }
+        PollTails();
+        return 0;
+    }
+    if (wParam == kTimerReminder) {
+        FireReminders();
+        return 0;
+    }
+    if (wParam == kTimerMemStats) {
+        RecordMemSample();
+        return 0;
+    }
+    if (wParam == kTimerSpell) {
+        FlushSpellTexts();
+        return 0;
+    }
+    if (wParam == kTimerRingBlink) {
+        g_ringPhase = !g_ringPhase && !g_ringing.empty();
+        for (uint64_t id : g_ringing) {
+            const int idx = FindTileIndexById(id);
+            if (idx >= 0 && g_state.tiles[idx].edit) InvalidateRect(g_state.tiles[idx].edit, nullptr, TRUE);
+        }
+        if (g_ringing.empty()) KillTimer(hwnd, kTimerRingBlink);
+        return 0;
+    }
+    if (wParam == kTimerSnapshot) {
+        TakeHistorySnapshot();
+        if (++g_snapshotTicks % kSnapshotsPerMaintenance == 0) {
+            PostHistoryMaintenance();
+            PostAttachmentMaintenance();
+        }
+        return 0;
+    }
     if (wParam == kTimerSaveDebounce) {
         KillTimer(hwnd, kTimerSaveDebounce);
+        if (g_mirrorPending) {
+            g_mirrorPending = false;
+            ImportMirrorChanges();
+        }
 
         if (g_savePending) {
             g_savePending = false;
@@ -1216,7 +5185,25 @@ SetTimer(hwnd, kTimerSaveDebounce, kSaveDebounceMs, nullptr);
 
 
 
+std::vector<std::string> CommandLineArgsUtf8() {
+    std::vector<std::string> args;
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv) return args;
+    for (int i = 1; i < argc; ++i) args.push_back(WideToUtf8(argv[i]));
+    LocalFree(argv);
+    return args;
+}
+
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow) {
+    // Seconda istanza: inoltra la riga di comando alla primaria ed esce subito,
+    // prima di font, stato e finestre. Due istanze si sovrascriverebbero state.json.
+    if (!g_instance.Acquire("GridNotes")) {
+        AllowSetForegroundWindow(ASFW_ANY);
+        ForwardToPrimary(IpcDefaultEndpoint(), CommandLineArgsUtf8(), 3000);
+        return 0;
+    }
+
     CreateGlobalFont();
     SetPriorityClass(GetCurrentProcess(), ABOVE_NORMAL_PRIORITY_CLASS);
     LoadState();
@@ -1248,6 +5235,9 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow) {
         nullptr);
     if (!hwnd) return 0;
 
+    g_ipc.Start(IpcDefaultEndpoint(), [] { PostMessageW(g_mainWnd, kMsgIpcBatch, 0, 0); });
+    StartAttachments(); // prima del primo WM_PAINT, che chiede le miniature
+
 CenterWindowOnSecondMonitor(hwnd,g_state.windowWidth,g_state.windowHeight);
 
 
@@ -1256,8 +5246,23 @@ CenterWindowOnSecondMonitor(hwnd,g_state.windowWidth,g_state.windowHeight);
 
     RECT boardRc{};
     GetClientRect(g_board, &boardRc);
+    StartSync(); // prima del 2x2: con la cartella gia' piena le tile arrivano da li'
     if (g_state.tiles.empty()) CreateDefault2x2(boardRc);
+    StartMirror();
+    ValidateLayout(true);
+    RebuildTileIndexes();
+    RecalcFormulas(); // le EDIT create da LayoutTiles mostrano gia' i risultati
+    UpdateTails();
     LayoutTiles();
+    StartHistory();
+    StartSearchIndex();
+    if (g_state.spellCheck) StartSpellCheck();
+    RecordMemSample();
+    SetTimer(hwnd, kTimerMemStats, kMemSampleMs, nullptr);
+
+    g_stateWatcher.Start(GetStateFolder(), [](const std::filesystem::path& name) {
+        if (name.empty() || name == L"state.json") PostMessageW(g_mainWnd, kMsgStateFileChanged, 0, 0);
+    });
 
     MSG msg{};
     while (GetMessageW(&msg, nullptr, 0, 0)) {
@@ -0,0 +1,30 @@
+#pragma once
+
+// File in sola lettura mappato in memoria (MapViewOfFile / mmap): i dizionari compilati
+// del controllo ortografico e i segmenti dell'indice di ricerca si leggono cosi', senza
+// copiarli. Il file si puo' cancellare o sostituire mentre e' mappato.
+
+#include <cstddef>
+#include <filesystem>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& o) noexcept;
+    MappedFile& operator=(MappedFile&& o) noexcept;
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    const unsigned char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+private:
+    const unsigned char* data_{nullptr};
+    size_t size_{0};
+#ifdef _WIN32
+    void* mapping_{nullptr};
+#endif
+};
@@ -0,0 +1,489 @@
+#include "markdown.h"
+
+#include <algorithm>
+#include <cwctype>
+
+#include "textutil.h" // DiffTexts
+
+namespace {
+
+// [begin, end) senza a capo ('\r' compreso); next = inizio della riga dopo
+struct Line {
+    size_t begin;
+    size_t end;
+    size_t next;
+};
+
+Line LineAt(std::wstring_view t, size_t pos) {
+    const size_t nl = t.find(L'\n', pos);
+    size_t end = nl == std::wstring_view::npos ? t.size() : nl;
+    const size_t next = nl == std::wstring_view::npos ? t.size() : nl + 1;
+    if (end > pos && t[end - 1] == L'\r') --end;
+    return Line{pos, end, next};
+}
+
+enum class LineKind { Blank, Fence, Heading, Rule, Bullet, Numbered, Task, Quote, Text };
+
+struct LineInfo {
+    LineKind kind{LineKind::Text};
+    size_t content{0}; // dopo il marcatore
+    size_t contentEnd{0};
+    int level{0};
+    bool checked{false};
+    size_t markerBegin{0};
+    size_t markerEnd{0};
+    wchar_t fence{0};
+    size_t fenceLen{0};
+};
+
+bool IsBlank(wchar_t c) { return c == L' ' || c == L'\t'; }
+
+LineInfo Classify(std::wstring_view t, const Line& l) {
+    LineInfo li;
+    li.content = l.begin;
+    li.contentEnd = l.end;
+    size_t i = l.begin;
+    int indent = 0;
+    while (i < l.end && IsBlank(t[i])) {
+        indent += t[i] == L'\t' ? 4 : 1;
+        ++i;
+    }
+    if (i == l.end) {
+        li.kind = LineKind::Blank;
+        return li;
+    }
+    const wchar_t c = t[i];
+    auto run = [&](size_t from, wchar_t ch) {
+        size_t n = 0;
+        while (from + n < l.end && t[from + n] == ch) ++n;
+        return n;
+    };
+
+    if (indent < 4) {
+        if (c == L'`' || c == L'~') {
+            const size_t n = run(i, c);
+            if (n >= 3) {
+                li.kind = LineKind::Fence;
+                li.fence = c;
+                li.fenceLen = n;
+                return li;
+            }
+        }
+        if (c == L'#') {
+            const size_t n = run(i, L'#');
+            if (n <= 6 && (i + n == l.end || IsBlank(t[i + n]))) {
+                li.kind = LineKind::Heading;
+                li.level = static_cast<int>(n);
+                size_t b = i + n, e = l.end;
+                while (b < e && IsBlank(t[b])) ++b;
+                // "## Titolo ##": i # di chiusura non si vedono
+                size_t k = e;
+                while (k > b && t[k - 1] == L'#') --k;
+                if (k == b || IsBlank(t[k - 1])) e = k;
+                while (e > b && IsBlank(t[e - 1])) --e;
+                li.content = b;
+                li.contentEnd = e;
+                return li;
+            }
+        }
+        if (c == L'-' || c == L'*' || c == L'_') {
+            size_t n = 0;
+            bool only = true;
+            for (size_t k = i; k < l.end && only; ++k) {
+                if (t[k] == c) ++n;
+                else if (!IsBlank(t[k])) only = false;
+            }
+            if (only && n >= 3) {
+                li.kind = LineKind::Rule;
+                return li;
+            }
+        }
+        if (c == L'>') {
+            li.kind = LineKind::Quote;
+            size_t k = i;
+            while (k < l.end && (t[k] == L'>' || IsBlank(t[k]))) {
+                if (t[k] == L'>') ++li.level;
+                ++k;
+            }
+            li.content = k;
+            return li;
+        }
+    }
+
+    if ((c == L'-' || c == L'*' || c == L'+') && i + 1 < l.end && IsBlank(t[i + 1])) {
+        li.kind = LineKind::Bullet;
+        li.level = indent / 2;
+        li.content = i + 2;
+        const size_t b = li.content;
+        if (b + 2 < l.end && t[b] == L'[' && t[b + 2] == L']' && (t[b + 1] == L' ' || t[b + 1] == L'x' || t[b + 1] == L'X') &&
+            (b + 3 == l.end || IsBlank(t[b + 3]))) {
+            li.kind = LineKind::Task;
+            li.checked = t[b + 1] != L' ';
+            li.content = std::min(l.end, b + 4);
+        }
+        return li;
+    }
+    if (c >= L'0' && c <= L'9') {
+        size_t k = i;
+        while (k < l.end && k - i < 9 && t[k] >= L'0' && t[k] <= L'9') ++k;
+        if (k + 1 < l.end && (t[k] == L'.' || t[k] == L')') && IsBlank(t[k + 1])) {
+            li.kind = LineKind::Numbered;
+            li.level = indent / 2;
+            li.markerBegin = i;
+            li.markerEnd = k + 1;
+            li.content = k + 2;
+            return li;
+        }
+    }
+    return li;
+}
+
+bool IsClosingFence(std::wstring_view t, const Line& l, wchar_t fence, size_t fenceLen) {
+    size_t i = l.begin;
+    while (i < l.end && i - l.begin < 4 && IsBlank(t[i])) ++i;
+    size_t n = 0;
+    while (i < l.end && t[i] == fence) {
+        ++n;
+        ++i;
+    }
+    while (i < l.end && IsBlank(t[i])) ++i;
+    return n >= fenceLen && i == l.end;
+}
+
+bool IsPunct(wchar_t c) { return c < 128 && std::iswpunct(c); }
+
+// Stili del testo di una riga [from, to): i delimitatori spariscono, il resto diventa
+// tratti con offset relativi a base. Un delimitatore apre solo se si chiude sulla riga.
+void ParseInline(std::wstring_view t, size_t from, size_t to, size_t base, uint8_t style, MdBlock& b) {
+    size_t runStart = from;
+    auto flush = [&](size_t end, uint8_t s) {
+        if (end > runStart) b.runs.push_back(MdRun{static_cast<uint32_t>(runStart - base), static_cast<uint32_t>(end - runStart), s});
+    };
+    const std::wstring_view line = t.substr(0, to);
+    size_t i = from;
+    while (i < to) {
+        const wchar_t c = t[i];
+        if (c == L'\\' && i + 1 < to && IsPunct(t[i + 1])) {
+            flush(i, style);
+            runStart = i + 1; // il carattere escapato apre il tratto dopo
+            i += 2;
+            continue;
+        }
+        if (c == L'`') {
+            const size_t close = line.find(L'`', i + 1);
+            if (close != std::wstring_view::npos && close > i + 1) {
+                flush(i, style);
+                runStart = i + 1;
+                flush(close, static_cast<uint8_t>(style | kMdCode));
+                runStart = close + 1;
+                i = close + 1;
+                b.markup = true;
+                continue;
+            }
+        }
+        if (c == L'*' || c == L'_') {
+            const size_t n = i + 1 < to && t[i + 1] == c ? 2 : 1;
+            const uint8_t flag = n == 2 ? kMdBold : kMdItalic;
+            // '_' solo ai bordi delle parole: snake_case resta com'e'
+            const bool canOpen = c == L'*' || i == from || !std::iswalnum(t[i - 1]);
+            const bool canClose = c == L'*' || i + n == to || !std::iswalnum(t[i + n]);
+            if (canClose && (style & flag)) {
+                flush(i, style);
+                style = static_cast<uint8_t>(style & ~flag);
+                runStart = i + n;
+                i += n;
+                continue;
+            }
+            const std::wstring_view delim = t.substr(i, n);
+            if (canOpen && i + n < to && !IsBlank(t[i + n]) && line.find(delim, i + n) != std::wstring_view::npos) {
+                flush(i, style);
+                style = static_cast<uint8_t>(style | flag);
+                runStart = i + n;
+                i += n;
+                b.markup = true;
+                continue;
+            }
+            i += n;
+            continue;
+        }
+        if (c == L'[') {
+            const size_t close = line.find(L"](", i + 1);
+            const size_t paren = close == std::wstring_view::npos ? close : line.find(L')', close + 2);
+            if (paren != std::wstring_view::npos && close > i + 1) {
+                flush(i, style);
+                runStart = i + 1;
+                flush(close, static_cast<uint8_t>(style | kMdLink)); // si vede il testo, non l'indirizzo
+                runStart = paren + 1;
+                i = paren + 1;
+                b.markup = true;
+                continue;
+            }
+        }
+        ++i;
+    }
+    flush(to, style);
+}
+
+void PushBreak(MdBlock& b) { b.runs.push_back(MdRun{0, 0, kMdBreak}); }
+
+// un blocco da pos (inizio riga); ritorna dove comincia il successivo
+size_t ParseBlock(std::wstring_view t, size_t pos, MdBlock& b) {
+    b.begin = pos;
+    const Line first = LineAt(t, pos);
+    const LineInfo li = Classify(t, first);
+    size_t end = first.next;
+
+    switch (li.kind) {
+    case LineKind::Blank:
+        b.kind = MdBlock::Kind::Blank;
+        while (end < t.size()) {
+            const Line l = LineAt(t, end);
+            if (Classify(t, l).kind != LineKind::Blank) break;
+            end = l.next;
+        }
+        break;
+    case LineKind::Fence: {
+        b.kind = MdBlock::Kind::Code;
+        b.markup = true;
+        bool firstLine = true;
+        while (end < t.size()) {
+            const Line l = LineAt(t, end);
+            end = l.next;
+            if (IsClosingFence(t, l, li.fence, li.fenceLen)) break;
+            if (!firstLine) PushBreak(b);
+            firstLine = false;
+            b.runs.push_back(MdRun{static_cast<uint32_t>(l.begin - pos), static_cast<uint32_t>(l.end - l.begin), kMdCode});
+        }
+        break;
+    }
+    case LineKind::Heading:
+        b.kind = MdBlock::Kind::Heading;
+        b.level = static_cast<uint8_t>(li.level);
+        b.markup = true;
+        ParseInline(t, li.content, li.contentEnd, pos, static_cast<uint8_t>(li.level << kMdHeadingShift), b);
+        break;
+    case LineKind::Rule:
+        b.kind = MdBlock::Kind::Rule;
+        b.markup = true;
+        break;
+    case LineKind::Bullet:
+    case LineKind::Numbered:
+    case LineKind::Task:
+        b.kind = li.kind == LineKind::Bullet ? MdBlock::Kind::Bullet : li.kind == LineKind::Task ? MdBlock::Kind::Task : MdBlock::Kind::Numbered;
+        b.level = static_cast<uint8_t>(std::min(li.level, 8));
+        b.checked = li.checked;
+        if (li.kind == LineKind::Numbered) {
+            b.marker = MdRun{static_cast<uint32_t>(li.markerBegin - pos), static_cast<uint32_t>(li.markerEnd - li.markerBegin), 0};
+        }
+        b.markup = true;
+        ParseInline(t, std::min(li.content, first.end), first.end, pos, 0, b);
+        break;
+    case LineKind::Quote: {
+        b.kind = MdBlock::Kind::Quote;
+        b.level = static_cast<uint8_t>(std::min(li.level, 8));
+        b.markup = true;
+        ParseInline(t, li.content, first.end, pos, 0, b);
+        while (end < t.size()) {
+            const Line l = LineAt(t, end);
+            const LineInfo next = Classify(t, l);
+            if (next.kind != LineKind::Quote) break;
+            PushBreak(b);
+            ParseInline(t, next.content, l.end, pos, 0, b);
+            end = l.next;
+        }
+        break;
+    }
+    case LineKind::Text:
+        // paragrafo: righe di testo consecutive, ognuna a capo come nella EDIT
+        b.kind = MdBlock::Kind::Paragraph;
+        ParseInline(t, first.begin, first.end, pos, 0, b);
+        while (end < t.size()) {
+            const Line l = LineAt(t, end);
+            if (Classify(t, l).kind != LineKind::Text) break;
+            PushBreak(b);
+            ParseInline(t, l.begin, l.end, pos, 0, b);
+            end = l.next;
+        }
+        break;
+    }
+    b.length = end - pos;
+    return end;
+}
+
+} // namespace
+
+void MarkdownDoc::SetText(std::wstring_view text) {
+    text_.assign(text);
+    blocks_.clear();
+    markupBlocks_ = 0;
+    Reparse(0, 0, text_.size());
+}
+
+void MarkdownDoc::Update(std::wstring_view text) {
+    const TextEdit e = DiffTexts(text_, text);
+    if (e.removed == 0 && e.inserted == 0) return;
+    text_.replace(e.at, e.removed, text.substr(e.at, e.inserted));
+    Reparse(e.at, e.removed, e.inserted);
+}
+
+void MarkdownDoc::Reparse(size_t at, size_t removed, size_t inserted) {
+    // Dal blocco prima di quello toccato: cambiando la prima riga di un blocco il
+    // precedente puo' allungarsi (un paragrafo che assorbe la riga).
+    size_t b = 0;
+    if (!blocks_.empty()) {
+        auto it = std::upper_bound(blocks_.begin(), blocks_.end(), at, [](size_t pos, const MdBlock& x) { return pos < x.begin; });
+        b = static_cast<size_t>(std::max<ptrdiff_t>(0, (it - blocks_.begin()) - 2));
+    }
+    size_t pos = blocks_.empty() ? 0 : blocks_[b].begin;
+    const size_t newEnd = at + inserted;
+
+    // si analizza finche' un confine nuovo dopo la modifica cade su un confine vecchio:
+    // da li' in poi il testo e' lo stesso e anche i blocchi
+    std::vector<MdBlock> fresh;
+    size_t j = b;
+    bool synced = false;
+    while (pos < text_.size()) {
+        MdBlock nb;
+        pos = ParseBlock(text_, pos, nb);
+        ++parsed_;
+        fresh.push_back(std::move(nb));
+        if (pos < newEnd) continue;
+        const size_t oldPos = pos - inserted + removed;
+        while (j < blocks_.size() && blocks_[j].begin < oldPos) ++j;
+        if (j < blocks_.size() && blocks_[j].begin == oldPos) {
+            synced = true;
+            break;
+        }
+    }
+    if (!synced) j = blocks_.size();
+
+    for (size_t k = b; k < j; ++k) markupBlocks_ -= blocks_[k].markup ? 1 : 0;
+    for (const auto& nb : fresh) markupBlocks_ += nb.markup ? 1 : 0;
+    for (size_t k = j; k < blocks_.size(); ++k) blocks_[k].begin = blocks_[k].begin + inserted - removed;
+    const size_t common = std::min(j - b, fresh.size());
+    std::move(fresh.begin(), fresh.begin() + common, blocks_.begin() + b);
+    if (fresh.size() > common) {
+        blocks_.insert(blocks_.begin() + b + common, std::make_move_iterator(fresh.begin() + common), std::make_move_iterator(fresh.end()));
+    } else {
+        blocks_.erase(blocks_.begin() + b + common, blocks_.begin() + j);
+    }
+}
+
+const MdBlock& MarkdownDoc::Layout(size_t i, int width, const MdMetrics& m) {
+    MdBlock& b = blocks_[i];
+    width = std::max(1, width);
+    if (b.layoutWidth == width && b.layoutVersion == m.version) return b;
+    b.layoutWidth = width;
+    b.layoutVersion = m.version;
+    b.fragments.clear();
+
+    const std::wstring_view src(text_.data() + b.begin, b.length);
+    const uint8_t base = b.kind == MdBlock::Kind::Heading ? static_cast<uint8_t>(b.level << kMdHeadingShift)
+                         : b.kind == MdBlock::Kind::Code  ? kMdCode
+                                                          : 0;
+    const int lh = std::max(1, m.lineHeight(base));
+    auto add = [&](MdFragment::Kind kind, int x, int y, int w, int h) { b.fragments.push_back(MdFragment{kind, 0, x, y, w, h, 0, 0}); };
+
+    if (b.kind == MdBlock::Kind::Blank) {
+        const int lines = static_cast<int>(std::count(src.begin(), src.end(), L'\n')) + (src.empty() || src.back() != L'\n' ? 1 : 0);
+        b.height = lh * std::max(1, lines);
+        return b;
+    }
+    if (b.kind == MdBlock::Kind::Rule) {
+        add(MdFragment::Kind::Rule, 0, lh / 2, width, 1);
+        b.height = lh;
+        return b;
+    }
+
+    int indent = 0;
+    const int step = lh * 3 / 2; // un livello di rientro
+    switch (b.kind) {
+    case MdBlock::Kind::Bullet:
+    case MdBlock::Kind::Task:
+        indent = step * (b.level + 1);
+        add(b.kind == MdBlock::Kind::Bullet ? MdFragment::Kind::Bullet : b.checked ? MdFragment::Kind::CheckedBox : MdFragment::Kind::Box,
+            indent - step, 0, step, lh);
+        break;
+    case MdBlock::Kind::Numbered: {
+        indent = step * (b.level + 1);
+        const int w = m.width(src.substr(b.marker.begin, b.marker.length), 0);
+        b.fragments.push_back(MdFragment{MdFragment::Kind::Text, 0, std::max(0, indent - w - lh / 3), 0, w, lh, b.marker.begin, b.marker.length});
+        break;
+    }
+    case MdBlock::Kind::Quote:
+        indent = (lh / 2) * (b.level + 1);
+        for (int k = 0; k < b.level; ++k) add(MdFragment::Kind::QuoteBar, k * (lh / 2), 0, std::max(2, lh / 6), 0);
+        break;
+    case MdBlock::Kind::Code:
+        add(MdFragment::Kind::CodeBack, 0, 0, width, 0);
+        indent = lh / 3;
+        break;
+    default:
+        break;
+    }
+    const size_t decorations = b.fragments.size();
+
+    // a capo automatico a parole; una parola piu' larga della riga si spezza
+    int x = indent, y = 0, lineH = lh;
+    bool lineEmpty = true;
+    auto newLine = [&] {
+        y += lineH;
+        x = indent;
+        lineH = lh;
+        lineEmpty = true;
+    };
+    auto emit = [&](size_t begin, size_t len, uint8_t style, int w) {
+        MdFragment* last = b.fragments.size() > decorations ? &b.fragments.back() : nullptr;
+        if (!lineEmpty && last && last->y == y && last->style == style && last->begin + last->length == begin) {
+            last->length += static_cast<uint32_t>(len);
+            last->w += w;
+        } else {
+            b.fragments.push_back(MdFragment{MdFragment::Kind::Text, style, x, y, w, m.lineHeight(style), static_cast<uint32_t>(begin), static_cast<uint32_t>(len)});
+        }
+        x += w;
+        lineH = std::max(lineH, m.lineHeight(style));
+        lineEmpty = false;
+    };
+    for (const MdRun& run : b.runs) {
+        if (run.style & kMdBreak) {
+            newLine();
+            continue;
+        }
+        size_t p = run.begin;
+        const size_t end = run.begin + run.length;
+        while (p < end) {
+            size_t q = p;
+            while (q < end && IsBlank(src[q])) ++q;
+            while (q < end && !IsBlank(src[q])) ++q;
+            int w = m.width(src.substr(p, q - p), run.style);
+            if (x + w > width && !lineEmpty) {
+                newLine();
+                while (p < q && IsBlank(src[p])) ++p;
+                if (p == q) continue;
+                w = m.width(src.substr(p, q - p), run.style);
+            }
+            if (x + w <= width) {
+                emit(p, q - p, run.style, w);
+                p = q;
+                continue;
+            }
+            while (p < q) {
+                // quanti caratteri stanno nel resto della riga (almeno uno)
+                size_t lo = 1, hi = q - p;
+                while (lo < hi) {
+                    const size_t mid = (lo + hi + 1) / 2;
+                    if (x + m.width(src.substr(p, mid), run.style) <= width) lo = mid;
+                    else hi = mid - 1;
+                }
+                emit(p, lo, run.style, m.width(src.substr(p, lo), run.style));
+                p += lo;
+                if (p < q) newLine();
+            }
+        }
+    }
+    b.height = y + lineH;
+    for (size_t k = 0; k < decorations; ++k) {
+        if (b.fragments[k].kind == MdFragment::Kind::QuoteBar || b.fragments[k].kind == MdFragment::Kind::CodeBack) b.fragments[k].h = b.height;
+    }
+    return b;
+}
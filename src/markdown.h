@@ -0,0 +1,91 @@
+#pragma once
+
+// Markdown in lettura per le tile senza focus: titoli, elenchi (anche con casella),
+// citazioni, blocchi di codice, linee, e nel testo grassetto, corsivo, `codice` e
+// [link](url). Gli a capo restano a capo, come nella EDIT.
+//
+// La nota si divide in blocchi (un titolo, un paragrafo, un elemento di elenco...)
+// che tengono solo offset nel testo. Update confronta il testo nuovo col vecchio
+// (prefisso e suffisso comuni) e rianalizza dal blocco toccato finche' i confini non
+// tornano a coincidere con quelli di prima; il resto si tiene spostando gli offset.
+// Il layout (a capo automatico, posizioni) e' in cache nel blocco per larghezza e
+// metriche: dopo una modifica si rifanno solo i blocchi cambiati, e chi disegna chiede
+// solo quelli che si vedono. La misura vera del testo sta in main.cpp.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// stile di un tratto: bit sotto, livello del titolo (1..6) nei bit alti
+constexpr uint8_t kMdBold = 1;
+constexpr uint8_t kMdItalic = 2;
+constexpr uint8_t kMdCode = 4;
+constexpr uint8_t kMdLink = 8;
+constexpr uint8_t kMdBreak = 16; // tratto vuoto: a capo
+constexpr int kMdHeadingShift = 5;
+inline int MdHeadingLevel(uint8_t style) { return style >> kMdHeadingShift; }
+
+struct MdMetrics {
+    std::function<int(std::wstring_view text, uint8_t style)> width; // px, a capo esclusi
+    std::function<int(uint8_t style)> lineHeight;
+    int version{0}; // cambia col font: tutti i layout da rifare
+};
+
+struct MdRun {
+    uint32_t begin{0}; // relativo all'inizio del blocco
+    uint32_t length{0};
+    uint8_t style{0};
+};
+
+struct MdFragment {
+    enum class Kind : uint8_t { Text, Bullet, Box, CheckedBox, Rule, QuoteBar, CodeBack };
+    Kind kind{Kind::Text};
+    uint8_t style{0};
+    int x{0}, y{0}, w{0}, h{0}; // relativi al blocco
+    uint32_t begin{0};          // Text: tratto del blocco da scrivere
+    uint32_t length{0};
+};
+
+struct MdBlock {
+    enum class Kind : uint8_t { Paragraph, Heading, Bullet, Numbered, Task, Quote, Code, Rule, Blank };
+    Kind kind{Kind::Paragraph};
+    uint8_t level{0};    // titolo: 1..6; elenchi: rientro; citazioni: profondita'
+    bool checked{false}; // Task
+    bool markup{false};  // qualcosa che la EDIT non saprebbe mostrare
+    size_t begin{0};     // righe della sorgente, a capo finale compreso
+    size_t length{0};
+    MdRun marker{};      // Numbered: "12." da scrivere davanti
+    std::vector<MdRun> runs;
+
+    // layout in cache
+    int layoutWidth{-1};
+    int layoutVersion{-1};
+    int height{0};
+    std::vector<MdFragment> fragments;
+};
+
+class MarkdownDoc {
+public:
+    void SetText(std::wstring_view text); // da zero
+    void Update(std::wstring_view text);  // testo nuovo: rianalizza solo i blocchi toccati
+
+    const std::wstring& Text() const { return text_; }
+    bool HasMarkup() const { return markupBlocks_ > 0; } // false: la EDIT basta
+    size_t BlockCount() const { return blocks_.size(); }
+    const MdBlock& Block(size_t i) const { return blocks_[i]; }
+    // layout del blocco i a quella larghezza, rifatto solo se blocco o metriche sono cambiati
+    const MdBlock& Layout(size_t i, int width, const MdMetrics& m);
+
+    size_t Parsed() const { return parsed_; } // blocchi analizzati finora (per le misure)
+
+private:
+    void Reparse(size_t at, size_t removed, size_t inserted);
+
+    std::wstring text_;
+    std::vector<MdBlock> blocks_;
+    size_t markupBlocks_{0};
+    size_t parsed_{0};
+};
@@ -0,0 +1,135 @@
+#include "memstats.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+struct Counters {
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> allocs{0};
+    std::atomic<int64_t> live{0};
+    std::atomic<int64_t> handles{0};
+    std::atomic<int64_t> items{0};
+};
+
+Counters g_counters[kMemAreaCount];
+
+Counters& At(MemArea area) { return g_counters[static_cast<size_t>(area)]; }
+
+const char* const kAreaNames[kMemAreaCount] = {"tiles", "tileText", "edits", "fonts", "paint", "brushes", "snapshots", "markdown", "thumbs"};
+
+constexpr int64_t kBytesTolerance = 64 * 1024; // sotto, e' rumore dell'heap
+
+void AppendStats(std::string& out, const MemAreaStats& a) {
+    out += "{\"bytes\":" + std::to_string(a.bytes) + ",\"allocs\":" + std::to_string(a.allocs) + ",\"live\":" + std::to_string(a.live) +
+           ",\"handles\":" + std::to_string(a.handles) + ",\"items\":" + std::to_string(a.items) + "}";
+}
+
+} // namespace
+
+const char* MemAreaName(MemArea area) {
+    const size_t i = static_cast<size_t>(area);
+    return i < kMemAreaCount ? kAreaNames[i] : "?";
+}
+
+void MemAlloc(MemArea area, size_t bytes) {
+    Counters& c = At(area);
+    c.bytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    c.live.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemFree(MemArea area, size_t bytes) {
+    Counters& c = At(area);
+    c.bytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    c.live.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void MemHandle(MemArea area, int delta) { At(area).handles.fetch_add(delta, std::memory_order_relaxed); }
+
+void MemSet(MemArea area, int64_t bytes, int64_t items) {
+    Counters& c = At(area);
+    c.bytes.store(bytes, std::memory_order_relaxed);
+    c.items.store(items, std::memory_order_relaxed);
+}
+
+void MemItems(MemArea area, int64_t items) { At(area).items.store(items, std::memory_order_relaxed); }
+
+MemAreaStats MemRead(MemArea area) {
+    const Counters& c = At(area);
+    MemAreaStats s;
+    s.bytes = c.bytes.load(std::memory_order_relaxed);
+    s.allocs = c.allocs.load(std::memory_order_relaxed);
+    s.live = c.live.load(std::memory_order_relaxed);
+    s.handles = c.handles.load(std::memory_order_relaxed);
+    s.items = c.items.load(std::memory_order_relaxed);
+    return s;
+}
+
+MemSample MemCapture(int64_t timeMs) {
+    MemSample s;
+    s.timeMs = timeMs;
+    for (size_t i = 0; i < kMemAreaCount; ++i) s.areas[i] = MemRead(static_cast<MemArea>(i));
+    return s;
+}
+
+std::string MemSampleJson(const MemSample& s) {
+    std::string out = "{\"t\":" + std::to_string(s.timeMs) + ",\"process\":{\"bytes\":" + std::to_string(s.processBytes) +
+                      ",\"gdi\":" + std::to_string(s.gdiHandles) + ",\"user\":" + std::to_string(s.userHandles) + "},\"areas\":{";
+    for (size_t i = 0; i < kMemAreaCount; ++i) {
+        if (i) out += ",";
+        out += "\"";
+        out += kAreaNames[i];
+        out += "\":";
+        AppendStats(out, s.areas[i]);
+    }
+    out += "}}";
+    return out;
+}
+
+void MemTrend::Add(const MemSample& s) {
+    samples_.push_back(s);
+    while (samples_.size() > window_) samples_.pop_front();
+}
+
+std::vector<std::string> MemTrend::Suspects() const {
+    std::vector<std::string> out;
+    if (samples_.size() < window_) return out;
+
+    // minimo di ogni quarto: deve salire (mai scendere) e alla fine superare la tolleranza.
+    // La tolleranza cresce col rumore (meta' dell'escursione del primo quarto): l'heap del
+    // processo oscilla di megabyte e una cache cambia numero di voci senza perdere niente.
+    auto rising = [&](const std::function<int64_t(const MemSample&)>& value, int64_t tolerance) {
+        int64_t mins[4];
+        int64_t firstMax = 0;
+        const size_t quarter = samples_.size() / 4;
+        for (size_t q = 0; q < 4; ++q) {
+            const size_t begin = q * quarter;
+            const size_t end = q == 3 ? samples_.size() : begin + quarter;
+            mins[q] = value(samples_[begin]);
+            for (size_t i = begin + 1; i < end; ++i) mins[q] = std::min(mins[q], value(samples_[i]));
+            if (q == 0) {
+                firstMax = mins[0];
+                for (size_t i = begin; i < end; ++i) firstMax = std::max(firstMax, value(samples_[i]));
+            }
+        }
+        for (size_t q = 1; q < 4; ++q) {
+            if (mins[q] < mins[q - 1]) return false;
+        }
+        tolerance = std::max(tolerance, (firstMax - mins[0]) / 2);
+        return mins[3] - mins[0] > tolerance;
+    };
+
+    if (rising([](const MemSample& s) { return s.processBytes; }, kBytesTolerance)) out.push_back("process.bytes");
+    if (rising([](const MemSample& s) { return s.gdiHandles; }, 0)) out.push_back("process.gdi");
+    if (rising([](const MemSample& s) { return s.userHandles; }, 0)) out.push_back("process.user");
+    for (size_t i = 0; i < kMemAreaCount; ++i) {
+        const std::string name = kAreaNames[i];
+        if (rising([i](const MemSample& s) { return s.areas[i].bytes; }, kBytesTolerance)) out.push_back(name + ".bytes");
+        if (rising([i](const MemSample& s) { return s.areas[i].live; }, 0)) out.push_back(name + ".live");
+        if (rising([i](const MemSample& s) { return s.areas[i].handles; }, 0)) out.push_back(name + ".handles");
+        if (rising([i](const MemSample& s) { return s.areas[i].items; }, 0)) out.push_back(name + ".items");
+    }
+    return out;
+}
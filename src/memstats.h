@@ -0,0 +1,107 @@
+#pragma once
+
+// Dove va la memoria: contatori per sottosistema di byte, allocazioni, handle e
+// oggetti vivi. I byte dei contenitori li conta TrackedAllocator; handle GDI e USER li
+// contano i wrapper in main.cpp (crea/distruggi), che sanno a quale area appartengono.
+// Quello che non passa da qui (testi dentro le EDIT, stringhe delle tile) si misura al
+// momento del campione con Set. I contatori sono atomici: si aggiornano da qualunque
+// thread, senza lock.
+//
+// MemTrend tiene gli ultimi campioni e segnala le crescite "a regime": il minimo di
+// ogni quarto della finestra non scende mai e alla fine e' salito oltre la tolleranza.
+// I picchi (un ridisegno, un gesto di zoom) non spostano i minimi; una perdita si'.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <new>
+#include <string>
+#include <vector>
+
+enum class MemArea : uint8_t {
+    Tiles,     // vettore delle tile
+    TileText,  // testi delle tile (misurati)
+    Edits,     // finestre EDIT vive e testo che tengono (misurato)
+    Fonts,
+    Paint,     // oggetti GDI di passaggio in WM_PAINT / WM_DRAWITEM
+    Brushes,   // pennelli che vivono quanto la finestra
+    Snapshots, // bitmap dello zoom
+    Markdown,  // testi e blocchi analizzati (misurati)
+    Thumbs,    // miniature degli allegati in memoria (dalla loro LRU)
+    Count
+};
+constexpr size_t kMemAreaCount = static_cast<size_t>(MemArea::Count);
+const char* MemAreaName(MemArea area);
+
+struct MemAreaStats {
+    int64_t bytes{0};   // vivi
+    int64_t allocs{0};  // allocazioni fatte da sempre
+    int64_t live{0};    // allocazioni non ancora liberate
+    int64_t handles{0}; // handle GDI/USER vivi
+    int64_t items{0};   // oggetti dell'area (tile, EDIT, documenti...)
+};
+
+void MemAlloc(MemArea area, size_t bytes);
+void MemFree(MemArea area, size_t bytes);
+void MemHandle(MemArea area, int delta);
+void MemSet(MemArea area, int64_t bytes, int64_t items); // aree misurate: valori assoluti
+void MemItems(MemArea area, int64_t items);              // aree coi byte contati: solo gli oggetti
+MemAreaStats MemRead(MemArea area);
+
+// Allocatore che conta i byte nell'area A e poi usa new/delete.
+template <class T, MemArea A>
+struct TrackedAllocator {
+    using value_type = T;
+    template <class U>
+    struct rebind {
+        using other = TrackedAllocator<U, A>;
+    };
+
+    TrackedAllocator() noexcept = default;
+    template <class U>
+    TrackedAllocator(const TrackedAllocator<U, A>&) noexcept {}
+
+    T* allocate(size_t n) {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+        MemAlloc(A, n * sizeof(T));
+        return p;
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        MemFree(A, n * sizeof(T));
+        ::operator delete(p);
+    }
+
+    template <class U>
+    bool operator==(const TrackedAllocator<U, A>&) const noexcept { return true; }
+};
+
+struct MemSample {
+    int64_t timeMs{0};
+    MemAreaStats areas[kMemAreaCount]{};
+    int64_t processBytes{0}; // memoria privata del processo (dal sistema)
+    int64_t gdiHandles{0};   // handle GDI del processo (dal sistema)
+    int64_t userHandles{0};
+};
+
+// Contatori attuali (le aree misurate valgono l'ultimo MemSet); il resto lo mette chi chiama.
+MemSample MemCapture(int64_t timeMs);
+// {"t":...,"process":{...},"areas":{"tiles":{...},...}}
+std::string MemSampleJson(const MemSample& s);
+
+class MemTrend {
+public:
+    explicit MemTrend(size_t window = 96) : window_(window < 8 ? 8 : window) {}
+
+    void Add(const MemSample& s);
+    size_t Size() const { return samples_.size(); }
+    const MemSample* Last() const { return samples_.empty() ? nullptr : &samples_.back(); }
+
+    // contatori che crescono a regime ("process.gdi", "fonts.handles", "tiles.bytes"...);
+    // vuoto finche' la finestra non e' piena
+    std::vector<std::string> Suspects() const;
+
+private:
+    size_t window_;
+    std::deque<MemSample> samples_;
+};
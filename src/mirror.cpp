@@ -0,0 +1,120 @@
+#include "mirror.h"
+
+#include "statefile.h"
+#include "textutil.h"
+
+#include <system_error>
+
+uint64_t MirrorIdFromName(const std::filesystem::path& name) {
+    if (name.extension() != ".md" || name.has_parent_path()) return 0;
+    const std::string stem = name.stem().string();
+    if (stem.empty() || stem.size() > 19) return 0;
+    uint64_t id = 0;
+    for (char c : stem) {
+        if (c < '0' || c > '9') return 0;
+        id = id * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return id;
+}
+
+bool MarkdownMirror::Open(const std::filesystem::path& dir) {
+    dir_ = dir;
+    hashes_.clear();
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    return std::filesystem::is_directory(dir_, ec);
+}
+
+std::filesystem::path MarkdownMirror::PathOf(uint64_t id) const { return dir_ / (std::to_string(id) + ".md"); }
+
+bool MarkdownMirror::Export(uint64_t id, const std::string& bytes) {
+    const uint64_t hash = ContentHash64(bytes);
+    auto it = hashes_.find(id);
+    if (it != hashes_.end() && it->second == hash) return true;
+    if (!WriteFileAtomic(PathOf(id), bytes)) return false;
+    hashes_[id] = hash;
+    return true;
+}
+
+void MarkdownMirror::Remove(uint64_t id) {
+    // prima si dimentica: la notifica della rimozione non deve sembrare fatta da fuori
+    hashes_.erase(id);
+    std::error_code ec;
+    std::filesystem::remove(PathOf(id), ec);
+}
+
+std::vector<uint64_t> MarkdownMirror::Ids() const {
+    std::vector<uint64_t> ids;
+    ids.reserve(hashes_.size());
+    for (const auto& [id, hash] : hashes_) ids.push_back(id);
+    return ids;
+}
+
+bool MarkdownMirror::ReadInto(uint64_t id, MirrorFile& f) {
+    f.id = id;
+    std::error_code ec;
+    f.modified = std::filesystem::last_write_time(PathOf(id), ec);
+    f.deleted = !ReadWholeFile(PathOf(id), f.bytes);
+    return !f.deleted;
+}
+
+std::vector<MirrorFile> MarkdownMirror::Scan() {
+    std::vector<MirrorFile> files;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        const uint64_t id = MirrorIdFromName(it->path().filename());
+        MirrorFile f;
+        if (id == 0 || !ReadInto(id, f)) continue;
+        hashes_[id] = ContentHash64(f.bytes);
+        files.push_back(std::move(f));
+    }
+    return files;
+}
+
+void MarkdownMirror::Notify(const std::filesystem::path& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (name.empty()) {
+        rescan_ = true;
+        return;
+    }
+    // i .tmp della scrittura atomica e i file non di tile non interessano
+    const uint64_t id = MirrorIdFromName(name);
+    if (id != 0) pending_.insert(id);
+}
+
+std::vector<MirrorFile> MarkdownMirror::TakeChanges() {
+    std::unordered_set<uint64_t> pending;
+    bool rescan = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(pending_);
+        std::swap(rescan, rescan_);
+    }
+    if (rescan) {
+        // notifiche perse: si confronta tutto, file spariti compresi
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+            const uint64_t id = MirrorIdFromName(it->path().filename());
+            if (id != 0) pending.insert(id);
+        }
+        for (const auto& [id, hash] : hashes_) pending.insert(id);
+    }
+
+    std::vector<MirrorFile> changes;
+    for (uint64_t id : pending) {
+        MirrorFile f;
+        auto known = hashes_.find(id);
+        if (!ReadInto(id, f)) {
+            // sparito: conta solo se era nostro (Remove l'ha gia' dimenticato)
+            if (known == hashes_.end()) continue;
+            hashes_.erase(known);
+            changes.push_back(std::move(f));
+            continue;
+        }
+        const uint64_t hash = ContentHash64(f.bytes);
+        if (known != hashes_.end() && known->second == hash) continue; // e' quello scritto da noi
+        hashes_[id] = hash;
+        changes.push_back(std::move(f));
+    }
+    return changes;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Copia delle tile come file Markdown in una cartella (<id>.md, un file per tile),
+// in tutte e due le direzioni. Si ricorda l'hash di ogni file scritto o letto: un
+// salvataggio scrive solo i file il cui contenuto e' cambiato, e una notifica della
+// cartella fa leggere solo il file toccato (le proprie scritture tornano indietro con
+// lo stesso hash e si scartano). La cartella intera si rilegge solo all'avvio o se le
+// notifiche sono andate perse.
+// Notify si chiama dal thread del watcher, tutto il resto dal thread UI.
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct MirrorFile {
+    uint64_t id{0};
+    bool deleted{false}; // sparito da fuori
+    std::string bytes;
+    std::filesystem::file_time_type modified{};
+};
+
+class MarkdownMirror {
+public:
+    bool Open(const std::filesystem::path& dir);
+    const std::filesystem::path& Dir() const { return dir_; }
+    std::filesystem::path PathOf(uint64_t id) const;
+
+    // false solo se la scrittura fallisce; nessuna scrittura se il file e' gia' cosi'
+    bool Export(uint64_t id, const std::string& bytes);
+    void Remove(uint64_t id);
+    bool Has(uint64_t id) const { return hashes_.count(id) != 0; }
+    std::vector<uint64_t> Ids() const;
+
+    // tutti i <id>.md della cartella, letti (all'avvio)
+    std::vector<MirrorFile> Scan();
+
+    // nome relativo alla cartella; vuoto = non si sa cosa e' cambiato
+    void Notify(const std::filesystem::path& name);
+    // file cambiati da fuori dalle notifiche arrivate finora
+    std::vector<MirrorFile> TakeChanges();
+
+private:
+    bool ReadInto(uint64_t id, MirrorFile& f);
+
+    std::filesystem::path dir_;
+    std::unordered_map<uint64_t, uint64_t> hashes_; // id -> hash dell'ultimo contenuto scritto o letto
+
+    std::mutex mutex_;
+    std::unordered_set<uint64_t> pending_;
+    bool rescan_{false};
+};
+
+// id dal nome "<id>.md", 0 se il nome non e' di una tile
+uint64_t MirrorIdFromName(const std::filesystem::path& name);
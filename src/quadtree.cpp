@@ -0,0 +1,144 @@
+#include "quadtree.h"
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+namespace {
+
+bool Intersects(const CellRect& a, const CellRect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+// centro della tile, mai negativo (il mondo parte da 0)
+int CenterX(const CellRect& r) { return std::max(0, r.x + r.w / 2); }
+int CenterY(const CellRect& r) { return std::max(0, r.y + r.h / 2); }
+
+} // namespace
+
+int TileQuadtree::SizeFor(const CellRect& r) {
+    const int side = std::max(r.w, r.h);
+    int s = kMinNodeCells;
+    while (s < side && s < (INT_MAX >> 1)) s <<= 1;
+    return s;
+}
+
+void TileQuadtree::Clear() {
+    nodes_.clear();
+    where_.clear();
+    rootSize_ = 0;
+}
+
+int TileQuadtree::NewChildren(int parent) {
+    const int first = static_cast<int>(nodes_.size());
+    const int half = nodes_[parent].size / 2;
+    const int px = nodes_[parent].x;
+    const int py = nodes_[parent].y;
+    nodes_.resize(nodes_.size() + 4);
+    for (int i = 0; i < 4; ++i) {
+        Node& c = nodes_[first + i];
+        c.x = px + (i & 1) * half;
+        c.y = py + (i >> 1) * half;
+        c.size = half;
+    }
+    nodes_[parent].child = first;
+    return first;
+}
+
+void TileQuadtree::GrowToCover(const CellRect& r) {
+    const int need = std::max({SizeFor(r), CenterX(r) + 1, CenterY(r) + 1});
+    if (nodes_.empty()) {
+        rootSize_ = kMinNodeCells;
+        while (rootSize_ < need) rootSize_ <<= 1;
+        nodes_.push_back(Node{0, 0, rootSize_, -1, {}});
+        return;
+    }
+    while (rootSize_ < need) {
+        // la vecchia radice diventa il figlio NW della nuova: si sposta in fondo e la
+        // posizione 0 resta alla radice, cosi' gli indici dei nodi sotto non cambiano
+        Node old = std::move(nodes_[0]);
+        rootSize_ <<= 1;
+        nodes_[0] = Node{0, 0, rootSize_, -1, {}};
+        const int first = NewChildren(0);
+        const int oldChild = old.child;
+        nodes_[first] = std::move(old);
+        nodes_[first].child = oldChild;
+        for (const Item& it : nodes_[first].items) where_[it.id] = first;
+    }
+}
+
+int TileQuadtree::FindOrCreate(const CellRect& r) {
+    GrowToCover(r);
+    const int target = SizeFor(r);
+    const int cx = CenterX(r);
+    const int cy = CenterY(r);
+    int node = 0;
+    while (nodes_[node].size > target) {
+        const int half = nodes_[node].size / 2;
+        const int quadrant = (cx >= nodes_[node].x + half ? 1 : 0) + (cy >= nodes_[node].y + half ? 2 : 0);
+        const int first = nodes_[node].child >= 0 ? nodes_[node].child : NewChildren(node);
+        node = first + quadrant;
+    }
+    return node;
+}
+
+void TileQuadtree::Insert(uint64_t id, const CellRect& r) {
+    if (where_.count(id)) Remove(id);
+    const int node = FindOrCreate(r);
+    nodes_[node].items.push_back(Item{id, r});
+    where_[id] = node;
+}
+
+void TileQuadtree::Remove(uint64_t id) {
+    auto it = where_.find(id);
+    if (it == where_.end()) return;
+    auto& items = nodes_[it->second].items;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].id != id) continue;
+        items[i] = items.back();
+        items.pop_back();
+        break;
+    }
+    // i nodi vuoti restano: la memoria segue l'area usata, non le modifiche
+    where_.erase(it);
+}
+
+void TileQuadtree::Move(uint64_t id, const CellRect& r) {
+    auto it = where_.find(id);
+    if (it != where_.end()) {
+        // stesso nodo (stessa classe di dimensione, centro nello stesso quadrato): si aggiorna sul posto
+        const Node& n = nodes_[it->second];
+        const int cx = CenterX(r);
+        const int cy = CenterY(r);
+        if (SizeFor(r) == n.size && cx >= n.x && cx < n.x + n.size && cy >= n.y && cy < n.y + n.size) {
+            for (Item& item : nodes_[it->second].items) {
+                if (item.id == id) {
+                    item.rect = r;
+                    return;
+                }
+            }
+        }
+    }
+    Insert(id, r);
+}
+
+void TileQuadtree::Query(const CellRect& r, std::vector<uint64_t>& out) const {
+    out.clear();
+    if (nodes_.empty() || r.w <= 0 || r.h <= 0) return;
+
+    int stack[128];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& n = nodes_[stack[--top]];
+        // limiti "loose": mezzo lato in piu' per parte
+        const int pad = n.size / 2;
+        if (!Intersects(CellRect{n.x - pad, n.y - pad, n.size + 2 * pad, n.size + 2 * pad}, r)) continue;
+        for (const Item& it : n.items) {
+            if (Intersects(it.rect, r)) out.push_back(it.id);
+        }
+        if (n.child >= 0) {
+            for (int i = 0; i < 4; ++i) stack[top++] = n.child + i;
+        }
+    }
+}
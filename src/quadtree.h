@@ -0,0 +1,52 @@
+#pragma once
+
+// Tile nello spazio del mondo (celle, coordinate >= 0, senza limite verso destra e
+// verso il basso): quadtree "loose". Una tile sta nel nodo piu' piccolo con lato
+// >= del suo lato maggiore che ne contiene il centro; i limiti del nodo allargati
+// di mezzo lato per parte la contengono tutta. Una query sulla viewport visita
+// solo i nodi vicini all'area cercata, quindi layout, disegno e hit-test costano
+// in base alle tile visibili e non al totale.
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "layoutcheck.h" // CellRect
+
+class TileQuadtree {
+public:
+    static constexpr int kMinNodeCells = 8; // lato delle foglie
+
+    void Clear();
+    void Insert(uint64_t id, const CellRect& r);
+    void Remove(uint64_t id);
+    void Move(uint64_t id, const CellRect& r);
+
+    size_t Size() const { return where_.size(); }
+    int RootCells() const { return rootSize_; } // lato coperto dalla radice (potenza di due)
+
+    // tile che intersecano r, senza ordine; out viene svuotato
+    void Query(const CellRect& r, std::vector<uint64_t>& out) const;
+
+private:
+    struct Item {
+        uint64_t id;
+        CellRect rect;
+    };
+    struct Node {
+        int x{0};
+        int y{0};
+        int size{0};
+        int child{-1}; // primo dei 4 figli consecutivi (NW, NE, SW, SE), -1 = nessuno
+        std::vector<Item> items;
+    };
+
+    static int SizeFor(const CellRect& r);
+    int NewChildren(int parent);
+    int FindOrCreate(const CellRect& r); // nodo che deve contenere r (crea il percorso)
+    void GrowToCover(const CellRect& r);
+
+    std::vector<Node> nodes_; // nodes_[0] e' la radice, in (0, 0)
+    int rootSize_{0};
+    std::unordered_map<uint64_t, int> where_; // id -> nodo
+};
@@ -0,0 +1,1061 @@
+#include "searchindex.h"
+
+#include "mappedfile.h"
+#include "sha256.h"
+#include "statefile.h"
+#include "textseg.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr size_t kMaxTermBytes = 64;     // piu' lunghi: base64, hash, righe di log; non si cercano
+constexpr size_t kPreviewBytes = 240;
+constexpr size_t kFlushDocs = 8192;      // memtable -> segmento
+constexpr size_t kFlushBytes = 16 << 20; // testo passato dalla memtable
+constexpr auto kFlushAfter = std::chrono::seconds(60);
+constexpr size_t kMergeFactor = 4;       // segmenti della stessa taglia da fondere insieme
+constexpr size_t kMaxSegments = 12;      // oltre si fondono i piu' piccoli
+constexpr double kBm25K1 = 1.2;
+constexpr double kBm25B = 0.75;
+constexpr uint32_t kMaxExpansions = 64; // termini per prefisso e segmento, i primi in ordine
+
+// ---------------------------------------------------------------- termini
+
+// lettera base delle lettere accentate minuscole ('.': nessuna, resta com'e')
+constexpr char kLatin1Base[] = "aaaaaa.ceeeeiiii.nooooo.ouuuuy.y"; // U+00E0..U+00FF
+constexpr char kLatinExtABase[] =                                   // U+0100..U+017F
+    "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii..jjkkklllllll"
+    "lllnnnnnnnnnoooooo..rrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+
+bool IsIdeograph(uint32_t c) {
+    return (c >= 0x3040 && c <= 0x30FF) || (c >= 0x3400 && c <= 0x4DBF) || (c >= 0x4E00 && c <= 0x9FFF) ||
+           (c >= 0xF900 && c <= 0xFAFF) || (c >= 0x20000 && c <= 0x2FFFF);
+}
+
+bool IsCombiningMark(uint32_t c) { return c >= 0x300 && c <= 0x36F; }
+
+// lettere e cifre fuori dall'ASCII: tutto tranne punteggiatura, simboli, spazi ed emoji
+bool IsTermChar(uint32_t c) {
+    if (c < 0xC0) return false;
+    if (c == 0xD7 || c == 0xF7) return false;
+    if (c >= 0x2000 && c <= 0x2BFF) return false; // punteggiatura, frecce, simboli, box
+    if (c >= 0x2E00 && c <= 0x2E7F) return false;
+    if (c >= 0x3000 && c <= 0x303F) return false; // punteggiatura CJK
+    if (c >= 0xD800 && c <= 0xF8FF) return false; // surrogati, uso privato
+    if (c >= 0xFE30 && c <= 0xFE6F) return false;
+    if ((c >= 0xFF00 && c <= 0xFF0F) || (c >= 0xFF1A && c <= 0xFF20) || (c >= 0xFF3B && c <= 0xFF40) || (c >= 0xFF5B && c <= 0xFF65)) return false;
+    if (c >= 0xFFF0 && c <= 0xFFFF) return false;
+    if (c == 0xFEFF) return false;
+    return c < 0x1F000; // emoji e simboli del piano 1
+}
+
+uint32_t FoldTermChar(uint32_t c) {
+    if (c < 0x10000) c = FoldCase(static_cast<char16_t>(c));
+    if (c >= 0xE0 && c <= 0xFF && kLatin1Base[c - 0xE0] != '.') return static_cast<uint32_t>(kLatin1Base[c - 0xE0]);
+    if (c >= 0x100 && c <= 0x17F && kLatinExtABase[c - 0x100] != '.') return static_cast<uint32_t>(kLatinExtABase[c - 0x100]);
+    return c;
+}
+
+void AppendCodePoint(std::string& out, uint32_t c) {
+    if (c < 0x80) {
+        out.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+
+// carattere non ASCII che comincia in s[i]; i va oltre. Le sequenze rotte valgono U+FFFD.
+uint32_t DecodeUtf8(std::string_view s, size_t& i) {
+    const auto byte = [&](size_t k) { return static_cast<unsigned char>(s[k]); };
+    const unsigned char b = byte(i);
+    size_t n = 0;
+    uint32_t c = 0;
+    if (b >= 0xC2 && b <= 0xDF) n = 1, c = b & 0x1F;
+    else if (b >= 0xE0 && b <= 0xEF) n = 2, c = b & 0x0F;
+    else if (b >= 0xF0 && b <= 0xF4) n = 3, c = b & 0x07;
+    if (n == 0 || i + n >= s.size()) {
+        ++i;
+        return 0xFFFD;
+    }
+    for (size_t k = 1; k <= n; ++k) {
+        if ((byte(i + k) & 0xC0) != 0x80) {
+            ++i;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (byte(i + k) & 0x3F);
+    }
+    i += n + 1;
+    return c;
+}
+
+bool IsContinuation(char ch) { return (static_cast<unsigned char>(ch) & 0xC0) == 0x80; }
+
+// taglio a un confine di carattere, non oltre at
+size_t Utf8Floor(std::string_view s, size_t at) {
+    if (at >= s.size()) return s.size();
+    while (at > 0 && IsContinuation(s[at])) --at;
+    return at;
+}
+
+// f(termine, inizio, fine): i byte del testo da cui viene il termine
+template <class F>
+void ForEachTerm(std::string_view s, F&& f) {
+    std::string term;
+    size_t begin = 0;
+    size_t chars = 0;
+    const auto emit = [&](size_t end) {
+        if (!term.empty() && term.size() <= kMaxTermBytes && (chars > 1 || static_cast<unsigned char>(term[0]) >= 0x80))
+            f(std::string_view(term), begin, end);
+        term.clear();
+        chars = 0;
+    };
+    size_t i = 0;
+    while (i < s.size()) {
+        const unsigned char b = static_cast<unsigned char>(s[i]);
+        if (b < 0x80) {
+            const bool lower = b >= 'a' && b <= 'z';
+            const bool upper = b >= 'A' && b <= 'Z';
+            if (lower || upper || (b >= '0' && b <= '9')) {
+                if (term.empty()) begin = i;
+                term.push_back(static_cast<char>(upper ? b + 32 : b));
+                ++chars;
+            } else {
+                emit(i);
+            }
+            ++i;
+            continue;
+        }
+        const size_t at = i;
+        const uint32_t c = DecodeUtf8(s, i);
+        if (IsCombiningMark(c)) continue; // accento scritto a parte: via come quelli composti
+        if (IsIdeograph(c)) {
+            emit(at);
+            begin = at;
+            AppendCodePoint(term, c);
+            chars = 1;
+            emit(i);
+            continue;
+        }
+        if (!IsTermChar(c)) {
+            emit(at);
+            continue;
+        }
+        if (term.empty()) begin = at;
+        AppendCodePoint(term, FoldTermChar(c));
+        ++chars;
+    }
+    emit(s.size());
+}
+
+struct QueryTerm {
+    std::string text;
+    bool prefix{false};
+};
+
+// l'ultimo termine vale anche come inizio di parola se la ricerca finisce li' (si sta scrivendo)
+std::vector<QueryTerm> ParseQuery(std::string_view query) {
+    std::vector<QueryTerm> terms;
+    ForEachTerm(query, [&](std::string_view t, size_t, size_t end) {
+        for (auto& q : terms) {
+            if (q.text == t) return;
+        }
+        terms.push_back(QueryTerm{std::string(t), end == query.size()});
+    });
+    for (size_t i = 0; i + 1 < terms.size(); ++i) terms[i].prefix = false;
+    return terms;
+}
+
+bool TermMatches(const QueryTerm& q, std::string_view t) {
+    return q.prefix ? t.substr(0, q.text.size()) == q.text : t == q.text;
+}
+
+// ---------------------------------------------------------------- varint e hash
+
+void PutVarint(std::string& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool GetVarint(const unsigned char*& p, const unsigned char* end, uint32_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        const unsigned char b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool ParseSha(const std::string& hex, uint8_t out[32]) {
+    if (hex.size() != 64) return false;
+    for (size_t i = 0; i < 32; ++i) {
+        const int hi = HexDigit(hex[2 * i]);
+        const int lo = HexDigit(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = static_cast<uint8_t>(hi << 4 | lo);
+    }
+    return true;
+}
+
+std::string ShaHex(const uint8_t sha[32]) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string hex(64, '0');
+    for (size_t i = 0; i < 32; ++i) {
+        hex[2 * i] = kDigits[sha[i] >> 4];
+        hex[2 * i + 1] = kDigits[sha[i] & 15];
+    }
+    return hex;
+}
+
+uint64_t VersionKey(const uint8_t sha[32], uint64_t tileId) {
+    uint64_t h = 0;
+    std::memcpy(&h, sha, sizeof h);
+    return h ^ (tileId * 0x9E3779B97F4A7C15ull);
+}
+
+std::string_view PreviewOf(std::string_view utf8) { return utf8.substr(0, Utf8Floor(utf8, kPreviewBytes)); }
+
+} // namespace
+
+// ---------------------------------------------------------------- segmento
+
+// Formato (little-endian, offset dall'inizio del file):
+//   Header 64 byte | Doc x docs | lunghezze (uint32 x docs) | anteprime | occorrenze |
+//   Term x terms | byte dei termini
+// Le lunghezze (in termini) stanno a parte perche' BM25 le legge per ogni occorrenza: 4 byte
+// di fila per documento invece di una riga di cache.
+// Le occorrenze di un termine vanno da Term::postings al postings del successivo (l'ultimo
+// fino alla tabella dei termini): coppie varint (delta del doc, occorrenze), doc crescenti.
+class SearchSegment {
+public:
+    struct Header {
+        char magic[8];
+        uint32_t docs;
+        uint32_t terms;
+        uint64_t tokens; // somma delle lunghezze: lunghezza media per BM25
+        uint64_t previews;
+        uint64_t postings;
+        uint64_t termTable;
+        uint64_t termStrings;
+        uint64_t size;
+    };
+    struct Doc {
+        uint8_t sha[32];
+        uint64_t tileId;
+        int64_t time;
+        uint64_t preview;
+        uint32_t previewLength;
+        uint32_t reserved;
+    };
+    struct Term {
+        uint64_t postings;
+        uint64_t string;
+        uint32_t length;
+        uint32_t docs;
+    };
+    using Posting = std::pair<uint32_t, uint32_t>; // doc, occorrenze
+
+    SearchSegment() = default;
+    ~SearchSegment();
+
+    bool Open(const std::filesystem::path& path, uint64_t gen);
+    bool Load(std::string bytes); // memtable: niente file
+    void MarkObsolete() const { obsolete_ = true; }
+
+    uint64_t Gen() const { return gen_; }
+    uint64_t Bytes() const { return file_.Size(); }
+    uint32_t Docs() const { return header_.docs; }
+    uint64_t Tokens() const { return header_.tokens; }
+    const Doc& DocAt(uint32_t i) const { return docs_[i]; }
+    uint32_t Length(uint32_t i) const { return lengths_[i]; }
+    std::string_view Preview(const Doc& d) const { return {reinterpret_cast<const char*>(data_ + d.preview), d.previewLength}; }
+
+    uint32_t Terms() const { return header_.terms; }
+    Term TermAt(uint32_t i) const {
+        Term t;
+        std::memcpy(&t, data_ + header_.termTable + static_cast<uint64_t>(i) * sizeof(Term), sizeof t);
+        return t;
+    }
+    std::string_view TermText(const Term& t) const { return {reinterpret_cast<const char*>(data_ + t.string), t.length}; }
+    // [first, last) dei termini che corrispondono (uno solo se non e' un prefisso)
+    std::pair<uint32_t, uint32_t> Range(const QueryTerm& q) const;
+    // occorrenze grezze del termine i
+    std::string_view RawPostings(uint32_t i) const;
+    template <class F>
+    void ForEachPosting(uint32_t i, F&& f) const; // f(doc, occorrenze), doc crescenti
+    void Postings(uint32_t i, std::vector<Posting>& out) const { ForEachPosting(i, [&](uint32_t doc, uint32_t tf) { out.emplace_back(doc, tf); }); }
+
+private:
+    bool Validate();
+
+    MappedFile file_;
+    std::string memory_;
+    const unsigned char* data_{nullptr};
+    size_t size_{0};
+    Header header_{};
+    const Doc* docs_{nullptr};
+    const uint32_t* lengths_{nullptr};
+    std::filesystem::path path_;
+    uint64_t gen_{0};
+    mutable std::atomic<bool> obsolete_{false};
+};
+
+static_assert(sizeof(SearchSegment::Header) == 64, "header di 64 byte");
+static_assert(sizeof(SearchSegment::Doc) == 64, "documenti allineati a 8");
+static_assert(sizeof(SearchSegment::Term) == 24, "termini di 24 byte");
+
+namespace {
+
+constexpr char kSegmentMagic[8] = {'G', 'N', 'I', 'D', 'X', '0', '0', '1'};
+
+// Scrive un segmento in memoria o su file, in ordine: prima tutti i documenti (AddDoc),
+// poi le loro anteprime nello stesso ordine (AddPreview), poi i termini in ordine con le
+// occorrenze gia' codificate (AddTerm). La tabella dei termini resta in memoria fino a Finish.
+class SegmentWriter {
+public:
+    SegmentWriter(uint32_t docs, std::ofstream* file) : file_(file) {
+        header_ = {};
+        std::memcpy(header_.magic, kSegmentMagic, sizeof kSegmentMagic);
+        header_.docs = docs;
+        header_.previews = sizeof(SearchSegment::Header) + static_cast<uint64_t>(docs) * (sizeof(SearchSegment::Doc) + sizeof(uint32_t));
+        Put(&header_, sizeof header_);
+        nextPreview_ = header_.previews;
+    }
+
+    void AddDoc(const uint8_t sha[32], uint64_t tileId, int64_t time, uint32_t length, size_t previewLength) {
+        SearchSegment::Doc d{};
+        std::memcpy(d.sha, sha, sizeof d.sha);
+        d.tileId = tileId;
+        d.time = time;
+        d.previewLength = static_cast<uint32_t>(previewLength);
+        d.preview = nextPreview_;
+        nextPreview_ += previewLength;
+        header_.tokens += length;
+        lengths_.push_back(length);
+        Put(&d, sizeof d);
+    }
+
+    void AddPreview(std::string_view preview) {
+        EndDocs();
+        Put(preview.data(), preview.size());
+    }
+
+    void AddTerm(std::string_view term, uint32_t docs, std::string_view postings) {
+        EndDocs();
+        if (header_.postings == 0) header_.postings = pos_;
+        terms_.push_back(SearchSegment::Term{pos_, strings_.size(), static_cast<uint32_t>(term.size()), docs});
+        strings_.append(term);
+        Put(postings.data(), postings.size());
+    }
+
+    bool Finish() {
+        EndDocs();
+        if (header_.postings == 0) header_.postings = pos_;
+        header_.terms = static_cast<uint32_t>(terms_.size());
+        header_.termTable = pos_;
+        header_.termStrings = pos_ + terms_.size() * sizeof(SearchSegment::Term);
+        for (auto& t : terms_) t.string += header_.termStrings;
+        Put(terms_.data(), terms_.size() * sizeof(SearchSegment::Term));
+        Put(strings_.data(), strings_.size());
+        header_.size = pos_;
+        if (file_) {
+            file_->seekp(0);
+            file_->write(reinterpret_cast<const char*>(&header_), sizeof header_);
+            file_->flush();
+            return static_cast<bool>(*file_);
+        }
+        std::memcpy(memory_.data(), &header_, sizeof header_);
+        return true;
+    }
+
+    std::string& Memory() { return memory_; }
+
+private:
+    void EndDocs() {
+        if (lengthsDone_) return;
+        Put(lengths_.data(), lengths_.size() * sizeof(uint32_t));
+        lengths_ = {};
+        lengthsDone_ = true;
+    }
+
+    void Put(const void* p, size_t n) {
+        if (file_) file_->write(static_cast<const char*>(p), static_cast<std::streamsize>(n));
+        else memory_.append(static_cast<const char*>(p), n);
+        pos_ += n;
+    }
+
+    std::ofstream* file_;
+    std::string memory_;
+    SearchSegment::Header header_;
+    uint64_t pos_{0};
+    uint64_t nextPreview_{0};
+    std::vector<uint32_t> lengths_;
+    bool lengthsDone_{false};
+    std::vector<SearchSegment::Term> terms_;
+    std::string strings_;
+};
+
+} // namespace
+
+SearchSegment::~SearchSegment() {
+    if (!obsolete_ || path_.empty()) return;
+    file_.Close(); // su Windows un file mappato non si cancella
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+}
+
+bool SearchSegment::Open(const std::filesystem::path& path, uint64_t gen) {
+    if (!file_.Open(path)) return false;
+    path_ = path;
+    gen_ = gen;
+    data_ = file_.Data();
+    size_ = file_.Size();
+    return Validate();
+}
+
+bool SearchSegment::Load(std::string bytes) {
+    memory_ = std::move(bytes);
+    data_ = reinterpret_cast<const unsigned char*>(memory_.data());
+    size_ = memory_.size();
+    return Validate();
+}
+
+// un segmento rotto (disco pieno, file troncato) si scarta intero: mai letture fuori
+bool SearchSegment::Validate() {
+    if (size_ < sizeof(Header)) return false;
+    std::memcpy(&header_, data_, sizeof header_);
+    const Header& h = header_;
+    if (std::memcmp(h.magic, kSegmentMagic, sizeof h.magic) != 0 || h.size != size_) return false;
+    if (h.previews != sizeof(Header) + static_cast<uint64_t>(h.docs) * (sizeof(Doc) + sizeof(uint32_t))) return false;
+    if (!(h.previews <= h.postings && h.postings <= h.termTable && h.termTable <= h.termStrings && h.termStrings <= h.size)) return false;
+    if (h.termStrings - h.termTable != static_cast<uint64_t>(h.terms) * sizeof(Term)) return false;
+    docs_ = reinterpret_cast<const Doc*>(data_ + sizeof(Header));
+    lengths_ = reinterpret_cast<const uint32_t*>(data_ + sizeof(Header) + static_cast<uint64_t>(h.docs) * sizeof(Doc));
+    for (uint32_t i = 0; i < h.docs; ++i) {
+        const Doc& d = docs_[i];
+        if (d.preview < h.previews || d.preview + d.previewLength > h.postings) return false;
+    }
+    uint64_t previous = h.postings;
+    for (uint32_t i = 0; i < h.terms; ++i) {
+        const Term t = TermAt(i);
+        if (t.postings < previous || t.postings > h.termTable) return false;
+        if (t.string < h.termStrings || t.string + t.length > h.size) return false;
+        previous = t.postings;
+    }
+    return true;
+}
+
+std::pair<uint32_t, uint32_t> SearchSegment::Range(const QueryTerm& q) const {
+    uint32_t lo = 0;
+    uint32_t hi = header_.terms;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (TermText(TermAt(mid)) < std::string_view(q.text)) lo = mid + 1;
+        else hi = mid;
+    }
+    uint32_t end = lo;
+    if (!q.prefix) {
+        if (end < header_.terms && TermText(TermAt(end)) == q.text) ++end;
+        return {lo, end};
+    }
+    hi = std::min(header_.terms, lo + kMaxExpansions); // i termini col prefisso sono di fila: il primo che non ce l'ha
+    while (end < hi) {
+        const uint32_t mid = end + (hi - end) / 2;
+        if (TermMatches(q, TermText(TermAt(mid)))) end = mid + 1;
+        else hi = mid;
+    }
+    return {lo, end};
+}
+
+std::string_view SearchSegment::RawPostings(uint32_t i) const {
+    const uint64_t begin = TermAt(i).postings;
+    const uint64_t end = i + 1 < header_.terms ? TermAt(i + 1).postings : header_.termTable;
+    return {reinterpret_cast<const char*>(data_ + begin), static_cast<size_t>(end - begin)};
+}
+
+template <class F>
+void SearchSegment::ForEachPosting(uint32_t i, F&& f) const {
+    const std::string_view raw = RawPostings(i);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(raw.data());
+    const unsigned char* end = p + raw.size();
+    uint32_t doc = 0;
+    bool first = true;
+    while (p < end) {
+        uint32_t delta = 0;
+        uint32_t tf = 0;
+        if (!GetVarint(p, end, delta) || !GetVarint(p, end, tf)) return;
+        doc = first ? delta : doc + delta;
+        first = false;
+        if (doc >= header_.docs) return;
+        f(doc, tf);
+    }
+}
+
+// ---------------------------------------------------------------- termini (pubblico)
+
+void SearchTerms(std::string_view utf8, std::vector<std::string>& out) {
+    ForEachTerm(utf8, [&](std::string_view t, size_t, size_t) { out.emplace_back(t); });
+}
+
+std::string SearchSnippet(std::string_view utf8, std::string_view query, size_t maxBytes) {
+    const std::vector<QueryTerm> terms = ParseQuery(query);
+    size_t hit = std::string_view::npos;
+    if (!terms.empty()) {
+        ForEachTerm(utf8, [&](std::string_view t, size_t begin, size_t) {
+            if (hit != std::string_view::npos) return;
+            for (const auto& q : terms) {
+                if (TermMatches(q, t)) {
+                    hit = begin;
+                    return;
+                }
+            }
+        });
+    }
+    size_t from = 0;
+    if (hit != std::string_view::npos && hit > maxBytes / 4) from = Utf8Floor(utf8, hit - maxBytes / 4);
+    const size_t to = Utf8Floor(utf8, from + maxBytes);
+
+    static const char kEllipsis[] = "\xE2\x80\xA6";
+    std::string out;
+    if (from > 0) out += kEllipsis;
+    bool space = false;
+    for (size_t i = from; i < to; ++i) {
+        const char c = utf8[i];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            space = true;
+            continue;
+        }
+        if (space && !out.empty()) out.push_back(' ');
+        space = false;
+        out.push_back(c);
+    }
+    if (to < utf8.size()) out += kEllipsis;
+    return out;
+}
+
+// ---------------------------------------------------------------- indice
+
+SearchIndex::~SearchIndex() { Stop(); }
+
+std::filesystem::path SearchIndex::SegmentPath(uint64_t gen) const {
+    char name[32];
+    std::snprintf(name, sizeof name, "seg-%06llu.idx", static_cast<unsigned long long>(gen));
+    return dir_ / name;
+}
+
+bool SearchIndex::Open(const std::filesystem::path& dir) {
+    dir_ = dir;
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    if (!std::filesystem::is_directory(dir_, ec)) return false;
+
+    std::string manifest;
+    ReadWholeFile(dir_ / "manifest", manifest);
+    std::istringstream in(manifest);
+    std::string line;
+    SegmentList segments;
+    std::unordered_set<std::u8string> listed; // nomi come u8string: su Windows string() puo' lanciare
+    bool lost = false;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "next") {
+            fields >> nextGen_;
+        } else if (key == "history") {
+            fields >> historyTime_;
+        } else if (key == "segment") {
+            uint64_t gen = 0;
+            fields >> gen;
+            auto seg = std::make_shared<SearchSegment>();
+            if (gen && seg->Open(SegmentPath(gen), gen)) {
+                listed.insert(SegmentPath(gen).filename().u8string());
+                nextGen_ = std::max(nextGen_, gen + 1);
+                segments.push_back(std::move(seg));
+            } else {
+                lost = true;
+            }
+        }
+    }
+    // un segmento rotto si perde: la cronologia si ripassa da capo (le versioni rimaste si saltano)
+    if (lost) historyTime_ = 0;
+
+    // avanzi: segmenti scritti e non ancora nel manifest, fusioni interrotte, vecchi non cancellati
+    for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+        const std::u8string name = entry.path().filename().u8string();
+        if (name.rfind(u8"seg-", 0) == 0 && !listed.count(name)) std::filesystem::remove(entry.path(), ec);
+    }
+
+    keys_.clear();
+    for (const auto& seg : segments) {
+        for (uint32_t i = 0; i < seg->Docs(); ++i) keys_.insert(VersionKey(seg->DocAt(i).sha, seg->DocAt(i).tileId));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_ = std::move(segments);
+    }
+    if (lost) WriteManifest();
+    return true;
+}
+
+bool SearchIndex::Contains(uint64_t tileId, const std::string& hash) const {
+    uint8_t sha[32];
+    return ParseSha(hash, sha) && keys_.count(VersionKey(sha, tileId)) != 0;
+}
+
+bool SearchIndex::Add(uint64_t tileId, int64_t time, std::string_view utf8, std::string hash) {
+    if (hash.empty()) hash = Sha256Hex(utf8);
+    MemDoc doc{};
+    if (!ParseSha(hash, doc.sha)) return false;
+    if (!keys_.insert(VersionKey(doc.sha, tileId)).second) return false;
+    if (utf8.empty()) return false;
+
+    const auto index = static_cast<uint32_t>(memDocs_.size());
+    docTerms_.clear();
+    ForEachTerm(utf8, [&](std::string_view t, size_t, size_t) {
+        auto it = memTermIds_.find(t);
+        if (it == memTermIds_.end()) it = memTermIds_.emplace(std::string(t), static_cast<uint32_t>(memTermIds_.size())).first;
+        docTerms_.push_back(it->second);
+    });
+    doc.length = static_cast<uint32_t>(docTerms_.size());
+    std::sort(docTerms_.begin(), docTerms_.end());
+    for (size_t i = 0; i < docTerms_.size();) {
+        size_t j = i;
+        while (j < docTerms_.size() && docTerms_[j] == docTerms_[i]) ++j;
+        memPostings_.push_back(MemPosting{docTerms_[i], index, static_cast<uint32_t>(j - i)});
+        i = j;
+    }
+    doc.tileId = tileId;
+    doc.time = time;
+    doc.preview = std::string(PreviewOf(utf8));
+    if (memDocs_.empty()) memSince_ = std::chrono::steady_clock::now();
+    memDocs_.push_back(std::move(doc));
+    memBytes_ += utf8.size();
+    memDirty_ = true;
+    if (memDocs_.size() >= kFlushDocs || memBytes_ >= kFlushBytes) Flush();
+    return true;
+}
+
+std::string SearchIndex::BuildMemImage() const {
+    SegmentWriter out(static_cast<uint32_t>(memDocs_.size()), nullptr);
+    for (const auto& d : memDocs_) out.AddDoc(d.sha, d.tileId, d.time, d.length, d.preview.size());
+    for (const auto& d : memDocs_) out.AddPreview(d.preview);
+
+    // occorrenze per termine con un counting sort: dentro ogni termine restano in ordine di doc
+    std::vector<uint32_t> start(memTermIds_.size() + 1, 0);
+    for (const auto& p : memPostings_) ++start[p.term + 1];
+    for (size_t i = 1; i < start.size(); ++i) start[i] += start[i - 1];
+    std::vector<std::pair<uint32_t, uint32_t>> grouped(memPostings_.size());
+    std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+    for (const auto& p : memPostings_) grouped[fill[p.term]++] = {p.doc, p.tf};
+
+    std::vector<std::pair<std::string_view, uint32_t>> terms(memTermIds_.begin(), memTermIds_.end());
+    std::sort(terms.begin(), terms.end());
+    std::string postings;
+    for (const auto& [term, id] : terms) {
+        postings.clear();
+        uint32_t previous = 0;
+        for (uint32_t i = start[id]; i < start[id + 1]; ++i) {
+            PutVarint(postings, grouped[i].first - previous);
+            PutVarint(postings, grouped[i].second);
+            previous = grouped[i].first;
+        }
+        out.AddTerm(term, start[id + 1] - start[id], postings);
+    }
+    out.Finish();
+    return std::move(out.Memory());
+}
+
+void SearchIndex::PublishMem() {
+    if (!memDirty_) return;
+    std::shared_ptr<SearchSegment> seg;
+    if (!memDocs_.empty()) {
+        seg = std::make_shared<SearchSegment>();
+        if (!seg->Load(BuildMemImage())) seg.reset();
+    }
+    memDirty_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    mem_ = std::move(seg);
+}
+
+void SearchIndex::Flush() {
+    if (memDocs_.empty() || dir_.empty()) return;
+    const uint64_t gen = nextGen_++;
+    if (!WriteFileAtomic(SegmentPath(gen), BuildMemImage())) return; // la memtable resta: si riprova
+    auto seg = std::make_shared<SearchSegment>();
+    if (!seg->Open(SegmentPath(gen), gen)) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.push_back(std::move(seg));
+        mem_.reset();
+    }
+    memDocs_.clear();
+    memTermIds_.clear();
+    memPostings_.clear();
+    memBytes_ = 0;
+    memDirty_ = false;
+    WriteManifest();
+    MergeTiers();
+}
+
+bool SearchIndex::WriteManifest() {
+    std::string text = "gridnotes-index 1\nnext " + std::to_string(nextGen_) + "\nhistory " + std::to_string(historyTime_) + "\n";
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& seg : segments_) text += "segment " + std::to_string(seg->Gen()) + "\n";
+    }
+    return WriteFileAtomic(dir_ / "manifest", text);
+}
+
+// Fusione a livelli: segmenti con taglia nella stessa potenza di 4 (da 1 MB) si fondono
+// a gruppi di kMergeFactor, cosi' ogni documento si riscrive O(log n) volte; se restano
+// troppi segmenti si fondono i piu' piccoli.
+void SearchIndex::MergeTiers() {
+    for (;;) {
+        std::unordered_map<int, std::vector<size_t>> tiers;
+        std::vector<size_t> bySize(segments_.size());
+        for (size_t i = 0; i < segments_.size(); ++i) {
+            bySize[i] = i;
+            int tier = 0;
+            for (uint64_t b = segments_[i]->Bytes() >> 20; b >= kMergeFactor; b /= kMergeFactor) ++tier;
+            tiers[tier].push_back(i);
+        }
+        std::vector<size_t> which;
+        for (auto& [tier, members] : tiers) {
+            if (members.size() >= kMergeFactor) {
+                which = members;
+                break;
+            }
+        }
+        if (which.empty() && segments_.size() > kMaxSegments) {
+            std::sort(bySize.begin(), bySize.end(), [&](size_t a, size_t b) { return segments_[a]->Bytes() < segments_[b]->Bytes(); });
+            which.assign(bySize.begin(), bySize.begin() + kMergeFactor);
+            std::sort(which.begin(), which.end());
+        }
+        if (which.empty()) return;
+        const size_t before = segments_.size();
+        MergeSegments(std::move(which));
+        if (segments_.size() >= before) return; // fusione fallita: si riprova al prossimo Flush
+    }
+}
+
+void SearchIndex::Merge() {
+    if (segments_.size() < 2) return;
+    std::vector<size_t> all(segments_.size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+    MergeSegments(std::move(all));
+}
+
+// I documenti si mettono di seguito (quelli del secondo segmento dopo quelli del primo e
+// cosi' via), i termini si fondono in ordine come in un merge sort e le occorrenze di
+// uno stesso termine si concatenano spostando i doc. Si scrive in streaming su un file
+// nuovo; le ricerche intanto continuano sui segmenti vecchi.
+void SearchIndex::MergeSegments(std::vector<size_t> which) {
+    SegmentList sources;
+    uint64_t docs = 0;
+    for (size_t i : which) {
+        sources.push_back(segments_[i]);
+        docs += segments_[i]->Docs();
+    }
+    if (sources.size() < 2 || docs > UINT32_MAX) return;
+
+    const uint64_t gen = nextGen_++;
+    const std::filesystem::path path = SegmentPath(gen);
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    bool ok = false;
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        SegmentWriter out(static_cast<uint32_t>(docs), &file);
+        for (const auto& s : sources) {
+            for (uint32_t i = 0; i < s->Docs(); ++i) {
+                const auto& d = s->DocAt(i);
+                out.AddDoc(d.sha, d.tileId, d.time, s->Length(i), d.previewLength);
+            }
+        }
+        for (const auto& s : sources) {
+            for (uint32_t i = 0; i < s->Docs(); ++i) out.AddPreview(s->Preview(s->DocAt(i)));
+        }
+
+        std::vector<uint32_t> cursor(sources.size(), 0);
+        std::vector<uint32_t> base(sources.size(), 0);
+        for (size_t k = 1; k < sources.size(); ++k) base[k] = base[k - 1] + sources[k - 1]->Docs();
+        std::vector<SearchSegment::Posting> list;
+        std::string postings;
+        for (;;) {
+            std::string_view smallest;
+            bool any = false;
+            for (size_t k = 0; k < sources.size(); ++k) {
+                if (cursor[k] >= sources[k]->Terms()) continue;
+                const std::string_view t = sources[k]->TermText(sources[k]->TermAt(cursor[k]));
+                if (!any || t < smallest) smallest = t;
+                any = true;
+            }
+            if (!any) break;
+            const std::string term(smallest); // smallest punta in un segmento: si copia prima di avanzare
+            postings.clear();
+            uint32_t previous = 0;
+            bool first = true;
+            uint32_t termDocs = 0;
+            for (size_t k = 0; k < sources.size(); ++k) {
+                if (cursor[k] >= sources[k]->Terms() || sources[k]->TermText(sources[k]->TermAt(cursor[k])) != term) continue;
+                list.clear();
+                sources[k]->Postings(cursor[k]++, list);
+                for (const auto& [doc, tf] : list) {
+                    const uint32_t global = base[k] + doc;
+                    PutVarint(postings, first ? global : global - previous);
+                    PutVarint(postings, tf);
+                    previous = global;
+                    first = false;
+                }
+                termDocs += static_cast<uint32_t>(list.size());
+            }
+            out.AddTerm(term, termDocs, postings);
+        }
+        ok = out.Finish();
+    }
+    std::error_code ec;
+    auto merged = std::make_shared<SearchSegment>();
+    if (ok) std::filesystem::rename(tmp, path, ec);
+    if (!ok || ec || !merged->Open(path, gen)) {
+        std::filesystem::remove(tmp, ec);
+        std::filesystem::remove(path, ec);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SegmentList next;
+        for (size_t i = 0; i < segments_.size(); ++i) {
+            if (i == which.front()) next.push_back(merged);
+            if (std::find(which.begin(), which.end(), i) == which.end()) next.push_back(segments_[i]);
+        }
+        segments_ = std::move(next);
+        ++merges_;
+    }
+    // i vecchi si cancellano solo quando il manifest non li nomina piu' (e nessuno li legge)
+    if (WriteManifest()) {
+        for (const auto& s : sources) s->MarkObsolete();
+    }
+}
+
+// ---------------------------------------------------------------- ricerca
+
+std::vector<SearchHit> SearchIndex::Query(std::string_view query, size_t limit) const {
+    const std::vector<QueryTerm> terms = ParseQuery(query);
+    if (terms.empty() || limit == 0) return {};
+
+    SegmentList segs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segs = segments_;
+        if (mem_) segs.push_back(mem_);
+    }
+    uint64_t docs = 0;
+    uint64_t tokens = 0;
+    for (const auto& s : segs) {
+        docs += s->Docs();
+        tokens += s->Tokens();
+    }
+    if (docs == 0) return {};
+    const double avgLength = std::max(1.0, static_cast<double>(tokens) / static_cast<double>(docs));
+
+    // IDF su tutto l'indice; un prefisso vale come un termine solo con le occorrenze di tutti
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> ranges(terms.size(), std::vector<std::pair<uint32_t, uint32_t>>(segs.size()));
+    std::vector<double> idf(terms.size());
+    for (size_t q = 0; q < terms.size(); ++q) {
+        uint64_t df = 0;
+        for (size_t s = 0; s < segs.size(); ++s) {
+            ranges[q][s] = segs[s]->Range(terms[q]);
+            for (uint32_t t = ranges[q][s].first; t < ranges[q][s].second; ++t) df += segs[s]->TermAt(t).docs;
+        }
+        if (df == 0) return {}; // tutti i termini devono esserci
+        df = std::min(df, docs);
+        idf[q] = std::log(1.0 + (static_cast<double>(docs - df) + 0.5) / (static_cast<double>(df) + 0.5));
+    }
+
+    struct Candidate {
+        double score;
+        uint32_t seg;
+        uint32_t doc;
+    };
+    std::vector<Candidate> all;
+    std::vector<SearchSegment::Posting> list;
+    std::vector<std::pair<uint32_t, double>> candidates;
+    std::vector<std::pair<uint32_t, double>> kept;
+    std::vector<uint32_t> dense;
+    std::vector<size_t> order(terms.size());
+    for (size_t s = 0; s < segs.size(); ++s) {
+        const SearchSegment& seg = *segs[s];
+        std::vector<uint64_t> weight(terms.size(), 0);
+        bool missing = false;
+        for (size_t q = 0; q < terms.size(); ++q) {
+            for (uint32_t t = ranges[q][s].first; t < ranges[q][s].second; ++t) weight[q] += seg.TermAt(t).docs;
+            missing = missing || weight[q] == 0;
+        }
+        if (missing) continue;
+        for (size_t q = 0; q < order.size(); ++q) order[q] = q;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return weight[a] < weight[b]; });
+
+        const auto termScore = [&](size_t q, uint32_t doc, uint32_t tf) {
+            const double norm = kBm25K1 * (1.0 - kBm25B + kBm25B * seg.Length(doc) / avgLength);
+            return idf[q] * (tf * (kBm25K1 + 1.0)) / (tf + norm);
+        };
+        // il termine piu' raro da' i candidati, gli altri li sfoltiscono
+        candidates.clear();
+        for (size_t n = 0; n < order.size(); ++n) {
+            const size_t q = order[n];
+            list.clear();
+            if (ranges[q][s].second - ranges[q][s].first == 1) {
+                seg.Postings(ranges[q][s].first, list);
+            } else {
+                // piu' termini col prefisso: occorrenze sommate per documento, in ordine
+                dense.assign(seg.Docs(), 0);
+                for (uint32_t t = ranges[q][s].first; t < ranges[q][s].second; ++t) {
+                    seg.ForEachPosting(t, [&](uint32_t doc, uint32_t tf) { dense[doc] += tf; });
+                }
+                for (uint32_t doc = 0; doc < dense.size(); ++doc) {
+                    if (dense[doc]) list.emplace_back(doc, dense[doc]);
+                }
+            }
+            if (n == 0) {
+                for (const auto& [doc, tf] : list) candidates.emplace_back(doc, termScore(q, doc, tf));
+                continue;
+            }
+            kept.clear();
+            size_t r = 0;
+            for (const auto& c : candidates) {
+                while (r < list.size() && list[r].first < c.first) ++r;
+                if (r == list.size()) break;
+                if (list[r].first == c.first) kept.emplace_back(c.first, c.second + termScore(q, c.first, list[r].second));
+            }
+            candidates.swap(kept);
+            if (candidates.empty()) break;
+        }
+
+        for (const auto& [doc, score] : candidates) all.push_back(Candidate{score, static_cast<uint32_t>(s), doc});
+    }
+
+    // i migliori per punteggio (a pari punteggio il piu' recente), poi uno per tile: se le
+    // versioni della stessa tile riempiono la scelta la si allarga. Si ordinano solo quelli.
+    const auto better = [&](const Candidate& a, const Candidate& b) {
+        if (a.score != b.score) return a.score > b.score;
+        return segs[a.seg]->DocAt(a.doc).time > segs[b.seg]->DocAt(b.doc).time;
+    };
+    std::vector<SearchHit> hits;
+    std::unordered_set<uint64_t> tiles;
+    size_t window = std::min(all.size(), limit * 4);
+    for (;;) {
+        std::partial_sort(all.begin(), all.begin() + static_cast<ptrdiff_t>(window), all.end(), better);
+        hits.clear();
+        tiles.clear();
+        for (size_t i = 0; i < window && hits.size() < limit; ++i) {
+            const SearchSegment& seg = *segs[all[i].seg];
+            const auto& d = seg.DocAt(all[i].doc);
+            if (!tiles.insert(d.tileId).second) continue;
+            hits.push_back(SearchHit{d.tileId, d.time, ShaHex(d.sha), std::string(seg.Preview(d)), all[i].score});
+        }
+        if (hits.size() == limit || window == all.size()) return hits;
+        window = std::min(all.size(), window * 4);
+    }
+}
+
+SearchStats SearchIndex::Stats() const {
+    SearchStats st;
+    std::lock_guard<std::mutex> lock(mutex_);
+    st.segments = segments_.size();
+    for (const auto& s : segments_) {
+        st.documents += s->Docs();
+        st.bytes += s->Bytes();
+    }
+    if (mem_) {
+        st.memDocuments = mem_->Docs();
+        st.documents += mem_->Docs();
+    }
+    st.merges = merges_;
+    return st;
+}
+
+// ---------------------------------------------------------------- thread
+
+void SearchIndex::Start() {
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            if (jobs_.empty()) {
+                if (stopping_) break;
+                // coda vuota: la memtable diventa visibile alle ricerche, e dopo un minuto un segmento
+                lock.unlock();
+                PublishMem();
+                if (!memDocs_.empty() && std::chrono::steady_clock::now() - memSince_ >= kFlushAfter) Flush();
+                lock.lock();
+                const auto ready = [this] { return stopping_ || !jobs_.empty(); };
+                if (memDocs_.empty()) wake_.wait(lock, ready);
+                else wake_.wait_until(lock, memSince_ + kFlushAfter, ready);
+                continue;
+            }
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+            job(*this);
+            lock.lock();
+        }
+        lock.unlock();
+        Flush();
+    });
+}
+
+void SearchIndex::Post(std::function<void(SearchIndex&)> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+bool SearchIndex::Stopping() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stopping_;
+}
+
+void SearchIndex::Stop() {
+    if (!thread_.joinable()) {
+        Flush();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
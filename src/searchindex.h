@@ -0,0 +1,152 @@
+#pragma once
+
+// Ricerca a testo pieno su tutte le note: i testi salvati della board e quelli delle
+// istantanee della cronologia, anche di tile che non ci sono piu'. Ogni versione di una
+// tile (id + SHA-256 del testo, lo stesso hash dei chunk della cronologia) e' un documento
+// che si indicizza una volta sola.
+//
+// Indice a segmenti (LSM) sotto una cartella:
+// - i documenti nuovi vanno in memoria (memtable); ogni tanto (abbastanza documenti, o
+//   un minuto dal primo) diventano un segmento seg-<n>.idx, che poi non cambia piu'
+// - un segmento e' un file unico mappato in memoria: tabella dei documenti, anteprime,
+//   liste di occorrenze (delta varint), tabella dei termini in ordine e i loro byte.
+//   Le ricerche leggono i termini con una ricerca binaria direttamente sulla mappatura
+// - quando ci sono abbastanza segmenti di taglia simile si fondono in uno (sul thread
+//   dell'indice); le ricerche in corso finiscono sui vecchi, che si cancellano dopo
+// - "manifest" elenca i segmenti validi: si riscrive intero (file temporaneo + rename)
+//   a ogni cambio, quindi un'interruzione lascia sempre un indice coerente; i file che
+//   il manifest non nomina sono avanzi e si cancellano all'apertura
+//
+// Termini: lettere e cifre, minuscole e senza accenti ("Perché" -> "perche"); i
+// caratteri cinesi e giapponesi valgono un termine ciascuno. Ricerca: tutti i termini
+// (l'ultimo anche come inizio di parola, mentre si scrive), punteggio BM25, un risultato
+// per tile con la sua versione migliore.
+//
+// Add, Flush, Merge e SetHistoryTime girano sul thread dell'indice (Post); Query e Stats
+// si possono chiamare da qualunque thread e vedono anche la memtable.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class SearchSegment;
+
+struct SearchHit {
+    uint64_t tileId{0};
+    int64_t time{0};     // secondi dal 1970: quando questa versione e' stata vista la prima volta
+    std::string hash;    // SHA-256 esadecimale del testo UTF-8
+    std::string preview; // inizio del testo (UTF-8), salvato nell'indice
+    double score{0};
+};
+
+struct SearchStats {
+    size_t segments{0};
+    size_t documents{0}; // segmenti e memtable
+    size_t memDocuments{0};
+    uint64_t bytes{0}; // file dei segmenti
+    uint64_t merges{0};
+};
+
+class SearchIndex {
+public:
+    SearchIndex() = default;
+    ~SearchIndex();
+    SearchIndex(const SearchIndex&) = delete;
+    SearchIndex& operator=(const SearchIndex&) = delete;
+
+    // prima di Start o sul thread dell'indice; false se la cartella non si crea
+    bool Open(const std::filesystem::path& dir);
+
+    // sul thread dell'indice
+    bool Contains(uint64_t tileId, const std::string& hash) const;
+    // false se la versione c'era gia'; hash vuoto: si calcola
+    bool Add(uint64_t tileId, int64_t time, std::string_view utf8, std::string hash = {});
+    void Flush(); // memtable -> segmento, poi le fusioni che servono
+    void Merge(); // fonde tutto in un segmento
+    // istantanee della cronologia gia' indicizzate: fino a questa compresa. Va nel manifest
+    // col segmento che contiene i loro testi, quindi dopo un'interruzione si riprende da li'.
+    int64_t HistoryTime() const { return historyTime_; }
+    void SetHistoryTime(int64_t time) { historyTime_ = time; }
+    // per i lavori lunghi sul thread dell'indice: Stop e' stato chiesto, meglio smettere
+    bool Stopping() const;
+
+    std::vector<SearchHit> Query(std::string_view query, size_t limit) const;
+    SearchStats Stats() const;
+
+    // Lavoro in ordine su un thread a parte. La memtable si svuota da sola dopo un
+    // minuto; Stop finisce la coda e la scrive prima di uscire.
+    void Start();
+    void Post(std::function<void(SearchIndex&)> job);
+    void Stop();
+
+private:
+    struct MemDoc {
+        uint8_t sha[32];
+        uint64_t tileId;
+        int64_t time;
+        uint32_t length; // termini
+        std::string preview;
+    };
+    using SegmentList = std::vector<std::shared_ptr<const SearchSegment>>;
+
+    std::string BuildMemImage() const;
+    void PublishMem();
+    void MergeSegments(std::vector<size_t> which); // indici in segments_, in ordine
+    void MergeTiers();
+    bool WriteManifest();
+    std::filesystem::path SegmentPath(uint64_t gen) const;
+
+    std::filesystem::path dir_;
+
+    // solo sul thread dell'indice (o prima di Start)
+    std::unordered_set<uint64_t> keys_; // versioni gia' indicizzate: primi 8 byte dell'hash ^ id
+    std::vector<MemDoc> memDocs_;
+    struct TermHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+    struct MemPosting {
+        uint32_t term;
+        uint32_t doc;
+        uint32_t tf;
+    };
+    // termine -> id; le occorrenze stanno tutte in fila, in ordine di doc, e si raggruppano
+    // per termine solo quando si scrive il segmento (una lista per termine costa un cache
+    // miss a ogni parola indicizzata)
+    std::unordered_map<std::string, uint32_t, TermHash, std::equal_to<>> memTermIds_;
+    std::vector<MemPosting> memPostings_;
+    std::vector<uint32_t> docTerms_; // appoggio per Add
+    size_t memBytes_{0};
+    std::chrono::steady_clock::time_point memSince_;
+    bool memDirty_{false};
+    uint64_t nextGen_{1};
+    int64_t historyTime_{0};
+
+    mutable std::mutex mutex_; // segments_, mem_, merges_, jobs_, stopping_
+    SegmentList segments_;     // dal piu' vecchio
+    std::shared_ptr<const SearchSegment> mem_;
+    uint64_t merges_{0};
+
+    std::thread thread_;
+    std::condition_variable wake_;
+    std::deque<std::function<void(SearchIndex&)>> jobs_;
+    bool stopping_{false};
+};
+
+// termini del testo come li vede l'indice, in ordine
+void SearchTerms(std::string_view utf8, std::vector<std::string>& out);
+// riga di al massimo maxBytes intorno alla prima parola cercata (o l'inizio del testo),
+// con i puntini dove e' tagliata
+std::string SearchSnippet(std::string_view utf8, std::string_view query, size_t maxBytes);
@@ -0,0 +1,28 @@
+#pragma once
+
+// SHA-256 (FIPS 180-4) per gli indirizzi dei contenuti: a differenza di ContentHash64
+// due contenuti diversi con lo stesso nome non capitano nemmeno cercandoli.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+class Sha256 {
+public:
+    Sha256();
+    void Update(const void* data, size_t len);
+    std::array<uint8_t, 32> Finish();
+
+private:
+    void Block(const uint8_t* p);
+
+    uint32_t h_[8];
+    uint8_t buf_[64];
+    size_t used_{0};
+    uint64_t total_{0};
+};
+
+// 64 cifre esadecimali minuscole
+std::string Sha256Hex(std::string_view bytes);
@@ -0,0 +1,558 @@
+#include "spell.h"
+
+#include "textcodec.h"
+#include "textseg.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// ---------------------------------------------------------------- DAWG
+
+namespace {
+
+// File: intestazione, poi gli archi come uint64 little endian. Gli archi di un nodo sono
+// contigui e in ordine di carattere; un nodo e' l'indice del suo primo arco (0 = nessun
+// arco: l'arco 0 non e' usato). Arco: bit 0-15 carattere (unita' UTF-16), 16 la parola
+// finisce qui, 17 ultimo arco del nodo, 18-63 nodo di arrivo.
+struct DawgHeader {
+    char magic[8];
+    uint32_t edgeCount;
+    uint32_t root;
+    uint64_t words;
+};
+static_assert(sizeof(DawgHeader) == 24, "gli archi devono restare allineati a 8");
+
+constexpr char kDawgMagic[8] = {'G', 'N', 'D', 'A', 'W', 'G', '0', '1'};
+constexpr uint64_t kEdgeFinal = 1ull << 16;
+constexpr uint64_t kEdgeLast = 1ull << 17;
+constexpr int kEdgeTargetShift = 18;
+
+// parole della lista, UTF-16; righe vuote e commenti (#) saltati
+bool ReadWordList(const std::filesystem::path& path, std::vector<std::u16string>& words) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    const std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string_view rest(bytes);
+    if (rest.substr(0, 3) == "\xEF\xBB\xBF") rest.remove_prefix(3);
+    bool first = true;
+    while (!rest.empty()) {
+        const size_t nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+        // formato .dic: "parola/FLAG" o "parola<tab>morfologia"; la prima riga e' il conteggio
+        line = line.substr(0, line.find_first_of("/\t \r"));
+        if (line.empty() || line[0] == '#') continue;
+        if (first && line.find_first_not_of("0123456789") == std::string_view::npos) {
+            first = false;
+            continue;
+        }
+        first = false;
+        std::u16string word;
+        AppendUtf16(word, line);
+        words.push_back(std::move(word));
+    }
+    return true;
+}
+
+// Costruzione incrementale su parole ordinate (Daciuk, Mihov, Watson, Watson 2000): il
+// ramo della parola precedente che non serve piu' si minimizza subito, quindi in memoria
+// c'e' solo il DAWG finale piu' una parola.
+class DawgBuilder {
+public:
+    DawgBuilder() { nodes_.emplace_back(); }
+
+    void Add(std::u16string_view word) {
+        size_t common = 0;
+        while (common < word.size() && common < previous_.size() && word[common] == previous_[common]) ++common;
+        Minimize(common);
+        uint32_t node = unchecked_.empty() ? 0 : unchecked_.back().child;
+        for (size_t i = common; i < word.size(); ++i) {
+            const uint32_t child = NewNode();
+            nodes_[node].edges.push_back({word[i], child});
+            unchecked_.push_back({node, child});
+            node = child;
+        }
+        nodes_[node].final = true;
+        previous_.assign(word);
+    }
+
+    std::vector<uint64_t> Finish(uint32_t& root) {
+        Minimize(0);
+        // archi di ogni nodo in ordine di visita; il primo blocco e' la radice
+        std::vector<uint32_t> offset(nodes_.size(), 0);
+        std::vector<uint32_t> queue{0};
+        uint32_t next = 1;
+        if (!nodes_[0].edges.empty()) {
+            offset[0] = next;
+            next += static_cast<uint32_t>(nodes_[0].edges.size());
+        }
+        for (size_t q = 0; q < queue.size(); ++q) {
+            for (const Edge& e : nodes_[queue[q]].edges) {
+                if (nodes_[e.target].edges.empty() || offset[e.target]) continue;
+                offset[e.target] = next;
+                next += static_cast<uint32_t>(nodes_[e.target].edges.size());
+                queue.push_back(e.target);
+            }
+        }
+        std::vector<uint64_t> edges(next, 0);
+        for (uint32_t n : queue) {
+            const auto& list = nodes_[n].edges;
+            for (size_t i = 0; i < list.size(); ++i) {
+                uint64_t e = list[i].label;
+                if (nodes_[list[i].target].final) e |= kEdgeFinal;
+                if (i + 1 == list.size()) e |= kEdgeLast;
+                e |= static_cast<uint64_t>(offset[list[i].target]) << kEdgeTargetShift;
+                edges[offset[n] + i] = e;
+            }
+        }
+        root = offset[0];
+        return edges;
+    }
+
+private:
+    struct Edge {
+        char16_t label;
+        uint32_t target;
+    };
+    struct Node {
+        bool final{false};
+        std::vector<Edge> edges;
+    };
+    struct Unchecked {
+        uint32_t parent;
+        uint32_t child;
+    };
+
+    uint32_t NewNode() {
+        if (!free_.empty()) {
+            const uint32_t n = free_.back();
+            free_.pop_back();
+            return n;
+        }
+        nodes_.emplace_back();
+        return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+
+    // i figli sono gia' nel registro: basta confrontare gli archi
+    std::string Signature(const Node& n) const {
+        std::string key(1, n.final ? '1' : '0');
+        for (const Edge& e : n.edges) {
+            key.append(reinterpret_cast<const char*>(&e.label), sizeof(e.label));
+            key.append(reinterpret_cast<const char*>(&e.target), sizeof(e.target));
+        }
+        return key;
+    }
+
+    void Minimize(size_t downTo) {
+        while (unchecked_.size() > downTo) {
+            const Unchecked u = unchecked_.back();
+            unchecked_.pop_back();
+            const auto [it, added] = register_.try_emplace(Signature(nodes_[u.child]), u.child);
+            if (added) continue;
+            nodes_[u.parent].edges.back().target = it->second;
+            nodes_[u.child] = Node{};
+            free_.push_back(u.child);
+        }
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> free_;
+    std::vector<Unchecked> unchecked_;
+    std::unordered_map<std::string, uint32_t> register_;
+    std::u16string previous_;
+};
+
+} // namespace
+
+bool SpellDictionary::Compile(const std::filesystem::path& wordList, const std::filesystem::path& out, size_t* wordCount) {
+    std::vector<std::u16string> words;
+    if (!ReadWordList(wordList, words)) return false;
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    DawgBuilder builder;
+    for (const auto& w : words) builder.Add(w);
+    DawgHeader header{};
+    std::memcpy(header.magic, kDawgMagic, sizeof(kDawgMagic));
+    const std::vector<uint64_t> edges = builder.Finish(header.root);
+    header.edgeCount = static_cast<uint32_t>(edges.size());
+    header.words = words.size();
+
+    // scritto a parte e poi rinominato: un dizionario a meta' non si apre mai
+    std::filesystem::path tmp = out;
+    tmp += ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(edges.data()), static_cast<std::streamsize>(edges.size() * sizeof(uint64_t)));
+        if (!file) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, out, ec);
+    if (ec) return false;
+    if (wordCount) *wordCount = words.size();
+    return true;
+}
+
+bool SpellDictionary::Open(const std::filesystem::path& compiled) {
+    edges_ = nullptr;
+    edgeCount_ = 0;
+    words_ = 0;
+    if (!file_.Open(compiled)) return false;
+    DawgHeader header{};
+    if (file_.Size() < sizeof(header)) return false;
+    std::memcpy(&header, file_.Data(), sizeof(header));
+    if (std::memcmp(header.magic, kDawgMagic, sizeof(kDawgMagic)) != 0 ||
+        file_.Size() != sizeof(header) + static_cast<size_t>(header.edgeCount) * sizeof(uint64_t) || header.root >= std::max<uint32_t>(1, header.edgeCount)) {
+        file_.Close();
+        return false;
+    }
+    edges_ = reinterpret_cast<const uint64_t*>(file_.Data() + sizeof(header));
+    edgeCount_ = header.edgeCount;
+    root_ = header.root;
+    words_ = static_cast<size_t>(header.words);
+    return true;
+}
+
+bool SpellDictionary::Contains(std::u16string_view word) const {
+    if (word.empty() || !edges_) return false;
+    uint32_t node = root_;
+    bool final = false;
+    for (const char16_t c : word) {
+        if (node == 0) return false;
+        // archi in ordine: ci si ferma al primo carattere oltre; indici controllati, il
+        // file puo' essere rovinato
+        for (uint32_t i = node;; ++i) {
+            if (i >= edgeCount_) return false;
+            const uint64_t e = edges_[i];
+            const char16_t label = static_cast<char16_t>(e & 0xFFFF);
+            if (label == c) {
+                final = (e & kEdgeFinal) != 0;
+                node = static_cast<uint32_t>(e >> kEdgeTargetShift);
+                break;
+            }
+            if (label > c || (e & kEdgeLast)) return false;
+        }
+    }
+    return final;
+}
+
+// ---------------------------------------------------------------- parole
+
+namespace {
+
+bool IsUpper(char16_t c) { return FoldCase(c) != c; }
+bool IsApostrophe(char16_t c) { return c == u'\'' || c == 0x2019; }
+
+// vicini che fanno di una parola un pezzo di indirizzo, percorso, tag o identificatore
+bool IsTechnicalNeighbour(char16_t c) { return c == u'@' || c == u'/' || c == u'\\' || c == u'#' || c == u'_' || c == u'&' || c == u'='; }
+
+bool InAny(const std::vector<SpellDictionary>& dicts, std::u16string_view w) {
+    for (const auto& d : dicts) {
+        if (d.Contains(w)) return true;
+    }
+    return false;
+}
+
+// come scritta o, a inizio frase, con la prima lettera minuscola
+bool Known(const std::vector<SpellDictionary>& dicts, std::u16string_view w) {
+    if (InAny(dicts, w)) return true;
+    if (!IsUpper(w[0])) return false;
+    std::u16string lower(w);
+    lower[0] = FoldCase(lower[0]);
+    return InAny(dicts, lower);
+}
+
+// [from, to) allargato alle parole che tocca e a quelle accanto: un apostrofo o uno
+// spazio cambiano anche la parola vicina ("po'", "l'acqua")
+void WidenToWords(std::u16string_view text, size_t& from, size_t& to) {
+    const Utf16View v{text.data(), text.size()};
+    for (int step = 0; step < 2 && from > 0; ++step) {
+        const WordSegment seg = WordSegmentAt(v, from - 1);
+        from = std::min(from - 1, seg.begin);
+        if (seg.kind == WordSegment::Kind::Word) break;
+    }
+    for (int step = 0; step < 2 && to < text.size(); ++step) {
+        const WordSegment seg = WordSegmentAt(v, to);
+        to = std::max(to + 1, seg.end);
+        if (seg.kind == WordSegment::Kind::Word) break;
+    }
+    to = std::min(to, text.size());
+}
+
+bool IsAsciiLetter(char16_t c) { return (c >= u'a' && c <= u'z') || (c >= u'A' && c <= u'Z'); }
+
+// carattere ASCII che per UAX #29 non puo' stare dentro una parola di sole lettere
+// (gli altri, . : ' _ cifre e tutto il non ASCII, li decide textseg)
+bool IsPlainSeparator(char16_t c) {
+    return c < 0x80 && !IsAsciiLetter(c) && !(c >= u'0' && c <= u'9') && c != u'_' && c != u'.' && c != u':' && c != u'\'';
+}
+
+// parole che cominciano in [from, to), senza allargare. Il testo delle note e' quasi
+// tutto ASCII: le parole di sole lettere tra separatori semplici si riconoscono qui,
+// il resto passa da WordSegmentAt (che costa qualche microsecondo a parola).
+void CheckWords(const std::vector<SpellDictionary>& dicts, std::u16string_view text, size_t from, size_t to, std::vector<SpellRange>& out) {
+    const Utf16View v{text.data(), text.size()};
+    for (size_t pos = from; pos < to;) {
+        const char16_t c = text[pos];
+        if (IsPlainSeparator(c)) {
+            ++pos;
+            continue;
+        }
+        size_t begin = pos, end = pos;
+        bool word = false;
+        if (IsAsciiLetter(c) && (pos == 0 || IsPlainSeparator(text[pos - 1]))) {
+            while (end < text.size() && IsAsciiLetter(text[end])) ++end;
+            word = end == text.size() || IsPlainSeparator(text[end]);
+        }
+        if (!word) {
+            const WordSegment seg = WordSegmentAt(v, pos);
+            begin = seg.begin;
+            end = std::max(pos + 1, seg.end);
+            word = seg.kind == WordSegment::Kind::Word;
+        }
+        if (word && !SpellWordOk(dicts, text, begin, end)) out.push_back({begin, end, std::u16string(text.substr(begin, end - begin))});
+        pos = end;
+    }
+}
+
+} // namespace
+
+bool SpellWordOk(const std::vector<SpellDictionary>& dicts, std::u16string_view text, size_t begin, size_t end) {
+    if (end - begin < 2) return true;
+    if ((begin > 0 && IsTechnicalNeighbour(text[begin - 1])) || (end < text.size() && (IsTechnicalNeighbour(text[end]) || text[end] == u':'))) return true;
+
+    const std::u16string_view word = text.substr(begin, end - begin);
+    size_t apostrophe = std::u16string::npos;
+    for (size_t i = 0; i < word.size(); ++i) {
+        const char16_t c = word[i];
+        // numeri, indirizzi (a.b.c), sigle e nomi in MAIUSCOLO o in CamelCase: non si controllano
+        if ((c >= u'0' && c <= u'9') || c == u'.' || c == u':' || (i > 0 && IsUpper(c))) return true;
+        if (IsApostrophe(c) && apostrophe == std::u16string::npos) apostrophe = i;
+    }
+    const bool truncated = end < text.size() && IsApostrophe(text[end]);
+    if (apostrophe == std::u16string::npos && !truncated) return Known(dicts, word); // quasi sempre: senza copie
+
+    std::u16string w(word); // apostrofo tipografico come quello dei dizionari
+    for (char16_t& c : w) {
+        if (IsApostrophe(c)) c = u'\'';
+    }
+    if (Known(dicts, w)) return true;
+    // troncamento: "po'", "un po'"
+    if (truncated && Known(dicts, w + u'\'')) return true;
+    if (apostrophe == std::u16string::npos) return false;
+    // elisione: "l'" (o "dell'", "un'") davanti a una parola del dizionario
+    const std::u16string head = w.substr(0, apostrophe + 1);
+    const std::u16string tail = w.substr(apostrophe + 1);
+    const bool headOk = head.size() <= 3 || Known(dicts, head);
+    return headOk && (tail.size() < 2 || Known(dicts, tail));
+}
+
+void SpellCheckRange(const std::vector<SpellDictionary>& dicts, std::u16string_view text, size_t from, size_t to, std::vector<SpellRange>& out) {
+    if (dicts.empty() || text.empty()) return;
+    to = std::min(to, text.size());
+    from = std::min(from, to);
+    WidenToWords(text, from, to);
+    CheckWords(dicts, text, from, to, out);
+}
+
+// ---------------------------------------------------------------- thread del controllo
+
+void SpellChecker::Start(std::function<void(uint64_t)> onReady) {
+    if (thread_.joinable()) return;
+    onReady_ = std::move(onReady);
+    stopping_ = false;
+    thread_ = std::thread(&SpellChecker::Loop, this);
+}
+
+void SpellChecker::Stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true; // il lavoro in coda si butta: non c'e' niente da salvare
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void SpellChecker::Loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !jobs_.empty() || !order_.empty(); });
+        if (stopping_) return;
+        if (!jobs_.empty()) {
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+            continue;
+        }
+        const uint64_t id = order_.front();
+        order_.pop_front();
+        auto it = pending_.find(id);
+        if (it == pending_.end()) continue; // tolta nel frattempo
+        std::u16string text = std::move(it->second);
+        pending_.erase(it);
+        lock.unlock();
+        Check(id, std::move(text));
+        lock.lock();
+    }
+}
+
+void SpellChecker::Post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void SpellChecker::Update(uint64_t id, std::u16string text) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [it, added] = pending_.try_emplace(id);
+        if (added) order_.push_back(id);
+        it->second = std::move(text);
+    }
+    wake_.notify_one();
+}
+
+void SpellChecker::Remove(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.erase(id);
+        published_.erase(id);
+    }
+    Post([this, id] { tiles_.erase(id); });
+}
+
+void SpellChecker::Retain(std::unordered_set<uint64_t> ids) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::erase_if(pending_, [&](const auto& p) { return !ids.count(p.first); });
+        std::erase_if(published_, [&](const auto& p) { return !ids.count(p.first); });
+    }
+    Post([this, ids = std::move(ids)] { std::erase_if(tiles_, [&](const auto& p) { return !ids.count(p.first); }); });
+}
+
+void SpellChecker::Clear() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.clear();
+        order_.clear();
+        published_.clear();
+    }
+    Post([this] {
+        tiles_.clear();
+        dicts_.clear();
+        dictWords_.store(0, std::memory_order_relaxed);
+    });
+}
+
+void SpellChecker::LoadDictionaries(const std::filesystem::path& folder) {
+    Post([this, folder] {
+        dicts_.clear(); // prima di ricompilare: su Windows un file mappato non si sostituisce
+        std::vector<std::filesystem::path> lists, compiled;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(folder, ec)) {
+            if (!entry.is_regular_file(ec)) continue;
+            const auto ext = entry.path().extension();
+            if (ext == ".dic" || ext == ".txt") lists.push_back(entry.path());
+            else if (ext == ".dawg") compiled.push_back(entry.path());
+        }
+        std::sort(lists.begin(), lists.end());
+        std::sort(compiled.begin(), compiled.end());
+
+        std::vector<std::filesystem::path> open;
+        for (const auto& list : lists) {
+            std::filesystem::path dawg = list;
+            dawg += ".dawg";
+            const auto built = std::filesystem::last_write_time(dawg, ec);
+            if (ec || built < std::filesystem::last_write_time(list, ec)) SpellDictionary::Compile(list, dawg);
+            open.push_back(dawg);
+        }
+        // .dawg senza la lista accanto: dizionari gia' compilati altrove
+        for (const auto& dawg : compiled) {
+            if (std::find(open.begin(), open.end(), dawg) == open.end()) open.push_back(dawg);
+        }
+        size_t words = 0;
+        for (const auto& path : open) {
+            SpellDictionary d;
+            if (!d.Open(path)) continue;
+            words += d.Words();
+            dicts_.push_back(std::move(d));
+        }
+        dictWords_.store(words, std::memory_order_relaxed);
+
+        for (auto& [id, tile] : tiles_) {
+            tile.ranges.clear();
+            SpellCheckRange(dicts_, tile.text, 0, tile.text.size(), tile.ranges);
+            Publish(id, tile.ranges);
+        }
+    });
+}
+
+void SpellChecker::Check(uint64_t id, std::u16string text) {
+    auto [it, fresh] = tiles_.try_emplace(id);
+    TileText& tile = it->second;
+    if (fresh || dicts_.empty()) {
+        tile.text = std::move(text);
+        tile.ranges.clear();
+        SpellCheckRange(dicts_, tile.text, 0, tile.text.size(), tile.ranges);
+        Publish(id, tile.ranges);
+        return;
+    }
+
+    // tratto cambiato: [at, at + removed) del vecchio testo e' [at, at + inserted) del nuovo
+    const std::u16string& old = tile.text;
+    const size_t common = std::min(old.size(), text.size());
+    const size_t at = static_cast<size_t>(std::mismatch(old.begin(), old.begin() + common, text.begin()).first - old.begin());
+    if (at == old.size() && at == text.size()) return;
+    size_t suffix = 0;
+    while (suffix < common - at && old[old.size() - 1 - suffix] == text[text.size() - 1 - suffix]) ++suffix;
+    const size_t removed = old.size() - at - suffix;
+    const size_t inserted = text.size() - at - suffix;
+
+    // errori prima del tratto restano, quelli dopo si spostano, quelli che lo toccano si rifanno
+    std::vector<SpellRange> ranges;
+    ranges.reserve(tile.ranges.size());
+    for (auto& r : tile.ranges) {
+        if (r.end < at) {
+            ranges.push_back(std::move(r));
+        } else if (r.begin > at + removed) {
+            r.begin = r.begin - removed + inserted;
+            r.end = r.end - removed + inserted;
+            ranges.push_back(std::move(r));
+        }
+    }
+    tile.text = std::move(text);
+
+    size_t from = at, to = at + inserted;
+    WidenToWords(tile.text, from, to);
+    std::vector<SpellRange> found;
+    if (!dicts_.empty()) CheckWords(dicts_, tile.text, from, to, found);
+    std::erase_if(ranges, [&](const SpellRange& r) { return r.end > from && r.begin < to; });
+    auto pos = std::lower_bound(ranges.begin(), ranges.end(), from, [](const SpellRange& r, size_t p) { return r.begin < p; });
+    ranges.insert(pos, std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    tile.ranges = std::move(ranges);
+    Publish(id, tile.ranges);
+}
+
+void SpellChecker::Publish(uint64_t id, const std::vector<SpellRange>& ranges) {
+    auto copy = std::make_shared<const std::vector<SpellRange>>(ranges);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        published_[id] = std::move(copy);
+    }
+    if (onReady_) onReady_(id);
+}
+
+SpellRanges SpellChecker::Misspelled(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = published_.find(id);
+    return it == published_.end() ? nullptr : it->second;
+}
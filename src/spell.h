@@ -0,0 +1,118 @@
+#pragma once
+
+// Controllo ortografico delle tile.
+//
+// Dizionari: liste di parole in file locali (una per riga, UTF-8; i .dic di Hunspell
+// vanno bene, il conteggio iniziale e i /flag si ignorano ma le regole di affisso no:
+// servono le forme gia' espanse). La prima volta la lista si compila in un DAWG (trie
+// con i suffissi comuni fusi, Daciuk et al.) scritto accanto come <nome>.dawg; dopo il
+// file compilato si mappa in memoria e si usa cosi' com'e', senza leggerlo ne' costruire
+// niente: mezzo milione di parole si aprono in pochi millisecondi.
+//
+// Controllo: un thread a parte tiene una copia del testo di ogni tile e i suoi errori.
+// A ogni testo nuovo trova il tratto cambiato (prefisso e suffisso comuni), sposta gli
+// errori dopo la modifica e ricontrolla solo le parole intorno al tratto; poi pubblica
+// la lista e chiama onReady dal suo thread. Il thread UI non aspetta mai il controllo.
+
+#include "mappedfile.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class SpellDictionary {
+public:
+    // lista di parole -> DAWG su disco; false se la lista non si legge o il file non si scrive
+    static bool Compile(const std::filesystem::path& wordList, const std::filesystem::path& out, size_t* words = nullptr);
+
+    // file compilato, mappato; false se manca o non e' un DAWG valido
+    bool Open(const std::filesystem::path& compiled);
+    bool Contains(std::u16string_view word) const; // esatta, maiuscole comprese
+    size_t Words() const { return words_; }
+    size_t Bytes() const { return file_.Size(); }
+
+private:
+    MappedFile file_;
+    const uint64_t* edges_{nullptr};
+    uint32_t edgeCount_{0};
+    uint32_t root_{0};
+    size_t words_{0};
+};
+
+// parola scritta male: [begin, end) del testo controllato. word serve a chi disegna per
+// scartare gli errori che il testo attuale ha gia' spostato.
+struct SpellRange {
+    size_t begin{0};
+    size_t end{0};
+    std::u16string word;
+};
+using SpellRanges = std::shared_ptr<const std::vector<SpellRange>>;
+
+// Parole da non controllare (numeri, indirizzi, sigle con cifre) e regole sulle maiuscole:
+// "Casa" va bene se c'e' "casa", "CASA" se c'e' "casa" o "Casa"; le elisioni ("l'acqua",
+// "po'") si provano anche pezzo per pezzo.
+bool SpellWordOk(const std::vector<SpellDictionary>& dicts, std::u16string_view text, size_t begin, size_t end);
+// errori tra from e to (allargati ai confini di parola), in ordine
+void SpellCheckRange(const std::vector<SpellDictionary>& dicts, std::u16string_view text, size_t from, size_t to, std::vector<SpellRange>& out);
+
+class SpellChecker {
+public:
+    SpellChecker() = default;
+    ~SpellChecker() { Stop(); }
+    SpellChecker(const SpellChecker&) = delete;
+    SpellChecker& operator=(const SpellChecker&) = delete;
+
+    // onReady(id): errori nuovi per la tile, dal thread del controllo
+    void Start(std::function<void(uint64_t)> onReady);
+    void Stop();
+
+    // *.dic e *.txt della cartella, compilati se la lista e' piu' nuova del .dawg; poi
+    // tutte le tile si ricontrollano da capo
+    void LoadDictionaries(const std::filesystem::path& folder);
+    // testo attuale della tile; se ne arriva un altro prima del controllo vale l'ultimo
+    void Update(uint64_t id, std::u16string text);
+    void Remove(uint64_t id);
+    void Retain(std::unordered_set<uint64_t> ids); // via le tile non piu' sulla board
+    void Clear();                                  // tutto via (controllo spento)
+
+    SpellRanges Misspelled(uint64_t id) const; // nullptr se non ancora controllata
+    size_t DictionaryWords() const { return dictWords_.load(std::memory_order_relaxed); }
+
+private:
+    struct TileText {
+        std::u16string text;
+        std::vector<SpellRange> ranges;
+    };
+
+    void Loop();
+    void Check(uint64_t id, std::u16string text);
+    void Publish(uint64_t id, const std::vector<SpellRange>& ranges);
+    void Post(std::function<void()> job);
+
+    // solo sul thread del controllo
+    std::vector<SpellDictionary> dicts_;
+    std::unordered_map<uint64_t, TileText> tiles_;
+
+    std::function<void(uint64_t)> onReady_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::function<void()>> jobs_;               // dizionari, rimozioni: prima dei testi
+    std::deque<uint64_t> order_;                           // tile in attesa, dalla prima arrivata
+    std::unordered_map<uint64_t, std::u16string> pending_; // ultimo testo di ognuna
+    std::unordered_map<uint64_t, SpellRanges> published_;
+    std::atomic<size_t> dictWords_{0};
+    bool stopping_{false};
+};
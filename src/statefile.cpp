@@ -0,0 +1,37 @@
+#include "statefile.h"
+
+#include <fstream>
+#include <system_error>
+
+bool ReadWholeFile(const std::filesystem::path& path, std::string& bytes) {
+    bytes.clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    in.seekg(0, std::ios::end);
+    const std::streamoff size = in.tellg();
+    if (size < 0) return false;
+    in.seekg(0, std::ios::beg);
+    bytes.resize(static_cast<size_t>(size));
+    if (size > 0) in.read(bytes.data(), size);
+    bytes.resize(static_cast<size_t>(in.gcount() > 0 ? in.gcount() : 0));
+    return true;
+}
+
+bool WriteFileAtomic(const std::filesystem::path& path, const std::string& bytes) {
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        out.flush();
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
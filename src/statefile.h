@@ -0,0 +1,14 @@
+#pragma once
+
+// I/O a byte del file di stato: lettura intera e scrittura atomica tmp + rename.
+// L'hash del contenuto (per riconoscere modifiche esterne senza fidarsi dei
+// timestamp) sta in textutil.h.
+
+#include <filesystem>
+#include <string>
+
+// false se il file non esiste o non e' leggibile (bytes resta vuoto)
+bool ReadWholeFile(const std::filesystem::path& path, std::string& bytes);
+
+// scrive su <path>.tmp e poi rinomina: chi legge vede il file vecchio o quello nuovo, mai a meta'
+bool WriteFileAtomic(const std::filesystem::path& path, const std::string& bytes);
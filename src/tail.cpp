@@ -0,0 +1,138 @@
+#include "tail.h"
+
+#include <algorithm>
+#include <fstream>
+#include <system_error>
+
+namespace {
+
+constexpr size_t kHeadBytes = 256;
+constexpr size_t kMarkBytes = 64;
+
+bool ReadAt(std::ifstream& in, uint64_t offset, size_t len, std::string& out) {
+    out.resize(len);
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(offset));
+    in.read(out.data(), static_cast<std::streamsize>(len));
+    out.resize(static_cast<size_t>(std::max<std::streamsize>(0, in.gcount())));
+    return out.size() == len;
+}
+
+} // namespace
+
+LineRing::LineRing(size_t capacity) : lines_(std::max<size_t>(1, capacity)) {}
+
+void LineRing::Push(std::string line) {
+    if (count_ < lines_.size()) {
+        lines_[(head_ + count_) % lines_.size()] = std::move(line);
+        ++count_;
+        return;
+    }
+    // pieno: la nuova prende il posto della piu' vecchia, senza allocare se ci sta
+    lines_[head_].assign(line);
+    head_ = (head_ + 1) % lines_.size();
+}
+
+void LineRing::Clear() {
+    for (auto& line : lines_) line.clear();
+    head_ = 0;
+    count_ = 0;
+}
+
+FileTail::FileTail(std::filesystem::path path, size_t lines) : path_(std::move(path)), ring_(lines) {}
+
+void FileTail::Restart() {
+    ring_.Clear();
+    partial_.clear();
+    head_.clear();
+    mark_.clear();
+    offset_ = 0;
+    skipFirst_ = false;
+}
+
+void FileTail::EndLine() {
+    if (skipFirst_) {
+        skipFirst_ = false;
+    } else {
+        if (!partial_.empty() && partial_.back() == '\r') partial_.pop_back();
+        ring_.Push(partial_);
+    }
+    partial_.clear();
+}
+
+void FileTail::Consume(const char* data, size_t len) {
+    const char* end = data + len;
+    while (data < end) {
+        const char* nl = std::find(data, end, '\n');
+        const size_t room = kMaxLineBytes > partial_.size() ? kMaxLineBytes - partial_.size() : 0;
+        partial_.append(data, std::min(room, static_cast<size_t>(nl - data)));
+        if (nl == end) break;
+        EndLine();
+        data = nl + 1;
+    }
+}
+
+FileTail::Result FileTail::Poll() {
+    std::error_code ec;
+    const uint64_t size = std::filesystem::file_size(path_, ec);
+    std::ifstream in(path_, std::ios::binary);
+    if (ec || !in) {
+        if (missing_) return Result::Unchanged;
+        missing_ = true;
+        Restart();
+        return Result::Missing;
+    }
+
+    bool restarted = missing_;
+    missing_ = false;
+
+    // troncato, oppure i primi byte o quelli appena prima dell'offset non sono piu' quelli:
+    // un file nuovo allo stesso path
+    std::string head;
+    std::string mark;
+    if (size < offset_ || (!head_.empty() && (!ReadAt(in, 0, head_.size(), head) || head != head_)) ||
+        (!mark_.empty() && (!ReadAt(in, offset_ - mark_.size(), mark_.size(), mark) || mark != mark_))) {
+        Restart();
+        restarted = true;
+    }
+    if (size == offset_) return restarted ? Result::Restarted : Result::Unchanged;
+
+    if (size - offset_ > kMaxCatchUp || (offset_ == 0 && size > kStartBytes)) {
+        // si vedono solo le ultime righe: inutile leggere quello che uscirebbe subito dal ring
+        offset_ = size - kStartBytes;
+        partial_.clear();
+        skipFirst_ = true;
+    }
+    if (head_.size() < kHeadBytes) {
+        ReadAt(in, 0, static_cast<size_t>(std::min<uint64_t>(size, kHeadBytes)), head_);
+    }
+
+    char buf[64 * 1024];
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(offset_));
+    uint64_t left = size - offset_;
+    while (left > 0 && in) {
+        in.read(buf, static_cast<std::streamsize>(std::min<uint64_t>(left, sizeof(buf))));
+        const size_t got = static_cast<size_t>(in.gcount());
+        if (got == 0) break;
+        Consume(buf, got);
+        offset_ += got;
+        left -= got;
+    }
+    const size_t markLen = static_cast<size_t>(std::min<uint64_t>(offset_, kMarkBytes));
+    if (!ReadAt(in, offset_ - markLen, markLen, mark_)) mark_.clear();
+    return restarted ? Result::Restarted : Result::Appended;
+}
+
+std::string FileTail::Text() const {
+    std::string out;
+    for (size_t i = 0; i < ring_.Size(); ++i) {
+        if (i > 0) out += '\n';
+        out += ring_.At(i);
+    }
+    if (!partial_.empty() && !skipFirst_) {
+        if (!out.empty()) out += '\n';
+        out += partial_;
+    }
+    return out;
+}
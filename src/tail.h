@@ -0,0 +1,63 @@
+#pragma once
+
+// Le ultime righe di un file che cresce (tail -F). Ogni Poll legge solo i byte
+// aggiunti dall'ultima volta; troncamento e rotazione (file rinominato e ricreato,
+// copytruncate) si riconoscono dalla dimensione, dai primi byte e dagli ultimi byte
+// letti, e si riparte dall'inizio. I byte prima dell'offset in un file che cresce solo
+// in coda non cambiano: cosi' si vede anche un file nuovo con la stessa intestazione
+// (banner fisso dei log) gia' piu' lungo del vecchio. Resta indistinguibile solo un
+// file nuovo uguale al vecchio sia in testa sia attorno all'offset. In memoria restano solo le ultime N righe, ognuna con un tetto di byte:
+// la memoria non cresce con il file ne' con la velocita' di scrittura.
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Buffer circolare di righe: Push oltre la capacita' sovrascrive la piu' vecchia
+class LineRing {
+public:
+    explicit LineRing(size_t capacity);
+
+    void Push(std::string line);
+    void Clear();
+    size_t Size() const { return count_; }
+    size_t Capacity() const { return lines_.size(); }
+    const std::string& At(size_t i) const { return lines_[(head_ + i) % lines_.size()]; } // 0 = la piu' vecchia
+
+private:
+    std::vector<std::string> lines_;
+    size_t head_{0};
+    size_t count_{0};
+};
+
+class FileTail {
+public:
+    static constexpr size_t kMaxLineBytes = 1024;      // righe piu' lunghe si tagliano
+    static constexpr uint64_t kStartBytes = 64 * 1024; // all'apertura e dopo un salto si legge solo la coda
+    static constexpr uint64_t kMaxCatchUp = 1 << 20;   // piu' di cosi' indietro: si salta alla coda
+
+    enum class Result { Unchanged, Appended, Restarted, Missing };
+
+    FileTail(std::filesystem::path path, size_t lines);
+
+    Result Poll();
+    const std::filesystem::path& Path() const { return path_; }
+    const LineRing& Lines() const { return ring_; }
+    std::string Text() const; // righe unite da '\n', la riga non ancora finita in fondo
+
+private:
+    void Restart();
+    void Consume(const char* data, size_t len);
+    void EndLine();
+
+    std::filesystem::path path_;
+    LineRing ring_;
+    uint64_t offset_{0};
+    std::string partial_;   // riga non ancora chiusa da '\n'
+    bool skipFirst_{false}; // dopo un salto a meta' file la prima riga e' un pezzo
+    std::string head_;      // primi byte del file letto: se cambiano e' un altro file
+    std::string mark_;      // ultimi byte letti, fino a offset_: idem
+    bool missing_{false};
+};
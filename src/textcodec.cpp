@@ -0,0 +1,604 @@
+#include "textcodec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TEXTCODEC_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(TEXTCODEC_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace {
+
+// Ogni nucleo guarda l'ingresso dall'inizio e si ferma sulla prima unita' che non sa
+// trattare in blocco. Quelli di conversione scrivono quello che hanno passato e
+// ritornano quante unita' erano (out deve avere posto per n); quelli di ricerca
+// ritornano la posizione trovata (n se nessuna). Il chiamante tratta quell'unita' in
+// scalare e richiama il nucleo.
+struct Kernels {
+    size_t (*narrowAscii)(const char16_t* in, size_t n, char* out);   // UTF-16 ASCII -> byte
+    size_t (*widenAscii)(const char* in, size_t n, char16_t* out);    // byte ASCII -> UTF-16
+    size_t (*asciiRun)(const char* in, size_t n);                     // primo byte >= 0x80
+    size_t (*jsonSpecial)(const char16_t* in, size_t n);              // " \ controllo o surrogato
+    size_t (*backslash)(const char16_t* in, size_t n);                // primo '\'
+    size_t (*quoteOrBackslash)(const char16_t* in, size_t n);         // primo '"' o '\'
+};
+
+// --- scalare: riferimento per le prove e CPU senza SIMD ---
+
+bool IsJsonSpecial(char16_t c) { return c == u'"' || c == u'\\' || c < 0x20 || (c & 0xF800) == 0xD800; }
+
+size_t NarrowAsciiScalar(const char16_t* in, size_t n, char* out) {
+    size_t i = 0;
+    for (; i < n && in[i] < 0x80; ++i) out[i] = static_cast<char>(in[i]);
+    return i;
+}
+
+size_t WidenAsciiScalar(const char* in, size_t n, char16_t* out) {
+    size_t i = 0;
+    for (; i < n && static_cast<unsigned char>(in[i]) < 0x80; ++i) out[i] = static_cast<char16_t>(in[i]);
+    return i;
+}
+
+size_t AsciiRunScalar(const char* in, size_t n) {
+    size_t i = 0;
+    while (i < n && static_cast<unsigned char>(in[i]) < 0x80) ++i;
+    return i;
+}
+
+size_t JsonSpecialScalar(const char16_t* in, size_t n) {
+    size_t i = 0;
+    while (i < n && !IsJsonSpecial(in[i])) ++i;
+    return i;
+}
+
+size_t BackslashScalar(const char16_t* in, size_t n) {
+    size_t i = 0;
+    while (i < n && in[i] != u'\\') ++i;
+    return i;
+}
+
+size_t QuoteOrBackslashScalar(const char16_t* in, size_t n) {
+    size_t i = 0;
+    while (i < n && in[i] != u'"' && in[i] != u'\\') ++i;
+    return i;
+}
+
+#ifdef TEXTCODEC_X86
+
+inline int FirstBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return static_cast<int>(i);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// --- SSE2: 8 unita' UTF-16 o 16 byte per registro ---
+// I nuclei di conversione scrivono sempre il blocco intero (anche oltre l'unita' che li
+// ferma): il chiamante da' un'uscita con posto per n unita' e sovrascrive il resto.
+
+TARGET_SSE2 size_t NarrowAsciiSse2(const char16_t* in, size_t n, char* out) {
+    const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(a, b));
+        const unsigned lo = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(a, high), _mm_setzero_si128())));
+        const unsigned hi = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(b, high), _mm_setzero_si128())));
+        const unsigned other = ~(lo | hi << 16);
+        if (other) return i + FirstBit(other) / 2;
+    }
+    return i + NarrowAsciiScalar(in + i, n - i, out + i);
+}
+
+TARGET_SSE2 size_t WidenAsciiSse2(const char* in, size_t n, char16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(v, zero));
+        const unsigned other = static_cast<unsigned>(_mm_movemask_epi8(v));
+        if (other) return i + FirstBit(other);
+    }
+    return i + WidenAsciiScalar(in + i, n - i, out + i);
+}
+
+TARGET_SSE2 size_t AsciiRunSse2(const char* in, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const unsigned other = static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+        if (other) return i + FirstBit(other);
+    }
+    return i + AsciiRunScalar(in + i, n - i);
+}
+
+// maschera a 16 bit (2 per unita') delle unita' speciali per JSON in 8 unita'
+TARGET_SSE2 inline unsigned JsonSpecialMaskSse2(__m128i v) {
+    const __m128i quote = _mm_cmpeq_epi16(v, _mm_set1_epi16(u'"'));
+    const __m128i slash = _mm_cmpeq_epi16(v, _mm_set1_epi16(u'\\'));
+    const __m128i control = _mm_cmpeq_epi16(_mm_subs_epu16(v, _mm_set1_epi16(0x1F)), _mm_setzero_si128()); // v <= 0x1F
+    const __m128i surrogate = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xF800))), _mm_set1_epi16(static_cast<short>(0xD800)));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, slash), _mm_or_si128(control, surrogate))));
+}
+
+TARGET_SSE2 size_t JsonSpecialSse2(const char16_t* in, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const unsigned mask = JsonSpecialMaskSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        if (mask) return i + FirstBit(mask) / 2;
+    }
+    return i + JsonSpecialScalar(in + i, n - i);
+}
+
+TARGET_SSE2 size_t BackslashSse2(const char16_t* in, size_t n) {
+    const __m128i slash = _mm_set1_epi16(u'\\');
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), slash)));
+        if (mask) return i + FirstBit(mask) / 2;
+    }
+    return i + BackslashScalar(in + i, n - i);
+}
+
+TARGET_SSE2 size_t QuoteOrBackslashSse2(const char16_t* in, size_t n) {
+    const __m128i quote = _mm_set1_epi16(u'"');
+    const __m128i slash = _mm_set1_epi16(u'\\');
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, quote), _mm_cmpeq_epi16(v, slash))));
+        if (mask) return i + FirstBit(mask) / 2;
+    }
+    return i + QuoteOrBackslashScalar(in + i, n - i);
+}
+
+// --- AVX2: 16 unita' o 32 byte per registro; le code restano scalari, senza passare
+// da SSE2 (mescolare le due codifiche costa) ---
+
+TARGET_AVX2 size_t NarrowAsciiAvx2(const char16_t* in, size_t n, char* out) {
+    const __m256i high = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+        // packus lavora per meta' registro: si rimettono in ordine i blocchi da 64 bit
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+        if (_mm256_testz_si256(_mm256_or_si256(a, b), high)) continue;
+        const unsigned lo = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(a, high), _mm256_setzero_si256())));
+        if (lo != 0xFFFFFFFFu) return i + FirstBit(~lo) / 2;
+        const unsigned hi = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(b, high), _mm256_setzero_si256())));
+        return i + 16 + FirstBit(~hi) / 2;
+    }
+    return i + NarrowAsciiScalar(in + i, n - i, out + i);
+}
+
+TARGET_AVX2 size_t WidenAsciiAvx2(const char* in, size_t n, char16_t* out) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+        const unsigned other = static_cast<unsigned>(_mm256_movemask_epi8(v));
+        if (other) return i + FirstBit(other);
+    }
+    return i + WidenAsciiScalar(in + i, n - i, out + i);
+}
+
+TARGET_AVX2 size_t AsciiRunAvx2(const char* in, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const unsigned other = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i))));
+        if (other) return i + FirstBit(other);
+    }
+    return i + AsciiRunScalar(in + i, n - i);
+}
+
+TARGET_AVX2 inline unsigned JsonSpecialMaskAvx2(__m256i v) {
+    const __m256i quote = _mm256_cmpeq_epi16(v, _mm256_set1_epi16(u'"'));
+    const __m256i slash = _mm256_cmpeq_epi16(v, _mm256_set1_epi16(u'\\'));
+    const __m256i control = _mm256_cmpeq_epi16(_mm256_subs_epu16(v, _mm256_set1_epi16(0x1F)), _mm256_setzero_si256());
+    const __m256i surrogate =
+        _mm256_cmpeq_epi16(_mm256_and_si256(v, _mm256_set1_epi16(static_cast<short>(0xF800))), _mm256_set1_epi16(static_cast<short>(0xD800)));
+    return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(quote, slash), _mm256_or_si256(control, surrogate))));
+}
+
+TARGET_AVX2 size_t JsonSpecialAvx2(const char16_t* in, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const unsigned mask = JsonSpecialMaskAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+        if (mask) return i + FirstBit(mask) / 2;
+    }
+    return i + JsonSpecialScalar(in + i, n - i);
+}
+
+TARGET_AVX2 size_t BackslashAvx2(const char16_t* in, size_t n) {
+    const __m256i slash = _mm256_set1_epi16(u'\\');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), slash)));
+        if (mask) return i + FirstBit(mask) / 2;
+    }
+    return i + BackslashScalar(in + i, n - i);
+}
+
+TARGET_AVX2 size_t QuoteOrBackslashAvx2(const char16_t* in, size_t n) {
+    const __m256i quote = _mm256_set1_epi16(u'"');
+    const __m256i slash = _mm256_set1_epi16(u'\\');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi16(v, quote), _mm256_cmpeq_epi16(v, slash))));
+        if (mask) return i + FirstBit(mask) / 2;
+    }
+    return i + QuoteOrBackslashScalar(in + i, n - i);
+}
+
+SimdLevel DetectLevel() {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::Sse2;
+    return SimdLevel::Scalar;
+#elif defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 1);
+    const bool sse2 = (r[3] & (1 << 26)) != 0;
+    const bool osAvx = (r[2] & (1 << 27)) && (r[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6; // OSXSAVE, AVX, registri salvati
+    __cpuid(r, 0);
+    bool avx2 = false;
+    if (osAvx && r[0] >= 7) {
+        __cpuidex(r, 7, 0);
+        avx2 = (r[1] & (1 << 5)) != 0;
+    }
+    return avx2 ? SimdLevel::Avx2 : sse2 ? SimdLevel::Sse2 : SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+#else
+
+SimdLevel DetectLevel() { return SimdLevel::Scalar; }
+
+#endif
+
+Kernels KernelsFor(SimdLevel level) {
+#ifdef TEXTCODEC_X86
+    if (level == SimdLevel::Avx2) return {NarrowAsciiAvx2, WidenAsciiAvx2, AsciiRunAvx2, JsonSpecialAvx2, BackslashAvx2, QuoteOrBackslashAvx2};
+    if (level == SimdLevel::Sse2) return {NarrowAsciiSse2, WidenAsciiSse2, AsciiRunSse2, JsonSpecialSse2, BackslashSse2, QuoteOrBackslashSse2};
+#endif
+    (void)level;
+    return {NarrowAsciiScalar, WidenAsciiScalar, AsciiRunScalar, JsonSpecialScalar, BackslashScalar, QuoteOrBackslashScalar};
+}
+
+struct Dispatch {
+    SimdLevel supported{DetectLevel()};
+    SimdLevel level{supported};
+    Kernels k{KernelsFor(level)};
+};
+
+Dispatch& Active() {
+    static Dispatch d;
+    return d;
+}
+
+// --- un carattere in scalare ---
+
+// da in[0] (non ASCII): scrive 2-4 byte e ritorna le unita' consumate
+size_t EncodeUtf8(const char16_t* in, size_t n, char* out, size_t& written) {
+    uint32_t c = in[0];
+    size_t used = 1;
+    if ((c & 0xF800) == 0xD800) {
+        if (c <= 0xDBFF && n > 1 && (in[1] & 0xFC00) == 0xDC00) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (in[1] - 0xDC00);
+            used = 2;
+        } else {
+            c = 0xFFFD; // surrogato spaiato
+        }
+    }
+    if (c < 0x800) {
+        out[0] = static_cast<char>(0xC0 | c >> 6);
+        out[1] = static_cast<char>(0x80 | (c & 0x3F));
+        written = 2;
+    } else if (c < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | c >> 12);
+        out[1] = static_cast<char>(0x80 | (c >> 6 & 0x3F));
+        out[2] = static_cast<char>(0x80 | (c & 0x3F));
+        written = 3;
+    } else {
+        out[0] = static_cast<char>(0xF0 | c >> 18);
+        out[1] = static_cast<char>(0x80 | (c >> 12 & 0x3F));
+        out[2] = static_cast<char>(0x80 | (c >> 6 & 0x3F));
+        out[3] = static_cast<char>(0x80 | (c & 0x3F));
+        written = 4;
+    }
+    return used;
+}
+
+// da in[0] (non ASCII): una sequenza, o la sua parte massimale non valida come un solo
+// U+FFFD (Unicode 3.9, come i browser); ritorna i byte consumati
+size_t DecodeUtf8(const unsigned char* in, size_t n, char16_t* out, size_t& written, bool& valid) {
+    const unsigned char b0 = in[0];
+    size_t len;
+    uint32_t c;
+    unsigned char lo = 0x80, hi = 0xBF; // limiti del secondo byte
+    if (b0 >= 0xC2 && b0 <= 0xDF) {
+        len = 2;
+        c = b0 & 0x1F;
+    } else if (b0 >= 0xE0 && b0 <= 0xEF) {
+        len = 3;
+        c = b0 & 0x0F;
+        if (b0 == 0xE0) lo = 0xA0;      // niente forme lunghe
+        else if (b0 == 0xED) hi = 0x9F; // niente surrogati
+    } else if (b0 >= 0xF0 && b0 <= 0xF4) {
+        len = 4;
+        c = b0 & 0x07;
+        if (b0 == 0xF0) lo = 0x90;
+        else if (b0 == 0xF4) hi = 0x8F; // non oltre U+10FFFF
+    } else {
+        out[0] = 0xFFFD;
+        written = 1;
+        valid = false;
+        return 1;
+    }
+    size_t i = 1;
+    for (; i < len && i < n; ++i) {
+        if (in[i] < lo || in[i] > hi) break;
+        c = c << 6 | (in[i] & 0x3F);
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    if (i < len) {
+        out[0] = 0xFFFD;
+        written = 1;
+        valid = false;
+        return i;
+    }
+    if (c >= 0x10000) {
+        c -= 0x10000;
+        out[0] = static_cast<char16_t>(0xD800 + (c >> 10));
+        out[1] = static_cast<char16_t>(0xDC00 + (c & 0x3FF));
+        written = 2;
+    } else {
+        out[0] = static_cast<char16_t>(c);
+        written = 1;
+    }
+    return len;
+}
+
+int HexValue(char16_t c) {
+    if (c >= u'0' && c <= u'9') return c - u'0';
+    if (c >= u'a' && c <= u'f') return c - u'a' + 10;
+    if (c >= u'A' && c <= u'F') return c - u'A' + 10;
+    return -1;
+}
+
+// --- conversioni, su qualunque stringa di unita' a 16 bit (u16string, wstring su Windows) ---
+
+template <class Str>
+char16_t* Data16(Str& s) {
+    static_assert(sizeof(typename Str::value_type) == 2);
+    return reinterpret_cast<char16_t*>(s.data());
+}
+
+template <class Str>
+void Append16(Str& out, const char16_t* p, size_t n) {
+    out.append(reinterpret_cast<const typename Str::value_type*>(p), n);
+}
+
+void Utf16ToUtf8(std::string& out, const char16_t* in, size_t n) {
+    const Kernels& k = Active().k;
+    size_t pos = out.size();
+    out.resize(pos + n + 16); // tutto ASCII; cresce al primo carattere lungo
+    size_t i = 0;
+    while (i < n) {
+        // ogni unita' che resta puo' valere al massimo 3 byte (una coppia ne vale 4 su 2)
+        const size_t need = (n - i) + 4;
+        if (out.size() - pos < need) out.resize(std::max(out.size() + out.size() / 2, pos + need + (n - i) / 2));
+        char* o = out.data() + pos;
+        const size_t ascii = k.narrowAscii(in + i, n - i, o);
+        i += ascii;
+        pos += ascii;
+        if (i >= n) break;
+        size_t written = 0;
+        i += EncodeUtf8(in + i, n - i, out.data() + pos, written);
+        pos += written;
+    }
+    out.resize(pos);
+}
+
+template <class Str>
+bool Utf8ToUtf16(Str& out, const char* in, size_t n) {
+    const Kernels& k = Active().k;
+    size_t pos = out.size();
+    out.resize(pos + n); // mai piu' unita' che byte
+    char16_t* o = Data16(out);
+    bool valid = true;
+    size_t i = 0;
+    while (i < n) {
+        const size_t ascii = k.widenAscii(in + i, n - i, o + pos);
+        i += ascii;
+        pos += ascii;
+        if (i >= n) break;
+        size_t written = 0;
+        i += DecodeUtf8(reinterpret_cast<const unsigned char*>(in) + i, n - i, o + pos, written, valid);
+        pos += written;
+    }
+    out.resize(pos);
+    return valid;
+}
+
+template <class Str>
+void JsonEscape(Str& out, const char16_t* in, size_t n) {
+    static const char16_t kHex[] = u"0123456789abcdef";
+    const Kernels& k = Active().k;
+    out.reserve(out.size() + n + n / 16 + 8);
+    size_t i = 0;
+    while (i < n) {
+        const size_t plain = k.jsonSpecial(in + i, n - i);
+        Append16(out, in + i, plain);
+        i += plain;
+        if (i >= n) break;
+        const char16_t c = in[i];
+        char16_t esc[6] = {u'\\', 0, 0, 0, 0, 0};
+        size_t len = 2;
+        switch (c) {
+            case u'"': esc[1] = u'"'; break;
+            case u'\\': esc[1] = u'\\'; break;
+            case u'\b': esc[1] = u'b'; break;
+            case u'\f': esc[1] = u'f'; break;
+            case u'\n': esc[1] = u'n'; break;
+            case u'\r': esc[1] = u'r'; break;
+            case u'\t': esc[1] = u't'; break;
+            default:
+                if (c >= 0xD800 && c <= 0xDBFF && i + 1 < n && (in[i + 1] & 0xFC00) == 0xDC00) {
+                    Append16(out, in + i, 2); // coppia valida: com'e'
+                    i += 2;
+                    continue;
+                }
+                esc[1] = u'u'; // controllo o surrogato spaiato
+                esc[2] = kHex[c >> 12];
+                esc[3] = kHex[c >> 8 & 0xF];
+                esc[4] = kHex[c >> 4 & 0xF];
+                esc[5] = kHex[c & 0xF];
+                len = 6;
+                break;
+        }
+        Append16(out, esc, len);
+        ++i;
+    }
+}
+
+template <class Str>
+bool JsonUnescape(Str& out, const char16_t* in, size_t n) {
+    const Kernels& k = Active().k;
+    out.reserve(out.size() + n);
+    bool valid = true;
+    size_t i = 0;
+    while (i < n) {
+        const size_t plain = k.backslash(in + i, n - i);
+        Append16(out, in + i, plain);
+        i += plain;
+        if (i >= n) break;
+        if (i + 1 >= n) { // barra finale: resta com'e'
+            Append16(out, in + i, 1);
+            valid = false;
+            break;
+        }
+        char16_t c = in[i + 1];
+        size_t used = 2;
+        switch (c) {
+            case u'"':
+            case u'\\':
+            case u'/': break;
+            case u'b': c = u'\b'; break;
+            case u'f': c = u'\f'; break;
+            case u'n': c = u'\n'; break;
+            case u'r': c = u'\r'; break;
+            case u't': c = u'\t'; break;
+            case u'u': {
+                // una coppia di surrogati escapata esce gia' come due unita' UTF-16
+                int v = 0;
+                size_t d = 0;
+                for (; d < 4 && i + 2 + d < n; ++d) {
+                    const int h = HexValue(in[i + 2 + d]);
+                    if (h < 0) break;
+                    v = v << 4 | h;
+                }
+                if (d == 4) {
+                    c = static_cast<char16_t>(v);
+                    used = 6;
+                } else {
+                    valid = false;
+                }
+                break;
+            }
+            default: valid = false; break;
+        }
+        Append16(out, &c, 1);
+        i += used;
+    }
+    return valid;
+}
+
+} // namespace
+
+SimdLevel TextCodecLevel() { return Active().level; }
+
+void SetTextCodecLevel(SimdLevel level) {
+    Dispatch& d = Active();
+    d.level = std::min(level, d.supported);
+    d.k = KernelsFor(d.level);
+}
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Sse2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+void AppendUtf8(std::string& out, std::u16string_view in) { Utf16ToUtf8(out, in.data(), in.size()); }
+
+bool AppendUtf16(std::u16string& out, std::string_view in) { return Utf8ToUtf16(out, in.data(), in.size()); }
+
+bool IsValidUtf8(std::string_view in) {
+    const Kernels& k = Active().k;
+    const auto* p = reinterpret_cast<const unsigned char*>(in.data());
+    const size_t n = in.size();
+    char16_t scratch[2];
+    size_t i = 0;
+    while (i < n) {
+        i += k.asciiRun(in.data() + i, n - i);
+        if (i >= n) break;
+        size_t written = 0;
+        bool valid = true;
+        i += DecodeUtf8(p + i, n - i, scratch, written, valid);
+        if (!valid) return false;
+    }
+    return true;
+}
+
+void AppendJsonEscaped(std::u16string& out, std::u16string_view in) { JsonEscape(out, in.data(), in.size()); }
+
+bool AppendJsonUnescaped(std::u16string& out, std::u16string_view in) { return JsonUnescape(out, in.data(), in.size()); }
+
+size_t FindJsonStringEnd(std::u16string_view s, size_t from) {
+    const Kernels& k = Active().k;
+    size_t i = from;
+    while (i < s.size()) {
+        i += k.quoteOrBackslash(s.data() + i, s.size() - i);
+        if (i >= s.size()) break;
+        if (s[i] == u'"') return i;
+        i += 2; // escape: il carattere dopo la barra non chiude
+    }
+    return std::u16string_view::npos;
+}
+
+#ifdef _WIN32
+void AppendUtf8(std::string& out, std::wstring_view in) { Utf16ToUtf8(out, reinterpret_cast<const char16_t*>(in.data()), in.size()); }
+
+bool AppendUtf16(std::wstring& out, std::string_view in) { return Utf8ToUtf16(out, in.data(), in.size()); }
+
+void AppendJsonEscaped(std::wstring& out, std::wstring_view in) { JsonEscape(out, reinterpret_cast<const char16_t*>(in.data()), in.size()); }
+
+bool AppendJsonUnescaped(std::wstring& out, std::wstring_view in) { return JsonUnescape(out, reinterpret_cast<const char16_t*>(in.data()), in.size()); }
+#endif
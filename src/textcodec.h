@@ -0,0 +1,50 @@
+#pragma once
+
+// Testo da e per il disco: UTF-16 <-> UTF-8 e stringhe JSON (RFC 8259).
+// Il testo delle note e' quasi tutto ASCII, quindi i cicli guardano 16-32 unita' alla
+// volta (SSE2, AVX2 se la CPU ce l'ha) e copiano in blocco finche' non trovano qualcosa
+// da trattare (un byte non ASCII, un carattere da escapare, un surrogato): solo li'
+// si passa al codice scalare, per un carattere, e poi si torna ai blocchi.
+//
+// Errori: le sequenze UTF-8 non valide e i surrogati spaiati diventano U+FFFD nella
+// conversione (come MultiByteToWideChar/WideCharToMultiByte). L'escape JSON invece
+// scrive i surrogati spaiati come \uXXXX, cosi' una nota passa da state.json intatta.
+//
+// Il nucleo e' su char16_t per poterlo provare e misurare anche su Linux; su Windows
+// wchar_t e' UTF-16 e gli overload per std::wstring scrivono direttamente li'.
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+enum class SimdLevel { Scalar, Sse2, Avx2 };
+
+SimdLevel TextCodecLevel();
+// per prove e misure: si puo' scendere di livello, mai salire oltre la CPU
+void SetTextCodecLevel(SimdLevel level);
+const char* SimdLevelName(SimdLevel level);
+
+void AppendUtf8(std::string& out, std::u16string_view in);
+// false se c'erano sequenze non valide (scritte come U+FFFD)
+bool AppendUtf16(std::u16string& out, std::string_view in);
+bool IsValidUtf8(std::string_view in);
+
+// contenuto di una stringa JSON, virgolette escluse: " \ e i controlli sotto U+0020
+// escapati (\b \f \n \r \t, gli altri \u00XX), i surrogati spaiati \uXXXX, il resto com'e'
+void AppendJsonEscaped(std::u16string& out, std::u16string_view in);
+// inverso, con \/ e \uXXXX; un escape sbagliato lascia il carattere dopo la barra.
+// false se ce n'erano
+bool AppendJsonUnescaped(std::u16string& out, std::u16string_view in);
+// virgoletta che chiude la stringa il cui contenuto comincia in from (dopo quella di
+// apertura), saltando gli escape; npos se manca
+size_t FindJsonStringEnd(std::u16string_view s, size_t from);
+
+#ifdef _WIN32
+inline std::u16string_view AsUtf16(std::wstring_view w) { return {reinterpret_cast<const char16_t*>(w.data()), w.size()}; }
+
+void AppendUtf8(std::string& out, std::wstring_view in);
+bool AppendUtf16(std::wstring& out, std::string_view in);
+void AppendJsonEscaped(std::wstring& out, std::wstring_view in);
+bool AppendJsonUnescaped(std::wstring& out, std::wstring_view in);
+inline size_t FindJsonStringEnd(std::wstring_view s, size_t from) { return FindJsonStringEnd(AsUtf16(s), from); }
+#endif
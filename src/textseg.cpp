@@ -0,0 +1,683 @@
+#include "textseg.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+namespace {
+
+// Proprieta' Word_Break / Grapheme_Cluster_Break fuse in un'unica tabella.
+// Scostamenti voluti: TAB conta come spazio; Hiragana e ideogrammi (Ideographic)
+// sono parole di un carattere; script SA (thai, khmer...) senza dizionario: una
+// corsa di lettere e' una parola.
+enum class Prop : uint8_t {
+    Other,
+    CR,
+    LF,
+    Newline,
+    Extend, // anche Format e SpacingMark
+    ZWJ,
+    RegionalIndicator,
+    ALetter,
+    HebrewLetter,
+    Numeric,
+    Katakana,
+    ExtendNumLet,
+    MidLetter,
+    MidNum,
+    MidNumLet,
+    SingleQuote,
+    DoubleQuote,
+    WSegSpace,
+    Ideographic,
+    ExtPict,
+    HangulL,
+    HangulV,
+    HangulT,
+    HangulSyllable, // LV o LVT, si distingue con l'aritmetica di AC00
+};
+
+struct PropRange {
+    char32_t lo;
+    char32_t hi;
+    Prop prop;
+};
+
+// ordinata e senza sovrapposizioni; quello che manca e' Other
+constexpr PropRange kProps[] = {
+    {0x0009, 0x0009, Prop::WSegSpace},
+    {0x000A, 0x000A, Prop::LF},
+    {0x000B, 0x000C, Prop::Newline},
+    {0x000D, 0x000D, Prop::CR},
+    {0x0020, 0x0020, Prop::WSegSpace},
+    {0x0022, 0x0022, Prop::DoubleQuote},
+    {0x0027, 0x0027, Prop::SingleQuote},
+    {0x002C, 0x002C, Prop::MidNum},
+    {0x002E, 0x002E, Prop::MidNumLet},
+    {0x0030, 0x0039, Prop::Numeric},
+    {0x003A, 0x003A, Prop::MidLetter},
+    {0x003B, 0x003B, Prop::MidNum},
+    {0x0041, 0x005A, Prop::ALetter},
+    {0x005F, 0x005F, Prop::ExtendNumLet},
+    {0x0061, 0x007A, Prop::ALetter},
+    {0x0085, 0x0085, Prop::Newline},
+    {0x00A9, 0x00A9, Prop::ExtPict},
+    {0x00AA, 0x00AA, Prop::ALetter},
+    {0x00AD, 0x00AD, Prop::Extend},
+    {0x00AE, 0x00AE, Prop::ExtPict},
+    {0x00B5, 0x00B5, Prop::ALetter},
+    {0x00B7, 0x00B7, Prop::MidLetter},
+    {0x00BA, 0x00BA, Prop::ALetter},
+    {0x00C0, 0x00D6, Prop::ALetter},
+    {0x00D8, 0x00F6, Prop::ALetter},
+    {0x00F8, 0x02D7, Prop::ALetter},
+    {0x02DE, 0x02FF, Prop::ALetter},
+    {0x0300, 0x036F, Prop::Extend},
+    {0x0370, 0x0374, Prop::ALetter},
+    {0x0376, 0x0377, Prop::ALetter},
+    {0x037A, 0x037D, Prop::ALetter},
+    {0x037E, 0x037E, Prop::MidNum},
+    {0x037F, 0x037F, Prop::ALetter},
+    {0x0386, 0x0386, Prop::ALetter},
+    {0x0387, 0x0387, Prop::MidLetter},
+    {0x0388, 0x038A, Prop::ALetter},
+    {0x038C, 0x038C, Prop::ALetter},
+    {0x038E, 0x03A1, Prop::ALetter},
+    {0x03A3, 0x03F5, Prop::ALetter},
+    {0x03F7, 0x0481, Prop::ALetter},
+    {0x0483, 0x0489, Prop::Extend},
+    {0x048A, 0x052F, Prop::ALetter},
+    {0x0531, 0x0556, Prop::ALetter},
+    {0x0559, 0x055C, Prop::ALetter},
+    {0x055E, 0x055E, Prop::ALetter},
+    {0x055F, 0x055F, Prop::MidLetter},
+    {0x0560, 0x0588, Prop::ALetter},
+    {0x0589, 0x0589, Prop::MidNum},
+    {0x058A, 0x058A, Prop::ALetter},
+    {0x0591, 0x05BD, Prop::Extend},
+    {0x05BF, 0x05BF, Prop::Extend},
+    {0x05C1, 0x05C2, Prop::Extend},
+    {0x05C4, 0x05C5, Prop::Extend},
+    {0x05C7, 0x05C7, Prop::Extend},
+    {0x05D0, 0x05EA, Prop::HebrewLetter},
+    {0x05EF, 0x05F2, Prop::HebrewLetter},
+    {0x05F3, 0x05F3, Prop::ALetter},
+    {0x05F4, 0x05F4, Prop::MidLetter},
+    {0x060C, 0x060D, Prop::MidNum},
+    {0x0610, 0x061A, Prop::Extend},
+    {0x061C, 0x061C, Prop::Extend},
+    {0x0620, 0x064A, Prop::ALetter},
+    {0x064B, 0x065F, Prop::Extend},
+    {0x0660, 0x0669, Prop::Numeric},
+    {0x066B, 0x066B, Prop::Numeric},
+    {0x066C, 0x066C, Prop::MidNum},
+    {0x066E, 0x066F, Prop::ALetter},
+    {0x0670, 0x0670, Prop::Extend},
+    {0x0671, 0x06D3, Prop::ALetter},
+    {0x06D5, 0x06D5, Prop::ALetter},
+    {0x06D6, 0x06DC, Prop::Extend},
+    {0x06DF, 0x06E4, Prop::Extend},
+    {0x06E5, 0x06E6, Prop::ALetter},
+    {0x06E7, 0x06E8, Prop::Extend},
+    {0x06EA, 0x06ED, Prop::Extend},
+    {0x06EE, 0x06EF, Prop::ALetter},
+    {0x06F0, 0x06F9, Prop::Numeric},
+    {0x06FA, 0x06FC, Prop::ALetter},
+    {0x06FF, 0x06FF, Prop::ALetter},
+    {0x0710, 0x0710, Prop::ALetter},
+    {0x0711, 0x0711, Prop::Extend},
+    {0x0712, 0x072F, Prop::ALetter},
+    {0x0730, 0x074A, Prop::Extend},
+    {0x074D, 0x07A5, Prop::ALetter},
+    {0x07A6, 0x07B0, Prop::Extend},
+    {0x07B1, 0x07B1, Prop::ALetter},
+    {0x07C0, 0x07C9, Prop::Numeric},
+    {0x07CA, 0x07EA, Prop::ALetter},
+    {0x07EB, 0x07F3, Prop::Extend},
+    {0x07F4, 0x07F5, Prop::ALetter},
+    {0x07F8, 0x07F8, Prop::MidNum},
+    {0x07FA, 0x07FA, Prop::ALetter},
+    {0x0900, 0x0903, Prop::Extend},
+    {0x0904, 0x0939, Prop::ALetter},
+    {0x093A, 0x093C, Prop::Extend},
+    {0x093D, 0x093D, Prop::ALetter},
+    {0x093E, 0x094F, Prop::Extend},
+    {0x0950, 0x0950, Prop::ALetter},
+    {0x0951, 0x0957, Prop::Extend},
+    {0x0958, 0x0961, Prop::ALetter},
+    {0x0962, 0x0963, Prop::Extend},
+    {0x0966, 0x096F, Prop::Numeric},
+    {0x0971, 0x0980, Prop::ALetter},
+    {0x0981, 0x0983, Prop::Extend},
+    {0x0985, 0x09B9, Prop::ALetter},
+    {0x09BC, 0x09BC, Prop::Extend},
+    {0x09BD, 0x09BD, Prop::ALetter},
+    {0x09BE, 0x09CD, Prop::Extend},
+    {0x09CE, 0x09CE, Prop::ALetter},
+    {0x09D7, 0x09D7, Prop::Extend},
+    {0x09DC, 0x09E1, Prop::ALetter},
+    {0x09E2, 0x09E3, Prop::Extend},
+    {0x09E6, 0x09EF, Prop::Numeric},
+    {0x09F0, 0x09F1, Prop::ALetter},
+    // altri script indiani: lettere e segni insieme (stessa parola), solo le cifre a parte
+    {0x0A01, 0x0A65, Prop::ALetter},
+    {0x0A66, 0x0A6F, Prop::Numeric},
+    {0x0A70, 0x0AE5, Prop::ALetter},
+    {0x0AE6, 0x0AEF, Prop::Numeric},
+    {0x0AF0, 0x0B65, Prop::ALetter},
+    {0x0B66, 0x0B6F, Prop::Numeric},
+    {0x0B70, 0x0BE5, Prop::ALetter},
+    {0x0BE6, 0x0BEF, Prop::Numeric},
+    {0x0BF0, 0x0C65, Prop::ALetter},
+    {0x0C66, 0x0C6F, Prop::Numeric},
+    {0x0C70, 0x0CE5, Prop::ALetter},
+    {0x0CE6, 0x0CEF, Prop::Numeric},
+    {0x0CF0, 0x0D65, Prop::ALetter},
+    {0x0D66, 0x0D6F, Prop::Numeric},
+    {0x0D70, 0x0DFF, Prop::ALetter},
+    {0x0E01, 0x0E30, Prop::ALetter},
+    {0x0E31, 0x0E31, Prop::Extend},
+    {0x0E32, 0x0E33, Prop::ALetter},
+    {0x0E34, 0x0E3A, Prop::Extend},
+    {0x0E40, 0x0E46, Prop::ALetter},
+    {0x0E47, 0x0E4E, Prop::Extend},
+    {0x0E50, 0x0E59, Prop::Numeric},
+    {0x0E81, 0x0EC6, Prop::ALetter},
+    {0x0EC8, 0x0ECE, Prop::Extend},
+    {0x0ED0, 0x0ED9, Prop::Numeric},
+    {0x0F00, 0x0F00, Prop::ALetter},
+    {0x0F20, 0x0F29, Prop::Numeric},
+    {0x0F40, 0x0F6C, Prop::ALetter},
+    {0x0F71, 0x0F84, Prop::Extend},
+    {0x1000, 0x103F, Prop::ALetter},
+    {0x1040, 0x1049, Prop::Numeric},
+    {0x1050, 0x109F, Prop::ALetter},
+    {0x10A0, 0x10FF, Prop::ALetter},
+    {0x1100, 0x115F, Prop::HangulL},
+    {0x1160, 0x11A7, Prop::HangulV},
+    {0x11A8, 0x11FF, Prop::HangulT},
+    {0x1200, 0x139F, Prop::ALetter},
+    {0x13A0, 0x13FF, Prop::ALetter},
+    {0x1401, 0x167F, Prop::ALetter},
+    {0x1680, 0x1680, Prop::WSegSpace},
+    {0x1681, 0x169A, Prop::ALetter},
+    {0x16A0, 0x16EA, Prop::ALetter},
+    {0x1780, 0x17B3, Prop::ALetter},
+    {0x17B4, 0x17D3, Prop::Extend},
+    {0x17E0, 0x17E9, Prop::Numeric},
+    {0x1810, 0x1819, Prop::Numeric},
+    {0x1820, 0x1878, Prop::ALetter},
+    {0x1AB0, 0x1AFF, Prop::Extend},
+    {0x1D00, 0x1DBF, Prop::ALetter},
+    {0x1DC0, 0x1DFF, Prop::Extend},
+    {0x1E00, 0x1FBC, Prop::ALetter},
+    {0x1FBE, 0x1FBE, Prop::ALetter},
+    {0x1FC2, 0x1FCC, Prop::ALetter},
+    {0x1FD0, 0x1FDB, Prop::ALetter},
+    {0x1FE0, 0x1FEC, Prop::ALetter},
+    {0x1FF2, 0x1FFC, Prop::ALetter},
+    {0x2000, 0x2006, Prop::WSegSpace},
+    {0x2008, 0x200A, Prop::WSegSpace},
+    {0x200C, 0x200C, Prop::Extend},
+    {0x200D, 0x200D, Prop::ZWJ},
+    {0x200E, 0x200F, Prop::Extend},
+    {0x2018, 0x2019, Prop::MidNumLet},
+    {0x2024, 0x2024, Prop::MidNumLet},
+    {0x2027, 0x2027, Prop::MidLetter},
+    {0x2028, 0x2029, Prop::Newline},
+    {0x202A, 0x202E, Prop::Extend},
+    {0x202F, 0x202F, Prop::ExtendNumLet},
+    {0x203C, 0x203C, Prop::ExtPict},
+    {0x203F, 0x2040, Prop::ExtendNumLet},
+    {0x2044, 0x2044, Prop::MidNum},
+    {0x2049, 0x2049, Prop::ExtPict},
+    {0x2054, 0x2054, Prop::ExtendNumLet},
+    {0x205F, 0x205F, Prop::WSegSpace},
+    {0x2060, 0x2064, Prop::Extend},
+    {0x2066, 0x206F, Prop::Extend},
+    {0x2071, 0x2071, Prop::ALetter},
+    {0x207F, 0x207F, Prop::ALetter},
+    {0x2090, 0x209C, Prop::ALetter},
+    {0x20D0, 0x20F0, Prop::Extend},
+    {0x2102, 0x2102, Prop::ALetter},
+    {0x2107, 0x2107, Prop::ALetter},
+    {0x210A, 0x2113, Prop::ALetter},
+    {0x2115, 0x2115, Prop::ALetter},
+    {0x2119, 0x211D, Prop::ALetter},
+    {0x2122, 0x2122, Prop::ExtPict},
+    {0x2124, 0x2124, Prop::ALetter},
+    {0x2126, 0x2126, Prop::ALetter},
+    {0x2128, 0x2128, Prop::ALetter},
+    {0x212A, 0x212D, Prop::ALetter},
+    {0x212F, 0x2138, Prop::ALetter},
+    {0x2139, 0x2139, Prop::ExtPict},
+    {0x213C, 0x213F, Prop::ALetter},
+    {0x2145, 0x2149, Prop::ALetter},
+    {0x214E, 0x214E, Prop::ALetter},
+    {0x2160, 0x2188, Prop::ALetter},
+    {0x2194, 0x2199, Prop::ExtPict},
+    {0x21A9, 0x21AA, Prop::ExtPict},
+    {0x231A, 0x231B, Prop::ExtPict},
+    {0x2328, 0x2328, Prop::ExtPict},
+    {0x23CF, 0x23CF, Prop::ExtPict},
+    {0x23E9, 0x23F3, Prop::ExtPict},
+    {0x23F8, 0x23FA, Prop::ExtPict},
+    {0x24B6, 0x24E9, Prop::ALetter},
+    {0x25AA, 0x25AB, Prop::ExtPict},
+    {0x25B6, 0x25B6, Prop::ExtPict},
+    {0x25C0, 0x25C0, Prop::ExtPict},
+    {0x25FB, 0x25FE, Prop::ExtPict},
+    {0x2600, 0x27BF, Prop::ExtPict},
+    {0x2934, 0x2935, Prop::ExtPict},
+    {0x2B05, 0x2B07, Prop::ExtPict},
+    {0x2B1B, 0x2B1C, Prop::ExtPict},
+    {0x2B50, 0x2B50, Prop::ExtPict},
+    {0x2B55, 0x2B55, Prop::ExtPict},
+    {0x2C00, 0x2CE4, Prop::ALetter},
+    {0x2CEB, 0x2CEE, Prop::ALetter},
+    {0x2CEF, 0x2CF1, Prop::Extend},
+    {0x2CF2, 0x2CF3, Prop::ALetter},
+    {0x2D00, 0x2D2D, Prop::ALetter},
+    {0x2D30, 0x2D6F, Prop::ALetter},
+    {0x2D7F, 0x2D7F, Prop::Extend},
+    {0x2D80, 0x2DDE, Prop::ALetter},
+    {0x2DE0, 0x2DFF, Prop::Extend},
+    {0x2E2F, 0x2E2F, Prop::ALetter},
+    {0x3000, 0x3000, Prop::WSegSpace},
+    {0x3005, 0x3005, Prop::ALetter},
+    {0x3006, 0x3007, Prop::Ideographic},
+    {0x3021, 0x3029, Prop::Ideographic},
+    {0x302A, 0x302F, Prop::Extend},
+    {0x3030, 0x3030, Prop::ExtPict},
+    {0x3031, 0x3035, Prop::Katakana},
+    {0x3038, 0x303A, Prop::Ideographic},
+    {0x303B, 0x303C, Prop::ALetter},
+    {0x303D, 0x303D, Prop::ExtPict},
+    {0x3041, 0x3096, Prop::Ideographic},
+    {0x3099, 0x309A, Prop::Extend},
+    {0x309B, 0x309C, Prop::Katakana},
+    {0x309D, 0x309F, Prop::Ideographic},
+    {0x30A0, 0x30FA, Prop::Katakana},
+    {0x30FC, 0x30FF, Prop::Katakana},
+    {0x3105, 0x312F, Prop::ALetter},
+    {0x3131, 0x318E, Prop::ALetter},
+    {0x31A0, 0x31BF, Prop::ALetter},
+    {0x31F0, 0x31FF, Prop::Katakana},
+    {0x3297, 0x3297, Prop::ExtPict},
+    {0x3299, 0x3299, Prop::ExtPict},
+    {0x32D0, 0x32FE, Prop::Katakana},
+    {0x3300, 0x3357, Prop::Katakana},
+    {0x3400, 0x4DBF, Prop::Ideographic},
+    {0x4E00, 0x9FFF, Prop::Ideographic},
+    {0xA000, 0xA48C, Prop::ALetter},
+    {0xA4D0, 0xA4FD, Prop::ALetter},
+    {0xA500, 0xA60C, Prop::ALetter},
+    {0xA610, 0xA61F, Prop::ALetter},
+    {0xA620, 0xA629, Prop::Numeric},
+    {0xA62A, 0xA62B, Prop::ALetter},
+    {0xA640, 0xA66E, Prop::ALetter},
+    {0xA66F, 0xA672, Prop::Extend},
+    {0xA674, 0xA67D, Prop::Extend},
+    {0xA67F, 0xA69D, Prop::ALetter},
+    {0xA69E, 0xA69F, Prop::Extend},
+    {0xA6A0, 0xA6EF, Prop::ALetter},
+    {0xA6F0, 0xA6F1, Prop::Extend},
+    {0xA717, 0xA7FF, Prop::ALetter},
+    {0xA960, 0xA97C, Prop::HangulL},
+    {0xAC00, 0xD7A3, Prop::HangulSyllable},
+    {0xD7B0, 0xD7C6, Prop::HangulV},
+    {0xD7CB, 0xD7FB, Prop::HangulT},
+    {0xF900, 0xFAFF, Prop::Ideographic},
+    {0xFB00, 0xFB06, Prop::ALetter},
+    {0xFB13, 0xFB17, Prop::ALetter},
+    {0xFB1D, 0xFB1D, Prop::HebrewLetter},
+    {0xFB1E, 0xFB1E, Prop::Extend},
+    {0xFB1F, 0xFB28, Prop::HebrewLetter},
+    {0xFB2A, 0xFB36, Prop::HebrewLetter},
+    {0xFB38, 0xFB3C, Prop::HebrewLetter},
+    {0xFB3E, 0xFB3E, Prop::HebrewLetter},
+    {0xFB40, 0xFB41, Prop::HebrewLetter},
+    {0xFB43, 0xFB44, Prop::HebrewLetter},
+    {0xFB46, 0xFB4F, Prop::HebrewLetter},
+    {0xFB50, 0xFBB1, Prop::ALetter},
+    {0xFBD3, 0xFD3D, Prop::ALetter},
+    {0xFD50, 0xFDFB, Prop::ALetter},
+    {0xFE00, 0xFE0F, Prop::Extend},
+    {0xFE10, 0xFE10, Prop::MidNum},
+    {0xFE13, 0xFE13, Prop::MidLetter},
+    {0xFE14, 0xFE14, Prop::MidNum},
+    {0xFE20, 0xFE2F, Prop::Extend},
+    {0xFE33, 0xFE34, Prop::ExtendNumLet},
+    {0xFE4D, 0xFE4F, Prop::ExtendNumLet},
+    {0xFE50, 0xFE50, Prop::MidNum},
+    {0xFE52, 0xFE52, Prop::MidNumLet},
+    {0xFE54, 0xFE54, Prop::MidNum},
+    {0xFE55, 0xFE55, Prop::MidLetter},
+    {0xFE70, 0xFEFC, Prop::ALetter},
+    {0xFEFF, 0xFEFF, Prop::Extend},
+    {0xFF07, 0xFF07, Prop::MidNumLet},
+    {0xFF0C, 0xFF0C, Prop::MidNum},
+    {0xFF0E, 0xFF0E, Prop::MidNumLet},
+    {0xFF10, 0xFF19, Prop::Numeric},
+    {0xFF1A, 0xFF1A, Prop::MidLetter},
+    {0xFF1B, 0xFF1B, Prop::MidNum},
+    {0xFF21, 0xFF3A, Prop::ALetter},
+    {0xFF3F, 0xFF3F, Prop::ExtendNumLet},
+    {0xFF41, 0xFF5A, Prop::ALetter},
+    {0xFF66, 0xFF9D, Prop::Katakana},
+    {0xFF9E, 0xFF9F, Prop::Extend},
+    {0xFFA0, 0xFFDC, Prop::ALetter},
+    {0x10000, 0x10FFF, Prop::ALetter},
+    {0x11000, 0x11FFF, Prop::ALetter},
+    {0x16800, 0x16FFF, Prop::ALetter},
+    {0x1B000, 0x1B000, Prop::Katakana},
+    {0x1B001, 0x1B11F, Prop::Ideographic},
+    {0x1D400, 0x1D7CB, Prop::ALetter},
+    {0x1D7CE, 0x1D7FF, Prop::Numeric},
+    {0x1E900, 0x1E94B, Prop::ALetter},
+    {0x1E950, 0x1E959, Prop::Numeric},
+    {0x1F000, 0x1F0FF, Prop::ExtPict},
+    {0x1F10D, 0x1F10F, Prop::ExtPict},
+    {0x1F130, 0x1F149, Prop::ALetter},
+    {0x1F150, 0x1F169, Prop::ALetter},
+    {0x1F170, 0x1F189, Prop::ALetter},
+    {0x1F18E, 0x1F18E, Prop::ExtPict},
+    {0x1F191, 0x1F19A, Prop::ExtPict},
+    {0x1F1E6, 0x1F1FF, Prop::RegionalIndicator},
+    {0x1F201, 0x1F20F, Prop::ExtPict},
+    {0x1F21A, 0x1F21A, Prop::ExtPict},
+    {0x1F22F, 0x1F22F, Prop::ExtPict},
+    {0x1F232, 0x1F23A, Prop::ExtPict},
+    {0x1F250, 0x1F251, Prop::ExtPict},
+    {0x1F300, 0x1F3FA, Prop::ExtPict},
+    {0x1F3FB, 0x1F3FF, Prop::Extend},
+    {0x1F400, 0x1FAFF, Prop::ExtPict},
+    {0x1FC00, 0x1FFFD, Prop::ExtPict},
+    {0x20000, 0x2FFFD, Prop::Ideographic},
+    {0x30000, 0x3FFFD, Prop::Ideographic},
+    {0xE0001, 0xE0001, Prop::Extend},
+    {0xE0020, 0xE007F, Prop::Extend},
+    {0xE0100, 0xE01EF, Prop::Extend},
+};
+
+Prop PropOf(char32_t c) {
+    auto it = std::upper_bound(std::begin(kProps), std::end(kProps), c, [](char32_t v, const PropRange& r) { return v < r.lo; });
+    if (it == std::begin(kProps)) return Prop::Other;
+    --it;
+    return c <= it->hi ? it->prop : Prop::Other;
+}
+
+// Control per i grafemi: i Format (Extend per le parole) qui spezzano
+bool IsGraphemeControl(char32_t c) {
+    return (c < 0x20 && c != 0x0A && c != 0x0D) || (c >= 0x7F && c <= 0x9F) || c == 0x00AD || c == 0x061C || c == 0x180E || c == 0x200B ||
+           c == 0x200E || c == 0x200F || (c >= 0x2028 && c <= 0x202E) || (c >= 0x2060 && c <= 0x206F) || c == 0xFEFF ||
+           (c >= 0xFFF0 && c <= 0xFFFB) || (c >= 0xE0000 && c <= 0xE001F) || (c >= 0xE0080 && c <= 0xE00FF) || (c >= 0xE01F0 && c <= 0xE0FFF);
+}
+
+bool IsHigh(char16_t u) { return u >= 0xD800 && u <= 0xDBFF; }
+bool IsLow(char16_t u) { return u >= 0xDC00 && u <= 0xDFFF; }
+
+// code point che inizia in i (surrogati isolati: l'unita' stessa)
+char32_t CodePointAt(Utf16View t, size_t i) {
+    const char16_t u = t.data[i];
+    if (IsHigh(u) && i + 1 < t.size && IsLow(t.data[i + 1])) return 0x10000 + ((char32_t(u) - 0xD800) << 10) + (char32_t(t.data[i + 1]) - 0xDC00);
+    return u;
+}
+
+size_t NextCodePoint(Utf16View t, size_t i) { return i + (IsHigh(t.data[i]) && i + 1 < t.size && IsLow(t.data[i + 1]) ? 2 : 1); }
+
+size_t PrevCodePoint(Utf16View t, size_t i) { return i - (i >= 2 && IsLow(t.data[i - 1]) && IsHigh(t.data[i - 2]) ? 2 : 1); }
+
+bool IsHangulLV(char32_t c) { return (c - 0xAC00) % 28 == 0; }
+
+bool IsGraphemeBoundary(Utf16View t, size_t i) {
+    if (i == 0 || i >= t.size) return true;
+    if (IsLow(t.data[i]) && IsHigh(t.data[i - 1])) return false; // dentro una coppia di surrogati
+
+    const size_t ai = PrevCodePoint(t, i);
+    const char32_t a = CodePointAt(t, ai);
+    const char32_t b = CodePointAt(t, i);
+    const Prop pa = PropOf(a);
+    const Prop pb = PropOf(b);
+
+    if (pa == Prop::CR && pb == Prop::LF) return false;                                   // GB3
+    if (pa == Prop::CR || pa == Prop::LF || IsGraphemeControl(a)) return true;             // GB4
+    if (pb == Prop::CR || pb == Prop::LF || IsGraphemeControl(b)) return true;             // GB5
+
+    const bool bV = pb == Prop::HangulV;
+    const bool bT = pb == Prop::HangulT;
+    if (pa == Prop::HangulL && (pb == Prop::HangulL || bV || pb == Prop::HangulSyllable)) return false; // GB6
+    if (((pa == Prop::HangulSyllable && IsHangulLV(a)) || pa == Prop::HangulV) && (bV || bT)) return false; // GB7
+    if (((pa == Prop::HangulSyllable && !IsHangulLV(a)) || pa == Prop::HangulT) && bT) return false;        // GB8
+
+    if (pb == Prop::Extend || pb == Prop::ZWJ) return false; // GB9, GB9a
+
+    if (pa == Prop::ZWJ && pb == Prop::ExtPict) { // GB11: ExtPict Extend* ZWJ x ExtPict
+        size_t j = ai;
+        while (j > 0 && i - j < kMaxWordScan) {
+            j = PrevCodePoint(t, j);
+            const Prop p = PropOf(CodePointAt(t, j));
+            if (p == Prop::ExtPict) return false;
+            if (p != Prop::Extend) break;
+        }
+        return true;
+    }
+
+    if (pa == Prop::RegionalIndicator && pb == Prop::RegionalIndicator) { // GB12/13: a coppie
+        size_t count = 1;
+        size_t j = ai;
+        while (j > 0 && i - j < kMaxWordScan) {
+            j = PrevCodePoint(t, j);
+            if (PropOf(CodePointAt(t, j)) != Prop::RegionalIndicator) break;
+            ++count;
+        }
+        return count % 2 == 0;
+    }
+    return true; // GB999
+}
+
+// classe di parola di un grafema: quella del primo code point, con l'hangul come lettera
+Prop WordProp(Utf16View t, size_t graphemeStart) {
+    const Prop p = PropOf(CodePointAt(t, graphemeStart));
+    switch (p) {
+        case Prop::HangulL:
+        case Prop::HangulV:
+        case Prop::HangulT:
+        case Prop::HangulSyllable: return Prop::ALetter;
+        default: return p;
+    }
+}
+
+bool IsIgnorable(Prop p) { return p == Prop::Extend || p == Prop::ZWJ; } // WB4
+bool IsNewline(Prop p) { return p == Prop::CR || p == Prop::LF || p == Prop::Newline; }
+bool IsAHLetter(Prop p) { return p == Prop::ALetter || p == Prop::HebrewLetter; }
+bool IsMidLetterQ(Prop p) { return p == Prop::MidLetter || p == Prop::MidNumLet || p == Prop::SingleQuote; }
+bool IsMidNumQ(Prop p) { return p == Prop::MidNum || p == Prop::MidNumLet || p == Prop::SingleQuote; }
+
+// grafema precedente (che finisce in i) saltando quelli ignorabili; start riceve il suo inizio
+Prop WordPropBefore(Utf16View t, size_t i, size_t& start) {
+    const size_t limit = i > kMaxWordScan ? i - kMaxWordScan : 0;
+    while (i > limit) {
+        i = PrevGraphemeBoundary(t, i);
+        const Prop p = WordProp(t, i);
+        if (!IsIgnorable(p)) {
+            start = i;
+            return p;
+        }
+    }
+    start = i;
+    return Prop::Other;
+}
+
+// grafema che inizia in i saltando quelli ignorabili; next riceve la fine
+Prop WordPropFrom(Utf16View t, size_t i, size_t& next) {
+    const size_t limit = i + kMaxWordScan;
+    while (i < t.size && i < limit) {
+        const Prop p = WordProp(t, i);
+        i = NextGraphemeBoundary(t, i);
+        if (!IsIgnorable(p)) {
+            next = i;
+            return p;
+        }
+    }
+    next = i;
+    return Prop::Other;
+}
+
+// i e' un confine di grafema
+bool IsWordBoundary(Utf16View t, size_t i) {
+    if (i == 0 || i >= t.size) return true;
+
+    size_t aStart = 0;
+    const Prop prevRaw = WordProp(t, PrevGraphemeBoundary(t, i));
+    const Prop b0 = WordProp(t, i);
+    if (IsNewline(prevRaw) || IsNewline(b0)) return true; // WB3a/b
+    if (IsIgnorable(b0)) return false;                    // WB4
+    if (prevRaw == Prop::WSegSpace && b0 == Prop::WSegSpace) return false; // WB3d
+
+    const Prop a = WordPropBefore(t, i, aStart);
+    size_t bNext = 0;
+    const Prop b = WordPropFrom(t, i, bNext);
+
+    auto after = [&] { size_t n; return WordPropFrom(t, bNext, n); };
+    auto before = [&] { size_t s; return aStart > 0 ? WordPropBefore(t, aStart, s) : Prop::Other; };
+
+    if (IsAHLetter(a) && IsAHLetter(b)) return false;                                      // WB5
+    if (IsAHLetter(a) && IsMidLetterQ(b) && IsAHLetter(after())) return false;             // WB6
+    if (IsMidLetterQ(a) && IsAHLetter(b) && IsAHLetter(before())) return false;            // WB7
+    if (a == Prop::HebrewLetter && b == Prop::SingleQuote) return false;                   // WB7a
+    if (a == Prop::HebrewLetter && b == Prop::DoubleQuote && after() == Prop::HebrewLetter) return false;  // WB7b
+    if (a == Prop::DoubleQuote && b == Prop::HebrewLetter && before() == Prop::HebrewLetter) return false; // WB7c
+    if (a == Prop::Numeric && b == Prop::Numeric) return false;                            // WB8
+    if (IsAHLetter(a) && b == Prop::Numeric) return false;                                 // WB9
+    if (a == Prop::Numeric && IsAHLetter(b)) return false;                                 // WB10
+    if (IsMidNumQ(a) && b == Prop::Numeric && before() == Prop::Numeric) return false;     // WB11
+    if (a == Prop::Numeric && IsMidNumQ(b) && after() == Prop::Numeric) return false;      // WB12
+    if (a == Prop::Katakana && b == Prop::Katakana) return false;                          // WB13
+    if ((IsAHLetter(a) || a == Prop::Numeric || a == Prop::Katakana || a == Prop::ExtendNumLet) && b == Prop::ExtendNumLet)
+        return false; // WB13a
+    if (a == Prop::ExtendNumLet && (IsAHLetter(b) || b == Prop::Numeric || b == Prop::Katakana)) return false; // WB13b
+    return true; // WB999 (le coppie di bandiere sono gia' un grafema solo)
+}
+
+WordSegment::Kind KindOf(Prop p) {
+    switch (p) {
+        case Prop::ALetter:
+        case Prop::HebrewLetter:
+        case Prop::Numeric:
+        case Prop::Katakana:
+        case Prop::ExtendNumLet:
+        case Prop::Ideographic: return WordSegment::Kind::Word;
+        case Prop::WSegSpace: return WordSegment::Kind::Space;
+        case Prop::CR:
+        case Prop::LF:
+        case Prop::Newline: return WordSegment::Kind::Newline;
+        default: return WordSegment::Kind::Other;
+    }
+}
+
+bool IsWordOrOther(WordSegment::Kind k) { return k == WordSegment::Kind::Word || k == WordSegment::Kind::Other; }
+
+} // namespace
+
+char16_t FoldCase(char16_t c) {
+    if (c >= u'A' && c <= u'Z') return c + 32;
+    if (c < 0xC0) return c;
+    if ((c >= 0xC0 && c <= 0xDE && c != 0xD7) || (c >= 0x391 && c <= 0x3AB && c != 0x3A2) || (c >= 0x410 && c <= 0x42F)) return c + 32;
+    if (c >= 0x400 && c <= 0x40F) return c + 80;
+    if ((c >= 0x100 && c <= 0x137) || (c >= 0x14A && c <= 0x177)) return c | 1;
+    if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) return (c & 1) ? c + 1 : c;
+    return c;
+}
+
+size_t NextGraphemeBoundary(Utf16View t, size_t pos) {
+    if (pos >= t.size) return t.size;
+    const size_t limit = pos + kMaxWordScan;
+    size_t i = NextCodePoint(t, pos);
+    while (i < t.size && i < limit && !IsGraphemeBoundary(t, i)) i = NextCodePoint(t, i);
+    return i;
+}
+
+size_t PrevGraphemeBoundary(Utf16View t, size_t pos) {
+    if (pos == 0) return 0;
+    pos = std::min(pos, t.size);
+    const size_t limit = pos > kMaxWordScan ? pos - kMaxWordScan : 0;
+    size_t i = PrevCodePoint(t, pos);
+    while (i > limit && !IsGraphemeBoundary(t, i)) i = PrevCodePoint(t, i);
+    return i;
+}
+
+WordSegment WordSegmentAt(Utf16View t, size_t pos) {
+    if (pos >= t.size) return WordSegment{t.size, t.size, WordSegment::Kind::Other};
+
+    size_t begin = IsGraphemeBoundary(t, pos) ? pos : PrevGraphemeBoundary(t, pos);
+    size_t end = NextGraphemeBoundary(t, begin);
+    while (begin > 0 && pos - begin < kMaxWordScan && !IsWordBoundary(t, begin)) begin = PrevGraphemeBoundary(t, begin);
+    while (end < t.size && end - pos < kMaxWordScan && !IsWordBoundary(t, end)) end = NextGraphemeBoundary(t, end);
+    return WordSegment{begin, end, KindOf(WordProp(t, begin))};
+}
+
+size_t WordLeft(Utf16View t, size_t pos) {
+    pos = std::min(pos, t.size);
+    size_t p = pos;
+    while (p > 0) {
+        const WordSegment s = WordSegmentAt(t, p - 1);
+        p = s.begin;
+        if (s.kind != WordSegment::Kind::Space || pos - p >= kMaxWordScan) break;
+    }
+    return p;
+}
+
+size_t WordRight(Utf16View t, size_t pos) {
+    if (pos >= t.size) return t.size;
+    size_t p = WordSegmentAt(t, pos).end;
+    while (p < t.size && p - pos < kMaxWordScan) {
+        const WordSegment s = WordSegmentAt(t, p);
+        if (s.kind != WordSegment::Kind::Space) break;
+        p = s.end;
+    }
+    return p;
+}
+
+size_t WordDeleteLeft(Utf16View t, size_t pos) {
+    pos = std::min(pos, t.size);
+    size_t p = pos;
+    while (p > 0) {
+        const WordSegment s = WordSegmentAt(t, p - 1);
+        if (s.kind != WordSegment::Kind::Space) break;
+        p = s.begin;
+    }
+    if (p == 0) return 0;
+
+    const WordSegment s = WordSegmentAt(t, p - 1);
+    if (s.kind != WordSegment::Kind::Other) return s.begin;
+
+    // punteggiatura/simboli: fino allo spazio precedente, parole comprese (come prima)
+    p = s.begin;
+    while (p > 0 && pos - p < kMaxWordScan) {
+        const WordSegment prev = WordSegmentAt(t, p - 1);
+        if (!IsWordOrOther(prev.kind)) break;
+        p = prev.begin;
+    }
+    return p;
+}
+
+size_t WordDeleteRight(Utf16View t, size_t pos) {
+    if (pos >= t.size) return t.size;
+    const WordSegment s = WordSegmentAt(t, pos);
+    if (s.kind == WordSegment::Kind::Space || s.kind == WordSegment::Kind::Newline) return s.end;
+
+    size_t p = s.end;
+    if (s.kind == WordSegment::Kind::Other) {
+        while (p < t.size && p - pos < kMaxWordScan) {
+            const WordSegment next = WordSegmentAt(t, p);
+            if (!IsWordOrOther(next.kind)) break;
+            p = next.end;
+        }
+    }
+    if (p < t.size) {
+        const WordSegment space = WordSegmentAt(t, p);
+        if (space.kind == WordSegment::Kind::Space) p = space.end;
+    }
+    return p;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Segmentazione del testo per la navigazione a parole: confini di grafema e di
+// parola secondo UAX #29 (regole principali, tabelle compatte per gli script
+// piu' comuni). Lavora direttamente sul buffer UTF-16 della EDIT, senza copie,
+// camminando dal cursore: ogni operazione guarda al massimo kMaxWordScan unita'
+// per lato, quindi il costo segue la lunghezza della parola e non della nota.
+
+#include <cstddef>
+
+struct Utf16View {
+    const char16_t* data{nullptr};
+    size_t size{0};
+};
+
+constexpr size_t kMaxWordScan = 4096;
+
+// confini di grafema (cluster percepito come un carattere: accenti, emoji, bandiere, hangul)
+size_t NextGraphemeBoundary(Utf16View t, size_t pos);
+size_t PrevGraphemeBoundary(Utf16View t, size_t pos);
+
+struct WordSegment {
+    size_t begin{0};
+    size_t end{0};
+    enum class Kind { Word, Space, Newline, Other } kind{Kind::Other}; // Other: punteggiatura, simboli
+};
+
+// segmento che contiene il carattere in pos (pos < size)
+WordSegment WordSegmentAt(Utf16View t, size_t pos);
+
+// Ctrl+Left / Ctrl+Right: inizio della parola precedente / successiva
+size_t WordLeft(Utf16View t, size_t pos);
+size_t WordRight(Utf16View t, size_t pos);
+
+// Ctrl+Backspace: spazi a sinistra, poi la parola (o il blocco di simboli) precedente.
+// Restituisce l'inizio dell'intervallo da cancellare, [risultato, pos).
+size_t WordDeleteLeft(Utf16View t, size_t pos);
+// Ctrl+Delete: la parola (o il blocco di simboli) e gli spazi che la seguono; su uno
+// spazio solo gli spazi. Restituisce la fine dell'intervallo da cancellare, [pos, risultato).
+size_t WordDeleteRight(Utf16View t, size_t pos);
+
+// minuscola per gli alfabeti delle note (latino, greco, cirillico); il resto resta com'e'.
+// Un'unita' sola: niente ß -> ss, e le maiuscole fuori da quei blocchi non cambiano.
+char16_t FoldCase(char16_t c);
@@ -0,0 +1,107 @@
+#include "textutil.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kP1 = 11400714785074694791ULL;
+constexpr uint64_t kP2 = 14029467366897019727ULL;
+constexpr uint64_t kP3 = 1609587929392839161ULL;
+constexpr uint64_t kP4 = 9650029242287828579ULL;
+constexpr uint64_t kP5 = 2870177450012600261ULL;
+
+inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t Read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v; // little-endian (x86/ARM)
+}
+
+inline uint32_t Read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kP2;
+    acc = Rotl(acc, 31);
+    return acc * kP1;
+}
+
+inline uint64_t MergeRound(uint64_t acc, uint64_t val) {
+    acc ^= Round(0, val);
+    return acc * kP1 + kP4;
+}
+
+} // namespace
+
+uint64_t ContentHash64(const void* data, size_t len, uint64_t seed) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + kP1 + kP2;
+        uint64_t v2 = seed + kP2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kP1;
+        const unsigned char* const limit = end - 32;
+        do {
+            v1 = Round(v1, Read64(p)); p += 8;
+            v2 = Round(v2, Read64(p)); p += 8;
+            v3 = Round(v3, Read64(p)); p += 8;
+            v4 = Round(v4, Read64(p)); p += 8;
+        } while (p <= limit);
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    } else {
+        h = seed + kP5;
+    }
+
+    h += static_cast<uint64_t>(len);
+    while (p + 8 <= end) {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * kP1 + kP4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(Read32(p)) * kP1;
+        h = Rotl(h, 23) * kP2 + kP3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * kP5;
+        h = Rotl(h, 11) * kP1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= kP2;
+    h ^= h >> 29;
+    h *= kP3;
+    h ^= h >> 32;
+    return h;
+}
+
+TextEdit DiffTexts(std::wstring_view before, std::wstring_view after) {
+    // a blocchi con memcmp (vettorizzata), poi carattere per carattere nel blocco diverso
+    constexpr size_t kBlock = 256;
+    const size_t common = std::min(before.size(), after.size());
+    size_t prefix = 0;
+    while (prefix + kBlock <= common && std::memcmp(before.data() + prefix, after.data() + prefix, kBlock * sizeof(wchar_t)) == 0) prefix += kBlock;
+    while (prefix < common && before[prefix] == after[prefix]) ++prefix;
+
+    const size_t room = common - prefix;
+    size_t suffix = 0;
+    while (suffix + kBlock <= room &&
+           std::memcmp(before.data() + before.size() - suffix - kBlock, after.data() + after.size() - suffix - kBlock, kBlock * sizeof(wchar_t)) == 0)
+        suffix += kBlock;
+    while (suffix < room && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) ++suffix;
+    return TextEdit{prefix, before.size() - prefix - suffix, after.size() - prefix - suffix};
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Utilita' sul contenuto condivise da piu' moduli: hash veloce dei byte (file di stato,
+// specchio, cronologia, cache dei paragrafi) e differenza fra due versioni di un testo
+// (autofit, markdown, main).
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// XXH64 del contenuto
+uint64_t ContentHash64(const void* data, size_t len, uint64_t seed = 0);
+inline uint64_t ContentHash64(const std::string& bytes) { return ContentHash64(bytes.data(), bytes.size()); }
+
+// modifica come sostituzione di un tratto: [at, at + removed) del vecchio testo
+// diventa [at, at + inserted) del nuovo
+struct TextEdit {
+    size_t at{0};
+    size_t removed{0};
+    size_t inserted{0};
+};
+
+// prefisso e suffisso comuni: da EN_CHANGE non si sa dove e' cambiato il testo
+TextEdit DiffTexts(std::wstring_view before, std::wstring_view after);
@@ -0,0 +1,515 @@
+#include "textview.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr size_t kMaxWraps = 4096;     // righe logiche con gli a capo in cache
+constexpr size_t kMaxRowUnits = 4096;  // riga visiva piu' lunga (testo senza spazi a larghezza enorme)
+constexpr size_t kMaxUndo = 256;
+constexpr ptrdiff_t kWalkLimit = 256;  // oltre, lo scorrimento salta con l'albero invece di contare le righe
+
+bool IsHighSurrogate(char16_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+bool IsLowSurrogate(char16_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+bool IsBreakSpace(char16_t c) { return c == u' ' || c == u'\t'; }
+
+} // namespace
+
+TextView::TextView() { SetText(u""); }
+
+void TextView::SetText(std::u16string_view text) {
+    text_.assign(text.data(), text.size());
+    starts_.assign(1, 0);
+    const char16_t* data = text_.data();
+    for (size_t i = 0, n = text_.size(); i < n; ++i) {
+        if (data[i] == u'\n') starts_.push_back(static_cast<uint32_t>(i + 1));
+    }
+    wraps_.clear();
+    ResetRows();
+    top_ = RowPos{};
+    caret_ = anchor_ = 0;
+    caretEnd_ = false;
+    goalX_ = -1;
+    undo_.clear();
+    redo_.clear();
+    typingRun_ = false;
+}
+
+void TextView::SetMetrics(const TextViewMetrics& m) {
+    const bool changed = m.version != metrics_.version || m.charWidth != metrics_.charWidth || m.lineHeight != metrics_.lineHeight;
+    metrics_ = m;
+    metrics_.lineHeight = std::max(1, metrics_.lineHeight);
+    metrics_.charWidth = std::max(1, metrics_.charWidth);
+    if (!changed) return;
+    wraps_.clear();
+    ResetRows();
+    ClampTop();
+}
+
+void TextView::SetViewport(int width, int height) {
+    width = std::max(1, width);
+    height_ = std::max(1, height);
+    if (width != width_) {
+        width_ = width;
+        wraps_.clear();
+        ResetRows();
+    }
+    ClampTop();
+}
+
+size_t TextView::LineOf(size_t pos) const {
+    return static_cast<size_t>(std::upper_bound(starts_.begin(), starts_.end(), pos) - starts_.begin()) - 1;
+}
+
+size_t TextView::LineEnd(size_t line) const {
+    size_t end = line + 1 < starts_.size() ? starts_[line + 1] - 1 : text_.size();
+    if (end > starts_[line] && text_[end - 1] == u'\r') --end;
+    return end;
+}
+
+size_t TextView::PageRows() const { return std::max(1, height_ / metrics_.lineHeight); }
+
+// --- righe visive ---------------------------------------------------------------------
+
+uint32_t TextView::EstimateRows(size_t line) const {
+    const uint64_t px = static_cast<uint64_t>(LineEnd(line) - starts_[line]) * static_cast<uint64_t>(metrics_.charWidth);
+    return static_cast<uint32_t>(std::max<uint64_t>(1, (px + width_ - 1) / width_));
+}
+
+void TextView::ResetRows() {
+    rows_.resize(starts_.size());
+    for (size_t i = 0; i < rows_.size(); ++i) rows_[i] = EstimateRows(i);
+    BuildTree();
+}
+
+void TextView::SetRows(size_t line, uint32_t rows) {
+    if (rows_[line] == rows) return;
+    TreeAdd(line, rows - rows_[line]);
+    rows_[line] = rows;
+}
+
+void TextView::BuildTree() {
+    const size_t n = rows_.size();
+    tree_.assign(n + 1, 0);
+    for (size_t i = 1; i <= n; ++i) {
+        tree_[i] += rows_[i - 1];
+        const size_t parent = i + (i & (0 - i));
+        if (parent <= n) tree_[parent] += tree_[i];
+    }
+}
+
+void TextView::TreeAdd(size_t line, uint32_t delta) {
+    for (size_t i = line + 1; i < tree_.size(); i += i & (0 - i)) tree_[i] += delta;
+}
+
+size_t TextView::RowsBefore(size_t line) const {
+    uint32_t sum = 0;
+    for (size_t i = std::min(line, tree_.size() - 1); i > 0; i -= i & (0 - i)) sum += tree_[i];
+    return sum;
+}
+
+TextView::RowPos TextView::FindRow(size_t row) const {
+    const size_t n = rows_.size();
+    size_t step = 1;
+    while (step * 2 <= n) step *= 2;
+    size_t line = 0;
+    size_t rest = row;
+    for (; step > 0; step /= 2) {
+        if (line + step <= n && tree_[line + step] <= rest) {
+            line += step;
+            rest -= tree_[line];
+        }
+    }
+    if (line >= n) return RowPos{n - 1, rows_[n - 1] - 1}; // oltre la fine
+    return RowPos{line, std::min<size_t>(rest, rows_[line] - 1)};
+}
+
+// A capo come la EDIT: dopo l'ultimo spazio che entra (gli spazi in fondo restano
+// appesi alla riga), a meta' parola solo se la parola da sola non ci sta.
+const std::vector<uint32_t>& TextView::Wrap(size_t line) {
+    auto it = wraps_.find(line);
+    if (it != wraps_.end()) return it->second;
+    if (wraps_.size() >= kMaxWraps) wraps_.clear();
+
+    std::vector<uint32_t>& out = wraps_[line];
+    out.push_back(0);
+    const size_t len = LineEnd(line) - starts_[line];
+    const std::u16string_view s(text_.data() + starts_[line], len);
+    // si misura poco piu' di quanto dice la stima; se entra tutto si raddoppia
+    size_t guess = static_cast<size_t>(width_ / metrics_.charWidth) * 3 / 2 + 8;
+    size_t pos = 0;
+    while (pos < len && metrics_.extents) {
+        size_t chunk = std::min(len - pos, guess);
+        size_t fit = 0;
+        for (;;) {
+            metrics_.extents(s.substr(pos, chunk), ends_);
+            fit = static_cast<size_t>(std::upper_bound(ends_.begin(), ends_.begin() + chunk, width_) - ends_.begin());
+            if (fit < chunk || chunk == len - pos || chunk >= kMaxRowUnits) break;
+            chunk = std::min({len - pos, chunk * 2, kMaxRowUnits});
+            guess = chunk;
+        }
+        if (fit == len - pos) break;
+
+        size_t brk = std::max<size_t>(fit, 1); // almeno un carattere per riga
+        if (brk < len - pos && IsLowSurrogate(s[pos + brk]) && IsHighSurrogate(s[pos + brk - 1])) {
+            if (brk > 1) --brk; // la coppia va a capo intera
+            else ++brk;
+        }
+        if (brk < len - pos && IsBreakSpace(s[pos + brk])) {
+            while (brk < len - pos && IsBreakSpace(s[pos + brk])) ++brk;
+        } else {
+            size_t k = brk;
+            while (k > 0 && !IsBreakSpace(s[pos + k - 1])) --k;
+            if (k > 0) brk = k;
+        }
+        if (brk >= len - pos) break;
+        pos += brk;
+        out.push_back(static_cast<uint32_t>(pos));
+    }
+    SetRows(line, static_cast<uint32_t>(out.size()));
+    ++wrapped_;
+    return out;
+}
+
+TextView::RowPos TextView::RowOfPos(size_t pos, bool atRowEnd) {
+    pos = std::min(pos, text_.size());
+    const size_t line = LineOf(pos);
+    const std::vector<uint32_t>& w = Wrap(line);
+    const size_t rel = pos - starts_[line];
+    size_t row = static_cast<size_t>(std::upper_bound(w.begin(), w.end(), rel) - w.begin()) - 1;
+    if (atRowEnd && row > 0 && w[row] == rel) --row;
+    return RowPos{line, row};
+}
+
+TextRow TextView::MakeRow(RowPos p) {
+    const std::vector<uint32_t>& w = Wrap(p.line);
+    const size_t row = std::min(p.row, w.size() - 1);
+    TextRow r;
+    r.line = p.line;
+    r.begin = starts_[p.line] + w[row];
+    r.last = row + 1 == w.size();
+    r.end = r.last ? LineEnd(p.line) : starts_[p.line] + w[row + 1];
+    return r;
+}
+
+bool TextView::NextRow(RowPos& p) {
+    if (p.row + 1 < RowCount(p.line)) {
+        ++p.row;
+        return true;
+    }
+    if (p.line + 1 >= starts_.size()) return false;
+    p = RowPos{p.line + 1, 0};
+    return true;
+}
+
+bool TextView::PrevRow(RowPos& p) {
+    if (p.row > 0) {
+        p.row = std::min(p.row, RowCount(p.line)) - 1;
+        return true;
+    }
+    if (p.line == 0) return false;
+    p = RowPos{p.line - 1, RowCount(p.line - 1) - 1};
+    return true;
+}
+
+TextView::RowPos TextView::Walk(RowPos p, ptrdiff_t rows) {
+    for (; rows > 0 && NextRow(p); --rows) {}
+    for (; rows < 0 && PrevRow(p); ++rows) {}
+    return p;
+}
+
+// la cima non va oltre il punto da cui l'ultima pagina finisce con l'ultima riga
+void TextView::ClampTop() {
+    const size_t lastLine = starts_.size() - 1;
+    const RowPos last = Walk(RowPos{lastLine, RowCount(lastLine) - 1}, 1 - static_cast<ptrdiff_t>(PageRows()));
+    if (last < top_) top_ = last;
+    top_.row = std::min(top_.row, RowCount(top_.line) - 1);
+}
+
+void TextView::ScrollTo(size_t row) {
+    top_ = FindRow(row);
+    // la stima diventa misura: la riga chiesta potrebbe non esserci piu'
+    top_.row = std::min(top_.row, RowCount(top_.line) - 1);
+    ClampTop();
+}
+
+void TextView::ScrollBy(ptrdiff_t rows) {
+    if (rows > kWalkLimit || rows < -kWalkLimit) {
+        const ptrdiff_t target = static_cast<ptrdiff_t>(TopRow()) + rows;
+        ScrollTo(static_cast<size_t>(std::max<ptrdiff_t>(0, target)));
+        return;
+    }
+    top_ = Walk(top_, rows);
+    ClampTop();
+}
+
+void TextView::ScrollToCaret() {
+    const RowPos c = RowOfPos(caret_, caretEnd_);
+    if (c < top_) {
+        top_ = c;
+        return;
+    }
+    const ptrdiff_t page = static_cast<ptrdiff_t>(PageRows());
+    const RowPos bottom = Walk(top_, page - 1);
+    if (bottom < c) top_ = Walk(c, 1 - page);
+}
+
+std::vector<TextRow> TextView::VisibleRows() {
+    std::vector<TextRow> out;
+    const size_t count = static_cast<size_t>((height_ + metrics_.lineHeight - 1) / metrics_.lineHeight);
+    RowPos p = top_;
+    p.row = std::min(p.row, RowCount(p.line) - 1);
+    do {
+        out.push_back(MakeRow(p));
+    } while (out.size() < count && NextRow(p));
+    return out;
+}
+
+// --- geometria ------------------------------------------------------------------------
+
+int TextView::XOf(const TextRow& row, size_t pos) {
+    if (pos <= row.begin || !metrics_.extents) return 0;
+    const size_t n = std::min(pos, row.end) - row.begin;
+    if (n == 0) return 0;
+    metrics_.extents(std::u16string_view(text_.data() + row.begin, n), ends_);
+    return ends_[n - 1];
+}
+
+size_t TextView::PosAtX(const TextRow& row, int x, bool* atRowEnd) {
+    if (atRowEnd) *atRowEnd = false;
+    const size_t n = row.end - row.begin;
+    if (x <= 0 || n == 0 || !metrics_.extents) return row.begin;
+    metrics_.extents(std::u16string_view(text_.data() + row.begin, n), ends_);
+    // il carattere sotto x va a chi e' piu' vicino dei suoi due bordi
+    int left = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (x < (left + ends_[i] + 1) / 2) {
+            size_t pos = row.begin + i;
+            if (pos > row.begin && IsLowSurrogate(text_[pos]) && IsHighSurrogate(text_[pos - 1])) --pos;
+            return pos;
+        }
+        left = ends_[i];
+    }
+    if (atRowEnd) *atRowEnd = !row.last;
+    return row.end;
+}
+
+size_t TextView::PosAt(int x, int y, bool* atRowEnd) {
+    const int lh = metrics_.lineHeight;
+    const ptrdiff_t rows = y >= 0 ? y / lh : -((-y + lh - 1) / lh);
+    RowPos p = top_;
+    p.row = std::min(p.row, RowCount(p.line) - 1);
+    p = Walk(p, rows);
+    return PosAtX(MakeRow(p), x, atRowEnd);
+}
+
+bool TextView::PointOf(size_t pos, bool atRowEnd, int& x, int& y) {
+    const RowPos c = RowOfPos(pos, atRowEnd);
+    if (c < top_) return false;
+    const size_t count = static_cast<size_t>((height_ + metrics_.lineHeight - 1) / metrics_.lineHeight);
+    RowPos p = top_;
+    for (size_t i = 0; i < count; ++i) {
+        if (p.line == c.line && p.row == c.row) {
+            x = XOf(MakeRow(c), pos);
+            y = static_cast<int>(i) * metrics_.lineHeight;
+            return true;
+        }
+        if (!NextRow(p)) break;
+    }
+    return false;
+}
+
+// --- cursore --------------------------------------------------------------------------
+
+// mai in mezzo a \r\n o a una coppia di surrogati: si torna indietro di uno
+size_t TextView::Snap(size_t pos) const {
+    pos = std::min(pos, text_.size());
+    if (pos == 0 || pos == text_.size()) return pos;
+    const char16_t prev = text_[pos - 1], next = text_[pos];
+    if ((prev == u'\r' && next == u'\n') || (IsHighSurrogate(prev) && IsLowSurrogate(next))) --pos;
+    return pos;
+}
+
+void TextView::SetSel(size_t anchor, size_t caret, bool atRowEnd) {
+    anchor_ = Snap(anchor);
+    caret_ = Snap(caret);
+    caretEnd_ = atRowEnd;
+    goalX_ = -1;
+    typingRun_ = false;
+}
+
+void TextView::Move(CaretMove m, bool extend) {
+    const bool selection = anchor_ != caret_;
+    size_t next = caret_;
+    bool end = false;
+    int goal = -1;
+    switch (m) {
+    case CaretMove::Left:
+        next = selection && !extend ? SelStart() : PrevGraphemeBoundary(View(), caret_);
+        break;
+    case CaretMove::Right:
+        next = selection && !extend ? SelEnd() : NextGraphemeBoundary(View(), caret_);
+        break;
+    case CaretMove::WordLeft: next = WordLeft(View(), caret_); break;
+    case CaretMove::WordRight: next = WordRight(View(), caret_); break;
+    case CaretMove::Up:
+    case CaretMove::Down:
+    case CaretMove::PageUp:
+    case CaretMove::PageDown: {
+        const RowPos from = RowOfPos(caret_, caretEnd_);
+        goal = goalX_ >= 0 ? goalX_ : XOf(MakeRow(from), caret_);
+        const ptrdiff_t page = static_cast<ptrdiff_t>(PageRows());
+        const ptrdiff_t delta = m == CaretMove::Up ? -1 : m == CaretMove::Down ? 1 : m == CaretMove::PageUp ? -page : page;
+        const RowPos to = Walk(from, delta);
+        if (to.line == from.line && to.row == from.row) {
+            // prima/ultima riga: la EDIT va all'inizio/fine solo con le pagine
+            if (m == CaretMove::PageUp) next = 0;
+            if (m == CaretMove::PageDown) next = text_.size();
+            break;
+        }
+        if (m == CaretMove::PageUp || m == CaretMove::PageDown) ScrollBy(delta); // il cursore resta allo stesso punto della vista
+        next = PosAtX(MakeRow(to), goal, &end);
+        break;
+    }
+    case CaretMove::Home: next = MakeRow(RowOfPos(caret_, caretEnd_)).begin; break;
+    case CaretMove::End: {
+        const TextRow row = MakeRow(RowOfPos(caret_, caretEnd_));
+        next = row.end;
+        end = !row.last;
+        break;
+    }
+    case CaretMove::DocStart: next = 0; break;
+    case CaretMove::DocEnd: next = text_.size(); break;
+    }
+    caret_ = next;
+    if (!extend) anchor_ = next;
+    caretEnd_ = end;
+    goalX_ = goal;
+    typingRun_ = false;
+    ScrollToCaret();
+}
+
+void TextView::SelectWordAt(size_t pos) {
+    if (text_.empty()) return;
+    WordSegment seg = WordSegmentAt(View(), std::min(pos, text_.size() - 1));
+    // oltre la fine riga: si prende quel che la precede, non l'a capo
+    if (seg.kind == WordSegment::Kind::Newline && seg.begin > 0) seg = WordSegmentAt(View(), seg.begin - 1);
+    SetSel(seg.begin, seg.end);
+}
+
+// --- modifiche ------------------------------------------------------------------------
+
+// Gli inizi riga in (at, at + removed] spariscono con i loro a capo, quelli del testo
+// nuovo entrano, i successivi si spostano. Le righe logiche toccate tornano a stima;
+// se il numero di righe cambia l'albero si rifa' (lineare, ma solo somme).
+void TextView::Replace(size_t at, size_t removed, std::u16string_view inserted) {
+    const size_t first = LineOf(at);
+    const size_t last = LineOf(at + removed);
+    text_.replace(at, removed, inserted.data(), inserted.size());
+
+    std::vector<uint32_t> added;
+    for (size_t i = 0; i < inserted.size(); ++i) {
+        if (inserted[i] == u'\n') added.push_back(static_cast<uint32_t>(at + i + 1));
+    }
+    const uint32_t delta = static_cast<uint32_t>(inserted.size() - removed); // modulo 2^32
+    const size_t oldLines = last - first + 1;
+    const size_t newLines = added.size() + 1;
+
+    starts_.erase(starts_.begin() + first + 1, starts_.begin() + last + 1);
+    starts_.insert(starts_.begin() + first + 1, added.begin(), added.end());
+    for (size_t k = first + newLines; k < starts_.size(); ++k) starts_[k] += delta;
+
+    if (oldLines == newLines) {
+        for (size_t k = first; k <= last; ++k) {
+            wraps_.erase(k);
+            SetRows(k, EstimateRows(k));
+        }
+    } else {
+        rows_.erase(rows_.begin() + first, rows_.begin() + last + 1);
+        rows_.insert(rows_.begin() + first, newLines, 1);
+        for (size_t k = first; k < first + newLines; ++k) rows_[k] = EstimateRows(k);
+        BuildTree();
+        wraps_.clear(); // le chiavi dopo first sono cambiate; si rifanno solo quelle che servono
+    }
+
+    if (top_.line > last) top_.line = top_.line - oldLines + newLines;
+    else if (top_.line > first) top_ = RowPos{first, 0};
+}
+
+bool TextView::Edit(size_t from, size_t to, std::u16string_view s, bool typing) {
+    if (from == to && s.empty()) return false;
+    const bool joins = typing && typingRun_ && !undo_.empty() && from == to && s.find(u'\n') == std::u16string_view::npos &&
+                       undo_.back().at + undo_.back().inserted.size() == from;
+    if (joins) {
+        undo_.back().inserted.append(s.data(), s.size());
+    } else {
+        if (undo_.size() >= kMaxUndo) undo_.erase(undo_.begin());
+        undo_.push_back(UndoStep{from, text_.substr(from, to - from), std::u16string(s), anchor_, caret_});
+    }
+    redo_.clear();
+
+    Replace(from, to - from, s);
+    caret_ = anchor_ = from + s.size();
+    caretEnd_ = false;
+    goalX_ = -1;
+    typingRun_ = typing;
+    ScrollToCaret();
+    return true;
+}
+
+bool TextView::Type(std::u16string_view s) { return Edit(SelStart(), SelEnd(), s, s.size() == 1); }
+
+bool TextView::DeleteBack(bool word) {
+    if (anchor_ != caret_) return Edit(SelStart(), SelEnd(), u"", false);
+    if (caret_ == 0) return false;
+    // una unita' alla volta come la EDIT (un accento si toglie da solo), ma mai meta' di \r\n o di una coppia
+    size_t from = caret_ - 1;
+    if (word) from = WordDeleteLeft(View(), caret_);
+    else if (from > 0 && ((text_[from] == u'\n' && text_[from - 1] == u'\r') || (IsLowSurrogate(text_[from]) && IsHighSurrogate(text_[from - 1])))) --from;
+    return Edit(from, caret_, u"", false);
+}
+
+bool TextView::DeleteForward(bool word) {
+    if (anchor_ != caret_) return Edit(SelStart(), SelEnd(), u"", false);
+    if (caret_ >= text_.size()) return false;
+    const size_t to = word ? WordDeleteRight(View(), caret_) : NextGraphemeBoundary(View(), caret_);
+    return Edit(caret_, to, u"", false);
+}
+
+void TextView::Restore(size_t at, size_t removed, std::u16string_view inserted) {
+    Replace(at, removed, inserted);
+    caretEnd_ = false;
+    goalX_ = -1;
+    typingRun_ = false;
+}
+
+bool TextView::Undo() {
+    if (undo_.empty()) return false;
+    UndoStep step = std::move(undo_.back());
+    undo_.pop_back();
+    Restore(step.at, step.inserted.size(), step.removed);
+    anchor_ = step.anchor;
+    caret_ = step.caret;
+    ScrollToCaret();
+    redo_.push_back(std::move(step));
+    return true;
+}
+
+bool TextView::Redo() {
+    if (redo_.empty()) return false;
+    UndoStep step = std::move(redo_.back());
+    redo_.pop_back();
+    Restore(step.at, step.removed.size(), step.inserted);
+    caret_ = anchor_ = step.at + step.inserted.size();
+    ScrollToCaret();
+    undo_.push_back(std::move(step));
+    return true;
+}
+
+size_t TextView::MemoryBytes() const {
+    size_t bytes = text_.capacity() * sizeof(char16_t) + (starts_.capacity() + rows_.capacity() + tree_.capacity()) * sizeof(uint32_t);
+    for (const auto& [line, w] : wraps_) bytes += w.capacity() * sizeof(uint32_t) + 48;
+    for (const UndoStep& s : undo_) bytes += (s.removed.capacity() + s.inserted.capacity()) * sizeof(char16_t);
+    for (const UndoStep& s : redo_) bytes += (s.removed.capacity() + s.inserted.capacity()) * sizeof(char16_t);
+    return bytes;
+}
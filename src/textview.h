@@ -0,0 +1,164 @@
+#pragma once
+
+// Note lunghe in una tile che scorre. La EDIT di sistema rifa' gli a capo di tutta la
+// nota a ogni tasto e con qualche megabyte diventa inutilizzabile; qui il testo ha un
+// indice degli inizi riga (riga logica = fino all'a capo) e gli a capo automatici si
+// calcolano solo per le righe logiche che servono (quelle in vista, quella del cursore),
+// in una cache per riga. Le righe mai misurate contano per una stima (lunghezza per
+// larghezza media); un albero di Fenwick sulle righe visive di ogni riga logica da' la
+// posizione della barra e il salto a una riga qualunque in O(log n). La cima della vista
+// e' ancorata a (riga logica, riga visiva): una stima che diventa misura da un'altra
+// parte non sposta quello che si vede.
+//
+// Cursore, selezione, frecce, pagine e clic lavorano sull'indice e sugli a capo delle
+// righe toccate; grafemi e parole vengono da textseg. Una modifica sposta gli inizi riga
+// successivi e rimisura solo le righe cambiate. La misura vera del testo sta in main.cpp
+// (GetTextExtentExPointW): qui si passa una funzione, cosi' il modello gira anche con
+// metriche sintetiche.
+
+#include "textseg.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct TextViewMetrics {
+    // px alla fine di ogni unita' del tratto, cumulativi (come alpDx di GetTextExtentExPointW)
+    std::function<void(std::u16string_view text, std::vector<int>& ends)> extents;
+    int lineHeight{16};
+    int charWidth{8}; // media: stima delle righe non ancora misurate
+    int version{0};   // cambia col font: tutti gli a capo da rifare
+};
+
+// riga visiva: tratto [begin, end) del testo, a capo escluso
+struct TextRow {
+    size_t begin{0};
+    size_t end{0};
+    size_t line{0};
+    bool last{true}; // ultima riga visiva della sua riga logica
+};
+
+enum class CaretMove { Left, Right, WordLeft, WordRight, Up, Down, PageUp, PageDown, Home, End, DocStart, DocEnd };
+
+class TextView {
+public:
+    TextView();
+
+    void SetText(std::u16string_view text); // da zero: cursore in cima, annullamenti persi
+    const std::u16string& Text() const { return text_; }
+
+    void SetMetrics(const TextViewMetrics& m);
+    void SetViewport(int width, int height); // area del testo in px
+
+    size_t LineCount() const { return starts_.size(); }
+    size_t LineOf(size_t pos) const;
+    size_t LineStart(size_t line) const { return starts_[line]; }
+    size_t LineEnd(size_t line) const; // a capo (\r\n o \n) escluso
+
+    // scorrimento in righe visive (quelle non ancora misurate valgono la stima)
+    size_t TotalRows() const { return RowsBefore(starts_.size()); }
+    size_t PageRows() const; // righe intere nell'altezza, almeno 1
+    int LineHeight() const { return metrics_.lineHeight; }
+    size_t TopRow() const { return RowsBefore(top_.line) + top_.row; }
+    void ScrollTo(size_t row);
+    void ScrollBy(ptrdiff_t rows);
+    void ScrollToCaret();
+    // dalla cima, quelle che entrano nell'altezza (anche l'ultima tagliata)
+    std::vector<TextRow> VisibleRows();
+
+    // geometria, relativa all'area del testo
+    int XOf(const TextRow& row, size_t pos); // px dall'inizio della riga
+    // atRowEnd: pos e' la fine di una riga spezzata (si disegna li', non a capo della successiva)
+    size_t PosAt(int x, int y, bool* atRowEnd = nullptr);
+    bool PointOf(size_t pos, bool atRowEnd, int& x, int& y); // false se la riga non e' in vista
+
+    // cursore e selezione: anchor e' l'estremo fermo, caret quello che si muove
+    size_t Caret() const { return caret_; }
+    size_t Anchor() const { return anchor_; }
+    bool CaretAtRowEnd() const { return caretEnd_; }
+    size_t SelStart() const { return anchor_ < caret_ ? anchor_ : caret_; }
+    size_t SelEnd() const { return anchor_ < caret_ ? caret_ : anchor_; }
+    void SetSel(size_t anchor, size_t caret, bool atRowEnd = false);
+    void Move(CaretMove m, bool extend);
+    void SelectWordAt(size_t pos);
+    std::u16string SelectedText() const { return text_.substr(SelStart(), SelEnd() - SelStart()); }
+
+    // modifiche; false se non e' cambiato niente. I caratteri scritti di fila si annullano insieme.
+    bool Type(std::u16string_view s); // al posto della selezione
+    bool DeleteBack(bool word);
+    bool DeleteForward(bool word);
+    bool Undo();
+    bool Redo();
+
+    // per le misure
+    size_t WrappedLines() const { return wrapped_; } // a capo calcolati finora (righe logiche)
+    size_t MemoryBytes() const;
+
+private:
+    struct RowPos {
+        size_t line{0};
+        size_t row{0};
+        bool operator<(const RowPos& o) const { return line != o.line ? line < o.line : row < o.row; }
+    };
+    struct UndoStep {
+        size_t at{0};
+        std::u16string removed;
+        std::u16string inserted;
+        size_t anchor{0}; // selezione prima della modifica
+        size_t caret{0};
+    };
+
+    Utf16View View() const { return Utf16View{text_.data(), text_.size()}; }
+    size_t Snap(size_t pos) const;
+
+    void Replace(size_t at, size_t removed, std::u16string_view inserted);
+    bool Edit(size_t from, size_t to, std::u16string_view s, bool typing);
+    void Restore(size_t at, size_t removed, std::u16string_view inserted);
+
+    // inizi delle righe visive di una riga logica, relativi alla riga (il primo e' 0)
+    const std::vector<uint32_t>& Wrap(size_t line);
+    size_t RowCount(size_t line) { return Wrap(line).size(); }
+    uint32_t EstimateRows(size_t line) const;
+    void ResetRows();
+    void SetRows(size_t line, uint32_t rows);
+
+    void BuildTree();
+    void TreeAdd(size_t line, uint32_t delta); // modulo 2^32: anche in meno
+    size_t RowsBefore(size_t line) const;
+    RowPos FindRow(size_t row) const; // secondo le stime
+
+    RowPos RowOfPos(size_t pos, bool atRowEnd);
+    TextRow MakeRow(RowPos p);
+    bool NextRow(RowPos& p);
+    bool PrevRow(RowPos& p);
+    RowPos Walk(RowPos p, ptrdiff_t rows);
+    void ClampTop();
+    size_t PosAtX(const TextRow& row, int x, bool* atRowEnd);
+
+    std::u16string text_;
+    std::vector<uint32_t> starts_; // inizio di ogni riga logica (la prima e' 0)
+    std::vector<uint32_t> rows_;   // righe visive per riga logica, misurate o stimate
+    std::vector<uint32_t> tree_;   // Fenwick su rows_
+    std::unordered_map<size_t, std::vector<uint32_t>> wraps_;
+    std::vector<int> ends_; // appoggio per le misure
+
+    TextViewMetrics metrics_;
+    int width_{1};
+    int height_{1};
+    RowPos top_;
+
+    size_t caret_{0};
+    size_t anchor_{0};
+    bool caretEnd_{false};
+    int goalX_{-1}; // colonna in px tenuta da su/giu'
+
+    std::vector<UndoStep> undo_;
+    std::vector<UndoStep> redo_;
+    bool typingRun_{false};
+
+    size_t wrapped_{0};
+};
@@ -0,0 +1,160 @@
+#include "timewheel.h"
+
+#include <algorithm>
+#include <bit>
+
+TimingWheel::TimingWheel(int64_t tickMs) : tickMs_(std::max<int64_t>(1, tickMs)) { std::fill(std::begin(heads_), std::end(heads_), kNone); }
+
+int64_t TimingWheel::TickOf(int64_t ms) const {
+    const int64_t q = ms / tickMs_;
+    return q * tickMs_ < ms ? q + 1 : q;
+}
+
+void TimingWheel::Reset(int64_t nowMs) {
+    nodes_.clear();
+    free_.clear();
+    index_.clear();
+    std::fill(std::begin(heads_), std::end(heads_), kNone);
+    std::fill(std::begin(occupied_), std::end(occupied_), 0);
+    current_ = nowMs / tickMs_;
+}
+
+void TimingWheel::Link(uint32_t n, int list) {
+    Node& node = nodes_[n];
+    node.list = list;
+    node.prev = kNone;
+    node.next = heads_[list];
+    if (node.next != kNone) nodes_[node.next].prev = n;
+    heads_[list] = n;
+    if (list < kDueList) occupied_[list / kSlots] |= 1ull << (list % kSlots);
+}
+
+void TimingWheel::Unlink(uint32_t n) {
+    Node& node = nodes_[n];
+    if (node.prev != kNone) nodes_[node.prev].next = node.next;
+    else heads_[node.list] = node.next;
+    if (node.next != kNone) nodes_[node.next].prev = node.prev;
+    if (node.list < kDueList && heads_[node.list] == kNone) occupied_[node.list / kSlots] &= ~(1ull << (node.list % kSlots));
+    node.list = -1;
+}
+
+std::vector<uint32_t> TimingWheel::TakeList(int list) {
+    std::vector<uint32_t> out;
+    for (uint32_t n = heads_[list]; n != kNone; n = nodes_[n].next) out.push_back(n);
+    heads_[list] = kNone;
+    if (list < kDueList) occupied_[list / kSlots] &= ~(1ull << (list % kSlots));
+    for (uint32_t n : out) nodes_[n].list = -1;
+    return out;
+}
+
+// Livello = il gruppo di 6 bit piu' alto in cui il tick di scadenza differisce da
+// quello corrente: sopra sono uguali, quindi lo slot si raggiunge senza fare il giro.
+void TimingWheel::Place(uint32_t n) {
+    const int64_t tick = TickOf(nodes_[n].dueMs);
+    if (tick <= current_) {
+        Link(n, kDueList);
+        return;
+    }
+    const uint64_t diff = static_cast<uint64_t>(tick) ^ static_cast<uint64_t>(current_);
+    const int level = std::min(kLevels - 1, (static_cast<int>(std::bit_width(diff)) - 1) / kSlotBits);
+    const int slot = static_cast<int>((static_cast<uint64_t>(tick) >> (level * kSlotBits)) & (kSlots - 1));
+    Link(n, level * kSlots + slot);
+}
+
+void TimingWheel::Add(uint64_t key, int64_t dueMs) {
+    auto it = index_.find(key);
+    uint32_t n;
+    if (it != index_.end()) {
+        n = it->second;
+        Unlink(n);
+    } else {
+        if (free_.empty()) {
+            n = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        } else {
+            n = free_.back();
+            free_.pop_back();
+        }
+        index_.emplace(key, n);
+    }
+    nodes_[n].key = key;
+    nodes_[n].dueMs = dueMs;
+    Place(n);
+}
+
+bool TimingWheel::Remove(uint64_t key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+    Unlink(it->second);
+    free_.push_back(it->second);
+    index_.erase(it);
+    return true;
+}
+
+int64_t TimingWheel::NextEventTick() const {
+    if (heads_[kDueList] != kNone) return current_;
+    // il primo livello con uno slot occupato dopo quello corrente ha l'evento piu' vicino:
+    // ogni livello comincia dopo la fine del blocco corrente del livello sotto
+    for (int level = 0; level < kLevels; ++level) {
+        const int shift = level * kSlotBits;
+        const int pos = static_cast<int>((static_cast<uint64_t>(current_) >> shift) & (kSlots - 1));
+        const uint64_t after = occupied_[level] & ~((2ull << pos) - 1);
+        if (after == 0) continue;
+        const int slot = std::countr_zero(after);
+        const uint64_t block = static_cast<uint64_t>(current_) >> (shift + kSlotBits) << (shift + kSlotBits);
+        return static_cast<int64_t>(block + (static_cast<uint64_t>(slot) << shift));
+    }
+    return -1;
+}
+
+int64_t TimingWheel::NextDelay(int64_t nowMs) const {
+    const int64_t tick = NextEventTick();
+    if (tick < 0) return -1;
+    return std::max<int64_t>(0, tick * tickMs_ - nowMs);
+}
+
+std::vector<uint64_t> TimingWheel::Advance(int64_t nowMs) {
+    const int64_t target = nowMs / tickMs_;
+    if (target < current_) {
+        // orologio tornato indietro: le posizioni valgono per il tick vecchio, si rifanno
+        std::vector<uint32_t> all;
+        for (int list = 0; list <= kDueList; ++list) {
+            for (uint32_t n : TakeList(list)) all.push_back(n);
+        }
+        current_ = target;
+        for (uint32_t n : all) Place(n);
+    }
+
+    std::vector<uint32_t> fired = TakeList(kDueList);
+    for (;;) {
+        const int64_t next = NextEventTick();
+        if (next < 0 || next > target) break;
+        if (next == current_) { // gia' scadute arrivate da una ridistribuzione
+            for (uint32_t n : TakeList(kDueList)) fired.push_back(n);
+            continue;
+        }
+        current_ = next;
+        // si ridistribuiscono gli slot che cominciano adesso, dall'alto: finiscono piu' in basso
+        for (int level = kLevels - 1; level >= 1; --level) {
+            const int shift = level * kSlotBits;
+            if ((static_cast<uint64_t>(current_) & ((1ull << shift) - 1)) != 0) continue;
+            const int slot = static_cast<int>((static_cast<uint64_t>(current_) >> shift) & (kSlots - 1));
+            for (uint32_t n : TakeList(level * kSlots + slot)) Place(n);
+        }
+        for (uint32_t n : TakeList(static_cast<int>(static_cast<uint64_t>(current_) & (kSlots - 1)))) fired.push_back(n);
+    }
+    // nessun evento fino a target: saltarci non sposta nessuno slot occupato
+    current_ = std::max(current_, target);
+
+    std::sort(fired.begin(), fired.end(), [&](uint32_t a, uint32_t b) {
+        return nodes_[a].dueMs != nodes_[b].dueMs ? nodes_[a].dueMs < nodes_[b].dueMs : nodes_[a].key < nodes_[b].key;
+    });
+    std::vector<uint64_t> keys;
+    keys.reserve(fired.size());
+    for (uint32_t n : fired) {
+        keys.push_back(nodes_[n].key);
+        index_.erase(nodes_[n].key);
+        free_.push_back(n);
+    }
+    return keys;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Scadenze (promemoria delle tile) su una timing wheel gerarchica: 8 livelli da 64
+// slot, il livello L conta 64^L tick. Aggiungere e togliere costa O(1) (liste
+// doppie per slot, bitmask degli slot occupati); Advance costa le scadenze passate e
+// gli slot da ridistribuire, non il tempo trascorso, quindi anche dopo ore di
+// sospensione o un salto in avanti dell'orologio si recupera subito. Un salto
+// indietro ricolloca tutto (O(n), raro).
+// Il tempo lo passa chi chiama (ms, di solito Unix): nessun orologio qui dentro, cosi'
+// si prova con un orologio finto. Le scadenze si arrotondano al tick successivo:
+// quelle vicine scattano insieme e non si scatta mai in anticipo.
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class TimingWheel {
+public:
+    explicit TimingWheel(int64_t tickMs = 1000);
+
+    void Reset(int64_t nowMs);                   // vuota e riparte da qui
+    void Add(uint64_t key, int64_t dueMs);       // sostituisce la scadenza precedente della chiave
+    bool Remove(uint64_t key);
+    bool Has(uint64_t key) const { return index_.count(key) != 0; }
+    size_t Size() const { return index_.size(); }
+
+    // chiavi scadute fino a nowMs, in ordine di scadenza; escono dalla ruota
+    std::vector<uint64_t> Advance(int64_t nowMs);
+    // ms fino al prossimo Advance utile (scadenza o ridistribuzione), -1 se vuota
+    int64_t NextDelay(int64_t nowMs) const;
+
+private:
+    static constexpr int kLevels = 8;
+    static constexpr int kSlotBits = 6;
+    static constexpr int kSlots = 1 << kSlotBits;
+    static constexpr uint32_t kNone = UINT32_MAX;
+    static constexpr int kDueList = kLevels * kSlots; // lista delle gia' scadute
+
+    struct Node {
+        uint64_t key{0};
+        int64_t dueMs{0};
+        uint32_t prev{kNone};
+        uint32_t next{kNone};
+        int list{-1};
+    };
+
+    int64_t TickOf(int64_t ms) const; // per eccesso
+    void Place(uint32_t n);
+    void Link(uint32_t n, int list);
+    void Unlink(uint32_t n);
+    std::vector<uint32_t> TakeList(int list);
+    int64_t NextEventTick() const; // -1 se niente
+
+    int64_t tickMs_;
+    int64_t current_{0}; // tick gia' elaborato
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> free_;
+    std::unordered_map<uint64_t, uint32_t> index_;
+    uint32_t heads_[kDueList + 1];
+    uint64_t occupied_[kLevels]{};
+};
@@ -0,0 +1,86 @@
+#include "tracks.h"
+
+#include <algorithm>
+
+namespace {
+
+// divisione con arrotondamento verso -infinito
+int64_t FloorDiv(int64_t a, int64_t b) { return a / b - (a % b != 0 && (a < 0) != (b < 0) ? 1 : 0); }
+
+} // namespace
+
+TrackAxis::TrackAxis(int defaultSize) : default_(std::clamp(defaultSize, kMinSize, kMaxSize)) {}
+
+void TrackAxis::SetDefaultSize(int px) {
+    px = std::clamp(px, kMinSize, kMaxSize);
+    if (px == default_) return;
+    default_ = px;
+    for (size_t i = 0; i < sizes_.size(); ++i) prefix_[i + 1] = prefix_[i] + Size(static_cast<int>(i));
+}
+
+int TrackAxis::Size(int i) const {
+    return i >= 0 && i < static_cast<int>(sizes_.size()) && sizes_[i] > 0 ? sizes_[i] : default_;
+}
+
+void TrackAxis::SetSize(int i, int px) {
+    if (i < 0) return;
+    px = px <= 0 ? 0 : std::clamp(px, kMinSize, kMaxSize);
+    if (px == default_) px = 0;
+
+    const int n = static_cast<int>(sizes_.size());
+    if (i >= n) {
+        if (px == 0) return;
+        // le tracce nuove fino a i valgono il default
+        sizes_.resize(i + 1, 0);
+        prefix_.resize(i + 2);
+        for (int k = n; k <= i; ++k) prefix_[k + 1] = prefix_[k] + default_;
+    }
+
+    const int64_t delta = static_cast<int64_t>(px ? px : default_) - Size(i);
+    sizes_[i] = px;
+    if (delta != 0) {
+        for (size_t k = i + 1; k < prefix_.size(); ++k) prefix_[k] += delta;
+    }
+    Trim();
+}
+
+void TrackAxis::Clear() {
+    sizes_.clear();
+    prefix_.assign(1, 0);
+}
+
+void TrackAxis::Trim() {
+    size_t n = sizes_.size();
+    while (n > 0 && sizes_[n - 1] == 0) --n;
+    sizes_.resize(n);
+    prefix_.resize(n + 1);
+}
+
+int64_t TrackAxis::Offset(int i) const {
+    const int n = static_cast<int>(sizes_.size());
+    if (i >= 0 && i <= n) return prefix_[i];
+    if (i < 0) return static_cast<int64_t>(i) * default_;
+    return prefix_[n] + static_cast<int64_t>(i - n) * default_;
+}
+
+int TrackAxis::IndexAt(int64_t pos) const {
+    const int n = static_cast<int>(sizes_.size());
+    if (pos < 0) return static_cast<int>(FloorDiv(pos, default_));
+    if (pos >= prefix_[n]) return n + static_cast<int>((pos - prefix_[n]) / default_);
+    // ultima traccia che inizia a pos o prima
+    auto it = std::upper_bound(prefix_.begin(), prefix_.end(), pos);
+    return static_cast<int>(it - prefix_.begin()) - 1;
+}
+
+int TrackAxis::NearestLine(int64_t pos) const {
+    const int i = IndexAt(pos);
+    return pos - Offset(i) <= Offset(i + 1) - pos ? i : i + 1;
+}
+
+std::vector<std::pair<int, int>> TrackAxis::Overrides() const {
+    std::vector<std::pair<int, int>> out;
+    for (size_t i = 0; i < sizes_.size(); ++i) {
+        if (sizes_[i] > 0) out.emplace_back(static_cast<int>(i), sizes_[i]);
+    }
+    return out;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Righe e colonne della board con dimensioni proprie (come le tracce di CSS grid).
+// Le tracce fino all'ultima personalizzata hanno un array di somme prefisse: cella ->
+// px e' una lettura, px -> cella una ricerca binaria. Oltre quell'ultima traccia sono
+// tutte della dimensione di default e si calcola senza array, quindi la memoria segue
+// le tracce toccate e non il mondo. Le posizioni sono in px a zoom 1.
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class TrackAxis {
+public:
+    static constexpr int kMinSize = 16;
+    static constexpr int kMaxSize = 4096;
+
+    TrackAxis() = default;
+    explicit TrackAxis(int defaultSize);
+
+    void SetDefaultSize(int px); // le tracce personalizzate restano come sono
+    int DefaultSize() const { return default_; }
+
+    int Size(int i) const;
+    // px <= 0: torna al default. Aggiorna le somme dalla traccia i in poi.
+    void SetSize(int i, int px);
+    void Clear(); // tutte di default
+
+    // inizio della traccia i (= fine della i - 1); indici negativi proseguono col default
+    int64_t Offset(int i) const;
+    // traccia che contiene pos (quella che inizia li', sul confine)
+    int IndexAt(int64_t pos) const;
+    // confine tra tracce piu' vicino a pos
+    int NearestLine(int64_t pos) const;
+
+    // tracce diverse dal default, in ordine di indice (per il file di stato)
+    std::vector<std::pair<int, int>> Overrides() const;
+
+private:
+    void Trim();
+
+    int default_{48};
+    std::vector<int> sizes_;         // tracce 0..n-1, 0 = default
+    std::vector<int64_t> prefix_{0}; // n + 1 voci: prefix_[i] = Offset(i)
+};
@@ -0,0 +1,93 @@
+// 10.000 tile sparse su una board di 500 x 500 celle e trascinamenti come col mouse: il
+// bersaglio avanza di una cella alla volta e a ogni passo MoveTileToward (con e senza
+// spinta) o, lasciando la tile su un'altra, SwapTiles. Il costo di un passo non deve
+// dipendere dal numero di tile: resta sotto il millisecondo. La sequenza e' deterministica
+// e si ripete tre volte; di ogni passo conta il tempo minimo, cosi' una prelazione dello
+// scheduler non passa per un passo lento.
+
+#include "check.h"
+#include "collision.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kBoard = 500;
+constexpr uint64_t kTiles = 10000;
+
+struct Run {
+    std::vector<double> stepMs;
+    double insertMs{0};
+    size_t moves{0};
+    size_t overlaps{0};
+};
+
+Run Drags() {
+    Run run;
+    std::mt19937 rng(3);
+    TileGrid grid;
+    std::vector<uint64_t> found;
+    auto start = TestClock::now();
+    for (uint64_t id = 1; id <= kTiles;) {
+        const int w = 2 + static_cast<int>(rng() % 3), h = 2 + static_cast<int>(rng() % 2);
+        const CellRect r{static_cast<int>(rng() % (kBoard - w + 1)), static_cast<int>(rng() % (kBoard - h + 1)), w, h};
+        grid.Query(r, 0, found);
+        if (found.empty()) grid.Insert(id++, r);
+        found.clear();
+    }
+    run.insertMs = ElapsedMs(start);
+
+    TileMoves moved;
+    for (int drag = 0; drag < 500; ++drag) {
+        const uint64_t id = 1 + rng() % kTiles;
+        const bool push = drag % 2;
+        const CellRect r = *grid.Rect(id);
+        int tx = r.x, ty = r.y;
+        const int dx = static_cast<int>(rng() % 3) - 1, dy = static_cast<int>(rng() % 3) - 1;
+        for (int step = 0; step < 40; ++step) {
+            tx = std::clamp(tx + dx, 0, kBoard - r.w);
+            ty = std::clamp(ty + dy, 0, kBoard - r.h);
+            moved.clear();
+            start = TestClock::now();
+            MoveTileToward(grid, id, tx, ty, push, kBoard, kBoard, moved);
+            run.stepMs.push_back(ElapsedMs(start));
+            run.moves += moved.size();
+        }
+        // rilascio sopra un'altra tile: scambio
+        moved.clear();
+        start = TestClock::now();
+        CHECK(SwapTiles(grid, id, 1 + (id + rng() % (kTiles - 1)) % kTiles, moved));
+        run.stepMs.push_back(ElapsedMs(start));
+    }
+
+    for (uint64_t id = 1; id <= kTiles; ++id) {
+        grid.Query(*grid.Rect(id), id, found);
+        run.overlaps += found.size();
+        found.clear();
+    }
+    return run;
+}
+
+} // namespace
+
+int main() {
+    Run best = Drags();
+    for (int again = 0; again < 2; ++again) {
+        const Run run = Drags();
+        CHECK_EQ(run.moves, best.moves); // stessa sequenza
+        for (size_t i = 0; i < best.stepMs.size(); ++i) best.stepMs[i] = std::min(best.stepMs[i], run.stepMs[i]);
+    }
+    std::printf("%llu tile, inserimento: %.1f ms\n", static_cast<unsigned long long>(kTiles), best.insertMs);
+
+    std::vector<double> steps = best.stepMs;
+    std::sort(steps.begin(), steps.end());
+    double total = 0;
+    for (double ms : steps) total += ms;
+    std::printf("%zu passi (%zu spostamenti): media %.2f us, p99 %.2f us, max %.2f us\n", steps.size(), best.moves,
+                total * 1000.0 / steps.size(), steps[steps.size() * 99 / 100] * 1000.0, steps.back() * 1000.0);
+    CHECK(steps.back() < 1.0);
+    CHECK_EQ(best.overlaps, size_t{0}); // la board e' ancora senza sovrapposizioni
+    return TestResult("bench_collision");
+}
@@ -0,0 +1,170 @@
+// Board 1000 x 1000 celle con ~7500 tile 10 x 10: costo di un aggiornamento incrementale
+// (una tile tolta e rimessa) seguito dalle tre interrogazioni, e lo stesso con una scansione
+// a forza bruta della griglia di occupazione, che deve dare le stesse risposte.
+
+#include "check.h"
+#include "freespace.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+// la griglia e basta: ogni interrogazione la rilegge da capo
+struct BruteGrid {
+    int w, h;
+    std::vector<uint16_t> count;
+
+    BruteGrid(int cw, int ch) : w(cw), h(ch), count(static_cast<size_t>(cw) * ch) {}
+    bool Free(int x, int y) const { return count[static_cast<size_t>(y) * w + x] == 0; }
+    void Apply(const CellRect& r, int delta) {
+        for (int y = r.y; y < r.y + r.h; ++y) {
+            for (int x = r.x; x < r.x + r.w; ++x) count[static_cast<size_t>(y) * w + x] += delta;
+        }
+    }
+
+    // altezze libere riga per riga e rettangolo massimo sotto ogni istogramma (pila)
+    int64_t LargestArea() const {
+        std::vector<int> height(w, 0), stack;
+        int64_t best = 0;
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) height[x] = Free(x, y) ? height[x] + 1 : 0;
+            stack.clear();
+            for (int x = 0; x <= w; ++x) {
+                const int cur = x < w ? height[x] : 0;
+                while (!stack.empty() && height[stack.back()] >= cur) {
+                    const int top = height[stack.back()];
+                    stack.pop_back();
+                    const int left = stack.empty() ? 0 : stack.back() + 1;
+                    best = std::max(best, static_cast<int64_t>(top) * (x - left));
+                }
+                stack.push_back(x);
+            }
+        }
+        return best;
+    }
+
+    // somme prefisse dell'occupazione, poi ogni angolo in ordine di lettura
+    bool FirstEmpty(int rw, int rh, CellRect& out) const {
+        std::vector<int> sum(static_cast<size_t>(w + 1) * (h + 1), 0);
+        auto at = [&](int x, int y) -> int& { return sum[static_cast<size_t>(y) * (w + 1) + x]; };
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) at(x + 1, y + 1) = !Free(x, y) + at(x, y + 1) + at(x + 1, y) - at(x, y);
+        }
+        for (int y = 0; y + rh <= h; ++y) {
+            for (int x = 0; x + rw <= w; ++x) {
+                if (at(x + rw, y + rh) - at(x, y + rh) - at(x + rw, y) + at(x, y) == 0) {
+                    out = CellRect{x, y, rw, rh};
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // ogni coppia di righe sopra e sotto la cella, allargando a sinistra e a destra
+    int64_t RegionAreaAt(int px, int py) const {
+        if (!Free(px, py)) return 0;
+        auto columnFree = [&](int x, int top, int bottom) {
+            for (int y = top; y <= bottom; ++y) {
+                if (!Free(x, y)) return false;
+            }
+            return true;
+        };
+        int64_t best = 0;
+        for (int top = py; top >= 0 && Free(px, top); --top) {
+            for (int bottom = py; bottom < h && Free(px, bottom); ++bottom) {
+                int left = px, right = px;
+                while (left > 0 && columnFree(left - 1, top, bottom)) --left;
+                while (right + 1 < w && columnFree(right + 1, top, bottom)) ++right;
+                best = std::max(best, static_cast<int64_t>(right - left + 1) * (bottom - top + 1));
+            }
+        }
+        return best;
+    }
+};
+
+bool AllFree(const BruteGrid& grid, const CellRect& r) {
+    for (int y = r.y; y < r.y + r.h; ++y) {
+        for (int x = r.x; x < r.x + r.w; ++x) {
+            if (!grid.Free(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+int64_t Area(const CellRect& r) { return static_cast<int64_t>(r.w) * r.h; }
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(1);
+    FreeSpaceIndex index;
+    index.Reset(1000, 1000);
+    BruteGrid grid(1000, 1000);
+    std::vector<CellRect> placed;
+    for (int y = 0; y < 1000; y += 10) {
+        for (int x = 0; x < 1000; x += 10) {
+            if (rng() % 4) placed.push_back({x, y, 10, 10});
+        }
+    }
+    auto start = TestClock::now();
+    for (const CellRect& r : placed) index.Occupy(r);
+    CellRect out;
+    CHECK(index.LargestEmpty(out));
+    std::printf("%zu tile, costruzione: %.1f ms\n", placed.size(), ElapsedMs(start));
+    for (const CellRect& r : placed) grid.Apply(r, +1);
+
+    constexpr int kOps = 1000;
+    start = TestClock::now();
+    for (int i = 0; i < kOps; ++i) {
+        const CellRect r = placed[rng() % placed.size()];
+        index.Release(r);
+        CHECK(index.LargestEmpty(out));
+        CHECK(index.FirstEmpty(5, 5, out));
+        CHECK(index.EmptyRegionAt(r.x, r.y, out));
+        CHECK(out.w * out.h >= 100);
+        index.Occupy(r);
+    }
+    std::printf("aggiornamento + 3 interrogazioni: %.1f us\n", ElapsedMs(start) * 1000.0 / kOps);
+
+    // forza bruta sulle stesse mosse (meno, costa troppo), confrontata con l'indice
+    constexpr int kBruteOps = 50;
+    double indexMs = 0, bruteMs = 0;
+    size_t wrong = 0;
+    for (int i = 0; i < kBruteOps; ++i) {
+        const CellRect r = placed[rng() % placed.size()];
+        const int fw = 1 + static_cast<int>(rng() % 20), fh = 1 + static_cast<int>(rng() % 20);
+        const int px = r.x + static_cast<int>(rng() % 10), py = r.y + static_cast<int>(rng() % 10);
+
+        start = TestClock::now();
+        index.Release(r);
+        CellRect largest, first, region;
+        const bool hasLargest = index.LargestEmpty(largest);
+        const bool hasFirst = index.FirstEmpty(fw, fh, first);
+        const bool hasRegion = index.EmptyRegionAt(px, py, region);
+        indexMs += ElapsedMs(start);
+
+        start = TestClock::now();
+        grid.Apply(r, -1);
+        const int64_t bruteLargest = grid.LargestArea();
+        CellRect bruteFirst;
+        const bool bruteHasFirst = grid.FirstEmpty(fw, fh, bruteFirst);
+        const int64_t bruteRegion = grid.RegionAreaAt(px, py);
+        bruteMs += ElapsedMs(start);
+
+        // a parita' d'area i rettangoli possono essere diversi: si confronta l'area e che sia vuoto
+        wrong += !hasLargest || Area(largest) != bruteLargest || !AllFree(grid, largest);
+        wrong += hasFirst != bruteHasFirst ||
+                 (hasFirst && (first.x != bruteFirst.x || first.y != bruteFirst.y || first.w != fw || first.h != fh));
+        wrong += !hasRegion || Area(region) != bruteRegion || !AllFree(grid, region) || px < region.x ||
+                 px >= region.x + region.w || py < region.y || py >= region.y + region.h;
+
+        index.Occupy(r);
+        grid.Apply(r, +1);
+    }
+    CHECK_EQ(wrong, size_t{0});
+    std::printf("forza bruta: %.1f ms contro %.1f us dell'indice per mossa\n", bruteMs / kBruteOps, indexMs * 1000.0 / kBruteOps);
+    return TestResult("bench_freespace");
+}
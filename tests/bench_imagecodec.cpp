@@ -0,0 +1,48 @@
+// Uno screenshot 1920 x 1080: codifica PNG, decodifica intera, dimensioni dall'intestazione
+// e miniatura a 256 (a righe, senza tenere l'immagine intera).
+
+#include "check.h"
+#include "imagecodec.h"
+
+#include <random>
+
+int main() {
+    Image shot;
+    shot.width = 1920;
+    shot.height = 1080;
+    shot.rgba.assign(static_cast<size_t>(1920) * 1080 * 4, 255);
+    std::mt19937 rng(1);
+    for (int y = 0; y < 1080; ++y) {
+        for (int x = 0; x < 1920; ++x) {
+            uint8_t* p = &shot.rgba[(static_cast<size_t>(y) * 1920 + x) * 4];
+            const int window = (x / 300 + y / 200) % 4; // finestre a tinta unita con righe di "testo"
+            p[0] = static_cast<uint8_t>(30 + window * 50);
+            p[1] = static_cast<uint8_t>(40 + window * 30);
+            p[2] = static_cast<uint8_t>(200 - window * 40);
+            if (y % 16 < 10 && rng() % 4 == 0) p[0] = p[1] = p[2] = 230;
+        }
+    }
+
+    auto start = TestClock::now();
+    const std::string png = EncodePng(shot);
+    std::printf("codifica: %.1f ms, %.0f KB\n", ElapsedMs(start), png.size() / 1024.0);
+
+    constexpr int kRounds = 10;
+    Image decoded;
+    start = TestClock::now();
+    for (int i = 0; i < kRounds; ++i) CHECK(DecodeImage(png, decoded));
+    std::printf("decodifica: %.1f ms\n", ElapsedMs(start) / kRounds);
+    CHECK(decoded.rgba == shot.rgba);
+
+    int w = 0, h = 0;
+    start = TestClock::now();
+    for (int i = 0; i < 100000; ++i) CHECK(ImageSize(png, w, h));
+    std::printf("dimensioni: %.3f us\n", ElapsedMs(start) * 1000.0 / 100000);
+
+    Image thumb;
+    start = TestClock::now();
+    for (int i = 0; i < kRounds; ++i) CHECK(MakeThumbnail(png, 256, 0x303030, thumb));
+    std::printf("miniatura 256: %.1f ms (%dx%d)\n", ElapsedMs(start) / kRounds, thumb.width, thumb.height);
+    CHECK_EQ(thumb.width, 256);
+    return TestResult("bench_imagecodec");
+}
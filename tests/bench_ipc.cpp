@@ -0,0 +1,45 @@
+// Comandi al secondo attraverso il socket: un client manda set in pipeline da un thread
+// e legge le risposte da un altro; il "thread UI" le applica a batch. Poi il solo parsing.
+
+#include "check.h"
+#include "ipc.h"
+#include "ipc_fake_ui.h"
+
+#include <string>
+#include <thread>
+
+int main() {
+    const std::string endpoint = TestSocketPath("bench");
+    IpcServer server;
+    FakeUi ui(server);
+    CHECK(server.Start(endpoint, ui.Wake()));
+    ui.Start();
+
+    IpcClient client;
+    CHECK(client.Connect(endpoint, 1000));
+    constexpr int kCount = 200000;
+    const auto start = TestClock::now();
+    std::thread writer([&] {
+        for (int i = 0; i < kCount; ++i) client.Send("{\"id\":" + std::to_string(i) + ",\"cmd\":\"set\",\"tile\":3,\"text\":\"a\\u00e8\\n\"}");
+    });
+    std::string line;
+    int received = 0;
+    while (received < kCount && client.ReadLine(line)) ++received;
+    const double ms = ElapsedMs(start);
+    writer.join();
+    CHECK_EQ(received, kCount);
+    std::printf("%d comandi in %.0f ms: %.0f comandi/s, %llu batch\n", received, ms, received / ms * 1000.0,
+                static_cast<unsigned long long>(ui.batches.load()));
+
+    const std::string sample = R"({"id":123,"cmd":"set","tile":42,"text":"una nota con \"virgolette\" e è accenti\n"})";
+    const auto parseStart = TestClock::now();
+    size_t ok = 0;
+    for (int i = 0; i < 1000000; ++i) ok += ParseIpcLine(sample).error.empty();
+    const double parseMs = ElapsedMs(parseStart);
+    CHECK_EQ(ok, size_t{1000000});
+    std::printf("parsing: %.0f righe/s\n", 1000000 / parseMs * 1000.0);
+
+    ui.Stop();
+    server.Stop();
+    return TestResult("bench_ipc");
+}
@@ -0,0 +1,34 @@
+// RepairLayout e LayoutIsValid su una board da 100k tile (griglia 317x317 di tile 4x4)
+// con 1000 tile spostate di qualche cella: la richiesta e' "millisecondi".
+
+#include "check.h"
+#include "layoutcheck.h"
+
+#include <random>
+#include <vector>
+
+int main() {
+    constexpr int kSide = 317;
+    std::mt19937 rng(1);
+    std::vector<CellRect> rects;
+    for (int y = 0; y < kSide; ++y) {
+        for (int x = 0; x < kSide; ++x) rects.push_back({x * 4, y * 4, 4, 4});
+    }
+    const auto validStart = TestClock::now();
+    CHECK(LayoutIsValid(rects, kSide * 4, kSide * 4));
+    const double validMs = ElapsedMs(validStart);
+
+    for (int k = 0; k < 1000; ++k) {
+        CellRect& r = rects[rng() % rects.size()];
+        r.x += static_cast<int>(rng() % 5) - 2;
+        r.y += static_cast<int>(rng() % 5) - 2;
+    }
+    const auto repairStart = TestClock::now();
+    const LayoutReport report = RepairLayout(rects, kSide * 4, kSide * 4);
+    const double repairMs = ElapsedMs(repairStart);
+    CHECK(LayoutIsValid(rects, kSide * 4, 0));
+
+    std::printf("%zu tile: verifica %.2f ms, riparazione %.2f ms (%zu sovrapposizioni, %zu fuori, %zu modifiche)\n", rects.size(), validMs, repairMs,
+                report.overlaps, report.outOfBounds, report.fixes.size());
+    return TestResult("bench_layoutcheck");
+}
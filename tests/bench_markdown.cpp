@@ -0,0 +1,145 @@
+// Una nota di 5.000 righe di Markdown misto: analisi e layout completi, poi 200 modifiche
+// di una riga (in testa, in mezzo, in coda, dentro un blocco di codice) con Update e layout
+// di tutti i blocchi, che riusa la cache di quelli non toccati. Ogni risultato e' uguale a
+// quello di un documento nuovo analizzato e impaginato da zero.
+
+#include "check.h"
+#include "markdown.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+MdMetrics BenchMetrics() {
+    MdMetrics m;
+    m.width = [](std::wstring_view s, uint8_t style) { return static_cast<int>(s.size()) * (MdHeadingLevel(style) ? 10 : 7); };
+    m.lineHeight = [](uint8_t style) { return MdHeadingLevel(style) ? 24 : 16; };
+    m.version = 1;
+    return m;
+}
+
+bool SameBlocks(const MarkdownDoc& a, const MarkdownDoc& b) {
+    if (a.BlockCount() != b.BlockCount() || a.HasMarkup() != b.HasMarkup()) return false;
+    for (size_t i = 0; i < a.BlockCount(); ++i) {
+        const MdBlock& x = a.Block(i);
+        const MdBlock& y = b.Block(i);
+        if (x.kind != y.kind || x.begin != y.begin || x.length != y.length || x.level != y.level || x.checked != y.checked ||
+            x.markup != y.markup || x.runs.size() != y.runs.size()) {
+            return false;
+        }
+        for (size_t k = 0; k < x.runs.size(); ++k) {
+            if (x.runs[k].begin != y.runs[k].begin || x.runs[k].length != y.runs[k].length || x.runs[k].style != y.runs[k].style) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool SameLayout(const MarkdownDoc& a, const MarkdownDoc& b) {
+    for (size_t i = 0; i < a.BlockCount(); ++i) {
+        const MdBlock& x = a.Block(i);
+        const MdBlock& y = b.Block(i);
+        if (x.height != y.height || x.fragments.size() != y.fragments.size()) return false;
+        for (size_t k = 0; k < x.fragments.size(); ++k) {
+            const MdFragment& f = x.fragments[k];
+            const MdFragment& g = y.fragments[k];
+            if (f.kind != g.kind || f.style != g.style || f.x != g.x || f.y != g.y || f.w != g.w || f.h != g.h ||
+                f.begin != g.begin || f.length != g.length) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void LayoutAll(MarkdownDoc& doc, int width, const MdMetrics& m) {
+    for (size_t i = 0; i < doc.BlockCount(); ++i) doc.Layout(i, width, m);
+}
+
+std::vector<std::wstring> Note(std::mt19937& rng, size_t lines) {
+    std::vector<std::wstring> out;
+    while (out.size() < lines) {
+        const std::wstring n = std::to_wstring(out.size());
+        switch (rng() % 10) {
+        case 0: out.push_back(L"## Sezione " + n); break;
+        case 1: out.push_back(L"- [ ] cosa da fare " + n + L" con **priorita'**"); break;
+        case 2: out.push_back(L"- punto " + n + L" con `codice` e [link](https://example.com)"); break;
+        case 3: out.push_back(n + L". passo numerato"); break;
+        case 4: out.push_back(L"> citazione " + n); break;
+        case 5:
+            out.push_back(L"```");
+            out.push_back(L"int x = " + n + L"; // *non* corsivo");
+            out.push_back(L"```");
+            break;
+        case 6: out.push_back(L""); break;
+        default:
+            out.push_back(L"Testo del paragrafo " + n + L" con *corsivo*, **grassetto** e una frase abbastanza lunga da andare a capo "
+                                                        L"almeno una volta nella colonna della tile.");
+        }
+    }
+    return out;
+}
+
+std::wstring Join(const std::vector<std::wstring>& lines) {
+    std::wstring text;
+    for (const std::wstring& l : lines) text += l + L"\r\n";
+    return text;
+}
+
+} // namespace
+
+int main() {
+    constexpr int kWidth = 420;
+    const MdMetrics metrics = BenchMetrics();
+    std::mt19937 rng(5);
+    std::vector<std::wstring> lines = Note(rng, 5000);
+
+    auto start = TestClock::now();
+    MarkdownDoc doc;
+    doc.SetText(Join(lines));
+    LayoutAll(doc, kWidth, metrics);
+    const double fullMs = ElapsedMs(start);
+    std::printf("analisi e layout completi: %zu righe, %zu blocchi in %.2f ms\n", lines.size(), doc.BlockCount(), fullMs);
+
+    double incrementalMs = 0, worstMs = 0, freshMs = 0;
+    size_t reparsed = 0, mismatches = 0;
+    constexpr int kEdits = 200;
+    for (int e = 0; e < kEdits; ++e) {
+        // in testa, in coda, dentro un recinto ``` o a caso
+        size_t at = e == 0 ? 0 : e == 1 ? lines.size() - 1 : rng() % lines.size();
+        if (e == 2) {
+            for (at = 0; lines[at] != L"```"; ++at) {
+            }
+            ++at;
+        }
+        if (e % 7 == 3) lines[at] = L"```"; // apre o chiude un recinto: rianalisi lunga
+        else lines[at] += L" **modificata** " + std::to_wstring(e);
+        const std::wstring text = Join(lines);
+
+        const size_t parsedBefore = doc.Parsed();
+        start = TestClock::now();
+        doc.Update(text);
+        LayoutAll(doc, kWidth, metrics);
+        const double ms = ElapsedMs(start);
+        incrementalMs += ms;
+        worstMs = std::max(worstMs, ms);
+        reparsed += doc.Parsed() - parsedBefore;
+
+        start = TestClock::now();
+        MarkdownDoc fresh;
+        fresh.SetText(text);
+        LayoutAll(fresh, kWidth, metrics);
+        freshMs += ElapsedMs(start);
+        mismatches += doc.Text() != fresh.Text() || !SameBlocks(doc, fresh) || !SameLayout(doc, fresh);
+    }
+    std::printf("modifica di una riga: %.3f ms in media (peggiore %.3f), %.1f blocchi rianalizzati; da zero %.2f ms\n",
+                incrementalMs / kEdits, worstMs, static_cast<double>(reparsed) / kEdits, freshMs / kEdits);
+
+    CHECK_EQ(mismatches, size_t{0});
+    CHECK(incrementalMs < freshMs);
+    return TestResult("bench_markdown");
+}
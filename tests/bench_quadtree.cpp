@@ -0,0 +1,43 @@
+// 1M tile 2 x 2 su una board 2000 x 2000: costruzione, query della viewport (piccola e
+// grande) a ogni frame, spostamento di una tile. Il costo delle query segue le tile
+// visibili, non il totale.
+
+#include "check.h"
+#include "quadtree.h"
+
+#include <tuple>
+#include <vector>
+
+int main() {
+    TileQuadtree tree;
+    auto start = TestClock::now();
+    uint64_t id = 1;
+    for (int y = 0; y < 1000; ++y) {
+        for (int x = 0; x < 1000; ++x) tree.Insert(id++, CellRect{x * 2, y * 2, 2, 2});
+    }
+    std::printf("1M tile: costruzione %.0f ms, radice %d celle\n", ElapsedMs(start), tree.RootCells());
+    CHECK_EQ(tree.Size(), size_t{1000000});
+
+    std::vector<uint64_t> out;
+    for (const auto& [w, h, frames] : {std::tuple{40, 25, 10000}, std::tuple{160, 100, 1000}}) {
+        size_t visible = 0;
+        start = TestClock::now();
+        for (int f = 0; f < frames; ++f) {
+            tree.Query(CellRect{(f * 7) % 1800, (f * 3) % 1800, w, h}, out);
+            visible += out.size();
+        }
+        const double us = ElapsedMs(start) * 1000.0 / frames;
+        std::printf("viewport %dx%d: %.2f us per frame, %.0f tile visibili\n", w, h, us, static_cast<double>(visible) / frames);
+        CHECK(visible > 0);
+    }
+
+    constexpr int kMoves = 100000;
+    start = TestClock::now();
+    for (int i = 0; i < kMoves; ++i) {
+        const uint64_t k = 1 + (i * 7919ull) % 1000000;
+        tree.Move(k, CellRect{static_cast<int>((k - 1) % 1000) * 2 + 1, static_cast<int>((k - 1) / 1000) * 2, 2, 2});
+    }
+    std::printf("spostamento: %.3f us\n", ElapsedMs(start) * 1000.0 / kMoves);
+    CHECK_EQ(tree.Size(), size_t{1000000});
+    return TestResult("bench_quadtree");
+}
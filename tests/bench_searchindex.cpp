@@ -0,0 +1,103 @@
+// Indicizzazione di versioni successive di 20k note (parole con distribuzione di Zipf) fino
+// a 64 MB di testo, con i segmenti e le fusioni che ne seguono; riapertura dal manifest;
+// ricerche di termini rari, comuni, piu' termini e prefissi; fusione completa.
+
+#include "check.h"
+#include "searchindex.h"
+
+#include <algorithm>
+#include <random>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+int main() {
+    constexpr uint64_t kTextBytes = 64ull << 20;
+    constexpr int kVocabulary = 200000;
+    constexpr int kTiles = 20000;
+    const char* const syllables[] = {"ca", "sa", "to", "re", "mi", "la", "no", "ve", "der", "tion", "ing", "pre",
+                                     "con", "stra", "ri", "el", "ment", "are", "pro", "ta", "lo", "gi", "ne", "bu"};
+    std::vector<std::string> vocab(kVocabulary);
+    for (int i = 0; i < kVocabulary; ++i) {
+        int x = i;
+        do {
+            vocab[i] += syllables[x % 24];
+            x /= 24;
+        } while (x);
+        if (i < 24) vocab[i] += "la";
+    }
+    std::vector<double> cumulative(kVocabulary);
+    double sum = 0;
+    for (int i = 0; i < kVocabulary; ++i) cumulative[i] = sum += 1.0 / (i + 1);
+    std::mt19937_64 rng(42);
+    auto word = [&]() -> const std::string& {
+        const double r = std::uniform_real_distribution<double>(0, sum)(rng);
+        return vocab[std::lower_bound(cumulative.begin(), cumulative.end(), r) - cumulative.begin()];
+    };
+
+    const fs::path dir = fs::temp_directory_path() / ("gridnotes-searchbench-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    std::vector<std::string> notes(kTiles);
+    uint64_t bytes = 0, versions = 0;
+    auto start = TestClock::now();
+    {
+        SearchIndex index;
+        CHECK(index.Open(dir));
+        for (int64_t time = 1600000000; bytes < kTextBytes; ++time) {
+            const size_t tile = rng() % kTiles;
+            std::string& text = notes[tile];
+            if (text.size() > 4000 || rng() % 8 == 0) text.clear();
+            for (int n = 20 + static_cast<int>(rng() % 200), k = 0; k < n; ++k) {
+                text += word();
+                text += k % 12 == 11 ? ".\n" : " ";
+            }
+            index.Add(tile + 1, time, text);
+            bytes += text.size();
+            ++versions;
+        }
+        index.Stop();
+        const double ms = ElapsedMs(start);
+        const SearchStats stats = index.Stats();
+        std::printf("indicizzazione: %llu versioni, %.0f MB in %.1f s (%.1f MB/s); %zu segmenti, %.1f MB di indice, %llu fusioni\n",
+                    static_cast<unsigned long long>(versions), bytes / 1048576.0, ms / 1000, bytes / 1048576.0 / (ms / 1000),
+                    stats.segments, stats.bytes / 1048576.0, static_cast<unsigned long long>(stats.merges));
+        CHECK_EQ(stats.documents, static_cast<size_t>(versions));
+    }
+
+    start = TestClock::now();
+    SearchIndex index;
+    CHECK(index.Open(dir));
+    std::printf("riapertura: %.1f ms\n", ElapsedMs(start));
+
+    struct Probe {
+        const char* what;
+        std::string query;
+    };
+    const Probe probes[] = {{"raro", vocab[150000]},
+                            {"medio", vocab[3000]},
+                            {"comune", vocab[10]},
+                            {"due termini", vocab[200] + " " + vocab[5000]},
+                            {"tre termini", vocab[50] + " " + vocab[700] + " " + vocab[9000]},
+                            {"prefisso 4", vocab[2000].substr(0, 4)},
+                            {"prefisso 3", vocab[2000].substr(0, 3)},
+                            {"assente", "zzzqqq"}};
+    for (const Probe& p : probes) {
+        std::vector<double> ms;
+        size_t hits = 0;
+        for (int r = 0; r < 7; ++r) {
+            const auto t = TestClock::now();
+            hits = index.Query(p.query, 50).size();
+            ms.push_back(ElapsedMs(t));
+        }
+        std::sort(ms.begin(), ms.end());
+        std::printf("  %-12s %-22s %2zu risultati, mediana %.2f ms\n", p.what, p.query.c_str(), hits, ms[3]);
+        CHECK(hits > 0 || p.query == "zzzqqq");
+    }
+
+    start = TestClock::now();
+    index.Merge();
+    std::printf("fusione completa: %.1f s, %zu segmenti\n", ElapsedMs(start) / 1000, index.Stats().segments);
+    CHECK_EQ(index.Stats().segments, size_t{1});
+    fs::remove_all(dir);
+    return TestResult("bench_searchindex");
+}
@@ -0,0 +1,69 @@
+// Dizionario da 500k parole: compilazione della lista nel DAWG (una volta sola), apertura
+// del file compilato (mappato, niente da leggere o costruire), ricerca di tutte le parole
+// e controllo completo di una nota da 10M unita'.
+
+#include "check.h"
+#include "spell.h"
+#include "textcodec.h"
+
+#include <fstream>
+#include <random>
+#include <set>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+int main() {
+    const char* const syllables[] = {"ca", "sa", "to", "re", "mi", "la", "no", "ve", "der", "tion", "ing", "pre",
+                                     "con", "stra", "ità", "èl", "ment", "are", "ere", "ire", "gli", "zio", "ne", "ro"};
+    std::mt19937 rng(7);
+    std::set<std::string> words;
+    while (words.size() < 500000) {
+        std::string w;
+        for (int n = 1 + static_cast<int>(rng() % 5); n > 0; --n) w += syllables[rng() % std::size(syllables)];
+        words.insert(w);
+    }
+    const fs::path dir = fs::temp_directory_path() / ("gridnotes-spellbench-" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    {
+        std::ofstream f(dir / "parole.dic", std::ios::binary);
+        f << words.size() << "\n";
+        for (const std::string& w : words) f << w << "/AB\n";
+    }
+
+    auto start = TestClock::now();
+    size_t compiled = 0;
+    CHECK(SpellDictionary::Compile(dir / "parole.dic", dir / "parole.dic.dawg", &compiled));
+    std::printf("compilazione di %zu parole: %.0f ms\n", compiled, ElapsedMs(start));
+
+    start = TestClock::now();
+    std::vector<SpellDictionary> dicts(1);
+    CHECK(dicts[0].Open(dir / "parole.dic.dawg"));
+    std::printf("apertura: %.3f ms, %.1f MB su disco\n", ElapsedMs(start), dicts[0].Bytes() / 1048576.0);
+
+    std::vector<std::u16string> pool;
+    for (const std::string& w : words) {
+        pool.emplace_back();
+        AppendUtf16(pool.back(), w);
+    }
+    start = TestClock::now();
+    size_t missing = 0;
+    for (const std::u16string& w : pool) missing += !dicts[0].Contains(w);
+    std::printf("ricerca: %.0f ns per parola\n", ElapsedMs(start) * 1e6 / pool.size());
+    CHECK_EQ(missing, size_t{0});
+
+    std::u16string note;
+    while (note.size() < 10'000'000) {
+        note += pool[rng() % pool.size()];
+        note += rng() % 10 ? u" " : u", ";
+    }
+    start = TestClock::now();
+    std::vector<SpellRange> errors;
+    SpellCheckRange(dicts, note, 0, note.size(), errors);
+    std::printf("controllo completo di 10M unita': %.0f ms (%zu errori)\n", ElapsedMs(start), errors.size());
+    CHECK(errors.empty());
+
+    dicts.clear();
+    fs::remove_all(dir);
+    return TestResult("bench_spell");
+}
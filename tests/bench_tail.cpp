@@ -0,0 +1,129 @@
+// Un log che cresce di 20.000 righe al secondo per 3 secondi e un FileTail da 500 righe
+// che lo segue a 60 Hz, come il pannello. Latenza tra la scrittura di una riga e il Poll che
+// la mostra, tempo di un Poll e memoria: l'anello resta di 500 righe, senza buchi ne'
+// doppioni, qualunque sia la velocita'. In testa, Push su LineRing a vuoto.
+
+#include "check.h"
+#include "tail.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+long MaxRssKb() {
+    rusage r{};
+    getrusage(RUSAGE_SELF, &r);
+    return r.ru_maxrss;
+}
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(TestClock::now().time_since_epoch()).count();
+}
+
+// "t=<microsecondi> id=<n> ..." -> campo numerico dopo la chiave
+int64_t Field(const std::string& line, const char* key) {
+    const size_t at = line.find(key);
+    return at == std::string::npos ? -1 : std::stoll(line.substr(at + std::char_traits<char>::length(key)));
+}
+
+} // namespace
+
+int main() {
+    constexpr size_t kRingLines = 500;
+    constexpr int kLinesPerBatch = 100;
+    constexpr auto kBatchEvery = std::chrono::milliseconds(5); // 20.000 righe/s
+    constexpr auto kDuration = std::chrono::seconds(3);
+
+    {
+        LineRing ring(kRingLines);
+        const auto start = TestClock::now();
+        for (int i = 0; i < 1000000; ++i) ring.Push("2026-10-19 12:00:00.000 INFO worker processed request " + std::to_string(i));
+        std::printf("LineRing: 1M Push in %.1f ms, %zu righe tenute\n", ElapsedMs(start), ring.Size());
+        CHECK_EQ(ring.Size(), kRingLines);
+    }
+
+    const fs::path path = fs::temp_directory_path() / ("gridnotes-bench-tail-" + std::to_string(::getpid()) + ".log");
+    fs::remove(path);
+    FileTail tail(path, kRingLines);
+    CHECK(tail.Poll() == FileTail::Result::Missing);
+
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> written{0};
+    std::thread writer([&] {
+        std::ofstream f(path, std::ios::binary | std::ios::app);
+        auto next = TestClock::now();
+        int64_t n = 0;
+        while (!stop) {
+            const int64_t t = NowUs();
+            for (int i = 0; i < kLinesPerBatch; ++i, ++n) {
+                f << "t=" << t << " id=" << n << " INFO worker-" << n % 8 << " processed request in 3 ms\n";
+            }
+            f.flush();
+            written = n;
+            next += kBatchEvery;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    const long rssBefore = MaxRssKb();
+    std::vector<double> latencyMs, pollMs;
+    size_t maxLines = 0, maxBytes = 0, badLines = 0;
+    const auto end = TestClock::now() + kDuration;
+    while (TestClock::now() < end) {
+        const auto start = TestClock::now();
+        const FileTail::Result r = tail.Poll();
+        pollMs.push_back(ElapsedMs(start));
+        if (r == FileTail::Result::Appended || r == FileTail::Result::Restarted) {
+            const LineRing& lines = tail.Lines();
+            latencyMs.push_back((NowUs() - Field(lines.At(lines.Size() - 1), "t=")) / 1000.0);
+            size_t bytes = 0;
+            for (size_t i = 0; i < lines.Size(); ++i) {
+                bytes += lines.At(i).size();
+                badLines += lines.At(i).size() > FileTail::kMaxLineBytes;
+                if (i > 0) badLines += Field(lines.At(i), "id=") != Field(lines.At(i - 1), "id=") + 1;
+            }
+            maxLines = std::max(maxLines, lines.Size());
+            maxBytes = std::max(maxBytes, bytes);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(16667));
+    }
+    stop = true;
+    writer.join();
+    tail.Poll();
+    const long rssGrowth = MaxRssKb() - rssBefore;
+
+    auto percentile = [](std::vector<double> v, double p) {
+        if (v.empty()) return 0.0;
+        std::sort(v.begin(), v.end());
+        return v[std::min(v.size() - 1, static_cast<size_t>(p * v.size()))];
+    };
+    const double seconds = std::chrono::duration<double>(kDuration).count();
+    std::printf("scritte %lld righe (%.0f righe/s), %zu Poll\n", static_cast<long long>(written.load()), written / seconds, pollMs.size());
+    std::printf("latenza scrittura -> Poll: mediana %.2f ms, p99 %.2f ms, max %.2f ms\n", percentile(latencyMs, 0.5),
+                percentile(latencyMs, 0.99), percentile(latencyMs, 1.0));
+    std::printf("Poll: mediana %.3f ms, p99 %.3f ms\n", percentile(pollMs, 0.5), percentile(pollMs, 0.99));
+    std::printf("memoria: anello al massimo %zu righe, %zu KB di testo; RSS massimo cresciuto di %ld KB\n", maxLines, maxBytes / 1024,
+                rssGrowth);
+
+    CHECK(written / seconds >= 10000);
+    CHECK_EQ(maxLines, kRingLines);
+    CHECK(maxBytes <= kRingLines * FileTail::kMaxLineBytes);
+    CHECK_EQ(badLines, size_t{0});
+    CHECK_EQ(tail.Lines().Size(), kRingLines);
+    CHECK_EQ(Field(tail.Lines().At(kRingLines - 1), "id="), written - 1); // l'ultima riga scritta c'e'
+    CHECK(percentile(latencyMs, 0.5) < 50);
+
+    fs::remove(path);
+    return TestResult("bench_tail");
+}
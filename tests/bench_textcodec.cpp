@@ -0,0 +1,70 @@
+// Throughput del codec a ogni livello su 32M unita' di testo da note (quasi tutto ASCII,
+// qualche accento, a capo e virgolette): UTF-16 -> UTF-8, ritorno, validazione, escape
+// JSON, unescape e ricerca della fine della stringa. GB/s sui byte letti.
+
+#include "check.h"
+#include "textcodec.h"
+
+#include <random>
+#include <string>
+
+int main() {
+    std::mt19937 rng(7);
+    std::u16string text;
+    while (text.size() < (32u << 20)) {
+        const int r = static_cast<int>(rng() % 1000);
+        if (r < 960) text += static_cast<char16_t>(r % 5 == 0 ? u' ' : u'a' + r % 26);
+        else if (r < 975) text += u"è";
+        else if (r < 990) text += u"\r\n";
+        else text += u"\"";
+    }
+
+    std::string utf8;
+    AppendUtf8(utf8, text);
+    std::u16string escaped;
+    AppendJsonEscaped(escaped, text);
+    escaped += u'"';
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+        SetTextCodecLevel(level);
+        if (TextCodecLevel() != level) {
+            std::printf("%s: non disponibile su questa CPU\n", SimdLevelName(level));
+            continue;
+        }
+        auto gbps = [](size_t bytes, double ms) { return bytes / ms / 1e6; };
+
+        auto start = TestClock::now();
+        std::string u8;
+        AppendUtf8(u8, text);
+        const double toUtf8 = gbps(text.size() * 2, ElapsedMs(start));
+
+        start = TestClock::now();
+        std::u16string u16;
+        CHECK(AppendUtf16(u16, utf8));
+        const double toUtf16 = gbps(utf8.size(), ElapsedMs(start));
+
+        start = TestClock::now();
+        CHECK(IsValidUtf8(utf8));
+        const double validate = gbps(utf8.size(), ElapsedMs(start));
+
+        start = TestClock::now();
+        std::u16string esc;
+        AppendJsonEscaped(esc, text);
+        const double escape = gbps(text.size() * 2, ElapsedMs(start));
+
+        start = TestClock::now();
+        std::u16string back;
+        CHECK(AppendJsonUnescaped(back, std::u16string_view(escaped).substr(0, escaped.size() - 1)));
+        const double unescape = gbps(escaped.size() * 2, ElapsedMs(start));
+
+        start = TestClock::now();
+        const size_t end = FindJsonStringEnd(escaped, 0);
+        const double find = gbps(escaped.size() * 2, ElapsedMs(start));
+
+        CHECK(u8 == utf8 && u16 == text && back == text && esc + u'"' == escaped);
+        CHECK_EQ(end, escaped.size() - 1);
+        std::printf("%-6s -> UTF-8 %.2f  -> UTF-16 %.2f  valida %.2f  escape %.2f  unescape %.2f  fine stringa %.2f GB/s\n",
+                    SimdLevelName(level), toUtf8, toUtf16, validate, escape, unescape, find);
+    }
+    return TestResult("bench_textcodec");
+}
@@ -0,0 +1,36 @@
+// Navigazione a parole su una nota da quasi 6M unita': ogni operazione cammina solo attorno al
+// cursore, quindi il costo non dipende dalla lunghezza della nota. Poi il caso peggiore,
+// 100k accenti combinanti di fila, che kMaxWordScan deve tenere limitato.
+
+#include "check.h"
+#include "textseg.h"
+
+#include <string>
+
+int main() {
+    std::u16string note;
+    for (int i = 0; i < 200000; ++i) note += u"lorem ipsum, dolor sit amet. ";
+    const Utf16View view{note.data(), note.size()};
+
+    constexpr int kOps = 100000;
+    size_t sum = 0;
+    auto start = TestClock::now();
+    for (int i = 0; i < kOps; ++i) {
+        const size_t pos = (i * 7919ull) % note.size();
+        sum += WordLeft(view, pos) + WordRight(view, pos) + WordDeleteLeft(view, pos) + WordDeleteRight(view, pos);
+    }
+    const double ms = ElapsedMs(start);
+    CHECK(sum > 0);
+    std::printf("%zu unita': %.3f us per Ctrl+Left/Right/Backspace/Delete\n", note.size(), ms * 1000.0 / kOps);
+
+    std::u16string marks = u"a";
+    for (int i = 0; i < 100000; ++i) marks += char16_t(0x301);
+    const Utf16View pathological{marks.data(), marks.size()};
+    start = TestClock::now();
+    const size_t left = WordLeft(pathological, marks.size());
+    const size_t right = WordRight(pathological, 0);
+    const size_t del = WordDeleteLeft(pathological, 50000);
+    std::printf("100k accenti di fila: %.1f us\n", ElapsedMs(start) * 1000.0);
+    CHECK(left < marks.size() && right > 0 && del < 50000);
+    return TestResult("bench_textseg");
+}
@@ -0,0 +1,77 @@
+// Nota da 10 MB in una tile: apertura (indice + stime), salto a una riga qualunque,
+// rotella, carattere e Invio a meta' nota, Ctrl+Fine. Ogni operazione misura solo le
+// righe in vista, quindi i tempi non seguono la lunghezza della nota.
+
+#include "check.h"
+#include "textview.h"
+
+#include <random>
+#include <string>
+
+int main() {
+    TextViewMetrics metrics;
+    metrics.extents = [](std::u16string_view s, std::vector<int>& ends) {
+        ends.resize(s.size());
+        int x = 0;
+        for (size_t i = 0; i < s.size(); ++i) ends[i] = x += s[i] == u' ' ? 4 : 8;
+    };
+    metrics.lineHeight = 18;
+    metrics.charWidth = 8;
+    metrics.version = 1;
+
+    std::mt19937 rng(7);
+    const char16_t* const words[] = {u"la ", u"nota ", u"griglia ", u"scorrimento ", u"indice ", u"riga ", u"a ", u"misura "};
+    std::u16string note;
+    while (note.size() < (10u << 20)) {
+        for (int w = static_cast<int>(rng() % 100); w > 0; --w) note += words[rng() % std::size(words)];
+        note += u"\r\n";
+    }
+
+    TextView view;
+    view.SetMetrics(metrics);
+    view.SetViewport(600, 700);
+    auto start = TestClock::now();
+    view.SetText(note);
+    view.VisibleRows();
+    std::printf("apertura: %.2f ms, %zu righe logiche, %zu visive stimate\n", ElapsedMs(start), view.LineCount(), view.TotalRows());
+
+    constexpr int kOps = 2000;
+    start = TestClock::now();
+    for (int i = 0; i < kOps; ++i) {
+        view.ScrollTo(rng() % view.TotalRows());
+        CHECK(!view.VisibleRows().empty());
+    }
+    std::printf("salto + pagina: %.4f ms\n", ElapsedMs(start) / kOps);
+
+    start = TestClock::now();
+    for (int i = 0; i < kOps; ++i) {
+        view.ScrollBy(3);
+        view.VisibleRows();
+    }
+    std::printf("rotella + pagina: %.4f ms\n", ElapsedMs(start) / kOps);
+
+    const size_t mid = view.LineStart(view.LineCount() / 2);
+    view.SetSel(mid, mid);
+    start = TestClock::now();
+    for (int i = 0; i < kOps; ++i) {
+        view.Type(i % 5 ? u"x" : u" ");
+        view.ScrollToCaret();
+        view.VisibleRows();
+    }
+    std::printf("carattere a meta' nota + pagina: %.4f ms\n", ElapsedMs(start) / kOps);
+
+    start = TestClock::now();
+    for (int i = 0; i < 200; ++i) {
+        view.Type(u"\r\n");
+        view.VisibleRows();
+    }
+    std::printf("Invio + pagina: %.4f ms\n", ElapsedMs(start) / 200);
+
+    start = TestClock::now();
+    view.Move(CaretMove::DocEnd, false);
+    view.VisibleRows();
+    std::printf("Ctrl+Fine: %.3f ms; a capo calcolati finora %zu (righe logiche %zu), memoria %.1f MB\n", ElapsedMs(start),
+                view.WrappedLines(), view.LineCount(), view.MemoryBytes() / 1048576.0);
+    CHECK_EQ(view.Caret(), view.Text().size());
+    return TestResult("bench_textview");
+}
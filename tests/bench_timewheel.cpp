@@ -0,0 +1,44 @@
+// 1M promemoria sparsi su un anno: aggiunta, rimozione di meta', risvegli guidati da
+// NextDelay e il recupero dopo una sospensione di 30 giorni. I costi seguono le
+// scadenze, non il tempo trascorso.
+
+#include "check.h"
+#include "timewheel.h"
+
+#include <random>
+
+int main() {
+    constexpr int64_t kStart = 1760000000000;
+    constexpr int64_t kDay = 86400000;
+    constexpr uint64_t kCount = 1000000;
+    std::mt19937_64 rng(7);
+    TimingWheel wheel(1000);
+    wheel.Reset(kStart);
+
+    auto start = TestClock::now();
+    for (uint64_t k = 0; k < kCount; ++k) wheel.Add(k, kStart + static_cast<int64_t>(rng() % (365 * kDay)));
+    std::printf("aggiunta: %.1f ns\n", ElapsedMs(start) * 1e6 / kCount);
+
+    start = TestClock::now();
+    for (uint64_t k = 0; k < kCount; k += 2) wheel.Remove(k);
+    std::printf("rimozione: %.1f ns\n", ElapsedMs(start) * 1e6 / (kCount / 2));
+    CHECK_EQ(wheel.Size(), size_t{kCount / 2});
+
+    start = TestClock::now();
+    size_t fired = 0;
+    int64_t now = kStart;
+    for (int i = 0; i < 2000; ++i) {
+        const int64_t delay = wheel.NextDelay(now);
+        CHECK(delay >= 0);
+        now += delay;
+        fired += wheel.Advance(now).size();
+    }
+    std::printf("2000 risvegli: %zu scaduti in %.2f ms, fino a +%.1f h\n", fired, ElapsedMs(start),
+                static_cast<double>(now - kStart) / 3.6e6);
+
+    start = TestClock::now();
+    const size_t late = wheel.Advance(now + 30 * kDay).size();
+    std::printf("salto di 30 giorni: %zu scaduti in %.2f ms\n", late, ElapsedMs(start));
+    CHECK(fired + late > 0);
+    return TestResult("bench_timewheel");
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Quel poco che serve ai test: CHECK conta i fallimenti senza fermarsi (si vedono tutti
+// in una volta), TestResult li riassume ed e' il codice di uscita per ctest.
+// ElapsedMs per i benchmark, che stampano i tempi e falliscono solo se il risultato e' sbagliato.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+inline int& TestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void TestFail(const char* file, int line, const std::string& what) {
+    if (++TestFailures() <= 20) std::fprintf(stderr, "%s:%d: %s\n", file, line, what.c_str());
+}
+
+#define CHECK(cond)                                         \
+    do {                                                    \
+        if (!(cond)) TestFail(__FILE__, __LINE__, #cond);   \
+    } while (0)
+
+// a e b stampabili con std::to_string
+#define CHECK_EQ(a, b)                                                                                       \
+    do {                                                                                                     \
+        const auto checkA_ = (a);                                                                            \
+        const auto checkB_ = (b);                                                                            \
+        if (!(checkA_ == checkB_)) {                                                                         \
+            TestFail(__FILE__, __LINE__, std::string(#a " == " #b ": ") + std::to_string(checkA_) + " != " + \
+                                             std::to_string(checkB_));                                       \
+        }                                                                                                    \
+    } while (0)
+
+inline int TestResult(const char* name) {
+    if (TestFailures()) {
+        std::fprintf(stderr, "%s: %d controlli falliti\n", name, TestFailures());
+        return 1;
+    }
+    std::printf("%s: ok\n", name);
+    return 0;
+}
+
+using TestClock = std::chrono::steady_clock;
+
+inline double ElapsedMs(TestClock::time_point since) {
+    return std::chrono::duration<double, std::milli>(TestClock::now() - since).count();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Il "thread UI" dei test IPC: come ProcessIpcBatch, prende un batch a ogni risveglio e
+// risponde a ogni comando. set/get su una mappa al posto delle tile.
+
+#include "ipc.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+class FakeUi {
+public:
+    explicit FakeUi(IpcServer& server) : server_(server) {}
+    ~FakeUi() { Stop(); }
+
+    IpcServer::WakeFn Wake() {
+        return [this] {
+            std::lock_guard<std::mutex> lock(mu_);
+            woken_ = true;
+            cv_.notify_one();
+        };
+    }
+
+    void Start() {
+        thread_ = std::thread([this] { Loop(); });
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stopping_ = true;
+            cv_.notify_one();
+        }
+        if (thread_.joinable()) thread_.join();
+    }
+
+    // risposte grandi: per far crescere la coda d'uscita di un client che non legge
+    std::atomic<size_t> padding{0};
+    std::atomic<uint64_t> batches{0};
+
+private:
+    void Loop() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                cv_.wait(lock, [this] { return woken_ || stopping_; });
+                if (stopping_) return;
+                woken_ = false;
+            }
+            const std::vector<IpcCommand> batch = server_.TakeBatch();
+            if (!batch.empty()) ++batches;
+            for (const IpcCommand& c : batch) server_.Reply(c.client, Handle(c));
+        }
+    }
+
+    std::string Handle(const IpcCommand& c) {
+        if (!c.error.empty()) return IpcErrorReply(c.reqId, c.error);
+        switch (c.op) {
+            case IpcOp::Set:
+                texts_[c.tile] = c.text;
+                if (server_.HasSubscribers()) server_.Publish("{\"event\":\"changed\",\"tile\":" + std::to_string(c.tile) + "}");
+                return IpcOkReply(c.reqId, padding ? "\"pad\":\"" + std::string(padding, 'x') + "\"" : std::string());
+            case IpcOp::Get: {
+                auto it = texts_.find(c.tile);
+                if (it == texts_.end()) return IpcErrorReply(c.reqId, "unknown tile");
+                return IpcOkReply(c.reqId, "\"text\":" + JsonQuoteUtf8(it->second));
+            }
+            case IpcOp::Subscribe:
+                server_.Subscribe(c.client);
+                return IpcOkReply(c.reqId);
+            default:
+                return IpcErrorReply(c.reqId, "unknown command");
+        }
+    }
+
+    IpcServer& server_;
+    std::map<uint64_t, std::string> texts_;
+    std::thread thread_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool woken_{false};
+    bool stopping_{false};
+};
+
+inline std::string TestSocketPath(const char* name) {
+    return "/tmp/gridnotes-" + std::string(name) + "-" + std::to_string(::getpid()) + ".sock";
+}
@@ -0,0 +1,198 @@
+// AdjacencyIndex contro la forza bruta su board riempite da tagli casuali (con buchi):
+// vicini per lato dopo aggiunte e rimozioni, gruppi di bordo condiviso (ogni spostamento
+// ammesso lascia il layout valido, il gruppo contiene tutte le tile sulla linea), tile piu'
+// vicina in ogni direzione e ordine di lettura.
+
+#include "adjacency.h"
+#include "check.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+struct Placed {
+    uint64_t id;
+    CellRect r;
+};
+
+bool Overlap1D(int a0, int a1, int b0, int b1) { return a0 < b1 && b0 < a1; }
+
+// board W x H divisa da tagli casuali, poi qualche tile tolta per lasciare buchi
+std::vector<Placed> RandomBoard(std::mt19937& rng, int w, int h, int splits) {
+    uint64_t nextId = 1;
+    std::vector<Placed> tiles{{nextId++, {0, 0, w, h}}};
+    for (int i = 0; i < splits; ++i) {
+        const size_t k = rng() % tiles.size();
+        const Placed t = tiles[k];
+        if (rng() % 2 && t.r.w >= 2) {
+            const int a = 1 + static_cast<int>(rng() % (t.r.w - 1));
+            tiles[k].r.w = a;
+            tiles.push_back({nextId++, {t.r.x + a, t.r.y, t.r.w - a, t.r.h}});
+        } else if (t.r.h >= 2) {
+            const int a = 1 + static_cast<int>(rng() % (t.r.h - 1));
+            tiles[k].r.h = a;
+            tiles.push_back({nextId++, {t.r.x, t.r.y + a, t.r.w, t.r.h - a}});
+        }
+    }
+    const size_t holes = rng() % (tiles.size() / 3 + 1);
+    for (size_t i = 0; i < holes && tiles.size() > 1; ++i) tiles.erase(tiles.begin() + rng() % tiles.size());
+    return tiles;
+}
+
+bool Touches(const CellRect& r, const CellRect& q, int side) {
+    switch (static_cast<TileSide>(side)) {
+        case TileSide::Left: return q.x + q.w == r.x && Overlap1D(r.y, r.y + r.h, q.y, q.y + q.h);
+        case TileSide::Right: return q.x == r.x + r.w && Overlap1D(r.y, r.y + r.h, q.y, q.y + q.h);
+        case TileSide::Top: return q.y + q.h == r.y && Overlap1D(r.x, r.x + r.w, q.x, q.x + q.w);
+        case TileSide::Bottom: return q.y == r.y + r.h && Overlap1D(r.x, r.x + r.w, q.x, q.x + q.w);
+    }
+    return false;
+}
+
+void CheckSharedEdge(const AdjacencyIndex& index, const std::vector<Placed>& tiles, const Placed& t, int side, int w, int h) {
+    EdgeGroup group;
+    if (!index.SharedEdge(t.id, static_cast<TileSide>(side), side < 2 ? w : h, group)) return;
+    const std::set<uint64_t> before(group.before.begin(), group.before.end());
+    const std::set<uint64_t> after(group.after.begin(), group.after.end());
+    CHECK(before.count(t.id) || after.count(t.id));
+
+    for (int delta : {group.minDelta, group.maxDelta, (group.minDelta + group.maxDelta) / 2}) {
+        std::vector<Placed> moved = tiles;
+        for (Placed& m : moved) {
+            if (before.count(m.id)) (group.vertical ? m.r.w : m.r.h) += delta;
+            if (after.count(m.id)) {
+                if (group.vertical) {
+                    m.r.x += delta;
+                    m.r.w -= delta;
+                } else {
+                    m.r.y += delta;
+                    m.r.h -= delta;
+                }
+            }
+        }
+        bool valid = true;
+        for (const Placed& m : moved) {
+            if (m.r.w < 1 || m.r.h < 1 || m.r.x < 0 || m.r.y < 0 || m.r.x + m.r.w > w || m.r.y + m.r.h > h) valid = false;
+        }
+        for (size_t i = 0; i < moved.size() && valid; ++i) {
+            for (size_t j = i + 1; j < moved.size(); ++j) {
+                const CellRect& a = moved[i].r;
+                const CellRect& b = moved[j].r;
+                if (Overlap1D(a.x, a.x + a.w, b.x, b.x + b.w) && Overlap1D(a.y, a.y + a.h, b.y, b.y + b.h)) valid = false;
+            }
+        }
+        CHECK(valid);
+    }
+
+    // chiusura: ogni tile con un lato sulla linea che si sovrappone al tratto e' nel gruppo
+    for (const Placed& o : tiles) {
+        const int end = group.vertical ? o.r.x + o.r.w : o.r.y + o.r.h;
+        const int start = group.vertical ? o.r.x : o.r.y;
+        const int lo = group.vertical ? o.r.y : o.r.x;
+        const int hi = group.vertical ? o.r.y + o.r.h : o.r.x + o.r.w;
+        if (Overlap1D(lo, hi, group.lo, group.hi) && (end == group.line || start == group.line)) {
+            CHECK(before.count(o.id) || after.count(o.id));
+        }
+    }
+}
+
+// distanza dalla tile piu' vicina oltre il lato tra quelle che si sovrappongono al lato
+int NearestGap(const std::vector<Placed>& tiles, const CellRect& r, int side, const CellRect* q) {
+    auto gapTo = [&](const CellRect& o) {
+        switch (static_cast<TileSide>(side)) {
+            case TileSide::Left: return r.x - (o.x + o.w);
+            case TileSide::Right: return o.x - (r.x + r.w);
+            case TileSide::Top: return r.y - (o.y + o.h);
+            case TileSide::Bottom: return o.y - (r.y + r.h);
+        }
+        return -1;
+    };
+    if (q) return gapTo(*q);
+    const bool vertical = side < 2;
+    int best = -1;
+    for (const Placed& o : tiles) {
+        const int lo = vertical ? o.r.y : o.r.x;
+        const int hi = vertical ? o.r.y + o.r.h : o.r.x + o.r.w;
+        if (!Overlap1D(vertical ? r.y : r.x, vertical ? r.y + r.h : r.x + r.w, lo, hi)) continue;
+        const int gap = gapTo(o.r);
+        if (gap >= 0 && (best < 0 || gap < best)) best = gap;
+    }
+    return best;
+}
+
+void TestRandomBoards() {
+    std::mt19937 rng(2);
+    for (int board = 0; board < 500; ++board) {
+        const int w = 2 + static_cast<int>(rng() % 30);
+        const int h = 2 + static_cast<int>(rng() % 30);
+        std::vector<Placed> tiles = RandomBoard(rng, w, h, static_cast<int>(rng() % 40));
+        AdjacencyIndex index;
+        for (const Placed& t : tiles) index.Add(t.id, t.r);
+        for (int i = 0; i < 5 && tiles.size() > 1; ++i) {
+            const size_t k = rng() % tiles.size();
+            index.Remove(tiles[k].id);
+            tiles.erase(tiles.begin() + k);
+        }
+        // Move incrementale: una tile spostata in un buco e poi rimessa al suo posto
+        if (!tiles.empty()) {
+            const Placed t = tiles[rng() % tiles.size()];
+            index.Move(t.id, {t.r.x, t.r.y, 1, 1});
+            index.Move(t.id, t.r);
+        }
+        CHECK_EQ(index.Size(), tiles.size());
+
+        std::vector<Placed> reading = tiles;
+        std::sort(reading.begin(), reading.end(),
+                  [](const Placed& a, const Placed& b) { return std::tie(a.r.y, a.r.x, a.id) < std::tie(b.r.y, b.r.x, b.id); });
+
+        for (size_t k = 0; k < reading.size(); ++k) {
+            const Placed& t = reading[k];
+            for (int side = 0; side < 4; ++side) {
+                std::set<uint64_t> expected;
+                for (const Placed& o : tiles) {
+                    if (o.id != t.id && Touches(t.r, o.r, side)) expected.insert(o.id);
+                }
+                const std::vector<uint64_t>& got = index.Neighbors(t.id, static_cast<TileSide>(side));
+                CHECK(std::set<uint64_t>(got.begin(), got.end()) == expected);
+                CHECK_EQ(got.size(), expected.size());
+
+                CheckSharedEdge(index, tiles, t, side, w, h);
+
+                const int ref = side < 2 ? t.r.y + t.r.h / 2 : t.r.x + t.r.w / 2;
+                const uint64_t nearest = index.Nearest(t.id, static_cast<TileSide>(side), ref);
+                const int bestGap = NearestGap(tiles, t.r, side, nullptr);
+                if (bestGap < 0) {
+                    CHECK_EQ(nearest, uint64_t{0});
+                } else {
+                    CHECK(nearest != 0);
+                    if (nearest) CHECK_EQ(NearestGap(tiles, t.r, side, index.Rect(nearest)), bestGap);
+                }
+            }
+            CHECK_EQ(index.NextInReadingOrder(t.id, false), reading[(k + 1) % reading.size()].id);
+            CHECK_EQ(index.NextInReadingOrder(t.id, true), reading[(k + reading.size() - 1) % reading.size()].id);
+        }
+    }
+}
+
+void TestMissingId() {
+    AdjacencyIndex index;
+    index.Add(1, {0, 0, 2, 2});
+    CHECK(index.Rect(7) == nullptr);
+    CHECK(index.Neighbors(7, TileSide::Left).empty());
+    CHECK_EQ(index.NextInReadingOrder(7, false), uint64_t{0});
+    CHECK_EQ(index.NextInReadingOrder(1, false), uint64_t{1}); // circolare anche con una sola tile
+    EdgeGroup group;
+    CHECK(!index.SharedEdge(7, TileSide::Right, 10, group));
+}
+
+} // namespace
+
+int main() {
+    TestMissingId();
+    TestRandomBoards();
+    return TestResult("test_adjacency");
+}
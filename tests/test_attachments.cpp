@@ -0,0 +1,156 @@
+// Allegati: lo store dei blob (un blob per contenuto, copia a pezzi con l'hash giusto,
+// niente .tmp rimasti, Sweep che tiene i vivi e quelli usati di recente) e le miniature
+// (ridotte una volta e poi rilette dal disco, fallimenti ricordati fino a Forget, LRU
+// in memoria entro il tetto in byte che butta fuori la meno usata, TrimDisk).
+
+#include "attachments.h"
+#include "check.h"
+#include "imagecodec.h"
+#include "sha256.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string TestPng(int seed, int w, int h) {
+    Image image;
+    image.width = w;
+    image.height = h;
+    image.rgba.assign(static_cast<size_t>(w) * h * 4, 255);
+    for (size_t i = 0; i < image.rgba.size(); i += 4) {
+        image.rgba[i] = static_cast<uint8_t>(seed * 40 + i / 4 % w);
+        image.rgba[i + 1] = static_cast<uint8_t>(seed * 7);
+    }
+    return EncodePng(image);
+}
+
+size_t FilesUnder(const fs::path& dir) {
+    size_t n = 0;
+    for (const auto& e : fs::recursive_directory_iterator(dir)) n += e.is_regular_file();
+    return n;
+}
+
+// la chiede finche' il thread delle miniature non l'ha pronta
+ThumbPtr WaitThumb(ThumbCache& cache, const std::string& hash, int side) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    bool failed = false;
+    for (;;) {
+        if (ThumbPtr t = cache.Get(hash, side, &failed)) return t;
+        if (failed || std::chrono::steady_clock::now() > deadline) return nullptr;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void TestBlobStore(const fs::path& root) {
+    BlobStore blobs;
+    CHECK(blobs.Open(root / "blobs"));
+    const std::string png = TestPng(1, 300, 200);
+    const std::string hash = blobs.Put(png);
+    CHECK(IsBlobHash(hash));
+    CHECK(hash == Sha256Hex(png));
+    CHECK(blobs.Has(hash));
+    CHECK(blobs.Put(png) == hash);
+    CHECK(!blobs.Has("../../etc/passwd"));
+    CHECK(!IsBlobHash("zz"));
+
+    std::string big(5u << 20, 'x');
+    for (size_t i = 0; i < big.size(); i += 4096) big[i] = static_cast<char>(i >> 12);
+    std::ofstream(root / "big.bin", std::ios::binary) << big;
+    uint64_t size = 0;
+    const std::string bigHash = blobs.PutFile(root / "big.bin", &size);
+    CHECK(bigHash == Sha256Hex(big));
+    CHECK_EQ(size, uint64_t{big.size()});
+    CHECK(blobs.PutFile(root / "manca.bin").empty());
+    CHECK_EQ(FilesUnder(root / "blobs"), size_t{2}); // niente .tmp rimasti
+
+    // Sweep: via solo quello non vivo e non usato da un giorno; rimettere un blob vale come usarlo
+    const std::string text = blobs.Put("non un'immagine");
+    CHECK_EQ(blobs.Sweep({hash}, std::chrono::hours(24)), size_t{0});
+    const auto old = fs::file_time_type::clock::now() - std::chrono::hours(48);
+    for (const std::string& h : {hash, bigHash, text}) fs::last_write_time(blobs.PathOf(h), old);
+    CHECK(blobs.Put("non un'immagine") == text);
+    CHECK_EQ(blobs.Sweep({hash}, std::chrono::hours(24)), size_t{1});
+    CHECK(!blobs.Has(bigHash));
+    CHECK(blobs.Has(hash) && blobs.Has(text));
+}
+
+void TestThumbnails(const fs::path& root) {
+    BlobStore blobs;
+    CHECK(blobs.Open(root / "blobs"));
+    const std::string image = blobs.Put(TestPng(1, 300, 200));
+    const std::string text = blobs.Put("non un'immagine");
+
+    CHECK_EQ(ThumbCache::ThumbSide(10), 48);
+    CHECK_EQ(ThumbCache::ThumbSide(200), 256);
+    CHECK_EQ(ThumbCache::ThumbSide(5000), 1024);
+
+    ThumbCache cache;
+    CHECK(cache.Open(&blobs, root / "thumbs", 40000, 0x303030));
+    const ThumbPtr first = cache.Load(image, 96);
+    CHECK(first && first->width == 96 && first->height == 64);
+    const ThumbPtr again = cache.Load(image, 96); // dal PNG ridotto
+    CHECK(again && again->pixels == first->pixels);
+    CHECK(!cache.Load(text, 96));
+    CHECK(!cache.Load(std::string(64, '0'), 96));
+    ThumbStats stats = cache.Stats();
+    CHECK_EQ(stats.decodes, uint64_t{1});
+    CHECK_EQ(stats.diskHits, uint64_t{1});
+    CHECK_EQ(stats.failures, uint64_t{2});
+
+    std::atomic<int> ready{0};
+    cache.Start([&] { ++ready; });
+    bool failed = true;
+    CHECK(!cache.Get(text, 64, &failed) && !failed); // in coda
+    CHECK(!WaitThumb(cache, text, 64));
+    CHECK(!cache.Get(text, 64, &failed) && failed); // ricordata
+    cache.Forget(text);
+    CHECK(!cache.Get(text, 64, &failed) && !failed);
+
+    // LRU: una miniatura 64 x 43 sono ~11 KB, nel tetto ne stanno tre
+    std::vector<std::string> hashes;
+    for (int i = 0; i < 4; ++i) hashes.push_back(blobs.Put(TestPng(2 + i, 300, 200)));
+    for (int i = 0; i < 3; ++i) CHECK(WaitThumb(cache, hashes[i], 64));
+    CHECK(cache.Get(hashes[0], 64)); // la prima torna la piu' recente
+    CHECK(WaitThumb(cache, hashes[3], 64));
+    stats = cache.Stats();
+    CHECK(stats.bytes <= stats.maxBytes);
+    CHECK_EQ(stats.items, size_t{3});
+    CHECK_EQ(stats.evictions, uint64_t{1});
+    CHECK(cache.Get(hashes[0], 64) && cache.Get(hashes[2], 64) && cache.Get(hashes[3], 64));
+    CHECK(!cache.Get(hashes[1], 64)); // la meno usata
+    CHECK(ready > 0);
+
+    std::atomic<bool> posted{false};
+    cache.Post([&] { posted = true; });
+    cache.Stop();
+    CHECK(posted);
+
+    // disco: via le miniature di blob non vivi, poi le meno usate fino al tetto
+    uint64_t before = 0;
+    for (const auto& e : fs::directory_iterator(root / "thumbs")) before += e.file_size();
+    std::unordered_set<std::string> live(hashes.begin(), hashes.end());
+    CHECK(cache.TrimDisk(live, before / 2) >= 2); // quelle di image (96 e 64) non sono vive
+    uint64_t after = 0;
+    for (const auto& e : fs::directory_iterator(root / "thumbs")) {
+        after += e.file_size();
+        CHECK(live.count(e.path().filename().string().substr(0, 64)) != 0);
+    }
+    CHECK(after <= before / 2);
+}
+
+} // namespace
+
+int main() {
+    const fs::path root = fs::temp_directory_path() / ("gridnotes-attachments-" + std::to_string(::getpid()));
+    fs::remove_all(root);
+    fs::create_directories(root);
+    TestBlobStore(root);
+    TestThumbnails(root);
+    fs::remove_all(root);
+    return TestResult("test_attachments");
+}
@@ -0,0 +1,114 @@
+// FitLayout con una metrica sintetica (caratteri a larghezza fissa, a capo per riempimento)
+// contro la somma da zero: dopo ogni modifica incrementale, cambio di larghezza o
+// SetText, Fit e TotalHeight danno lo stesso risultato della forza bruta. Poi il conto
+// delle misure vere: scrivere in un paragrafo rimisura solo quel paragrafo.
+
+#include "autofit.h"
+#include "check.h"
+#include "textutil.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+namespace {
+
+int Measure(std::wstring_view paragraph, int fontPx, int width) {
+    const int charW = std::max(1, fontPx * 6 / 10);
+    const long long columns = std::max(1, width / charW);
+    const long long lines = std::max<long long>(1, (static_cast<long long>(paragraph.size()) + columns - 1) / columns);
+    return static_cast<int>(lines * (fontPx + fontPx / 4));
+}
+
+// paragrafi separati da \n, con \r finale tolto come fa FitLayout
+long long BruteHeight(const std::wstring& text, size_t sizeIdx, int width) {
+    long long sum = 0;
+    size_t begin = 0;
+    for (;;) {
+        const size_t nl = text.find(L'\n', begin);
+        const size_t end = nl == std::wstring::npos ? text.size() : nl;
+        size_t length = end - begin;
+        if (nl != std::wstring::npos && length && text[begin + length - 1] == L'\r') --length;
+        sum += Measure(std::wstring_view(text).substr(begin, length), kFontLadderPx[sizeIdx], width);
+        if (nl == std::wstring::npos) break;
+        begin = nl + 1;
+    }
+    return sum;
+}
+
+void TestAgainstBrute() {
+    std::mt19937 rng(7);
+    ParagraphHeightCache cache(Measure, 5000); // piccola: si svuota spesso
+    for (int run = 0; run < 300; ++run) {
+        FitLayout layout;
+        std::wstring text;
+        int width = 100 + static_cast<int>(rng() % 400);
+        layout.SetWidth(width);
+        for (int step = 0; step < 200; ++step) {
+            const std::wstring before = text;
+            const int op = static_cast<int>(rng() % 10);
+            size_t pos = text.empty() ? 0 : rng() % (text.size() + 1);
+            if (op < 5) {
+                text.insert(pos, 1, L"ab \n\r"[rng() % 5]);
+            } else if (op < 7 && !text.empty()) {
+                if (pos == text.size()) --pos;
+                text.erase(pos, 1 + rng() % std::min<size_t>(5, text.size() - pos));
+            } else if (op == 7) {
+                text.insert(pos, L"\r\nhello world\r\n");
+            } else if (op == 8) {
+                width = 100 + static_cast<int>(rng() % 400);
+                layout.SetWidth(width);
+            }
+            if (step == 0 || rng() % 20 == 0) layout.SetText(text);
+            else layout.ApplyEdit(text, DiffTexts(before, text));
+
+            const int height = static_cast<int>(rng() % 800);
+            const int maxPx = kFontLadderPx[rng() % kFontLadderSize] + static_cast<int>(rng() % 3);
+            int expected = -1;
+            for (size_t s = 0; s < kFontLadderSize; ++s) {
+                if (kFontLadderPx[s] <= maxPx && BruteHeight(text, s, width) <= height) expected = static_cast<int>(s);
+            }
+            CHECK_EQ(layout.Fit(text, height, maxPx, cache), expected);
+            const size_t s = rng() % kFontLadderSize;
+            CHECK_EQ(layout.TotalHeight(text, s, cache), BruteHeight(text, s, width));
+        }
+    }
+}
+
+void TestDiff() {
+    TextEdit e = DiffTexts(L"abcdef", L"abXYef");
+    CHECK(e.at == 2 && e.removed == 2 && e.inserted == 2);
+    e = DiffTexts(L"aaa", L"aaaa"); // ripetizioni: l'inserimento sta in fondo, non si sovrappone
+    CHECK(e.at + e.inserted <= 4 && e.removed == 0 && e.inserted == 1);
+    e = DiffTexts(L"same", L"same");
+    CHECK(e.removed == 0 && e.inserted == 0);
+}
+
+void TestIncrementalMeasures() {
+    std::wstring text;
+    for (int i = 0; i < 2000; ++i) text += L"paragrafo numero " + std::to_wstring(i) + L"\r\n";
+    ParagraphHeightCache cache(Measure);
+    FitLayout layout;
+    layout.SetWidth(300);
+    layout.SetText(text);
+    CHECK(layout.Fit(text, 1 << 30, 64, cache) == static_cast<int>(kFontLadderSize) - 1);
+    const size_t first = cache.Measured();
+    CHECK(first >= 2000);
+
+    // un carattere in un paragrafo: una misura per dimensione chiesta, non 2000
+    const std::wstring before = text;
+    text.insert(text.size() / 2, 1, L'x');
+    layout.ApplyEdit(text, DiffTexts(before, text));
+    layout.Fit(text, 1 << 30, 64, cache);
+    CHECK(cache.Measured() - first <= kFontLadderSize);
+    CHECK_EQ(layout.ParagraphCount(), size_t{2001});
+}
+
+} // namespace
+
+int main() {
+    TestDiff();
+    TestIncrementalMeasures();
+    TestAgainstBrute();
+    return TestResult("test_autofit");
+}
@@ -0,0 +1,175 @@
+// TileGrid e MoveTileToward su board casuali senza sovrapposizioni, contro la forza bruta:
+// dopo ogni spostamento (con e senza spinta) o scambio nessuna sovrapposizione, tutte
+// dentro la board, griglia coerente con le mosse; se la tile non e' arrivata al bersaglio
+// il passo successivo e' davvero impossibile (ostacolo senza spinta, catena che uscirebbe
+// dalla board con la spinta). Query confrontata con un filtro su tutte le tile.
+
+#include "check.h"
+#include "collision.h"
+
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+using Board = std::map<uint64_t, CellRect>;
+
+bool Overlap(const CellRect& a, const CellRect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+bool Inside(const CellRect& r, int w, int h) { return r.x >= 0 && r.y >= 0 && r.x + r.w <= w && r.y + r.h <= h; }
+
+CellRect Shift(const CellRect& r, int dx, int dy) { return CellRect{r.x + dx, r.y + dy, r.w, r.h}; }
+
+// Un passo (dx, dy) di id e' possibile? Con push la catena delle tile colpite si sposta
+// tutta insieme e deve restare nella board.
+bool StepPossible(const Board& board, uint64_t id, int dx, int dy, bool push, int w, int h) {
+    std::vector<uint64_t> group{id};
+    std::set<uint64_t> inGroup{id};
+    for (size_t i = 0; i < group.size(); ++i) {
+        const CellRect next = Shift(board.at(group[i]), dx, dy);
+        if (!Inside(next, w, h)) return false;
+        for (const auto& [other, r] : board) {
+            if (inGroup.count(other) || !Overlap(next, r)) continue;
+            if (!push) return false;
+            inGroup.insert(other);
+            group.push_back(other);
+        }
+    }
+    return true;
+}
+
+void CheckBoard(const TileGrid& grid, const Board& board, int w, int h) {
+    for (const auto& [id, r] : board) {
+        CHECK(Inside(r, w, h));
+        const CellRect* g = grid.Rect(id);
+        CHECK(g && g->x == r.x && g->y == r.y && g->w == r.w && g->h == r.h);
+        for (const auto& [other, q] : board) {
+            if (other > id) CHECK(!Overlap(r, q));
+        }
+    }
+}
+
+void TestRandomMoves() {
+    std::mt19937 rng(4);
+    for (int round = 0; round < 400; ++round) {
+        const int w = 4 + static_cast<int>(rng() % 40);
+        const int h = 4 + static_cast<int>(rng() % 40);
+        Board board;
+        uint64_t nextId = 1;
+        for (int k = 0; k < 60; ++k) {
+            const CellRect r{static_cast<int>(rng() % w), static_cast<int>(rng() % h), 1 + static_cast<int>(rng() % 6),
+                             1 + static_cast<int>(rng() % 6)};
+            if (!Inside(r, w, h)) continue;
+            bool free = true;
+            for (const auto& [id, q] : board) free = free && !Overlap(r, q);
+            if (free) board[nextId++] = r;
+        }
+        if (board.size() < 2) continue;
+        TileGrid grid;
+        for (const auto& [id, r] : board) grid.Insert(id, r);
+
+        for (int move = 0; move < 30; ++move) {
+            auto pick = board.begin();
+            std::advance(pick, rng() % board.size());
+            const uint64_t id = pick->first;
+
+            if (rng() % 5 == 0) {
+                auto other = board.begin();
+                std::advance(other, rng() % board.size());
+                const CellRect a = board[id];
+                const CellRect b = other->second;
+                TileMoves swapped;
+                CHECK(SwapTiles(grid, id, other->first, swapped) == (id != other->first));
+                for (const auto& [m, r] : swapped) board[m] = r;
+                if (id != other->first) {
+                    CHECK_EQ(swapped.size(), size_t{2});
+                    CHECK(board[id].x == b.x && board[id].y == b.y && board[id].w == b.w && board[id].h == b.h);
+                    CHECK(board[other->first].x == a.x && board[other->first].y == a.y);
+                }
+                CheckBoard(grid, board, w, h);
+                continue;
+            }
+
+            const bool push = rng() % 2;
+            const int tx = static_cast<int>(rng() % w) - 2;
+            const int ty = static_cast<int>(rng() % h) - 2;
+            const Board before = board;
+            TileMoves moved;
+            MoveTileToward(grid, id, tx, ty, push, w, h, moved);
+            // le mosse vanno applicate in ordine: ogni passo sposta di una cella
+            for (const auto& [m, r] : moved) {
+                const CellRect& prev = board[m];
+                CHECK(std::abs(r.x - prev.x) + std::abs(r.y - prev.y) == 1);
+                CHECK(r.w == prev.w && r.h == prev.h);
+                board[m] = r;
+            }
+            if (!push) {
+                for (const auto& [m, r] : moved) CHECK_EQ(m, id);
+            }
+            CheckBoard(grid, board, w, h);
+
+            // fermata solo se bloccata davvero, su ciascun asse non raggiunto
+            const CellRect r = board[id];
+            const int dx = (tx > r.x) - (tx < r.x);
+            const int dy = (ty > r.y) - (ty < r.y);
+            if (dx) CHECK(!StepPossible(board, id, dx, 0, push, w, h));
+            if (dy) CHECK(!StepPossible(board, id, 0, dy, push, w, h));
+            if (moved.empty()) {
+                for (const auto& [m, q] : before) CHECK(board[m].x == q.x && board[m].y == q.y);
+            }
+
+            const CellRect query{static_cast<int>(rng() % w), static_cast<int>(rng() % h), 1 + static_cast<int>(rng() % 10),
+                                 1 + static_cast<int>(rng() % 10)};
+            std::vector<uint64_t> hits;
+            grid.Query(query, id, hits);
+            std::set<uint64_t> expected;
+            for (const auto& [m, q] : board) {
+                if (m != id && Overlap(q, query)) expected.insert(m);
+            }
+            CHECK(std::set<uint64_t>(hits.begin(), hits.end()) == expected);
+            CHECK_EQ(hits.size(), expected.size());
+        }
+    }
+}
+
+void TestDirected() {
+    // riga piena: la spinta verso destra si ferma al bordo, senza spinta la prima tile non si muove
+    TileGrid grid;
+    grid.Insert(1, {0, 0, 2, 1});
+    grid.Insert(2, {2, 0, 2, 1});
+    grid.Insert(3, {5, 0, 1, 1});
+    TileMoves moved;
+    MoveTileToward(grid, 1, 5, 0, false, 7, 1, moved);
+    CHECK(moved.empty());
+    MoveTileToward(grid, 1, 5, 0, true, 7, 1, moved);
+    CHECK_EQ(grid.Rect(1)->x, 2);
+    CHECK_EQ(grid.Rect(2)->x, 4);
+    CHECK_EQ(grid.Rect(3)->x, 6);
+
+    // tile inesistente e scambio con se stessa: niente mosse
+    moved.clear();
+    MoveTileToward(grid, 9, 0, 0, true, 7, 1, moved);
+    CHECK(!SwapTiles(grid, 1, 9, moved));
+    CHECK(!SwapTiles(grid, 1, 1, moved));
+    CHECK(moved.empty());
+
+    // una tile su piu' bucket compare una volta sola
+    grid.Clear();
+    grid.Insert(1, {0, 0, TileGrid::kBucketCells * 3, TileGrid::kBucketCells * 3});
+    std::vector<uint64_t> hits;
+    grid.Query({0, 0, TileGrid::kBucketCells * 4, TileGrid::kBucketCells * 4}, 0, hits);
+    CHECK_EQ(hits.size(), size_t{1});
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestRandomMoves();
+    return TestResult("test_collision");
+}
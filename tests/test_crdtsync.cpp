@@ -0,0 +1,210 @@
+// Convergenza di SyncDoc: repliche che modificano testo e geometria delle stesse tile e si
+// scambiano i log a pezzi, con duplicati; poi le righe di tutti i log consegnate in ordine
+// casuale (e ripetute) a una replica nuova. Alla fine testi e geometrie uguali ovunque e
+// nessun inserimento in attesa. SyncLog sulla cartella: righe a meta' lette solo quando
+// sono complete.
+
+#include "check.h"
+#include "crdtsync.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t kTiles = 4;
+
+struct Replica {
+    SyncDoc doc;
+    std::string log;
+    std::vector<size_t> seen; // byte gia' ricevuti dal log di ciascuna replica
+    explicit Replica(uint64_t id) : doc(id) {}
+};
+
+std::vector<std::string_view> Lines(std::string_view all) {
+    std::vector<std::string_view> out;
+    for (size_t begin = 0; begin < all.size();) {
+        const size_t nl = all.find('\n', begin);
+        out.push_back(all.substr(begin, nl - begin + 1));
+        begin = nl + 1;
+    }
+    return out;
+}
+
+bool SameState(const SyncDoc& a, const SyncDoc& b) {
+    for (uint64_t tile = 1; tile <= kTiles; ++tile) {
+        if (a.Text(tile) != b.Text(tile)) return false;
+        const SyncGeometry* ga = a.Geometry(tile);
+        const SyncGeometry* gb = b.Geometry(tile);
+        if (!ga != !gb || (ga && !(*ga == *gb))) return false;
+    }
+    return a.Tiles() == b.Tiles();
+}
+
+void TestConvergence() {
+    std::mt19937 rng(7);
+    for (int round = 0; round < 300; ++round) {
+        const int count = 2 + static_cast<int>(rng() % 3);
+        std::vector<Replica> replicas;
+        for (int i = 0; i < count; ++i) {
+            replicas.emplace_back(1000 + i * 77 + round);
+            replicas.back().seen.assign(count, 0);
+        }
+
+        // consegna di un prefisso di righe complete (o di tutto), a volte ripetendo da capo
+        auto deliver = [&](int to, int from, bool partial) {
+            const std::string& log = replicas[from].log;
+            size_t& offset = replicas[to].seen[from];
+            if (offset >= log.size()) return;
+            size_t end = log.size();
+            if (partial) {
+                end = offset + rng() % (log.size() - offset + 1);
+                const size_t nl = log.rfind('\n', end ? end - 1 : 0);
+                if (nl == std::string::npos || nl < offset) return;
+                end = nl + 1;
+            }
+            std::unordered_set<uint64_t> touched;
+            replicas[to].doc.Apply(std::string_view(log).substr(offset, end - offset), touched);
+            if (rng() % 5 == 0) replicas[to].doc.Apply(std::string_view(log).substr(0, end), touched);
+            offset = end;
+        };
+
+        for (int step = 0; step < 150; ++step) {
+            const int r = static_cast<int>(rng() % count);
+            Replica& me = replicas[r];
+            const int kind = static_cast<int>(rng() % 10);
+            const uint64_t tile = 1 + rng() % kTiles;
+            if (kind < 6) {
+                std::u32string text = me.doc.Text(tile);
+                const size_t at = text.empty() ? 0 : rng() % (text.size() + 1);
+                const size_t removed = std::min<size_t>(text.size() - at, rng() % 3);
+                std::u32string inserted;
+                for (int k = static_cast<int>(rng() % 4); k > 0; --k) {
+                    inserted += rng() % 7 == 0 ? static_cast<char32_t>(0x1F600 + rng() % 5)
+                                : rng() % 9 == 0 ? U'\n'
+                                                 : static_cast<char32_t>(U'a' + rng() % 26);
+                }
+                text.replace(at, removed, inserted);
+                std::string out;
+                me.doc.SetText(tile, text, out);
+                CHECK(me.doc.Text(tile) == text);
+                me.log += out;
+            } else if (kind < 8) {
+                const SyncGeometry g{static_cast<int>(rng() % 10), static_cast<int>(rng() % 10), 1 + static_cast<int>(rng() % 5),
+                                     1 + static_cast<int>(rng() % 5), rng() % 2 == 0, rng() % 6 == 0};
+                std::string out;
+                me.doc.SetGeometry(tile, g, out);
+                me.log += out;
+            } else {
+                const int from = static_cast<int>(rng() % count);
+                if (from != r) deliver(r, from, true);
+            }
+        }
+        for (int a = 0; a < count; ++a) {
+            for (int b = 0; b < count; ++b) {
+                if (a != b) deliver(a, b, false);
+            }
+        }
+        for (int a = 0; a < count; ++a) {
+            CHECK(SameState(replicas[a].doc, replicas[0].doc));
+            CHECK_EQ(replicas[a].doc.Waiting(), size_t{0});
+        }
+
+        // tutte le righe, mescolate e in parte ripetute, a una replica che non ha visto nulla
+        std::vector<std::string_view> lines;
+        for (const Replica& rep : replicas) {
+            for (std::string_view line : Lines(rep.log)) {
+                lines.push_back(line);
+                if (rng() % 4 == 0) lines.push_back(line);
+            }
+        }
+        std::shuffle(lines.begin(), lines.end(), rng);
+        SyncDoc late(999);
+        std::unordered_set<uint64_t> touched;
+        for (std::string_view line : lines) late.Apply(line, touched);
+        CHECK(SameState(late, replicas[0].doc));
+        CHECK_EQ(late.Waiting(), size_t{0});
+    }
+}
+
+void TestLocalEdits() {
+    SyncDoc doc(1);
+    std::string log;
+    doc.SetText(7, U"ciao", log);
+    CHECK(!log.empty());
+    const size_t size = log.size();
+    doc.SetText(7, U"ciao", log); // niente di cambiato: niente righe
+    CHECK_EQ(log.size(), size);
+    doc.SetGeometry(7, SyncGeometry{1, 2, 3, 4, false, false}, log);
+    CHECK(doc.Tiles() == std::vector<uint64_t>{7});
+    doc.SetGeometry(7, SyncGeometry{1, 2, 3, 4, false, true}, log);
+    CHECK(doc.Tiles().empty()); // rimossa
+
+    std::unordered_set<uint64_t> touched;
+    SyncDoc other(2);
+    other.Apply("riga illeggibile\n", touched);
+    other.Apply(log, touched);
+    CHECK(other.Text(7) == U"ciao");
+    CHECK(touched.count(7));
+
+    const std::wstring wide = L"a\U0001F600è";
+    CHECK(WideToCodepoints(wide) == U"a\U0001F600è");
+    CHECK(CodepointsToWide(WideToCodepoints(wide)) == wide);
+}
+
+void TestSyncLog() {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / ("gridnotes-sync-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(dir);
+    SyncLog logA, logB;
+    CHECK(logA.Open(dir, 0xA1));
+    CHECK(logB.Open(dir, 0xB2));
+    SyncDoc a(0xA1), b(0xB2);
+    std::unordered_set<uint64_t> touched;
+    a.Apply(logA.ReadNew(), touched);
+    b.Apply(logB.ReadNew(), touched);
+
+    std::string lines;
+    a.SetGeometry(1, SyncGeometry{0, 0, 2, 2, false, false}, lines);
+    a.SetText(1, U"ciao", lines);
+    CHECK(logA.Append(lines));
+    lines.clear();
+    b.SetText(1, U"xy", lines);
+    CHECK(logB.Append(lines));
+
+    // un terzo dispositivo con una riga ancora a meta' (sync in corso)
+    std::string third;
+    SyncDoc c(0xC3);
+    c.SetGeometry(1, SyncGeometry{9, 9, 1, 1, false, false}, third);
+    {
+        std::ofstream f(dir / "c3.ops", std::ios::binary | std::ios::app);
+        f << third.substr(0, third.size() - 1);
+    }
+    touched.clear();
+    a.Apply(logA.ReadNew(), touched);
+    b.Apply(logB.ReadNew(), touched);
+    CHECK_EQ(a.Geometry(1)->x, 0);
+    {
+        std::ofstream f(dir / "c3.ops", std::ios::binary | std::ios::app);
+        f << "\n";
+    }
+    a.Apply(logA.ReadNew(), touched);
+    b.Apply(logB.ReadNew(), touched);
+    CHECK(a.Text(1) == b.Text(1));
+    CHECK_EQ(a.Text(1).size(), size_t{6});
+    CHECK(a.Geometry(1) && b.Geometry(1) && a.Geometry(1)->x == 9 && b.Geometry(1)->x == 9);
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+int main() {
+    TestLocalEdits();
+    TestConvergence();
+    TestSyncLog();
+    return TestResult("test_crdtsync");
+}
@@ -0,0 +1,199 @@
+// FormulaEngine: casi noti (riferimenti per id e per nome, funzioni, errori), la tile
+// citata prima di esistere, la precedenza degli errori indipendente dall'ordine delle
+// modifiche, e il confronto principale: dopo ogni Recalculate incrementale il risultato
+// di ogni formula e' quello di un motore nuovo che riceve gli stessi testi (in ordine
+// casuale) e ricalcola tutto; le formule che cambiano sono tutte nella lista ritornata.
+
+#include "check.h"
+#include "formula.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+#define CHECK_SHOW(engine, id, want) CHECK((engine).Display(id) == std::wstring(want))
+
+void TestDirected() {
+    FormulaEngine e;
+    e.SetTile(1, L"spese\r\n12,50 pane\r\n1.234,50 affitto\r\n-3 rimborso");
+    e.SetTile(2, L"=#1");
+    e.SetTile(3, L"=somma([Spese]; 10) * 2");
+    e.SetTile(4, L"=#2 + #3");
+    e.SetTile(5, L"=media(#1)");
+    e.SetTile(6, L"=#7");
+    e.SetTile(7, L"=#6+1");
+    e.SetTile(8, L"=1/0");
+    e.SetTile(9, L"=#99");
+    e.SetTile(10, L"=1+");
+    e.SetTile(11, L"=[nessuno]");
+    e.SetTile(12, L"=arrotonda(2/3; 2) + max(1,5,3) + conta(#1) + abs(-2) + 2^3");
+    e.SetTile(13, L"42");
+    e.SetTile(14, L"=#13*2 + #8");
+    e.SetTile(15, L"=#16");
+    e.SetTile(16, L"=#16");
+    e.Recalculate();
+    CHECK_SHOW(e, 2, L"1244");
+    CHECK_SHOW(e, 3, L"2508");
+    CHECK_SHOW(e, 4, L"3752");
+    CHECK_SHOW(e, 5, L"414.6666667");
+    CHECK_SHOW(e, 6, L"#ciclo");
+    CHECK_SHOW(e, 7, L"#ciclo");
+    CHECK_SHOW(e, 8, L"#div/0");
+    CHECK_SHOW(e, 9, L"#rif?");
+    CHECK_SHOW(e, 10, L"#sintassi");
+    CHECK_SHOW(e, 11, L"#nome?");
+    CHECK_SHOW(e, 12, L"18.67");
+    CHECK_SHOW(e, 14, L"#div/0");
+    CHECK_SHOW(e, 15, L"#ciclo"); // a valle di un ciclo su se stessa
+    CHECK_SHOW(e, 16, L"#ciclo");
+    CHECK(e.Display(13).empty());
+
+    e.SetTile(1, L"spese\r\n10");
+    CHECK_EQ(e.Recalculate().size(), size_t{5}); // 2, 3, 4, 5 e 12 (conta(#1))
+    CHECK_SHOW(e, 4, L"50");
+    e.SetTile(7, L"5");
+    e.Recalculate();
+    CHECK_SHOW(e, 6, L"5");
+    e.SetTile(99, L"7");
+    e.Recalculate();
+    CHECK_SHOW(e, 9, L"7");
+    e.RemoveTile(99);
+    e.Recalculate();
+    CHECK_SHOW(e, 9, L"#rif?");
+    e.SetTile(20, L"SPESE  \r\n5");
+    e.Recalculate();
+    CHECK_SHOW(e, 3, L"50");
+    e.SetTile(8, L"=0");
+    e.Recalculate();
+    CHECK_SHOW(e, 14, L"84");
+
+    // stessa formula in piu' tile: analizzata una volta
+    const size_t parses = e.Parses();
+    e.SetTile(30, L"=#13 + 1");
+    e.SetTile(31, L"=#13 + 1");
+    CHECK_EQ(e.Parses(), parses + 1);
+}
+
+void TestLateReference() {
+    // la tile citata nasce dopo la formula, e il suo primo risultato e' 0
+    FormulaEngine e;
+    e.SetTile(1, L"=#6+1");
+    e.SetTile(3, L"ciao");
+    e.Recalculate();
+    CHECK_SHOW(e, 1, L"#rif?");
+    e.SetTile(6, L"=#3*2");
+    const std::vector<uint64_t> changed = e.Recalculate();
+    CHECK_SHOW(e, 6, L"0");
+    CHECK_SHOW(e, 1, L"1");
+    CHECK(std::count(changed.begin(), changed.end(), 1) == 1);
+
+    // una tile di testo nuova, citata prima di esistere
+    e.SetTile(2, L"=#8");
+    e.Recalculate();
+    e.SetTile(8, L"nota senza numeri");
+    e.Recalculate();
+    CHECK_SHOW(e, 2, L"0");
+
+    // una tile di testo che diventa formula con lo stesso valore
+    e.SetTile(4, L"=#5");
+    e.SetTile(5, L"titolo");
+    e.Recalculate();
+    e.SetTile(5, L"=[nessuno]");
+    e.Recalculate();
+    CHECK_SHOW(e, 4, L"#nome?");
+}
+
+void TestErrorPrecedence() {
+    // a valle di un ciclo, con un altro errore nella stessa formula: conta la formula,
+    // non se il ciclo e' nato prima o dopo
+    const std::vector<std::pair<uint64_t, std::wstring>> texts{
+        {1, L"=#2"}, {2, L"=#1"}, {3, L"=[nessuno] + #1"}, {4, L"=#1 + [nessuno]"}, {5, L"=#3"}};
+    std::vector<size_t> order{0, 1, 2, 3, 4};
+    std::map<uint64_t, std::wstring> first;
+    do {
+        FormulaEngine e;
+        // meta' dei testi, ricalcolo, poi il resto: l'ordine delle modifiche cambia davvero
+        for (size_t i = 0; i < order.size(); ++i) {
+            e.SetTile(texts[order[i]].first, texts[order[i]].second);
+            if (i == 2) e.Recalculate();
+        }
+        e.Recalculate();
+        for (const auto& [id, text] : texts) {
+            if (first.size() < texts.size()) first[id] = e.Display(id);
+            CHECK(e.Display(id) == first[id]);
+        }
+    } while (std::next_permutation(order.begin(), order.end()));
+    CHECK(first[1] == L"#ciclo" && first[2] == L"#ciclo");
+    CHECK(first[3] == L"#nome?" && first[5] == L"#nome?");
+    CHECK(first[4] == L"#ciclo");
+}
+
+std::wstring RandomText(std::mt19937& rng, int tiles) {
+    auto ref = [&] { return L"#" + std::to_wstring(1 + rng() % tiles); };
+    switch (rng() % 12) {
+        case 0: return L"voce\r\n" + std::to_wstring(rng() % 100);
+        case 1: return L"spese\r\n" + std::to_wstring(rng() % 50) + L",5";
+        case 2: return L"nota senza numeri";
+        case 3: return std::to_wstring(rng() % 9);
+        case 4: return L"=" + ref() + L" + " + ref();
+        case 5: return L"=somma([spese]; " + ref() + L")";
+        case 6: return L"=" + ref() + L" * 2";
+        case 7: return L"=[nessuno] + " + ref();
+        case 8: return L"=1 / " + ref();
+        case 9: return L"=media([voce]) - " + ref();
+        case 10: return L"=max(" + ref() + L"; " + ref() + L"; 3)";
+        default: return L"=1+";
+    }
+}
+
+void TestIncrementalVsFresh() {
+    constexpr int kTiles = 12;
+    std::mt19937 rng(42);
+    for (int run = 0; run < 400; ++run) {
+        FormulaEngine engine;
+        std::map<uint64_t, std::wstring> texts;
+        std::map<uint64_t, std::wstring> shown;
+        for (int step = 0; step < 60; ++step) {
+            const uint64_t id = 1 + rng() % kTiles;
+            if (rng() % 8 == 0) {
+                engine.RemoveTile(id);
+                texts.erase(id);
+            } else {
+                texts[id] = RandomText(rng, kTiles);
+                engine.SetTile(id, texts[id]);
+            }
+            if (rng() % 3) continue;
+
+            const std::vector<uint64_t> changed = engine.Recalculate();
+            const std::set<uint64_t> changedSet(changed.begin(), changed.end());
+
+            std::vector<std::pair<uint64_t, std::wstring>> shuffled(texts.begin(), texts.end());
+            std::shuffle(shuffled.begin(), shuffled.end(), rng);
+            FormulaEngine fresh;
+            for (const auto& [tid, text] : shuffled) fresh.SetTile(tid, text);
+            fresh.Recalculate();
+
+            for (uint64_t tid = 1; tid <= kTiles; ++tid) {
+                const std::wstring now = engine.Display(tid);
+                CHECK(now == fresh.Display(tid));
+                if (engine.IsFormula(tid) && shown[tid] != now) CHECK(changedSet.count(tid));
+                shown[tid] = now;
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestLateReference();
+    TestErrorPrecedence();
+    TestIncrementalVsFresh();
+    return TestResult("test_formula");
+}
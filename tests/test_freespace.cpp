@@ -0,0 +1,147 @@
+// FreeSpaceIndex contro la forza bruta su board casuali, dopo ogni aggiunta o rimozione:
+// area del rettangolo vuoto massimo, primo posto libero w x h in ordine di lettura,
+// rettangolo massimo attorno a una cella. Tile sovrapposte comprese (contatore per cella).
+
+#include "check.h"
+#include "freespace.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Grid {
+    int w{0};
+    int h{0};
+    std::vector<int> cells;
+
+    void Add(const CellRect& r, int delta) {
+        for (int y = r.y; y < r.y + r.h; ++y) {
+            for (int x = r.x; x < r.x + r.w; ++x) cells[y * w + x] += delta;
+        }
+    }
+    bool Free(int x, int y, int rw, int rh) const {
+        for (int j = y; j < y + rh; ++j) {
+            for (int i = x; i < x + rw; ++i) {
+                if (cells[j * w + i]) return false;
+            }
+        }
+        return true;
+    }
+    bool Free(const CellRect& r) const { return Free(r.x, r.y, r.w, r.h); }
+};
+
+void CheckAgainstBrute(const FreeSpaceIndex& index, const Grid& g, std::mt19937& rng) {
+    for (int y = 0; y < g.h; ++y) {
+        for (int x = 0; x < g.w; ++x) CHECK(index.IsFree(x, y) == (g.cells[y * g.w + x] == 0));
+    }
+
+    long best = 0;
+    for (int y = 0; y < g.h; ++y) {
+        for (int x = 0; x < g.w; ++x) {
+            for (int h = 1; y + h <= g.h; ++h) {
+                for (int w = 1; x + w <= g.w; ++w) {
+                    if (g.Free(x, y, w, h)) best = std::max(best, static_cast<long>(w) * h);
+                }
+            }
+        }
+    }
+    CellRect out;
+    const bool found = index.LargestEmpty(out);
+    CHECK_EQ(found ? static_cast<long>(out.w) * out.h : 0L, best);
+    if (found) CHECK(g.Free(out));
+
+    const int qw = 1 + static_cast<int>(rng() % 4);
+    const int qh = 1 + static_cast<int>(rng() % 4);
+    bool expected = false;
+    CellRect first{};
+    for (int y = 0; y + qh <= g.h && !expected; ++y) {
+        for (int x = 0; x + qw <= g.w && !expected; ++x) {
+            if (g.Free(x, y, qw, qh)) {
+                expected = true;
+                first = {x, y, qw, qh};
+            }
+        }
+    }
+    CHECK(index.FirstEmpty(qw, qh, out) == expected);
+    if (expected) {
+        CHECK_EQ(out.x, first.x);
+        CHECK_EQ(out.y, first.y);
+    }
+
+    const int px = static_cast<int>(rng() % g.w);
+    const int py = static_cast<int>(rng() % g.h);
+    long around = 0;
+    for (int y = 0; y <= py; ++y) {
+        for (int x = 0; x <= px; ++x) {
+            for (int h = py - y + 1; y + h <= g.h; ++h) {
+                for (int w = px - x + 1; x + w <= g.w; ++w) {
+                    if (g.Free(x, y, w, h)) around = std::max(around, static_cast<long>(w) * h);
+                }
+            }
+        }
+    }
+    const bool at = index.EmptyRegionAt(px, py, out);
+    CHECK_EQ(at ? static_cast<long>(out.w) * out.h : 0L, around);
+    if (at) {
+        CHECK(g.Free(out));
+        CHECK(px >= out.x && px < out.x + out.w && py >= out.y && py < out.y + out.h);
+    }
+}
+
+void TestRandom() {
+    std::mt19937 rng(1);
+    for (int board = 0; board < 300; ++board) {
+        Grid g;
+        g.w = 1 + static_cast<int>(rng() % 20);
+        g.h = 1 + static_cast<int>(rng() % 20);
+        g.cells.assign(g.w * g.h, 0);
+        FreeSpaceIndex index;
+        index.Reset(g.w, g.h);
+        std::vector<CellRect> placed;
+        for (int op = 0; op < 40; ++op) {
+            if (!placed.empty() && rng() % 3 == 0) {
+                const size_t k = rng() % placed.size();
+                index.Release(placed[k]);
+                g.Add(placed[k], -1);
+                placed.erase(placed.begin() + k);
+            } else {
+                CellRect r{static_cast<int>(rng() % g.w), static_cast<int>(rng() % g.h), 1 + static_cast<int>(rng() % 5),
+                           1 + static_cast<int>(rng() % 5)};
+                r.w = std::min(r.w, g.w - r.x);
+                r.h = std::min(r.h, g.h - r.y);
+                index.Occupy(r);
+                g.Add(r, +1);
+                placed.push_back(r);
+            }
+            CheckAgainstBrute(index, g, rng);
+        }
+    }
+}
+
+void TestDirected() {
+    FreeSpaceIndex index;
+    index.Reset(4, 3);
+    CellRect out;
+    CHECK(index.LargestEmpty(out));
+    CHECK(out.x == 0 && out.y == 0 && out.w == 4 && out.h == 3);
+
+    index.Occupy({0, 0, 4, 3});
+    CHECK(!index.LargestEmpty(out));
+    CHECK(!index.FirstEmpty(1, 1, out));
+    CHECK(!index.EmptyRegionAt(2, 1, out));
+
+    index.Move({0, 0, 4, 3}, {0, 0, 4, 1});
+    CHECK(index.FirstEmpty(4, 2, out));
+    CHECK(out.x == 0 && out.y == 1);
+    CHECK(!index.FirstEmpty(4, 3, out));
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestRandom();
+    return TestResult("test_freespace");
+}
@@ -0,0 +1,205 @@
+// Cronologia a chunk indirizzati per contenuto: vettori noti di SHA-256, ChunkStore
+// (dedup, chunk rovinato rifiutato, Sweep), istantanee di 5000 tile che crescono sul disco
+// solo per i byte cambiati, Load e DiffSnapshots, riavvio senza doppioni, Prune per fasce
+// d'eta' e CollectGarbage che non toglie niente di ancora raggiungibile.
+
+#include "check.h"
+#include "history.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int64_t kDay = 86400;
+
+uint64_t DirBytes(const fs::path& dir) {
+    uint64_t total = 0;
+    for (const auto& e : fs::recursive_directory_iterator(dir)) {
+        if (e.is_regular_file()) total += e.file_size();
+    }
+    return total;
+}
+
+size_t FileCount(const fs::path& dir) {
+    size_t n = 0;
+    for (const auto& e : fs::recursive_directory_iterator(dir)) n += e.is_regular_file();
+    return n;
+}
+
+fs::path TempDir(const char* name) {
+    const fs::path dir = fs::temp_directory_path() / ("gridnotes-" + std::string(name) + "-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    return dir;
+}
+
+void TestSha256() {
+    CHECK(Sha256Hex("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(Sha256Hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK(Sha256Hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    CHECK(Sha256Hex(std::string(1000000, 'a')) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    // a pezzi di lunghezza qualunque come in un colpo solo
+    const std::string data(1000, 'q');
+    Sha256 h;
+    for (size_t at = 0, step = 1; at < data.size(); at += step, step = step % 70 + 1) h.Update(data.data() + at, std::min(step, data.size() - at));
+    const auto digest = h.Finish();
+    std::string hex;
+    for (uint8_t b : digest) {
+        static const char* digits = "0123456789abcdef";
+        hex += digits[b >> 4];
+        hex += digits[b & 15];
+    }
+    CHECK(hex == Sha256Hex(data));
+}
+
+void TestChunkStore() {
+    const fs::path dir = TempDir("chunks");
+    ChunkStore store;
+    store.Open(dir);
+    const std::string a = store.Put("prima nota");
+    CHECK(a == Sha256Hex("prima nota"));
+    CHECK(store.Put("prima nota") == a);
+    const std::string b = store.Put("seconda nota");
+    CHECK_EQ(FileCount(dir), size_t{2});
+
+    std::string bytes;
+    CHECK(store.Get(a, bytes) && bytes == "prima nota");
+    CHECK(!store.Get("zz", bytes));
+    CHECK(!store.Get(Sha256Hex("mai scritta"), bytes));
+
+    // contenuto che non corrisponde piu' all'hash: rifiutato, niente testo sbagliato
+    {
+        std::ofstream f(dir / b.substr(0, 2) / b.substr(2), std::ios::binary | std::ios::trunc);
+        f << "seconda n0ta";
+    }
+    CHECK(!store.Get(b, bytes));
+    CHECK(bytes.empty());
+
+    CHECK_EQ(store.Sweep({a}), size_t{1});
+    CHECK(store.Get(a, bytes));
+    CHECK_EQ(FileCount(dir), size_t{1});
+    fs::remove_all(dir);
+}
+
+void TestHistory() {
+    const fs::path dir = TempDir("history");
+    constexpr int kTiles = 5000;
+    std::mt19937 rng(1);
+    std::vector<HistoryTile> tiles;
+    std::unordered_map<uint64_t, std::string> texts;
+    for (int i = 0; i < kTiles; ++i) {
+        HistoryTile t;
+        t.id = static_cast<uint64_t>(i + 1);
+        t.x = (i % 100) * 4;
+        t.y = (i / 100) * 4;
+        t.w = t.h = 4;
+        tiles.push_back(t);
+        texts[t.id] = "nota " + std::to_string(i) + " " + std::string(rng() % 200, 'x');
+    }
+
+    History history;
+    CHECK(history.Open(dir));
+    HistorySnapshot snap;
+    snap.time = 1000;
+    snap.tiles = tiles;
+    snap.columns = {{3, 80}};
+    CHECK(history.Take(snap, texts));
+    const uint64_t first = DirBytes(dir);
+
+    // dieci testi e una posizione: il disco cresce di poco, non di un'altra board intera
+    std::unordered_map<uint64_t, std::string> changed;
+    for (int k = 0; k < 10; ++k) {
+        const uint64_t id = 1 + rng() % kTiles;
+        texts[id] += " modificata";
+        changed[id] = texts[id];
+    }
+    tiles[5].x += 1;
+    snap.tiles = tiles;
+    snap.time = 2000;
+    CHECK(history.Take(snap, changed));
+    const uint64_t delta = DirBytes(dir) - first;
+    CHECK(delta < first / 10);
+
+    snap.time = 3000;
+    CHECK(!history.Take(snap, {})); // niente di nuovo: nessuna istantanea
+    const std::vector<int64_t> times = history.List();
+    CHECK(times == (std::vector<int64_t>{1000, 2000}));
+
+    HistorySnapshot before, after;
+    CHECK(history.Load(1000, before));
+    CHECK(history.Load(2000, after));
+    CHECK_EQ(after.tiles.size(), size_t{kTiles});
+    CHECK(after.columns == snap.columns);
+    size_t textChanges = 0, moves = 0;
+    for (const HistoryChange& c : DiffSnapshots(before, after)) {
+        textChanges += c.text;
+        moves += c.moved;
+        CHECK(!c.added && !c.removed);
+    }
+    CHECK_EQ(textChanges, changed.size());
+    CHECK_EQ(moves, size_t{1});
+    for (const HistoryTile& t : after.tiles) {
+        std::string text;
+        CHECK(history.Text(t.textHash, text) && text == texts[t.id]);
+    }
+
+    // riavvio con gli stessi testi: nessun doppione
+    History reopened;
+    CHECK(reopened.Open(dir));
+    CHECK(!reopened.Take(snap, texts));
+
+    // Prune: nell'ultimo giorno tutte, tra 1 e 30 giorni una per ora, oltre una al giorno
+    const int64_t now = 400 * kDay;
+    std::unordered_map<uint64_t, std::string> one;
+    // in ordine: i tempi delle istantanee crescono sempre
+    for (int64_t t : {now - 60 * kDay - 100, now - 60 * kDay - 50, now - 2 * kDay - 100, now - 2 * kDay - 50, now - 100,
+                      now - 50}) {
+        snap.time = t;
+        snap.tiles[0].x = static_cast<int>(t % 1000); // ogni istantanea diversa dalla precedente
+        one[1] = "testo " + std::to_string(t);
+        CHECK(reopened.Take(snap, one));
+    }
+    const size_t beforePrune = reopened.List().size();
+    const size_t pruned = reopened.Prune(now);
+    CHECK_EQ(pruned, size_t{3}); // 1000/2000 nella stessa settimana, poi stesso giorno, stessa ora
+    const std::vector<int64_t> left = reopened.List();
+    CHECK_EQ(left.size(), beforePrune - pruned);
+    CHECK(std::count(left.begin(), left.end(), now - 100) == 1);
+    CHECK(std::count(left.begin(), left.end(), now - 50) == 1);
+
+    // CollectGarbage nel thread della cronologia: ogni istantanea rimasta si carica per intero
+    reopened.Start();
+    size_t collected = 0;
+    reopened.Post([&](History& h) { collected = h.CollectGarbage(); });
+    reopened.Stop();
+    CHECK(collected > 0);
+    for (int64_t t : reopened.List()) {
+        HistorySnapshot s;
+        CHECK(reopened.Load(t, s));
+        CHECK_EQ(s.tiles.size(), size_t{kTiles});
+        for (const HistoryTile& tile : s.tiles) {
+            std::string text;
+            CHECK(reopened.Text(tile.textHash, text));
+        }
+    }
+    fs::remove_all(dir);
+}
+
+} // namespace
+
+int main() {
+    TestSha256();
+    TestChunkStore();
+    TestHistory();
+    return TestResult("test_history");
+}
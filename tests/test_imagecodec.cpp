@@ -0,0 +1,396 @@
+// Codec delle immagini. PNG costruiti qui con tutti i tipi di colore e le profondita',
+// filtri a caso, interlacciati o no, tRNS e IDAT spezzati (deflate a blocchi non
+// compressi: l'encoder di riferimento e' questo file), piu' un PNG compresso da zlib per
+// i blocchi Huffman; BMP a 8, 24 e 32 bit dagli stessi pixel. Ogni file si decodifica
+// nei pixel attesi, intero e a righe, e torna uguale da EncodePng. File troncati o con
+// byte cambiati non fanno danni; miniature della misura giusta e composte sul fondo.
+
+#include "check.h"
+#include "imagecodec.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 32 x 20 RGBA, filtro 0, compresso da zlib al livello 9: vedi ZlibPixel
+const unsigned char kZlibPng[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00,
+    0x00, 0x20, 0x00, 0x00, 0x00, 0x14, 0x08, 0x06, 0x00, 0x00, 0x00, 0xec, 0x91, 0x3f, 0x4f, 0x00, 0x00, 0x01,
+    0x4e, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0xed, 0xd1, 0x31, 0xb1, 0x04, 0x31, 0x0c, 0x03, 0x50, 0x23, 0x49,
+    0x6d, 0x10, 0x46, 0x12, 0x24, 0x2e, 0x83, 0x62, 0x91, 0x18, 0xc9, 0x12, 0xda, 0xaf, 0xd8, 0xb9, 0xbf, 0x1e,
+    0x51, 0xb8, 0x2b, 0x34, 0x52, 0xf7, 0x32, 0x8e, 0x88, 0xe8, 0x23, 0xb2, 0x4e, 0xf4, 0x19, 0xe8, 0x4a, 0x6d,
+    0xcb, 0xe8, 0xe9, 0xf5, 0x4c, 0xec, 0x99, 0x5d, 0xdb, 0xd1, 0x95, 0xda, 0x57, 0x46, 0x4f, 0xaf, 0x27, 0x44,
+    0x57, 0xc8, 0x3a, 0xd1, 0x75, 0xa3, 0x2b, 0xb5, 0xa5, 0xe3, 0x42, 0xf8, 0x20, 0xdc, 0x08, 0x9f, 0x84, 0x3b,
+    0xe1, 0x7b, 0x77, 0x3c, 0x08, 0x6f, 0x0f, 0x78, 0xaf, 0x30, 0xe8, 0x0a, 0x46, 0x57, 0x98, 0x74, 0x05, 0xa7,
+    0x2b, 0x5c, 0x74, 0x85, 0x8e, 0x07, 0xe1, 0x7b, 0xcb, 0xef, 0x0b, 0xc4, 0x80, 0x1b, 0xf0, 0x6c, 0xa0, 0xd8,
+    0x23, 0xbb, 0xb6, 0xa1, 0x2b, 0xb5, 0x67, 0x46, 0x4f, 0x03, 0xc5, 0xf6, 0xec, 0xda, 0x17, 0xba, 0x52, 0x3b,
+    0x0c, 0xb8, 0x01, 0xcf, 0x06, 0x8a, 0x7d, 0x67, 0xd7, 0x96, 0x8e, 0x0b, 0xe1, 0x83, 0x70, 0x23, 0x7c, 0x12,
+    0xee, 0x84, 0xd7, 0x03, 0x5e, 0x3c, 0x08, 0xdf, 0x2d, 0x1d, 0x17, 0xc2, 0x07, 0xe1, 0x46, 0xf8, 0x24, 0xdc,
+    0x09, 0xdf, 0xbb, 0xe3, 0x41, 0x78, 0x7b, 0xc0, 0x57, 0x7f, 0x81, 0x03, 0xce, 0x68, 0xf6, 0xc8, 0xe8, 0x69,
+    0xa0, 0xd8, 0x96, 0x5d, 0x7b, 0xa2, 0x2b, 0xb5, 0x3d, 0xa3, 0xa7, 0x81, 0x62, 0x5f, 0xd9, 0xb5, 0xc3, 0x01,
+    0x67, 0x34, 0xfb, 0xce, 0xe8, 0xe9, 0xff, 0x07, 0xe8, 0xf3, 0x79, 0x48, 0xc7, 0x07, 0xe1, 0x46, 0xf8, 0x24,
+    0xdc, 0x09, 0xdf, 0xdd, 0xf1, 0x20, 0x7c, 0x6f, 0xe9, 0xb8, 0x10, 0x3e, 0x08, 0x37, 0xc2, 0x27, 0xe1, 0x4e,
+    0x78, 0x3d, 0xe0, 0xc5, 0x83, 0xf0, 0x76, 0x81, 0xaf, 0xfe, 0x82, 0x00, 0x1e, 0xeb, 0x04, 0x38, 0xba, 0x52,
+    0xdb, 0x32, 0x7a, 0x1a, 0x28, 0xf6, 0xcc, 0xae, 0xed, 0xe8, 0x4a, 0xed, 0x2b, 0xa3, 0xa7, 0xf1, 0x80, 0x00,
+    0x1e, 0xeb, 0x04, 0x38, 0xba, 0x52, 0x5b, 0x3a, 0x2e, 0x84, 0x0f, 0xc2, 0x8d, 0xf0, 0x49, 0xb8, 0x13, 0xbe,
+    0x77, 0xc7, 0x83, 0xf0, 0xf6, 0x80, 0xf7, 0x0a, 0x83, 0xae, 0x60, 0x74, 0x85, 0x49, 0x57, 0x70, 0xba, 0xc2,
+    0x45, 0x57, 0xe8, 0x78, 0x10, 0xbe, 0xf7, 0xef, 0x0b, 0xfe, 0x00, 0x62, 0xcf, 0x0c, 0xb4, 0x95, 0xc3, 0xc0,
+    0xa5, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82
+};
+
+std::array<uint8_t, 4> ZlibPixel(int x, int y) {
+    return {static_cast<uint8_t>((x / 4) * 30), static_cast<uint8_t>((y / 5) * 60), static_cast<uint8_t>((x + y) % 3 ? 128 : 40),
+            static_cast<uint8_t>(x < 24 ? 255 : 128)};
+}
+
+uint32_t Crc32(const std::string& bytes) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t c = 0xFFFFFFFFu;
+    for (unsigned char b : bytes) c = table[(c ^ b) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+void PutBe32(std::string& out, uint32_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8) out += static_cast<char>(v >> shift);
+}
+
+void PutLe(std::string& out, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out += static_cast<char>(v >> (8 * i));
+}
+
+std::string Chunk(const char* type, const std::string& data) {
+    std::string out;
+    PutBe32(out, static_cast<uint32_t>(data.size()));
+    const std::string body = type + data;
+    out += body;
+    PutBe32(out, Crc32(body));
+    return out;
+}
+
+// zlib con soli blocchi non compressi
+std::string ZlibStored(const std::string& raw) {
+    std::string out = "\x78\x01";
+    size_t at = 0;
+    do {
+        const size_t n = std::min<size_t>(raw.size() - at, 65535);
+        out += static_cast<char>(at + n == raw.size() ? 1 : 0);
+        PutLe(out, static_cast<uint32_t>(n), 2);
+        PutLe(out, static_cast<uint32_t>(~n & 0xFFFF), 2);
+        out.append(raw, at, n);
+        at += n;
+    } while (at < raw.size());
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    PutBe32(out, b << 16 | a);
+    return out;
+}
+
+int Paeth(int a, int b, int c) {
+    const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+std::string FilterRows(const std::vector<std::string>& rows, size_t bpp, std::mt19937& rng) {
+    std::string out;
+    std::string prev(rows.empty() ? 0 : rows[0].size(), '\0');
+    for (const std::string& row : rows) {
+        const int type = static_cast<int>(rng() % 5);
+        out += static_cast<char>(type);
+        for (size_t i = 0; i < row.size(); ++i) {
+            const int a = i >= bpp ? static_cast<uint8_t>(row[i - bpp]) : 0;
+            const int b = static_cast<uint8_t>(prev[i]);
+            const int c = i >= bpp ? static_cast<uint8_t>(prev[i - bpp]) : 0;
+            const int pred = type == 0 ? 0 : type == 1 ? a : type == 2 ? b : type == 3 ? (a + b) >> 1 : Paeth(a, b, c);
+            out += static_cast<char>(static_cast<uint8_t>(row[i]) - pred);
+        }
+        prev = row;
+    }
+    return out;
+}
+
+struct Case {
+    std::string png;
+    std::string bmp;
+    Image expected;    // dal PNG
+    Image expectedBmp; // gli stessi colori, opachi
+};
+
+Case MakeCase(std::mt19937& rng) {
+    static const int kPasses[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+    const int types[] = {0, 2, 3, 4, 6};
+    const int ct = types[rng() % 5];
+    std::vector<int> depths = ct == 0 ? std::vector<int>{1, 2, 4, 8, 16} : ct == 3 ? std::vector<int>{1, 2, 4, 8} : std::vector<int>{8, 16};
+    const int depth = depths[rng() % depths.size()];
+    const int w = 1 + static_cast<int>(rng() % 70), h = 1 + static_cast<int>(rng() % 70);
+    const bool interlaced = rng() % 5 < 2;
+    const int channels = ct == 0 ? 1 : ct == 2 ? 3 : ct == 3 ? 1 : ct == 4 ? 2 : 4;
+    const int maxv = (1 << depth) - 1;
+
+    std::vector<std::array<uint8_t, 3>> palette;
+    std::vector<uint8_t> paletteAlpha;
+    if (ct == 3) {
+        palette.resize(1 + rng() % (maxv + 1));
+        for (auto& p : palette) p = {static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng())};
+        if (rng() % 2) paletteAlpha.resize(rng() % (palette.size() + 1));
+        for (auto& a : paletteAlpha) a = static_cast<uint8_t>(rng());
+    }
+    std::vector<std::vector<std::array<int, 4>>> px(h, std::vector<std::array<int, 4>>(w));
+    const bool smooth = rng() % 2;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < channels; ++c) px[y][x][c] = static_cast<int>(rng() % (ct == 3 ? palette.size() : maxv + 1));
+            if (smooth && (x + y) % 7) px[y][x] = px[0][0];
+        }
+    }
+    const bool keyed = (ct == 0 || ct == 2) && rng() % 2;
+    const std::array<int, 4> key = px[rng() % h][rng() % w];
+
+    auto to8 = [&](int v) { return depth == 16 ? v >> 8 : depth == 8 ? v : v * 255 / maxv; };
+    auto expected = [&](const std::array<int, 4>& s) -> std::array<uint8_t, 4> {
+        if (ct == 3) {
+            const auto& p = palette[s[0]];
+            return {p[0], p[1], p[2], static_cast<uint8_t>(static_cast<size_t>(s[0]) < paletteAlpha.size() ? paletteAlpha[s[0]] : 255)};
+        }
+        const bool transparent = keyed && std::equal(s.begin(), s.begin() + channels, key.begin());
+        if (ct == 0) return {static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(transparent ? 0 : 255)};
+        if (ct == 2) return {static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(to8(s[1])), static_cast<uint8_t>(to8(s[2])), static_cast<uint8_t>(transparent ? 0 : 255)};
+        if (ct == 4) return {static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(to8(s[1]))};
+        return {static_cast<uint8_t>(to8(s[0])), static_cast<uint8_t>(to8(s[1])), static_cast<uint8_t>(to8(s[2])), static_cast<uint8_t>(to8(s[3]))};
+    };
+    auto rowBytes = [&](const std::vector<std::array<int, 4>>& row) {
+        std::string out;
+        if (depth < 8) {
+            int bits = 0, acc = 0;
+            for (const auto& s : row) {
+                acc = acc << depth | s[0];
+                if ((bits += depth) == 8) {
+                    out += static_cast<char>(acc);
+                    bits = acc = 0;
+                }
+            }
+            if (bits) out += static_cast<char>(acc << (8 - bits));
+            return out;
+        }
+        for (const auto& s : row) {
+            for (int c = 0; c < channels; ++c) {
+                if (depth == 16) out += static_cast<char>(s[c] >> 8);
+                out += static_cast<char>(s[c]);
+            }
+        }
+        return out;
+    };
+
+    const size_t bpp = std::max(1, channels * depth / 8);
+    std::string raw;
+    if (!interlaced) {
+        std::vector<std::string> rows;
+        for (const auto& row : px) rows.push_back(rowBytes(row));
+        raw = FilterRows(rows, bpp, rng);
+    } else {
+        for (const auto& p : kPasses) {
+            std::vector<std::string> rows;
+            for (int y = p[1]; y < h; y += p[3]) {
+                std::vector<std::array<int, 4>> sub;
+                for (int x = p[0]; x < w; x += p[2]) sub.push_back(px[y][x]);
+                if (!sub.empty()) rows.push_back(rowBytes(sub));
+            }
+            raw += FilterRows(rows, bpp, rng);
+        }
+    }
+
+    Case out;
+    std::string ihdr;
+    PutBe32(ihdr, w);
+    PutBe32(ihdr, h);
+    ihdr += {static_cast<char>(depth), static_cast<char>(ct), 0, 0, static_cast<char>(interlaced)};
+    out.png = "\x89PNG\r\n\x1a\n" + Chunk("IHDR", ihdr);
+    if (ct == 3) {
+        std::string plte;
+        for (const auto& p : palette) plte.append(reinterpret_cast<const char*>(p.data()), 3);
+        out.png += Chunk("PLTE", plte);
+        if (!paletteAlpha.empty() || rng() % 2) out.png += Chunk("tRNS", std::string(paletteAlpha.begin(), paletteAlpha.end()));
+    }
+    if (keyed) {
+        std::string trns;
+        for (int c = 0; c < channels; ++c) trns += {static_cast<char>(key[c] >> 8), static_cast<char>(key[c])};
+        out.png += Chunk("tRNS", trns);
+    }
+    const std::string z = ZlibStored(raw);
+    for (size_t at = 0; at < z.size();) { // IDAT spezzato
+        const size_t n = 1 + rng() % std::max<size_t>(1, z.size() / 2);
+        out.png += Chunk("IDAT", z.substr(at, n));
+        at += n;
+    }
+    out.png += Chunk("IEND", "");
+
+    out.expected.width = out.expectedBmp.width = w;
+    out.expected.height = out.expectedBmp.height = h;
+    for (const auto& row : px) {
+        for (const auto& s : row) {
+            const auto e = expected(s);
+            out.expected.rgba.insert(out.expected.rgba.end(), e.begin(), e.end());
+            out.expectedBmp.rgba.insert(out.expectedBmp.rgba.end(), {e[0], e[1], e[2], 255});
+        }
+    }
+
+    // BMP dagli stessi colori: 8 bit se bastano 256 colori, altrimenti 24 o 32
+    std::vector<uint32_t> colors;
+    for (size_t i = 0; i < out.expectedBmp.rgba.size(); i += 4) {
+        const uint32_t c = out.expectedBmp.rgba[i] << 16 | out.expectedBmp.rgba[i + 1] << 8 | out.expectedBmp.rgba[i + 2];
+        if (std::find(colors.begin(), colors.end(), c) == colors.end() && colors.size() <= 256) colors.push_back(c);
+    }
+    int bits = rng() % 3 == 0 ? 8 : rng() % 2 ? 24 : 32;
+    if (bits == 8 && colors.size() > 256) bits = 24;
+    const bool topDown = rng() % 10 < 3;
+    const size_t stride = (static_cast<size_t>(w) * bits + 31) / 32 * 4;
+    std::string pixels;
+    for (int i = 0; i < h; ++i) {
+        const int y = topDown ? i : h - 1 - i;
+        std::string row;
+        for (int x = 0; x < w; ++x) {
+            const uint8_t* p = &out.expectedBmp.rgba[(static_cast<size_t>(y) * w + x) * 4];
+            if (bits == 8) {
+                row += static_cast<char>(std::find(colors.begin(), colors.end(), uint32_t(p[0] << 16 | p[1] << 8 | p[2])) - colors.begin());
+            } else {
+                row += {static_cast<char>(p[2]), static_cast<char>(p[1]), static_cast<char>(p[0])};
+                if (bits == 32) row += '\0';
+            }
+        }
+        row.resize(stride, '\0');
+        pixels += row;
+    }
+    std::string palette8;
+    if (bits == 8) {
+        for (uint32_t c : colors) PutLe(palette8, c, 4);
+    }
+    const uint32_t offset = 14 + 40 + static_cast<uint32_t>(palette8.size());
+    out.bmp = "BM";
+    PutLe(out.bmp, offset + static_cast<uint32_t>(pixels.size()), 4);
+    PutLe(out.bmp, 0, 4);
+    PutLe(out.bmp, offset, 4);
+    PutLe(out.bmp, 40, 4);
+    PutLe(out.bmp, static_cast<uint32_t>(w), 4);
+    PutLe(out.bmp, static_cast<uint32_t>(topDown ? -h : h), 4);
+    PutLe(out.bmp, 1, 2);
+    PutLe(out.bmp, static_cast<uint32_t>(bits), 2);
+    PutLe(out.bmp, 0, 4);
+    PutLe(out.bmp, static_cast<uint32_t>(pixels.size()), 4);
+    PutLe(out.bmp, 0, 8);
+    PutLe(out.bmp, bits == 8 ? static_cast<uint32_t>(colors.size()) : 0, 4);
+    PutLe(out.bmp, 0, 4);
+    out.bmp += palette8 + pixels;
+    return out;
+}
+
+bool DecodesTo(const std::string& bytes, const Image& expected) {
+    Image image;
+    if (!DecodeImage(bytes, image) || image.width != expected.width || image.height != expected.height || image.rgba != expected.rgba) {
+        return false;
+    }
+    int w = 0, h = 0;
+    if (!ImageSize(bytes, w, h) || w != expected.width || h != expected.height) return false;
+
+    // a righe: ognuna una volta, con gli stessi pixel
+    std::vector<uint8_t> rows(expected.rgba.size());
+    std::vector<int> seen(expected.height, 0);
+    ImageRows sink;
+    sink.begin = [&](int width, int height) { return width == expected.width && height == expected.height; };
+    sink.row = [&](int y, const uint8_t* rgba) {
+        ++seen[y];
+        std::copy(rgba, rgba + expected.width * 4, rows.begin() + static_cast<size_t>(y) * expected.width * 4);
+    };
+    return DecodeImage(bytes, sink) && rows == expected.rgba && std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; });
+}
+
+void TestGenerated() {
+    std::mt19937 rng(1);
+    for (int i = 0; i < 200; ++i) {
+        const Case c = MakeCase(rng);
+        CHECK(DecodesTo(c.png, c.expected));
+        CHECK(DecodesTo(c.bmp, c.expectedBmp));
+        Image dib;
+        CHECK(DecodeDib(std::string_view(c.bmp).substr(14), dib) && dib.rgba == c.expectedBmp.rgba);
+
+        Image back;
+        CHECK(DecodeImage(EncodePng(c.expected), back) && back.rgba == c.expected.rgba);
+
+        // file rovinati: false o pixel qualunque, mai fuori dai buffer
+        for (int k = 0; k < 20; ++k) {
+            std::string bad = k % 2 ? c.png : c.bmp;
+            if (k < 10) bad.resize(rng() % bad.size());
+            else for (int j = 0; j < 3; ++j) bad[rng() % bad.size()] ^= static_cast<char>(1 << (rng() % 8));
+            Image ignored;
+            DecodeImage(bad, ignored);
+            MakeThumbnail(bad, 16, 0, ignored);
+        }
+    }
+}
+
+void TestZlibCompressed() {
+    Image expected;
+    expected.width = 32;
+    expected.height = 20;
+    for (int y = 0; y < 20; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            const auto p = ZlibPixel(x, y);
+            expected.rgba.insert(expected.rgba.end(), p.begin(), p.end());
+        }
+    }
+    CHECK(DecodesTo(std::string(reinterpret_cast<const char*>(kZlibPng), sizeof(kZlibPng)), expected));
+}
+
+void TestThumbnails() {
+    Image image;
+    image.width = 400;
+    image.height = 100;
+    image.rgba.resize(static_cast<size_t>(400) * 100 * 4);
+    for (size_t i = 0; i < image.rgba.size(); i += 4) {
+        image.rgba[i] = 200;
+        image.rgba[i + 1] = 100;
+        image.rgba[i + 2] = 0;
+        image.rgba[i + 3] = (i / 4) % 400 < 200 ? 255 : 0; // meta' destra trasparente
+    }
+    const std::string png = EncodePng(image);
+
+    int w = 0, h = 0;
+    ThumbnailSize(400, 100, 64, w, h);
+    CHECK_EQ(w, 64);
+    CHECK_EQ(h, 16);
+    ThumbnailSize(40, 10, 64, w, h); // mai ingrandite
+    CHECK_EQ(w, 40);
+
+    Image thumb;
+    CHECK(MakeThumbnail(png, 64, 0x0000FF, thumb));
+    CHECK_EQ(thumb.width, 64);
+    CHECK_EQ(thumb.height, 16);
+    const uint8_t* left = &thumb.rgba[0];
+    const uint8_t* right = &thumb.rgba[(static_cast<size_t>(8) * 64 + 63) * 4];
+    CHECK(left[0] == 200 && left[1] == 100 && left[2] == 0 && left[3] == 255);
+    CHECK(right[0] == 0 && right[1] == 0 && right[2] == 255 && right[3] == 255); // il fondo
+    CHECK(!MakeThumbnail("non un'immagine", 64, 0, thumb));
+}
+
+} // namespace
+
+int main() {
+    TestGenerated();
+    TestZlibCompressed();
+    TestThumbnails();
+    return TestResult("test_imagecodec");
+}
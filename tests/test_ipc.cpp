@@ -0,0 +1,149 @@
+// Protocollo e server IPC con un client locale (socket unix): parsing delle righe,
+// framing, comandi in pipeline con le risposte in ordine, eventi ai sottoscrittori,
+// un client che non legge le risposte (viene chiuso, gli altri continuano), Stop con
+// client ancora collegati. Permessi: cartella creata a 0700, socket a 0600, nessun socket
+// in una cartella che altri possono scrivere.
+
+#include "check.h"
+#include "ipc.h"
+#include "ipc_fake_ui.h"
+
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+void TestParse() {
+    IpcCommand c = ParseIpcLine(R"({"id":7,"cmd":"set","tile":3,"text":"a\"bè😀\n"})");
+    CHECK(c.error.empty());
+    CHECK(c.op == IpcOp::Set);
+    CHECK_EQ(c.reqId, 7LL);
+    CHECK_EQ(c.tile, uint64_t{3});
+    CHECK(c.text == "a\"b\xC3\xA8\xF0\x9F\x98\x80\n");
+
+    c = ParseIpcLine(R"({"id":1,"cmd":"activate","args":["--a","b c"]})");
+    CHECK(c.op == IpcOp::Activate);
+    CHECK_EQ(c.args.size(), size_t{2});
+
+    CHECK(!ParseIpcLine("{bad").error.empty());
+    CHECK(!ParseIpcLine(R"({"id":1})").error.empty()); // manca cmd
+    CHECK(ParseIpcLine(R"({"id":1,"cmd":"boh"})").op == IpcOp::Unknown);
+    CHECK(IpcErrorReply(4, "no \"x\"") == R"({"id":4,"ok":false,"error":"no \"x\""})");
+}
+
+void TestFramer() {
+    IpcLineFramer framer;
+    std::vector<std::string> lines;
+    CHECK(framer.Feed("ab", 2, lines));
+    CHECK(lines.empty());
+    CHECK(framer.Feed("c\r\n\nde\nf", 9, lines));
+    CHECK_EQ(lines.size(), size_t{2});
+    CHECK(lines[0] == "abc");
+    CHECK(lines[1] == "de");
+
+    IpcLineFramer big;
+    const std::string huge(IpcLineFramer::kMaxLine + 1, 'x');
+    CHECK(!big.Feed(huge.data(), huge.size(), lines));
+}
+
+void TestServer() {
+    const std::string endpoint = TestSocketPath("test");
+    IpcServer server;
+    FakeUi ui(server);
+    CHECK(server.Start(endpoint, ui.Wake()));
+    ui.Start();
+
+    // seconda istanza: lo stesso endpoint e' occupato
+    IpcServer second;
+    CHECK(!second.Start(endpoint, [] {}));
+
+    // pipeline: tutte le richieste prima di leggere, risposte nello stesso ordine
+    IpcClient client;
+    CHECK(client.Connect(endpoint, 1000));
+    constexpr int kCount = 2000;
+    for (int i = 0; i < kCount; ++i) {
+        CHECK(client.Send("{\"id\":" + std::to_string(i) + ",\"cmd\":\"set\",\"tile\":" + std::to_string(i % 7) + ",\"text\":\"t" + std::to_string(i) + "\"}"));
+    }
+    std::string line;
+    for (int i = 0; i < kCount; ++i) {
+        CHECK(client.ReadLine(line));
+        CHECK(line == "{\"id\":" + std::to_string(i) + ",\"ok\":true}");
+    }
+    CHECK(ui.batches < static_cast<uint64_t>(kCount)); // comandi accorpati per giro
+    CHECK(client.Send(R"({"id":1,"cmd":"get","tile":6})"));
+    CHECK(client.ReadLine(line));
+    CHECK(line == R"({"id":1,"ok":true,"text":"t1994"})");
+    CHECK(client.Send("{bad"));
+    CHECK(client.ReadLine(line));
+    CHECK(line.find("\"ok\":false") != std::string::npos);
+
+    // eventi: solo a chi si e' iscritto
+    IpcClient watcher;
+    CHECK(watcher.Connect(endpoint, 1000));
+    CHECK(watcher.Send(R"({"id":9,"cmd":"subscribe"})"));
+    CHECK(watcher.ReadLine(line));
+    CHECK(client.Send(R"({"id":2,"cmd":"set","tile":5,"text":"x"})"));
+    CHECK(client.ReadLine(line));
+    CHECK(watcher.ReadLine(line));
+    CHECK(line == R"({"event":"changed","tile":5})");
+
+    // un client che manda e non legge: la sua coda d'uscita arriva al tetto e viene chiuso,
+    // senza bloccare il server ne' gli altri client
+    ui.padding = 1 << 20;
+    IpcClient greedy;
+    CHECK(greedy.Connect(endpoint, 1000));
+    constexpr int kGreedy = 40; // 40 MB di risposte, oltre i 16 MB del tetto
+    for (int i = 0; i < kGreedy; ++i) CHECK(greedy.Send("{\"id\":" + std::to_string(i) + ",\"cmd\":\"set\",\"tile\":1,\"text\":\"g\"}"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ui.padding = 0;
+    int received = 0;
+    while (greedy.ReadLine(line)) ++received;
+    CHECK(received < kGreedy);
+    CHECK(client.Send(R"({"id":3,"cmd":"get","tile":1})"));
+    CHECK(client.ReadLine(line));
+    CHECK(line == R"({"id":3,"ok":true,"text":"g"})");
+    while (watcher.ReadLine(line) && line != R"({"event":"changed","tile":1})") {
+    }
+
+    // Stop con client collegati: si chiudono e non restano thread appesi
+    ui.Stop();
+    server.Stop();
+    CHECK(!client.ReadLine(line));
+    CHECK(!server.Running());
+}
+
+void TestPermissions() {
+    const std::string dir = "/tmp/gridnotes-perm-" + std::to_string(::getpid());
+    std::filesystem::remove_all(dir);
+    const std::string endpoint = dir + "/gridnotes.sock";
+    IpcServer server;
+    CHECK(server.Start(endpoint, [] {}));
+    struct stat st {};
+    CHECK(stat(dir.c_str(), &st) == 0 && (st.st_mode & 0777) == 0700);
+    CHECK(stat(endpoint.c_str(), &st) == 0 && (st.st_mode & 0777) == 0600);
+    IpcClient client;
+    CHECK(client.Connect(endpoint, 1000));
+    client.Close();
+    server.Stop();
+
+    // cartella che chiunque puo' scrivere, senza sticky bit: ne' server ne' client
+    chmod(dir.c_str(), 0777);
+    IpcServer exposed;
+    CHECK(!exposed.Start(endpoint, [] {}));
+    CHECK(!client.Connect(endpoint, 0));
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+int main() {
+    TestParse();
+    TestFramer();
+    TestServer();
+    TestPermissions();
+    return TestResult("test_ipc");
+}
@@ -0,0 +1,113 @@
+// RepairLayout contro una verifica a forza bruta su board casuali: dopo la riparazione
+// niente sovrapposizioni, niente tile fuori (tranne le impilate sotto la board), stesso
+// risultato a ogni giro; LayoutIsValid d'accordo con la forza bruta.
+
+#include "check.h"
+#include "layoutcheck.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+bool Overlap(const CellRect& a, const CellRect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+// boardH <= 0: nessun limite in basso (le tile impilate stanno sotto la board)
+bool BruteValid(const std::vector<CellRect>& rects, int boardW, int boardH) {
+    for (const CellRect& r : rects) {
+        if (r.x < 0 || r.y < 0 || r.w < 1 || r.h < 1) return false;
+        if (boardW > 0 && r.x + r.w > boardW) return false;
+        if (boardH > 0 && r.y + r.h > boardH) return false;
+    }
+    for (size_t i = 0; i < rects.size(); ++i) {
+        for (size_t j = i + 1; j < rects.size(); ++j) {
+            if (Overlap(rects[i], rects[j])) return false;
+        }
+    }
+    return true;
+}
+
+bool Same(const CellRect& a, const CellRect& b) { return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h; }
+
+void TestDirected() {
+    // gia' valida: nessuna modifica
+    std::vector<CellRect> ok{{0, 0, 2, 2}, {2, 0, 2, 2}, {0, 2, 4, 1}};
+    LayoutReport report = RepairLayout(ok, 4, 3);
+    CHECK(report.fixes.empty());
+    CHECK_EQ(report.overlaps, size_t{0});
+
+    // fuori board: riportata dentro
+    std::vector<CellRect> out{{-2, 1, 3, 1}, {5, 5, 2, 2}};
+    report = RepairLayout(out, 6, 6);
+    CHECK_EQ(report.outOfBounds, size_t{2});
+    CHECK(BruteValid(out, 6, 6));
+
+    // sovrapposte a parita' di colonna: resta l'indice piu' alto (quella che HitTestTile vede)
+    std::vector<CellRect> pair{{0, 0, 2, 2}, {0, 0, 2, 2}};
+    report = RepairLayout(pair, 4, 4);
+    CHECK_EQ(report.overlaps, size_t{1});
+    CHECK(Same(pair[1], CellRect{0, 0, 2, 2}));
+    CHECK(!Same(pair[0], CellRect{0, 0, 2, 2}));
+    CHECK(BruteValid(pair, 4, 4));
+    CHECK_EQ(report.fixes.size(), size_t{1});
+    CHECK_EQ(report.fixes[0].index, size_t{0});
+
+    // board piena: la seconda non trova spazio e finisce sotto
+    std::vector<CellRect> full{{0, 0, 4, 4}, {1, 1, 3, 3}};
+    report = RepairLayout(full, 4, 4);
+    bool stacked = false;
+    for (const LayoutFix& f : report.fixes) stacked |= f.kind == LayoutFix::Kind::Stacked;
+    CHECK(stacked);
+    CHECK(BruteValid(full, 4, 0));
+}
+
+void TestRandom() {
+    std::mt19937 rng(1);
+    for (int round = 0; round < 3000; ++round) {
+        const int boardW = static_cast<int>(rng() % 30) + 1;
+        const int boardH = static_cast<int>(rng() % 30) + 1;
+        const int n = static_cast<int>(rng() % 40);
+        std::vector<CellRect> rects;
+        for (int i = 0; i < n; ++i) {
+            rects.push_back({static_cast<int>(rng() % 40) - 5, static_cast<int>(rng() % 40) - 5, static_cast<int>(rng() % 12) - 1,
+                             static_cast<int>(rng() % 12) - 1});
+        }
+        const std::vector<CellRect> original = rects;
+        CHECK_EQ(LayoutIsValid(rects, boardW, boardH), BruteValid(rects, boardW, boardH));
+
+        const LayoutReport report = RepairLayout(rects, boardW, boardH);
+        bool stacked = false;
+        std::vector<const LayoutFix*> last(rects.size()); // una tile puo' avere piu' modifiche: conta l'ultima
+        for (const LayoutFix& f : report.fixes) {
+            stacked |= f.kind == LayoutFix::Kind::Stacked;
+            CHECK(f.index < rects.size());
+            if (f.index < rects.size()) last[f.index] = &f;
+        }
+        for (size_t i = 0; i < rects.size(); ++i) {
+            if (last[i]) CHECK(Same(last[i]->after, rects[i]));
+        }
+        CHECK(BruteValid(rects, boardW, 0));
+        if (!stacked) CHECK(BruteValid(rects, boardW, boardH));
+        CHECK(LayoutIsValid(rects, boardW, 0));
+
+        // solo le tile riportate cambiano
+        for (size_t i = 0; i < rects.size(); ++i) {
+            if (!last[i]) CHECK(Same(rects[i], original[i]));
+        }
+
+        // deterministico
+        std::vector<CellRect> again = original;
+        RepairLayout(again, boardW, boardH);
+        for (size_t i = 0; i < rects.size(); ++i) CHECK(Same(again[i], rects[i]));
+    }
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestRandom();
+    return TestResult("test_layoutcheck");
+}
@@ -0,0 +1,133 @@
+// MarkdownDoc: blocchi e stili dei casi noti, poi il confronto principale: dopo ogni
+// modifica casuale (anche recinti ``` aperti e chiusi) Update da' gli stessi blocchi,
+// tratti e layout di un documento analizzato da zero. Una modifica su una riga di una nota
+// lunga rianalizza pochi blocchi.
+
+#include "check.h"
+#include "markdown.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+namespace {
+
+MdMetrics TestMetrics() {
+    MdMetrics m;
+    m.width = [](std::wstring_view s, uint8_t style) { return static_cast<int>(s.size()) * (MdHeadingLevel(style) ? 10 : 7); };
+    m.lineHeight = [](uint8_t style) { return MdHeadingLevel(style) ? 24 : 16; };
+    m.version = 1;
+    return m;
+}
+
+bool SameBlocks(const MarkdownDoc& a, const MarkdownDoc& b) {
+    if (a.BlockCount() != b.BlockCount() || a.HasMarkup() != b.HasMarkup()) return false;
+    for (size_t i = 0; i < a.BlockCount(); ++i) {
+        const MdBlock& x = a.Block(i);
+        const MdBlock& y = b.Block(i);
+        if (x.kind != y.kind || x.begin != y.begin || x.length != y.length || x.level != y.level || x.checked != y.checked ||
+            x.markup != y.markup || x.runs.size() != y.runs.size() || x.marker.begin != y.marker.begin ||
+            x.marker.length != y.marker.length) {
+            return false;
+        }
+        for (size_t k = 0; k < x.runs.size(); ++k) {
+            if (x.runs[k].begin != y.runs[k].begin || x.runs[k].length != y.runs[k].length || x.runs[k].style != y.runs[k].style) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool SameLayout(MarkdownDoc& a, MarkdownDoc& b, int width, const MdMetrics& m) {
+    for (size_t i = 0; i < a.BlockCount(); ++i) {
+        const MdBlock& x = a.Layout(i, width, m);
+        const MdBlock& y = b.Layout(i, width, m);
+        if (x.height != y.height || x.fragments.size() != y.fragments.size()) return false;
+        for (size_t k = 0; k < x.fragments.size(); ++k) {
+            const MdFragment& f = x.fragments[k];
+            const MdFragment& g = y.fragments[k];
+            if (f.kind != g.kind || f.style != g.style || f.x != g.x || f.y != g.y || f.w != g.w || f.h != g.h ||
+                f.begin != g.begin || f.length != g.length) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void TestDirected() {
+    MarkdownDoc doc;
+    doc.SetText(L"# Titolo\r\ntesto **grassetto** e *corsivo*\r\n- [x] fatto\r\n12. primo\r\n```\r\ncodice *no*\r\n```\r\n---\r\n");
+    CHECK(doc.HasMarkup());
+    CHECK(doc.BlockCount() >= 6);
+    CHECK(doc.Block(0).kind == MdBlock::Kind::Heading && doc.Block(0).level == 1);
+    CHECK(doc.Block(1).kind == MdBlock::Kind::Paragraph);
+    bool bold = false, italic = false;
+    for (const MdRun& r : doc.Block(1).runs) {
+        const std::wstring s = doc.Text().substr(doc.Block(1).begin + r.begin, r.length);
+        if (r.style & kMdBold) bold = bold || s == L"grassetto";
+        if (r.style & kMdItalic) italic = italic || s == L"corsivo";
+    }
+    CHECK(bold && italic);
+    CHECK(doc.Block(2).kind == MdBlock::Kind::Task && doc.Block(2).checked);
+    CHECK(doc.Block(3).kind == MdBlock::Kind::Numbered);
+    CHECK(doc.Block(4).kind == MdBlock::Kind::Code);
+    CHECK(doc.Block(doc.BlockCount() - 1).kind == MdBlock::Kind::Rule);
+
+    // testo che la EDIT mostra gia' bene
+    doc.SetText(L"solo testo\r\ncon a capo e snake_case_name\r\n");
+    CHECK(!doc.HasMarkup());
+}
+
+void TestIncrementalVsFull() {
+    const wchar_t* pieces[] = {L"# Titolo\r\n", L"testo **grassetto** e *corsivo*\r\n", L"- voce\r\n", L"- [ ] da fare\r\n",
+                               L"- [x] fatto\r\n", L"1. primo\r\n", L"> citazione\r\n", L"```\r\n", L"codice();\r\n", L"---\r\n",
+                               L"\r\n", L"riga con `code` e [link](http://x)\r\n", L"snake_case_name\r\n"};
+    const std::wstring alphabet = L"ab #-*_`>[]()1.\r\n\n ~x";
+    const MdMetrics metrics = TestMetrics();
+    std::mt19937 rng(1);
+    for (int run = 0; run < 20; ++run) {
+        std::wstring text;
+        for (int i = 0; i < 60; ++i) text += pieces[rng() % std::size(pieces)];
+        MarkdownDoc doc;
+        doc.SetText(text);
+        for (int step = 0; step < 300; ++step) {
+            const size_t at = rng() % (text.size() + 1);
+            const size_t removed = std::min<size_t>(text.size() - at, rng() % 6);
+            std::wstring inserted;
+            for (int k = static_cast<int>(rng() % 5); k > 0; --k) inserted += alphabet[rng() % alphabet.size()];
+            if (step % 50 == 0) inserted = L"```\r\n";
+            text.replace(at, removed, inserted);
+            doc.Update(text);
+
+            MarkdownDoc full;
+            full.SetText(text);
+            CHECK(doc.Text() == text);
+            CHECK(SameBlocks(doc, full));
+            if (step % 10 == 0) CHECK(SameLayout(doc, full, 120 + static_cast<int>(rng() % 400), metrics));
+        }
+    }
+}
+
+void TestLocalReparse() {
+    std::wstring text;
+    for (int i = 0; i < 2000; ++i) text += i % 3 ? L"- voce " + std::to_wstring(i) + L"\r\n" : L"paragrafo *semplice*\r\n";
+    MarkdownDoc doc;
+    doc.SetText(text);
+    const size_t before = doc.Parsed();
+    for (int k = 0; k < 100; ++k) {
+        text.insert(text.size() / 2 + k * 31, L"x");
+        doc.Update(text);
+    }
+    CHECK(doc.Parsed() - before <= 100 * 3); // pochi blocchi per modifica, non 2000
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestLocalReparse();
+    TestIncrementalVsFull();
+    return TestResult("test_markdown");
+}
@@ -0,0 +1,114 @@
+// Contatori della memoria e MemTrend. Un contenitore con TrackedAllocator riporta byte e
+// allocazioni vive a zero quando si svuota (copie e spostamenti compresi). Poi un soak
+// simulato: una perdita lenta e costante sotto allocazioni di passaggio va segnalata; una
+// cache limitata che cambia taglia a caso, col processo che oscilla di megabyte, no.
+
+#include "check.h"
+#include "memstats.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Buffer = std::vector<char, TrackedAllocator<char, MemArea::Thumbs>>;
+
+struct Tile {
+    int64_t id;
+    double x, y;
+};
+
+bool Has(const std::vector<std::string>& v, const std::string& name) {
+    return std::find(v.begin(), v.end(), name) != v.end();
+}
+
+void TestBalancedCounters() {
+    const MemAreaStats before = MemRead(MemArea::Tiles);
+    {
+        std::vector<Tile, TrackedAllocator<Tile, MemArea::Tiles>> tiles;
+        for (int i = 0; i < 1000; ++i) tiles.push_back(Tile{i, 0, 0});
+        const MemAreaStats full = MemRead(MemArea::Tiles);
+        CHECK_EQ(full.bytes - before.bytes, static_cast<int64_t>(tiles.capacity() * sizeof(Tile)));
+        CHECK_EQ(full.live - before.live, int64_t{1});
+        CHECK(full.allocs - before.allocs > 1); // le ricrescite del vettore
+
+        auto copy = tiles;
+        auto moved = std::move(tiles);
+        CHECK_EQ(MemRead(MemArea::Tiles).live - before.live, int64_t{2});
+        copy.clear();
+        copy.shrink_to_fit();
+    }
+    const MemAreaStats after = MemRead(MemArea::Tiles);
+    CHECK_EQ(after.bytes, before.bytes);
+    CHECK_EQ(after.live, before.live);
+
+    MemHandle(MemArea::Paint, 3);
+    MemHandle(MemArea::Paint, -3);
+    CHECK_EQ(MemRead(MemArea::Paint).handles, int64_t{0});
+}
+
+// un campione ogni "minuto" di soak; transient e cache sono allocazioni vere nell'area
+// Thumbs, il processo e' simulato (base + perdita + rumore dell'heap)
+std::vector<std::string> Soak(std::mt19937& rng, bool leaking) {
+    MemTrend trend;
+    std::vector<Buffer> leaked, cache;
+    for (int step = 0; step < 96; ++step) {
+        std::vector<Buffer> transient(rng() % 20); // un ridisegno: va e viene
+        for (Buffer& b : transient) b.resize(1 + rng() % 4096);
+
+        // cache limitata: da 32 a 64 voci di taglia qualunque, scelta a caso ogni volta
+        const size_t target = 32 + rng() % 33;
+        while (cache.size() > target) cache.erase(cache.begin() + rng() % cache.size());
+        while (cache.size() < target) cache.emplace_back(1 + rng() % 8192);
+
+        if (leaking) leaked.emplace_back(1024); // un KB perso a ogni campione
+
+        MemSample s = MemCapture(step * 60000);
+        s.processBytes = (80 << 20) + static_cast<int64_t>(rng() % (2 << 20)) + (leaking ? step * 40000 : 0);
+        s.gdiHandles = 120 + (rng() % 8 == 0 ? rng() % 40 : 0);
+        trend.Add(s);
+    }
+    return trend.Suspects();
+}
+
+void TestSoak() {
+    std::mt19937 rng(2024);
+    int missed = 0, wrong = 0;
+    for (int trial = 0; trial < 50; ++trial) {
+        const std::vector<std::string> leak = Soak(rng, true);
+        missed += !Has(leak, "thumbs.live") || !Has(leak, "process.bytes");
+        wrong += Has(leak, "process.gdi");
+
+        const std::vector<std::string> steady = Soak(rng, false);
+        wrong += !steady.empty();
+    }
+    CHECK_EQ(missed, 0);
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(MemRead(MemArea::Thumbs).bytes, int64_t{0}); // e alla fine non resta niente
+    CHECK_EQ(MemRead(MemArea::Thumbs).live, int64_t{0});
+}
+
+void TestWindowNotFull() {
+    MemTrend trend(16);
+    for (int i = 0; i < 15; ++i) {
+        MemSample s;
+        s.gdiHandles = i * 100;
+        trend.Add(s);
+    }
+    CHECK(trend.Suspects().empty()); // finestra non piena: nessun giudizio
+    MemSample s;
+    s.gdiHandles = 1500;
+    trend.Add(s);
+    CHECK(Has(trend.Suspects(), "process.gdi"));
+}
+
+} // namespace
+
+int main() {
+    TestBalancedCounters();
+    TestSoak();
+    TestWindowNotFull();
+    return TestResult("test_memstats");
+}
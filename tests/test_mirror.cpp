@@ -0,0 +1,107 @@
+// Cartella Markdown in tutte e due le direzioni, con il watcher vero (inotify): un file
+// riscritto uguale non si tocca, le proprie scritture e cancellazioni tornano dal watcher
+// e si scartano, una modifica o cancellazione da fuori arriva come cambiamento del solo
+// file toccato, i nomi che non sono di tile si ignorano, la rilettura completa trova
+// cio' che le notifiche hanno perso.
+
+#include "check.h"
+#include "filewatch.h"
+#include "mirror.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// le notifiche arrivano da un altro thread: si aspetta che il contatore si muova
+bool WaitEvents(const std::atomic<int>& events, int atLeast) {
+    for (int i = 0; i < 200 && events.load() < atLeast; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30)); // eventuali eventi doppi della stessa scrittura
+    return events.load() >= atLeast;
+}
+
+void WriteFile(const fs::path& path, const std::string& bytes) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f << bytes;
+}
+
+void TestMirror() {
+    const fs::path dir = fs::temp_directory_path() / ("gridnotes-mirror-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+
+    CHECK_EQ(MirrorIdFromName("42.md"), uint64_t{42});
+    CHECK_EQ(MirrorIdFromName("42.txt"), uint64_t{0});
+    CHECK_EQ(MirrorIdFromName("nota.md"), uint64_t{0});
+
+    MarkdownMirror mirror;
+    CHECK(mirror.Open(dir));
+    for (uint64_t id = 1; id <= 100; ++id) CHECK(mirror.Export(id, "# nota " + std::to_string(id) + "\n"));
+    CHECK_EQ(mirror.Ids().size(), size_t{100});
+
+    // stesso contenuto: il file non si riscrive
+    const auto old = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    fs::last_write_time(mirror.PathOf(7), old);
+    CHECK(mirror.Export(7, "# nota 7\n"));
+    CHECK(fs::last_write_time(mirror.PathOf(7)) == old);
+
+    // un'altra istanza che apre la cartella la ritrova tutta
+    MarkdownMirror other;
+    CHECK(other.Open(dir));
+    const std::vector<MirrorFile> scanned = other.Scan();
+    CHECK_EQ(scanned.size(), size_t{100});
+
+    std::atomic<int> events{0};
+    DirWatcher watcher;
+    CHECK(watcher.Start(dir, [&](const fs::path& name) {
+        mirror.Notify(name);
+        ++events;
+    }));
+
+    CHECK(mirror.Export(5, "cambiato da qui\n"));
+    CHECK(WaitEvents(events, 1));
+    CHECK(mirror.TakeChanges().empty());
+
+    int seen = events.load();
+    WriteFile(dir / "12.md", "modificato da fuori\n");
+    WriteFile(dir / "appunti.txt", "non e' una tile");
+    CHECK(WaitEvents(events, seen + 2));
+    std::vector<MirrorFile> changes = mirror.TakeChanges();
+    CHECK_EQ(changes.size(), size_t{1});
+    if (changes.size() == 1) CHECK(changes[0].id == 12 && !changes[0].deleted && changes[0].bytes == "modificato da fuori\n");
+    CHECK(mirror.TakeChanges().empty());
+
+    seen = events.load();
+    fs::remove(dir / "77.md");
+    CHECK(WaitEvents(events, seen + 1));
+    changes = mirror.TakeChanges();
+    CHECK(changes.size() == 1 && changes[0].id == 77 && changes[0].deleted);
+
+    seen = events.load();
+    mirror.Remove(78);
+    CHECK(WaitEvents(events, seen + 1));
+    CHECK(mirror.TakeChanges().empty());
+    CHECK(!mirror.Has(78));
+
+    watcher.Stop();
+
+    // notifica persa (watcher fermo): solo la rilettura completa se ne accorge
+    WriteFile(dir / "30.md", "scritto a watcher fermo\n");
+    CHECK(mirror.TakeChanges().empty());
+    mirror.Notify(fs::path());
+    changes = mirror.TakeChanges();
+    CHECK(changes.size() == 1 && changes[0].id == 30);
+
+    fs::remove_all(dir);
+}
+
+} // namespace
+
+int main() {
+    TestMirror();
+    return TestResult("test_mirror");
+}
@@ -0,0 +1,93 @@
+// TileQuadtree contro un filtro su tutte le tile, dopo ogni inserimento, rimozione o
+// spostamento: tile larghe e strette, alte fino a 200 celle, board che cresce (la radice
+// si allarga), query che escono dalla board a sinistra e in alto.
+
+#include "check.h"
+#include "quadtree.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+bool Overlap(const CellRect& a, const CellRect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+void TestRandom() {
+    std::mt19937 rng(3);
+    for (int run = 0; run < 200; ++run) {
+        TileQuadtree tree;
+        std::map<uint64_t, CellRect> tiles;
+        uint64_t nextId = 1;
+        for (int step = 0; step < 400; ++step) {
+            const int op = static_cast<int>(rng() % 4);
+            if (op < 2 || tiles.empty()) {
+                const int tall = rng() % 10 == 0 ? 200 : 6;
+                const CellRect r{static_cast<int>(rng() % (200 + run * 10)), static_cast<int>(rng() % 300),
+                                 1 + static_cast<int>(rng() % 40), 1 + static_cast<int>(rng() % tall)};
+                tree.Insert(nextId, r);
+                tiles[nextId++] = r;
+            } else {
+                auto it = tiles.begin();
+                std::advance(it, rng() % tiles.size());
+                if (op == 2) {
+                    tree.Remove(it->first);
+                    tiles.erase(it);
+                } else {
+                    CellRect r = it->second;
+                    r.x = std::max(0, r.x + static_cast<int>(rng() % 21) - 10);
+                    r.y = std::max(0, r.y + static_cast<int>(rng() % 21) - 10);
+                    r.w = std::max(1, r.w + static_cast<int>(rng() % 5) - 2);
+                    tree.Move(it->first, r);
+                    it->second = r;
+                }
+            }
+            CHECK_EQ(tree.Size(), tiles.size());
+
+            const CellRect query{static_cast<int>(rng() % 400) - 20, static_cast<int>(rng() % 400) - 20,
+                                 1 + static_cast<int>(rng() % 100), 1 + static_cast<int>(rng() % 100)};
+            std::vector<uint64_t> got;
+            tree.Query(query, got);
+            std::sort(got.begin(), got.end());
+            std::vector<uint64_t> expected;
+            for (const auto& [id, r] : tiles) {
+                if (Overlap(r, query)) expected.push_back(id);
+            }
+            CHECK(got == expected);
+        }
+    }
+}
+
+void TestDirected() {
+    TileQuadtree tree;
+    std::vector<uint64_t> out{42};
+    tree.Query({0, 0, 100, 100}, out);
+    CHECK(out.empty()); // out viene svuotato anche senza tile
+
+    tree.Insert(1, {0, 0, 2, 2});
+    tree.Insert(2, {5000, 7000, 3, 3}); // lontana: la radice cresce fino a coprirla
+    CHECK(tree.RootCells() >= 7003);
+    tree.Query({4999, 6999, 2, 2}, out);
+    CHECK(out.size() == 1 && out[0] == 2);
+
+    tree.Move(2, {1, 1, 1, 1});
+    tree.Query({1, 1, 1, 1}, out);
+    CHECK_EQ(out.size(), size_t{2});
+    tree.Remove(1);
+    tree.Remove(1); // gia' tolta: niente
+    CHECK_EQ(tree.Size(), size_t{1});
+    tree.Clear();
+    tree.Query({0, 0, 10000, 10000}, out);
+    CHECK(out.empty());
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestRandom();
+    return TestResult("test_quadtree");
+}
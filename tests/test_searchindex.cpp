@@ -0,0 +1,123 @@
+// SearchIndex: termini (minuscole senza accenti, niente lettere sole, ideogrammi uno per
+// uno), anteprime, e poi 20k versioni di note con un flush a meta', riapertura dal
+// manifest e fusione completa. Ogni ricerca (anche con l'ultimo termine come prefisso)
+// trova le stesse tile di una scansione di tutti i testi, con i punteggi in ordine.
+
+#include "check.h"
+#include "searchindex.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void TestTerms() {
+    std::vector<std::string> terms;
+    SearchTerms("Perché l'ÉTÉ è caldo, a1 東京", terms);
+    const std::vector<std::string> expected = {"perche", "ete", "caldo", "a1", "東", "京"};
+    CHECK(terms == expected);
+
+    const std::string snippet = SearchSnippet("prima riga\n\nseconda riga con la parola Cercata dentro e poi ancora testo", "cerc", 40);
+    CHECK(snippet.find("Cercata") != std::string::npos);
+    CHECK(snippet.size() <= 40 + 6); // puntini compresi
+}
+
+struct Doc {
+    uint64_t tile;
+    std::string text;
+};
+
+// con un segmento solo: un prefisso vale per i primi 64 termini in ordine che lo hanno
+// (kMaxExpansions in searchindex.cpp)
+std::set<uint64_t> ScanAll(const std::vector<Doc>& docs, std::string_view query, bool prefix) {
+    constexpr size_t kExpansions = 64;
+    std::vector<std::string> wanted, terms;
+    SearchTerms(query, wanted);
+    std::set<std::string> expanded;
+    if (prefix) {
+        for (const Doc& d : docs) {
+            terms.clear();
+            SearchTerms(d.text, terms);
+            for (const std::string& t : terms) {
+                if (t.rfind(wanted.back(), 0) == 0) expanded.insert(t);
+            }
+        }
+        while (expanded.size() > kExpansions) expanded.erase(std::prev(expanded.end()));
+    }
+    std::set<uint64_t> tiles;
+    for (const Doc& d : docs) {
+        terms.clear();
+        SearchTerms(d.text, terms);
+        bool all = true;
+        for (size_t k = 0; all && k < wanted.size(); ++k) {
+            const bool last = k + 1 == wanted.size();
+            all = std::any_of(terms.begin(), terms.end(), [&](const std::string& t) {
+                return last && prefix ? expanded.count(t) != 0 : t == wanted[k];
+            });
+        }
+        if (all) tiles.insert(d.tile);
+    }
+    return tiles;
+}
+
+void TestAgainstScan(const fs::path& dir) {
+    std::mt19937 rng(1);
+    std::vector<std::string> vocab;
+    for (int i = 0; i < 300; ++i) vocab.push_back("w" + std::to_string(i) + (i % 3 ? "x" : "yy"));
+
+    std::vector<Doc> docs;
+    std::set<std::pair<uint64_t, std::string>> seen;
+    {
+        SearchIndex index;
+        CHECK(index.Open(dir));
+        for (int i = 0; i < 20000; ++i) {
+            Doc d{rng() % 1500 + 1, {}};
+            for (int n = 3 + static_cast<int>(rng() % 30), k = 0; k < n; ++k) {
+                d.text += vocab[std::min(rng() % 300, rng() % 300)] + (k % 7 ? " " : ".\n");
+            }
+            const bool fresh = seen.emplace(d.tile, d.text).second;
+            CHECK(index.Add(d.tile, i, d.text) == fresh); // stessa versione: non si indicizza due volte
+            if (fresh) docs.push_back(d);
+            if (i == 10000) index.Flush();
+        }
+        index.Stop(); // scrive la memtable
+    }
+
+    SearchIndex index;
+    CHECK(index.Open(dir));
+    CHECK_EQ(index.Stats().documents, docs.size());
+    CHECK(!index.Add(docs[5].tile, 99, docs[5].text));
+    index.Merge();
+    CHECK_EQ(index.Stats().segments, size_t{1});
+    CHECK_EQ(index.Stats().documents, docs.size());
+
+    for (int q = 0; q < 120; ++q) {
+        std::string query = vocab[rng() % 300];
+        if (q % 2) query += " " + vocab[rng() % 60];
+        const bool prefix = q % 3 == 0;
+        if (prefix) query.pop_back();
+        const std::vector<SearchHit> hits = index.Query(query, 100000);
+        std::set<uint64_t> tiles;
+        for (const SearchHit& h : hits) tiles.insert(h.tileId);
+        CHECK_EQ(tiles.size(), hits.size()); // un risultato per tile
+        CHECK(tiles == ScanAll(docs, query, prefix));
+        for (size_t k = 1; k < hits.size(); ++k) CHECK(hits[k - 1].score >= hits[k].score);
+    }
+    CHECK(index.Query("zzzqqq", 10).empty());
+}
+
+} // namespace
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("gridnotes-searchindex-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    TestTerms();
+    TestAgainstScan(dir);
+    fs::remove_all(dir);
+    return TestResult("test_searchindex");
+}
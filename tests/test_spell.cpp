@@ -0,0 +1,154 @@
+// Controllo ortografico. Il DAWG compilato da una lista (con /flag e conteggio iniziale
+// alla Hunspell) contiene esattamente le parole della lista; le regole su maiuscole,
+// elisioni e parole tecniche danno gli errori attesi; e dopo ogni modifica casuale gli
+// errori pubblicati dal thread del controllo (che ricontrolla solo intorno al tratto
+// cambiato) sono quelli di un controllo di tutto il testo.
+
+#include "check.h"
+#include "spell.h"
+#include "textcodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <set>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const kSyllables[] = {"ca", "sa", "to", "re", "mi", "la", "no", "ve", "der", "tion", "ing", "pre",
+                                  "con", "stra", "ità", "èl", "ment", "are", "ere", "ire", "gli", "zio", "ne", "ro"};
+
+std::string RandomWord(std::mt19937& rng) {
+    std::string w;
+    for (int n = 1 + static_cast<int>(rng() % 5); n > 0; --n) w += kSyllables[rng() % std::size(kSyllables)];
+    return w;
+}
+
+std::u16string U16(std::string_view s) {
+    std::u16string out;
+    AppendUtf16(out, s);
+    return out;
+}
+
+bool WriteList(const fs::path& path, const std::set<std::string>& words) {
+    std::ofstream f(path, std::ios::binary);
+    f << words.size() << "\n";
+    for (const std::string& w : words) f << w << "/AB\n";
+    return static_cast<bool>(f);
+}
+
+std::vector<std::u16string> Errors(const std::vector<SpellDictionary>& dicts, std::u16string_view text) {
+    std::vector<SpellRange> ranges;
+    SpellCheckRange(dicts, text, 0, text.size(), ranges);
+    std::vector<std::u16string> out;
+    for (const SpellRange& r : ranges) out.push_back(r.word);
+    return out;
+}
+
+bool SameRanges(const std::vector<SpellRange>& a, const std::vector<SpellRange>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].begin != b[i].begin || a[i].end != b[i].end || a[i].word != b[i].word) return false;
+    }
+    return true;
+}
+
+void TestDawg(const fs::path& dir, std::vector<std::string>& pool) {
+    std::mt19937 rng(7);
+    std::set<std::string> words;
+    while (words.size() < 20000) {
+        std::string w = RandomWord(rng);
+        if (rng() % 10 == 0) w[0] = static_cast<char>(w[0] - 32);
+        words.insert(w);
+    }
+    for (const char* w : {"l'", "po'", "un", "di", "acqua", "casa", "Roma"}) words.insert(w);
+    CHECK(WriteList(dir / "parole.dic", words));
+
+    size_t compiled = 0;
+    CHECK(SpellDictionary::Compile(dir / "parole.dic", dir / "parole.dic.dawg", &compiled));
+    CHECK_EQ(compiled, words.size());
+    SpellDictionary dict;
+    CHECK(dict.Open(dir / "parole.dic.dawg"));
+    CHECK_EQ(dict.Words(), words.size());
+    CHECK(!SpellDictionary().Open(dir / "parole.dic")); // una lista non e' un DAWG
+
+    size_t missing = 0;
+    for (const std::string& w : words) missing += !dict.Contains(U16(w));
+    CHECK_EQ(missing, size_t{0});
+    size_t wrong = 0;
+    for (int i = 0; i < 50000; ++i) {
+        std::string w = RandomWord(rng);
+        if (rng() % 3 == 0) w += "x";
+        wrong += dict.Contains(U16(w)) != (words.count(w) > 0);
+    }
+    CHECK_EQ(wrong, size_t{0});
+    CHECK(!dict.Contains(u""));
+    pool.assign(words.begin(), words.end());
+
+    std::vector<SpellDictionary> dicts;
+    dicts.push_back(std::move(dict));
+    const std::vector<std::u16string> expected = {u"caza", u"l'acqa", u"roma"};
+    CHECK(Errors(dicts, U16("Casa casa CASA caza l'acqua l'acqa un po' di NASA iPhone 123abc www.foo.bar user@mail x roma Roma")) ==
+          expected);
+}
+
+void TestIncrementalVsFull(const fs::path& dir, const std::vector<std::string>& pool) {
+    std::vector<SpellDictionary> dicts(1);
+    CHECK(dicts[0].Open(dir / "parole.dic.dawg"));
+
+    SpellChecker checker;
+    checker.Start([](uint64_t) {});
+    checker.LoadDictionaries(dir);
+    std::mt19937 rng(3);
+    for (int round = 0; round < 8; ++round) {
+        std::u16string text;
+        for (int i = 0; i < 300; ++i) {
+            std::string w = rng() % 4 ? pool[rng() % pool.size()] : std::string("qqz") + kSyllables[rng() % std::size(kSyllables)];
+            if (rng() % 20 == 0) w += "'";
+            text += U16(w);
+            text += rng() % 8 ? u" " : u"\r\n";
+        }
+        const uint64_t id = 1 + round % 3;
+        for (int step = 0; step < 150; ++step) {
+            const size_t at = rng() % (text.size() + 1);
+            const size_t removed = std::min<size_t>(rng() % 6, text.size() - at);
+            std::u16string inserted;
+            for (int k = static_cast<int>(rng() % 4); k > 0; --k) inserted += u"aqz 'x."[rng() % 7];
+            text.replace(at, removed, inserted);
+            checker.Update(id, text);
+            if (step % 5 != 4) continue; // qualche testo si sovrascrive prima del controllo
+
+            std::vector<SpellRange> full;
+            SpellCheckRange(dicts, text, 0, text.size(), full);
+            bool same = false;
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!same && std::chrono::steady_clock::now() < deadline) {
+                const SpellRanges published = checker.Misspelled(id);
+                same = published && SameRanges(*published, full);
+                if (!same) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            CHECK(same);
+        }
+    }
+    checker.Remove(1);
+    checker.Clear();
+    checker.Stop();
+}
+
+} // namespace
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("gridnotes-spell-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::vector<std::string> pool;
+    TestDawg(dir, pool);
+    TestIncrementalVsFull(dir, pool);
+    fs::remove_all(dir);
+    return TestResult("test_spell");
+}
@@ -0,0 +1,118 @@
+// LineRing (riempimento, sovrascrittura della piu' vecchia, Clear) e FileTail su file veri:
+// righe a meta', \r\n, righe oltre il tetto, apertura di un file grande dalla coda,
+// troncamento, file sparito e ricreato, rotazione con un file nuovo diverso e con un file
+// nuovo con la stessa intestazione e gia' piu' lungo del vecchio, copytruncate.
+
+#include "check.h"
+#include "tail.h"
+
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void Write(const fs::path& path, const std::string& bytes, bool append = false) {
+    std::ofstream f(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+    f << bytes;
+}
+
+std::string Last(const FileTail& tail) {
+    const LineRing& lines = tail.Lines();
+    return lines.Size() ? lines.At(lines.Size() - 1) : std::string();
+}
+
+void TestRing() {
+    LineRing ring(3);
+    CHECK_EQ(ring.Capacity(), size_t{3});
+    ring.Push("a");
+    ring.Push("b");
+    CHECK(ring.Size() == 2 && ring.At(0) == "a" && ring.At(1) == "b");
+    for (int i = 0; i < 10; ++i) ring.Push(std::to_string(i));
+    CHECK_EQ(ring.Size(), size_t{3});
+    CHECK(ring.At(0) == "7" && ring.At(1) == "8" && ring.At(2) == "9");
+    ring.Clear();
+    CHECK_EQ(ring.Size(), size_t{0});
+    ring.Push("x");
+    CHECK(ring.At(0) == "x");
+    CHECK_EQ(LineRing(0).Capacity(), size_t{1});
+}
+
+void TestTail() {
+    const fs::path dir = fs::temp_directory_path() / ("gridnotes-tail-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const fs::path path = dir / "app.log";
+
+    FileTail tail(path, 5);
+    CHECK(tail.Poll() == FileTail::Result::Missing);
+    CHECK(tail.Poll() == FileTail::Result::Unchanged);
+
+    Write(path, "riga 1\r\nriga 2\nparz");
+    CHECK(tail.Poll() == FileTail::Result::Restarted); // ricomparso
+    CHECK(tail.Text() == "riga 1\nriga 2\nparz");
+    CHECK(tail.Poll() == FileTail::Result::Unchanged);
+    Write(path, "iale\n" + std::string(3000, 'x') + "\n", true);
+    CHECK(tail.Poll() == FileTail::Result::Appended);
+    CHECK_EQ(tail.Lines().Size(), size_t{4});
+    CHECK(tail.Lines().At(2) == "parziale");
+    CHECK_EQ(Last(tail).size(), FileTail::kMaxLineBytes);
+
+    // troncato
+    Write(path, "dopo il troncamento\n");
+    CHECK(tail.Poll() == FileTail::Result::Restarted);
+    CHECK(tail.Lines().Size() == 1 && tail.Lines().At(0) == "dopo il troncamento");
+
+    // rotazione: rinominato e ricreato, piu' lungo e diverso
+    fs::rename(path, dir / "app.log.1");
+    std::string fresh;
+    for (int i = 0; i < 50; ++i) fresh += "nuovo file riga " + std::to_string(i) + "\n";
+    Write(path, fresh);
+    CHECK(tail.Poll() == FileTail::Result::Restarted);
+    CHECK(Last(tail) == "nuovo file riga 49");
+
+    // rotazione con la stessa intestazione (banner di 300 byte, oltre i 256 confrontati) e
+    // il file nuovo gia' piu' lungo del vecchio: se ne accorgono i byte prima dell'offset
+    const std::string banner = "# " + std::string(297, '=') + "\n";
+    Write(path, banner + "vecchio 1\nvecchio 2\n");
+    CHECK(tail.Poll() == FileTail::Result::Restarted);
+    CHECK(Last(tail) == "vecchio 2");
+    fs::rename(path, dir / "app.log.2");
+    Write(path, banner + "nuovo A\nnuovo B\nnuovo C\nnuovo D\n");
+    CHECK(tail.Poll() == FileTail::Result::Restarted);
+    CHECK(tail.Lines().Size() == 5 && tail.Lines().At(1) == "nuovo A" && Last(tail) == "nuovo D");
+
+    // copytruncate e poi scritture veloci con la stessa intestazione prima del Poll
+    Write(path, banner + "dopo copytruncate, una riga piu' lunga di prima\n");
+    CHECK(tail.Poll() == FileTail::Result::Restarted);
+    CHECK(Last(tail) == "dopo copytruncate, una riga piu' lunga di prima");
+
+    // solo aggiunte: niente ripartenze, solo le righe nuove
+    Write(path, "e una\n", true);
+    CHECK(tail.Poll() == FileTail::Result::Appended);
+    CHECK(Last(tail) == "e una");
+
+    // file grande all'apertura: si legge solo la coda e la prima riga (un pezzo) si scarta
+    std::string big;
+    for (int i = 0; i < 20000; ++i) big += "riga numero " + std::to_string(i) + "\n";
+    Write(dir / "big.log", big);
+    FileTail bigTail(dir / "big.log", 3);
+    CHECK(bigTail.Poll() == FileTail::Result::Appended);
+    CHECK(bigTail.Text() == "riga numero 19997\nriga numero 19998\nriga numero 19999");
+
+    fs::remove(path);
+    CHECK(tail.Poll() == FileTail::Result::Missing);
+    CHECK(tail.Text().empty());
+    fs::remove_all(dir);
+}
+
+} // namespace
+
+int main() {
+    TestRing();
+    TestTail();
+    return TestResult("test_tail");
+}
@@ -0,0 +1,240 @@
+// Codec del testo a ogni livello (scalare, SSE2, AVX2 se la CPU ce l'ha). Casi limite di
+// RFC 8259 e di UTF-8: controlli, surrogati spaiati o invertiti, \u sbagliati, sequenze
+// troncate, forme lunghe, surrogati codificati e oltre U+10FFFF. Poi ogni carattere
+// speciale in ogni posizione di stringhe fino a 70 unita' (a cavallo dei blocchi da 16 e
+// 32) e testo casuale: tutti i livelli danno lo stesso risultato di un codificatore di
+// riferimento scritto qui carattere per carattere.
+
+#include "check.h"
+#include "textcodec.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// --- riferimento, un carattere alla volta ---
+
+std::string RefUtf8(std::u16string_view s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        uint32_t c = s[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < s.size() && s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (s[++i] - 0xDC00);
+        } else if (c >= 0xD800 && c <= 0xDFFF) {
+            c = 0xFFFD;
+        }
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += {static_cast<char>(0xC0 | c >> 6), static_cast<char>(0x80 | (c & 0x3F))};
+        } else if (c < 0x10000) {
+            out += {static_cast<char>(0xE0 | c >> 12), static_cast<char>(0x80 | (c >> 6 & 0x3F)), static_cast<char>(0x80 | (c & 0x3F))};
+        } else {
+            out += {static_cast<char>(0xF0 | c >> 18), static_cast<char>(0x80 | (c >> 12 & 0x3F)), static_cast<char>(0x80 | (c >> 6 & 0x3F)),
+                    static_cast<char>(0x80 | (c & 0x3F))};
+        }
+    }
+    return out;
+}
+
+// surrogati spaiati -> U+FFFD, come dopo un giro in UTF-8
+std::u16string Clean(std::u16string_view s) {
+    std::u16string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        const char16_t c = s[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < s.size() && s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF) {
+            out += c;
+            out += s[++i];
+        } else {
+            out += c >= 0xD800 && c <= 0xDFFF ? char16_t{0xFFFD} : c;
+        }
+    }
+    return out;
+}
+
+std::u16string RefEscape(std::u16string_view s) {
+    static const char16_t kHex[] = u"0123456789abcdef";
+    std::u16string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        const char16_t c = s[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < s.size() && s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF) {
+            out += c;
+            out += s[++i];
+        } else if (c == u'"' || c == u'\\') {
+            out += {u'\\', c};
+        } else if (c == u'\b' || c == u'\f' || c == u'\n' || c == u'\r' || c == u'\t') {
+            out += {u'\\', c == u'\b' ? u'b' : c == u'\f' ? u'f' : c == u'\n' ? u'n' : c == u'\r' ? u'r' : u't'};
+        } else if (c < 0x20 || (c >= 0xD800 && c <= 0xDFFF)) {
+            out += {u'\\', u'u', kHex[c >> 12], kHex[c >> 8 & 0xF], kHex[c >> 4 & 0xF], kHex[c & 0xF]};
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+std::u16string RandomText(std::mt19937& rng, size_t n, bool asciiOnly) {
+    std::u16string s;
+    while (s.size() < n) {
+        const int r = static_cast<int>(rng() % 100);
+        if (asciiOnly || r < 80) s += static_cast<char16_t>(32 + rng() % 95);
+        else if (r < 85) s += u"\n\t\"\\\b\f\r\x01\x1f"[rng() % 9];
+        else if (r < 90) s += static_cast<char16_t>(0x80 + rng() % 0x780);
+        else if (r < 95) s += static_cast<char16_t>(0x800 + rng() % 0xD000);
+        else if (r < 98) s += u"\U0001F600";
+        else s += static_cast<char16_t>(0xD800 + rng() % 0x800); // spaiato
+    }
+    return s;
+}
+
+std::vector<SimdLevel> Levels() {
+    std::vector<SimdLevel> levels;
+    for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+        SetTextCodecLevel(l);
+        if (TextCodecLevel() == l) levels.push_back(l);
+    }
+    return levels;
+}
+
+std::string Utf8(std::u16string_view s) {
+    std::string out;
+    AppendUtf8(out, s);
+    return out;
+}
+
+std::u16string Utf16(std::string_view s, bool* valid = nullptr) {
+    std::u16string out;
+    const bool ok = AppendUtf16(out, s);
+    if (valid) *valid = ok;
+    return out;
+}
+
+std::u16string Escaped(std::u16string_view s) {
+    std::u16string out;
+    AppendJsonEscaped(out, s);
+    return out;
+}
+
+std::u16string Unescaped(std::u16string_view s, bool* valid = nullptr) {
+    std::u16string out;
+    const bool ok = AppendJsonUnescaped(out, s);
+    if (valid) *valid = ok;
+    return out;
+}
+
+// tutto quello che si puo' dire di una stringa, al livello attivo
+bool Consistent(std::u16string_view s) {
+    const std::string u8 = Utf8(s);
+    bool valid = false;
+    if (u8 != RefUtf8(s) || Utf16(u8, &valid) != Clean(s) || !valid || !IsValidUtf8(u8)) return false;
+    const std::u16string esc = Escaped(s);
+    if (esc != RefEscape(s) || Unescaped(esc, &valid) != s || !valid) return false;
+    const std::u16string quoted = u"\"" + esc + u"\" coda \"";
+    return FindJsonStringEnd(quoted, 1) == esc.size() + 1;
+}
+
+void TestEdgeCases() {
+    const std::u16string fffd(1, 0xFFFD);
+    for (SimdLevel level : Levels()) {
+        SetTextCodecLevel(level);
+
+        // RFC 8259: controlli e surrogati spaiati escapati, il resto com'e' (anche / e DEL)
+        CHECK(Escaped(u"\x01\x1f\"\\\b\f\n\r\t/\x7f") == u"\\u0001\\u001f\\\"\\\\\\b\\f\\n\\r\\t/\x7f");
+        CHECK(Escaped(std::u16string{0xD800}) == u"\\ud800");
+        CHECK(Escaped(std::u16string{0xDC00, 0xD800}) == u"\\udc00\\ud800"); // invertiti
+        CHECK(Escaped(u"\U0001F600") == u"\U0001F600");
+        CHECK(Unescaped(u"\\ud83d\\ude00\\/") == u"\U0001F600/");
+        CHECK(Unescaped(u"\\uD800") == std::u16string{0xD800});
+
+        bool valid = true;
+        CHECK(Unescaped(u"a\\u12x", &valid) == u"au12x" && !valid); // \u corto: resta la lettera
+        CHECK(Unescaped(u"ab\\u", &valid) == u"abu" && !valid);
+        CHECK(Unescaped(u"\\q", &valid) == u"q" && !valid);
+        CHECK(Unescaped(u"x\\", &valid) == u"x\\" && !valid); // barra finale
+
+        CHECK_EQ(FindJsonStringEnd(u"ab\\\"cd\" x", 0), size_t{6});
+        CHECK_EQ(FindJsonStringEnd(u"ab\\\\\" x", 0), size_t{4});
+        CHECK(FindJsonStringEnd(u"senza fine\\\"", 0) == std::u16string_view::npos);
+
+        // UTF-8 non valido: la parte massimale di ogni sequenza rotta diventa un U+FFFD
+        CHECK(Utf16("\xF0\x9F\x98\x80", &valid) == u"\U0001F600" && valid);
+        CHECK(Utf16("\xC0\xAF", &valid) == fffd + fffd && !valid);               // forma lunga
+        CHECK(Utf16("\xE0\x80\xAF", &valid) == fffd + fffd + fffd && !valid);    // forma lunga
+        CHECK(Utf16("\xED\xA0\x80", &valid) == fffd + fffd + fffd && !valid);    // surrogato
+        CHECK(Utf16("\xF4\x90\x80\x80", &valid) == fffd + fffd + fffd + fffd && !valid); // oltre U+10FFFF
+        CHECK(Utf16("a\xE2\x82", &valid) == u"a" + fffd && !valid);              // troncata
+        CHECK(Utf16("\xE2\x82x", &valid) == fffd + u"x" && !valid);
+        CHECK(Utf16("\x80\xBF", &valid) == fffd + fffd && !valid);               // continuazioni sole
+        for (const char* bad : {"\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "a\xE2\x82", "\xFF"}) CHECK(!IsValidUtf8(bad));
+        CHECK(IsValidUtf8("\xEF\xBF\xBD\xF4\x8F\xBF\xBF"));
+        CHECK(Utf8(std::u16string{0xDBFF}) == "\xEF\xBF\xBD");
+    }
+}
+
+// ogni speciale in ogni posizione: i blocchi vettoriali devono fermarsi proprio li'
+void TestBlockBoundaries() {
+    const std::u16string specials[] = {u"\"", u"\\", u"\x01", u"\n", u"è", u"€", u"\U0001F600",
+                                       std::u16string{0xD800}, std::u16string{0xDC00}, u"\x7f"};
+    for (SimdLevel level : Levels()) {
+        SetTextCodecLevel(level);
+        size_t bad = 0;
+        for (size_t n = 1; n <= 70; ++n) {
+            for (size_t p = 0; p < n; ++p) {
+                for (const std::u16string& sp : specials) {
+                    std::u16string s(n, u'a');
+                    s.replace(p, 1, sp);
+                    bad += !Consistent(s);
+
+                    std::string bytes(n, 'a'); // byte non valido o troncato in posizione p
+                    bytes[p] = static_cast<char>(p % 2 ? 0x80 : 0xE2);
+                    bool valid = true;
+                    const std::u16string back = Utf16(bytes, &valid);
+                    bad += valid || IsValidUtf8(bytes) || back.size() != n || back[p] != 0xFFFD;
+                }
+            }
+        }
+        CHECK_EQ(bad, size_t{0});
+    }
+}
+
+void TestRandomAcrossLevels() {
+    const std::vector<SimdLevel> levels = Levels();
+    std::mt19937 rng(42);
+    size_t bad = 0;
+    for (int it = 0; it < 5000; ++it) {
+        const std::u16string s = RandomText(rng, rng() % 300, it % 3 == 0);
+        std::string bytes; // byte qualunque, con molti inizi e continuazioni
+        for (size_t i = rng() % 80; i > 0; --i) {
+            const int r = static_cast<int>(rng() % 10);
+            bytes += static_cast<char>(r < 4 ? rng() % 128 : r < 7 ? 0x80 + rng() % 64 : 0xC0 + rng() % 64);
+        }
+        std::u16string ref16;
+        bool refValid = false;
+        for (SimdLevel level : levels) {
+            SetTextCodecLevel(level);
+            bad += !Consistent(s);
+            bool valid = false;
+            const std::u16string out = Utf16(bytes, &valid);
+            bad += valid != IsValidUtf8(bytes);
+            if (level == SimdLevel::Scalar) {
+                ref16 = out;
+                refValid = valid;
+            } else {
+                bad += out != ref16 || valid != refValid;
+            }
+            if (valid) bad += Utf8(out) != bytes; // UTF-8 valido fa il giro intero
+        }
+    }
+    CHECK_EQ(bad, size_t{0});
+}
+
+} // namespace
+
+int main() {
+    TestEdgeCases();
+    TestBlockBoundaries();
+    TestRandomAcrossLevels();
+    return TestResult("test_textcodec");
+}
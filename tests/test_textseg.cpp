@@ -0,0 +1,110 @@
+// Segmentazione UAX #29: casi noti (apostrofi, numeri con separatori, emoji composte,
+// bandiere, a capo \r\n) e invarianti su 200k stringhe casuali prese da un alfabeto scelto
+// per far scattare le regole: i segmenti coprono il testo senza buchi, ogni operazione
+// avanza di almeno un'unita', i confini di grafema non spezzano le coppie surrogate.
+
+#include "check.h"
+#include "textseg.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+Utf16View View(const std::u16string& s) { return Utf16View{s.data(), s.size()}; }
+
+std::vector<std::u16string> Segments(const std::u16string& s) {
+    std::vector<std::u16string> out;
+    for (size_t pos = 0; pos < s.size();) {
+        const WordSegment seg = WordSegmentAt(View(s), pos);
+        if (seg.begin != pos || seg.end <= pos) break;
+        out.push_back(s.substr(seg.begin, seg.end - seg.begin));
+        pos = seg.end;
+    }
+    return out;
+}
+
+void TestDirected() {
+    const std::vector<std::u16string> words = Segments(u"can't 3.14 foo_bar, x\r\ny");
+    const std::vector<std::u16string> expected{u"can't", u" ", u"3.14", u" ", u"foo_bar", u",", u" ", u"x", u"\r\n", u"y"};
+    CHECK(words == expected);
+
+    const std::u16string s = u"foo bar  baz.qux";
+    CHECK_EQ(WordRight(View(s), 0), size_t{4});
+    CHECK_EQ(WordLeft(View(s), 7), size_t{4});
+    CHECK_EQ(WordLeft(View(s), 0), size_t{0});
+    CHECK_EQ(WordRight(View(s), s.size()), s.size());
+    CHECK_EQ(WordDeleteLeft(View(s), 9), size_t{4});   // spazi e poi la parola
+    CHECK_EQ(WordDeleteRight(View(s), 0), size_t{4});  // la parola e lo spazio dopo
+    CHECK_EQ(WordDeleteRight(View(s), 7), size_t{9});  // su uno spazio solo gli spazi
+
+    // grafemi: accento combinante, bandiera (due indicatori regionali), famiglia con ZWJ
+    const std::u16string accent = u"éx";
+    CHECK_EQ(NextGraphemeBoundary(View(accent), 0), size_t{2});
+    CHECK_EQ(PrevGraphemeBoundary(View(accent), 2), size_t{0});
+    const std::u16string flag = u"\U0001F1EE\U0001F1F9\U0001F1EB\U0001F1F7";
+    CHECK_EQ(NextGraphemeBoundary(View(flag), 0), size_t{4});
+    CHECK_EQ(PrevGraphemeBoundary(View(flag), flag.size()), size_t{4});
+    const std::u16string family = u"\U0001F468‍\U0001F469";
+    CHECK_EQ(NextGraphemeBoundary(View(family), 0), family.size());
+    const std::u16string crlf = u"\r\n";
+    CHECK_EQ(NextGraphemeBoundary(View(crlf), 0), size_t{2});
+
+    CHECK(FoldCase(u'A') == u'a');
+    CHECK(FoldCase(u'È') == u'è');
+    CHECK(FoldCase(u'Ж') == u'ж');
+    CHECK(FoldCase(u'Σ') == u'σ');
+    CHECK(FoldCase(u'1') == u'1');
+}
+
+bool IsLow(char16_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+bool IsHigh(char16_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+
+void TestRandom() {
+    const char16_t pool[] = {u'a', u' ', u'.', u'\'', u'1', u',', u'\r', u'\n', 0x301, 0x200D, 0xD83D, 0xDE00,
+                             0xD83C, 0xDDEE, 0x4E00, 0x30AB, u'_', 0x1100, 0x1161, 0xAC00, 0x2028, u'"', 0x5D0};
+    std::mt19937 rng(1);
+    for (int round = 0; round < 200000; ++round) {
+        std::u16string s;
+        const int n = static_cast<int>(rng() % 20);
+        for (int i = 0; i < n; ++i) s += pool[rng() % std::size(pool)];
+        const Utf16View v = View(s);
+
+        for (size_t pos = 0; pos < s.size();) {
+            const WordSegment seg = WordSegmentAt(v, pos);
+            CHECK(seg.begin == pos && seg.end > pos && seg.end <= s.size());
+            if (seg.begin != pos || seg.end <= pos) break;
+            for (size_t q = pos + 1; q < seg.end; ++q) {
+                const WordSegment inner = WordSegmentAt(v, q);
+                CHECK(inner.begin == seg.begin && inner.end == seg.end);
+            }
+            pos = seg.end;
+        }
+
+        for (size_t q = 0; q <= s.size(); ++q) {
+            if (q > 0) {
+                CHECK(WordLeft(v, q) < q);
+                CHECK(WordDeleteLeft(v, q) < q);
+                const size_t prev = PrevGraphemeBoundary(v, q);
+                CHECK(prev < q);
+                CHECK(prev == 0 || !(IsHigh(s[prev - 1]) && IsLow(s[prev])));
+            }
+            if (q < s.size()) {
+                CHECK(WordRight(v, q) > q && WordRight(v, q) <= s.size());
+                CHECK(WordDeleteRight(v, q) > q && WordDeleteRight(v, q) <= s.size());
+                const size_t next = NextGraphemeBoundary(v, q);
+                CHECK(next > q && next <= s.size());
+                CHECK(next == s.size() || !(IsHigh(s[next - 1]) && IsLow(s[next])));
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestRandom();
+    return TestResult("test_textseg");
+}
@@ -0,0 +1,215 @@
+// TextView su note generate a caso con metriche sintetiche. Dopo modifiche, selezioni,
+// movimenti e scorrimenti l'indice delle righe logiche coincide con un conteggio degli a
+// capo, il cursore non cade dentro \r\n o una coppia surrogata, e le righe in vista sono
+// quelle di un a capo calcolato da zero. Misurate tutte le righe, l'albero di Fenwick da'
+// il totale esatto e ScrollTo(r) mette in cima proprio la riga visiva r.
+
+#include "check.h"
+#include "textview.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int UnitWidth(char16_t c) {
+    if (c == u'i' || c == u'l' || c == u'.' || c == u' ') return 4;
+    if (c == u'm' || c == u'w') return 12;
+    return c < 128 ? 8 : 10;
+}
+
+TextViewMetrics TestMetrics() {
+    TextViewMetrics m;
+    m.extents = [](std::u16string_view s, std::vector<int>& ends) {
+        ends.resize(s.size());
+        int x = 0;
+        for (size_t i = 0; i < s.size(); ++i) ends[i] = x += UnitWidth(s[i]);
+    };
+    m.lineHeight = 18;
+    m.charWidth = 8;
+    m.version = 1;
+    return m;
+}
+
+bool IsBreakSpace(char16_t c) { return c == u' ' || c == u'\t'; }
+
+// a capo di riferimento di una riga logica: inizi delle righe visive, relativi
+std::vector<size_t> ReferenceWrap(std::u16string_view s, int width) {
+    std::vector<size_t> out{0};
+    size_t pos = 0;
+    while (pos < s.size()) {
+        int x = 0;
+        size_t fit = 0;
+        while (pos + fit < s.size() && x + UnitWidth(s[pos + fit]) <= width) x += UnitWidth(s[pos + fit++]);
+        if (pos + fit == s.size()) break;
+        size_t brk = std::max<size_t>(fit, 1);
+        const size_t left = s.size() - pos;
+        if (brk < left && s[pos + brk] >= 0xDC00 && s[pos + brk] <= 0xDFFF && s[pos + brk - 1] >= 0xD800 && s[pos + brk - 1] <= 0xDBFF) {
+            brk = brk > 1 ? brk - 1 : brk + 1;
+        }
+        if (brk < left && IsBreakSpace(s[pos + brk])) {
+            while (brk < left && IsBreakSpace(s[pos + brk])) ++brk;
+        } else {
+            size_t k = brk;
+            while (k > 0 && !IsBreakSpace(s[pos + k - 1])) --k;
+            if (k > 0) brk = k;
+        }
+        if (brk >= left) break;
+        pos += brk;
+        out.push_back(pos);
+    }
+    return out;
+}
+
+std::u16string MakeNote(size_t target, std::mt19937& rng) {
+    static const char* const kWords[] = {"la", "nota", "tile", "griglia", "scorrimento", "indice", "riga", "testo", "misura", "a",
+                                         "di", "che", "mmmmmmmmmm", "iiiii", "parolalunghissimasenzaspazi"};
+    std::u16string s;
+    while (s.size() < target) {
+        const int kind = static_cast<int>(rng() % 10);
+        const size_t words = kind < 3 ? 1 + rng() % 4 : kind < 9 ? 20 + rng() % 80 : 0;
+        for (size_t w = 0; w < words; ++w) {
+            for (const char* p = kWords[rng() % std::size(kWords)]; *p; ++p) s += static_cast<char16_t>(*p);
+            if (rng() % 50 == 0) s += u"è";
+            if (rng() % 200 == 0) s += u"\U0001F600";
+            if (w + 1 < words) s += u' ';
+        }
+        s += u"\r\n";
+    }
+    return s;
+}
+
+bool SameIndex(const TextView& v) {
+    const std::u16string& t = v.Text();
+    size_t line = 0;
+    if (v.LineStart(0) != 0) return false;
+    for (size_t i = 0; i < t.size(); ++i) {
+        if (t[i] == u'\n' && (++line >= v.LineCount() || v.LineStart(line) != i + 1)) return false;
+    }
+    return line + 1 == v.LineCount();
+}
+
+bool CaretOnBoundary(const TextView& v) {
+    const std::u16string& t = v.Text();
+    const size_t c = v.Caret();
+    if (c == 0 || c >= t.size()) return true;
+    if (t[c] == u'\n' && t[c - 1] == u'\r') return false;
+    return !(t[c] >= 0xDC00 && t[c] <= 0xDFFF && t[c - 1] >= 0xD800 && t[c - 1] <= 0xDBFF);
+}
+
+// le righe in vista sono righe del riferimento, contigue
+bool RowsMatchReference(TextView& v, int width) {
+    const std::vector<TextRow> rows = v.VisibleRows();
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const TextRow& r = rows[i];
+        const size_t b = v.LineStart(r.line), e = v.LineEnd(r.line);
+        const std::vector<size_t> ref = ReferenceWrap(std::u16string_view(v.Text()).substr(b, e - b), width);
+        const auto it = std::find(ref.begin(), ref.end(), r.begin - b);
+        if (it == ref.end()) return false;
+        const size_t end = it + 1 < ref.end() ? b + *(it + 1) : e;
+        if (r.end != end || r.last != (it + 1 == ref.end())) return false;
+        if (i > 0) {
+            const TextRow& p = rows[i - 1];
+            if (p.line == r.line ? p.end != r.begin && !IsBreakSpace(v.Text()[p.end]) : (r.line != p.line + 1 || !p.last)) return false;
+        }
+    }
+    return true;
+}
+
+void TestEditsAgainstReference() {
+    std::mt19937 rng(7);
+    const TextViewMetrics metrics = TestMetrics();
+    for (int round = 0; round < 12; ++round) {
+        TextView v;
+        v.SetMetrics(metrics);
+        const int width = 200 + static_cast<int>(rng() % 400);
+        v.SetViewport(width, 300);
+        v.SetText(MakeNote(20000, rng));
+        std::vector<std::u16string> history{v.Text()};
+        for (int op = 0; op < 300; ++op) {
+            const int k = static_cast<int>(rng() % 12);
+            const size_t n = v.Text().size();
+            if (k < 3) {
+                const size_t a = rng() % (n + 1);
+                v.SetSel(a, std::min(n, a + rng() % 200)); // corta: altrimenti la nota si svuota
+            } else if (k < 6) {
+                const char16_t* const inserts[] = {u"x", u"y", u" ", u"\r\n", u"abc def\r\nghi", u"è"};
+                v.Type(inserts[rng() % std::size(inserts)]);
+            } else if (k < 7) {
+                v.DeleteBack(rng() % 2);
+            } else if (k < 8) {
+                v.DeleteForward(rng() % 2);
+            } else if (k < 10) {
+                const auto m = static_cast<CaretMove>(rng() % 12);
+                v.Move(m, rng() % 2 && m != CaretMove::DocStart && m != CaretMove::DocEnd);
+            } else if (k < 11) {
+                v.ScrollTo(rng() % (v.TotalRows() + 5));
+            } else {
+                v.ScrollBy(static_cast<ptrdiff_t>(rng() % 600) - 300);
+            }
+            CHECK(SameIndex(v));
+            CHECK(CaretOnBoundary(v));
+            CHECK(RowsMatchReference(v, width));
+            history.push_back(v.Text());
+        }
+
+        // annullare riporta a un testo della storia, rifare all'ultimo
+        while (v.Undo()) {}
+        CHECK(std::find(history.begin(), history.end(), v.Text()) != history.end());
+        while (v.Redo()) {}
+        CHECK(v.Text() == history.back());
+    }
+}
+
+void TestRowOffsets() {
+    std::mt19937 rng(11);
+    const TextViewMetrics metrics = TestMetrics();
+    for (int round = 0; round < 6; ++round) {
+        const int width = 150 + static_cast<int>(rng() % 450);
+        TextView v;
+        v.SetMetrics(metrics);
+        v.SetViewport(width, 400);
+        v.SetText(MakeNote(30000, rng));
+        for (int edit = 0; edit < 20; ++edit) {
+            const size_t at = rng() % (v.Text().size() + 1);
+            v.SetSel(at, at);
+            v.Type(edit % 3 ? u"parola nuova " : u"\r\nriga\r\n");
+        }
+
+        // riferimento: tutte le righe visive in ordine
+        std::vector<size_t> begins;
+        for (size_t line = 0; line < v.LineCount(); ++line) {
+            const size_t b = v.LineStart(line), e = v.LineEnd(line);
+            for (size_t r : ReferenceWrap(std::u16string_view(v.Text()).substr(b, e - b), width)) begins.push_back(b + r);
+        }
+
+        // scorrendo fino in fondo ogni riga viene misurata e la stima sparisce
+        v.ScrollTo(0);
+        for (size_t last = SIZE_MAX; v.TopRow() != last;) {
+            last = v.TopRow();
+            v.VisibleRows();
+            v.ScrollBy(static_cast<ptrdiff_t>(v.PageRows()));
+        }
+        CHECK_EQ(v.TotalRows(), begins.size());
+
+        const size_t maxTop = begins.size() - v.PageRows();
+        for (int probe = 0; probe < 200; ++probe) {
+            const size_t row = probe == 0 ? maxTop : rng() % (maxTop + 1);
+            v.ScrollTo(row);
+            CHECK_EQ(v.TopRow(), row);
+            CHECK_EQ(v.VisibleRows().front().begin, begins[row]);
+        }
+        v.ScrollTo(begins.size() + 10); // oltre la fine: l'ultima pagina piena
+        CHECK_EQ(v.TopRow(), maxTop);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestEditsAgainstReference();
+    TestRowOffsets();
+    return TestResult("test_textview");
+}
@@ -0,0 +1,111 @@
+// TimingWheel contro un modello banale (mappa chiave -> scadenza): aggiunte, sostituzioni,
+// rimozioni e avanzamenti di ogni ampiezza, compresi salti di settimane e salti indietro
+// dell'orologio. Advance deve restituire esattamente le scadute in ordine di scadenza e
+// NextDelay non deve mai oltrepassare la prima scadenza.
+
+#include "check.h"
+#include "timewheel.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int64_t kTick = 1000;
+constexpr int64_t kStart = 1760000000000; // ms Unix finti
+constexpr int64_t kDay = 86400000;
+
+int64_t CeilTick(int64_t ms) {
+    const int64_t q = ms / kTick;
+    return q * kTick < ms ? q + 1 : q;
+}
+
+void TestBasics() {
+    TimingWheel w(kTick);
+    w.Reset(kStart);
+    CHECK_EQ(w.NextDelay(kStart), int64_t{-1});
+
+    w.Add(1, kStart + 1500);
+    w.Add(2, kStart + 500);
+    w.Add(3, kStart + 10 * kDay);
+    CHECK_EQ(w.Size(), size_t{3});
+    CHECK(w.Advance(kStart + 999).empty()); // arrotondate al tick successivo: mai in anticipo
+    CHECK(w.Advance(kStart + 1000) == std::vector<uint64_t>{2});
+    CHECK(w.Advance(kStart + 2000) == std::vector<uint64_t>{1});
+
+    w.Add(3, kStart + 3000); // sostituisce la scadenza lontana
+    CHECK_EQ(w.Size(), size_t{1});
+    CHECK(w.NextDelay(kStart + 2000) <= 1000);
+    CHECK(w.Remove(3));
+    CHECK(!w.Remove(3));
+    CHECK(!w.Has(3));
+    CHECK(w.Advance(kStart + 20 * kDay).empty());
+
+    // gia' scaduta quando arriva: esce al primo Advance
+    w.Add(4, kStart);
+    CHECK(w.Advance(kStart + 20 * kDay) == std::vector<uint64_t>{4});
+}
+
+void TestAgainstModel() {
+    std::mt19937_64 rng(7);
+    int64_t now = kStart;
+    TimingWheel w(kTick);
+    w.Reset(now);
+    std::map<uint64_t, int64_t> ref;
+    for (int it = 0; it < 60000; ++it) {
+        const int op = static_cast<int>(rng() % 10);
+        if (op < 5) {
+            const uint64_t k = rng() % 2000;
+            const uint64_t span = rng() % 2 ? 120000 : 90 * kDay;
+            const int64_t due = now + static_cast<int64_t>(rng() % span) - 5000;
+            w.Add(k, due);
+            ref[k] = due;
+        } else if (op < 7) {
+            const uint64_t k = rng() % 2000;
+            CHECK(w.Remove(k) == (ref.erase(k) > 0));
+        } else {
+            const int r = static_cast<int>(rng() % 100);
+            int64_t step;
+            if (r < 80) step = static_cast<int64_t>(rng() % 3000);
+            else if (r < 95) step = static_cast<int64_t>(rng() % 3600000);
+            else if (r < 98) step = static_cast<int64_t>(rng() % (30 * kDay));
+            else step = -static_cast<int64_t>(rng() % 7200000);
+            now += step;
+
+            std::vector<std::pair<int64_t, uint64_t>> due;
+            for (auto e = ref.begin(); e != ref.end();) {
+                if (CeilTick(e->second) <= now / kTick) {
+                    due.emplace_back(e->second, e->first);
+                    e = ref.erase(e);
+                } else {
+                    ++e;
+                }
+            }
+            std::sort(due.begin(), due.end());
+            std::vector<uint64_t> expected;
+            for (const auto& d : due) expected.push_back(d.second);
+            CHECK(w.Advance(now) == expected);
+
+            const int64_t delay = w.NextDelay(now);
+            if (ref.empty()) {
+                CHECK_EQ(delay, int64_t{-1});
+            } else {
+                int64_t first = INT64_MAX;
+                for (const auto& e : ref) first = std::min(first, CeilTick(e.second) * kTick);
+                CHECK(delay >= 0 && now + delay <= first);
+            }
+        }
+        CHECK_EQ(w.Size(), ref.size());
+    }
+}
+
+} // namespace
+
+int main() {
+    TestBasics();
+    TestAgainstModel();
+    return TestResult("test_timewheel");
+}
@@ -0,0 +1,85 @@
+// TrackAxis contro una mappa indice -> dimensione sommata da zero: Offset, IndexAt e
+// NearestLine dopo ogni SetSize, cambio del default e Clear, indici negativi compresi.
+// Overrides elenca esattamente le tracce diverse dal default.
+
+#include "check.h"
+#include "tracks.h"
+
+#include <cstdlib>
+#include <map>
+#include <random>
+
+namespace {
+
+void TestRandom() {
+    std::mt19937 rng(1);
+    for (int round = 0; round < 200; ++round) {
+        TrackAxis axis(48);
+        std::map<int, int> custom;
+        int def = 48;
+        for (int op = 0; op < 200; ++op) {
+            const int r = static_cast<int>(rng() % 10);
+            if (r < 6) {
+                const int i = static_cast<int>(rng() % 300);
+                const int px = rng() % 5 == 0 ? 0 : TrackAxis::kMinSize + static_cast<int>(rng() % 200);
+                axis.SetSize(i, px);
+                if (px <= 0 || px == def) custom.erase(i);
+                else custom[i] = px;
+            } else if (r < 7) {
+                def = TrackAxis::kMinSize + static_cast<int>(rng() % 100);
+                axis.SetDefaultSize(def); // le personalizzate restano, anche se uguali al nuovo default
+            } else if (r < 8) {
+                axis.Clear();
+                custom.clear();
+            }
+            auto size = [&](int i) {
+                auto it = custom.find(i);
+                return it == custom.end() ? def : it->second;
+            };
+
+            for (int q = 0; q < 20; ++q) {
+                const int i = static_cast<int>(rng() % 400) - 20;
+                int64_t offset = 0;
+                if (i >= 0) {
+                    for (int k = 0; k < i; ++k) offset += size(k);
+                } else {
+                    offset = static_cast<int64_t>(i) * def;
+                }
+                CHECK_EQ(axis.Offset(i), offset);
+                CHECK_EQ(axis.Size(i < 0 ? 0 : i), size(i < 0 ? 0 : i));
+
+                const int64_t pos = static_cast<int64_t>(rng() % 30000) - 1000;
+                const int idx = axis.IndexAt(pos);
+                CHECK(axis.Offset(idx) <= pos && pos < axis.Offset(idx + 1));
+                const int line = axis.NearestLine(pos);
+                const int64_t dist = std::llabs(axis.Offset(line) - pos);
+                CHECK(dist <= std::llabs(axis.Offset(idx) - pos) && dist <= std::llabs(axis.Offset(idx + 1) - pos));
+            }
+
+            const auto overrides = axis.Overrides();
+            CHECK_EQ(overrides.size(), custom.size());
+            for (const auto& [i, px] : overrides) CHECK(custom.count(i) && custom[i] == px);
+        }
+    }
+}
+
+void TestDirected() {
+    TrackAxis axis(48);
+    axis.SetSize(2, 100);
+    CHECK_EQ(axis.Offset(-1), int64_t{-48});
+    CHECK_EQ(axis.Offset(3), int64_t{196});
+    CHECK_EQ(axis.Offset(4), int64_t{244});
+    CHECK_EQ(axis.IndexAt(195), 2);
+    CHECK_EQ(axis.IndexAt(196), 3); // sul confine: la traccia che inizia li'
+    axis.SetSize(2, 0);
+    CHECK(axis.Overrides().empty());
+    CHECK_EQ(axis.Offset(3), int64_t{144});
+}
+
+} // namespace
+
+int main() {
+    TestDirected();
+    TestRandom();
+    return TestResult("test_tracks");
+}